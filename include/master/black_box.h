@@ -0,0 +1,63 @@
+#ifndef BLACK_BOX_H
+#define BLACK_BOX_H
+
+#include <stdint.h>
+
+// Pre-failure black box
+//
+// The pump task appends one compact sample of the master state every
+// period, and tasks record state changes as events, into two rings in RTC
+// memory that survive a panic or watchdog reset. A trigger (failsafe entry,
+// or the 'B' command) keeps recording BLACKBOX_POST_SAMPLES more samples
+// and then freezes the rings; on the next boot after an abnormal reset the
+// rings are frozen as found. blackBoxProcess() then formats a CSV dump and
+// appends it to BLACKBOX_PATH through the SD I/O task at safety priority
+// (or prints it when there is no card), and recording resumes.
+//
+// Recording a sample is a few stores with no lock; its cost is measured
+// in CPU cycles and shown by blackBoxPrintStats().
+
+typedef enum {
+    BLACKBOX_EVENT_BOOT,            // arg: esp_reset_reason_t
+    BLACKBOX_EVENT_FAILSAFE,        // arg: SPI timeouts so far
+    BLACKBOX_EVENT_FAILSAFE_CLEAR,
+    BLACKBOX_EVENT_HEALTH,          // arg: SystemHealth
+    BLACKBOX_EVENT_DISPLAY_MODE,    // arg: MODE_AUTO / MODE_MANUAL
+    BLACKBOX_EVENT_OP_MODE,         // arg: OperatingMode
+    BLACKBOX_EVENT_WATER_STATUS,    // arg: WATER_TEMP_STATUS_*
+    BLACKBOX_EVENT_MANUAL,          // Dump requested from the serial console
+    BLACKBOX_EVENT_COUNT
+} BlackBoxEvent;
+
+typedef struct {
+    uint32_t samples;           // Recorded since boot
+    uint32_t events;
+    uint32_t skipped;           // Samples not recorded while frozen
+    uint32_t dumps;             // Written to the card or printed
+    uint32_t dumpErrors;
+    uint32_t sampleCycles;      // Last sample, CPU cycles
+    uint32_t maxSampleCycles;
+    uint64_t totalSampleCycles;
+} BlackBoxStats;
+
+// Check the rings left in RTC memory: kept and frozen for a dump after an
+// abnormal reset, cleared otherwise. Call once before the tasks start.
+void blackBoxInit();
+
+// Pump task only: record the master state
+void blackBoxSample(uint32_t nowMs);
+
+// Any task: record a state change
+void blackBoxEvent(BlackBoxEvent event, uint16_t arg);
+
+// Any task: record event and freeze the rings BLACKBOX_POST_SAMPLES later
+// for a dump. Ignored while a trigger is already pending.
+void blackBoxTrigger(BlackBoxEvent event, uint16_t arg);
+
+// Background task: dump frozen rings, then resume recording
+void blackBoxProcess();
+
+void blackBoxGetStats(BlackBoxStats* stats);
+void blackBoxPrintStats();
+
+#endif // BLACK_BOX_H
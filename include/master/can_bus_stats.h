@@ -0,0 +1,105 @@
+#ifndef CAN_BUS_STATS_H
+#define CAN_BUS_STATS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "master/can_frame_ring.h"
+
+// Per-ID CAN bus statistics
+//
+// For reverse-engineering a bus: which IDs exist, how often and how
+// regularly they come, and which payload bytes move. An open-addressing
+// table keyed by ID and frame type, probed linearly from a multiplicative
+// hash, holds per ID the frame count, an EWMA of the interval (the period)
+// and of its deviation (the jitter, as RTP does it), the shortest and
+// longest interval, the last payload and a mask of the bytes that have
+// changed since the ID was first seen. It stops taking new IDs at half
+// full, so probes stay short, and counts the frames of IDs beyond that.
+// One add() per frame is a hash, a probe or two and a handful of updates.
+//
+// Bus load is the frames' bit count on the wire - exact, stuff bits and
+// CRC included, from canFrameBits() - over the elapsed time, per whole
+// second and since the reset. Only frames the controller accepts are
+// counted, so it is the bus load with the acceptance filters open.
+
+#define CAN_STATS_SLOTS         256     // Table size (power of two), half of it usable
+#define CAN_STATS_EWMA_SHIFT    3       // Period EWMA weight 1/8
+#define CAN_STATS_JITTER_SHIFT  4       // Jitter EWMA weight 1/16
+
+typedef struct {
+    uint32_t id;                // 11 or 29 bits
+    bool extended;
+    uint32_t frames;
+    uint64_t firstUs;
+    uint64_t lastUs;
+    uint32_t periodUs;          // EWMA of the interval, 0 until two frames
+    uint32_t jitterUs;          // EWMA of |interval - period|
+    uint32_t minIntervalUs;     // UINT32_MAX until two frames
+    uint32_t maxIntervalUs;
+    uint8_t dlc;                // Last frame's
+    bool rtr;
+    uint8_t data[8];            // Last payload (zero for RTR)
+    uint8_t changed;            // Bit n: byte n has changed since the first frame
+    uint8_t dlcChanges;         // DLC or RTR changed, saturating
+} CanIdStats;
+
+typedef struct {
+    uint32_t frames;
+    uint32_t ids;
+    uint32_t untracked;         // Frames of IDs the table had no room for
+    uint64_t bits;              // On the wire since the reset
+    uint64_t startUs;           // First frame since the reset, 0 = none
+    uint64_t lastUs;
+    float load;                 // Last whole second, 0..1
+    float peakLoad;             // Busiest whole second
+    uint32_t framesPerSec;      // Last whole second
+} CanBusSummary;
+
+// Bits of a frame on the wire: stuffed SOF to CRC, then CRC delimiter,
+// ACK, end of frame and the 3-bit interframe space
+uint32_t canFrameBits(const CanFrame& frame);
+
+class CanBusStats {
+public:
+    CanBusStats();
+
+    void reset();
+
+    // bitrate for the load, e.g. 500000
+    void setBitrate(uint32_t bitrate) { _bitrate = bitrate; }
+
+    // One received frame; frames come in time order. bits is
+    // canFrameBits(frame), 0 to compute it here.
+    void add(const CanFrame& frame, uint32_t bits = 0);
+
+    // Roll the load over whole seconds up to nowUs, so a bus gone quiet
+    // reads as such
+    void tick(uint64_t nowUs);
+
+    const CanBusSummary& summary() const { return _summary; }
+    float averageLoad() const;
+
+    // Iterate: index below CAN_STATS_SLOTS, false for empty slots
+    bool entry(uint32_t index, CanIdStats* stats) const;
+
+    // Lookup, false if never seen
+    bool find(uint32_t id, bool extended, CanIdStats* stats) const;
+
+    // Probe steps taken by add(), for the bench
+    uint64_t probes() const { return _probes; }
+
+private:
+    int32_t slot(uint32_t key) const;
+    void closeSecond(uint64_t nowUs);
+
+    uint32_t _key[CAN_STATS_SLOTS];         // ID | extended << 29 | used << 30, 0 = empty
+    CanIdStats _entries[CAN_STATS_SLOTS];
+    CanBusSummary _summary;
+    uint32_t _bitrate;
+    uint64_t _secondStartUs;
+    uint64_t _secondBits;
+    uint32_t _secondFrames;
+    uint64_t _probes;
+};
+
+#endif // CAN_BUS_STATS_H
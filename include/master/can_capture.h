@@ -0,0 +1,65 @@
+#ifndef CAN_CAPTURE_H
+#define CAN_CAPTURE_H
+
+#include <stdint.h>
+#include "master/can_capture_log.h"
+
+// Full-rate CAN capture
+//
+// The CAN RX task stores every frame it reads from the controller into
+// capture blocks (format in can_capture_log.h) before the frame reaches the
+// ring, so a slow consumer cannot lose frames for the capture. Sealed
+// blocks go to one sink:
+//
+//   SD   appended to CAN_CAPTURE_DIR/NNNNN.cap through the SD I/O task,
+//        a new file every CAN_CAPTURE_FILE_MB
+//   USB  written whole to Serial by the Log task; log text between blocks
+//        is skipped by the reader, which resyncs on the block magic
+//
+// Buffers live in PSRAM; while the sink falls behind they fill up, and
+// frames with no buffer are dropped and counted in the next block header,
+// next to the controller's overrun count, so a capture proves its own
+// completeness. tools/can-decode turns captures into candump or ASC logs.
+// Capturing opens the acceptance filters; the caller re-plans them
+// (canRefreshFilters()) after starting or stopping.
+
+#define CAN_CAPTURE_DIR     "/can"
+
+enum CanCaptureSink {
+    CAN_CAPTURE_OFF,
+    CAN_CAPTURE_SD,
+    CAN_CAPTURE_USB
+};
+
+typedef struct {
+    CanCaptureSink sink;        // Running
+    uint32_t fileIndex;         // SD: file being written
+    uint32_t overruns;          // Controller overruns since the start
+    uint32_t writeErrors;       // Blocks the card or USB did not take
+    uint32_t pending;           // Sealed, waiting for the SD I/O queue
+    uint64_t startUs;
+    CanCaptureStats writer;
+} CanCaptureStatus;
+
+// Allocate the block buffers (once, before the CAN RX task starts)
+bool canCaptureInit();
+
+// Start capturing to sink, or stop (CAN_CAPTURE_OFF). The CAN RX task
+// switches over on its next wake; a new capture waits until the last
+// one's blocks are written. False if the sink is not available.
+bool canCaptureStart(CanCaptureSink sink);
+
+// Requested sink, CAN_CAPTURE_OFF when not capturing
+CanCaptureSink canCaptureRequested();
+
+// CAN RX task: every frame read, then once per wake
+void canCaptureFrame(const CanFrame& frame);
+void canCaptureService(uint64_t nowUs, uint32_t controllerOverruns);
+
+// Log task: write blocks sealed for the USB sink
+void canCaptureDrainUsb();
+
+void canCaptureGetStatus(CanCaptureStatus* status);
+void canCapturePrintStats();
+
+#endif // CAN_CAPTURE_H
@@ -0,0 +1,138 @@
+#ifndef CAN_CAPTURE_LOG_H
+#define CAN_CAPTURE_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "master/can_frame_ring.h"
+
+// Binary CAN capture format and block writer
+//
+// A capture is a stream of self-contained blocks, written back to back to a
+// file or a USB serial stream:
+//
+//   block = [block header, 32 B][recordCount records, 16 B each]
+//
+// A block carries the full time of its first frame; records store the
+// microseconds since then, so a block is sealed before that offset could
+// pass 28 bits (268 s). Each header holds the block sequence number and the
+// capture's running drop counters, and one CRC over the records followed by
+// the header. A reader finds blocks by their magic and CRC, so text mixed
+// into a serial stream, or a file cut short, only costs the blocks it hits;
+// sequence gaps show blocks lost on the way, and the counters show frames
+// that never made it into a block.
+//
+// CanCaptureWriter fills block buffers supplied by the caller and hands out
+// sealed blocks ready to write. Buffers come back with release() once
+// written; while none is free, frames are dropped and counted. The CRC runs
+// as frames are added, so sealing a block costs no pass over it. Not
+// thread-safe - only the CAN RX task calls it.
+
+// =============================================================================
+// Format
+// =============================================================================
+
+#define CAN_CAPTURE_MAGIC           0x3142414E  // "NAB1"
+#define CAN_CAPTURE_TIME_MASK       0x0FFFFFFF  // Record time offset, us
+#define CAN_CAPTURE_DLC_SHIFT       28
+#define CAN_CAPTURE_ID_EXTENDED     0x80000000
+#define CAN_CAPTURE_ID_RTR          0x40000000
+#define CAN_CAPTURE_ID_MASK         0x1FFFFFFF
+
+typedef struct __attribute__((packed)) {
+    uint32_t timeDlc;           // us since the block's firstTimeUs | dlc << CAN_CAPTURE_DLC_SHIFT
+    uint32_t id;                // 11 or 29 bits | CAN_CAPTURE_ID_*
+    uint8_t data[8];            // Past dlc: zero
+} CanCaptureRecord;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t recordCount;
+    uint16_t reserved;
+    uint32_t sequence;          // Block number since the capture started
+    uint64_t firstTimeUs;       // Arrival of the first frame, esp_timer clock
+    uint32_t dropped;           // Frames with no free buffer, since the capture started
+    uint32_t overruns;          // Controller RX overruns, since the capture started
+    uint32_t crc;               // Of the records, then the header bytes above
+} CanCaptureBlockHeader;
+
+static_assert(sizeof(CanCaptureRecord) == 16, "CanCaptureRecord layout is part of the capture format");
+static_assert(sizeof(CanCaptureBlockHeader) == 32, "CanCaptureBlockHeader layout is part of the capture format");
+
+// Length of the valid block at data (magic, size and CRC), 0 if there is none
+uint32_t canCaptureBlockLength(const uint8_t* data, size_t available);
+
+// Record back to a frame, timed from its block header
+void canCaptureDecode(const CanCaptureBlockHeader* header, const CanCaptureRecord* record,
+                      CanFrame* frame);
+
+// =============================================================================
+// Writer
+// =============================================================================
+
+#define CAN_CAPTURE_MAX_BUFFERS     32
+
+// A sealed block: length bytes at data
+typedef struct {
+    const uint8_t* data;
+    uint32_t length;
+    uint32_t sequence;
+    uint8_t buffer;             // Pass back to release()
+} CanCaptureBlock;
+
+typedef struct {
+    uint32_t frames;            // Stored
+    uint32_t dropped;           // No free buffer
+    uint32_t blocks;            // Sealed
+    uint64_t bytes;             // Sealed, headers included
+    uint32_t buffersInUse;      // Filling or waiting to be written
+    uint32_t maxBuffersInUse;
+} CanCaptureStats;
+
+class CanCaptureWriter {
+public:
+    CanCaptureWriter();
+
+    // buffers: count areas of blockBytes each (at least two records)
+    bool init(uint8_t* const* buffers, uint32_t count, uint32_t blockBytes);
+
+    // Store a frame. Returns true and fills block when a block was sealed,
+    // because it filled or the frame came too late for it.
+    bool add(const CanFrame& frame, CanCaptureBlock* block);
+
+    // Seal the partly filled block if its first frame is at least maxAgeUs
+    // old at nowUs. With maxAgeUs 0 (the end of a capture) and no block
+    // open, counters that changed since the last block go out in an empty one.
+    bool flush(uint64_t nowUs, uint32_t maxAgeUs, CanCaptureBlock* block);
+
+    // Running controller overrun count, stamped into the next blocks
+    void setOverruns(uint32_t overruns) { _overruns = overruns; }
+
+    // Buffer of a block that has been written (or failed to be)
+    void release(uint8_t buffer);
+
+    uint32_t blockBytes() const { return _blockBytes; }
+    const CanCaptureStats& stats() const { return _stats; }
+
+private:
+    bool acquire(uint64_t timeUs);
+    void seal(CanCaptureBlock* block);
+
+    uint8_t* _buffers[CAN_CAPTURE_MAX_BUFFERS];
+    bool _busy[CAN_CAPTURE_MAX_BUFFERS];
+    uint32_t _count;
+    uint32_t _blockBytes;
+    uint32_t _blockRecords;
+
+    int32_t _current;           // Buffer being filled, -1 if none
+    uint32_t _records;          // In the current block
+    uint64_t _firstTimeUs;
+    uint32_t _crc;              // CRC register over the current block's records
+    uint32_t _sequence;
+    uint32_t _overruns;
+    uint32_t _sealedDropped;    // Counters in the last block
+    uint32_t _sealedOverruns;
+
+    CanCaptureStats _stats;
+};
+
+#endif // CAN_CAPTURE_LOG_H
@@ -0,0 +1,96 @@
+#ifndef CAN_FILTER_H
+#define CAN_FILTER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// MCP2515 acceptance filter planning
+//
+// The MCP2515 has two receive buffers, each with one mask and its own
+// filters: RXB0 with RXF0-RXF1, RXB1 with RXF2-RXF5. A frame is accepted if,
+// for any filter of the buffer, it has the filter's frame type (standard or
+// extended) and (id ^ filter) & mask == 0. Six filters can match six IDs
+// exactly; more IDs, or a mix of types that does not fit the two buffers,
+// need masks with don't-care bits that also let some unwanted IDs through.
+//
+// canFilterPlan() chooses masks and filters for a set of wanted IDs. It
+// tries several ways of splitting the IDs between the two buffers and for
+// each clears mask bits greedily until the IDs fit the buffer's filters,
+// picking at every step the bit that lets the least extra traffic through.
+// Traffic comes from a CanTrafficSurvey of the bus taken with all frames
+// accepted; without one, the number of extra IDs in ID space is minimized.
+// A plan that is not exact needs the software check canFilterWanted() on
+// every received frame.
+//
+// Masks and filters use one 29-bit layout: extended IDs as they are,
+// standard IDs in the top 11 bits (id << 18), as in the controller's
+// registers. For standard frames the controller applies the low 16 mask
+// bits to the first two data bytes, so a buffer with standard filters
+// always gets those bits clear.
+
+#define CAN_FILTER_MAX_IDS      16      // Wanted IDs a plan can hold
+#define CAN_FILTER_SURVEY_SLOTS 128     // Distinct IDs a survey can count (power of two)
+
+#define CAN_FILTER_RXB0_FILTERS 2
+#define CAN_FILTER_RXB1_FILTERS 4
+#define CAN_FILTER_COUNT        (CAN_FILTER_RXB0_FILTERS + CAN_FILTER_RXB1_FILTERS)
+
+typedef struct {
+    uint32_t id;                // 11 or 29 bits
+    bool extended;
+} CanId;
+
+// Frames per ID seen on the bus
+class CanTrafficSurvey {
+public:
+    CanTrafficSurvey();
+
+    void reset();
+    void add(uint32_t id, bool extended);
+
+    uint32_t ids() const { return _ids; }
+    uint32_t frames() const { return _frames; }
+    uint32_t untracked() const { return _untracked; }     // Frames of IDs beyond the table
+
+    // Frames counted for ID, 0 if never seen
+    uint32_t count(uint32_t id, bool extended) const;
+
+    // Iterate: index below CAN_FILTER_SURVEY_SLOTS, false for empty slots
+    bool entry(uint32_t index, CanId* id, uint32_t* count) const;
+
+private:
+    uint32_t _key[CAN_FILTER_SURVEY_SLOTS];     // 29-bit layout | extended << 29 | used << 30, 0 = empty
+    uint32_t _count[CAN_FILTER_SURVEY_SLOTS];
+    uint32_t _ids;
+    uint32_t _frames;
+    uint32_t _untracked;
+};
+
+typedef struct {
+    bool open;                              // Accept everything (no wanted IDs)
+    bool exact;                             // Hardware accepts exactly the wanted IDs
+    uint32_t mask[2];                       // RXB0, RXB1
+    uint32_t filter[CAN_FILTER_COUNT];      // RXF0-RXF5
+    bool filterExtended[CAN_FILTER_COUNT];
+    CanId wanted[CAN_FILTER_MAX_IDS];
+    uint32_t wantedCount;
+    uint32_t extraIds;                      // Unwanted IDs in ID space the filters pass
+    uint32_t surveyFrames;                  // Traffic the plan was scored on (0 = none)
+    uint32_t acceptedFrames;                // Of those, passed by the filters
+} CanFilterPlan;
+
+// Plan for count wanted IDs (at most CAN_FILTER_MAX_IDS; none = open).
+// survey may be nullptr. Returns false if there are too many IDs.
+bool canFilterPlan(const CanId* wanted, uint32_t count, const CanTrafficSurvey* survey,
+                   CanFilterPlan* plan);
+
+// What the programmed controller does with a frame
+bool canFilterAccepts(const CanFilterPlan* plan, uint32_t id, bool extended);
+
+// Software check: one of the wanted IDs (always true for an open plan)
+bool canFilterWanted(const CanFilterPlan* plan, uint32_t id, bool extended);
+
+// Share of the surveyed traffic the filters reject, 0..1
+float canFilterPredictedRejection(const CanFilterPlan* plan);
+
+#endif // CAN_FILTER_H
@@ -0,0 +1,55 @@
+#ifndef CAN_FRAME_RING_H
+#define CAN_FRAME_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Received CAN frames between the CAN RX task and their consumer
+//
+// The RX task empties the MCP2515's two receive buffers as soon as its
+// interrupt fires and pushes each frame, stamped with its arrival time,
+// into a CanFrameRing; the consumer (canProcess()) pops them at its own
+// pace. One producer and one consumer, each owning its index, so neither
+// side locks or waits. A full ring refuses the newest frame and counts an
+// overrun - the RX task must never stall while the controller fills up.
+
+#define CAN_FRAME_EXTENDED  0x01        // 29-bit identifier
+#define CAN_FRAME_RTR       0x02        // Remote transmission request
+
+typedef struct {
+    uint64_t timeUs;            // Arrival, esp_timer clock
+    uint32_t id;                // 11 or 29 bits, no flags
+    uint8_t dlc;
+    uint8_t flags;              // CAN_FRAME_*
+    uint8_t data[8];
+} CanFrame;
+
+class CanFrameRing {
+public:
+    CanFrameRing();
+
+    // count must be a power of two
+    bool init(CanFrame* frames, uint32_t count);
+
+    // Producer: false (and an overrun) when full
+    bool push(const CanFrame& frame);
+
+    // Consumer: oldest frame, false when empty
+    bool pop(CanFrame* frame);
+
+    uint32_t capacity() const { return _mask + 1; }
+    uint32_t depth() const;
+    uint32_t maxDepth() const { return _maxDepth; }
+    uint32_t pushed() const { return _head; }   // Since init, wraps
+    uint32_t overruns() const { return _overruns; }
+
+private:
+    CanFrame* _frames;
+    uint32_t _mask;
+    uint32_t _head;             // Producer only
+    uint32_t _tail;             // Consumer only
+    uint32_t _overruns;         // Producer only
+    uint32_t _maxDepth;         // Producer only
+};
+
+#endif // CAN_FRAME_RING_H
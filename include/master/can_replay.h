@@ -0,0 +1,66 @@
+#ifndef CAN_REPLAY_H
+#define CAN_REPLAY_H
+
+#include <stdint.h>
+#include "master/can_replay_log.h"
+
+// CAN log replay
+//
+// Feeds a capture from the SD card (CAN_CAPTURE_DIR/NNNNN.cap, see
+// can_capture.h) into the frame ring in place of the controller, so
+// canProcess() - signal decoding, RPM mode and the pump behind it - runs
+// on recorded traffic exactly as on live frames. The CAN RX task, the
+// ring's only producer, does the work: it reads the file a chunk at a
+// time through the SD I/O task, and hands each frame over once the pacer
+// (can_replay_log.h) says it is due, stamped with the time it is pushed,
+// like a live frame. An esp_timer wakes the task for the next frame.
+//
+// Speed 1 replays in real time, N at N times, CAN_REPLAY_ASAP as fast as
+// canProcess() takes frames. A full ring holds the frame back rather than
+// losing it, so a replay always delivers the whole capture; late frames are
+// counted instead. While a replay runs, live frames still reach the capture
+// and the bus statistics but not the ring. Replays also run without a
+// working controller, e.g. on a bench board.
+//
+// On the device the outcome still depends on task timing; tools/master-bench
+// replay runs the same reader, decoder and assist mapping in simulated time
+// for results that repeat exactly.
+
+#define CAN_REPLAY_NOTIFY   0x08    // CAN RX task notification bit: frame due or chunk read
+
+typedef struct {
+    bool active;
+    uint32_t fileIndex;
+    uint32_t speed;
+    uint32_t delivered;         // Frames pushed into the ring
+    uint32_t held;              // Times the ring was full
+    uint32_t maxLateUs;         // Frame pushed after it was due, at most
+    uint32_t readErrors;
+    uint64_t bytesRead;
+    uint64_t startUs;
+    uint64_t endUs;             // Finished, 0 while running
+    CanReplayStats reader;
+} CanReplayStatus;
+
+// Allocate the read buffer (once, before the CAN RX task starts)
+bool canReplayInit();
+
+// Replay CAN_CAPTURE_DIR/<fileIndex>.cap at speed, replacing a running
+// replay. The CAN RX task starts it on its next wake. False if the SD card
+// or the file is not there.
+bool canReplayStart(uint32_t fileIndex, uint32_t speed);
+void canReplayStop();
+
+// A replay is running: live frames stay out of the ring
+bool canReplayActive();
+
+// Push a frame into the ring; false when full (the frame is held back)
+typedef bool (*CanReplayDeliver)(const CanFrame& frame);
+
+// CAN RX task, once per wake
+void canReplayService(uint64_t nowUs, CanReplayDeliver deliver);
+
+void canReplayGetStatus(CanReplayStatus* status);
+void canReplayPrintStats();
+
+#endif // CAN_REPLAY_H
@@ -0,0 +1,102 @@
+#ifndef CAN_REPLAY_LOG_H
+#define CAN_REPLAY_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "master/can_capture_log.h"
+
+// Reading CAN captures back for replay
+//
+// The other side of can_capture_log.h: a recorded capture fed back to the
+// consumer that normally takes live frames. CanReplayReader takes the file
+// in chunks of any size, into a buffer supplied by the caller that holds at
+// least one whole block, and returns the frames in order. Like
+// tools/can-decode it finds blocks by their magic and CRC, so bytes between
+// valid blocks (log text from a USB capture, a torn write) are skipped and
+// counted, sequence gaps count lost blocks, and the drop counters of the
+// latest header show frames the capture itself missed.
+//
+// CanReplayPacer maps recorded time onto the replay clock: at speed N a
+// frame recorded t after the first is due t / N after the replay started,
+// and CAN_REPLAY_ASAP makes every frame due at once, so the consumer sets
+// the pace. Recorded time going backwards (captures of two boots in one
+// replay) re-anchors the clock at the last frame, so nothing stalls.
+// Neither reads a file or a clock: the device feeds SD chunks and
+// esp_timer time, the host replay a file and simulated time.
+
+#define CAN_REPLAY_ASAP     0       // Speed: as fast as the consumer takes frames
+
+typedef struct {
+    uint32_t blocks;            // Valid blocks read
+    uint32_t frames;
+    uint64_t skippedBytes;      // Not part of a valid block
+    uint32_t missingBlocks;     // Sequence gaps
+    uint32_t dropped;           // Capture's counters, latest block
+    uint32_t overruns;
+} CanReplayStats;
+
+class CanReplayReader {
+public:
+    CanReplayReader();
+
+    // size: one block of the capture at least (CAN_CAPTURE_BLOCK_KB);
+    // blocks bigger than the buffer are skipped
+    bool init(uint8_t* buffer, uint32_t size);
+
+    // Room for the next chunk after the buffered data, moving unread bytes
+    // to the front first; nullptr when full. Then filled() with the bytes
+    // stored there.
+    uint8_t* space(uint32_t* length);
+    void filled(uint32_t length);
+
+    // No more data: a partial block left over is skipped
+    void finish();
+
+    // Next frame, false when the buffered data holds no more. done() tells
+    // the end of the capture from a need for the next chunk.
+    bool next(CanFrame* frame);
+    bool done() const;
+
+    const CanReplayStats& stats() const { return _stats; }
+
+private:
+    bool nextBlock();
+    void skip(uint32_t bytes);
+
+    uint8_t* _buffer;
+    uint32_t _size;
+    uint32_t _start;            // Unread data: _start.._end
+    uint32_t _end;
+    uint32_t _records;          // Left in the current block, at _start
+    CanCaptureBlockHeader _header;
+    bool _finished;
+    bool _sequenced;            // _nextSequence is known
+    uint32_t _nextSequence;
+    CanReplayStats _stats;
+};
+
+class CanReplayPacer {
+public:
+    CanReplayPacer();
+
+    // speed: N times real time, or CAN_REPLAY_ASAP
+    void start(uint32_t speed, uint64_t nowUs);
+
+    // Replay clock time the frame recorded at recordedUs is due; frames
+    // come in recorded order
+    uint64_t due(uint64_t recordedUs);
+
+    uint32_t speed() const { return _speed; }
+    uint32_t restarts() const { return _restarts; }    // Recorded clock went backwards
+
+private:
+    uint32_t _speed;
+    bool _anchored;
+    uint64_t _anchorRecordedUs;
+    uint64_t _anchorDueUs;
+    uint64_t _lastRecordedUs;
+    uint64_t _lastDueUs;
+    uint32_t _restarts;
+};
+
+#endif // CAN_REPLAY_LOG_H
@@ -0,0 +1,112 @@
+#ifndef CAN_SIGNAL_H
+#define CAN_SIGNAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "master/can_filter.h"
+#include "master/can_frame_ring.h"
+
+// DBC-style CAN signal decoding
+//
+// A signal is a bit field of one message, described as in a DBC file:
+// start bit, length, byte order, signedness, and physical = raw * factor
+// + offset. CanSignalDecoder compiles a table of them once: each signal
+// becomes an extractor - a shift and mask over the 8 data bytes read as one
+// 64-bit word - and the extractors of one ID are stored together behind an
+// open-addressing hash, so decoding a frame is one lookup plus a few shifts,
+// whatever the table size. Factor, offset and values are fixed point with
+// CAN_SIGNAL_FRACTION_BITS fraction bits; nothing uses floats.
+//
+// Bit numbering follows DBC: bit n is bit n % 8 of byte n / 8. Intel
+// (little-endian) signals name their least significant bit, Motorola
+// (big-endian) signals their most significant bit. The Volvo speed in bytes
+// 6-7, byte 6 high, is Motorola, start bit 55, length 16.
+
+#define CAN_SIGNAL_MAX              32      // Signals in one table
+#define CAN_SIGNAL_MAX_IDS          16      // Distinct message IDs in one table
+#define CAN_SIGNAL_ID_SLOTS         32      // Hash slots (power of two, 2x IDs)
+#define CAN_SIGNAL_FRACTION_BITS    16
+
+// Fixed point from a constant, e.g. CAN_SIGNAL_FIXED(0.25)
+#define CAN_SIGNAL_FIXED(x) \
+    ((int32_t)((x) * (1 << CAN_SIGNAL_FRACTION_BITS) + ((x) < 0 ? -0.5 : 0.5)))
+
+enum CanByteOrder {
+    CAN_SIGNAL_INTEL,           // Little-endian, DBC @1
+    CAN_SIGNAL_MOTOROLA         // Big-endian, DBC @0
+};
+
+typedef struct {
+    const char* name;
+    uint32_t id;
+    bool extended;
+    uint8_t startBit;           // LSB for Intel, MSB for Motorola
+    uint8_t length;             // 1..32 bits
+    CanByteOrder order;
+    bool isSigned;
+    int32_t factor;             // Fixed point
+    int32_t offset;             // Fixed point
+} CanSignalDef;
+
+typedef struct {
+    int64_t value;              // Physical, fixed point
+    uint64_t timeUs;            // Frame arrival
+    uint32_t updates;           // 0 = never received
+} CanSignalValue;
+
+// Whole units from a fixed point value, rounded half away from zero
+static inline int32_t canSignalToInt(int64_t value) {
+    const int64_t half = (int64_t)1 << (CAN_SIGNAL_FRACTION_BITS - 1);
+    return (int32_t)(value >= 0 ? (value + half) >> CAN_SIGNAL_FRACTION_BITS
+                                : -((-value + half) >> CAN_SIGNAL_FRACTION_BITS));
+}
+
+class CanSignalDecoder {
+public:
+    CanSignalDecoder();
+
+    // Copies nothing: defs must outlive the decoder. False (and an empty
+    // table) if a definition does not fit 8 bytes or the table is too big.
+    bool compile(const CanSignalDef* defs, uint32_t count);
+
+    // Update the signals of the frame's ID, returns how many
+    uint32_t decode(const CanFrame& frame);
+
+    uint32_t signalCount() const { return _signalCount; }
+    const CanSignalDef& definition(uint32_t index) const { return _defs[index]; }
+    const CanSignalValue& value(uint32_t index) const { return _values[index]; }
+
+    // Distinct message IDs in the table, e.g. for acceptance filters
+    uint32_t idCount() const { return _idCount; }
+    CanId id(uint32_t index) const { return _ids[index]; }
+
+private:
+    typedef struct {
+        uint32_t mask;          // length bits
+        uint8_t shift;          // Of the LSB in the Intel or Motorola word
+        uint8_t length;
+        uint8_t minDlc;         // Bytes the signal needs
+        uint8_t flags;          // EXTRACT_*
+        uint8_t signal;         // Index into _defs / _values
+        int32_t factor;
+        int32_t offset;
+    } Extractor;
+
+    typedef struct {
+        uint32_t key;           // 29-bit ID | extended << 29 | used << 30, 0 = empty
+        uint8_t first;          // Into _extractors
+        uint8_t count;
+    } Slot;
+
+    const CanSignalDef* _defs;
+    uint32_t _signalCount;
+    Extractor _extractors[CAN_SIGNAL_MAX];      // Grouped by ID
+    Slot _slots[CAN_SIGNAL_ID_SLOTS];
+    CanId _ids[CAN_SIGNAL_MAX_IDS];
+    uint32_t _idCount;
+    CanSignalValue _values[CAN_SIGNAL_MAX];
+
+    const Slot* find(uint32_t key) const;
+};
+
+#endif // CAN_SIGNAL_H
@@ -0,0 +1,92 @@
+#ifndef CAN_TX_SCHEDULE_H
+#define CAN_TX_SCHEDULE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "master/can_frame_ring.h"
+
+// Periodic CAN transmit schedule
+//
+// Each message has a period, a phase offset and a builder callback that
+// fills its payload when it is due. Deadlines advance by whole periods from
+// the moment the gate opened, never from the time a frame actually went out,
+// so a late frame does not drift the schedule; a message more than a period
+// late skips the deadlines it missed and counts them. The gate lets the
+// schedule run only while a condition holds (the Volvo pump's alive frame
+// being seen); opening it restarts every message at its phase.
+//
+// Each message names one of the MCP2515's three transmit buffers. With
+// equal TXP priority bits the controller sends the highest numbered pending
+// buffer first, so the buffer is the message's priority on the bus side;
+// on this side, due messages go out earliest deadline first.
+//
+// The caller supplies the time and hands due frames to the controller
+// itself; the scheduler never touches the hardware.
+
+#define CAN_TX_MAX_MESSAGES     6
+#define CAN_TX_BUFFERS          3
+
+// Fill the first dlc bytes of data (zeroed); false to skip this deadline
+typedef bool (*CanTxBuilder)(uint8_t* data, void* context);
+
+typedef struct {
+    const char* name;
+    uint32_t id;
+    bool extended;
+    uint8_t dlc;
+    uint32_t periodUs;
+    uint32_t phaseUs;           // First deadline after the gate opens
+    uint8_t buffer;             // TXB0-TXB2, higher goes first
+    CanTxBuilder build;
+    void* context;
+} CanTxMessage;
+
+typedef struct {
+    uint32_t sent;
+    uint32_t declined;          // Builder returned false
+    uint32_t busy;              // Buffer still transmitting at the deadline
+    uint32_t missed;            // Deadlines skipped for being a period late
+    uint32_t maxLateUs;         // Deadline to frame handed to the controller
+    uint32_t maxJitterUs;       // Largest |interval - period| between sends
+    uint32_t minIntervalUs;
+    uint32_t maxIntervalUs;
+    uint64_t lastSentUs;        // 0 = none since the gate opened
+} CanTxStats;
+
+class CanTxScheduler {
+public:
+    CanTxScheduler();
+
+    // False if full or the message is invalid
+    bool add(const CanTxMessage& message);
+    void clear();
+
+    // Opening restarts every message at nowUs + phase
+    void setGate(bool open, uint64_t nowUs);
+    bool gateOpen() const { return _gateOpen; }
+
+    // The due message with the earliest deadline (higher buffer on a tie),
+    // its frame built and its deadline advanced; false if nothing is due.
+    // Report the outcome with sent() or busy().
+    bool next(uint64_t nowUs, uint32_t* index, CanFrame* frame);
+    void sent(uint32_t index, uint64_t sentUs);
+    void busy(uint32_t index);
+
+    // Earliest deadline, UINT64_MAX with the gate closed or no messages
+    uint64_t nextDeadline() const;
+
+    uint32_t count() const { return _count; }
+    const CanTxMessage& message(uint32_t index) const { return _messages[index]; }
+    const CanTxStats& stats(uint32_t index) const { return _stats[index]; }
+    void resetStats();
+
+private:
+    CanTxMessage _messages[CAN_TX_MAX_MESSAGES];
+    CanTxStats _stats[CAN_TX_MAX_MESSAGES];
+    uint64_t _deadline[CAN_TX_MAX_MESSAGES];    // Next
+    uint64_t _due[CAN_TX_MAX_MESSAGES];         // Of the frame last returned by next()
+    uint32_t _count;
+    bool _gateOpen;
+};
+
+#endif // CAN_TX_SCHEDULE_H
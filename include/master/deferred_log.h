@@ -0,0 +1,53 @@
+#ifndef DEFERRED_LOG_H
+#define DEFERRED_LOG_H
+
+#include <stdint.h>
+#include <esp_timer.h>
+#include "master/log_ring.h"
+
+// Deferred console log for the real-time tasks
+//
+// LOG_PRINTF() takes printf arguments but only pushes the format pointer,
+// esp_timer time and binary arguments into a lock-free ring (log_ring.h),
+// so the pump, SPI and UI tasks never pay for formatting or a slow Serial
+// port. The Log task drains the ring every LOG_TASK_PERIOD_MS, formats each
+// record with a "[s.ms]" timestamp at the start of a line, writes it to
+// Serial and, when enabled, appends it to LOG_PATH through the SD I/O task
+// at bulk priority. Records that found the ring full are dropped, never
+// waited for, and the drain reports how many.
+//
+// The format must be a string literal and %s arguments static strings:
+// both are read when the record is printed, not when it is logged.
+// Interactive command output is printed directly as before.
+
+extern LogRing deferredLogRing;
+
+#define LOG_PRINTF(format, ...) do { \
+    if (0) logCheckFormat(format, ##__VA_ARGS__); \
+    deferredLogRing.push((uint64_t)esp_timer_get_time(), "" format, ##__VA_ARGS__); \
+} while (0)
+
+typedef struct {
+    uint32_t pushed;            // Records logged since boot
+    uint32_t dropped;           // Found the ring full
+    uint32_t printed;
+    uint32_t maxDepth;          // Most records ever waiting
+    uint32_t sdBytes;           // Appended to LOG_PATH
+    uint32_t sdDropped;         // Chunks the SD I/O queue had no room for
+    uint32_t maxDrainUs;        // Longest drain pass
+    bool toSd;
+} DeferredLogStats;
+
+// Set up the ring (once, before any task logs)
+bool deferredLogInit();
+
+// Log task body: print everything waiting
+void deferredLogProcess();
+
+// Copy the output to LOG_PATH on the SD card
+void deferredLogSetSd(bool enabled);
+
+void deferredLogGetStats(DeferredLogStats* stats);
+void deferredLogPrintStats();
+
+#endif // DEFERRED_LOG_H
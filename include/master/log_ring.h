@@ -0,0 +1,135 @@
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <type_traits>
+
+// Deferred log records
+//
+// A real-time task logs by pushing the format string pointer, a timestamp
+// and its arguments in binary into a LogRing; nothing is formatted and no
+// I/O is done. A low-priority task pops the records later and formats them
+// with logFormat(). The format string and every %s argument must therefore
+// stay valid until then - string literals and other static strings only.
+//
+// The ring is a bounded multi-producer, single-consumer queue: each slot
+// carries a sequence number, producers claim a slot with one compare and
+// swap on the write position and publish it by advancing the sequence, so
+// any task (on either core) can push without a lock. When the ring is full
+// the record is dropped and counted, the caller never waits.
+//
+// Arguments are stored the way printf reads them after default argument
+// promotion (small integers as int, float as double), so logFormat() can
+// walk the format string to find them. Not supported: '*' width or
+// precision, %n, and the L length modifier.
+
+#define LOG_RING_ARG_BYTES  32      // Eight 32-bit or four 64-bit arguments
+
+typedef struct {
+    const char* format;         // Static string
+    uint64_t timeUs;            // Caller clock when pushed
+    uint8_t argBytes;
+    uint8_t args[LOG_RING_ARG_BYTES];
+} LogRecord;
+
+typedef struct {
+    uint32_t sequence;          // Free for position p at p, published at p + 1
+    LogRecord record;
+} LogSlot;
+
+// =============================================================================
+// Argument packing
+// =============================================================================
+
+// Stored type of one argument, after default argument promotion
+template <typename T>
+struct LogArg {
+    typedef typename std::decay<T>::type D;
+    typedef typename std::conditional<std::is_floating_point<D>::value, double,
+            typename std::conditional<std::is_pointer<D>::value, const void*,
+            typename std::conditional<(sizeof(D) < sizeof(int)), int, D>::type>::type>::type Type;
+};
+
+template <typename... Args>
+struct LogArgBytes;
+
+template <>
+struct LogArgBytes<> {
+    static const size_t value = 0;
+};
+
+template <typename T, typename... Rest>
+struct LogArgBytes<T, Rest...> {
+    static const size_t value = sizeof(typename LogArg<T>::Type) + LogArgBytes<Rest...>::value;
+};
+
+inline void logPack(uint8_t*) {}
+
+template <typename T, typename... Rest>
+inline void logPack(uint8_t* out, T value, Rest... rest) {
+    typename LogArg<T>::Type stored = (typename LogArg<T>::Type)value;
+    memcpy(out, &stored, sizeof(stored));
+    logPack(out + sizeof(stored), rest...);
+}
+
+// Compile-time printf format check for wrappers around push()
+inline void logCheckFormat(const char*, ...) __attribute__((format(printf, 1, 2)));
+inline void logCheckFormat(const char*, ...) {}
+
+// =============================================================================
+// Ring
+// =============================================================================
+
+class LogRing {
+public:
+    LogRing();
+
+    // count must be a power of two
+    bool init(LogSlot* slots, uint32_t count);
+
+    // Any task: queue one record, false (and counted) when the ring is full
+    template <typename... Args>
+    bool push(uint64_t timeUs, const char* format, Args... args) {
+        static_assert(LogArgBytes<Args...>::value <= LOG_RING_ARG_BYTES,
+                      "Too many log arguments");
+        uint32_t position;
+        LogSlot* slot = claim(&position);
+        if (slot == nullptr) {
+            return false;
+        }
+        slot->record.format = format;
+        slot->record.timeUs = timeUs;
+        slot->record.argBytes = (uint8_t)LogArgBytes<Args...>::value;
+        logPack(slot->record.args, args...);
+        publish(slot, position);
+        return true;
+    }
+
+    // Single consumer: take the oldest record, false when none is ready
+    bool pop(LogRecord* record);
+
+    uint32_t capacity() const { return _mask + 1; }
+    uint32_t depth() const;                 // Records waiting (approximate)
+    uint32_t maxDepth() const { return _maxDepth; }
+    uint32_t pushed() const;                // Since init, wraps
+    uint32_t popped() const { return _dequeuePos; }
+    uint32_t dropped() const;
+
+private:
+    LogSlot* claim(uint32_t* position);
+    void publish(LogSlot* slot, uint32_t position);
+
+    LogSlot* _slots;
+    uint32_t _mask;
+    uint32_t _enqueuePos;                   // Producers, compare and swap
+    uint32_t _dequeuePos;                   // Consumer only
+    uint32_t _dropped;
+    uint32_t _maxDepth;
+};
+
+// Format a record into out (always terminated). Returns the length written.
+size_t logFormat(const LogRecord* record, char* out, size_t size);
+
+#endif // LOG_RING_H
@@ -0,0 +1,24 @@
+#ifndef PERIPH_SPI_H
+#define PERIPH_SPI_H
+
+#include <SPI.h>
+
+// Peripheral SPI bus (FSPI)
+//
+// The SD card and the MCP2515 share one bus: SCK, MOSI and MISO on the
+// SD_SPI_*_PIN pins, a chip select each. The ESP32-S3 has two general
+// purpose SPI hosts and HSPI talks to the slave; a host takes MISO from a
+// single pin, so two devices on one host cannot have pin sets of their own.
+//
+// Both drivers get the same SPIClass and wrap every transfer in
+// beginTransaction() / endTransaction(), whose lock serialises the SD I/O
+// and CAN RX tasks and switches the clock between the devices. A long SD
+// transfer holds the bus, so at high bus load the MCP2515's two receive
+// buffers can overrun meanwhile; the CAN RX statistics count it.
+//
+// The bus is begun on the first call, with both chip selects high, and is
+// never ended - unmounting the card leaves it running for the MCP2515.
+
+SPIClass* periphSpi();
+
+#endif // PERIPH_SPI_H
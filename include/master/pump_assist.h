@@ -0,0 +1,35 @@
+#ifndef PUMP_ASSIST_H
+#define PUMP_ASSIST_H
+
+#include <stdint.h>
+#include "master/can_signal.h"
+
+// Pump assist from the vehicle bus
+//
+// What the master makes of the CAN signals it follows: the signal table of
+// the Volvo EHPS bus (docs/volvo-xc60-eps-can-bus.md), the newest engine
+// RPM out of it, the pump task's RPM to PWM duty curve and the EHPS speed
+// value sent for a duty. Kept out of can_handler and the pump task so the
+// host replay (tools/master-bench) runs captures through the same steps.
+
+// Default signal table
+enum CanSignalIndex {
+    CAN_SIGNAL_PUMP_STATUS,     // 0x1B200002 bytes 6-7, big-endian
+    CAN_SIGNAL_VEHICLE_SPEED,   // 0x02104136 bytes 6-7, big-endian, inverted
+    CAN_SIGNAL_ENGINE_RPM,      // canSetRpmMessageId() bytes 0-1, little-endian
+    CAN_SIGNAL_DEFAULT_COUNT
+};
+
+extern const CanSignalDef CAN_DEFAULT_SIGNALS[CAN_SIGNAL_DEFAULT_COUNT];
+
+// RPM from the signal value if it has updates since *seenUpdates (which
+// it advances), clamped to 0..65535
+bool pumpAssistRpm(const CanSignalValue& value, uint32_t* seenUpdates, uint16_t* rpm);
+
+// Pump task PWM duty for an engine RPM, full at 4000
+uint8_t pumpDutyForRpm(uint16_t rpm);
+
+// Speed value sent for a PWM duty (0-255)
+uint16_t ehpsSpeedForDuty(uint8_t duty);
+
+#endif // PUMP_ASSIST_H
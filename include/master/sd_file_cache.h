@@ -0,0 +1,132 @@
+#ifndef SD_FILE_CACHE_H
+#define SD_FILE_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Open file handle cache for sd_handler
+//
+// Opening a file on FatFs resolves the path through the directory entries
+// and every seek walks the cluster chain from the start, so open -> op ->
+// close per call costs far more than the transfer itself for small random
+// accesses. The cache keeps up to SD_FILE_CACHE_MAX files open, keyed by
+// path, and closes the least recently used one when a new path needs a
+// slot. Handles returned by open() pin their slot until release().
+//
+// Writes stay in the file system buffers until sync(): syncDue() flushes
+// files left dirty longer than the sync interval, and every path-based
+// operation that bypasses the cache (remove, rename, truncate, rmdir) must
+// call invalidate() or invalidateDir() first.
+//
+// Only talks to the file system through SdFileBackend, so the same code runs
+// on the Arduino SD library and on stdio in tools/master-bench. Not
+// thread-safe - sd_handler serialises access with its mutex.
+
+// =============================================================================
+// Configuration
+// =============================================================================
+
+#define SD_FILE_CACHE_MAX       8           // Slots available to init()
+#define SD_FILE_PATH_MAX        48          // Longer paths are opened per use, not kept
+
+typedef int32_t SdHandle;                   // Slot + generation, negative = invalid
+#define SD_HANDLE_INVALID       (-1)
+
+// =============================================================================
+// Backend
+// =============================================================================
+
+class SdFileBackend {
+public:
+    virtual ~SdFileBackend() {}
+
+    // Open for reading and writing, creating an empty file if create is set
+    // Returns nullptr if the file does not exist (and !create) or on error
+    virtual void* open(const char* path, bool create) = 0;
+
+    // Positioned transfers, return bytes moved or -1 on error
+    virtual int32_t readAt(void* file, uint32_t offset, uint8_t* buffer, size_t length) = 0;
+    virtual int32_t writeAt(void* file, uint32_t offset, const uint8_t* data, size_t length) = 0;
+
+    virtual int32_t size(void* file) = 0;
+    virtual bool sync(void* file) = 0;
+    virtual void close(void* file) = 0;
+};
+
+// =============================================================================
+// Statistics
+// =============================================================================
+
+typedef struct {
+    uint32_t hits;          // open() served by a cached file
+    uint32_t misses;        // open() that had to open the file
+    uint32_t evictions;     // Files closed to make room
+    uint32_t syncs;         // Dirty files flushed
+    uint32_t bypasses;      // Paths too long to keep open
+} SdFileCacheStats;
+
+// =============================================================================
+// SdFileCache Class
+// =============================================================================
+
+class SdFileCache {
+public:
+    SdFileCache();
+
+    void init(SdFileBackend* backend, uint32_t slots);
+
+    // Pin the file at path, opening it if needed
+    SdHandle open(const char* path, bool create);
+    void release(SdHandle handle);
+
+    int32_t readAt(SdHandle handle, uint32_t offset, uint8_t* buffer, size_t length);
+    int32_t writeAt(SdHandle handle, uint32_t offset, const uint8_t* data, size_t length);
+    int32_t size(SdHandle handle);
+    bool sync(SdHandle handle);
+
+    // Flush path if it is cached and dirty (before reading it another way)
+    bool syncPath(const char* path);
+
+    // Flush and close path if cached; pinned handles to it become invalid
+    void invalidate(const char* path);
+
+    // invalidate() every cached file below directory dir
+    void invalidateDir(const char* dir);
+
+    // Flush every dirty file / those dirty for at least intervalMs
+    bool syncAll();
+    bool syncDue(uint32_t nowMs, uint32_t intervalMs);
+
+    // Flush and close everything (unmount)
+    void closeAll();
+
+    const SdFileCacheStats& stats() const { return _stats; }
+    uint32_t openFiles() const;
+
+private:
+    typedef struct {
+        void* file;                 // Backend file, nullptr if the slot is free
+        char path[SD_FILE_PATH_MAX];
+        uint32_t lastUse;           // Access counter value, for LRU
+        uint32_t dirtySince;        // Time of the first unsynced write
+        uint16_t generation;        // Bumped on close, stale handles fail
+        uint8_t pins;
+        bool dirty;
+        bool transient;             // Path too long - closed on the last release()
+    } Slot;
+
+    SdFileBackend* _backend;
+    Slot _slots[SD_FILE_CACHE_MAX];
+    uint32_t _slotCount;
+    uint32_t _clock;
+    uint32_t _nowMs;                // Last time passed to syncDue()
+    SdFileCacheStats _stats;
+
+    Slot* lookup(SdHandle handle);
+    int32_t find(const char* path) const;
+    int32_t victim() const;
+    bool flushSlot(Slot& slot);
+    void closeSlot(Slot& slot);
+};
+
+#endif // SD_FILE_CACHE_H
@@ -4,6 +4,8 @@
 #include <Arduino.h>
 #include <stdint.h>
 #include <stddef.h>
+#include "master/sd_file_cache.h"
+#include "shared/sd_latency.h"
 
 // Initialize SD card on dedicated SPI bus
 // Returns true if SD card is present and initialized
@@ -55,6 +57,7 @@ bool sdWriteFile(const char* path, const uint8_t* data, size_t length);
 bool sdWriteFileString(const char* path, const String& content);
 
 // Append buffer to file (creates if doesn't exist)
+// Data reaches the card on the next sync, like sdWriteFileAt()
 bool sdAppendFile(const char* path, const uint8_t* data, size_t length);
 
 // Append string to file (creates if doesn't exist)
@@ -64,17 +67,68 @@ bool sdAppendFileString(const char* path, const String& content);
 int32_t sdFileSize(const char* path);
 
 // Low-level random access operations (for virtual memory system)
+// These go through the open file cache (see below), so repeated access to
+// the same files skips the path lookup and cluster chain walk of an open
 // Read data from file at specific offset
 // Returns bytes read, or -1 on error
 int32_t sdReadFileAt(const char* path, uint32_t offset, uint8_t* buffer, size_t length);
 
-// Write data to file at specific offset (file must exist, will extend if needed)
+// Write data to file at specific offset (created if missing, extended if needed)
 // Returns bytes written, or -1 on error
+// Data reaches the card on the next sync (sdSyncFile, sdSyncAll or sdPeriodicSync)
 int32_t sdWriteFileAt(const char* path, uint32_t offset, const uint8_t* data, size_t length);
 
-// Create a file of specified size, filled with zeros
-// Useful for pre-allocating virtual memory swap file
-bool sdCreateSparseFile(const char* path, uint32_t size);
+// Open file handles
+// Up to SD_FILE_CACHE_SIZE files stay open, least recently used closed
+// first. sdOpen() pins a file until sdClose(), which releases the handle
+// but leaves the file open for the next user. Handles become invalid if the
+// file is removed, renamed, rewritten with sdWriteFile() or the card is
+// unmounted (calls then fail with -1/false).
+SdHandle sdOpen(const char* path, bool create = false);
+int32_t sdPread(SdHandle handle, uint32_t offset, uint8_t* buffer, size_t length);
+int32_t sdPwrite(SdHandle handle, uint32_t offset, const uint8_t* data, size_t length);
+int32_t sdHandleSize(SdHandle handle);
+bool sdSync(SdHandle handle);
+void sdClose(SdHandle handle);
+
+// Flush buffered writes to the card
+bool sdSyncFile(const char* path);
+bool sdSyncAll();
+
+// Flush files written more than SD_SYNC_INTERVAL_MS ago (call periodically)
+void sdPeriodicSync();
+
+// Open file cache counters
+void sdGetFileCacheStats(SdFileCacheStats* stats, uint32_t* openFiles);
+
+// Latency histograms per operation type, throughput and the slow-op trace
+// (operations of at least SD_SLOW_OP_US). Counted since mount or reset.
+void sdGetLatencyStats(SdLatencyStats* stats);
+void sdResetLatencyStats();
+void sdPrintLatencyStats();
+
+// Where a file lies on the card. A contiguous file occupies sectors
+// firstSector .. firstSector + sectors - 1 of FatFs physical drive `drive`,
+// so it can be read and written with disk_read()/disk_write() directly.
+typedef struct {
+    bool contiguous;
+    uint8_t drive;
+    uint16_t sectorSize;
+    uint32_t firstSector;       // 0 unless contiguous
+    uint32_t sectors;
+} SdExtent;
+
+// Create a file of specified size without writing its contents
+// Clusters are allocated but not cleared, so existing card data may show
+// through - callers must track which regions they have written themselves
+// (the virtual memory swap file does this with its page map). The file is
+// reserved as one contiguous run of clusters if the card has one that is
+// long enough, otherwise it is allocated in pieces. extent (optional)
+// reports which.
+bool sdCreateSparseFile(const char* path, uint32_t size, SdExtent* extent = nullptr);
+
+// Describe an existing file (walks its cluster chain)
+bool sdGetFileExtent(const char* path, SdExtent* extent);
 
 // List directory contents
 // Callback receives filename (not full path), isDirectory flag
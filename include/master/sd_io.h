@@ -0,0 +1,91 @@
+#ifndef SD_IO_H
+#define SD_IO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "master/sd_io_queue.h"
+
+// Asynchronous SD access through the SD I/O task
+//
+// Submitting copies the request into a priority queue (see sd_io_queue.h)
+// inside a short critical section and returns - a task that must never
+// block on the card, like the pump task, only ever submits. The SD I/O task
+// runs requests most important class first, merges small appends and
+// contiguous writes to the same file, and reports completion through an
+// optional callback (run on the SD I/O task) or a future.
+//
+// Call from tasks only, not from interrupts. A full queue rejects the
+// request (counted per class); SD_IO_SAFETY_RESERVE slots are kept for
+// safety logs.
+
+// Create the queue (once, before any task submits)
+bool sdIoInit();
+
+// SD I/O task body: wait up to waitMs for work, then run requests until
+// the queue is empty
+void sdIoProcess(uint32_t waitMs);
+
+// =============================================================================
+// Requests
+// =============================================================================
+// Data of up to SD_IO_INLINE_BYTES is copied; larger buffers (and read
+// buffers) must stay valid until the request completes.
+
+bool sdIoAppend(const char* path, const void* data, size_t length, SdIoPriority priority,
+                SdIoCallback callback = nullptr, void* context = nullptr);
+bool sdIoAppendString(const char* path, const char* text, SdIoPriority priority);
+bool sdIoWriteAt(const char* path, uint32_t offset, const void* data, size_t length,
+                 SdIoPriority priority, SdIoCallback callback = nullptr, void* context = nullptr);
+bool sdIoReadAt(const char* path, uint32_t offset, void* buffer, size_t length,
+                SdIoPriority priority, SdIoCallback callback = nullptr, void* context = nullptr);
+
+// Flush buffered writes of path, or of every open file if path is nullptr
+bool sdIoSync(const char* path, SdIoPriority priority,
+              SdIoCallback callback = nullptr, void* context = nullptr);
+
+// =============================================================================
+// Futures
+// =============================================================================
+// SdIoFuture future;
+// sdIoFutureInit(&future);
+// sdIoReadAt(path, 0, buffer, length, SD_IO_BULK, sdIoComplete, &future);
+// int32_t n = sdIoWait(&future, 100);
+//
+// A future that timed out must stay in scope until the request completes.
+//
+// Completion wakes the waiter with xTaskNotifyGive() and sdIoWait() clears
+// its whole notification value, so a task that takes notification bits for
+// itself (the CAN RX task) must not wait on futures or call the *Wait
+// functions below - it submits with a callback instead.
+
+typedef struct {
+    volatile bool done;
+    int32_t result;
+    TaskHandle_t waiter;
+} SdIoFuture;
+
+void sdIoFutureInit(SdIoFuture* future);
+
+// Callback completing the future passed as context
+void sdIoComplete(int32_t result, void* future);
+
+// Result of the request, or -1 if it did not complete within timeoutMs
+int32_t sdIoWait(SdIoFuture* future, uint32_t timeoutMs);
+
+// Submit and wait for completion, retrying while the queue is full.
+// Run directly when the SD I/O task is not running yet or is the caller.
+int32_t sdIoReadAtWait(const char* path, uint32_t offset, void* buffer, size_t length,
+                       SdIoPriority priority);
+int32_t sdIoWriteAtWait(const char* path, uint32_t offset, const void* data, size_t length,
+                        SdIoPriority priority);
+
+// =============================================================================
+// Statistics
+// =============================================================================
+
+void sdIoGetStats(SdIoStats* stats, uint32_t* pending);
+void sdIoPrintStats();
+
+#endif // SD_IO_H
@@ -0,0 +1,170 @@
+#ifndef SD_IO_QUEUE_H
+#define SD_IO_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "master/sd_file_cache.h"
+
+// Priority request queue for the SD I/O task
+//
+// Requests wait in one FIFO per priority class and are handed out most
+// important class first. Two rules keep the card contents the same as if
+// every request had run in submission order:
+//
+//  - A request is never passed by a later one for the same file: when a
+//    more important request arrives, the queued requests for its file move
+//    up to its class first (promotion).
+//  - Merging only folds a request into the last queued request for the
+//    same file, when it continues it (appends, or a write starting where
+//    the queued one ends) and the data fits the request's inline buffer.
+//
+// Requests of up to SD_IO_INLINE_BYTES are copied at submit; larger
+// buffers are used in place and must stay valid until completion. Only
+// requests without a callback are merged, so every callback reports
+// exactly its own request.
+//
+// Not thread-safe - sd_io wraps every call in a critical section.
+
+// =============================================================================
+// Configuration
+// =============================================================================
+
+#define SD_IO_QUEUE_MAX         16          // Slots available to init()
+#define SD_IO_INLINE_BYTES      256         // Data copied into the request
+
+// =============================================================================
+// Requests
+// =============================================================================
+
+// Most important first
+typedef enum {
+    SD_IO_SAFETY,       // Failsafe and crash logs, synced as soon as written
+    SD_IO_TELEMETRY,    // Periodic data logging
+    SD_IO_VMEM,         // Virtual memory swap traffic
+    SD_IO_BULK,         // Copies, exports, anything that can wait
+    SD_IO_PRIORITIES
+} SdIoPriority;
+
+typedef enum {
+    SD_IO_APPEND,
+    SD_IO_WRITE_AT,
+    SD_IO_READ_AT,
+    SD_IO_SYNC          // path nullptr = every open file
+} SdIoOp;
+
+// Bytes moved (0 for a sync) or -1 on error. Runs on the SD I/O task.
+typedef void (*SdIoCallback)(int32_t result, void* context);
+
+typedef struct {
+    SdIoOp op;
+    SdIoPriority priority;
+    const char* path;
+    uint32_t offset;            // WRITE_AT, READ_AT
+    const uint8_t* data;        // APPEND, WRITE_AT
+    uint8_t* buffer;            // READ_AT
+    uint32_t length;
+    SdIoCallback callback;      // Optional
+    void* context;
+} SdIoRequest;
+
+// A queued request, handed to the executor by take()
+typedef struct {
+    SdIoOp op;
+    uint8_t priority;           // Current class (after promotion)
+    uint8_t origin;             // Class it was submitted in
+    bool queued;                // In a priority list (false while running)
+    bool allFiles;              // Sync without a path
+    int16_t next;               // Next slot in the same list
+    char path[SD_FILE_PATH_MAX];
+    uint32_t offset;
+    uint32_t length;            // Including merged requests
+    uint32_t ownLength;         // Reported to the callback
+    const uint8_t* data;        // inlineData or the caller's buffer
+    uint8_t* buffer;
+    SdIoCallback callback;
+    void* context;
+    uint32_t sequence;          // Submission order
+    uint32_t submitUs;
+
+    // Merged requests, per class, for the wait statistics
+    uint16_t riders[SD_IO_PRIORITIES];
+    uint32_t riderFirstUs[SD_IO_PRIORITIES];
+    uint64_t riderSubmitUs[SD_IO_PRIORITIES];
+
+    uint8_t inlineData[SD_IO_INLINE_BYTES];
+} SdIoJob;
+
+// Callback to run once the queue lock is released
+typedef struct {
+    SdIoCallback callback;
+    void* context;
+    int32_t result;
+} SdIoCompletion;
+
+// =============================================================================
+// Statistics
+// =============================================================================
+
+typedef struct {
+    uint32_t submitted;
+    uint32_t merged;        // Folded into an earlier request
+    uint32_t promoted;      // Moved up behind a more important request
+    uint32_t rejected;      // Queue full, path too long
+    uint32_t operations;    // Card operations run for this class
+    uint32_t completed;     // Requests finished, merged ones included
+    uint32_t failed;
+    uint64_t totalWaitUs;   // Submit to completion, merged requests included
+    uint32_t maxWaitUs;
+} SdIoClassStats;
+
+typedef struct {
+    SdIoClassStats classes[SD_IO_PRIORITIES];
+    uint32_t highWater;     // Most slots in use at once
+} SdIoStats;
+
+// =============================================================================
+// SdIoQueue Class
+// =============================================================================
+
+class SdIoQueue {
+public:
+    SdIoQueue();
+
+    // depth slots (at most SD_IO_QUEUE_MAX), the last safetyReserve of
+    // them only for SD_IO_SAFETY requests
+    void init(uint32_t depth, uint32_t safetyReserve, bool merging);
+
+    // Queue or merge a request. False if it was rejected.
+    bool submit(const SdIoRequest& request, uint32_t nowUs);
+
+    // Most important queued request, or nullptr. The job belongs to the
+    // caller until finish().
+    SdIoJob* take();
+
+    // Record the result of a taken job and free its slot. The completion
+    // is filled in for the caller to run after unlocking.
+    void finish(SdIoJob* job, int32_t result, uint32_t nowUs, SdIoCompletion* completion);
+
+    uint32_t pending() const { return _used; }
+    const SdIoStats& stats() const { return _stats; }
+    void resetStats();
+
+private:
+    SdIoJob _jobs[SD_IO_QUEUE_MAX];
+    int16_t _head[SD_IO_PRIORITIES];
+    int16_t _tail[SD_IO_PRIORITIES];
+    int16_t _free;
+    uint32_t _depth;
+    uint32_t _reserve;
+    uint32_t _used;
+    uint32_t _sequence;
+    bool _merging;
+    SdIoStats _stats;
+
+    void append(uint8_t priority, int16_t index);
+    void unlink(uint8_t priority, int16_t index, int16_t previous);
+    void promote(const char* path, uint8_t priority);
+    bool merge(const SdIoRequest& request, uint32_t nowUs);
+};
+
+#endif // SD_IO_QUEUE_H
@@ -26,6 +26,11 @@ bool spiOtaExchange(const uint8_t* txBuffer, uint8_t* rxBuffer, size_t len);
 // Bulk data exchange for OTA (larger packets)
 bool spiOtaExchangeBulk(const uint8_t* txBuffer, uint8_t* rxBuffer, size_t len);
 
+// Send a CAN statistics packet (packCanStatsPacket() in protocol.h) in
+// place of the state packet; the slave's UI requests come back as usual.
+// Returns true if a valid response was received.
+bool spiSendCanStats(const uint8_t* packet, uint8_t* requestedMode, uint16_t* requestedRpm);
+
 // Get statistics
 uint32_t spiGetSuccessCount();
 uint32_t spiGetErrorCount();
@@ -0,0 +1,47 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include "master/telemetry_log.h"
+
+// Binary telemetry recorder
+//
+// The recorder task samples the master state (target and input RPM,
+// vehicle speed, water temperature, PWM duty, steering level, health and
+// modes) at up to TELEMETRY_MAX_RATE_HZ into TelemetryRecords, fills chunk
+// buffers in PSRAM and hands full chunks to the SD I/O task at telemetry
+// priority (format in telemetry_log.h). It reads the shared state without
+// taking stateMutex and never waits on the card, so it cannot hold up the
+// pump task; when the card falls behind, every buffer ends up waiting and
+// samples are dropped and counted instead.
+//
+// Files rotate every TELEMETRY_FILE_MB, the newest TELEMETRY_FILES are kept.
+// Chunks are sized to fill within TELEMETRY_CHUNK_MS at the running rate
+// (up to TELEMETRY_CHUNK_KB), which bounds how much a power loss costs.
+
+#define TELEMETRY_DIR   "/tlm"
+
+typedef struct {
+    uint16_t rateHz;            // 0 = stopped
+    uint32_t samples;           // Taken since start (stored + dropped)
+    uint32_t overruns;          // Sample periods missed entirely
+    uint32_t writeErrors;       // Chunks the card failed to take
+    uint32_t maxSampleUs;       // Longest sample + encode
+    TelemetryWriterStats writer;
+} TelemetryStats;
+
+// Allocate the chunk buffers (once, before the recorder task starts)
+bool telemetryInit();
+
+// Recorder task body: one sample period while recording, otherwise an idle wait
+void telemetryProcess();
+
+// Start recording at rateHz into a new file, or stop (0). A running
+// recorder changing rate starts a new file. Returns false for a rate above
+// TELEMETRY_MAX_RATE_HZ.
+bool telemetrySetRate(uint16_t rateHz);
+
+void telemetryGetStats(TelemetryStats* stats);
+void telemetryPrintStats();
+
+#endif // TELEMETRY_H
@@ -0,0 +1,193 @@
+#ifndef TELEMETRY_LOG_H
+#define TELEMETRY_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Binary telemetry log format and chunk writer
+//
+// A log is a series of files /tlm/NNNNN.bin. Each file is one header block
+// followed by fixed-size chunks, so chunk k starts at
+// TELEMETRY_FILE_HEADER_BYTES + k * chunkBytes and a reader can seek to any
+// chunk (or binary search them by time) without scanning:
+//
+//   [file header, 512 B][chunk 0][chunk 1]...[chunk n-1]
+//   chunk = [chunk header, 32 B][recordCount records][zero padding]
+//
+// Every header carries its own CRC, and each chunk header the CRC of its
+// records. A file cut short by a power loss is still readable up to its
+// last complete chunk.
+//
+// TelemetryWriter fills chunk buffers supplied by the caller and hands out
+// sealed chunks ready to write. Buffers come back with release() once
+// written; while none is free, records are dropped and counted. Not
+// thread-safe - telemetry.cpp only calls it from the recorder task.
+
+// =============================================================================
+// Format
+// =============================================================================
+
+#define TELEMETRY_FILE_MAGIC        0x314D4C54  // "TLM1"
+#define TELEMETRY_CHUNK_MAGIC       0x434D4C54  // "TLMC"
+#define TELEMETRY_FORMAT_VERSION    1
+#define TELEMETRY_FILE_HEADER_BYTES 512         // Chunks start sector aligned
+#define TELEMETRY_FIRMWARE_MAX      24
+
+// modes
+#define TELEMETRY_MODE_DISPLAY_MASK 0x0F        // MODE_AUTO / MODE_MANUAL
+#define TELEMETRY_MODE_OP_SHIFT     4           // OperatingMode in the high nibble
+
+// flags
+#define TELEMETRY_FLAG_RPM_INPUT    0x01        // RPM pulse counter enabled
+#define TELEMETRY_FLAG_VSS_INPUT    0x02        // VSS pulse counter enabled
+#define TELEMETRY_FLAG_WATER_INPUT  0x04        // Water temp sensor enabled (else simulated)
+#define TELEMETRY_FLAG_ENCODER      0x08        // Encoder MUX present
+
+// One sample of the master state
+typedef struct __attribute__((packed)) {
+    uint32_t timeUs;            // Low 32 bits of the sample time (see chunk firstTimeUs)
+    uint32_t sequence;          // Sample number since the recorder started, gaps are drops
+    uint16_t targetRpm;         // RPM driving the pump (CAN, simulation or manual)
+    uint16_t manualRpm;
+    uint16_t inputRpm;          // RPM pulse input, 0 when disabled
+    uint16_t speedKph10;        // Vehicle speed input, km/h * 10
+    int16_t waterTempF10;       // WATER_TEMP_INVALID without a reading
+    uint8_t waterStatus;        // WATER_TEMP_STATUS_*
+    uint8_t pwmDuty;
+    uint8_t steeringLevel;      // Power steering assist, percent
+    uint8_t health;             // SystemHealth
+    uint8_t modes;              // displayMode | opMode << TELEMETRY_MODE_OP_SHIFT
+    uint8_t flags;              // TELEMETRY_FLAG_*
+} TelemetryRecord;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerBytes;       // TELEMETRY_FILE_HEADER_BYTES
+    uint16_t recordBytes;       // sizeof(TelemetryRecord)
+    uint16_t sampleRateHz;      // Configured rate when the file was started
+    uint32_t chunkBytes;        // Chunk stride, header included
+    uint32_t chunkRecords;      // Records a chunk can hold
+    uint32_t fileIndex;         // NNNNN of the file name
+    uint64_t startTimeUs;       // Time of its first record
+    uint32_t firstSequence;
+    char firmware[TELEMETRY_FIRMWARE_MAX];
+    uint32_t crc;               // Of the bytes above
+} TelemetryFileHeader;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t chunkIndex;        // Position in the file
+    uint32_t firstSequence;
+    uint16_t recordCount;       // Fewer than chunkRecords only for the last chunk written
+    uint16_t reserved;
+    uint64_t firstTimeUs;       // Full time of the first record
+    uint32_t dataCrc;           // Of the recordCount records
+    uint32_t crc;               // Of the bytes above
+} TelemetryChunkHeader;
+
+static_assert(sizeof(TelemetryRecord) == 24, "TelemetryRecord layout is part of the file format");
+static_assert(sizeof(TelemetryFileHeader) == 64, "TelemetryFileHeader layout is part of the file format");
+static_assert(sizeof(TelemetryChunkHeader) == 32, "TelemetryChunkHeader layout is part of the file format");
+
+// Records a chunk of chunkBytes can hold
+inline uint32_t telemetryChunkRecords(uint32_t chunkBytes) {
+    return (chunkBytes - sizeof(TelemetryChunkHeader)) / sizeof(TelemetryRecord);
+}
+
+// Where a sealed chunk goes in its file
+inline uint32_t telemetryChunkOffset(uint32_t chunkIndex, uint32_t chunkBytes) {
+    return chunkIndex == 0 ? 0 : TELEMETRY_FILE_HEADER_BYTES + chunkIndex * chunkBytes;
+}
+
+// CRC-32 of a header, excluding its trailing crc field
+uint32_t telemetryHeaderCrc(const void* header, size_t size);
+
+// Check magic and CRCs; data points just past the chunk header
+bool telemetryFileHeaderValid(const TelemetryFileHeader* header);
+bool telemetryChunkValid(const TelemetryChunkHeader* header, const uint8_t* data,
+                         uint32_t chunkRecords);
+
+// =============================================================================
+// Writer
+// =============================================================================
+
+#define TELEMETRY_MAX_BUFFERS   8
+
+// Each buffer needs room for a file header in front of the chunk
+#define TELEMETRY_BUFFER_BYTES(chunkBytes) (TELEMETRY_FILE_HEADER_BYTES + (chunkBytes))
+
+// A sealed chunk: write length bytes from data to file fileIndex at
+// telemetryChunkOffset() (data includes the file header when chunkIndex is 0)
+typedef struct {
+    const uint8_t* data;
+    uint32_t length;
+    uint32_t fileIndex;
+    uint32_t chunkIndex;
+    uint8_t buffer;             // Pass back to release()
+} TelemetryChunk;
+
+typedef struct {
+    uint32_t records;           // Stored
+    uint32_t dropped;           // No free buffer
+    uint32_t chunks;            // Sealed
+    uint32_t files;             // Started
+    uint64_t bytes;             // Sealed, headers and padding included
+    uint32_t buffersInUse;      // Filling or waiting to be written
+    uint32_t maxBuffersInUse;
+} TelemetryWriterStats;
+
+class TelemetryWriter {
+public:
+    TelemetryWriter();
+
+    // buffers: count areas of TELEMETRY_BUFFER_BYTES(chunkBytes) each.
+    // Files hold fileChunks chunks; the first one started is firstFile.
+    bool init(uint8_t* const* buffers, uint32_t count, uint32_t chunkBytes,
+              uint32_t fileChunks, uint32_t firstFile, uint16_t sampleRateHz,
+              const char* firmware);
+
+    // Store a record taken at timeUs. Returns true and fills chunk when the
+    // record completed one. A record dropped for lack of a buffer is counted.
+    bool add(const TelemetryRecord& record, uint64_t timeUs, TelemetryChunk* chunk);
+
+    // Seal the partly filled chunk, if any (padded to full size)
+    bool flush(TelemetryChunk* chunk);
+
+    // Close the current file: the next chunk started goes to a new one
+    // (flush() first, or the partly filled chunk still ends the old file)
+    void endFile();
+
+    // Buffer of a chunk that has been written (or failed to be)
+    void release(uint8_t buffer);
+
+    uint32_t chunkBytes() const { return _chunkBytes; }
+    uint32_t chunkRecords() const { return _chunkRecords; }
+    uint32_t currentFile() const { return _fileIndex; }
+    const TelemetryWriterStats& stats() const { return _stats; }
+
+private:
+    bool acquire(const TelemetryRecord& record, uint64_t timeUs);
+    void seal(TelemetryChunk* chunk);
+
+    uint8_t* _buffers[TELEMETRY_MAX_BUFFERS];
+    bool _busy[TELEMETRY_MAX_BUFFERS];
+    uint32_t _count;
+    uint32_t _chunkBytes;
+    uint32_t _chunkRecords;
+    uint32_t _fileChunks;
+    uint16_t _sampleRateHz;
+    char _firmware[TELEMETRY_FIRMWARE_MAX];
+
+    int32_t _current;           // Buffer being filled, -1 if none
+    bool _withHeader;           // Current buffer starts a file
+    TelemetryChunkHeader _header;
+    uint32_t _crc;              // CRC register over the current chunk's records
+    uint32_t _fileIndex;
+    uint32_t _nextChunk;        // chunkIndex of the next chunk started
+    bool _fileOpen;
+
+    TelemetryWriterStats _stats;
+};
+
+#endif // TELEMETRY_LOG_H
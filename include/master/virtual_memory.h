@@ -1,15 +1,29 @@
 #ifndef VIRTUAL_MEMORY_H
 #define VIRTUAL_MEMORY_H
 
-#include <Arduino.h>
 #include <stdint.h>
 #include <stddef.h>
 #include "shared/config.h"
+#include "master/vmem_backend.h"
+#include "master/vmem_tier.h"
+#include "master/vmem_journal.h"
+#include "master/vmem_policy.h"
 
 #if VIRTUAL_MEMORY
 
 // Virtual memory system using SD card as backing store with PSRAM cache
 // Provides 16MB+ memory buffers for large data processing
+//
+// Thread safety: read/write/zero/map/unmap/flush/prefetch may be called
+// from any task. The page table is split into VMEM_LOCK_STRIPES ranges,
+// each with its own lock, and slot replacement has a separate lock, so
+// page faults on pages in different ranges run concurrently and hits only
+// take their range lock. init()/shutdown()/setBackend() must not race with
+// other calls. Memory returned by map() is not locked - tasks sharing a
+// mapped range must coordinate themselves.
+//
+// The page replacement policy is a template parameter (see vmem_policy.h);
+// VirtualMemory is the instance selected by VIRTUAL_MEMORY_POLICY.
 
 // =============================================================================
 // Configuration (derived from config.h)
@@ -20,22 +34,110 @@
 #define VMEM_CACHE_SIZE     (VIRTUAL_MEMORY_CACHE_MB * 1024UL * 1024UL)
 #define VMEM_MAX_PAGES      (VMEM_CACHE_SIZE / VMEM_PAGE_SIZE)
 #define VMEM_TOTAL_PAGES    (VMEM_TOTAL_SIZE / VMEM_PAGE_SIZE)
+#define VMEM_TIER_SIZE      (VIRTUAL_MEMORY_TIER_KB * 1024UL)
+
+#define VMEM_SHARD_SIZE     (VIRTUAL_MEMORY_SHARD_MB * 1024UL * 1024UL)
+#define VMEM_JOURNAL_SIZE   (VIRTUAL_MEMORY_JOURNAL_KB * 1024UL)
+
+// Dirty tracking granularity (one SD card sector)
+#define VMEM_SECTOR_SIZE        512
+#define VMEM_SECTORS_PER_PAGE   (VMEM_PAGE_SIZE / VMEM_SECTOR_SIZE)
+
+// Runtime page sizes accepted by init() (VMEM_MAX_PAGE_SIZE in vmem_tier.h)
+#define VMEM_MIN_PAGE_SIZE      VMEM_SECTOR_SIZE
+#define VMEM_DIRTY_WORDS        VMEM_TIER_DIRTY_WORDS
+
+static_assert((VMEM_PAGE_SIZE & (VMEM_PAGE_SIZE - 1)) == 0 &&
+              VMEM_PAGE_SIZE >= VMEM_MIN_PAGE_SIZE && VMEM_PAGE_SIZE <= VMEM_MAX_PAGE_SIZE,
+              "VIRTUAL_MEMORY_PAGE_SIZE must be a power of two between 512 and VMEM_MAX_PAGE_SIZE");
+
+// Two-level page table: leaves of up to 2^VMEM_PT_LEAF_BITS 16-bit slot
+// numbers, allocated while any page in their range is cached
+#ifndef VMEM_PT_LEAF_BITS
+#define VMEM_PT_LEAF_BITS   6
+#endif
+#define VMEM_PT_NONE        0xFFFF      // Not cached (also caps the slot count)
 
 // Swap file path on SD card
 #define VMEM_SWAP_FILE      "/vmem_swap.bin"
 
+// Swap shard paths when the swap is split (printf format, shard number)
+#define VMEM_SWAP_SHARD_FORMAT  "/vmem_swap.%03lu.bin"
+
+// Materialised page bitmap (pages never written back read as zeros)
+#define VMEM_SWAP_MAP_FILE  "/vmem_swap.map"
+
+// Durable mode: page checksum table and write-ahead journal
+#define VMEM_SWAP_META_FILE     "/vmem_swap.meta"
+#define VMEM_SWAP_JOURNAL_FILE  "/vmem_swap.jnl"
+
+// Page table lock stripes (contiguous page ranges, one lock each)
+#ifndef VMEM_LOCK_STRIPES
+#define VMEM_LOCK_STRIPES   16
+#endif
+
+// Tasks with their own statistics block (later tasks share the last one)
+#ifndef VMEM_MAX_TASK_STATS
+#define VMEM_MAX_TASK_STATS 8
+#endif
+
+// Access trace callback (see setTraceHook) - used to record real access
+// patterns for replay in tools/vmem-bench
+typedef void (*VMemTraceHook)(uint32_t vaddr, uint32_t length, bool isWrite, void* userData);
+
+// =============================================================================
+// Geometry
+// =============================================================================
+// Runtime layout passed to init(). VMEM_PAGE_SIZE only sets the default;
+// VArray element layout (vmem_array.h) keeps using compile-time blocks of
+// that size, which stay correct with any runtime page size.
+
+typedef struct {
+    uint32_t totalSize;     // Virtual address space (multiple of pageSize)
+    uint32_t pageSize;      // Power of two, VMEM_MIN_PAGE_SIZE..VMEM_MAX_PAGE_SIZE
+    uint32_t cacheSize;     // Page cache (below VMEM_PT_NONE pages)
+    uint32_t tierSize;      // Compressed tier, 0 to disable
+    uint32_t shardSize;     // Swap file shard size (multiple of pageSize), 0 = one file
+    uint32_t journalSize;   // Durable mode write-ahead journal, 0 to disable
+} VMemGeometry;
+
+// Geometry from config.h
+inline VMemGeometry vmemDefaultGeometry() {
+    VMemGeometry geometry;
+    geometry.totalSize = VMEM_TOTAL_SIZE;
+    geometry.pageSize = VMEM_PAGE_SIZE;
+    geometry.cacheSize = VMEM_CACHE_SIZE;
+    geometry.tierSize = VMEM_TIER_SIZE;
+    geometry.shardSize = VMEM_SHARD_SIZE;
+    geometry.journalSize = VMEM_JOURNAL_SIZE;
+    return geometry;
+}
+
 // =============================================================================
 // Page Descriptor
 // =============================================================================
+// virtualPage/valid/reserved change only with both the replacement lock and
+// the page's stripe lock held; the remaining fields belong to the stripe.
 
 typedef struct {
     uint32_t virtualPage;   // Virtual page number (0xFFFFFFFF = unused)
     uint8_t* cachePtr;      // Pointer to PSRAM cache location
-    uint32_t lastAccess;    // Timestamp for LRU eviction
+    uint16_t pinCount;      // Active map() references (pinned pages are never evicted)
     bool dirty;             // Needs write-back before eviction
+    uint32_t dirtySectors[VMEM_DIRTY_WORDS];  // Modified 512-byte sectors (bit per sector)
     bool valid;             // Page contains valid data
+    bool reserved;          // Claimed by a page fault in progress
 } VMemPage;
 
+// =============================================================================
+// Mapping Modes
+// =============================================================================
+
+typedef enum {
+    VMEM_MAP_READ,          // Read-only access, page stays clean
+    VMEM_MAP_WRITE          // Read/write access, page marked dirty on unmap
+} VMemMapMode;
+
 // =============================================================================
 // Statistics
 // =============================================================================
@@ -43,27 +145,63 @@ typedef struct {
 typedef struct {
     uint32_t hits;          // Cache hits
     uint32_t misses;        // Cache misses (page faults)
+    uint32_t zeroFills;     // Misses on never-written pages (served without SD read)
     uint32_t evictions;     // Pages evicted from cache
     uint32_t writebacks;    // Dirty pages written to SD
+    uint32_t writeRuns;     // Contiguous dirty sector runs written to SD
     uint32_t bytesRead;     // Total bytes read from SD
     uint32_t bytesWritten;  // Total bytes written to SD
+    uint32_t bytesSaved;    // Clean sectors skipped by write-back (vs whole pages)
     uint32_t pagesLoaded;   // Currently loaded pages
     uint32_t maxPages;      // Maximum pages that fit in cache
+    uint32_t pinnedPages;   // Pages currently pinned by map()
+    uint32_t relocations;   // Pages moved between slots to build contiguous maps
+    uint32_t tierHits;      // Misses served from the compressed tier
+    uint32_t tierMisses;    // Misses not found in the tier (read from SD or zero-filled)
+    uint32_t tierStores;    // Evicted pages compressed into the tier
+    uint32_t tierRejects;   // Evicted pages that did not compress well enough
+    uint32_t tierEvictions; // Pages pushed out of the tier to make room
+    uint32_t tierPages;     // Pages currently in the tier
+    uint32_t tierBytes;     // Compressed bytes currently in the tier
+    uint32_t ghostHits;     // Misses on pages the policy remembered evicting (2Q, ARC)
+    uint32_t journalRecords; // Write-backs logged to the journal (durable mode)
+    uint32_t journalBytes;   // Bytes appended to the journal
+    uint32_t checkpoints;    // Journal checkpoints (checksum table saved, journal emptied)
+    uint32_t checksumErrors; // Pages read from SD that failed their checksum
 } VMemStats;
 
+// Counters of one task (pagesLoaded/maxPages/pinnedPages/tierPages/tierBytes
+// are not per task)
+typedef struct {
+    uintptr_t taskId;       // 0 = unused entry
+    char name[16];
+    VMemStats stats;
+} VMemTaskStats;
+
 // =============================================================================
 // VirtualMemory Class
 // =============================================================================
 
-class VirtualMemory {
+template <class Policy>
+class VirtualMemoryT {
 public:
-    VirtualMemory();
-    ~VirtualMemory();
+    VirtualMemoryT();
+    ~VirtualMemoryT();
 
-    // Initialize virtual memory system
-    // totalSize: total virtual address space (default from config)
+    // Select backing store and cache allocator (call before init)
+    // Device builds default to the SD swap file and PSRAM
+    void setBackend(VMemStorage* storage, VMemAllocator* allocator);
+
+    // Initialize virtual memory system with the given layout
     // Returns true on success
-    bool init(uint32_t totalSize = VMEM_TOTAL_SIZE);
+    bool init(const VMemGeometry& geometry);
+
+    // Initialize with the configured page and shard size
+    // totalSize: total virtual address space (default from config)
+    // cacheSize: page cache size (default from config)
+    // tierSize: compressed tier behind the cache, 0 to disable (default from config)
+    bool init(uint32_t totalSize = VMEM_TOTAL_SIZE, uint32_t cacheSize = VMEM_CACHE_SIZE,
+              uint32_t tierSize = VMEM_TIER_SIZE);
 
     // Shutdown and flush all dirty pages
     void shutdown();
@@ -90,8 +228,25 @@ public:
     int32_t write(uint32_t vaddr, const void* data, size_t length);
 
     // Zero-fill a range of virtual memory
+    // Whole pages are dropped from the page map instead of being written
     bool zero(uint32_t vaddr, size_t length);
 
+    // ==========================================================================
+    // Zero-Copy Mapping
+    // ==========================================================================
+
+    // Map a virtual range and return a pointer directly into the PSRAM cache
+    // The pages are pinned (never evicted) until the matching unmap() call.
+    // Ranges spanning several pages are placed in adjacent cache slots so the
+    // returned pointer covers the whole range; this may move or evict other
+    // unpinned pages. Returns nullptr if the range cannot be mapped.
+    void* map(uint32_t vaddr, size_t length, VMemMapMode mode);
+
+    // Release a mapping created by map() (same vaddr, length and mode)
+    // VMEM_MAP_WRITE marks the sectors covered by the range dirty so they
+    // are written back later
+    bool unmap(uint32_t vaddr, size_t length, VMemMapMode mode);
+
     // ==========================================================================
     // Cache Control
     // ==========================================================================
@@ -112,8 +267,11 @@ public:
     // Statistics
     // ==========================================================================
 
-    // Get current statistics
-    VMemStats getStats() const { return _stats; }
+    // Get current statistics (summed over all tasks)
+    VMemStats getStats() const;
+
+    // Copy per-task statistics, returns number of entries written
+    uint32_t getTaskStats(VMemTaskStats* out, uint32_t maxEntries) const;
 
     // Reset statistics counters
     void resetStats();
@@ -124,14 +282,30 @@ public:
     // Print statistics to Serial
     void printStats();
 
+    // Report every read/write/zero/map call (nullptr to disable)
+    // The hook runs in the calling task and must be thread-safe
+    void setTraceHook(VMemTraceHook hook, void* userData = nullptr);
+
     // ==========================================================================
     // Configuration Getters
     // ==========================================================================
 
     uint32_t getTotalSize() const { return _totalSize; }
-    uint32_t getPageSize() const { return VMEM_PAGE_SIZE; }
+    uint32_t getPageSize() const { return _pageSize; }
+    uint32_t getShardSize() const { return _shardSize; }
     uint32_t getCacheSize() const { return _cacheSize; }
     uint32_t getMaxCachePages() const { return _maxCachePages; }
+    uint32_t getTierSize() const { return _tier.capacity(); }
+    const char* getPolicyName() const { return Policy::name(); }
+    const Policy& getPolicy() const { return _policy; }
+
+    // Bytes used by the page table (directory, allocated leaves and the
+    // policy's ghost map)
+    uint32_t getPageTableBytes() const;
+
+    // Durable mode (journalSize > 0) and the journal replay done by init()
+    bool isDurable() const { return _journal.isEnabled(); }
+    const VMemRecovery& getRecovery() const { return _journal.recovery(); }
 
 private:
     bool _initialized;
@@ -139,10 +313,48 @@ private:
     uint32_t _cacheSize;
     uint32_t _maxCachePages;
     uint32_t _totalPages;
-
-    // Page table (all possible virtual pages)
-    // Maps virtual page number to cache slot (-1 if not cached)
-    int32_t* _pageTable;
+    uint32_t _pageSize;
+    uint32_t _pageShift;
+    uint32_t _sectorsPerPage;
+    uint32_t _shardSize;
+
+    // Page table: directory of leaves mapping virtual page number to cache
+    // slot (VMEM_PT_NONE if not cached). A leaf covers (1 << _leafShift)
+    // pages inside one stripe, followed by its count of cached pages, and
+    // is freed when that drops to zero - RAM follows the cache size, not
+    // the virtual space.
+    uint16_t** _pageDir;
+    uint32_t _pageDirSize;
+    uint32_t _pageLeaves;
+    uint32_t _leafShift;
+
+    // Stripe locks guard page table ranges of (1 << _stripeShift) pages;
+    // the replacement lock guards slot ownership. Order: one stripe, then
+    // replacement. Further stripes are only try-locked (by eviction, and by
+    // lockAll() which backs off and retries).
+    VMemLock _stripeLocks[VMEM_LOCK_STRIPES];
+    VMemLock _replacementLock;
+    uint32_t _stripeShift;
+
+    // Materialised pages (bit set once a page has been written to swap)
+    // Persisted next to the swap file by flush() and shutdown()
+    uint8_t* _pageMap;
+    uint8_t* _pageMapCopy;  // Snapshot written to storage
+    bool _pageMapDirty;
+    VMemLock _pageMapLock;  // Serialises savePageMap()
+
+    // Compressed tier for evicted pages. Lock order: stripe, replacement,
+    // tier. Tier write-back touches storage and the page map only.
+    VMemTier _tier;
+    mutable VMemLock _tierLock;
+
+    // Durable mode journal. Lock order: after stripe/replacement/tier,
+    // before the page map lock; held from journal append to commit.
+    VMemJournal _journal;
+    VMemLock _journalLock;
+
+    // Replacement policy (touched on hits, consulted by claimSlot())
+    Policy _policy;
 
     // Cache slots
     VMemPage* _cacheSlots;
@@ -150,18 +362,68 @@ private:
     // PSRAM cache buffer
     uint8_t* _cacheBuffer;
 
-    // Statistics
-    VMemStats _stats;
+    // Backing store and cache allocator
+    VMemStorage* _storage;
+    VMemAllocator* _allocator;
+
+    // Statistics (entries claimed under _statsLock, counters updated atomically)
+    VMemTaskStats _taskStats[VMEM_MAX_TASK_STATS];
+    VMemLock _statsLock;
+    uint32_t _pagesLoaded;
+    uint32_t _pinnedPages;
+
+    // Access tracing
+    VMemTraceHook _traceHook;
+    void* _traceUserData;
 
     // Internal helpers
     int32_t findCacheSlot(uint32_t virtualPage);
-    int32_t loadPage(uint32_t virtualPage);
-    int32_t evictPage();
+    bool allocLeaf(uint32_t virtualPage);
+    void releaseLeaf(uint32_t virtualPage);
+    int32_t slotOf(uint32_t virtualPage);
+    void setSlotOf(uint32_t virtualPage, int32_t slot);
+    VMemLock& stripeLock(uint32_t virtualPage);
+    void lockAll();
+    void unlockAll();
+    VMemStats* taskStats();
+    int32_t claimSlot(uint32_t virtualPage);
+    static bool slotEvictable(uint32_t slot, void* context);
+    bool freeSlot(int32_t slot);
+    bool loadPageIntoSlot(uint32_t virtualPage, int32_t slot);
+    void moveSlot(int32_t from, int32_t to);
+    int32_t findFreeSlotOutside(int32_t start, uint32_t count);
+    int32_t findContiguousRun(uint32_t firstPage, uint32_t count);
+    int32_t mapContiguous(uint32_t firstPage, uint32_t count);
     bool writeBackPage(int32_t slot);
+    bool writeSectors(uint32_t virtualPage, const uint8_t* data, const uint32_t* dirtySectors);
+    bool writeRuns(uint32_t virtualPage, const uint8_t* data, const uint32_t* sectors);
+    bool journalWriteBack(uint32_t virtualPage, const uint8_t* data, const uint32_t* sectors);
+    bool checkpointJournal();
+    static void journalReplayed(uint32_t virtualPage, void* context);
+    bool demotePage(int32_t slot);
+    static bool tierWriteBack(uint32_t virtualPage, const uint8_t* page,
+                              const uint32_t* dirtySectors, void* context);
+    void markDirty(int32_t slot, uint32_t offset, size_t length);
+    void clearDirty(VMemPage& page);
+    bool isMaterialised(uint32_t virtualPage) const;
+    void setMaterialised(uint32_t virtualPage, bool materialised);
+    bool savePageMap();
+    void releaseBuffers();
     uint8_t* getPagePtr(uint32_t virtualPage);
     void touchPage(int32_t slot);
 };
 
+// Instances for every policy are compiled in virtual_memory.cpp
+#if VIRTUAL_MEMORY_POLICY == VMEM_POLICY_CLOCK
+typedef VirtualMemoryT<VMemClockPolicy> VirtualMemory;
+#elif VIRTUAL_MEMORY_POLICY == VMEM_POLICY_2Q
+typedef VirtualMemoryT<VMem2QPolicy> VirtualMemory;
+#elif VIRTUAL_MEMORY_POLICY == VMEM_POLICY_ARC
+typedef VirtualMemoryT<VMemArcPolicy> VirtualMemory;
+#else
+typedef VirtualMemoryT<VMemLruPolicy> VirtualMemory;
+#endif
+
 // Global instance (extern declaration)
 extern VirtualMemory vmem;
 
@@ -0,0 +1,453 @@
+#ifndef VMEM_ARRAY_H
+#define VMEM_ARRAY_H
+
+#include "master/virtual_memory.h"
+
+#if VIRTUAL_MEMORY
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <iterator>
+#include <type_traits>
+
+// Typed containers on top of VirtualMemory
+//
+// VArray<T> lays elements out page by page: each VMEM_PAGE_SIZE page holds
+// kElemsPerPage whole elements, so an element never straddles two pages and
+// any access touches exactly one page. Iterators map the current page once
+// and then walk it with plain pointer arithmetic, so the page lookup,
+// bounds checks and LRU update are paid once per page instead of once per
+// element.
+//
+// The layout uses the configured VMEM_PAGE_SIZE even if init() was given
+// another runtime page size: a block then spans several smaller pages
+// (mapped into adjacent slots) or shares one larger page, both correct.
+//
+// Example - 1M sensor samples in the swap file:
+//   VArray<Sample> history(0, 1024 * 1024);
+//   history.set(i, sample);
+//   for (const Sample& s : history.reader()) { ... }
+
+// =============================================================================
+// Page-Aware Iterator
+// =============================================================================
+
+template <typename T, VMemMapMode Mode>
+class VArrayIterator {
+public:
+    typedef typename std::conditional<Mode == VMEM_MAP_WRITE, T, const T>::type value_ref_type;
+
+    typedef T value_type;
+    typedef ptrdiff_t difference_type;
+    typedef value_ref_type* pointer;
+    typedef value_ref_type& reference;
+    typedef std::forward_iterator_tag iterator_category;
+
+    static constexpr size_t kElemsPerPage = VMEM_PAGE_SIZE / sizeof(T);
+
+    // failFlag, if given, is also set when a page cannot be mapped
+    VArrayIterator(VirtualMemory* vm, uint32_t baseAddr, size_t index, bool* failFlag = nullptr)
+        : _vm(vm), _baseAddr(baseAddr), _index(index)
+        , _ptr(nullptr), _pageEnd(nullptr), _mappedAddr(0)
+        , _failFlag(failFlag), _failed(false) {}
+
+    // Copies re-map lazily so every live iterator holds its own pin
+    VArrayIterator(const VArrayIterator& other)
+        : _vm(other._vm), _baseAddr(other._baseAddr), _index(other._index)
+        , _ptr(nullptr), _pageEnd(nullptr), _mappedAddr(0)
+        , _failFlag(other._failFlag), _failed(other._failed) {}
+
+    VArrayIterator& operator=(const VArrayIterator& other) {
+        if (this != &other) {
+            release();
+            _vm = other._vm;
+            _baseAddr = other._baseAddr;
+            _index = other._index;
+            _failFlag = other._failFlag;
+            _failed = other._failed;
+        }
+        return *this;
+    }
+
+    ~VArrayIterator() { release(); }
+
+    reference operator*() const {
+        if (!_ptr) acquire();
+        return *_ptr;
+    }
+
+    pointer operator->() const { return &operator*(); }
+
+    VArrayIterator& operator++() {
+        _index++;
+        if (_pageEnd) {
+            _ptr++;
+            if (_ptr == _pageEnd) release();  // Next page mapped on demand
+        } else {
+            _ptr = nullptr;                   // Scratch stand-in: try the next element's page
+        }
+        return *this;
+    }
+
+    VArrayIterator operator++(int) {
+        VArrayIterator tmp(*this);
+        ++(*this);
+        return tmp;
+    }
+
+    bool operator==(const VArrayIterator& other) const { return _index == other._index; }
+    bool operator!=(const VArrayIterator& other) const { return _index != other._index; }
+
+    size_t index() const { return _index; }
+
+    // A page could not be mapped: reads returned zeros, writes were lost
+    bool failed() const { return _failed; }
+
+private:
+    VirtualMemory* _vm;
+    uint32_t _baseAddr;
+    size_t _index;
+    mutable pointer _ptr;
+    mutable pointer _pageEnd;
+    mutable uint32_t _mappedAddr;
+    mutable T _scratch;  // Stand-in if the page cannot be mapped (cache fully pinned)
+    bool* _failFlag;
+    mutable bool _failed;
+
+    void acquire() const {
+        size_t pageIndex = _index / kElemsPerPage;
+        size_t slot = _index % kElemsPerPage;
+        uint32_t pageAddr = _baseAddr + (uint32_t)(pageIndex * VMEM_PAGE_SIZE);
+
+        T* page = (T*)_vm->map(pageAddr, kElemsPerPage * sizeof(T), Mode);
+        if (!page) {
+            memset((void*)&_scratch, 0, sizeof(T));
+            _ptr = &_scratch;
+            _failed = true;
+            if (_failFlag) *_failFlag = true;
+            _pageEnd = nullptr;
+            return;
+        }
+        _mappedAddr = pageAddr;
+        _ptr = page + slot;
+        _pageEnd = page + kElemsPerPage;
+    }
+
+    void release() const {
+        if (_pageEnd) {
+            _vm->unmap(_mappedAddr, kElemsPerPage * sizeof(T), Mode);
+        }
+        _ptr = nullptr;
+        _pageEnd = nullptr;
+    }
+};
+
+// =============================================================================
+// Iteration Range
+// =============================================================================
+// Range-for hides its iterators, so the range records whether any of them
+// failed to map a page:
+//   auto samples = history.writer();
+//   for (Sample& s : samples) { ... }
+//   if (samples.failed()) { ... }
+
+template <typename T, VMemMapMode Mode>
+class VArrayRange {
+public:
+    typedef VArrayIterator<T, Mode> iterator;
+
+    VArrayRange(VirtualMemory* vm, uint32_t baseAddr, size_t first, size_t last)
+        : _vm(vm), _baseAddr(baseAddr), _first(first), _last(last), _failed(false) {}
+
+    iterator begin() const { return iterator(_vm, _baseAddr, _first, &_failed); }
+    iterator end() const { return iterator(_vm, _baseAddr, _last, &_failed); }
+
+    bool failed() const { return _failed; }
+
+private:
+    VirtualMemory* _vm;
+    uint32_t _baseAddr;
+    size_t _first;
+    size_t _last;
+    mutable bool _failed;
+};
+
+// =============================================================================
+// VArray
+// =============================================================================
+
+template <typename T>
+class VArray {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "VArray elements are moved with memcpy and must be trivially copyable");
+    static_assert(sizeof(T) <= VMEM_PAGE_SIZE,
+                  "VArray element larger than a virtual memory page");
+    static_assert(VMEM_PAGE_SIZE % alignof(T) == 0,
+                  "VArray element alignment does not divide the page size");
+
+public:
+    static constexpr size_t kElemsPerPage = VMEM_PAGE_SIZE / sizeof(T);
+
+    typedef VArrayIterator<T, VMEM_MAP_READ> const_iterator;
+    typedef VArrayIterator<T, VMEM_MAP_WRITE> iterator;
+
+    // Bytes of virtual address space needed for count elements
+    static constexpr uint32_t bytesFor(size_t count) {
+        return (uint32_t)(((count + kElemsPerPage - 1) / kElemsPerPage) * VMEM_PAGE_SIZE);
+    }
+
+    // baseAddr must be page aligned; use endAddr() to place the next array
+    VArray(uint32_t baseAddr, size_t count, VirtualMemory& vm = vmem)
+        : _vm(&vm), _baseAddr(baseAddr), _count(count) {}
+
+    // Check placement against the current virtual memory geometry
+    bool isValid() const {
+        return _vm->isReady() &&
+               (_baseAddr % VMEM_PAGE_SIZE) == 0 &&
+               (uint64_t)_baseAddr + bytesFor(_count) <= _vm->getTotalSize();
+    }
+
+    size_t size() const { return _count; }
+    uint32_t baseAddr() const { return _baseAddr; }
+    uint32_t endAddr() const { return _baseAddr + bytesFor(_count); }
+
+    // ==========================================================================
+    // Element Access
+    // ==========================================================================
+
+    // Read one element (zeroed T on error)
+    T get(size_t index) const {
+        T value;
+        if (index >= _count || _vm->read(addrOf(index), &value, sizeof(T)) < 0) {
+            memset((void*)&value, 0, sizeof(T));
+        }
+        return value;
+    }
+
+    bool set(size_t index, const T& value) {
+        if (index >= _count) return false;
+        return _vm->write(addrOf(index), &value, sizeof(T)) == (int32_t)sizeof(T);
+    }
+
+    // ==========================================================================
+    // Iteration (one page lookup per page)
+    // ==========================================================================
+
+    VArrayRange<T, VMEM_MAP_READ> reader(size_t first = 0, size_t last = SIZE_MAX) const {
+        return VArrayRange<T, VMEM_MAP_READ>(_vm, _baseAddr, first, clampLast(first, last));
+    }
+
+    VArrayRange<T, VMEM_MAP_WRITE> writer(size_t first = 0, size_t last = SIZE_MAX) {
+        return VArrayRange<T, VMEM_MAP_WRITE>(_vm, _baseAddr, first, clampLast(first, last));
+    }
+
+    iterator begin() { return iterator(_vm, _baseAddr, 0); }
+    iterator end() { return iterator(_vm, _baseAddr, _count); }
+    const_iterator begin() const { return const_iterator(_vm, _baseAddr, 0); }
+    const_iterator end() const { return const_iterator(_vm, _baseAddr, _count); }
+
+    // Call fn(T* elems, size_t n, size_t firstIndex) once per page run
+    // Elements are accessed in place; Mode selects whether pages get dirtied
+    template <VMemMapMode Mode, typename Fn>
+    bool forEachPage(size_t first, size_t n, Fn fn) const {
+        if (first > _count || n > _count - first) return false;
+        while (n > 0) {
+            size_t inPage = kElemsPerPage - (first % kElemsPerPage);
+            if (inPage > n) inPage = n;
+
+            uint32_t addr = addrOf(first);
+            T* elems = (T*)_vm->map(addr, inPage * sizeof(T), Mode);
+            if (!elems) return false;
+            fn(elems, inPage, first);
+            _vm->unmap(addr, inPage * sizeof(T), Mode);
+
+            first += inPage;
+            n -= inPage;
+        }
+        return true;
+    }
+
+    // ==========================================================================
+    // Bulk Operations (std::copy / std::fill style)
+    // ==========================================================================
+
+    // Copy n elements starting at index first into dst
+    bool copyOut(size_t first, size_t n, T* dst) const {
+        return forEachPage<VMEM_MAP_READ>(first, n, [&](T* elems, size_t cnt, size_t) {
+            memcpy((void*)dst, elems, cnt * sizeof(T));
+            dst += cnt;
+        });
+    }
+
+    // Copy n elements from src into the array starting at index first
+    bool copyIn(size_t first, const T* src, size_t n) {
+        return forEachPage<VMEM_MAP_WRITE>(first, n, [&](T* elems, size_t cnt, size_t) {
+            memcpy((void*)elems, src, cnt * sizeof(T));
+            src += cnt;
+        });
+    }
+
+    // Set n elements starting at index first to value
+    bool fill(size_t first, size_t n, const T& value) {
+        return forEachPage<VMEM_MAP_WRITE>(first, n, [&](T* elems, size_t cnt, size_t) {
+            for (size_t i = 0; i < cnt; i++) elems[i] = value;
+        });
+    }
+
+    // Copy n elements between two arrays, or within one. False if a page
+    // could not be mapped (the copy may then be partial) or if the source
+    // and destination ranges overlap - memcpy, not memmove, semantics.
+    template <typename U>
+    friend bool vcopy(const VArray<U>& src, size_t srcFirst, size_t n,
+                      VArray<U>& dst, size_t dstFirst);
+
+private:
+    VirtualMemory* _vm;
+    uint32_t _baseAddr;
+    size_t _count;
+
+    uint32_t addrOf(size_t index) const {
+        return _baseAddr + (uint32_t)((index / kElemsPerPage) * VMEM_PAGE_SIZE +
+                                      (index % kElemsPerPage) * sizeof(T));
+    }
+
+    size_t clampLast(size_t first, size_t last) const {
+        if (last > _count) last = _count;
+        return last < first ? first : last;
+    }
+};
+
+template <typename T>
+bool vcopy(const VArray<T>& src, size_t srcFirst, size_t n,
+           VArray<T>& dst, size_t dstFirst) {
+    if (srcFirst > src._count || n > src._count - srcFirst) return false;
+    if (dstFirst > dst._count || n > dst._count - dstFirst) return false;
+    if (n == 0) return true;
+
+    if (src._vm == dst._vm) {
+        uint32_t srcStart = src.addrOf(srcFirst);
+        uint32_t srcEnd = src.addrOf(srcFirst + n - 1) + sizeof(T);
+        uint32_t dstStart = dst.addrOf(dstFirst);
+        uint32_t dstEnd = dst.addrOf(dstFirst + n - 1) + sizeof(T);
+        if (srcStart < dstEnd && dstStart < srcEnd) return false;
+    }
+
+    // Source pages are mapped one at a time and written straight through;
+    // the destination is mapped while the source page is still pinned
+    while (n > 0) {
+        size_t inPage = VArray<T>::kElemsPerPage - (srcFirst % VArray<T>::kElemsPerPage);
+        if (inPage > n) inPage = n;
+
+        uint32_t addr = src.addrOf(srcFirst);
+        T* elems = (T*)src._vm->map(addr, inPage * sizeof(T), VMEM_MAP_READ);
+        if (!elems) return false;
+        bool ok = dst.copyIn(dstFirst, elems, inPage);
+        src._vm->unmap(addr, inPage * sizeof(T), VMEM_MAP_READ);
+        if (!ok) return false;
+
+        srcFirst += inPage;
+        dstFirst += inPage;
+        n -= inPage;
+    }
+    return true;
+}
+
+// =============================================================================
+// VRingBuffer - fixed capacity history (oldest entries overwritten)
+// =============================================================================
+
+template <typename T>
+class VRingBuffer {
+public:
+    VRingBuffer(uint32_t baseAddr, size_t capacity, VirtualMemory& vm = vmem)
+        : _array(baseAddr, capacity, vm), _head(0), _count(0) {}
+
+    bool isValid() const { return _array.isValid() && _array.size() > 0; }
+
+    size_t size() const { return _count; }
+    size_t capacity() const { return _array.size(); }
+    bool full() const { return _count == _array.size(); }
+    uint32_t endAddr() const { return _array.endAddr(); }
+
+    void clear() { _head = 0; _count = 0; }
+
+    // Append one element, overwriting the oldest when full
+    bool push(const T& value) {
+        if (!_array.set(_head, value)) return false;
+        advance(1);
+        return true;
+    }
+
+    // Append n elements in page-sized chunks
+    bool pushBulk(const T* src, size_t n) {
+        size_t cap = _array.size();
+        if (n > cap) {
+            // Only the newest 'capacity' elements survive
+            src += n - cap;
+            n = cap;
+        }
+        while (n > 0) {
+            size_t chunk = cap - _head;
+            if (chunk > n) chunk = n;
+            if (!_array.copyIn(_head, src, chunk)) return false;
+            advance(chunk);
+            src += chunk;
+            n -= chunk;
+        }
+        return true;
+    }
+
+    // Element i counted from the oldest entry (0 = oldest)
+    T at(size_t i) const { return _array.get(physical(i)); }
+
+    // Most recent element
+    T back() const { return at(_count - 1); }
+
+    // Copy the newest n elements (oldest first) into dst
+    bool copyLatest(size_t n, T* dst) const {
+        if (n > _count) return false;
+        return forEach(_count - n, n, [&](const T* elems, size_t cnt) {
+            memcpy((void*)dst, elems, cnt * sizeof(T));
+            dst += cnt;
+        });
+    }
+
+    // Call fn(const T* elems, size_t n) over n entries starting at logical
+    // index first, oldest first, at most two page runs per wrap
+    template <typename Fn>
+    bool forEach(size_t first, size_t n, Fn fn) const {
+        if (first > _count || n > _count - first) return false;
+        size_t cap = _array.size();
+        while (n > 0) {
+            size_t start = physical(first);
+            size_t chunk = cap - start;
+            if (chunk > n) chunk = n;
+            bool ok = _array.template forEachPage<VMEM_MAP_READ>(start, chunk,
+                [&](T* elems, size_t cnt, size_t) { fn((const T*)elems, cnt); });
+            if (!ok) return false;
+            first += chunk;
+            n -= chunk;
+        }
+        return true;
+    }
+
+private:
+    VArray<T> _array;
+    size_t _head;   // Next write position
+    size_t _count;  // Valid entries
+
+    size_t physical(size_t logical) const {
+        size_t cap = _array.size();
+        return (_head + cap - _count + logical) % cap;
+    }
+
+    void advance(size_t n) {
+        _head = (_head + n) % _array.size();
+        _count = (_count + n > _array.size()) ? _array.size() : _count + n;
+    }
+};
+
+#endif // VIRTUAL_MEMORY
+
+#endif // VMEM_ARRAY_H
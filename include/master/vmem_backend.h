@@ -0,0 +1,166 @@
+#ifndef VMEM_BACKEND_H
+#define VMEM_BACKEND_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Platform layer for the virtual memory system
+//
+// VirtualMemory only talks to its backing store and cache allocator through
+// the interfaces below, so the same class builds for the ESP32 (SD card +
+// PSRAM) and for Linux (POSIX file + heap, see tools/vmem-bench).
+//
+// Storage and allocator methods are called from several tasks at once and
+// must be thread-safe (FatFs in ESP-IDF is built reentrant).
+
+// =============================================================================
+// Logging and Time
+// =============================================================================
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#define VMEM_LOG(...)   Serial.printf(__VA_ARGS__)
+inline uint32_t vmemMillis() { return millis(); }
+inline uint32_t vmemMicros() { return micros(); }
+#else
+#include <mutex>
+// Host builds: quiet unless enabled with vmemSetHostLogging(true)
+void vmemHostLog(const char* fmt, ...);
+void vmemSetHostLogging(bool enabled);
+uint32_t vmemMillis();
+uint32_t vmemMicros();
+#define VMEM_LOG(...)   vmemHostLog(__VA_ARGS__)
+#endif
+
+// =============================================================================
+// Tasks and Locking
+// =============================================================================
+
+// Relaxed atomics for counters and hints read outside their lock
+// (GCC builtins - available on Xtensa and the host)
+#define VMEM_ATOMIC_LOAD(p)         __atomic_load_n((p), __ATOMIC_RELAXED)
+#define VMEM_ATOMIC_STORE(p, v)     __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#define VMEM_ATOMIC_ADD(p, v)       __atomic_fetch_add((p), (v), __ATOMIC_RELAXED)
+#define VMEM_ATOMIC_SUB(p, v)       __atomic_fetch_sub((p), (v), __ATOMIC_RELAXED)
+
+#ifdef ARDUINO
+// Calling FreeRTOS task
+inline uintptr_t vmemTaskId() { return (uintptr_t)xTaskGetCurrentTaskHandle(); }
+inline const char* vmemTaskName() { return pcTaskGetName(nullptr); }
+inline void vmemYield() { taskYIELD(); }
+
+// Statically allocated so it is safe to construct before the scheduler starts
+class VMemLock {
+public:
+    VMemLock() { _handle = xSemaphoreCreateMutexStatic(&_buffer); }
+    void lock() { xSemaphoreTake(_handle, portMAX_DELAY); }
+    bool tryLock() { return xSemaphoreTake(_handle, 0) == pdTRUE; }
+    void unlock() { xSemaphoreGive(_handle); }
+
+private:
+    StaticSemaphore_t _buffer;
+    SemaphoreHandle_t _handle;
+};
+#else
+// Calling thread
+uintptr_t vmemTaskId();
+const char* vmemTaskName();
+void vmemYield();
+
+class VMemLock {
+public:
+    void lock() { _mutex.lock(); }
+    bool tryLock() { return _mutex.try_lock(); }
+    void unlock() { _mutex.unlock(); }
+
+private:
+    std::mutex _mutex;
+};
+#endif
+
+// Scoped lock holder
+class VMemLockGuard {
+public:
+    explicit VMemLockGuard(VMemLock& lock) : _lock(lock) { _lock.lock(); }
+    ~VMemLockGuard() { _lock.unlock(); }
+
+private:
+    VMemLock& _lock;
+    VMemLockGuard(const VMemLockGuard&);
+    VMemLockGuard& operator=(const VMemLockGuard&);
+};
+
+// =============================================================================
+// Backing Store
+// =============================================================================
+
+// Files kept next to the swap in durable mode (see vmem_journal.h)
+typedef enum {
+    VMEM_SIDE_META,         // Per-page generation and checksum table
+    VMEM_SIDE_JOURNAL       // Write-ahead journal of in-flight write-backs
+} VMemSideFile;
+
+class VMemStorage {
+public:
+    virtual ~VMemStorage() {}
+
+    // Storage medium is available
+    virtual bool isReady() = 0;
+
+    // Split the swap into files of shardSize bytes (0 = a single file)
+    // Set by init() before size()/create(); requests never cross a shard
+    virtual void setShardSize(uint32_t shardSize) = 0;
+
+    // Current swap size in bytes, or -1 if the swap does not exist
+    virtual int64_t size() = 0;
+
+    // Create (or recreate) a swap of the given size
+    // Contents need not be zeroed - pages are only read once the page map
+    // says they were written, and any old page map is discarded
+    virtual bool create(uint32_t size) = 0;
+
+    // Random access I/O - return bytes transferred, or -1 on error
+    // Writes may stay buffered until sync()
+    virtual int32_t readAt(uint32_t offset, uint8_t* buffer, size_t length) = 0;
+    virtual int32_t writeAt(uint32_t offset, const uint8_t* data, size_t length) = 0;
+
+    // Make every completed swap write durable
+    virtual bool sync() = 0;
+
+    // Page map persistence (one bit per materialised page), durable on return
+    // loadMap returns false if no map of exactly this length exists
+    virtual bool loadMap(uint8_t* bits, size_t length) = 0;
+    virtual bool saveMap(const uint8_t* bits, size_t length) = 0;
+
+    // Durable mode side files, removed by create()
+    // Reads of a missing file fail (-1); writes create it and are durable
+    // when they return
+    virtual int32_t sideReadAt(VMemSideFile file, uint32_t offset, uint8_t* buffer, size_t length) = 0;
+    virtual int32_t sideWriteAt(VMemSideFile file, uint32_t offset, const uint8_t* data, size_t length) = 0;
+};
+
+// =============================================================================
+// Cache Allocator
+// =============================================================================
+
+class VMemAllocator {
+public:
+    virtual ~VMemAllocator() {}
+
+    // Bytes currently available for the page cache
+    virtual size_t freeBytes() = 0;
+
+    virtual void* alloc(size_t size) = 0;
+    virtual void release(void* ptr) = 0;
+};
+
+#ifdef ARDUINO
+// Default device backends: swap file on the master SD card, PSRAM cache
+VMemStorage* vmemSdStorage();
+VMemAllocator* vmemPsramAllocator();
+#endif
+
+#endif // VMEM_BACKEND_H
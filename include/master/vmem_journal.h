@@ -0,0 +1,162 @@
+#ifndef VMEM_JOURNAL_H
+#define VMEM_JOURNAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "shared/config.h"
+
+#if VIRTUAL_MEMORY
+
+#include "master/vmem_backend.h"
+#include "master/vmem_tier.h"
+
+// Crash-consistent write-back for VirtualMemory (durable mode)
+//
+// Power can drop in the middle of a page write-back, leaving a page on the
+// swap that is half old and half new. In durable mode every write-back is
+// first appended to a redo journal (record block + the sectors about to be
+// written), then written to the swap, then committed to a per-page table
+// of generation numbers and CRC32 checksums. init() replays the records of
+// the current journal epoch, so a torn swap write is completed from the
+// journal and a torn journal append is simply ignored (the swap write had
+// not started). Recovery reads at most the journal, whatever the swap size.
+//
+// A checkpoint writes the changed parts of the checksum table and starts a
+// new epoch, which empties the journal. It runs when the journal is full
+// and on flush(). Pages whose checksum no longer matches on load are
+// reported instead of returned.
+//
+// SD cards are assumed to write 512-byte blocks atomically; every record
+// and table update is block aligned. Not thread-safe - VirtualMemory
+// serialises access with its journal lock.
+
+// =============================================================================
+// On-Storage Format
+// =============================================================================
+
+#define VMEM_JOURNAL_BLOCK          512
+#define VMEM_SECTOR_BYTES           512         // Dirty bitmap granularity
+#define VMEM_JOURNAL_MAGIC          0x4C4E4A56  // "VJNL"
+#define VMEM_JOURNAL_RECORD_MAGIC   0x43524A56  // "VJRC"
+#define VMEM_META_MAGIC             0x544D4A56  // "VJMT"
+#define VMEM_META_PER_BLOCK         (VMEM_JOURNAL_BLOCK / sizeof(VMemPageMeta))
+
+// Checksum table entry, one per virtual page
+typedef struct {
+    uint32_t generation;    // Durable write-backs of the page (0 = no checksum yet)
+    uint32_t crc;           // CRC32 of the whole page as last written
+} VMemPageMeta;
+
+// Block 0 of the journal and of the checksum table
+typedef struct {
+    uint32_t magic;
+    uint32_t epoch;         // Journal: bumped by every checkpoint
+    uint32_t pageSize;
+    uint32_t totalPages;
+    uint32_t crc;           // Over the fields above
+} VMemJournalHeader;
+
+// First block of a record, followed by its dirty sectors in order
+typedef struct {
+    uint32_t magic;
+    uint32_t epoch;         // Records from older epochs are stale
+    uint32_t sequence;      // 0, 1, 2... within the epoch
+    uint32_t virtualPage;
+    uint32_t generation;
+    uint32_t pageCrc;       // Whole page after the write
+    uint32_t dataCrc;       // Sector data following this block
+    uint32_t sectors;       // Number of sectors following
+    uint32_t dirtySectors[VMEM_TIER_DIRTY_WORDS];
+    uint32_t crc;           // Over the fields above
+} VMemJournalRecord;
+
+static_assert(sizeof(VMemJournalRecord) <= VMEM_JOURNAL_BLOCK, "Record header must fit one block");
+
+// Outcome of the journal scan at init()
+typedef struct {
+    uint32_t records;       // Valid records found in the current epoch
+    uint32_t pages;         // Page writes redone into the swap
+    uint32_t bytesRead;     // Journal bytes scanned
+    uint32_t timeUs;        // Scan and replay time
+    bool torn;              // Scan stopped at a damaged record (power lost mid-append)
+} VMemRecovery;
+
+// Called for every page with a record in the replayed epoch
+typedef void (*VMemJournalReplayFn)(uint32_t virtualPage, void* context);
+
+// CRC-32 (IEEE 802.3), same result as otaCrc32()
+uint32_t vmemCrc32(const uint8_t* data, size_t length, uint32_t crc = 0);
+
+// =============================================================================
+// VMemJournal Class
+// =============================================================================
+
+class VMemJournal {
+public:
+    VMemJournal();
+
+    // Allocate the checksum table (from the allocator) and staging buffers,
+    // and load the table from storage. journalSize bytes of journal, at
+    // least two blocks more than a page.
+    bool init(VMemStorage* storage, VMemAllocator* allocator, uint32_t totalPages,
+              uint32_t pageSize, uint32_t journalSize);
+    void release();
+    bool isEnabled() const { return _meta != nullptr; }
+
+    // Redo the records of the current epoch into the swap (call once after
+    // init, then checkpoint). Returns false if the swap could not be written.
+    bool recover(VMemJournalReplayFn replayed, void* context);
+    const VMemRecovery& recovery() const { return _recovery; }
+
+    // Journal a write-back of the given sectors of page before it reaches
+    // the swap. Returns the record size in bytes, 0 if the journal is full
+    // (checkpoint first), or -1 on a storage error.
+    int32_t append(uint32_t virtualPage, const uint8_t* page, const uint32_t* sectors);
+
+    // The last appended write-back is on the swap
+    void commit();
+
+    // Persist changed checksum table blocks, then empty the journal
+    // (the caller saves the page map first)
+    bool checkpoint();
+
+    // True if page matches its checksum, or the page has none yet
+    bool verify(uint32_t virtualPage, const uint8_t* page) const;
+
+    uint32_t capacity() const { return _journalSize; }
+    uint32_t used() const { return _offset; }
+
+private:
+    VMemStorage* _storage;
+    VMemAllocator* _allocator;
+    uint32_t _totalPages;
+    uint32_t _pageSize;
+    uint32_t _journalSize;
+
+    VMemPageMeta* _meta;            // Checksum table (allocator memory)
+    uint8_t* _metaDirty;            // Changed table blocks, bit per block
+    uint32_t _metaBlocks;
+    uint32_t _metaDirtyCount;
+    bool _metaHeaderWritten;
+
+    uint8_t* _staging;              // Record block + sector data
+    uint32_t _epoch;
+    uint32_t _sequence;
+    uint32_t _offset;               // Next record position
+
+    // Write-back between append() and commit()
+    uint32_t _pendingPage;
+    VMemPageMeta _pending;
+
+    VMemRecovery _recovery;
+
+    void setMeta(uint32_t virtualPage, const VMemPageMeta& meta);
+    bool writeHeader(VMemSideFile file, uint32_t epoch);
+    bool readHeader(VMemSideFile file, VMemJournalHeader& header);
+    bool readRecord(uint32_t offset, const VMemJournalHeader& header, uint32_t* length);
+    bool redo(const VMemJournalRecord& record, uint32_t pageSize);
+};
+
+#endif // VIRTUAL_MEMORY
+
+#endif // VMEM_JOURNAL_H
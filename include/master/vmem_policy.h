@@ -0,0 +1,205 @@
+#ifndef VMEM_POLICY_H
+#define VMEM_POLICY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "shared/config.h"
+
+#if VIRTUAL_MEMORY
+
+#include "master/vmem_backend.h"
+
+// Page replacement policies for VirtualMemoryT<Policy>
+//
+// A policy tracks recency/frequency of the cache slots and proposes which
+// slot to evict. VirtualMemory keeps ownership of the slots themselves:
+// it asks victim() for a candidate, filtered through an evictable callback
+// (pinned, reserved and locked pages are skipped), and reports every page
+// entering, leaving or moving between slots.
+//
+// Calls made by VirtualMemory:
+//   touch()   cache hit, from any task with only the page's stripe held
+//   insert()  page loaded into a slot, returns true on a ghost hit
+//   remove()  page left its slot (evicted = true if it was pushed out)
+//   move()    page relocated to another slot by map()
+//   victim()  eviction candidate, with the replacement lock held
+//
+// LRU and CLOCK only use atomics on the hit path. 2Q and ARC keep linked
+// lists and take a short internal lock on every call, including hits.
+// mapBytes() is the policy's share of the page table RAM (the 2Q/ARC ghost
+// map), reported by VirtualMemory::getPageTableBytes().
+
+// =============================================================================
+// Policy Selection (VIRTUAL_MEMORY_POLICY in config.h)
+// =============================================================================
+
+#define VMEM_POLICY_LRU     0       // Least recently used (oldest access stamp)
+#define VMEM_POLICY_CLOCK   1       // Second chance with a reference bit per slot
+#define VMEM_POLICY_2Q      2       // FIFO probation queue + LRU main queue + ghost queue
+#define VMEM_POLICY_ARC     3       // Adaptive Replacement Cache (recency/frequency balance)
+
+#define VMEM_POLICY_NONE    0xFFFF  // No node / end of list
+
+// Returns true if the slot may be evicted right now
+typedef bool (*VMemEvictableFn)(uint32_t slot, void* context);
+
+// =============================================================================
+// LRU
+// =============================================================================
+
+class VMemLruPolicy {
+public:
+    static const char* name() { return "LRU"; }
+
+    VMemLruPolicy();
+    bool init(VMemAllocator* allocator, uint32_t slots, uint32_t totalPages);
+    void release();
+    uint32_t mapBytes() const { return 0; }
+
+    void touch(uint32_t slot) {
+        VMEM_ATOMIC_STORE(&_stamps[slot], VMEM_ATOMIC_ADD(&_clock, 1) + 1);
+    }
+    bool insert(uint32_t slot, uint32_t virtualPage) {
+        (void)virtualPage;
+        touch(slot);
+        return false;
+    }
+    void remove(uint32_t slot, bool evicted) { (void)slot; (void)evicted; }
+    void move(uint32_t from, uint32_t to) {
+        VMEM_ATOMIC_STORE(&_stamps[to], VMEM_ATOMIC_LOAD(&_stamps[from]));
+    }
+    int32_t victim(uint32_t incoming, VMemEvictableFn evictable, void* context);
+
+private:
+    uint32_t* _stamps;      // Access counter value of the last touch
+    uint32_t _slots;
+    uint32_t _clock;
+};
+
+// =============================================================================
+// CLOCK
+// =============================================================================
+
+class VMemClockPolicy {
+public:
+    static const char* name() { return "CLOCK"; }
+
+    VMemClockPolicy();
+    bool init(VMemAllocator* allocator, uint32_t slots, uint32_t totalPages);
+    void release();
+    uint32_t mapBytes() const { return 0; }
+
+    void touch(uint32_t slot) { VMEM_ATOMIC_STORE(&_referenced[slot], (uint8_t)1); }
+    bool insert(uint32_t slot, uint32_t virtualPage) {
+        (void)virtualPage;
+        touch(slot);
+        return false;
+    }
+    void remove(uint32_t slot, bool evicted) { (void)slot; (void)evicted; }
+    void move(uint32_t from, uint32_t to) {
+        VMEM_ATOMIC_STORE(&_referenced[to], VMEM_ATOMIC_LOAD(&_referenced[from]));
+    }
+    int32_t victim(uint32_t incoming, VMemEvictableFn evictable, void* context);
+
+private:
+    uint8_t* _referenced;   // Set on access, cleared as the hand passes
+    uint32_t _slots;
+    uint32_t _hand;         // Only moved by victim()
+};
+
+// =============================================================================
+// List-Based Policies (2Q, ARC)
+// =============================================================================
+// Nodes 0..slots-1 are the cache slots, the rest are ghost entries that
+// remember recently evicted page numbers. Lists run head = most recent to
+// tail = least recent. Ghosts are found by page through an open addressing
+// map of node numbers (linear probing, at most half full), so its size
+// follows the ghost count rather than the virtual space.
+
+typedef struct {
+    uint16_t prev;
+    uint16_t next;
+    uint8_t list;
+} VMemPolicyNode;
+
+typedef struct {
+    uint16_t head;
+    uint16_t tail;
+    uint32_t size;
+} VMemPolicyList;
+
+class VMemListPolicy {
+public:
+    VMemListPolicy();
+    bool init(VMemAllocator* allocator, uint32_t slots, uint32_t totalPages, uint32_t ghosts);
+    void release();
+    uint32_t mapBytes() const { return _ghostMapMask ? (_ghostMapMask + 1) * sizeof(uint16_t) : 0; }
+
+protected:
+    static const uint8_t NO_LIST = 0xFF;
+
+    VMemPolicyNode* _nodes;
+    uint32_t* _pageOf;          // Page held by each node
+    uint16_t* _ghostMap;        // Ghost nodes by page hash (VMEM_POLICY_NONE if empty)
+    uint32_t _ghostMapMask;     // Map entries - 1 (a power of two)
+    VMemAllocator* _allocator;
+    uint32_t _slots;
+    uint32_t _totalPages;
+    uint16_t _freeGhost;        // Free ghost nodes through .next
+    VMemPolicyList _lists[4];
+    VMemLock _lock;
+
+    void pushHead(uint8_t list, uint16_t node);
+    void unlink(uint16_t node);
+    void replaceNode(uint16_t from, uint16_t to);
+    uint16_t findGhost(uint32_t virtualPage) const;
+    bool addGhost(uint8_t list, uint32_t virtualPage);
+    void dropGhost(uint16_t node);
+    int32_t lastEvictable(uint8_t list, VMemEvictableFn evictable, void* context);
+};
+
+// 2Q: new pages wait in a FIFO (A1in); only pages referenced again after
+// leaving it (found in the A1out ghost queue) enter the LRU main queue (Am).
+// A sequential scan therefore cycles through A1in without touching Am.
+class VMem2QPolicy : public VMemListPolicy {
+public:
+    static const char* name() { return "2Q"; }
+
+    bool init(VMemAllocator* allocator, uint32_t slots, uint32_t totalPages);
+    void touch(uint32_t slot);
+    bool insert(uint32_t slot, uint32_t virtualPage);
+    void remove(uint32_t slot, bool evicted);
+    void move(uint32_t from, uint32_t to);
+    int32_t victim(uint32_t incoming, VMemEvictableFn evictable, void* context);
+
+private:
+    enum { A1IN, AM, A1OUT };
+    uint32_t _inTarget;         // A1in size above which it is evicted first
+    uint32_t _outTarget;        // A1out ghost entries
+};
+
+// ARC: T1 holds pages seen once, T2 pages seen at least twice; ghost
+// lists B1/B2 remember pages evicted from each. A ghost hit in B1 grows
+// the T1 target p (recency is paying off), a hit in B2 shrinks it.
+class VMemArcPolicy : public VMemListPolicy {
+public:
+    static const char* name() { return "ARC"; }
+
+    bool init(VMemAllocator* allocator, uint32_t slots, uint32_t totalPages);
+    void touch(uint32_t slot);
+    bool insert(uint32_t slot, uint32_t virtualPage);
+    void remove(uint32_t slot, bool evicted);
+    void move(uint32_t from, uint32_t to);
+    int32_t victim(uint32_t incoming, VMemEvictableFn evictable, void* context);
+
+    // Current T1 target size in pages
+    uint32_t target() const { return _target; }
+
+private:
+    enum { T1, T2, B1, B2 };
+    uint32_t _target;
+};
+
+#endif // VIRTUAL_MEMORY
+
+#endif // VMEM_POLICY_H
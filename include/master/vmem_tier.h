@@ -0,0 +1,153 @@
+#ifndef VMEM_TIER_H
+#define VMEM_TIER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "shared/config.h"
+
+#if VIRTUAL_MEMORY
+
+#include "master/vmem_backend.h"
+
+// Compressed second cache tier for VirtualMemory
+//
+// Pages evicted from the PSRAM page cache are LZ-compressed into a pool of
+// VMEM_TIER_CHUNK_SIZE chunks (also in PSRAM) instead of going straight to
+// SD. Telemetry pages (slow-changing values, mostly zeros) shrink 10-50x,
+// so the pool holds far more pages than the same memory as raw slots.
+// Dirty pages keep their dirty-sector bitmap and are only written to SD
+// when they fall out of the tier or on flush. Oldest entries are evicted
+// first; a hit moves the page back to the main cache and frees its entry.
+//
+// Not thread-safe - VirtualMemory serialises access with its tier lock.
+
+// =============================================================================
+// Configuration
+// =============================================================================
+
+#define VMEM_TIER_CHUNK_SIZE    256
+
+// Largest page size VirtualMemory accepts at runtime (below the codec's
+// 64 KB input limit); sizes the dirty-sector bitmaps
+#ifndef VMEM_MAX_PAGE_SIZE
+#define VMEM_MAX_PAGE_SIZE      32768
+#endif
+#define VMEM_TIER_DIRTY_WORDS   ((VMEM_MAX_PAGE_SIZE / 512 + 31) / 32)
+#define VMEM_TIER_NONE          0xFFFF      // No entry / end of list
+
+// =============================================================================
+// LZ Codec
+// =============================================================================
+// LZF-style byte format: a control byte below 32 starts a run of 1-32
+// literals; otherwise the top three bits are a match length (7 = extended
+// by one more byte) and the low five bits plus the next byte a distance of
+// up to 8 KB. Fast enough to run on every eviction.
+
+#define VMEM_LZ_HASH_BITS       12
+#define VMEM_LZ_HASH_SIZE       (1 << VMEM_LZ_HASH_BITS)
+
+// Compress input (max 65534 bytes) using a VMEM_LZ_HASH_SIZE entry table
+// Returns compressed length, or 0 if the result would exceed outCapacity
+size_t vmemLzCompress(const uint8_t* in, size_t inLength, uint8_t* out, size_t outCapacity,
+                      uint16_t* hashTable);
+
+// Decompress exactly outLength bytes, returns false on malformed input
+bool vmemLzDecompress(const uint8_t* in, size_t inLength, uint8_t* out, size_t outLength);
+
+// =============================================================================
+// Tier Entry
+// =============================================================================
+
+typedef struct {
+    uint32_t virtualPage;
+    uint16_t length;        // Compressed bytes
+    uint16_t firstChunk;    // Chunk chain through the pool
+    uint16_t older;         // Eviction list (VMEM_TIER_NONE at the ends)
+    uint16_t newer;
+    bool dirty;             // Newer than the swap file
+    uint32_t dirtySectors[VMEM_TIER_DIRTY_WORDS];
+} VMemTierEntry;
+
+// Write-back of a dirty page leaving the tier; return true once on storage
+typedef bool (*VMemTierWriteFn)(uint32_t virtualPage, const uint8_t* page,
+                                const uint32_t* dirtySectors, void* context);
+
+// =============================================================================
+// VMemTier Class
+// =============================================================================
+
+class VMemTier {
+public:
+    VMemTier();
+
+    // Allocate pool and metadata (all from the allocator, i.e. PSRAM)
+    bool init(VMemAllocator* allocator, uint32_t poolSize, uint32_t totalPages, uint32_t pageSize);
+    void release();
+    bool isEnabled() const { return _pool != nullptr; }
+
+    // Compress a page into the staging buffer
+    // Returns compressed length, or 0 if the page does not compress enough
+    uint32_t compress(const uint8_t* page);
+
+    // Store the last compress() result for virtualPage, evicting the oldest
+    // entries (dirty ones through writeBack) until it fits
+    bool store(uint32_t virtualPage, uint32_t length, bool dirty,
+               const uint32_t* dirtySectors, VMemTierWriteFn writeBack, void* context);
+
+    // Decompress and remove an entry; returns false if the page is not here
+    bool fetch(uint32_t virtualPage, uint8_t* page, bool* dirty, uint32_t* dirtySectors);
+
+    // Discard an entry without writing it back
+    void drop(uint32_t virtualPage);
+
+    // Discard every entry
+    void clear();
+
+    // Write back dirty entries for pages first..last (entries stay cached)
+    // Returns number of pages written, or -1 if a write failed
+    int32_t flush(uint32_t firstPage, uint32_t lastPage, VMemTierWriteFn writeBack, void* context);
+
+    // Current contents
+    uint32_t pages() const { return _pages; }
+    uint32_t bytes() const { return _bytes; }
+    uint32_t chunksUsed() const { return _chunkCount - _freeChunks; }
+    uint32_t capacity() const { return _chunkCount * VMEM_TIER_CHUNK_SIZE; }
+
+    // Counted by VirtualMemory's per-task stats instead
+    uint32_t evictions() const { return _evictions; }
+
+private:
+    VMemAllocator* _allocator;
+    uint8_t* _pool;
+    uint16_t* _chunkNext;           // Chunk chains and free list
+    uint32_t _chunkCount;
+    uint16_t _freeChunk;
+    uint32_t _freeChunks;
+
+    VMemTierEntry* _entries;
+    uint16_t _freeEntry;            // Free list through .newer
+    uint16_t _oldest;
+    uint16_t _newest;
+    uint16_t* _index;               // Virtual page -> entry
+    uint32_t _totalPages;
+    uint32_t _pageSize;
+    uint32_t _maxCompressed;        // Pages that do not shrink below this stay on SD
+
+    uint16_t* _hashTable;           // Codec state
+    uint8_t* _staging;              // compress() output, kept until store()
+    uint8_t* _gather;               // Chunk chain of an entry being read
+    uint8_t* _pageBuffer;           // Decompressed page for write-back
+
+    uint32_t _pages;
+    uint32_t _bytes;
+    uint32_t _evictions;
+
+    void unlink(uint16_t entry);
+    void freeEntry(uint16_t entry);
+    bool evictOldest(VMemTierWriteFn writeBack, void* context);
+    bool readEntry(uint16_t entry, uint8_t* page);
+};
+
+#endif // VIRTUAL_MEMORY
+
+#endif // VMEM_TIER_H
@@ -19,12 +19,19 @@
 #define I2C_TOUCH_SDA_PIN 16
 #define I2C_TOUCH_SCL_PIN 15
 
-// Master - MCP2515 SPI Pins
-#define MCP2515_SCK_PIN  12
-#define MCP2515_MISO_PIN 13
-#define MCP2515_MOSI_PIN 11
+// Master - MCP2515 on the SD card's SPI bus (SD_SPI_SCK/MOSI/MISO_PIN, see
+// master/periph_spi.h): only chip select and interrupt have pins of their own
 #define MCP2515_CS_PIN   10
 #define MCP2515_INT_PIN  9
+#define CAN_RX_RING_FRAMES 256  // Received frames waiting for canProcess() (power of two, 24 B each)
+#define CAN_TX_BUFFER_TIMEOUT_US 5000  // TX buffer reused if its frame has not gone out by then
+
+// Master - Volvo EHPS pump control over CAN (docs/volvo-xc60-eps-can-bus.md)
+#define EHPS_CAN_CONTROL         0       // Send from boot (1), or only after the 'e1' command
+#define EHPS_SPEED_PERIOD_US     14000   // 0x02104136 at ~71.4 Hz
+#define EHPS_KEEPALIVE_PERIOD_US 420000  // 0x1AE0092C at ~2.38 Hz, 1/30 of the speed rate
+#define EHPS_ALIVE_TIMEOUT_MS    500     // Stop sending this long after the pump's last 0x1B200002
+#define EHPS_SPEED_LEAST_ASSIST  0x4000  // Speed value at PWM duty 0 (duty 255 sends 0 = most assist)
 
 // Master - Available GPIOs (formerly direct encoder, now freed up)
 // GPIO 4, 5, 6 are available for other uses
@@ -110,7 +117,7 @@
 #define POWER_STEERING_DEFAULT  50      // Default assist level (50%)
 
 // Master - SD Card (SPI Mode)
-// Uses dedicated SPI bus for data logging and configuration storage
+// Shares its SPI bus with the MCP2515 (master/periph_spi.h)
 // See docs/schematics/master-custom-pcb.md for circuit details
 #define SD_SPI_CS_PIN    15    // Chip select (active LOW)
 #define SD_SPI_MOSI_PIN  16    // Master Out, Slave In
@@ -118,6 +125,39 @@
 #define SD_SPI_MISO_PIN  18    // Master In, Slave Out
 #define SD_SPI_CD_PIN    8     // Card detect (optional, LOW = card present)
 #define SD_SPI_FREQUENCY 25000000  // 25MHz (max for most SD cards in SPI mode)
+#define SD_FILE_CACHE_SIZE  6      // Files sd_handler keeps open (swap shards, page map, logs)
+#define SD_SYNC_INTERVAL_MS 1000   // Longest time a write stays buffered in an open file
+#define SD_IO_QUEUE_DEPTH   16     // Requests the SD I/O task can hold (max SD_IO_QUEUE_MAX)
+#define SD_IO_SAFETY_RESERVE 2     // Of those, kept free for safety logs
+
+// Master - Telemetry recorder (binary logs in /tlm, see master/telemetry.h)
+#define TELEMETRY_RATE_HZ       100     // Samples per second from boot (0 = off until started)
+#define TELEMETRY_MAX_RATE_HZ   1000
+#define TELEMETRY_CHUNK_KB      16      // Largest chunk written at once
+#define TELEMETRY_CHUNK_MS      5000    // Smaller chunks at low rates, so data reaches the card within this
+#define TELEMETRY_BUFFERS       6       // PSRAM chunk buffers (max TELEMETRY_MAX_BUFFERS)
+#define TELEMETRY_FILE_MB       16      // Log file size before rotating
+#define TELEMETRY_FILES         16      // Newest files kept, older ones deleted
+
+// Master - CAN capture (binary frame logs in /can or over USB, see master/can_capture.h)
+#define CAN_CAPTURE_BLOCK_KB    8       // Block written at once (32 B header + 16 B per frame)
+#define CAN_CAPTURE_BUFFERS     16      // PSRAM block buffers (max CAN_CAPTURE_MAX_BUFFERS)
+#define CAN_CAPTURE_FLUSH_MS    500     // Partly filled block written after this
+#define CAN_CAPTURE_FILE_MB     64      // Capture file size before starting the next
+
+// Master - CAN replay (captures fed back to the consumer, see master/can_replay.h)
+#define CAN_REPLAY_BUFFER_KB    32      // PSRAM read buffer, at least one capture block
+
+// Master - Black box (recent state in RTC memory, see master/black_box.h)
+#define BLACKBOX_SAMPLES        300     // Pump task samples kept (3 s at 100 Hz, 12 B each)
+#define BLACKBOX_EVENTS         32      // State changes kept (8 B each)
+#define BLACKBOX_POST_SAMPLES   50      // Samples still recorded after a trigger
+#define BLACKBOX_PATH           "/blackbox.csv"
+
+// Master - Deferred log (real-time task messages, see master/deferred_log.h)
+#define LOG_RING_SLOTS          64      // Records waiting to be printed (power of two)
+#define LOG_TO_SD               0       // Copy the messages to LOG_PATH from boot
+#define LOG_PATH                "/console.log"
 
 // Master - JTAG Debug Interface (directly exposed to J10 header)
 // Standard ARM Cortex 10-pin debug connector
@@ -175,6 +215,9 @@
 // Set to true for 1-bit mode, false for 4-bit mode
 #define SD_MMC_1BIT_MODE true
 
+// SD latency statistics (both MCUs, see shared/sd_latency.h)
+#define SD_SLOW_OP_US 50000     // Operations at least this slow go to the slow-op trace
+
 // Timing
 #define SPI_SEND_INTERVAL_MS 100  // 10Hz update rate (SPI is fast and reliable)
 #define SPI_TIMEOUT_MS 1000       // Show "NO SIGNAL" after 1 second
@@ -185,10 +228,31 @@
 // =============================================================================
 // Provides 16MB+ memory buffers using SD card as backing store with PSRAM cache
 // Disabled by default to allow testing without SD card
+// Each value can be overridden with -D (tools/vmem-bench builds with VIRTUAL_MEMORY=1)
+#ifndef VIRTUAL_MEMORY
 #define VIRTUAL_MEMORY              0       // Set to 1 to enable
+#endif
+#ifndef VIRTUAL_MEMORY_SIZE_MB
 #define VIRTUAL_MEMORY_SIZE_MB      32      // Virtual address space in MB
+#endif
+#ifndef VIRTUAL_MEMORY_PAGE_SIZE
 #define VIRTUAL_MEMORY_PAGE_SIZE    8192    // 8KB pages (balance overhead vs efficiency)
+#endif
+#ifndef VIRTUAL_MEMORY_CACHE_MB
 #define VIRTUAL_MEMORY_CACHE_MB     6       // PSRAM cache size (~6MB, leave room for other uses)
+#endif
+#ifndef VIRTUAL_MEMORY_TIER_KB
+#define VIRTUAL_MEMORY_TIER_KB      0       // Compressed PSRAM tier behind the cache (0 = off)
+#endif
+#ifndef VIRTUAL_MEMORY_SHARD_MB
+#define VIRTUAL_MEMORY_SHARD_MB     0       // Split swap into files of this size (0 = one file)
+#endif
+#ifndef VIRTUAL_MEMORY_JOURNAL_KB
+#define VIRTUAL_MEMORY_JOURNAL_KB   0       // Durable write-back journal on SD (0 = off, see vmem_journal.h)
+#endif
+#ifndef VIRTUAL_MEMORY_POLICY
+#define VIRTUAL_MEMORY_POLICY       VMEM_POLICY_LRU // Page replacement: LRU, CLOCK, 2Q or ARC (vmem_policy.h)
+#endif
 
 // CAN Configuration
 // CAN speed and clock are defined in can_handler.cpp using library types
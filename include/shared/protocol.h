@@ -106,6 +106,43 @@ inline void packSlavePacket(uint8_t* buffer, uint8_t mode, uint16_t manualRpm) {
     buffer[7] = calculateSpiChecksum(buffer);
 }
 
+// =============================================================================
+// CAN Bus Statistics (Master -> Slave)
+// =============================================================================
+// While a dump runs the master sends these in place of every other state
+// packet; the slave's response is its normal packet.
+//
+// Byte 0: Header (0xCC)
+// Byte 1: Kind (CAN_STATS_KIND_*) in bits 7-6, row in bits 5-0
+// Byte 2-6: By kind, little endian
+//   SUMMARY (row 0): bus load (permille, 2B), IDs (1B, saturating), frames/s (2B)
+//   ID:              CAN ID (4B, bit 31 set for extended), changed-byte mask (1B)
+//   TIMING:          period (100 us units, 2B), jitter (10 us units, 2B),
+//                    DLC (1B, bit 7 set for RTR); both saturate at 0xFFFF
+// Byte 7: Checksum (XOR of bytes 0-6)
+//
+// A dump is the summary, then ID and TIMING for each row in order.
+
+#define CAN_STATS_PACKET_HEADER 0xCC
+#define CAN_STATS_KIND_SUMMARY  0x00
+#define CAN_STATS_KIND_ID       0x01
+#define CAN_STATS_KIND_TIMING   0x02
+#define CAN_STATS_LINK_ROWS     64      // Rows a dump can carry
+#define CAN_STATS_EXTENDED_BIT  0x80000000u
+
+inline void packCanStatsPacket(uint8_t* buffer, uint8_t kind, uint8_t row, const uint8_t* payload) {
+    buffer[0] = CAN_STATS_PACKET_HEADER;
+    buffer[1] = (uint8_t)((kind << 6) | (row & 0x3F));
+    for (int i = 0; i < 5; i++) {
+        buffer[2 + i] = payload[i];
+    }
+    buffer[7] = calculateSpiChecksum(buffer);
+}
+
+inline bool validateCanStatsPacket(const uint8_t* data) {
+    return data[0] == CAN_STATS_PACKET_HEADER && data[7] == calculateSpiChecksum(data);
+}
+
 // Legacy I2C support (can be removed later)
 #define RPM_PACKET_HEADER SPI_PACKET_HEADER
 #define RPM_PACKET_SIZE 4
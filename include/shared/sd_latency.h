@@ -0,0 +1,191 @@
+#ifndef SHARED_SD_LATENCY_H
+#define SHARED_SD_LATENCY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+// =============================================================================
+// SD Latency Statistics (both MCUs)
+// =============================================================================
+//
+// Every card operation is timed into a log-linear histogram for its type:
+// 8 linear buckets per power of two, so any recorded time is known to
+// within 12.5% from 8 us up to 8 s (longer times land in the last bucket).
+// Alongside each histogram are byte and busy-time counters for throughput,
+// and operations slower than a threshold are kept in a small trace ring.
+//
+// The functions here do no locking - each MCU's SD module guards its
+// SdLatencyStats with its own lock and hands out copies.
+
+#define SD_LATENCY_SUB_BITS     3
+#define SD_LATENCY_SUB_BUCKETS  (1 << SD_LATENCY_SUB_BITS)
+#define SD_LATENCY_MAX_BITS     23      // Times up to 2^23 us (8.4 s) are resolved
+#define SD_LATENCY_BUCKETS      ((SD_LATENCY_MAX_BITS - SD_LATENCY_SUB_BITS + 1) * SD_LATENCY_SUB_BUCKETS)
+#define SD_SLOW_TRACE_SIZE      8       // Slow operations remembered
+#define SD_SLOW_PATH_MAX        24      // Tail of the path kept per slow operation
+
+typedef enum {
+    SD_OP_READ,
+    SD_OP_WRITE,
+    SD_OP_OPEN,         // Open / create, including the directory lookup
+    SD_OP_SYNC,         // Flush of buffered writes, close
+    SD_OP_META,         // exists, remove, rename, mkdir, list, allocate
+    SD_OP_TYPES
+} SdOpType;
+
+typedef struct {
+    uint32_t counts[SD_LATENCY_BUCKETS];
+    uint32_t operations;
+    uint32_t errors;
+    uint64_t bytes;
+    uint64_t totalUs;
+    uint32_t maxUs;
+} SdLatencyHistogram;
+
+typedef struct {
+    uint32_t timeMs;            // When it finished (millis)
+    uint32_t us;
+    uint32_t bytes;
+    uint8_t op;
+    bool failed;
+    char path[SD_SLOW_PATH_MAX];
+} SdSlowOp;
+
+typedef struct {
+    SdLatencyHistogram ops[SD_OP_TYPES];
+    SdSlowOp slow[SD_SLOW_TRACE_SIZE];  // Ring, slowCount % SIZE is next
+    uint32_t slowCount;
+    uint32_t sinceMs;                   // Start of the measurement (millis)
+} SdLatencyStats;
+
+inline const char* sdOpName(uint8_t op) {
+    static const char* const names[SD_OP_TYPES] = {"read", "write", "open", "sync", "meta"};
+    return op < SD_OP_TYPES ? names[op] : "?";
+}
+
+// =============================================================================
+// Buckets
+// =============================================================================
+
+inline uint32_t sdLatencyBucket(uint32_t us) {
+    if (us < SD_LATENCY_SUB_BUCKETS) return us;
+    uint32_t msb = 31 - __builtin_clz(us);
+    if (msb >= SD_LATENCY_MAX_BITS) return SD_LATENCY_BUCKETS - 1;
+    uint32_t sub = (us >> (msb - SD_LATENCY_SUB_BITS)) & (SD_LATENCY_SUB_BUCKETS - 1);
+    return (msb - SD_LATENCY_SUB_BITS + 1) * SD_LATENCY_SUB_BUCKETS + sub;
+}
+
+// Smallest time that lands in bucket
+inline uint32_t sdLatencyBucketStart(uint32_t bucket) {
+    if (bucket < SD_LATENCY_SUB_BUCKETS) return bucket;
+    uint32_t msb = bucket / SD_LATENCY_SUB_BUCKETS + SD_LATENCY_SUB_BITS - 1;
+    uint32_t sub = bucket % SD_LATENCY_SUB_BUCKETS;
+    return (SD_LATENCY_SUB_BUCKETS + sub) << (msb - SD_LATENCY_SUB_BITS);
+}
+
+// =============================================================================
+// Recording
+// =============================================================================
+
+inline void sdLatencyReset(SdLatencyStats* stats, uint32_t nowMs) {
+    memset(stats, 0, sizeof(SdLatencyStats));
+    stats->sinceMs = nowMs;
+}
+
+inline void sdLatencyRecord(SdLatencyStats* stats, SdOpType op, uint32_t us, uint32_t bytes,
+                            bool ok, const char* path, uint32_t nowMs, uint32_t slowUs) {
+    SdLatencyHistogram& h = stats->ops[op];
+    h.counts[sdLatencyBucket(us)]++;
+    h.operations++;
+    if (!ok) h.errors++;
+    h.bytes += bytes;
+    h.totalUs += us;
+    if (us > h.maxUs) h.maxUs = us;
+
+    if (us < slowUs) return;
+    SdSlowOp& slow = stats->slow[stats->slowCount % SD_SLOW_TRACE_SIZE];
+    stats->slowCount++;
+    slow.timeMs = nowMs;
+    slow.us = us;
+    slow.bytes = bytes;
+    slow.op = (uint8_t)op;
+    slow.failed = !ok;
+    // Keep the end of long paths, it names the file
+    size_t length = path ? strlen(path) : 0;
+    const char* tail = length >= SD_SLOW_PATH_MAX ? path + length - (SD_SLOW_PATH_MAX - 1) : path;
+    snprintf(slow.path, sizeof(slow.path), "%s", tail ? tail : "");
+}
+
+// =============================================================================
+// Reporting
+// =============================================================================
+
+// Time below which `percent` of the operations finished (start of the
+// bucket holding that rank, so within 12.5% below the true value)
+inline uint32_t sdLatencyPercentile(const SdLatencyHistogram* h, uint32_t percent) {
+    if (h->operations == 0) return 0;
+    uint64_t rank = ((uint64_t)h->operations * percent + 99) / 100;
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < SD_LATENCY_BUCKETS; b++) {
+        seen += h->counts[b];
+        if (seen >= rank) return sdLatencyBucketStart(b);
+    }
+    return h->maxUs;
+}
+
+// Card transfer rate while busy with this operation type, in KB/s
+inline uint32_t sdLatencyThroughputKBps(const SdLatencyHistogram* h) {
+    if (h->totalUs == 0) return 0;
+    return (uint32_t)(h->bytes * 1000000ULL / 1024 / h->totalUs);
+}
+
+// Short time for displays: "850us", "12.4ms", "1.2s"
+inline void sdLatencyFormatTime(uint32_t us, char* out, size_t size) {
+    if (us < 1000) {
+        snprintf(out, size, "%luus", (unsigned long)us);
+    } else if (us < 1000000) {
+        snprintf(out, size, "%lu.%lums", (unsigned long)(us / 1000), (unsigned long)(us % 1000 / 100));
+    } else {
+        snprintf(out, size, "%lu.%lus", (unsigned long)(us / 1000000), (unsigned long)(us % 1000000 / 100000));
+    }
+}
+
+// One line per operation type:
+// "read    1234 ops  0 err  p50 850us  p99 12.4ms  max 40.1ms  1875 KB/s  2048 KB"
+inline void sdLatencyFormatLine(const SdLatencyHistogram* h, uint8_t op, char* out, size_t size) {
+    char p50[12], p99[12], max[12];
+    sdLatencyFormatTime(sdLatencyPercentile(h, 50), p50, sizeof(p50));
+    sdLatencyFormatTime(sdLatencyPercentile(h, 99), p99, sizeof(p99));
+    sdLatencyFormatTime(h->maxUs, max, sizeof(max));
+    snprintf(out, size, "%-5s %7lu ops %4lu err  p50 %-7s p99 %-7s max %-7s %5lu KB/s %8lu KB",
+             sdOpName(op), (unsigned long)h->operations, (unsigned long)h->errors,
+             p50, p99, max, (unsigned long)sdLatencyThroughputKBps(h),
+             (unsigned long)(h->bytes / 1024));
+}
+
+// Summary for small screens: "850us/12.4ms 1875KB/s" (p50/p99, throughput)
+inline void sdLatencyFormatShort(const SdLatencyHistogram* h, char* out, size_t size) {
+    if (h->operations == 0) {
+        snprintf(out, size, "-");
+        return;
+    }
+    char p50[12], p99[12];
+    sdLatencyFormatTime(sdLatencyPercentile(h, 50), p50, sizeof(p50));
+    sdLatencyFormatTime(sdLatencyPercentile(h, 99), p99, sizeof(p99));
+    snprintf(out, size, "%s/%s %luKB/s", p50, p99, (unsigned long)sdLatencyThroughputKBps(h));
+}
+
+// "12345 ms  write  84.2ms  8192 B  /vmem_swap.bin" (failed ops are marked)
+inline void sdLatencyFormatSlow(const SdSlowOp* slow, char* out, size_t size) {
+    char time[12];
+    sdLatencyFormatTime(slow->us, time, sizeof(time));
+    snprintf(out, size, "%8lu ms  %-5s %7s %6lu B  %s%s",
+             (unsigned long)slow->timeMs, sdOpName(slow->op), time,
+             (unsigned long)slow->bytes, slow->path, slow->failed ? "  FAILED" : "");
+}
+
+#endif // SHARED_SD_LATENCY_H
@@ -47,6 +47,29 @@ uint8_t spiSlaveGetRequestedMode();
 void spiSlaveSetRequestedRpm(uint16_t rpm);
 uint16_t spiSlaveGetRequestedRpm();
 
+// CAN bus statistics dumped by the master (CAN_STATS_* packets in protocol.h)
+typedef struct {
+    uint32_t id;
+    bool extended;
+    uint8_t changed;            // Bit n: byte n has changed
+    uint32_t periodUs;          // 100 us resolution
+    uint32_t jitterUs;          // 10 us resolution
+    uint8_t dlc;
+    bool rtr;
+} SpiCanStatsRow;
+
+typedef struct {
+    float load;                 // Master's last whole second, 0..1
+    uint32_t ids;               // On the bus (255 means at least)
+    uint32_t framesPerSec;
+    uint32_t rows;              // Complete rows received
+    unsigned long receivedMs;   // millis() of the summary
+} SpiCanStats;
+
+// False if no dump has been received
+bool spiSlaveGetCanStats(SpiCanStats* stats);
+bool spiSlaveGetCanStatsRow(uint32_t row, SpiCanStatsRow* out);
+
 // Check if we just reconnected (returns true once, then resets)
 // Use this to force display refresh on reconnection
 bool spiSlaveCheckReconnected();
@@ -0,0 +1,332 @@
+#include "master/black_box.h"
+#include "master/sd_handler.h"
+#include "master/sd_io.h"
+#include "tasks.h"
+#include "shared/config.h"
+#include "shared/protocol.h"
+#include <Arduino.h>
+#include <esp_attr.h>
+#include <esp_heap_caps.h>
+#include <esp_system.h>
+#include <stdlib.h>
+#include <string.h>
+
+// One pump period of state, 12 bytes
+typedef struct __attribute__((packed)) {
+    uint32_t timeMs;
+    uint16_t targetRpm;
+    int16_t waterTempF10;
+    uint16_t spiAgeMs;          // Since the last good exchange, saturating
+    uint8_t pwmDuty;
+    uint8_t state;              // See STATE_* below
+} BlackBoxSampleEntry;
+
+typedef struct __attribute__((packed)) {
+    uint32_t timeMs;
+    uint16_t event;
+    uint16_t arg;
+} BlackBoxEventEntry;
+
+// health bits 0-1, water status 2-3, display mode 4, op mode 5-6
+#define STATE_PACK(health, water, display, op) \
+    (uint8_t)(((health) & 3) | (((water) & 3) << 2) | (((display) & 1) << 4) | (((op) & 3) << 5))
+#define STATE_HEALTH(s)     ((s) & 3)
+#define STATE_WATER(s)      (((s) >> 2) & 3)
+#define STATE_DISPLAY(s)    (((s) >> 4) & 1)
+#define STATE_OP(s)         (((s) >> 5) & 3)
+
+typedef struct {
+    uint32_t magic;
+    uint16_t sampleNext;
+    uint16_t sampleCount;
+    uint16_t eventNext;
+    uint16_t eventCount;
+    BlackBoxSampleEntry samples[BLACKBOX_SAMPLES];
+    BlackBoxEventEntry events[BLACKBOX_EVENTS];
+} BlackBoxRing;
+
+// A firmware with another ring layout does not trust this one
+#define BLACKBOX_MAGIC  (0xB1AC0B00 ^ (uint32_t)sizeof(BlackBoxRing))
+
+// Row text is at most ~60 characters
+#define BLACKBOX_DUMP_BYTES (256 + (BLACKBOX_SAMPLES + BLACKBOX_EVENTS) * 64)
+
+// Survives panic and watchdog resets (not power loss)
+RTC_NOINIT_ATTR static BlackBoxRing ring;
+
+static portMUX_TYPE eventMux = portMUX_INITIALIZER_UNLOCKED;
+static volatile bool frozen = false;
+static volatile uint16_t triggerCountdown = 0;  // Samples left before freezing
+static volatile bool dumpInFlight = false;
+static bool fromCrash = false;                  // Rings are from before the last reset
+static uint16_t dumpEvent = BLACKBOX_EVENT_BOOT;
+static uint16_t dumpArg = 0;
+static uint32_t dumpTimeMs = 0;
+
+static BlackBoxStats stats;
+static volatile uint32_t dumpsWritten = 0;      // Counted on the SD I/O task
+static volatile uint32_t dumpsFailed = 0;
+
+static const char* const EVENT_NAMES[BLACKBOX_EVENT_COUNT] = {
+    "BOOT", "FAILSAFE", "FAILSAFE_CLEAR", "HEALTH", "DISPLAY_MODE", "OP_MODE",
+    "WATER_STATUS", "MANUAL"
+};
+
+// =============================================================================
+// Rings
+// =============================================================================
+
+static void clearRing() {
+    ring.sampleNext = 0;
+    ring.sampleCount = 0;
+    ring.eventNext = 0;
+    ring.eventCount = 0;
+    ring.magic = BLACKBOX_MAGIC;
+}
+
+static bool ringValid() {
+    return ring.magic == BLACKBOX_MAGIC &&
+           ring.sampleNext < BLACKBOX_SAMPLES && ring.sampleCount <= BLACKBOX_SAMPLES &&
+           ring.eventNext < BLACKBOX_EVENTS && ring.eventCount <= BLACKBOX_EVENTS;
+}
+
+static void appendEvent(BlackBoxEvent event, uint16_t arg) {
+    BlackBoxEventEntry* entry = &ring.events[ring.eventNext];
+    entry->timeMs = millis();
+    entry->event = event;
+    entry->arg = arg;
+    ring.eventNext = ring.eventNext + 1 == BLACKBOX_EVENTS ? 0 : ring.eventNext + 1;
+    if (ring.eventCount < BLACKBOX_EVENTS) ring.eventCount++;
+    stats.events++;
+}
+
+static void resume() {
+    if (fromCrash) {
+        // Times in the old rings are from the previous boot
+        fromCrash = false;
+        clearRing();
+        portENTER_CRITICAL(&eventMux);
+        appendEvent(BLACKBOX_EVENT_BOOT, (uint16_t)esp_reset_reason());
+        portEXIT_CRITICAL(&eventMux);
+    }
+    frozen = false;
+}
+
+// =============================================================================
+// Dump
+// =============================================================================
+
+// CSV of both rings merged in time order; the rings must be frozen
+static size_t formatDump(char* text, size_t size) {
+    size_t length = 0;
+    auto put = [&](int n) {
+        if (n > 0) length += (size_t)n < size - length ? (size_t)n : size - length - 1;
+    };
+
+    uint32_t sampleCount = ring.sampleCount;
+    uint32_t sample = sampleCount == BLACKBOX_SAMPLES ? ring.sampleNext : 0;
+    if (fromCrash && sampleCount == BLACKBOX_SAMPLES) {
+        // The oldest slot may be half overwritten by the sample the reset cut short
+        sample = sample + 1 == BLACKBOX_SAMPLES ? 0 : sample + 1;
+        sampleCount--;
+    }
+    uint32_t eventCount = ring.eventCount;
+    uint32_t event = eventCount == BLACKBOX_EVENTS ? ring.eventNext : 0;
+
+    if (fromCrash) {
+        put(snprintf(text + length, size - length,
+                     "# Black box %lu: kept over a reset (reason %u), times from the previous boot\n",
+                     (unsigned long)stats.dumps + 1, dumpArg));
+    } else {
+        put(snprintf(text + length, size - length, "# Black box %lu: %s (%u) at %lu ms\n",
+                     (unsigned long)stats.dumps + 1, EVENT_NAMES[dumpEvent], dumpArg,
+                     (unsigned long)dumpTimeMs));
+    }
+    put(snprintf(text + length, size - length,
+                 "time_ms,event,arg,target_rpm,pwm_duty,water_temp_f,water_status,health,"
+                 "display_mode,op_mode,spi_age_ms\n"));
+
+    while (sampleCount > 0 || eventCount > 0) {
+        const BlackBoxSampleEntry* s = sampleCount > 0 ? &ring.samples[sample] : nullptr;
+        const BlackBoxEventEntry* e = eventCount > 0 ? &ring.events[event] : nullptr;
+        // Events first on equal times: they explain the sample that follows
+        if (e && (!s || (int32_t)(e->timeMs - s->timeMs) <= 0)) {
+            put(snprintf(text + length, size - length, "%lu,%s,%u,,,,,,,,\n",
+                         (unsigned long)e->timeMs,
+                         e->event < BLACKBOX_EVENT_COUNT ? EVENT_NAMES[e->event] : "?", e->arg));
+            event = event + 1 == BLACKBOX_EVENTS ? 0 : event + 1;
+            eventCount--;
+            continue;
+        }
+        char water[8] = "";
+        if (s->waterTempF10 != WATER_TEMP_INVALID) {
+            snprintf(water, sizeof(water), "%d.%d", s->waterTempF10 / 10, abs(s->waterTempF10 % 10));
+        }
+        put(snprintf(text + length, size - length, "%lu,,,%u,%u,%s,%u,%u,%u,%u,%u\n",
+                     (unsigned long)s->timeMs, s->targetRpm, s->pwmDuty, water,
+                     STATE_WATER(s->state), STATE_HEALTH(s->state), STATE_DISPLAY(s->state),
+                     STATE_OP(s->state), s->spiAgeMs));
+        sample = sample + 1 == BLACKBOX_SAMPLES ? 0 : sample + 1;
+        sampleCount--;
+    }
+    return length;
+}
+
+// Runs on the SD I/O task
+static void onDumpWritten(int32_t result, void* context) {
+    if (result < 0) {
+        dumpsFailed++;
+    } else {
+        dumpsWritten++;
+    }
+    free(context);
+    dumpInFlight = false;
+}
+
+// =============================================================================
+// Public API
+// =============================================================================
+
+void blackBoxInit() {
+    memset(&stats, 0, sizeof(stats));
+    esp_reset_reason_t reason = esp_reset_reason();
+    bool abnormal = reason == ESP_RST_PANIC || reason == ESP_RST_INT_WDT ||
+                    reason == ESP_RST_TASK_WDT || reason == ESP_RST_WDT ||
+                    reason == ESP_RST_BROWNOUT;
+
+    if (abnormal && ringValid() && ring.sampleCount > 0) {
+        fromCrash = true;
+        frozen = true;
+        dumpEvent = BLACKBOX_EVENT_BOOT;
+        dumpArg = (uint16_t)reason;
+        Serial.printf("Black box: %u samples, %u events from before the reset kept for a dump\n",
+                      ring.sampleCount, ring.eventCount);
+        return;
+    }
+
+    clearRing();
+    appendEvent(BLACKBOX_EVENT_BOOT, (uint16_t)reason);
+    Serial.printf("Black box: %u samples (%u ms) + %u events in RTC memory\n",
+                  BLACKBOX_SAMPLES, BLACKBOX_SAMPLES * PUMP_TASK_PERIOD_MS, BLACKBOX_EVENTS);
+}
+
+void blackBoxSample(uint32_t nowMs) {
+    uint32_t start = ESP.getCycleCount();
+    if (frozen) {
+        stats.skipped++;
+        return;
+    }
+
+    BlackBoxSampleEntry* entry = &ring.samples[ring.sampleNext];
+    entry->timeMs = nowMs;
+    entry->targetRpm = masterState.currentRpm;
+    entry->waterTempF10 = masterState.waterTempF10;
+    uint32_t age = nowMs - masterState.lastValidSpiTime;
+    entry->spiAgeMs = age > UINT16_MAX ? UINT16_MAX : (uint16_t)age;
+    entry->pwmDuty = masterState.currentPwmDuty;
+    entry->state = STATE_PACK(masterState.health, masterState.waterStatus,
+                              masterState.displayMode, masterState.opMode);
+    // Advance only once the entry is complete
+    ring.sampleNext = ring.sampleNext + 1 == BLACKBOX_SAMPLES ? 0 : ring.sampleNext + 1;
+    if (ring.sampleCount < BLACKBOX_SAMPLES) ring.sampleCount++;
+    stats.samples++;
+
+    // Frozen goes up before the countdown reaches 0, so a trigger never
+    // sees both clear in between
+    if (triggerCountdown > 0) {
+        if (triggerCountdown == 1) frozen = true;
+        triggerCountdown = triggerCountdown - 1;
+    }
+
+    uint32_t cycles = ESP.getCycleCount() - start;
+    stats.sampleCycles = cycles;
+    stats.totalSampleCycles += cycles;
+    if (cycles > stats.maxSampleCycles) {
+        stats.maxSampleCycles = cycles;
+    }
+}
+
+void blackBoxEvent(BlackBoxEvent event, uint16_t arg) {
+    portENTER_CRITICAL(&eventMux);
+    if (frozen) {
+        stats.skipped++;
+    } else {
+        appendEvent(event, arg);
+    }
+    portEXIT_CRITICAL(&eventMux);
+}
+
+void blackBoxTrigger(BlackBoxEvent event, uint16_t arg) {
+    portENTER_CRITICAL(&eventMux);
+    if (frozen || triggerCountdown > 0) {
+        stats.skipped++;
+    } else {
+        appendEvent(event, arg);
+        dumpEvent = event;
+        dumpArg = arg;
+        dumpTimeMs = millis();
+        triggerCountdown = BLACKBOX_POST_SAMPLES > 0 ? BLACKBOX_POST_SAMPLES : 1;
+    }
+    portEXIT_CRITICAL(&eventMux);
+}
+
+void blackBoxProcess() {
+    if (!frozen || dumpInFlight) return;
+
+    char* text = (char*)heap_caps_malloc(BLACKBOX_DUMP_BYTES, MALLOC_CAP_SPIRAM);
+    if (!text) {
+        text = (char*)malloc(BLACKBOX_DUMP_BYTES);
+    }
+    if (!text) {
+        Serial.println("Black box: No memory for a dump, discarded");
+        stats.dumpErrors++;
+        resume();
+        return;
+    }
+    size_t length = formatDump(text, BLACKBOX_DUMP_BYTES);
+    const char* what = fromCrash ? "reset" : EVENT_NAMES[dumpEvent];
+    stats.dumps++;
+
+    // The text is a copy, so recording can go on while the card writes it
+    resume();
+
+    if (sdIsReady()) {
+        dumpInFlight = true;
+        if (sdIoAppend(BLACKBOX_PATH, text, length, SD_IO_SAFETY, onDumpWritten, text)) {
+            Serial.printf("Black box: %s dump (%u bytes) queued to %s\n",
+                          what, (unsigned)length, BLACKBOX_PATH);
+            return;
+        }
+        dumpInFlight = false;
+        stats.dumpErrors++;
+    }
+
+    // No card, or the queue is full of safety logs: the console is all that is left
+    Serial.printf("Black box: %s dump, not saved to SD\n", what);
+    Serial.write((const uint8_t*)text, length);
+    free(text);
+}
+
+void blackBoxGetStats(BlackBoxStats* out) {
+    *out = stats;
+    out->dumpErrors += dumpsFailed;
+}
+
+void blackBoxPrintStats() {
+    BlackBoxStats s;
+    blackBoxGetStats(&s);
+    uint32_t mhz = getCpuFrequencyMhz();
+
+    Serial.printf("Black box: %s, %u/%u samples, %u/%u events held\n",
+                  frozen ? "frozen for a dump" : triggerCountdown > 0 ? "triggered" : "recording",
+                  ring.sampleCount, BLACKBOX_SAMPLES, ring.eventCount, BLACKBOX_EVENTS);
+    Serial.printf("  %lu samples, %lu events, %lu skipped while frozen\n",
+                  s.samples, s.events, s.skipped);
+    Serial.printf("  %lu dumps (%lu written to %s), %lu errors\n",
+                  s.dumps, (unsigned long)dumpsWritten, BLACKBOX_PATH, s.dumpErrors);
+    if (s.samples > 0) {
+        Serial.printf("  Sample cost: %lu cycles last, %llu avg, %lu max (%lu ns max)\n",
+                      s.sampleCycles, s.totalSampleCycles / s.samples, s.maxSampleCycles,
+                      s.maxSampleCycles * 1000 / mhz);
+    }
+}
@@ -0,0 +1,328 @@
+#include "master/can_bus_stats.h"
+#include <string.h>
+
+#define KEY_EXTENDED    0x20000000u
+#define KEY_USED        0x40000000u
+#define SECOND_US       1000000ULL
+
+// =============================================================================
+// Frame Length
+// =============================================================================
+
+// The frame is packed MSB first, then the CRC and the stuffing walk it a
+// byte at a time through tables; the few bits past the last whole byte go
+// one by one. Stuffing state: the last bit and how many of it in a row
+// (1-4, a fifth takes a stuff bit), 8 states plus the start.
+#define STUFF_START     8
+#define STUFF_STATES    9
+
+typedef struct {
+    uint16_t crc[256];
+    uint8_t stuff[STUFF_STATES][256];   // Next state | stuff bits << 4
+} WireTables;
+
+static uint16_t crcBit(uint16_t crc, uint8_t bit) {
+    uint8_t feedback = bit ^ ((crc >> 14) & 1);
+    crc = (uint16_t)((crc << 1) & 0x7FFF);
+    return feedback ? crc ^ 0x4599 : crc;
+}
+
+// Five equal bits take a stuff bit of the other value, which starts the
+// next run
+static uint8_t stuffBit(uint8_t state, uint8_t bit, uint32_t* stuffBits) {
+    if (state != STUFF_START && (state >> 2) == bit) {
+        uint8_t run = (state & 3) + 2;
+        if (run < 5) {
+            return (uint8_t)((bit << 2) | (run - 1));
+        }
+        (*stuffBits)++;
+        return (uint8_t)(!bit << 2);
+    }
+    return (uint8_t)(bit << 2);
+}
+
+static WireTables buildTables() {
+    WireTables t;
+    for (uint32_t byte = 0; byte < 256; byte++) {
+        // Byte fed into a zero register, for a register whose top 8 bits are byte
+        uint16_t crc = 0;
+        for (int i = 7; i >= 0; i--) {
+            crc = crcBit(crc, (byte >> i) & 1);
+        }
+        t.crc[byte] = crc;
+        for (uint8_t state = 0; state < STUFF_STATES; state++) {
+            uint8_t next = state;
+            uint32_t stuffBits = 0;
+            for (int i = 7; i >= 0; i--) {
+                next = stuffBit(next, (byte >> i) & 1, &stuffBits);
+            }
+            t.stuff[state][byte] = (uint8_t)(next | (stuffBits << 4));
+        }
+    }
+    return t;
+}
+
+typedef struct {
+    uint8_t bytes[18];          // 133 bits at most (extended, 8 bytes, CRC)
+    uint32_t bits;
+    uint32_t pending;           // Bits not yet in bytes
+    uint32_t pendingCount;
+} BitPacker;
+
+static void packBits(BitPacker* p, uint32_t value, uint32_t count) {
+    p->pending = (p->pending << count) | (value & ((1u << count) - 1));
+    p->pendingCount += count;
+    p->bits += count;
+    while (p->pendingCount >= 8) {
+        p->pendingCount -= 8;
+        p->bytes[(p->bits - p->pendingCount) / 8 - 1] = (uint8_t)(p->pending >> p->pendingCount);
+    }
+}
+
+// The bits short of a byte, left aligned in the next byte
+static void packTail(BitPacker* p) {
+    if (p->pendingCount > 0) {
+        p->bytes[p->bits / 8] = (uint8_t)(p->pending << (8 - p->pendingCount));
+    }
+}
+
+// CRC-15 of the first count bits
+static uint16_t packedCrc(const WireTables& t, const BitPacker& p, uint32_t count) {
+    uint16_t crc = 0;
+    uint32_t whole = count / 8;
+    for (uint32_t i = 0; i < whole; i++) {
+        crc = (uint16_t)(((crc << 8) & 0x7FFF) ^ t.crc[((crc >> 7) ^ p.bytes[i]) & 0xFF]);
+    }
+    for (uint32_t i = whole * 8; i < count; i++) {
+        crc = crcBit(crc, (p.bytes[i / 8] >> (7 - i % 8)) & 1);
+    }
+    return crc;
+}
+
+uint32_t canFrameBits(const CanFrame& frame) {
+    static const WireTables tables = buildTables();
+
+    bool rtr = (frame.flags & CAN_FRAME_RTR) != 0;
+    uint8_t dlc = frame.dlc > 8 ? 8 : frame.dlc;
+
+    BitPacker p;
+    p.bits = 0;
+    p.pending = 0;
+    p.pendingCount = 0;
+    if (frame.flags & CAN_FRAME_EXTENDED) {
+        // SOF, base ID, SRR, IDE, then the extension, RTR, r1, r0
+        packBits(&p, ((frame.id >> 18) & 0x7FF) << 2 | 0x3, 14);
+        packBits(&p, (frame.id & 0x3FFFF) << 3 | (rtr ? 4 : 0), 21);
+    } else {
+        // SOF, ID, RTR, IDE, r0
+        packBits(&p, (frame.id & 0x7FF) << 3 | (rtr ? 4 : 0), 15);
+    }
+    packBits(&p, dlc, 4);
+    if (!rtr) {
+        for (uint8_t i = 0; i < dlc; i++) {
+            packBits(&p, frame.data[i], 8);
+        }
+    }
+    packTail(&p);
+    packBits(&p, packedCrc(tables, p, p.bits), 15);
+    packTail(&p);
+
+    uint32_t stuffBits = 0;
+    uint8_t state = STUFF_START;
+    uint32_t whole = p.bits / 8;
+    for (uint32_t i = 0; i < whole; i++) {
+        uint8_t next = tables.stuff[state][p.bytes[i]];
+        stuffBits += next >> 4;
+        state = next & 0x0F;
+    }
+    for (uint32_t i = whole * 8; i < p.bits; i++) {
+        state = stuffBit(state, (p.bytes[i / 8] >> (7 - i % 8)) & 1, &stuffBits);
+    }
+
+    // CRC delimiter, ACK slot and delimiter, end of frame, interframe space
+    return p.bits + stuffBits + 1 + 2 + 7 + 3;
+}
+
+// =============================================================================
+// Table
+// =============================================================================
+
+static uint32_t statsKey(uint32_t id, bool extended) {
+    return (id & 0x1FFFFFFF) | (extended ? KEY_EXTENDED : 0) | KEY_USED;
+}
+
+static uint32_t statsHome(uint32_t key) {
+    return (key * 2654435761u) >> 24;   // Top 8 bits: CAN_STATS_SLOTS
+}
+
+CanBusStats::CanBusStats() : _bitrate(500000) {
+    reset();
+}
+
+void CanBusStats::reset() {
+    memset(_key, 0, sizeof(_key));
+    memset(_entries, 0, sizeof(_entries));
+    memset(&_summary, 0, sizeof(_summary));
+    _secondStartUs = 0;
+    _secondBits = 0;
+    _secondFrames = 0;
+    _probes = 0;
+}
+
+int32_t CanBusStats::slot(uint32_t key) const {
+    for (uint32_t i = statsHome(key), n = 0; n < CAN_STATS_SLOTS;
+         i = (i + 1) & (CAN_STATS_SLOTS - 1), n++) {
+        if (_key[i] == key) {
+            return (int32_t)i;
+        }
+        if (_key[i] == 0) {
+            break;
+        }
+    }
+    return -1;
+}
+
+// Rounded, so the averages settle on the mean rather than below it
+static int64_t ewmaStep(int64_t difference, uint32_t shift) {
+    int64_t half = (int64_t)1 << (shift - 1);
+    return difference >= 0 ? (difference + half) >> shift : -((-difference + half) >> shift);
+}
+
+void CanBusStats::add(const CanFrame& frame, uint32_t bits) {
+    if (bits == 0) {
+        bits = canFrameBits(frame);
+    }
+    if (_summary.frames == 0) {
+        _summary.startUs = frame.timeUs;
+        _secondStartUs = frame.timeUs;
+    } else {
+        tick(frame.timeUs);
+    }
+    _summary.frames++;
+    _summary.bits += bits;
+    _summary.lastUs = frame.timeUs;
+    _secondBits += bits;
+    _secondFrames++;
+
+    bool extended = (frame.flags & CAN_FRAME_EXTENDED) != 0;
+    bool rtr = (frame.flags & CAN_FRAME_RTR) != 0;
+    uint8_t dlc = frame.dlc > 8 ? 8 : frame.dlc;
+    uint8_t data[8] = {0};
+    if (!rtr) {
+        memcpy(data, frame.data, dlc);
+    }
+
+    uint32_t key = statsKey(frame.id, extended);
+    for (uint32_t i = statsHome(key), n = 0; n < CAN_STATS_SLOTS;
+         i = (i + 1) & (CAN_STATS_SLOTS - 1), n++) {
+        _probes++;
+        CanIdStats& e = _entries[i];
+        if (_key[i] == key) {
+            uint64_t elapsed = frame.timeUs > e.lastUs ? frame.timeUs - e.lastUs : 0;
+            uint32_t interval = elapsed > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed;
+            if (e.frames == 1) {
+                e.periodUs = interval;
+            } else {
+                int64_t deviation = (int64_t)interval - e.periodUs;
+                int64_t size = deviation < 0 ? -deviation : deviation;
+                e.jitterUs = (uint32_t)(e.jitterUs + ewmaStep(size - e.jitterUs, CAN_STATS_JITTER_SHIFT));
+                e.periodUs = (uint32_t)(e.periodUs + ewmaStep(deviation, CAN_STATS_EWMA_SHIFT));
+            }
+            if (interval < e.minIntervalUs) e.minIntervalUs = interval;
+            if (interval > e.maxIntervalUs) e.maxIntervalUs = interval;
+
+            for (uint32_t b = 0; b < 8; b++) {
+                if (data[b] != e.data[b]) {
+                    e.changed |= (uint8_t)(1u << b);
+                }
+            }
+            if ((dlc != e.dlc || rtr != e.rtr) && e.dlcChanges < UINT8_MAX) {
+                e.dlcChanges++;
+            }
+            e.frames++;
+            e.lastUs = frame.timeUs;
+            e.dlc = dlc;
+            e.rtr = rtr;
+            memcpy(e.data, data, sizeof(e.data));
+            return;
+        }
+        if (_key[i] == 0) {
+            // Stop at half full so probes stay short
+            if (_summary.ids >= CAN_STATS_SLOTS / 2) {
+                break;
+            }
+            _key[i] = key;
+            memset(&e, 0, sizeof(e));
+            e.id = frame.id & 0x1FFFFFFF;
+            e.extended = extended;
+            e.frames = 1;
+            e.firstUs = frame.timeUs;
+            e.lastUs = frame.timeUs;
+            e.minIntervalUs = UINT32_MAX;
+            e.dlc = dlc;
+            e.rtr = rtr;
+            memcpy(e.data, data, sizeof(e.data));
+            _summary.ids++;
+            return;
+        }
+    }
+    _summary.untracked++;
+}
+
+// =============================================================================
+// Bus Load
+// =============================================================================
+
+// The second that started at _secondStartUs is over
+void CanBusStats::closeSecond(uint64_t nowUs) {
+    _summary.load = _bitrate > 0 ? (float)_secondBits / _bitrate : 0.0f;
+    _summary.framesPerSec = _secondFrames;
+    if (_summary.load > _summary.peakLoad) {
+        _summary.peakLoad = _summary.load;
+    }
+    _secondBits = 0;
+    _secondFrames = 0;
+
+    // Seconds with no frame at all
+    uint64_t seconds = (nowUs - _secondStartUs) / SECOND_US;
+    if (seconds > 1) {
+        _summary.load = 0;
+        _summary.framesPerSec = 0;
+    }
+    _secondStartUs += seconds * SECOND_US;
+}
+
+void CanBusStats::tick(uint64_t nowUs) {
+    if (_summary.frames > 0 && nowUs >= _secondStartUs + SECOND_US) {
+        closeSecond(nowUs);
+    }
+}
+
+float CanBusStats::averageLoad() const {
+    uint64_t elapsed = _summary.lastUs - _summary.startUs;
+    if (_bitrate == 0 || elapsed == 0) {
+        return 0.0f;
+    }
+    return (float)((double)_summary.bits * SECOND_US / elapsed / _bitrate);
+}
+
+// =============================================================================
+// Queries
+// =============================================================================
+
+bool CanBusStats::entry(uint32_t index, CanIdStats* stats) const {
+    if (index >= CAN_STATS_SLOTS || _key[index] == 0) {
+        return false;
+    }
+    *stats = _entries[index];
+    return true;
+}
+
+bool CanBusStats::find(uint32_t id, bool extended, CanIdStats* stats) const {
+    int32_t i = slot(statsKey(id, extended));
+    if (i < 0) {
+        return false;
+    }
+    *stats = _entries[i];
+    return true;
+}
@@ -0,0 +1,305 @@
+#include "master/can_capture.h"
+#include "master/sd_handler.h"
+#include "master/sd_io.h"
+#include "shared/config.h"
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <freertos/queue.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CAN_CAPTURE_PATH_MAX    24
+
+// A block handed to the SD I/O task, one per buffer
+typedef struct {
+    char path[CAN_CAPTURE_PATH_MAX];
+    uint8_t buffer;
+} BlockWrite;
+
+static CanCaptureWriter writer;
+static uint8_t* buffers[CAN_CAPTURE_BUFFERS];
+static uint32_t bufferCount = 0;
+static BlockWrite writes[CAN_CAPTURE_BUFFERS];
+static QueueHandle_t releasedQueue = nullptr;   // Buffers back from the SD I/O or Log task
+static QueueHandle_t usbQueue = nullptr;        // Sealed blocks for the Log task
+
+// Sealed blocks the SD I/O queue had no room for yet, oldest first
+static CanCaptureBlock pending[CAN_CAPTURE_BUFFERS];
+static uint32_t pendingCount = 0;
+
+// Set by canCaptureStart(), taken by the CAN RX task
+static volatile CanCaptureSink requestedSink = CAN_CAPTURE_OFF;
+static uint32_t requestedFile = 0;
+static portMUX_TYPE requestMux = portMUX_INITIALIZER_UNLOCKED;
+
+// CAN RX task
+static CanCaptureSink activeSink = CAN_CAPTURE_OFF;
+static uint32_t fileIndex = 0;
+static uint32_t fileBytes = 0;
+static bool fileUsed = false;                   // fileIndex has blocks on their way
+static uint32_t overrunBase = 0;
+static uint32_t overruns = 0;
+static uint64_t startUs = 0;
+
+static volatile uint32_t writeErrors = 0;       // Counted on the SD I/O and Log tasks
+
+// =============================================================================
+// Sinks
+// =============================================================================
+
+static void capturePath(uint32_t index, char* path, size_t size) {
+    snprintf(path, size, CAN_CAPTURE_DIR "/%05lu.cap", (unsigned long)index);
+}
+
+static bool findLastFile(const char* name, bool isDirectory, size_t size, void* userData) {
+    uint32_t* last = (uint32_t*)userData;
+    char* end;
+    unsigned long index = strtoul(name, &end, 10);
+    if (!isDirectory && end != name && strcmp(end, ".cap") == 0 && index + 1 > *last) {
+        *last = index + 1;
+    }
+    return true;
+}
+
+// Runs on the SD I/O task
+static void onBlockWritten(int32_t result, void* context) {
+    BlockWrite* write = (BlockWrite*)context;
+    if (result < 0) {
+        writeErrors++;
+    }
+    uint8_t buffer = write->buffer;
+    xQueueSend(releasedQueue, &buffer, 0);
+}
+
+// Append sealed blocks in order, keeping the rest for the next wake when
+// the SD I/O queue is full
+static void submitPending() {
+    uint32_t submitted = 0;
+    while (submitted < pendingCount) {
+        const CanCaptureBlock& block = pending[submitted];
+        if (fileBytes > 0 && fileBytes + block.length > CAN_CAPTURE_FILE_MB * 1024UL * 1024UL) {
+            fileIndex++;
+            fileBytes = 0;
+        }
+        BlockWrite* write = &writes[block.buffer];
+        capturePath(fileIndex, write->path, sizeof(write->path));
+        write->buffer = block.buffer;
+        if (!sdIoAppend(write->path, block.data, block.length, SD_IO_TELEMETRY,
+                        onBlockWritten, write)) {
+            break;
+        }
+        fileBytes += block.length;
+        fileUsed = true;
+        submitted++;
+    }
+    if (submitted > 0) {
+        memmove(pending, pending + submitted, (pendingCount - submitted) * sizeof(CanCaptureBlock));
+        pendingCount -= submitted;
+    }
+}
+
+// The USB queue holds one entry per buffer, so it never refuses a block
+static void submit(const CanCaptureBlock& block) {
+    if (activeSink == CAN_CAPTURE_USB) {
+        xQueueSend(usbQueue, &block, 0);
+    } else {
+        pending[pendingCount++] = block;
+        submitPending();
+    }
+}
+
+static void releaseWritten() {
+    uint8_t buffer;
+    while (xQueueReceive(releasedQueue, &buffer, 0) == pdTRUE) {
+        writer.release(buffer);
+    }
+}
+
+// =============================================================================
+// Capture
+// =============================================================================
+
+// Buffers still out with the sink delay the start
+static bool startCapture(CanCaptureSink sink, uint32_t firstFile, uint64_t nowUs,
+                         uint32_t controllerOverruns) {
+    if (writer.stats().buffersInUse > 0 || pendingCount > 0) {
+        return false;
+    }
+    if (!writer.init(buffers, bufferCount, CAN_CAPTURE_BLOCK_KB * 1024UL)) {
+        return false;
+    }
+    // The directory listing may predate the last capture's final blocks
+    if (sink == CAN_CAPTURE_SD && fileUsed && firstFile <= fileIndex) {
+        firstFile = fileIndex + 1;
+    }
+    writeErrors = 0;
+    fileIndex = firstFile;
+    fileUsed = false;
+    fileBytes = 0;
+    overrunBase = controllerOverruns;
+    overruns = 0;
+    startUs = nowUs;
+    activeSink = sink;
+    return true;
+}
+
+static void stopCapture(uint64_t nowUs) {
+    CanCaptureBlock block;
+    if (writer.flush(nowUs, 0, &block)) {
+        submit(block);
+    }
+    activeSink = CAN_CAPTURE_OFF;
+}
+
+// =============================================================================
+// Public API
+// =============================================================================
+
+bool canCaptureInit() {
+    if (releasedQueue) return true;
+    releasedQueue = xQueueCreate(CAN_CAPTURE_BUFFERS, sizeof(uint8_t));
+    usbQueue = xQueueCreate(CAN_CAPTURE_BUFFERS, sizeof(CanCaptureBlock));
+    if (!releasedQueue || !usbQueue) {
+        Serial.println("CAN capture: Failed to create queues");
+        return false;
+    }
+
+    // PSRAM if present; internal RAM is only worth a minimal double buffer
+    size_t size = CAN_CAPTURE_BLOCK_KB * 1024UL;
+    for (uint32_t i = 0; i < CAN_CAPTURE_BUFFERS; i++) {
+        uint8_t* buffer = (uint8_t*)heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+        if (!buffer && i < 2) {
+            buffer = (uint8_t*)malloc(size);
+        }
+        if (!buffer) break;
+        buffers[bufferCount++] = buffer;
+    }
+    if (bufferCount < 2) {
+        Serial.println("CAN capture: Not enough memory for block buffers");
+        return false;
+    }
+    Serial.printf("CAN capture: %lu x %u KB block buffers\n", bufferCount, (unsigned)(size / 1024));
+    return true;
+}
+
+bool canCaptureStart(CanCaptureSink sink) {
+    if (sink != CAN_CAPTURE_OFF && bufferCount < 2) {
+        return false;
+    }
+
+    uint32_t firstFile = 0;
+    if (sink == CAN_CAPTURE_SD) {
+        if (!sdIsReady()) {
+            return false;
+        }
+        sdMkdir(CAN_CAPTURE_DIR);
+        sdListDir(CAN_CAPTURE_DIR, findLastFile, &firstFile);
+    }
+
+    portENTER_CRITICAL(&requestMux);
+    requestedSink = sink;
+    requestedFile = firstFile;
+    portEXIT_CRITICAL(&requestMux);
+    return true;
+}
+
+CanCaptureSink canCaptureRequested() {
+    return requestedSink;
+}
+
+void canCaptureFrame(const CanFrame& frame) {
+    if (activeSink == CAN_CAPTURE_OFF) {
+        return;
+    }
+    CanCaptureBlock block;
+    if (writer.add(frame, &block)) {
+        submit(block);
+    }
+}
+
+void canCaptureService(uint64_t nowUs, uint32_t controllerOverruns) {
+    if (bufferCount < 2) {
+        return;
+    }
+    releaseWritten();
+    if (pendingCount > 0) {
+        submitPending();
+    }
+
+    CanCaptureSink sink;
+    uint32_t firstFile;
+    portENTER_CRITICAL(&requestMux);
+    sink = requestedSink;
+    firstFile = requestedFile;
+    portEXIT_CRITICAL(&requestMux);
+
+    if (activeSink != CAN_CAPTURE_OFF) {
+        overruns = controllerOverruns - overrunBase;
+        writer.setOverruns(overruns);
+    }
+    if (activeSink != CAN_CAPTURE_OFF && sink != activeSink) {
+        stopCapture(nowUs);
+    }
+    if (activeSink == CAN_CAPTURE_OFF) {
+        if (sink == CAN_CAPTURE_OFF ||
+            !startCapture(sink, firstFile, nowUs, controllerOverruns)) {
+            return;
+        }
+    }
+
+    // A quiet bus still gets its frames out within CAN_CAPTURE_FLUSH_MS
+    CanCaptureBlock block;
+    if (writer.flush(nowUs, CAN_CAPTURE_FLUSH_MS * 1000UL, &block)) {
+        submit(block);
+    }
+}
+
+void canCaptureDrainUsb() {
+    if (usbQueue == nullptr) {
+        return;
+    }
+    CanCaptureBlock block;
+    while (xQueueReceive(usbQueue, &block, 0) == pdTRUE) {
+        if (Serial.write(block.data, block.length) != block.length) {
+            writeErrors++;
+        }
+        xQueueSend(releasedQueue, &block.buffer, 0);
+    }
+}
+
+void canCaptureGetStatus(CanCaptureStatus* status) {
+    status->sink = activeSink;
+    status->fileIndex = fileIndex;
+    status->overruns = overruns;
+    status->writeErrors = writeErrors;
+    status->pending = pendingCount;
+    status->startUs = startUs;
+    status->writer = writer.stats();
+}
+
+void canCapturePrintStats() {
+    CanCaptureStatus s;
+    canCaptureGetStatus(&s);
+
+    if (s.sink == CAN_CAPTURE_OFF) {
+        Serial.printf("CAN capture: Stopped (%s)\n",
+                      requestedSink != CAN_CAPTURE_OFF ? "waiting for buffers" : "off");
+        if (s.writer.frames == 0 && s.writer.dropped == 0) {
+            return;
+        }
+    } else if (s.sink == CAN_CAPTURE_SD) {
+        char path[CAN_CAPTURE_PATH_MAX];
+        capturePath(s.fileIndex, path, sizeof(path));
+        Serial.printf("CAN capture: SD %s, %lu s\n", path,
+                      (unsigned long)((esp_timer_get_time() - s.startUs) / 1000000));
+    } else {
+        Serial.printf("CAN capture: USB, %lu s\n",
+                      (unsigned long)((esp_timer_get_time() - s.startUs) / 1000000));
+    }
+    Serial.printf("  %lu frames, %lu dropped, %lu controller overruns, %lu write errors\n",
+                  s.writer.frames, s.writer.dropped, s.overruns, s.writeErrors);
+    Serial.printf("  %lu blocks, %llu KB, %lu/%lu buffers in use, %lu at most, %lu waiting for the queue\n",
+                  s.writer.blocks, s.writer.bytes / 1024, s.writer.buffersInUse, bufferCount,
+                  s.writer.maxBuffersInUse, s.pending);
+}
@@ -0,0 +1,195 @@
+#include "master/can_capture_log.h"
+#include "shared/ota_protocol.h"
+#include <string.h>
+
+// =============================================================================
+// Format
+// =============================================================================
+
+// CRC register over the records, then the header up to its crc field
+static uint32_t blockCrc(const CanCaptureBlockHeader* header, uint32_t recordsCrc) {
+    return otaCrc32((const uint8_t*)header, sizeof(CanCaptureBlockHeader) - sizeof(uint32_t),
+                    recordsCrc);
+}
+
+uint32_t canCaptureBlockLength(const uint8_t* data, size_t available) {
+    if (available < sizeof(CanCaptureBlockHeader)) {
+        return 0;
+    }
+    CanCaptureBlockHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != CAN_CAPTURE_MAGIC) {
+        return 0;
+    }
+    uint32_t length = sizeof(CanCaptureBlockHeader) + header.recordCount * sizeof(CanCaptureRecord);
+    if (length > available) {
+        return 0;
+    }
+    uint32_t records = ~otaCrc32(data + sizeof(CanCaptureBlockHeader),
+                                 length - sizeof(CanCaptureBlockHeader));
+    return header.crc == blockCrc(&header, records) ? length : 0;
+}
+
+void canCaptureDecode(const CanCaptureBlockHeader* header, const CanCaptureRecord* record,
+                      CanFrame* frame) {
+    frame->timeUs = header->firstTimeUs + (record->timeDlc & CAN_CAPTURE_TIME_MASK);
+    frame->id = record->id & CAN_CAPTURE_ID_MASK;
+    frame->dlc = (uint8_t)(record->timeDlc >> CAN_CAPTURE_DLC_SHIFT);
+    frame->flags = ((record->id & CAN_CAPTURE_ID_EXTENDED) ? CAN_FRAME_EXTENDED : 0) |
+                   ((record->id & CAN_CAPTURE_ID_RTR) ? CAN_FRAME_RTR : 0);
+    memcpy(frame->data, record->data, sizeof(frame->data));
+}
+
+// =============================================================================
+// Writer
+// =============================================================================
+
+CanCaptureWriter::CanCaptureWriter()
+    : _count(0)
+    , _blockBytes(0)
+    , _blockRecords(0)
+    , _current(-1)
+    , _records(0)
+    , _firstTimeUs(0)
+    , _crc(0)
+    , _sequence(0)
+    , _overruns(0)
+    , _sealedDropped(0)
+    , _sealedOverruns(0) {
+    memset(_buffers, 0, sizeof(_buffers));
+    memset(_busy, 0, sizeof(_busy));
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+bool CanCaptureWriter::init(uint8_t* const* buffers, uint32_t count, uint32_t blockBytes) {
+    uint32_t records = blockBytes >= sizeof(CanCaptureBlockHeader)
+                           ? (blockBytes - sizeof(CanCaptureBlockHeader)) / sizeof(CanCaptureRecord)
+                           : 0;
+    if (count == 0 || count > CAN_CAPTURE_MAX_BUFFERS || records < 2 || records > UINT16_MAX) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if (!buffers[i]) return false;
+        _buffers[i] = buffers[i];
+        _busy[i] = false;
+    }
+    _count = count;
+    _blockBytes = blockBytes;
+    _blockRecords = records;
+    _current = -1;
+    _records = 0;
+    _sequence = 0;
+    _overruns = 0;
+    _sealedDropped = 0;
+    _sealedOverruns = 0;
+    memset(&_stats, 0, sizeof(_stats));
+    return true;
+}
+
+// Take a free buffer for a block starting at timeUs
+bool CanCaptureWriter::acquire(uint64_t timeUs) {
+    int32_t free = -1;
+    for (uint32_t i = 0; i < _count; i++) {
+        if (!_busy[i]) {
+            free = (int32_t)i;
+            break;
+        }
+    }
+    if (free < 0) return false;
+
+    _busy[free] = true;
+    _current = free;
+    _stats.buffersInUse++;
+    if (_stats.buffersInUse > _stats.maxBuffersInUse) {
+        _stats.maxBuffersInUse = _stats.buffersInUse;
+    }
+    _records = 0;
+    _firstTimeUs = timeUs;
+    _crc = 0xFFFFFFFF;
+    return true;
+}
+
+bool CanCaptureWriter::add(const CanFrame& frame, CanCaptureBlock* block) {
+    if (_count == 0) return false;
+
+    // A frame past the record time range, or stamped before the block's
+    // first frame, starts a new block
+    bool sealed = false;
+    if (_current >= 0 &&
+        (frame.timeUs < _firstTimeUs || frame.timeUs - _firstTimeUs > CAN_CAPTURE_TIME_MASK)) {
+        seal(block);
+        sealed = true;
+    }
+    if (_current < 0 && !acquire(frame.timeUs)) {
+        _stats.dropped++;
+        return sealed;
+    }
+
+    CanCaptureRecord record;
+    uint8_t dlc = frame.dlc > 8 ? 8 : frame.dlc;
+    record.timeDlc = (uint32_t)(frame.timeUs - _firstTimeUs) | ((uint32_t)dlc << CAN_CAPTURE_DLC_SHIFT);
+    record.id = (frame.id & CAN_CAPTURE_ID_MASK) |
+                ((frame.flags & CAN_FRAME_EXTENDED) ? CAN_CAPTURE_ID_EXTENDED : 0) |
+                ((frame.flags & CAN_FRAME_RTR) ? CAN_CAPTURE_ID_RTR : 0);
+    memset(record.data, 0, sizeof(record.data));
+    if (!(frame.flags & CAN_FRAME_RTR)) {
+        memcpy(record.data, frame.data, dlc);
+    }
+
+    memcpy(_buffers[_current] + sizeof(CanCaptureBlockHeader) + _records * sizeof(CanCaptureRecord),
+           &record, sizeof(record));
+    _crc = ~otaCrc32((const uint8_t*)&record, sizeof(record), _crc);
+    _records++;
+    _stats.frames++;
+
+    // A block just started holds one record, so at most one seal per call
+    if (_records < _blockRecords) return sealed;
+    seal(block);
+    return true;
+}
+
+bool CanCaptureWriter::flush(uint64_t nowUs, uint32_t maxAgeUs, CanCaptureBlock* block) {
+    if (_current < 0) {
+        if (maxAgeUs > 0 || _count == 0 ||
+            (_stats.dropped == _sealedDropped && _overruns == _sealedOverruns) ||
+            !acquire(nowUs)) {
+            return false;
+        }
+    } else if ((nowUs > _firstTimeUs ? nowUs - _firstTimeUs : 0) < maxAgeUs) {
+        return false;
+    }
+    seal(block);
+    return true;
+}
+
+// Write the header and hand out the current block
+void CanCaptureWriter::seal(CanCaptureBlock* block) {
+    CanCaptureBlockHeader header;
+    header.magic = CAN_CAPTURE_MAGIC;
+    header.recordCount = (uint16_t)_records;
+    header.reserved = 0;
+    header.sequence = _sequence++;
+    header.firstTimeUs = _firstTimeUs;
+    header.dropped = _stats.dropped;
+    header.overruns = _overruns;
+    header.crc = blockCrc(&header, _crc);
+    _sealedDropped = header.dropped;
+    _sealedOverruns = header.overruns;
+    memcpy(_buffers[_current], &header, sizeof(header));
+
+    block->data = _buffers[_current];
+    block->length = sizeof(CanCaptureBlockHeader) + _records * sizeof(CanCaptureRecord);
+    block->sequence = header.sequence;
+    block->buffer = (uint8_t)_current;
+
+    _stats.blocks++;
+    _stats.bytes += block->length;
+    _current = -1;
+}
+
+void CanCaptureWriter::release(uint8_t buffer) {
+    if (buffer < _count && _busy[buffer] && (int32_t)buffer != _current) {
+        _busy[buffer] = false;
+        _stats.buffersInUse--;
+    }
+}
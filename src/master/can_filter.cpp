@@ -0,0 +1,449 @@
+#include "master/can_filter.h"
+#include <string.h>
+
+#define STD_BITS    0x1FFC0000u     // Standard ID, top 11 bits
+#define EXT_BITS    0x1FFFFFFFu
+#define MIXED_BITS  0x1FFF0000u     // Low 16 bits compare data bytes of standard frames
+#define KEY_USED    0x40000000u
+
+static uint32_t layout(uint32_t id, bool extended) {
+    return extended ? (id & EXT_BITS) : ((id & 0x7FF) << 18);
+}
+
+static uint32_t typeBits(bool extended) {
+    return extended ? EXT_BITS : STD_BITS;
+}
+
+static uint32_t popcount(uint32_t value) {
+    return (uint32_t)__builtin_popcount(value);
+}
+
+// =============================================================================
+// Survey
+// =============================================================================
+
+CanTrafficSurvey::CanTrafficSurvey() {
+    reset();
+}
+
+void CanTrafficSurvey::reset() {
+    memset(_key, 0, sizeof(_key));
+    memset(_count, 0, sizeof(_count));
+    _ids = 0;
+    _frames = 0;
+    _untracked = 0;
+}
+
+static uint32_t surveyKey(uint32_t id, bool extended) {
+    return layout(id, extended) | (extended ? 0x20000000u : 0) | KEY_USED;
+}
+
+static uint32_t surveyHome(uint32_t key) {
+    return (key * 2654435761u) >> 25;   // Top 7 bits: CAN_FILTER_SURVEY_SLOTS
+}
+
+void CanTrafficSurvey::add(uint32_t id, bool extended) {
+    _frames++;
+    uint32_t key = surveyKey(id, extended);
+    // Stop at half full so probes stay short
+    for (uint32_t i = surveyHome(key), n = 0; n < CAN_FILTER_SURVEY_SLOTS;
+         i = (i + 1) & (CAN_FILTER_SURVEY_SLOTS - 1), n++) {
+        if (_key[i] == key) {
+            _count[i]++;
+            return;
+        }
+        if (_key[i] == 0) {
+            if (_ids >= CAN_FILTER_SURVEY_SLOTS / 2) {
+                break;
+            }
+            _key[i] = key;
+            _count[i] = 1;
+            _ids++;
+            return;
+        }
+    }
+    _untracked++;
+}
+
+uint32_t CanTrafficSurvey::count(uint32_t id, bool extended) const {
+    uint32_t key = surveyKey(id, extended);
+    for (uint32_t i = surveyHome(key), n = 0; n < CAN_FILTER_SURVEY_SLOTS;
+         i = (i + 1) & (CAN_FILTER_SURVEY_SLOTS - 1), n++) {
+        if (_key[i] == key) {
+            return _count[i];
+        }
+        if (_key[i] == 0) {
+            break;
+        }
+    }
+    return 0;
+}
+
+bool CanTrafficSurvey::entry(uint32_t index, CanId* id, uint32_t* count) const {
+    uint32_t key = _key[index];
+    if (key == 0) {
+        return false;
+    }
+    id->extended = (key & 0x20000000u) != 0;
+    id->id = id->extended ? (key & EXT_BITS) : ((key & STD_BITS) >> 18);
+    *count = _count[index];
+    return true;
+}
+
+// =============================================================================
+// Planning
+// =============================================================================
+
+typedef struct {
+    uint64_t traffic;           // Surveyed frames of unwanted IDs let through
+    uint64_t space;             // IDs let through, wanted included
+} Cost;
+
+static bool cheaper(const Cost& a, const Cost& b) {
+    return a.traffic < b.traffic || (a.traffic == b.traffic && a.space < b.space);
+}
+
+// One receive buffer: its mask and one filter per class of wanted IDs
+typedef struct {
+    uint32_t mask;
+    uint32_t filter[CAN_FILTER_RXB1_FILTERS];
+    bool extended[CAN_FILTER_RXB1_FILTERS];
+    uint32_t classes;
+} Group;
+
+typedef struct {
+    const CanId* ids;
+    const uint32_t* bits;       // layout() of each ID
+    const CanTrafficSurvey* survey;
+    const CanFilterPlan* plan;  // For the wanted check
+} Input;
+
+// Distinct (type, bits & mask) among the IDs in members; false if more than limit
+static bool buildClasses(const Input& in, const uint8_t* members, uint32_t n, uint32_t mask,
+                         uint32_t limit, Group* group) {
+    group->mask = mask;
+    group->classes = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t value = in.bits[members[i]] & mask;
+        bool extended = in.ids[members[i]].extended;
+        bool found = false;
+        for (uint32_t c = 0; c < group->classes; c++) {
+            if (group->filter[c] == value && group->extended[c] == extended) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            if (group->classes >= limit) {
+                group->classes = limit + 1;
+                return false;
+            }
+            group->filter[group->classes] = value;
+            group->extended[group->classes] = extended;
+            group->classes++;
+        }
+    }
+    return true;
+}
+
+static bool groupAccepts(const Group& group, uint32_t bits, bool extended) {
+    for (uint32_t c = 0; c < group.classes; c++) {
+        if (group.extended[c] == extended &&
+            ((bits ^ group.filter[c]) & group.mask & typeBits(extended)) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static Cost groupCost(const Input& in, const Group& group) {
+    Cost cost = {0, 0};
+    for (uint32_t c = 0; c < group.classes; c++) {
+        cost.space += 1ULL << popcount(typeBits(group.extended[c]) & ~group.mask);
+    }
+    if (in.survey != nullptr) {
+        CanId id;
+        uint32_t count;
+        for (uint32_t i = 0; i < CAN_FILTER_SURVEY_SLOTS; i++) {
+            if (in.survey->entry(i, &id, &count) &&
+                groupAccepts(group, layout(id.id, id.extended), id.extended) &&
+                !canFilterWanted(in.plan, id.id, id.extended)) {
+                cost.traffic += count;
+            }
+        }
+    }
+    return cost;
+}
+
+// Clear mask bits until the members fit limit filters, cheapest bit first
+static Cost planGroup(const Input& in, const uint8_t* members, uint32_t n, uint32_t limit,
+                      Group* group) {
+    Cost none = {0, 0};
+    group->classes = 0;
+    group->mask = EXT_BITS;
+    if (n == 0) {
+        return none;
+    }
+
+    bool hasStd = false;
+    bool hasExt = false;
+    for (uint32_t i = 0; i < n; i++) {
+        if (in.ids[members[i]].extended) hasExt = true; else hasStd = true;
+    }
+    uint32_t mask = hasStd && hasExt ? MIXED_BITS : (hasStd ? STD_BITS : EXT_BITS);
+
+    // Only bits on which members of one type differ can merge classes
+    uint32_t differing = 0;
+    for (uint32_t i = 1; i < n; i++) {
+        for (uint32_t j = 0; j < i; j++) {
+            if (in.ids[members[i]].extended == in.ids[members[j]].extended) {
+                differing |= in.bits[members[i]] ^ in.bits[members[j]];
+            }
+        }
+    }
+
+    while (!buildClasses(in, members, n, mask, limit, group)) {
+        uint32_t bestMask = 0;
+        uint32_t bestClasses = 0;
+        Cost bestCost = {0, 0};
+        bool found = false;
+        bool bestReduces = false;
+
+        Group trial;
+        buildClasses(in, members, n, mask, n, &trial);
+        uint32_t current = trial.classes;
+
+        for (uint32_t b = 0; b < 29; b++) {
+            uint32_t bit = 1u << b;
+            if (!(mask & differing & bit)) {
+                continue;
+            }
+            buildClasses(in, members, n, mask & ~bit, n, &trial);
+            bool reduces = trial.classes < current;
+            Cost cost = groupCost(in, trial);
+            // A bit that merges classes beats one that does not, then cheaper,
+            // then fewer classes
+            if (!found || (reduces && !bestReduces) ||
+                (reduces == bestReduces &&
+                 (cheaper(cost, bestCost) ||
+                  (!cheaper(bestCost, cost) && trial.classes < bestClasses)))) {
+                found = true;
+                bestReduces = reduces;
+                bestMask = mask & ~bit;
+                bestCost = cost;
+                bestClasses = trial.classes;
+            }
+        }
+        if (!found) {
+            // Cannot happen: members of one type that differ have a differing bit
+            mask = 0;
+            continue;
+        }
+        mask = bestMask;
+    }
+
+    return groupCost(in, *group);
+}
+
+static void fillUnused(Group* group, const Group& other, uint32_t filters) {
+    if (group->classes == 0) {
+        // Nothing for this buffer: match one of the other buffer's IDs exactly
+        group->mask = EXT_BITS;
+        group->filter[0] = other.filter[0];
+        group->extended[0] = other.extended[0];
+        group->classes = 1;
+    }
+    for (uint32_t c = group->classes; c < filters; c++) {
+        group->filter[c] = group->filter[0];
+        group->extended[c] = group->extended[0];
+    }
+}
+
+static void planOpen(CanFilterPlan* plan) {
+    // As after reset: mask 0, one filter per type in each buffer
+    static const bool extended[CAN_FILTER_COUNT] = {false, true, false, true, false, false};
+    plan->open = true;
+    plan->exact = true;
+    plan->mask[0] = 0;
+    plan->mask[1] = 0;
+    for (uint32_t i = 0; i < CAN_FILTER_COUNT; i++) {
+        plan->filter[i] = 0;
+        plan->filterExtended[i] = extended[i];
+    }
+}
+
+bool canFilterPlan(const CanId* wanted, uint32_t count, const CanTrafficSurvey* survey,
+                   CanFilterPlan* plan) {
+    memset(plan, 0, sizeof(*plan));
+    if (count > CAN_FILTER_MAX_IDS) {
+        return false;
+    }
+
+    // Keep one of each
+    for (uint32_t i = 0; i < count; i++) {
+        bool extended = wanted[i].extended;
+        uint32_t id = wanted[i].id & (extended ? EXT_BITS : 0x7FF);
+        if (!canFilterWanted(plan, id, extended)) {
+            plan->wanted[plan->wantedCount].id = id;
+            plan->wanted[plan->wantedCount].extended = extended;
+            plan->wantedCount++;
+        }
+    }
+    uint32_t n = plan->wantedCount;
+
+    if (survey != nullptr) {
+        CanId id;
+        uint32_t frames;
+        for (uint32_t i = 0; i < CAN_FILTER_SURVEY_SLOTS; i++) {
+            if (survey->entry(i, &id, &frames)) {
+                plan->surveyFrames += frames;
+            }
+        }
+    }
+
+    if (n == 0) {
+        planOpen(plan);
+        plan->acceptedFrames = plan->surveyFrames;
+        return true;
+    }
+
+    uint32_t bits[CAN_FILTER_MAX_IDS];
+    uint8_t order[CAN_FILTER_MAX_IDS];
+    for (uint32_t i = 0; i < n; i++) {
+        bits[i] = layout(plan->wanted[i].id, plan->wanted[i].extended);
+        order[i] = (uint8_t)i;
+    }
+    // Sorted by type, then ID, for the contiguous splits below
+    for (uint32_t i = 1; i < n; i++) {
+        for (uint32_t j = i; j > 0; j--) {
+            uint8_t a = order[j - 1];
+            uint8_t b = order[j];
+            uint64_t ka = ((uint64_t)plan->wanted[a].extended << 32) | bits[a];
+            uint64_t kb = ((uint64_t)plan->wanted[b].extended << 32) | bits[b];
+            if (ka <= kb) break;
+            order[j - 1] = b;
+            order[j] = a;
+        }
+    }
+
+    Input in = {plan->wanted, bits, survey, plan};
+    Group best[2] = {};
+    Cost bestCost = {0, 0};
+    bool found = false;
+
+    // Candidate splits between RXB0 and RXB1, as a bitmap of IDs in RXB0:
+    // by type, all in one buffer, sorted prefixes and suffixes, and by each ID bit
+    uint32_t all = (n >= 32) ? 0xFFFFFFFFu : ((1u << n) - 1);
+    uint32_t candidates[4 + 2 * CAN_FILTER_MAX_IDS + 2 * 29];
+    uint32_t candidateCount = 0;
+    uint32_t extendedSet = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        if (plan->wanted[i].extended) extendedSet |= 1u << i;
+    }
+    candidates[candidateCount++] = extendedSet;
+    candidates[candidateCount++] = all & ~extendedSet;
+    candidates[candidateCount++] = 0;
+    candidates[candidateCount++] = all;
+    uint32_t prefix = 0;
+    for (uint32_t j = 0; j + 1 < n; j++) {
+        prefix |= 1u << order[j];
+        candidates[candidateCount++] = prefix;
+        candidates[candidateCount++] = all & ~prefix;
+    }
+    for (uint32_t b = 0; b < 29; b++) {
+        uint32_t set = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            if (bits[i] & (1u << b)) set |= 1u << i;
+        }
+        if (set != 0 && set != all) {
+            candidates[candidateCount++] = set;
+            candidates[candidateCount++] = all & ~set;
+        }
+    }
+
+    for (uint32_t c = 0; c < candidateCount; c++) {
+        uint8_t members[2][CAN_FILTER_MAX_IDS];
+        uint32_t sizes[2] = {0, 0};
+        for (uint32_t i = 0; i < n; i++) {
+            uint32_t g = (candidates[c] & (1u << i)) ? 0 : 1;
+            members[g][sizes[g]++] = (uint8_t)i;
+        }
+
+        Group groups[2];
+        Cost a = planGroup(in, members[0], sizes[0], CAN_FILTER_RXB0_FILTERS, &groups[0]);
+        Cost b = planGroup(in, members[1], sizes[1], CAN_FILTER_RXB1_FILTERS, &groups[1]);
+        Cost total = {a.traffic + b.traffic, a.space + b.space};
+        if (!found || cheaper(total, bestCost)) {
+            found = true;
+            bestCost = total;
+            best[0] = groups[0];
+            best[1] = groups[1];
+        }
+    }
+
+    fillUnused(&best[0], best[1], CAN_FILTER_RXB0_FILTERS);
+    fillUnused(&best[1], best[0], CAN_FILTER_RXB1_FILTERS);
+
+    plan->open = false;
+    for (uint32_t g = 0; g < 2; g++) {
+        plan->mask[g] = best[g].mask;
+        uint32_t first = g == 0 ? 0 : CAN_FILTER_RXB0_FILTERS;
+        uint32_t filters = g == 0 ? CAN_FILTER_RXB0_FILTERS : CAN_FILTER_RXB1_FILTERS;
+        for (uint32_t f = 0; f < filters; f++) {
+            plan->filter[first + f] = best[g].filter[f] & best[g].mask;
+            plan->filterExtended[first + f] = best[g].extended[f];
+        }
+    }
+
+    plan->exact = bestCost.space == n;
+    plan->extraIds = bestCost.space - n > 0xFFFFFFFFull ? 0xFFFFFFFFu
+                                                         : (uint32_t)(bestCost.space - n);
+    if (survey != nullptr) {
+        CanId id;
+        uint32_t frames;
+        for (uint32_t i = 0; i < CAN_FILTER_SURVEY_SLOTS; i++) {
+            if (survey->entry(i, &id, &frames) && canFilterAccepts(plan, id.id, id.extended)) {
+                plan->acceptedFrames += frames;
+            }
+        }
+    }
+    return true;
+}
+
+// =============================================================================
+// Checks
+// =============================================================================
+
+bool canFilterAccepts(const CanFilterPlan* plan, uint32_t id, bool extended) {
+    if (plan->open) {
+        return true;
+    }
+    uint32_t bits = layout(id, extended);
+    for (uint32_t f = 0; f < CAN_FILTER_COUNT; f++) {
+        uint32_t mask = plan->mask[f < CAN_FILTER_RXB0_FILTERS ? 0 : 1];
+        if (plan->filterExtended[f] == extended &&
+            ((bits ^ plan->filter[f]) & mask & typeBits(extended)) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool canFilterWanted(const CanFilterPlan* plan, uint32_t id, bool extended) {
+    if (plan->open) {
+        return true;
+    }
+    for (uint32_t i = 0; i < plan->wantedCount; i++) {
+        if (plan->wanted[i].id == id && plan->wanted[i].extended == extended) {
+            return true;
+        }
+    }
+    return false;
+}
+
+float canFilterPredictedRejection(const CanFilterPlan* plan) {
+    if (plan->surveyFrames == 0) {
+        return 0.0f;
+    }
+    return 1.0f - (float)plan->acceptedFrames / (float)plan->surveyFrames;
+}
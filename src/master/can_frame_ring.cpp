@@ -0,0 +1,63 @@
+#include "master/can_frame_ring.h"
+
+CanFrameRing::CanFrameRing()
+    : _frames(nullptr)
+    , _mask(0)
+    , _head(0)
+    , _tail(0)
+    , _overruns(0)
+    , _maxDepth(0) {
+}
+
+bool CanFrameRing::init(CanFrame* frames, uint32_t count) {
+    if (frames == nullptr || count < 2 || (count & (count - 1)) != 0) {
+        return false;
+    }
+    _frames = frames;
+    _mask = count - 1;
+    _head = 0;
+    _tail = 0;
+    _overruns = 0;
+    _maxDepth = 0;
+    return true;
+}
+
+bool CanFrameRing::push(const CanFrame& frame) {
+    if (_frames == nullptr) {
+        return false;
+    }
+
+    uint32_t head = _head;
+    uint32_t waiting = head - __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+    if (waiting > _mask) {
+        __atomic_store_n(&_overruns, _overruns + 1, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    _frames[head & _mask] = frame;
+    __atomic_store_n(&_head, head + 1, __ATOMIC_RELEASE);
+
+    if (waiting + 1 > _maxDepth) {
+        _maxDepth = waiting + 1;
+    }
+    return true;
+}
+
+bool CanFrameRing::pop(CanFrame* frame) {
+    if (_frames == nullptr) {
+        return false;
+    }
+
+    uint32_t tail = _tail;
+    if (tail == __atomic_load_n(&_head, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+
+    *frame = _frames[tail & _mask];
+    __atomic_store_n(&_tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+uint32_t CanFrameRing::depth() const {
+    return __atomic_load_n(&_head, __ATOMIC_ACQUIRE) - __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+}
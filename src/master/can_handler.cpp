@@ -1,35 +1,113 @@
 #include "can_handler.h"
+#include "master/can_bus_stats.h"
+#include "master/can_capture.h"
+#include "master/can_filter.h"
+#include "master/can_replay.h"
+#include "master/can_signal.h"
+#include "master/can_tx_schedule.h"
+#include "master/deferred_log.h"
+#include "master/periph_spi.h"
+#include "master/pump_assist.h"
 #include "shared/config.h"
 #include <Arduino.h>
 #include <SPI.h>
+#include <esp_timer.h>
 #include <mcp2515.h>
 
 // CAN Configuration - adjust based on your MCP2515 module and vehicle
 static const CAN_SPEED CAN_BITRATE = CAN_500KBPS;  // Volvo typically uses 500kbps
+static const uint32_t CAN_BITRATE_BPS = 500000;    // The same, for the bus load
 static const CAN_CLOCK CAN_CLOCK_SPEED = MCP_8MHZ; // Crystal on MCP2515 module
 
 static SPIClass* canSpi = nullptr;
 static MCP2515* canController = nullptr;
 static bool canInitialized = false;
 
-static CanMode currentMode = CAN_MODE_SNIFF;
-static uint32_t rpmMessageId = 0;
-static uint8_t rpmByteOffset = 0;
-static float rpmScale = 1.0f;
+static CanMode currentMode = CAN_MODE_IDLE;
+
+// Decoding runs in the consumer (UI task)
+static CanSignalDef signalDefs[CAN_SIGNAL_MAX];
+static CanSignalDecoder decoder;
+static uint32_t rpmSignal = CAN_SIGNAL_ENGINE_RPM;
+static uint32_t rpmUpdates = 0;
 
 static uint32_t messageCount = 0;
 static uint32_t errorCount = 0;
 
+// Receive path
+static CanFrame ringFrames[CAN_RX_RING_FRAMES];
+static CanFrameRing ring;
+static TaskHandle_t rxTask = nullptr;
+static volatile int64_t interruptTimeUs = 0;
+static CanRxStats rxStats;
+
+// Per-ID statistics: updated by the RX task, read by the UI and SPI tasks
+static CanBusStats busStats;
+static portMUX_TYPE busStatsMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Why the CAN RX task was woken (task notification bits)
+#define CAN_NOTIFY_RX       0x01    // INT pin
+#define CAN_NOTIFY_TX       0x02    // Transmit deadline
+#define CAN_NOTIFY_PLAN     0x04    // Acceptance filters to program
+// CAN_REPLAY_NOTIFY (0x08): replay frame due or chunk read (can_replay.h)
+
+// Transmit path: run by the CAN RX task, which owns the controller
+static CanTxScheduler txScheduler;
+static esp_timer_handle_t txTimer = nullptr;
+static volatile bool txEnabled = false;
+static bool txGateSet = false;
+static uint32_t txGateKey = 0;              // ID | CAN_FRAME_EXTENDED << 29
+static uint32_t txGateTimeoutUs = 0;
+static int64_t txGateSeenUs = 0;            // Last gate frame, 0 = never
+static int64_t txBufferBusyUs[CAN_TX_BUFFERS];  // Handed to the controller at, 0 = free
+static uint32_t txErrors = 0;
+static uint32_t txTimeouts = 0;
+
+// Acceptance filters: planned by the consumer, programmed by the RX task
+static CanFilterPlan activePlan;
+static CanFilterPlan pendingPlan;
+static bool planPending = false;
+static portMUX_TYPE planMux = portMUX_INITIALIZER_UNLOCKED;
+static CanTrafficSurvey survey;             // Taken while the filters are open
+static uint32_t surveyStartMs = 0;
+static float surveyFramesPerSec = 0;
+static uint32_t planStartMs = 0;
+static uint32_t planFrames = 0;             // Passed by the filters since planStartMs
+static uint32_t softwareRejected = 0;
+
+static void txTimerExpired(void* arg);
+static void canTxService();
+
+// =============================================================================
+// Interrupt
+// =============================================================================
+
+static void IRAM_ATTR canInterrupt() {
+    interruptTimeUs = esp_timer_get_time();
+    if (rxTask != nullptr) {
+        BaseType_t woken = pdFALSE;
+        xTaskNotifyFromISR(rxTask, CAN_NOTIFY_RX, eSetBits, &woken);
+        if (woken) {
+            portYIELD_FROM_ISR();
+        }
+    }
+}
+
+// =============================================================================
+// Initialization
+// =============================================================================
+
 bool canInit() {
     canInitialized = false;
+    ring.init(ringFrames, CAN_RX_RING_FRAMES);
+    busStats.setBitrate(CAN_BITRATE_BPS);
+    canFilterPlan(nullptr, 0, nullptr, &activePlan);   // reset() leaves them open
+    canSetSignals(CAN_DEFAULT_SIGNALS, CAN_SIGNAL_DEFAULT_COUNT, CAN_SIGNAL_ENGINE_RPM);
+    surveyStartMs = millis();
 
-    // Initialize SPI for MCP2515 using FSPI (SPI2) - separate from comm SPI on HSPI
-    canSpi = new SPIClass(FSPI);
-    if (!canSpi) {
-        Serial.println("Failed to allocate SPI!");
-        return false;
-    }
-    canSpi->begin(MCP2515_SCK_PIN, MCP2515_MISO_PIN, MCP2515_MOSI_PIN, MCP2515_CS_PIN);
+    // MCP2515 on the SD card's bus (FSPI, periph_spi.h) with its own CS pin;
+    // HSPI talks to the slave
+    canSpi = periphSpi();
 
     // Initialize MCP2515 (CS pin, SPI clock speed, SPI instance)
     canController = new MCP2515(MCP2515_CS_PIN, 10000000, canSpi);
@@ -59,110 +137,618 @@ bool canInit() {
         return false;
     }
 
+    esp_timer_create_args_t timerArgs = {};
+    timerArgs.callback = txTimerExpired;
+    timerArgs.name = "can_tx";
+    if (esp_timer_create(&timerArgs, &txTimer) != ESP_OK) {
+        Serial.println("CAN TX timer failed - transmit disabled");
+        txTimer = nullptr;
+    }
+
+    // Active low while any enabled interrupt flag (RX0, RX1, errors) is set
+    pinMode(MCP2515_INT_PIN, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(MCP2515_INT_PIN), canInterrupt, FALLING);
+
     canInitialized = true;
     Serial.println("MCP2515 initialized successfully");
     return true;
 }
 
-void canSetMode(CanMode mode) {
-    currentMode = mode;
-    if (mode == CAN_MODE_SNIFF) {
-        Serial.println("CAN mode: SNIFF - logging all messages");
+// =============================================================================
+// Acceptance Filters
+// =============================================================================
+
+// Masks take the 29-bit layout as an extended ID; standard filters take
+// their 11 bits
+static void applyPlan(const CanFilterPlan& plan) {
+    static const MCP2515::RXF filters[CAN_FILTER_COUNT] = {
+        MCP2515::RXF0, MCP2515::RXF1, MCP2515::RXF2,
+        MCP2515::RXF3, MCP2515::RXF4, MCP2515::RXF5
+    };
+
+    bool ok = canController->setConfigMode() == MCP2515::ERROR_OK;
+    ok = ok && canController->setFilterMask(MCP2515::MASK0, true, plan.mask[0]) == MCP2515::ERROR_OK;
+    ok = ok && canController->setFilterMask(MCP2515::MASK1, true, plan.mask[1]) == MCP2515::ERROR_OK;
+    for (uint32_t f = 0; f < CAN_FILTER_COUNT && ok; f++) {
+        bool extended = plan.filterExtended[f];
+        uint32_t value = extended ? plan.filter[f] : plan.filter[f] >> 18;
+        ok = canController->setFilter(filters[f], extended, value) == MCP2515::ERROR_OK;
+    }
+    // Receive again even if programming failed part way
+    if (canController->setNormalMode() != MCP2515::ERROR_OK || !ok) {
+        errorCount++;
+        LOG_PRINTF("CAN: programming acceptance filters failed\n");
+    }
+}
+
+bool canSetAcceptedIds(const CanId* ids, uint32_t count) {
+    CanFilterPlan plan;
+    if (!canFilterPlan(ids, count, survey.frames() > 0 ? &survey : nullptr, &plan)) {
+        Serial.printf("CAN filter: too many IDs (%lu, max %u)\n",
+                      (unsigned long)count, CAN_FILTER_MAX_IDS);
+        return false;
+    }
+
+    uint32_t now = millis();
+    if (activePlan.open && now > surveyStartMs) {
+        surveyFramesPerSec = survey.frames() * 1000.0f / (now - surveyStartMs);
+    }
+    activePlan = plan;
+    planStartMs = now;
+    planFrames = 0;
+    softwareRejected = 0;
+    if (plan.open) {
+        survey.reset();
+        surveyStartMs = now;
+    }
+
+    portENTER_CRITICAL(&planMux);
+    pendingPlan = plan;
+    planPending = true;
+    portEXIT_CRITICAL(&planMux);
+    if (rxTask != nullptr) {
+        xTaskNotify(rxTask, CAN_NOTIFY_PLAN, eSetBits);
+    }
+
+    if (plan.open) {
+        Serial.println("CAN filter: open, surveying traffic");
     } else {
-        Serial.printf("CAN mode: RPM - filtering for ID 0x%03X\n", rpmMessageId);
+        Serial.printf("CAN filter: %lu IDs, %s", (unsigned long)plan.wantedCount,
+                      plan.exact ? "exact" : "software check");
+        if (!plan.exact) {
+            Serial.printf(" (%lu extra IDs pass)", (unsigned long)plan.extraIds);
+        }
+        if (plan.surveyFrames > 0) {
+            Serial.printf(", %.1f%% of surveyed traffic rejected in hardware",
+                          canFilterPredictedRejection(&plan) * 100.0f);
+        }
+        Serial.println();
     }
+    return true;
 }
 
-void canSetRpmMessageId(uint32_t messageId) {
-    rpmMessageId = messageId;
+// =============================================================================
+// Transmit Schedule
+// =============================================================================
+
+static void txTimerExpired(void* arg) {
+    if (rxTask != nullptr) {
+        xTaskNotify(rxTask, CAN_NOTIFY_TX, eSetBits);
+    }
 }
 
-void canSetRpmExtraction(uint8_t byteOffset, float scale) {
-    rpmByteOffset = byteOffset;
-    rpmScale = scale;
+// Free buffers whose frame went out. TXnIF flags are cleared together, so
+// one set between reading and clearing is lost; a buffer busy longer than
+// CAN_TX_BUFFER_TIMEOUT_US is reused and counted as a timeout.
+static void txReleaseBuffers(int64_t nowUs) {
+    static const uint8_t doneFlags[CAN_TX_BUFFERS] = {
+        MCP2515::CANINTF_TX0IF, MCP2515::CANINTF_TX1IF, MCP2515::CANINTF_TX2IF
+    };
+
+    bool anyBusy = false;
+    for (uint32_t b = 0; b < CAN_TX_BUFFERS; b++) {
+        anyBusy |= txBufferBusyUs[b] != 0;
+    }
+    if (!anyBusy) {
+        return;
+    }
+
+    uint8_t flags = canController->getInterrupts();
+    canController->clearTXInterrupts();
+    for (uint32_t b = 0; b < CAN_TX_BUFFERS; b++) {
+        if (txBufferBusyUs[b] == 0) {
+            continue;
+        }
+        if (flags & doneFlags[b]) {
+            txBufferBusyUs[b] = 0;
+        } else if (nowUs - txBufferBusyUs[b] > CAN_TX_BUFFER_TIMEOUT_US) {
+            txBufferBusyUs[b] = 0;
+            txTimeouts++;
+        }
+    }
 }
 
-static void printCanMessage(const struct can_frame& frame) {
-    // Print timestamp
-    Serial.printf("[%lu] ", millis());
+static void canTxService() {
+    int64_t nowUs = esp_timer_get_time();
 
-    // Print ID (standard or extended)
-    if (frame.can_id & CAN_EFF_FLAG) {
-        Serial.printf("EXT ID: 0x%08X ", frame.can_id & CAN_EFF_MASK);
-    } else {
-        Serial.printf("STD ID: 0x%03X ", frame.can_id & CAN_SFF_MASK);
+    bool open = txEnabled && txTimer != nullptr &&
+                (!txGateSet || (txGateSeenUs != 0 && nowUs - txGateSeenUs < txGateTimeoutUs));
+    if (open != txScheduler.gateOpen()) {
+        txScheduler.setGate(open, (uint64_t)nowUs);
+        LOG_PRINTF("CAN TX: %s\n", open ? "sending" : "stopped");
+    }
+    if (!open) {
+        if (txTimer != nullptr) {
+            esp_timer_stop(txTimer);
+        }
+        return;
     }
 
-    // Print RTR flag
-    if (frame.can_id & CAN_RTR_FLAG) {
-        Serial.print("RTR ");
+    txReleaseBuffers(nowUs);
+
+    uint32_t index;
+    CanFrame frame;
+    while (txScheduler.next((uint64_t)nowUs, &index, &frame)) {
+        uint8_t buffer = txScheduler.message(index).buffer;
+        if (txBufferBusyUs[buffer] != 0) {
+            txScheduler.busy(index);
+            continue;
+        }
+
+        struct can_frame raw;
+        raw.can_id = frame.id | ((frame.flags & CAN_FRAME_EXTENDED) ? CAN_EFF_FLAG : 0);
+        raw.can_dlc = frame.dlc;
+        memcpy(raw.data, frame.data, 8);
+
+        int64_t sentUs = esp_timer_get_time();
+        if (canController->sendMessage((MCP2515::TXBn)buffer, &raw) != MCP2515::ERROR_OK) {
+            txErrors++;
+        } else {
+            txScheduler.sent(index, (uint64_t)sentUs);
+        }
+        txBufferBusyUs[buffer] = sentUs;
+        nowUs = esp_timer_get_time();
     }
 
-    // Print data length
-    Serial.printf("DLC: %d ", frame.can_dlc);
+    // Wake for the next deadline; the timer notifies this task
+    uint64_t deadline = txScheduler.nextDeadline();
+    esp_timer_stop(txTimer);
+    if (deadline != UINT64_MAX) {
+        uint64_t now = (uint64_t)esp_timer_get_time();
+        esp_timer_start_once(txTimer, deadline > now ? deadline - now : 1);
+    }
+}
 
-    // Print data bytes
-    Serial.print("Data: ");
-    for (int i = 0; i < frame.can_dlc; i++) {
-        Serial.printf("%02X ", frame.data[i]);
+bool canTxAddMessage(const CanTxMessage& message) {
+    if (txEnabled) {
+        return false;
     }
+    return txScheduler.add(message);
+}
 
-    // Print ASCII representation
-    Serial.print(" | ");
-    for (int i = 0; i < frame.can_dlc; i++) {
-        char c = frame.data[i];
-        Serial.print((c >= 32 && c <= 126) ? c : '.');
+void canTxSetGate(uint32_t id, bool extended, uint32_t timeoutMs) {
+    txGateKey = id | (extended ? (uint32_t)CAN_FRAME_EXTENDED << 29 : 0);
+    txGateTimeoutUs = timeoutMs * 1000;
+    txGateSet = true;
+}
+
+void canTxEnable(bool enable) {
+    txEnabled = enable;
+    if (enable) {
+        txScheduler.resetStats();
+        txErrors = 0;
+        txTimeouts = 0;
+    }
+    if (rxTask != nullptr) {
+        xTaskNotify(rxTask, CAN_NOTIFY_TX, eSetBits);
     }
+}
 
-    Serial.println();
+bool canTxIsEnabled() {
+    return txEnabled;
 }
 
-static uint16_t extractRpmFromFrame(const struct can_frame& frame) {
-    if (rpmByteOffset + 1 >= frame.can_dlc) {
-        return 0;
+void canPrintTxStats() {
+    if (txScheduler.count() == 0) {
+        Serial.println("CAN TX: no messages scheduled");
+        return;
+    }
+    Serial.printf("CAN TX: %s, %s, %lu errors, %lu buffer timeouts\n",
+                  txEnabled ? "enabled" : "disabled",
+                  txScheduler.gateOpen() ? "gate open" : "waiting for gate frame",
+                  (unsigned long)txErrors, (unsigned long)txTimeouts);
+    for (uint32_t i = 0; i < txScheduler.count(); i++) {
+        const CanTxMessage& m = txScheduler.message(i);
+        const CanTxStats& s = txScheduler.stats(i);
+        Serial.printf("  %-10s 0x%08lX TXB%u every %lu us: %lu sent, %lu busy, %lu missed, "
+                      "late max %lu us, jitter max %lu us\n",
+                      m.name, (unsigned long)m.id, m.buffer, (unsigned long)m.periodUs,
+                      (unsigned long)s.sent, (unsigned long)s.busy, (unsigned long)s.missed,
+                      (unsigned long)s.maxLateUs, (unsigned long)s.maxJitterUs);
     }
+}
+
+// =============================================================================
+// Receive Task
+// =============================================================================
 
-    // Extract 16-bit value (little-endian)
-    uint16_t rawValue = frame.data[rpmByteOffset] | (frame.data[rpmByteOffset + 1] << 8);
-    return (uint16_t)(rawValue * rpmScale);
+static void readBuffer(MCP2515::RXBn buffer, int64_t stampUs) {
+    struct can_frame raw;
+    if (canController->readMessage(buffer, &raw) != MCP2515::ERROR_OK) {
+        rxStats.readErrors++;
+        return;
+    }
+
+    CanFrame frame;
+    frame.timeUs = (uint64_t)stampUs;
+    frame.flags = 0;
+    if (raw.can_id & CAN_EFF_FLAG) {
+        frame.id = raw.can_id & CAN_EFF_MASK;
+        frame.flags |= CAN_FRAME_EXTENDED;
+    } else {
+        frame.id = raw.can_id & CAN_SFF_MASK;
+    }
+    if (raw.can_id & CAN_RTR_FLAG) {
+        frame.flags |= CAN_FRAME_RTR;
+    }
+    frame.dlc = raw.can_dlc <= 8 ? raw.can_dlc : 8;
+    memcpy(frame.data, raw.data, 8);
+
+    rxStats.frames++;
+    canCaptureFrame(frame);
+    if (!canReplayActive()) {
+        ring.push(frame);
+    }
+
+    uint32_t bits = canFrameBits(frame);
+    portENTER_CRITICAL(&busStatsMux);
+    busStats.add(frame, bits);
+    portEXIT_CRITICAL(&busStatsMux);
+
+    if (txGateSet && (frame.id | (uint32_t)(frame.flags & CAN_FRAME_EXTENDED) << 29) == txGateKey) {
+        txGateSeenUs = stampUs;
+    }
+
+    uint32_t latency = (uint32_t)(esp_timer_get_time() - stampUs);
+    if (latency > rxStats.maxLatencyUs) {
+        rxStats.maxLatencyUs = latency;
+    }
 }
 
-bool canProcess(uint16_t* rpm) {
-    if (!canInitialized || canController == nullptr) {
+// Replayed frames take the live frames' place in the ring, and only there
+static bool deliverReplayed(const CanFrame& frame) {
+    if (ring.depth() >= ring.capacity()) {
         return false;
     }
+    ring.push(frame);
+    rxStats.replayed++;
+    return true;
+}
 
-    struct can_frame frame;
-    MCP2515::ERROR result = canController->readMessage(&frame);
+void canRxProcess(uint32_t waitMs) {
+    if (rxTask == nullptr) {
+        rxTask = xTaskGetCurrentTaskHandle();
+    }
 
-    if (result != MCP2515::ERROR_OK) {
-        if (result != MCP2515::ERROR_NOMSG) {
-            errorCount++;
+    uint32_t reasons = 0;
+    xTaskNotifyWait(0, UINT32_MAX, &reasons, pdMS_TO_TICKS(waitMs));
+    bool interrupted = (reasons & CAN_NOTIFY_RX) != 0;
+
+    // Needs no controller, so a bench board can replay too
+    canReplayService((uint64_t)esp_timer_get_time(), deliverReplayed);
+    if (!canInitialized) {
+        return;
+    }
+
+    if (planPending) {
+        CanFilterPlan plan;
+        portENTER_CRITICAL(&planMux);
+        plan = pendingPlan;
+        planPending = false;
+        portEXIT_CRITICAL(&planMux);
+        applyPlan(plan);
+    }
+
+    canTxService();
+    canCaptureService((uint64_t)esp_timer_get_time(), rxStats.rxOverruns);
+    // A missed edge leaves the pin low with frames waiting
+    if (!interrupted && digitalRead(MCP2515_INT_PIN) == HIGH) {
+        return;
+    }
+    rxStats.wakes++;
+
+    // Frames found on the first pass arrived by the interrupt, later
+    // passes pick up frames that arrived while reading
+    int64_t stampUs = interrupted ? interruptTimeUs : esp_timer_get_time();
+    uint32_t burst = 0;
+
+    while (true) {
+        uint8_t flags = canController->getInterrupts();
+
+        if (flags & (MCP2515::CANINTF_ERRIF | MCP2515::CANINTF_MERRF)) {
+            uint8_t errors = canController->getErrorFlags();
+            if (errors & MCP2515::EFLG_RX0OVR) rxStats.rxOverruns++;
+            if (errors & MCP2515::EFLG_RX1OVR) rxStats.rxOverruns++;
+            canController->clearRXnOVRFlags();
+            canController->clearERRIF();
+            canController->clearMERR();
+        }
+
+        uint8_t pending = flags & (MCP2515::CANINTF_RX0IF | MCP2515::CANINTF_RX1IF);
+        if (pending == 0) {
+            break;
+        }
+
+        // With rollover RXB1 only fills while RXB0 is full, so RXB0 is older
+        if (pending & MCP2515::CANINTF_RX0IF) {
+            readBuffer(MCP2515::RXB0, stampUs);
+            burst++;
+        }
+        if (pending & MCP2515::CANINTF_RX1IF) {
+            readBuffer(MCP2515::RXB1, stampUs);
+            burst++;
+        }
+        stampUs = esp_timer_get_time();
+    }
+
+    if (burst > rxStats.maxBurst) {
+        rxStats.maxBurst = burst;
+    }
+}
+
+// =============================================================================
+// Consumer
+// =============================================================================
+
+// RPM mode only needs the messages of the signal table, unless capturing
+static void planForMode() {
+    if (currentMode == CAN_MODE_RPM && canCaptureRequested() == CAN_CAPTURE_OFF) {
+        CanId ids[CAN_SIGNAL_MAX_IDS];
+        for (uint32_t i = 0; i < decoder.idCount(); i++) {
+            ids[i] = decoder.id(i);
         }
+        canSetAcceptedIds(ids, decoder.idCount());
+    } else if (!activePlan.open) {
+        canSetAcceptedIds(nullptr, 0);
+    }
+}
+
+void canRefreshFilters() {
+    planForMode();
+}
+
+void canSetMode(CanMode mode) {
+    currentMode = mode;
+    if (mode == CAN_MODE_IDLE) {
+        Serial.println("CAN mode: IDLE - counting messages");
+    } else if (mode == CAN_MODE_SNIFF) {
+        Serial.println("CAN mode: SNIFF - logging all messages");
+    } else {
+        Serial.printf("CAN mode: RPM - following %s, ID 0x%03lX\n", signalDefs[rpmSignal].name,
+                      (unsigned long)signalDefs[rpmSignal].id);
+    }
+    planForMode();
+}
+
+bool canSetSignals(const CanSignalDef* defs, uint32_t count, uint32_t rpmIndex) {
+    if (count > CAN_SIGNAL_MAX || rpmIndex >= count) {
+        Serial.printf("CAN signals: table of %lu invalid\n", (unsigned long)count);
+        return false;
+    }
+    memcpy(signalDefs, defs, count * sizeof(CanSignalDef));
+    if (!decoder.compile(signalDefs, count)) {
+        Serial.println("CAN signals: definition does not fit 8 bytes or too many IDs");
+        decoder.compile(nullptr, 0);
         return false;
     }
+    rpmSignal = rpmIndex;
+    rpmUpdates = 0;
+    if (currentMode == CAN_MODE_RPM) {
+        planForMode();
+    }
+    return true;
+}
 
-    messageCount++;
+// IDs above 11 bits are extended
+void canSetRpmMessageId(uint32_t messageId) {
+    CanSignalDef defs[CAN_SIGNAL_MAX];
+    uint32_t count = decoder.signalCount();
+    memcpy(defs, signalDefs, count * sizeof(CanSignalDef));
+    defs[rpmSignal].id = messageId;
+    defs[rpmSignal].extended = messageId > 0x7FF;
+    canSetSignals(defs, count, rpmSignal);
+}
 
-    if (currentMode == CAN_MODE_SNIFF) {
-        printCanMessage(frame);
+bool canGetSignal(uint32_t index, CanSignalValue* value) {
+    if (index >= decoder.signalCount()) {
         return false;
     }
+    *value = decoder.value(index);
+    return value->updates > 0;
+}
 
-    // RPM mode - check if this is our target message
-    uint32_t msgId = frame.can_id & (frame.can_id & CAN_EFF_FLAG ? CAN_EFF_MASK : CAN_SFF_MASK);
-    if (msgId == rpmMessageId && rpm != nullptr) {
-        *rpm = extractRpmFromFrame(frame);
-        return true;
+// One deferred record per frame: sniffing runs on the UI task
+static void printCanMessage(const CanFrame& frame) {
+    uint32_t high = 0;
+    uint32_t low = 0;
+    for (int i = 0; i < 4; i++) {
+        high = (high << 8) | frame.data[i];
+        low = (low << 8) | frame.data[i + 4];
     }
+    LOG_PRINTF("[%lu] %s ID: 0x%08lX %sDLC: %u Data: %08lX%08lX\n",
+               (unsigned long)(frame.timeUs / 1000),
+               (frame.flags & CAN_FRAME_EXTENDED) ? "EXT" : "STD",
+               (unsigned long)frame.id,
+               (frame.flags & CAN_FRAME_RTR) ? "RTR " : "",
+               frame.dlc, (unsigned long)high, (unsigned long)low);
+}
 
-    return false;
+bool canProcess(uint16_t* rpm) {
+    if (!canInitialized && !canReplayActive() && ring.depth() == 0) {
+        return false;
+    }
+
+    CanFrame frame;
+    while (ring.pop(&frame)) {
+        messageCount++;
+
+        bool extended = (frame.flags & CAN_FRAME_EXTENDED) != 0;
+        if (activePlan.open) {
+            survey.add(frame.id, extended);
+        } else {
+            planFrames++;
+            if (!activePlan.exact && !canFilterWanted(&activePlan, frame.id, extended)) {
+                softwareRejected++;
+                continue;
+            }
+        }
+
+        decoder.decode(frame);
+        if (currentMode == CAN_MODE_SNIFF) {
+            printCanMessage(frame);
+        }
+    }
+
+    // RPM mode - newest value of the RPM signal wins
+    if (currentMode != CAN_MODE_RPM || rpm == nullptr) {
+        return false;
+    }
+    return pumpAssistRpm(decoder.value(rpmSignal), &rpmUpdates, rpm);
 }
 
+// =============================================================================
+// Statistics
+// =============================================================================
+
 uint32_t canGetMessageCount() {
     return messageCount;
 }
 
 uint32_t canGetErrorCount() {
-    return errorCount;
+    return errorCount + rxStats.readErrors;
+}
+
+void canGetRxStats(CanRxStats* stats) {
+    *stats = rxStats;
+    stats->ringOverruns = ring.overruns();
+    stats->maxDepth = ring.maxDepth();
+}
+
+void canPrintRxStats() {
+    CanRxStats s;
+    canGetRxStats(&s);
+
+    Serial.printf("CAN RX: %lu frames in %lu wakes (burst max %lu), latency max %lu us\n",
+                  s.frames, s.wakes, s.maxBurst, s.maxLatencyUs);
+    Serial.printf("CAN Overruns: controller %lu, ring %lu (%lu/%lu waiting at most)\n",
+                  s.rxOverruns, s.ringOverruns, s.maxDepth, ring.capacity());
+    if (s.replayed > 0) {
+        Serial.printf("CAN Replayed: %lu frames from captures\n", s.replayed);
+    }
+
+    uint64_t nowUs = (uint64_t)esp_timer_get_time();
+    for (uint32_t i = 0; i < decoder.signalCount(); i++) {
+        const CanSignalValue& v = decoder.value(i);
+        if (v.updates == 0) {
+            Serial.printf("CAN Signal %s: never received\n", signalDefs[i].name);
+        } else {
+            Serial.printf("CAN Signal %s: %.3f (%lu updates, %lu ms ago)\n", signalDefs[i].name,
+                          (double)v.value / (1 << CAN_SIGNAL_FRACTION_BITS),
+                          (unsigned long)v.updates, (unsigned long)((nowUs - v.timeUs) / 1000));
+        }
+    }
+
+    if (activePlan.open) {
+        Serial.printf("CAN Filter: open, survey %lu IDs / %lu frames (%lu untracked)\n",
+                      survey.ids(), survey.frames(), survey.untracked());
+        return;
+    }
+    // The controller does not count what it rejects: compare the rate that
+    // gets through with the rate seen while open
+    uint32_t elapsedMs = millis() - planStartMs;
+    Serial.printf("CAN Filter: %lu IDs, %s, %lu rejected in software",
+                  (unsigned long)activePlan.wantedCount,
+                  activePlan.exact ? "exact" : "inexact", softwareRejected);
+    if (activePlan.surveyFrames > 0) {
+        Serial.printf(", hardware rejects %.1f%% predicted",
+                      canFilterPredictedRejection(&activePlan) * 100.0f);
+    }
+    if (surveyFramesPerSec > 0 && elapsedMs > 0) {
+        float rate = planFrames * 1000.0f / elapsedMs;
+        float rejected = rate < surveyFramesPerSec ? 1.0f - rate / surveyFramesPerSec : 0.0f;
+        Serial.printf(", %.1f%% measured", rejected * 100.0f);
+    }
+    Serial.println();
+}
+
+// =============================================================================
+// Per-ID Statistics
+// =============================================================================
+
+void canGetBusSummary(CanBusSummary* summary, float* averageLoad) {
+    uint64_t nowUs = (uint64_t)esp_timer_get_time();
+    portENTER_CRITICAL(&busStatsMux);
+    busStats.tick(nowUs);
+    *summary = busStats.summary();
+    *averageLoad = busStats.averageLoad();
+    portEXIT_CRITICAL(&busStatsMux);
+}
+
+bool canGetIdStats(uint32_t index, CanIdStats* stats) {
+    portENTER_CRITICAL(&busStatsMux);
+    bool found = busStats.entry(index, stats);
+    portEXIT_CRITICAL(&busStatsMux);
+    return found;
+}
+
+void canResetIdStats() {
+    portENTER_CRITICAL(&busStatsMux);
+    busStats.reset();
+    portEXIT_CRITICAL(&busStatsMux);
+}
+
+// One line per ID in table order, copied one entry at a time so the RX
+// task is never held up for the whole table
+void canPrintIdStats() {
+    CanBusSummary summary;
+    float average;
+    canGetBusSummary(&summary, &average);
+    if (summary.frames == 0) {
+        Serial.println("CAN IDs: no frames since the reset");
+        return;
+    }
+
+    Serial.printf("CAN IDs: %lu IDs, %lu frames (%lu untracked) in %lu s\n",
+                  summary.ids, summary.frames, summary.untracked,
+                  (unsigned long)((summary.lastUs - summary.startUs) / 1000000));
+    Serial.printf("CAN Bus load: %.1f%% last second (%lu frames/s), %.1f%% peak, %.1f%% average%s\n",
+                  summary.load * 100.0f, summary.framesPerSec, summary.peakLoad * 100.0f,
+                  average * 100.0f, activePlan.open ? "" : " (accepted frames only)");
+    Serial.println("  ID          frames  period ms  jitter ms  interval ms        DLC data              changed");
+
+    CanIdStats s;
+    for (uint32_t i = 0; i < CAN_STATS_SLOTS; i++) {
+        if (!canGetIdStats(i, &s)) {
+            continue;
+        }
+        char id[12];
+        snprintf(id, sizeof(id), s.extended ? "0x%08lX" : "0x%03lX", (unsigned long)s.id);
+        char timing[48];
+        if (s.frames < 2) {
+            snprintf(timing, sizeof(timing), "%-41s", "");
+        } else {
+            snprintf(timing, sizeof(timing), "%9.2f  %9.3f  %8.2f..%-8.2f", s.periodUs / 1000.0f,
+                     s.jitterUs / 1000.0f, s.minIntervalUs / 1000.0f, s.maxIntervalUs / 1000.0f);
+        }
+        char data[17];
+        char changed[9];
+        for (uint32_t b = 0; b < 8; b++) {
+            snprintf(data + 2 * b, 3, "%02X", s.data[b]);
+            changed[b] = (s.changed & (1u << b)) ? (char)('0' + b) : '.';
+        }
+        changed[8] = '\0';
+        Serial.printf("  %-10s %7lu  %s %s%u  %s  %s%s\n", id, s.frames, timing,
+                      s.rtr ? "R" : " ", s.dlc, data, changed,
+                      s.dlcChanges > 0 ? " (DLC varies)" : "");
+    }
 }
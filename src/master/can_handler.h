@@ -2,34 +2,121 @@
 #define CAN_HANDLER_H
 
 #include <stdint.h>
+#include "master/can_bus_stats.h"
+#include "master/can_filter.h"
+#include "master/can_frame_ring.h"
+#include "master/can_signal.h"
+#include "master/can_tx_schedule.h"
+#include "master/pump_assist.h"
+
+// MCP2515 CAN receive path
+//
+// The MCP2515 pulls MCP2515_INT_PIN low when a frame lands in one of its
+// two receive buffers. The interrupt records the time and wakes the CAN RX
+// task, which reads both buffers, and keeps reading until neither holds a
+// frame, pushing each into a CanFrameRing (can_frame_ring.h) stamped with
+// the interrupt time. canProcess() consumes the ring from the UI task.
+// Frames lost are counted where they are lost: in the controller when both
+// buffers were full (RX overrun), or in the ring when the consumer fell
+// behind.
+//
+// Acceptance filters keep unwanted frames off the SPI bus altogether. While
+// they are open canProcess() surveys the traffic per ID; canSetAcceptedIds()
+// plans masks and filters against that survey (can_filter.h) and the RX
+// task programs them. When the IDs do not fit the filters exactly the rest
+// is rejected in software by canProcess().
+//
+// canProcess() decodes every frame through a table of DBC-style signals
+// (can_signal.h); RPM mode follows one of them.
+//
+// Periodic transmit messages (can_tx_schedule.h) are sent by the same task,
+// which owns the controller's SPI bus: an esp_timer wakes it at each
+// deadline, and each message has its own TX buffer. Sending can be gated
+// on a frame being seen, such as the pump's alive message.
+//
+// The RX task also feeds every frame it reads to the CAN capture
+// (master/can_capture.h), ahead of the ring, and to the per-ID statistics
+// and bus load (master/can_bus_stats.h), so the consumer falling behind
+// does not skew them.
+//
+// A replay (master/can_replay.h) pushes recorded frames into the ring from
+// the same task instead; the controller's frames then stay out of it.
 
 // Operating modes
 enum CanMode {
+    CAN_MODE_IDLE,     // Count messages only
     CAN_MODE_SNIFF,    // Log all messages to serial
-    CAN_MODE_RPM       // Extract RPM from configured message ID
+    CAN_MODE_RPM       // Follow the RPM signal
 };
 
-// Initialize MCP2515 CAN controller
+typedef struct {
+    uint32_t frames;            // Read from the controller
+    uint32_t wakes;             // Interrupts (or INT pin polls) handled
+    uint32_t rxOverruns;        // Controller had both buffers full, frames lost on the chip
+    uint32_t ringOverruns;      // Ring full, frames lost before canProcess()
+    uint32_t readErrors;
+    uint32_t maxBurst;          // Most frames read in one wake
+    uint32_t maxDepth;          // Most frames waiting for canProcess()
+    uint32_t maxLatencyUs;      // Interrupt to frame in the ring
+    uint32_t replayed;          // Pushed by a replay (master/can_replay.h)
+} CanRxStats;
+
+// Initialize MCP2515 CAN controller and its interrupt
 bool canInit();
 
+// CAN RX task body: wait up to waitMs for the interrupt, then read until
+// both receive buffers are empty
+void canRxProcess(uint32_t waitMs);
+
 // Set operating mode
 void canSetMode(CanMode mode);
 
-// Set the CAN message ID to filter for RPM extraction
+// Replace the signal table (copied); RPM mode follows signal rpmIndex.
+// False if a definition is invalid or the table too big.
+bool canSetSignals(const CanSignalDef* defs, uint32_t count, uint32_t rpmIndex);
+
+// Move the RPM signal to another message ID; above 11 bits is extended
 void canSetRpmMessageId(uint32_t messageId);
 
-// Set byte position and scale for RPM extraction
-// RPM = (data[byteOffset] | (data[byteOffset+1] << 8)) * scale
-void canSetRpmExtraction(uint8_t byteOffset, float scale);
+// Latest value of a signal, false if never received
+bool canGetSignal(uint32_t index, CanSignalValue* value);
+
+// Receive only these IDs (none = everything). RPM mode accepts the
+// messages of the signal table, the other modes everything. False if
+// there are too many IDs.
+bool canSetAcceptedIds(const CanId* ids, uint32_t count);
 
-// Process incoming CAN messages
-// In sniff mode: logs to serial
-// In RPM mode: extracts and returns RPM value
+// Plan the filters again for the mode, e.g. after a capture starts or
+// stops (a capture takes every frame)
+void canRefreshFilters();
+
+// Add a periodic message; only while transmit is disabled
+bool canTxAddMessage(const CanTxMessage& message);
+
+// Send only while frames of this ID arrive at most timeoutMs apart
+void canTxSetGate(uint32_t id, bool extended, uint32_t timeoutMs);
+
+void canTxEnable(bool enable);
+bool canTxIsEnabled();
+void canPrintTxStats();
+
+// Consume the frames received so far
+// In sniff mode: logs them
+// In RPM mode: takes the newest RPM signal value
 // Returns true if new RPM value available
 bool canProcess(uint16_t* rpm);
 
 // Get statistics
 uint32_t canGetMessageCount();
 uint32_t canGetErrorCount();
+void canGetRxStats(CanRxStats* stats);
+void canPrintRxStats();
+
+// Per-ID statistics since canInit() or the reset; entries by table slot
+// (index below CAN_STATS_SLOTS), false for empty slots
+void canGetBusSummary(CanBusSummary* summary, float* averageLoad);
+bool canGetIdStats(uint32_t index, CanIdStats* stats);
+void canResetIdStats();
+void canPrintIdStats();
 
 #endif // CAN_HANDLER_H
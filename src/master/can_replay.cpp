@@ -0,0 +1,311 @@
+#include "master/can_replay.h"
+#include "master/can_capture.h"
+#include "master/deferred_log.h"
+#include "master/sd_handler.h"
+#include "master/sd_io.h"
+#include "shared/config.h"
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CAN_REPLAY_PATH_MAX     24
+#define CAN_REPLAY_RETRY_US     5000    // Ring full: try again after this
+
+static uint8_t* buffer = nullptr;
+static uint32_t bufferSize = 0;
+static esp_timer_handle_t timer = nullptr;
+static TaskHandle_t serviceTask = nullptr;
+
+// Set by canReplayStart() / canReplayStop(), taken by the CAN RX task
+static uint32_t requestCount = 0;           // Bumped by every request
+static bool requestRun = false;
+static uint32_t requestFile = 0;
+static uint32_t requestSpeed = 1;
+static portMUX_TYPE requestMux = portMUX_INITIALIZER_UNLOCKED;
+
+// CAN RX task
+static CanReplayReader reader;
+static CanReplayPacer pacer;
+static uint32_t takenCount = 0;
+static volatile bool active = false;
+static char path[CAN_REPLAY_PATH_MAX];
+static uint32_t offset = 0;                 // Of the next chunk in the file
+static bool endOfFile = false;
+static bool paced = false;                  // Pacer started, at the first frame
+static bool holding = false;                // frame read, waiting until dueUs
+static CanFrame frame;
+static uint64_t dueUs = 0;
+static CanReplayStatus status;
+
+// The read in flight, completed on the SD I/O task
+static bool readPending = false;
+static uint32_t readLength = 0;
+static volatile bool readDone = false;
+static volatile int32_t readResult = 0;
+
+// =============================================================================
+// Reading
+// =============================================================================
+
+static void replayPath(uint32_t index, char* out, size_t size) {
+    snprintf(out, size, CAN_CAPTURE_DIR "/%05lu.cap", (unsigned long)index);
+}
+
+static void wake() {
+    if (serviceTask != nullptr) {
+        xTaskNotify(serviceTask, CAN_REPLAY_NOTIFY, eSetBits);
+    }
+}
+
+// Runs on the SD I/O task
+static void onChunkRead(int32_t result, void* context) {
+    readResult = result;
+    readDone = true;
+    wake();
+}
+
+static void timerExpired(void* arg) {
+    wake();
+}
+
+// Take the chunk that came in, then ask for the next one while there is
+// room for a good part of the buffer, or nothing left to replay
+static void serviceReads() {
+    if (readPending && readDone) {
+        readPending = false;
+        if (readResult < 0) {
+            status.readErrors++;
+            endOfFile = true;
+        } else {
+            reader.filled((uint32_t)readResult);
+            offset += (uint32_t)readResult;
+            status.bytesRead += (uint32_t)readResult;
+            endOfFile = (uint32_t)readResult < readLength;
+        }
+        if (endOfFile) {
+            reader.finish();
+        }
+    }
+    if (readPending || endOfFile) {
+        return;
+    }
+
+    uint32_t room;
+    uint8_t* at = reader.space(&room);
+    if (at == nullptr || (room < bufferSize / 2 && holding)) {
+        return;
+    }
+    readLength = room;
+    readDone = false;
+    if (sdIoReadAt(path, offset, at, room, SD_IO_BULK, onChunkRead, nullptr)) {
+        readPending = true;
+    }
+}
+
+// =============================================================================
+// Replay
+// =============================================================================
+
+static void startReplay(uint32_t fileIndex, uint32_t speed, uint64_t nowUs) {
+    reader.init(buffer, bufferSize);
+    replayPath(fileIndex, path, sizeof(path));
+    offset = 0;
+    endOfFile = false;
+    paced = false;
+    holding = false;
+    memset(&status, 0, sizeof(status));
+    status.fileIndex = fileIndex;
+    status.speed = speed;
+    status.startUs = nowUs;
+    active = true;
+}
+
+static void stopReplay(uint64_t nowUs, const char* why) {
+    active = false;
+    holding = false;
+    status.endUs = nowUs;
+    status.reader = reader.stats();
+    if (timer != nullptr) {
+        esp_timer_stop(timer);
+    }
+    LOG_PRINTF("CAN replay: %s, %lu frames\n", why, (unsigned long)status.delivered);
+}
+
+// =============================================================================
+// Public API
+// =============================================================================
+
+bool canReplayInit() {
+    if (buffer != nullptr) return true;
+
+    size_t size = CAN_REPLAY_BUFFER_KB * 1024UL;
+    buffer = (uint8_t*)heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+    if (buffer == nullptr) {
+        // One capture block is enough to replay from internal RAM
+        size = CAN_CAPTURE_BLOCK_KB * 1024UL;
+        buffer = (uint8_t*)malloc(size);
+    }
+    if (buffer == nullptr) {
+        Serial.println("CAN replay: Not enough memory for the read buffer");
+        return false;
+    }
+    bufferSize = size;
+
+    esp_timer_create_args_t timerArgs = {};
+    timerArgs.callback = timerExpired;
+    timerArgs.name = "can_replay";
+    if (esp_timer_create(&timerArgs, &timer) != ESP_OK) {
+        Serial.println("CAN replay: Timer failed - pacing on the RX task's idle wakes");
+        timer = nullptr;
+    }
+    return true;
+}
+
+bool canReplayStart(uint32_t fileIndex, uint32_t speed) {
+    char file[CAN_REPLAY_PATH_MAX];
+    replayPath(fileIndex, file, sizeof(file));
+    if (buffer == nullptr || !sdIsReady() || !sdExists(file)) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&requestMux);
+    requestCount++;
+    requestRun = true;
+    requestFile = fileIndex;
+    requestSpeed = speed;
+    portEXIT_CRITICAL(&requestMux);
+    wake();
+    return true;
+}
+
+void canReplayStop() {
+    portENTER_CRITICAL(&requestMux);
+    requestCount++;
+    requestRun = false;
+    portEXIT_CRITICAL(&requestMux);
+    wake();
+}
+
+bool canReplayActive() {
+    return active;
+}
+
+void canReplayService(uint64_t nowUs, CanReplayDeliver deliver) {
+    if (buffer == nullptr) {
+        return;
+    }
+    if (serviceTask == nullptr) {
+        serviceTask = xTaskGetCurrentTaskHandle();
+    }
+
+    uint32_t count;
+    bool run;
+    uint32_t fileIndex;
+    uint32_t speed;
+    portENTER_CRITICAL(&requestMux);
+    count = requestCount;
+    run = requestRun;
+    fileIndex = requestFile;
+    speed = requestSpeed;
+    portEXIT_CRITICAL(&requestMux);
+
+    if (count != takenCount) {
+        if (active) {
+            stopReplay(nowUs, "stopped");
+        }
+        // The buffer is the SD I/O task's until its read completes
+        if (readPending && !readDone) {
+            return;
+        }
+        readPending = false;
+        takenCount = count;
+        if (run) {
+            startReplay(fileIndex, speed, nowUs);
+        }
+    }
+    if (!active) {
+        return;
+    }
+
+    serviceReads();
+
+    // Frames due by now, in order; the clock starts at the first frame, not
+    // at the first read
+    uint64_t retryUs = 0;
+    while (true) {
+        if (!holding) {
+            if (!reader.next(&frame)) break;
+            if (!paced) {
+                pacer.start(status.speed, nowUs);
+                paced = true;
+            }
+            dueUs = pacer.due(frame.timeUs);
+            holding = true;
+        }
+        if (dueUs > nowUs) break;
+
+        CanFrame live = frame;
+        live.timeUs = nowUs;
+        if (!deliver(live)) {
+            status.held++;
+            retryUs = CAN_REPLAY_RETRY_US;
+            break;
+        }
+        uint64_t late = nowUs - dueUs;
+        if (late > status.maxLateUs) {
+            status.maxLateUs = late > UINT32_MAX ? UINT32_MAX : (uint32_t)late;
+        }
+        status.delivered++;
+        holding = false;
+    }
+    status.reader = reader.stats();
+
+    serviceReads();
+    if (!holding && reader.done()) {
+        stopReplay(nowUs, "done");
+        return;
+    }
+
+    // Wake for the next frame; a chunk read wakes the task by itself
+    if (timer != nullptr && holding) {
+        if (retryUs == 0) {
+            retryUs = dueUs > nowUs ? dueUs - nowUs : 1;
+        }
+        esp_timer_stop(timer);
+        esp_timer_start_once(timer, retryUs);
+    }
+}
+
+void canReplayGetStatus(CanReplayStatus* out) {
+    *out = status;
+    out->active = active;
+}
+
+void canReplayPrintStats() {
+    CanReplayStatus s;
+    canReplayGetStatus(&s);
+
+    if (s.startUs == 0) {
+        Serial.println("CAN replay: Off");
+        return;
+    }
+    char file[CAN_REPLAY_PATH_MAX];
+    replayPath(s.fileIndex, file, sizeof(file));
+    uint64_t endUs = s.active ? (uint64_t)esp_timer_get_time() : s.endUs;
+    char speed[12];
+    if (s.speed == CAN_REPLAY_ASAP) {
+        snprintf(speed, sizeof(speed), "max speed");
+    } else {
+        snprintf(speed, sizeof(speed), "%lux", (unsigned long)s.speed);
+    }
+    Serial.printf("CAN replay: %s %s, %s, %lu s\n", s.active ? "Replaying" : "Replayed", file,
+                  speed, (unsigned long)((endUs - s.startUs) / 1000000));
+    Serial.printf("  %lu frames delivered, ring full %lu times, late max %lu us, %lu read errors\n",
+                  s.delivered, s.held, s.maxLateUs, s.readErrors);
+    Serial.printf("  %llu KB read, %lu blocks (%lu missing), %llu bytes skipped\n",
+                  s.bytesRead / 1024, s.reader.blocks, s.reader.missingBlocks, s.reader.skippedBytes);
+    Serial.printf("  Capture lost %lu frames (no buffer) and %lu to controller overruns\n",
+                  s.reader.dropped, s.reader.overruns);
+}
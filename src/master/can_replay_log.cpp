@@ -0,0 +1,169 @@
+#include "master/can_replay_log.h"
+#include <string.h>
+
+// =============================================================================
+// Reader
+// =============================================================================
+
+CanReplayReader::CanReplayReader()
+    : _buffer(nullptr)
+    , _size(0)
+    , _start(0)
+    , _end(0)
+    , _records(0)
+    , _finished(false)
+    , _sequenced(false)
+    , _nextSequence(0) {
+    memset(&_header, 0, sizeof(_header));
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+bool CanReplayReader::init(uint8_t* buffer, uint32_t size) {
+    if (buffer == nullptr || size < sizeof(CanCaptureBlockHeader) + 2 * sizeof(CanCaptureRecord)) {
+        return false;
+    }
+    _buffer = buffer;
+    _size = size;
+    _start = 0;
+    _end = 0;
+    _records = 0;
+    _finished = false;
+    _sequenced = false;
+    _nextSequence = 0;
+    memset(&_stats, 0, sizeof(_stats));
+    return true;
+}
+
+uint8_t* CanReplayReader::space(uint32_t* length) {
+    if (_start > 0) {
+        memmove(_buffer, _buffer + _start, _end - _start);
+        _end -= _start;
+        _start = 0;
+    }
+    *length = _size - _end;
+    return *length > 0 ? _buffer + _end : nullptr;
+}
+
+void CanReplayReader::filled(uint32_t length) {
+    _end += length <= _size - _end ? length : _size - _end;
+}
+
+void CanReplayReader::finish() {
+    _finished = true;
+}
+
+void CanReplayReader::skip(uint32_t bytes) {
+    _start += bytes;
+    _stats.skippedBytes += bytes;
+}
+
+// Move to the next valid block, skipping anything else. False when the
+// rest of the buffer could still be the start of one.
+bool CanReplayReader::nextBlock() {
+    static const uint8_t MAGIC[4] = {
+        (uint8_t)CAN_CAPTURE_MAGIC, (uint8_t)(CAN_CAPTURE_MAGIC >> 8),
+        (uint8_t)(CAN_CAPTURE_MAGIC >> 16), (uint8_t)(CAN_CAPTURE_MAGIC >> 24)
+    };
+
+    while (true) {
+        uint32_t available = _end - _start;
+        if (available < sizeof(MAGIC)) {
+            if (_finished) skip(available);
+            return false;
+        }
+
+        // Up to the magic, or to the last bytes that could begin one
+        const uint8_t* at = _buffer + _start;
+        uint32_t offset = 0;
+        while (offset + sizeof(MAGIC) <= available && memcmp(at + offset, MAGIC, sizeof(MAGIC)) != 0) {
+            offset++;
+        }
+        skip(offset);
+        available -= offset;
+        at = _buffer + _start;
+        if (available < sizeof(CanCaptureBlockHeader)) {
+            if (_finished) skip(available);
+            return false;
+        }
+
+        CanCaptureBlockHeader header;
+        memcpy(&header, at, sizeof(header));
+        uint32_t length = sizeof(CanCaptureBlockHeader) + header.recordCount * sizeof(CanCaptureRecord);
+        if (length <= _size && length > available && !_finished) {
+            return false;
+        }
+        if (length > available || canCaptureBlockLength(at, length) != length) {
+            skip(1);
+            continue;
+        }
+
+        if (_sequenced && header.sequence > _nextSequence) {
+            _stats.missingBlocks += header.sequence - _nextSequence;
+        }
+        _sequenced = true;
+        _nextSequence = header.sequence + 1;
+        _header = header;
+        _records = header.recordCount;
+        _start += sizeof(CanCaptureBlockHeader);
+        _stats.blocks++;
+        _stats.dropped = header.dropped;
+        _stats.overruns = header.overruns;
+        return true;
+    }
+}
+
+bool CanReplayReader::next(CanFrame* frame) {
+    while (_records == 0) {
+        if (!nextBlock()) {
+            return false;
+        }
+    }
+    CanCaptureRecord record;
+    memcpy(&record, _buffer + _start, sizeof(record));
+    canCaptureDecode(&_header, &record, frame);
+    _start += sizeof(CanCaptureRecord);
+    _records--;
+    _stats.frames++;
+    return true;
+}
+
+bool CanReplayReader::done() const {
+    return _finished && _records == 0 && _start == _end;
+}
+
+// =============================================================================
+// Pacer
+// =============================================================================
+
+CanReplayPacer::CanReplayPacer()
+    : _speed(1)
+    , _anchored(false)
+    , _anchorRecordedUs(0)
+    , _anchorDueUs(0)
+    , _lastRecordedUs(0)
+    , _lastDueUs(0)
+    , _restarts(0) {
+}
+
+void CanReplayPacer::start(uint32_t speed, uint64_t nowUs) {
+    _speed = speed;
+    _anchored = false;
+    _lastDueUs = nowUs;
+    _restarts = 0;
+}
+
+uint64_t CanReplayPacer::due(uint64_t recordedUs) {
+    if (!_anchored || recordedUs < _lastRecordedUs) {
+        if (_anchored) {
+            _restarts++;
+        }
+        _anchored = true;
+        _anchorRecordedUs = recordedUs;
+        _anchorDueUs = _lastDueUs;
+    }
+    _lastRecordedUs = recordedUs;
+    if (_speed != CAN_REPLAY_ASAP) {
+        _lastDueUs = _anchorDueUs + (recordedUs - _anchorRecordedUs) / _speed;
+    }
+    return _lastDueUs;
+}
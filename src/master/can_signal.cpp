@@ -0,0 +1,166 @@
+#include "master/can_signal.h"
+#include <string.h>
+
+#define EXTRACT_MOTOROLA    0x01
+#define EXTRACT_SIGNED      0x02
+
+static uint32_t idKey(uint32_t id, bool extended) {
+    return (extended ? (id & 0x1FFFFFFF) | 0x20000000u : (id & 0x7FF)) | 0x40000000u;
+}
+
+static uint32_t slotHome(uint32_t key) {
+    return (key * 2654435761u) >> 27;   // Top 5 bits: CAN_SIGNAL_ID_SLOTS
+}
+
+CanSignalDecoder::CanSignalDecoder()
+    : _defs(nullptr)
+    , _signalCount(0)
+    , _idCount(0) {
+    memset(_slots, 0, sizeof(_slots));
+    memset(_values, 0, sizeof(_values));
+}
+
+// =============================================================================
+// Compile
+// =============================================================================
+
+bool CanSignalDecoder::compile(const CanSignalDef* defs, uint32_t count) {
+    _defs = defs;
+    _signalCount = 0;
+    _idCount = 0;
+    memset(_slots, 0, sizeof(_slots));
+    memset(_values, 0, sizeof(_values));
+    if (count > CAN_SIGNAL_MAX || (defs == nullptr && count > 0)) {
+        return false;
+    }
+
+    // One extractor per signal, shift counted from bit 0 of the word
+    // decode() builds for its byte order
+    Extractor built[CAN_SIGNAL_MAX];
+    uint32_t keys[CAN_SIGNAL_MAX];
+    for (uint32_t i = 0; i < count; i++) {
+        const CanSignalDef& def = defs[i];
+        if (def.length == 0 || def.length > 32 || def.startBit > 63) {
+            return false;
+        }
+
+        Extractor& e = built[i];
+        e.mask = def.length == 32 ? 0xFFFFFFFFu : (1u << def.length) - 1;
+        e.length = def.length;
+        e.signal = (uint8_t)i;
+        e.factor = def.factor;
+        e.offset = def.offset;
+        e.flags = def.isSigned ? EXTRACT_SIGNED : 0;
+
+        if (def.order == CAN_SIGNAL_INTEL) {
+            // Word with byte 0 lowest: DBC bit n is word bit n
+            if (def.startBit + def.length > 64) {
+                return false;
+            }
+            e.shift = def.startBit;
+            e.minDlc = (uint8_t)((def.startBit + def.length - 1) / 8 + 1);
+        } else {
+            // Word with byte 0 highest: DBC bit n is word bit (7 - n / 8) * 8 + n % 8
+            int msb = (7 - def.startBit / 8) * 8 + def.startBit % 8;
+            int lsb = msb - def.length + 1;
+            if (lsb < 0) {
+                return false;
+            }
+            e.shift = (uint8_t)lsb;
+            e.minDlc = (uint8_t)(7 - lsb / 8 + 1);
+            e.flags |= EXTRACT_MOTOROLA;
+        }
+        keys[i] = idKey(def.id, def.extended);
+    }
+
+    // Group by ID in table order, one hash slot per ID
+    uint32_t placed = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (find(keys[i]) != nullptr) {
+            continue;
+        }
+        if (_idCount >= CAN_SIGNAL_MAX_IDS) {
+            memset(_slots, 0, sizeof(_slots));
+            _idCount = 0;
+            return false;
+        }
+
+        uint32_t s = slotHome(keys[i]);
+        while (_slots[s].key != 0) {
+            s = (s + 1) & (CAN_SIGNAL_ID_SLOTS - 1);
+        }
+        _slots[s].key = keys[i];
+        _slots[s].first = (uint8_t)placed;
+        for (uint32_t j = i; j < count; j++) {
+            if (keys[j] == keys[i]) {
+                _extractors[placed++] = built[j];
+            }
+        }
+        _slots[s].count = (uint8_t)(placed - _slots[s].first);
+        _ids[_idCount].id = defs[i].id;
+        _ids[_idCount].extended = defs[i].extended;
+        _idCount++;
+    }
+
+    _signalCount = count;
+    return true;
+}
+
+const CanSignalDecoder::Slot* CanSignalDecoder::find(uint32_t key) const {
+    for (uint32_t s = slotHome(key), n = 0; n < CAN_SIGNAL_ID_SLOTS;
+         s = (s + 1) & (CAN_SIGNAL_ID_SLOTS - 1), n++) {
+        if (_slots[s].key == key) {
+            return &_slots[s];
+        }
+        if (_slots[s].key == 0) {
+            break;
+        }
+    }
+    return nullptr;
+}
+
+// =============================================================================
+// Decode
+// =============================================================================
+
+uint32_t CanSignalDecoder::decode(const CanFrame& frame) {
+    if (frame.flags & CAN_FRAME_RTR) {
+        return 0;
+    }
+    const Slot* slot = find(idKey(frame.id, (frame.flags & CAN_FRAME_EXTENDED) != 0));
+    if (slot == nullptr) {
+        return 0;
+    }
+
+    uint64_t intel = 0;
+    uint64_t motorola = 0;
+    for (int i = 0; i < 8; i++) {
+        intel |= (uint64_t)frame.data[i] << (8 * i);
+        motorola = (motorola << 8) | frame.data[i];
+    }
+
+    uint32_t updated = 0;
+    const Extractor* e = &_extractors[slot->first];
+    for (uint32_t n = 0; n < slot->count; n++, e++) {
+        if (frame.dlc < e->minDlc) {
+            continue;
+        }
+        uint64_t word = (e->flags & EXTRACT_MOTOROLA) ? motorola : intel;
+        uint32_t raw = (uint32_t)(word >> e->shift) & e->mask;
+
+        int64_t value;
+        if (e->flags & EXTRACT_SIGNED) {
+            // Sign-extend from length bits
+            value = (int32_t)(raw << (32 - e->length)) >> (32 - e->length);
+        } else {
+            value = raw;
+        }
+
+        CanSignalValue& v = _values[e->signal];
+        v.value = value * e->factor + e->offset;
+        v.timeUs = frame.timeUs;
+        v.updates++;
+        updated++;
+    }
+    return updated;
+}
@@ -0,0 +1,137 @@
+#include "master/can_tx_schedule.h"
+#include <string.h>
+
+CanTxScheduler::CanTxScheduler()
+    : _count(0)
+    , _gateOpen(false) {
+    resetStats();
+}
+
+bool CanTxScheduler::add(const CanTxMessage& message) {
+    if (_count >= CAN_TX_MAX_MESSAGES || message.periodUs == 0 || message.dlc > 8 ||
+        message.buffer >= CAN_TX_BUFFERS || message.build == nullptr ||
+        message.id > (message.extended ? 0x1FFFFFFFu : 0x7FFu)) {
+        return false;
+    }
+    _messages[_count] = message;
+    _deadline[_count] = 0;
+    _due[_count] = 0;
+    memset(&_stats[_count], 0, sizeof(CanTxStats));
+    _stats[_count].minIntervalUs = UINT32_MAX;
+    _count++;
+    return true;
+}
+
+void CanTxScheduler::clear() {
+    _count = 0;
+    _gateOpen = false;
+}
+
+void CanTxScheduler::resetStats() {
+    memset(_stats, 0, sizeof(_stats));
+    for (uint32_t i = 0; i < CAN_TX_MAX_MESSAGES; i++) {
+        _stats[i].minIntervalUs = UINT32_MAX;
+    }
+}
+
+void CanTxScheduler::setGate(bool open, uint64_t nowUs) {
+    if (open && !_gateOpen) {
+        for (uint32_t i = 0; i < _count; i++) {
+            _deadline[i] = nowUs + _messages[i].phaseUs;
+            _stats[i].lastSentUs = 0;       // No interval across a closed gate
+        }
+    }
+    _gateOpen = open;
+}
+
+uint64_t CanTxScheduler::nextDeadline() const {
+    uint64_t earliest = UINT64_MAX;
+    if (!_gateOpen) {
+        return earliest;
+    }
+    for (uint32_t i = 0; i < _count; i++) {
+        if (_deadline[i] < earliest) {
+            earliest = _deadline[i];
+        }
+    }
+    return earliest;
+}
+
+// =============================================================================
+// Dispatch
+// =============================================================================
+
+bool CanTxScheduler::next(uint64_t nowUs, uint32_t* index, CanFrame* frame) {
+    if (!_gateOpen) {
+        return false;
+    }
+
+    while (true) {
+        // Earliest due deadline, higher buffer first on a tie
+        uint32_t pick = _count;
+        for (uint32_t i = 0; i < _count; i++) {
+            if (_deadline[i] > nowUs) {
+                continue;
+            }
+            if (pick == _count || _deadline[i] < _deadline[pick] ||
+                (_deadline[i] == _deadline[pick] &&
+                 _messages[i].buffer > _messages[pick].buffer)) {
+                pick = i;
+            }
+        }
+        if (pick == _count) {
+            return false;
+        }
+
+        const CanTxMessage& m = _messages[pick];
+        CanTxStats& s = _stats[pick];
+
+        // More than a period late: drop the deadlines that passed
+        uint64_t late = nowUs - _deadline[pick];
+        if (late >= m.periodUs) {
+            uint64_t skipped = late / m.periodUs;
+            s.missed += (uint32_t)skipped;
+            _deadline[pick] += skipped * m.periodUs;
+        }
+        _due[pick] = _deadline[pick];
+        _deadline[pick] += m.periodUs;
+
+        memset(frame, 0, sizeof(*frame));
+        frame->id = m.id;
+        frame->flags = m.extended ? CAN_FRAME_EXTENDED : 0;
+        frame->dlc = m.dlc;
+        frame->timeUs = _due[pick];
+        if (!m.build(frame->data, m.context)) {
+            s.declined++;
+            continue;
+        }
+
+        *index = pick;
+        return true;
+    }
+}
+
+void CanTxScheduler::sent(uint32_t index, uint64_t sentUs) {
+    CanTxStats& s = _stats[index];
+    s.sent++;
+
+    uint64_t late = sentUs > _due[index] ? sentUs - _due[index] : 0;
+    if (late > s.maxLateUs) {
+        s.maxLateUs = late > UINT32_MAX ? UINT32_MAX : (uint32_t)late;
+    }
+
+    if (s.lastSentUs != 0) {
+        uint64_t interval = sentUs - s.lastSentUs;
+        uint32_t clamped = interval > UINT32_MAX ? UINT32_MAX : (uint32_t)interval;
+        if (clamped < s.minIntervalUs) s.minIntervalUs = clamped;
+        if (clamped > s.maxIntervalUs) s.maxIntervalUs = clamped;
+        uint32_t period = _messages[index].periodUs;
+        uint32_t jitter = clamped > period ? clamped - period : period - clamped;
+        if (jitter > s.maxJitterUs) s.maxJitterUs = jitter;
+    }
+    s.lastSentUs = sentUs;
+}
+
+void CanTxScheduler::busy(uint32_t index) {
+    _stats[index].busy++;
+}
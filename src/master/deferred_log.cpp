@@ -0,0 +1,143 @@
+#include "master/deferred_log.h"
+#include "master/sd_handler.h"
+#include "master/sd_io.h"
+#include "shared/config.h"
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <string.h>
+
+#define LOG_LINE_MAX    160     // Longest formatted record, longer ones are cut
+
+LogRing deferredLogRing;
+
+static LogSlot slots[LOG_RING_SLOTS];
+static bool lineStart = true;           // Next record begins a line
+static uint32_t reportedDrops = 0;
+
+// Console text waiting for the card, sent in inline-sized appends
+static char sdBuffer[SD_IO_INLINE_BYTES];
+static size_t sdUsed = 0;
+static volatile bool toSd = LOG_TO_SD;
+
+static uint32_t printed = 0;
+static uint32_t sdBytes = 0;
+static uint32_t sdDropped = 0;
+static uint32_t maxDrainUs = 0;
+
+// =============================================================================
+// Output
+// =============================================================================
+
+static void flushSd() {
+    if (sdUsed == 0) {
+        return;
+    }
+    if (sdIoAppend(LOG_PATH, sdBuffer, sdUsed, SD_IO_BULK)) {
+        sdBytes += sdUsed;
+    } else {
+        sdDropped++;
+    }
+    sdUsed = 0;
+}
+
+static void emit(const char* text, size_t length) {
+    Serial.write((const uint8_t*)text, length);
+
+    if (!toSd || !sdIsReady()) {
+        return;
+    }
+    if (sdUsed + length > sizeof(sdBuffer)) {
+        flushSd();
+    }
+    if (length > sizeof(sdBuffer)) {
+        length = sizeof(sdBuffer);
+    }
+    memcpy(sdBuffer + sdUsed, text, length);
+    sdUsed += length;
+}
+
+// "[s.ms] " before the first record of each line
+static void emitRecord(uint64_t timeUs, const char* text, size_t length) {
+    char line[LOG_LINE_MAX + 24];
+    size_t used = 0;
+    if (lineStart) {
+        uint32_t ms = (uint32_t)(timeUs / 1000);
+        used = snprintf(line, sizeof(line), "[%lu.%03lu] ",
+                        (unsigned long)(ms / 1000), (unsigned long)(ms % 1000));
+    }
+    memcpy(line + used, text, length);
+    used += length;
+    lineStart = length > 0 && text[length - 1] == '\n';
+    emit(line, used);
+}
+
+// =============================================================================
+// Drain
+// =============================================================================
+
+bool deferredLogInit() {
+    if (!deferredLogRing.init(slots, LOG_RING_SLOTS)) {
+        Serial.println("Deferred log: LOG_RING_SLOTS must be a power of two");
+        return false;
+    }
+    return true;
+}
+
+void deferredLogProcess() {
+    int64_t start = esp_timer_get_time();
+
+    LogRecord record;
+    char text[LOG_LINE_MAX];
+    while (deferredLogRing.pop(&record)) {
+        size_t length = logFormat(&record, text, sizeof(text));
+        emitRecord(record.timeUs, text, length);
+        printed++;
+    }
+
+    // Report drops once the ring has room again, on a line of their own
+    uint32_t dropped = deferredLogRing.dropped();
+    if (dropped != reportedDrops) {
+        char line[64];
+        int length = snprintf(line, sizeof(line), "%s[log] %lu records dropped\n",
+                              lineStart ? "" : "\n", (unsigned long)(dropped - reportedDrops));
+        reportedDrops = dropped;
+        lineStart = true;
+        emit(line, length);
+    }
+
+    flushSd();
+
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
+    if (elapsed > maxDrainUs) {
+        maxDrainUs = elapsed;
+    }
+}
+
+void deferredLogSetSd(bool enabled) {
+    toSd = enabled;
+}
+
+// =============================================================================
+// Statistics
+// =============================================================================
+
+void deferredLogGetStats(DeferredLogStats* stats) {
+    stats->pushed = deferredLogRing.pushed();
+    stats->dropped = deferredLogRing.dropped();
+    stats->printed = printed;
+    stats->maxDepth = deferredLogRing.maxDepth();
+    stats->sdBytes = sdBytes;
+    stats->sdDropped = sdDropped;
+    stats->maxDrainUs = maxDrainUs;
+    stats->toSd = toSd;
+}
+
+void deferredLogPrintStats() {
+    DeferredLogStats s;
+    deferredLogGetStats(&s);
+
+    Serial.printf("Log: %lu logged, %lu printed, %lu dropped, %lu/%lu waiting at most\n",
+                  s.pushed, s.printed, s.dropped, s.maxDepth, deferredLogRing.capacity());
+    Serial.printf("  Drain max %lu us, SD copy %s (%s): %lu B, %lu appends dropped\n",
+                  s.maxDrainUs, s.toSd ? "on" : "off", LOG_PATH, s.sdBytes, s.sdDropped);
+}
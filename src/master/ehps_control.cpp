@@ -0,0 +1,76 @@
+#include "ehps_control.h"
+#include "can_handler.h"
+#include "tasks.h"
+#include "shared/config.h"
+#include <Arduino.h>
+
+#define EHPS_SPEED_ID       0x02104136
+#define EHPS_KEEPALIVE_ID   0x1AE0092C
+#define EHPS_ALIVE_ID       0x1B200002
+
+static bool initialized = false;
+
+// =============================================================================
+// Payload Builders
+// =============================================================================
+// Run on the CAN RX task at each deadline; data arrives zeroed
+
+static bool buildSpeed(uint8_t* data, void* context) {
+    uint16_t speed = ehpsSpeedForDuty(masterState.currentPwmDuty);
+    data[6] = (uint8_t)(speed >> 8);
+    data[7] = (uint8_t)(speed & 0xFF);
+    return true;
+}
+
+// Content is not documented; the pump only needs to see it
+static bool buildKeepAlive(uint8_t* data, void* context) {
+    return true;
+}
+
+// =============================================================================
+// Setup
+// =============================================================================
+
+bool ehpsInit() {
+    CanTxMessage speed = {};
+    speed.name = "speed";
+    speed.id = EHPS_SPEED_ID;
+    speed.extended = true;
+    speed.dlc = 8;
+    speed.periodUs = EHPS_SPEED_PERIOD_US;
+    speed.phaseUs = 0;
+    speed.buffer = 2;
+    speed.build = buildSpeed;
+
+    CanTxMessage keepAlive = {};
+    keepAlive.name = "keepalive";
+    keepAlive.id = EHPS_KEEPALIVE_ID;
+    keepAlive.extended = true;
+    keepAlive.dlc = 8;
+    keepAlive.periodUs = EHPS_KEEPALIVE_PERIOD_US;
+    keepAlive.phaseUs = EHPS_SPEED_PERIOD_US / 2;
+    keepAlive.buffer = 1;
+    keepAlive.build = buildKeepAlive;
+
+    if (!canTxAddMessage(speed) || !canTxAddMessage(keepAlive)) {
+        Serial.println("EHPS: could not schedule CAN messages");
+        return false;
+    }
+    canTxSetGate(EHPS_ALIVE_ID, true, EHPS_ALIVE_TIMEOUT_MS);
+    initialized = true;
+
+    if (EHPS_CAN_CONTROL) {
+        ehpsEnable(true);
+    }
+    return true;
+}
+
+void ehpsEnable(bool enable) {
+    if (initialized) {
+        canTxEnable(enable);
+    }
+}
+
+bool ehpsIsEnabled() {
+    return initialized && canTxIsEnabled();
+}
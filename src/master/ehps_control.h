@@ -0,0 +1,31 @@
+#ifndef EHPS_CONTROL_H
+#define EHPS_CONTROL_H
+
+#include <stdint.h>
+#include "master/pump_assist.h"
+
+// =============================================================================
+// Volvo EHPS Pump Control over CAN
+// =============================================================================
+// Drives the pump the way the car does (docs/volvo-xc60-eps-can-bus.md):
+//   - 0x02104136 at ~71.4 Hz, vehicle speed in bytes 6-7, big-endian.
+//     Inverted: small values make the pump run fast (more assist)
+//   - 0x1AE0092C keep-alive at ~2.38 Hz, half a speed period out of phase
+// Speed follows the pump task's PWM duty (ehpsSpeedForDuty(), in
+// master/pump_assist.h), so CAN and the analog output command the same
+// assist, failsafe included. Frames are only sent while the pump's alive
+// message 0x1B200002 is being received.
+//
+// Registered with the CAN transmit schedule (can_handler.h); the speed
+// message gets TXB2, which the MCP2515 sends first.
+// =============================================================================
+
+// Register the messages and the alive gate; requires canInit()
+// Sending starts now if EHPS_CAN_CONTROL is set
+bool ehpsInit();
+
+// Start or stop sending (still gated on the alive message)
+void ehpsEnable(bool enable);
+bool ehpsIsEnabled();
+
+#endif // EHPS_CONTROL_H
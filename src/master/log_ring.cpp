@@ -0,0 +1,249 @@
+#include "master/log_ring.h"
+#include <stdio.h>
+
+// =============================================================================
+// Ring
+// =============================================================================
+
+LogRing::LogRing()
+    : _slots(nullptr)
+    , _mask(0)
+    , _enqueuePos(0)
+    , _dequeuePos(0)
+    , _dropped(0)
+    , _maxDepth(0) {
+}
+
+bool LogRing::init(LogSlot* slots, uint32_t count) {
+    if (slots == nullptr || count < 2 || (count & (count - 1)) != 0) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        slots[i].sequence = i;
+    }
+    _slots = slots;
+    _mask = count - 1;
+    _enqueuePos = 0;
+    _dequeuePos = 0;
+    _dropped = 0;
+    _maxDepth = 0;
+    return true;
+}
+
+LogSlot* LogRing::claim(uint32_t* position) {
+    if (_slots == nullptr) {
+        __atomic_fetch_add(&_dropped, 1, __ATOMIC_RELAXED);
+        return nullptr;
+    }
+
+    uint32_t pos = __atomic_load_n(&_enqueuePos, __ATOMIC_RELAXED);
+    while (true) {
+        LogSlot* slot = &_slots[pos & _mask];
+        uint32_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        int32_t diff = (int32_t)(sequence - pos);
+        if (diff == 0) {
+            // Free for this position: take it unless another producer did
+            if (__atomic_compare_exchange_n(&_enqueuePos, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                *position = pos;
+                return slot;
+            }
+        } else if (diff < 0) {
+            // Still holds the record from one lap ago: full
+            __atomic_fetch_add(&_dropped, 1, __ATOMIC_RELAXED);
+            return nullptr;
+        } else {
+            // Another producer got here first
+            pos = __atomic_load_n(&_enqueuePos, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+void LogRing::publish(LogSlot* slot, uint32_t position) {
+    __atomic_store_n(&slot->sequence, position + 1, __ATOMIC_RELEASE);
+}
+
+bool LogRing::pop(LogRecord* record) {
+    if (_slots == nullptr) {
+        return false;
+    }
+
+    uint32_t pos = _dequeuePos;
+    LogSlot* slot = &_slots[pos & _mask];
+    uint32_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+    if ((int32_t)(sequence - (pos + 1)) < 0) {
+        // Empty, or the oldest record is still being written
+        return false;
+    }
+
+    uint32_t waiting = __atomic_load_n(&_enqueuePos, __ATOMIC_RELAXED) - pos;
+    if (waiting > _maxDepth) {
+        _maxDepth = waiting;
+    }
+
+    *record = slot->record;
+    __atomic_store_n(&slot->sequence, pos + _mask + 1, __ATOMIC_RELEASE);
+    _dequeuePos = pos + 1;
+    return true;
+}
+
+uint32_t LogRing::depth() const {
+    return __atomic_load_n(&_enqueuePos, __ATOMIC_RELAXED) - _dequeuePos;
+}
+
+uint32_t LogRing::pushed() const {
+    return __atomic_load_n(&_enqueuePos, __ATOMIC_RELAXED);
+}
+
+uint32_t LogRing::dropped() const {
+    return __atomic_load_n(&_dropped, __ATOMIC_RELAXED);
+}
+
+// =============================================================================
+// Formatting
+// =============================================================================
+
+// Walks the format one conversion at a time, reading each argument from the
+// record with the type its length modifier and conversion imply, and hands
+// the single conversion to snprintf.
+
+#define LOG_SPEC_MAX 16
+
+template <typename T>
+static bool readArg(const LogRecord* record, size_t* offset, T* value) {
+    if (*offset + sizeof(T) > record->argBytes) {
+        return false;
+    }
+    memcpy(value, record->args + *offset, sizeof(T));
+    *offset += sizeof(T);
+    return true;
+}
+
+template <typename T>
+static int formatArg(const LogRecord* record, size_t* offset, const char* spec,
+                     char* out, size_t size) {
+    T value;
+    if (!readArg(record, offset, &value)) {
+        return -1;
+    }
+    return snprintf(out, size, spec, value);
+}
+
+static int formatInteger(const LogRecord* record, size_t* offset, const char* spec,
+                         const char* length, bool isSigned, char* out, size_t size) {
+    if (length[0] == 'l' && length[1] == 'l') {
+        return isSigned ? formatArg<long long>(record, offset, spec, out, size)
+                        : formatArg<unsigned long long>(record, offset, spec, out, size);
+    }
+    switch (length[0]) {
+        case 'l':
+            return isSigned ? formatArg<long>(record, offset, spec, out, size)
+                            : formatArg<unsigned long>(record, offset, spec, out, size);
+        case 'z':
+            return formatArg<size_t>(record, offset, spec, out, size);
+        case 'j':
+            return isSigned ? formatArg<intmax_t>(record, offset, spec, out, size)
+                            : formatArg<uintmax_t>(record, offset, spec, out, size);
+        case 't':
+            return formatArg<ptrdiff_t>(record, offset, spec, out, size);
+        default:
+            // h and hh arrive promoted to int
+            return isSigned ? formatArg<int>(record, offset, spec, out, size)
+                            : formatArg<unsigned int>(record, offset, spec, out, size);
+    }
+}
+
+size_t logFormat(const LogRecord* record, char* out, size_t size) {
+    if (size == 0) {
+        return 0;
+    }
+
+    size_t used = 0;
+    size_t offset = 0;
+    const char* p = record->format;
+
+    while (*p && used + 1 < size) {
+        if (*p != '%') {
+            out[used++] = *p++;
+            continue;
+        }
+        if (p[1] == '%') {
+            out[used++] = '%';
+            p += 2;
+            continue;
+        }
+
+        // %[flags][width][.precision][length]conversion
+        const char* start = p++;
+        while (*p && strchr("-+ #0", *p)) p++;
+        while (*p >= '0' && *p <= '9') p++;
+        if (*p == '.') {
+            p++;
+            while (*p >= '0' && *p <= '9') p++;
+        }
+        const char* length = p;
+        while (*p && strchr("hljzt", *p)) p++;
+        char conversion = *p;
+        if (conversion == '\0') {
+            break;
+        }
+        p++;
+
+        char spec[LOG_SPEC_MAX];
+        size_t specLength = (size_t)(p - start);
+        int written;
+        if (specLength >= sizeof(spec)) {
+            written = -1;
+        } else {
+            memcpy(spec, start, specLength);
+            spec[specLength] = '\0';
+
+            char* dest = out + used;
+            size_t room = size - used;
+            switch (conversion) {
+                case 'd': case 'i':
+                    written = formatInteger(record, &offset, spec, length, true, dest, room);
+                    break;
+                case 'u': case 'x': case 'X': case 'o':
+                    written = formatInteger(record, &offset, spec, length, false, dest, room);
+                    break;
+                case 'c':
+                    written = formatArg<int>(record, &offset, spec, dest, room);
+                    break;
+                case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+                    written = formatArg<double>(record, &offset, spec, dest, room);
+                    break;
+                case 's': {
+                    const void* text;
+                    if (!readArg(record, &offset, &text)) {
+                        written = -1;
+                    } else {
+                        written = snprintf(dest, room, spec, text ? (const char*)text : "(null)");
+                    }
+                    break;
+                }
+                case 'p':
+                    written = formatArg<const void*>(record, &offset, spec, dest, room);
+                    break;
+                default:
+                    written = -1;
+                    break;
+            }
+        }
+
+        if (written < 0) {
+            // Unsupported conversion or missing argument: show it unformatted
+            written = snprintf(out + used, size - used, "<%.*s>", (int)specLength, start);
+            if (written < 0) {
+                break;
+            }
+        }
+        used += (size_t)written;
+        if (used >= size) {
+            used = size - 1;
+        }
+    }
+
+    out[used] = '\0';
+    return used;
+}
@@ -4,6 +4,7 @@
 #include "master/spi_master.h"
 #include "master/sd_handler.h"
 #include "can_handler.h"
+#include "ehps_control.h"
 #include "rpm_counter.h"
 #include "water_temp.h"
 #include "shared/config.h"
@@ -23,15 +24,21 @@
 // Task        Priority  Core  Rate    Purpose
 // ----------  --------  ----  ------  ----------------------------------
 // Pump        10 (Max)  1     100Hz   Safety-critical PWM output
-// SPI_Comm    5         0     10Hz    Slave communication
+// CAN_RX      6         0     IRQ     MCP2515 frames (or a replay) into the RX ring, capture and ID stats, scheduled TX
+// SPI_Comm    5         0     10Hz    Slave communication, CAN stats dumps
+// Telemetry   4         0     <=1kHz  Binary state log on SD
 // UI          3         1     50Hz    Encoder input, serial commands
-// NVS         1         0     1Hz     Debounced settings persistence
+// SD_IO       2         0     demand  Queued SD card access
+// NVS         1         0     1Hz     Settings persistence, black box dumps
+// Log         1         0     50Hz    Prints the real-time tasks' messages, USB capture
 //
 // Safety features:
 // - Watchdog fed from Pump task (highest priority)
 // - Failsafe mode on SPI timeout (pumps run at safe speed)
 // - RTC memory tracks crashes across resets
 // - Crash log written to SD card
+// - Black box of the last seconds in RTC memory, dumped to SD on failsafe
+//   and on the boot after a crash
 //
 // =============================================================================
 
@@ -92,6 +99,7 @@ void setup() {
                 snprintf(entry, sizeof(entry), "%lu,BOOT_AFTER_CRASH,%d\n",
                          millis(), (int)reason);
                 sdAppendFileString("/crash_log.csv", entry);
+                sdSyncFile("/crash_log.csv");
             }
         }
 
@@ -110,8 +118,13 @@ void setup() {
         #endif
     }
 
-    // CAN disabled for now
-    // canInit();
+    // CAN receive runs in its own task once tasks start
+    if (!canInit()) {
+        Serial.println("WARNING: CAN unavailable");
+    } else if (ehpsInit()) {
+        Serial.printf("EHPS CAN control: %s (use 'e1' / 'e0')\n",
+                      EHPS_CAN_CONTROL ? "enabled" : "disabled");
+    }
 
     // Initialize RPM counter (starts disabled)
     // Enable with 'r' command, disable with 'R' command
@@ -1,5 +1,6 @@
 #include "master/ota_handler.h"
 #include "master/spi_master.h"
+#include "master/deferred_log.h"
 #include "shared/config.h"
 #include "shared/ota_protocol.h"
 #include <Arduino.h>
@@ -77,8 +78,8 @@ static bool otaSpiExchange(uint8_t cmd, uint16_t param, uint8_t* status, uint16_
     
     // Validate the response
     if (!otaValidatePacket(rxBuffer)) {
-        Serial.printf("[OTA] Invalid response: [0x%02X 0x%02X 0x%02X 0x%02X 0x%02X]\n",
-                      rxBuffer[0], rxBuffer[1], rxBuffer[2], rxBuffer[3], rxBuffer[4]);
+        LOG_PRINTF("[OTA] Invalid response: [0x%02X 0x%02X 0x%02X 0x%02X 0x%02X]\n",
+                   rxBuffer[0], rxBuffer[1], rxBuffer[2], rxBuffer[3], rxBuffer[4]);
         return false;
     }
     
@@ -101,7 +102,7 @@ static bool otaSpiGetChunk(uint16_t chunkIndex, uint8_t* buffer, size_t* bytesRe
     // First exchange: send GET_CHUNK command
     // In bulk mode, slave has 264-byte transaction queued with previous response
     if (!spiOtaExchangeBulk(txBuffer, rxBuffer, OTA_BULK_PACKET_SIZE)) {
-        Serial.println("[OTA] Chunk: exchange 1 failed");
+        LOG_PRINTF("[OTA] Chunk: exchange 1 failed\n");
         return false;
     }
     
@@ -112,31 +113,35 @@ static bool otaSpiGetChunk(uint16_t chunkIndex, uint8_t* buffer, size_t* bytesRe
     memset(txBuffer, 0, OTA_BULK_PACKET_SIZE);
     txBuffer[0] = OTA_PACKET_HEADER;  // Keep OTA mode
     if (!spiOtaExchangeBulk(txBuffer, rxBuffer, OTA_BULK_PACKET_SIZE)) {
-        Serial.println("[OTA] Chunk: exchange 2 failed");
+        LOG_PRINTF("[OTA] Chunk: exchange 2 failed\n");
         return false;
     }
     
     // Debug: print first 16 bytes of response
     if (chunkIndex < 3 || chunkIndex % 100 == 0) {
-        Serial.printf("[OTA] Chunk %d rx[0-15]: ", chunkIndex);
-        for (int i = 0; i < 16; i++) Serial.printf("%02X ", rxBuffer[i]);
-        Serial.println();
+        LOG_PRINTF("[OTA] Chunk %d rx[0-15]: ", chunkIndex);
+        LOG_PRINTF("%02X %02X %02X %02X %02X %02X %02X %02X ",
+                   rxBuffer[0], rxBuffer[1], rxBuffer[2], rxBuffer[3],
+                   rxBuffer[4], rxBuffer[5], rxBuffer[6], rxBuffer[7]);
+        LOG_PRINTF("%02X %02X %02X %02X %02X %02X %02X %02X\n",
+                   rxBuffer[8], rxBuffer[9], rxBuffer[10], rxBuffer[11],
+                   rxBuffer[12], rxBuffer[13], rxBuffer[14], rxBuffer[15]);
     }
     
     // Validate response header
     if (rxBuffer[0] != OTA_PACKET_HEADER) {
-        Serial.printf("[OTA] Chunk: bad header 0x%02X\n", rxBuffer[0]);
+        LOG_PRINTF("[OTA] Chunk: bad header 0x%02X\n", rxBuffer[0]);
         return false;
     }
     
     if (rxBuffer[1] != 0x00) {  // Status byte
-        Serial.printf("[OTA] Chunk: error status 0x%02X\n", rxBuffer[1]);
+        LOG_PRINTF("[OTA] Chunk: error status 0x%02X\n", rxBuffer[1]);
         return false;
     }
     
     uint16_t chunkLen = rxBuffer[2] | (rxBuffer[3] << 8);
     if (chunkLen == 0 || chunkLen > OTA_CHUNK_SIZE) {
-        Serial.printf("[OTA] Chunk: invalid length %u\n", chunkLen);
+        LOG_PRINTF("[OTA] Chunk: invalid length %u\n", chunkLen);
         return false;
     }
     
@@ -150,8 +155,8 @@ static bool otaSpiGetChunk(uint16_t chunkIndex, uint8_t* buffer, size_t* bytesRe
     uint32_t calculatedCrc = otaCrc32(buffer, chunkLen);
     
     if (receivedCrc != calculatedCrc) {
-        Serial.printf("[OTA] Chunk %d CRC mismatch: got 0x%08X, calc 0x%08X\n",
-                      chunkIndex, receivedCrc, calculatedCrc);
+        LOG_PRINTF("[OTA] Chunk %d CRC mismatch: got 0x%08X, calc 0x%08X\n",
+                   chunkIndex, receivedCrc, calculatedCrc);
         return false;
     }
     
@@ -164,15 +169,15 @@ static bool startBulkMode() {
     uint8_t status;
     uint16_t data;
     
-    Serial.println("[OTA] Requesting bulk mode...");
+    LOG_PRINTF("[OTA] Requesting bulk mode...\n");
     
     if (!otaSpiExchange(OTA_CMD_START_BULK, 0, &status, &data)) {
-        Serial.println("[OTA] START_BULK: SPI exchange failed");
+        LOG_PRINTF("[OTA] START_BULK: SPI exchange failed\n");
         return false;
     }
     
     if (status != OTA_STATUS_FW_READY) {
-        Serial.printf("[OTA] START_BULK: unexpected status 0x%02X\n", status);
+        LOG_PRINTF("[OTA] START_BULK: unexpected status 0x%02X\n", status);
         return false;
     }
     
@@ -187,11 +192,11 @@ static bool startBulkMode() {
     txBuffer[0] = OTA_PACKET_HEADER;
     
     if (!spiOtaExchangeBulk(txBuffer, rxBuffer, OTA_BULK_PACKET_SIZE)) {
-        Serial.println("[OTA] Bulk mode flush failed");
+        LOG_PRINTF("[OTA] Bulk mode flush failed\n");
         return false;
     }
     
-    Serial.println("[OTA] Bulk mode active");
+    LOG_PRINTF("[OTA] Bulk mode active\n");
     return true;
 }
 
@@ -206,7 +211,7 @@ void masterOtaInit() {
     rebootPending = false;
     errorMessage[0] = '\0';
     
-    Serial.println("[OTA] Master OTA handler initialized");
+    LOG_PRINTF("[OTA] Master OTA handler initialized\n");
 }
 
 // =============================================================================
@@ -227,26 +232,26 @@ bool masterOtaProcess() {
                 if (pollResult == POLL_RESULT_VERIFY_REQ) {
 #if OTA_ENABLE_TEST_MODE
                     // User pressed VERIFY button - enter OTA polling mode and run test
-                    Serial.println("[OTA] User requested verification - entering OTA mode");
+                    LOG_PRINTF("[OTA] User requested verification - entering OTA mode\n");
                     currentState = MASTER_OTA_POLLING;
                     
                     // Run the protocol test
-                    Serial.println("[OTA] Running verification test for user...");
+                    LOG_PRINTF("[OTA] Running verification test for user...\n");
                     bool passed = masterOtaRunTest();
                     
                     // Result is sent to slave via TEST_END inside masterOtaRunTest()
                     
                     if (passed) {
-                        Serial.println("[OTA] Verification PASSED - waiting for user to press INSTALL");
+                        LOG_PRINTF("[OTA] Verification PASSED - waiting for user to press INSTALL\n");
                         currentState = MASTER_OTA_WAITING;
                     } else {
-                        Serial.println("[OTA] Verification FAILED - returning to idle");
+                        LOG_PRINTF("[OTA] Verification FAILED - returning to idle\n");
                         currentState = MASTER_OTA_IDLE;
                     }
                     return true;
 #else
                     // Test mode disabled - treat verify as immediate pass, proceed to waiting
-                    Serial.println("[OTA] Verification requested (test disabled) - proceeding");
+                    LOG_PRINTF("[OTA] Verification requested (test disabled) - proceeding\n");
                     currentState = MASTER_OTA_WAITING;
                     return true;
 #endif
@@ -254,7 +259,7 @@ bool masterOtaProcess() {
                 
                 if (pollResult == POLL_RESULT_FW_READY) {
                     // User already verified and pressed INSTALL - proceed with download
-                    Serial.println("[OTA] Firmware ready, starting download...");
+                    LOG_PRINTF("[OTA] Firmware ready, starting download...\n");
                     
                     // Get firmware info and start download
                     if (getFirmwareInfo()) {
@@ -272,8 +277,8 @@ bool masterOtaProcess() {
                         totalChunks = (firmwareSize + OTA_CHUNK_SIZE - 1) / OTA_CHUNK_SIZE;
                         retryCount = 0;
                         
-                        Serial.printf("[OTA] Starting download: %u bytes, %u chunks\n",
-                                      firmwareSize, totalChunks);
+                        LOG_PRINTF("[OTA] Starting download: %u bytes, %u chunks\n",
+                                   firmwareSize, totalChunks);
                         
                         // Begin Update
                         if (!Update.begin(firmwareSize)) {
@@ -301,7 +306,7 @@ bool masterOtaProcess() {
                 
                 if (pollResult == POLL_RESULT_FW_READY) {
                     // User pressed INSTALL - proceed with download
-                    Serial.println("[OTA] User pressed INSTALL - starting download...");
+                    LOG_PRINTF("[OTA] User pressed INSTALL - starting download...\n");
                     
                     if (getFirmwareInfo()) {
                         if (!startBulkMode()) {
@@ -317,8 +322,8 @@ bool masterOtaProcess() {
                         totalChunks = (firmwareSize + OTA_CHUNK_SIZE - 1) / OTA_CHUNK_SIZE;
                         retryCount = 0;
                         
-                        Serial.printf("[OTA] Starting download: %u bytes, %u chunks\n",
-                                      firmwareSize, totalChunks);
+                        LOG_PRINTF("[OTA] Starting download: %u bytes, %u chunks\n",
+                                   firmwareSize, totalChunks);
                         
                         if (!Update.begin(firmwareSize)) {
                             snprintf(errorMessage, sizeof(errorMessage), 
@@ -330,7 +335,7 @@ bool masterOtaProcess() {
                     }
                 } else if (pollResult == POLL_RESULT_NONE) {
                     // Slave returned IDLE - user pressed ABORT or something reset
-                    Serial.println("[OTA] Slave returned to IDLE - exiting OTA mode");
+                    LOG_PRINTF("[OTA] Slave returned to IDLE - exiting OTA mode\n");
                     currentState = MASTER_OTA_IDLE;
                 } else if (pollResult == POLL_RESULT_VERIFY_PASS) {
                     // Verification passed - stay in WAITING state for user to press INSTALL
@@ -355,7 +360,7 @@ bool masterOtaProcess() {
                 if (currentChunk >= totalChunks) {
                     // All chunks received
                     currentState = MASTER_OTA_VERIFYING;
-                    Serial.println("[OTA] Download complete, verifying...");
+                    LOG_PRINTF("[OTA] Download complete, verifying...\n");
                 }
             } else {
                 retryCount++;
@@ -376,7 +381,7 @@ bool masterOtaProcess() {
                 progress = 100;
                 rebootPending = true;
                 sendDoneCommand();
-                Serial.println("[OTA] Update complete, reboot pending");
+                LOG_PRINTF("[OTA] Update complete, reboot pending\n");
             } else {
                 currentState = MASTER_OTA_ERROR;
                 sendAbortCommand();
@@ -404,32 +409,32 @@ static uint8_t pollSlaveForOta() {
     uint8_t status;
     uint16_t data;
     
-    Serial.println("[OTA] Polling slave...");
+    LOG_PRINTF("[OTA] Polling slave...\n");
     
     if (!otaSpiExchange(OTA_CMD_STATUS, 0, &status, &data)) {
-        Serial.println("[OTA] Poll: SPI exchange failed");
+        LOG_PRINTF("[OTA] Poll: SPI exchange failed\n");
         return POLL_RESULT_ERROR;
     }
     
-    Serial.printf("[OTA] Poll: status=0x%02X\n", status);
+    LOG_PRINTF("[OTA] Poll: status=0x%02X\n", status);
     
     if (status == OTA_STATUS_FW_READY) {
-        Serial.println("[OTA] Poll: Firmware ready!");
+        LOG_PRINTF("[OTA] Poll: Firmware ready!\n");
         return POLL_RESULT_FW_READY;
     }
     
     if (status == OTA_STATUS_VERIFY_REQUESTED) {
-        Serial.println("[OTA] Poll: Verification requested by user");
+        LOG_PRINTF("[OTA] Poll: Verification requested by user\n");
         return POLL_RESULT_VERIFY_REQ;
     }
     
     if (status == OTA_STATUS_VERIFY_PASSED) {
-        Serial.println("[OTA] Poll: Verification passed, user can install");
+        LOG_PRINTF("[OTA] Poll: Verification passed, user can install\n");
         return POLL_RESULT_VERIFY_PASS;
     }
     
     if (status == OTA_STATUS_VERIFY_FAILED) {
-        Serial.println("[OTA] Poll: Verification failed");
+        LOG_PRINTF("[OTA] Poll: Verification failed\n");
         return POLL_RESULT_NONE;  // Return to idle
     }
     
@@ -440,14 +445,14 @@ static bool getFirmwareInfo() {
     uint8_t txBuffer[OTA_PACKET_SIZE];
     uint8_t rxBuffer[OTA_BULK_PACKET_SIZE];
     
-    Serial.println("[OTA] Requesting firmware info...");
+    LOG_PRINTF("[OTA] Requesting firmware info...\n");
     
     // Send GET_INFO command using same 2-phase exchange as polling
     otaPackCommand(txBuffer, OTA_CMD_GET_INFO, 0);
     
     // First exchange: send command (receive previous response - discard)
     if (!spiOtaExchange(txBuffer, rxBuffer, OTA_PACKET_SIZE)) {
-        Serial.println("[OTA] Info: SPI exchange 1 failed");
+        LOG_PRINTF("[OTA] Info: SPI exchange 1 failed\n");
         return false;
     }
     
@@ -457,23 +462,26 @@ static bool getFirmwareInfo() {
     // Second exchange: send same command again, receive the 12-byte INFO response
     // Slave should now have INFO response queued with OTA_BULK_PACKET_SIZE transaction
     if (!spiOtaExchangeBulk(txBuffer, rxBuffer, OTA_BULK_PACKET_SIZE)) {
-        Serial.println("[OTA] Info: SPI exchange 2 failed");
+        LOG_PRINTF("[OTA] Info: SPI exchange 2 failed\n");
         return false;
     }
     
-    Serial.printf("[OTA] Info raw: [%02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X]\n",
-                  rxBuffer[0], rxBuffer[1], rxBuffer[2], rxBuffer[3],
-                  rxBuffer[4], rxBuffer[5], rxBuffer[6], rxBuffer[7],
-                  rxBuffer[8], rxBuffer[9], rxBuffer[10], rxBuffer[11]);
+    // Two records: a log record holds at most eight 32-bit arguments
+    LOG_PRINTF("[OTA] Info raw: [%02X %02X %02X %02X %02X %02X ",
+               rxBuffer[0], rxBuffer[1], rxBuffer[2],
+               rxBuffer[3], rxBuffer[4], rxBuffer[5]);
+    LOG_PRINTF("%02X %02X %02X %02X %02X %02X]\n",
+               rxBuffer[6], rxBuffer[7], rxBuffer[8],
+               rxBuffer[9], rxBuffer[10], rxBuffer[11]);
     
     if (rxBuffer[0] != OTA_PACKET_HEADER) {
-        Serial.printf("[OTA] Info: Bad header 0x%02X (expected 0x%02X)\n", 
-                      rxBuffer[0], OTA_PACKET_HEADER);
+        LOG_PRINTF("[OTA] Info: Bad header 0x%02X (expected 0x%02X)\n", 
+                   rxBuffer[0], OTA_PACKET_HEADER);
         return false;
     }
     
     if (rxBuffer[1] != OTA_STATUS_FW_READY) {
-        Serial.printf("[OTA] Info: Bad status 0x%02X\n", rxBuffer[1]);
+        LOG_PRINTF("[OTA] Info: Bad status 0x%02X\n", rxBuffer[1]);
         return false;
     }
     
@@ -483,11 +491,11 @@ static bool getFirmwareInfo() {
     
     if (firmwareSize == 0 || firmwareSize > 2 * 1024 * 1024) {
         snprintf(errorMessage, sizeof(errorMessage), "Invalid firmware size: %u", firmwareSize);
-        Serial.printf("[OTA] %s\n", errorMessage);
+        LOG_PRINTF("[OTA] Invalid firmware size: %u\n", firmwareSize);
         return false;
     }
     
-    Serial.printf("[OTA] Firmware info: size=%u, crc=0x%08X\n", firmwareSize, firmwareCrc);
+    LOG_PRINTF("[OTA] Firmware info: size=%u, crc=0x%08X\n", firmwareSize, firmwareCrc);
     return true;
 }
 
@@ -509,8 +517,8 @@ static bool downloadNextChunk() {
     bytesReceived += bytesRead;
     
     if (currentChunk % 50 == 0) {
-        Serial.printf("[OTA] Progress: %u/%u bytes (%d%%)\n", 
-                      bytesReceived, firmwareSize, progress);
+        LOG_PRINTF("[OTA] Progress: %u/%u bytes (%d%%)\n", 
+                   bytesReceived, firmwareSize, progress);
     }
     
     return true;
@@ -543,7 +551,7 @@ static void sendDoneCommand() {
     delay(20);
     spiOtaExchangeBulk(txBuffer, rxBuffer, OTA_BULK_PACKET_SIZE);
     
-    Serial.println("[OTA] DONE command sent");
+    LOG_PRINTF("[OTA] DONE command sent\n");
 }
 
 static void sendAbortCommand() {
@@ -559,7 +567,7 @@ static void sendAbortCommand() {
     delay(20);
     spiOtaExchangeBulk(txBuffer, rxBuffer, OTA_BULK_PACKET_SIZE);
     
-    Serial.println("[OTA] ABORT command sent");
+    LOG_PRINTF("[OTA] ABORT command sent\n");
 }
 
 // =============================================================================
@@ -584,7 +592,7 @@ bool masterOtaRebootPending() {
 
 void masterOtaReboot() {
     if (rebootPending) {
-        Serial.println("[OTA] Rebooting...");
+        LOG_PRINTF("[OTA] Rebooting...\n");
         delay(100);
         ESP.restart();
     }
@@ -597,9 +605,9 @@ void masterOtaReboot() {
 #if OTA_ENABLE_TEST_MODE
 
 bool masterOtaRunTest() {
-    Serial.println("[OTA TEST] ========================================");
-    Serial.println("[OTA TEST] Starting OTA protocol test...");
-    Serial.println("[OTA TEST] ========================================");
+    LOG_PRINTF("[OTA TEST] ========================================\n");
+    LOG_PRINTF("[OTA TEST] Starting OTA protocol test...\n");
+    LOG_PRINTF("[OTA TEST] ========================================\n");
     
     uint8_t txBuffer[OTA_BULK_PACKET_SIZE];
     uint8_t rxBuffer[OTA_BULK_PACKET_SIZE];
@@ -610,13 +618,13 @@ bool masterOtaRunTest() {
     uint32_t patternErrors = 0;
     
     // Step 1: Send TEST_START command
-    Serial.println("[OTA TEST] Step 1: Sending TEST_START...");
+    LOG_PRINTF("[OTA TEST] Step 1: Sending TEST_START...\n");
     memset(txBuffer, 0, OTA_BULK_PACKET_SIZE);
     otaPackCommand(txBuffer, OTA_CMD_TEST_START, 0);
     
     // First exchange - send command (receives stale DMA data - discard)
     if (!spiOtaExchange(txBuffer, rxBuffer, OTA_PACKET_SIZE)) {
-        Serial.println("[OTA TEST] FAILED: TEST_START exchange 1 failed");
+        LOG_PRINTF("[OTA TEST] FAILED: TEST_START exchange 1 failed\n");
         return false;
     }
     
@@ -626,28 +634,28 @@ bool masterOtaRunTest() {
     // Second exchange - flush out stale response from 5-byte transaction
     // Send TEST_START again (slave is already in test mode, will just re-queue TEST_READY)
     if (!spiOtaExchangeBulk(txBuffer, rxBuffer, OTA_BULK_PACKET_SIZE)) {
-        Serial.println("[OTA TEST] FAILED: TEST_START exchange 2 (flush) failed");
+        LOG_PRINTF("[OTA TEST] FAILED: TEST_START exchange 2 (flush) failed\n");
         return false;
     }
     
-    Serial.printf("[OTA TEST] Flush response: hdr=0x%02X status=0x%02X\n",
-                  rxBuffer[0], rxBuffer[1]);
+    LOG_PRINTF("[OTA TEST] Flush response: hdr=0x%02X status=0x%02X\n",
+               rxBuffer[0], rxBuffer[1]);
     
     delay(30);
     
     // Third exchange - NOW we get the actual TEST_READY response (12 bytes with size/crc)
     // Send TEST_START again to keep response fresh
     if (!spiOtaExchangeBulk(txBuffer, rxBuffer, OTA_BULK_PACKET_SIZE)) {
-        Serial.println("[OTA TEST] FAILED: TEST_START exchange 3 failed");
+        LOG_PRINTF("[OTA TEST] FAILED: TEST_START exchange 3 failed\n");
         return false;
     }
     
-    Serial.printf("[OTA TEST] Response: hdr=0x%02X status=0x%02X\n",
-                  rxBuffer[0], rxBuffer[1]);
+    LOG_PRINTF("[OTA TEST] Response: hdr=0x%02X status=0x%02X\n",
+               rxBuffer[0], rxBuffer[1]);
     
     if (rxBuffer[0] != OTA_PACKET_HEADER || rxBuffer[1] != OTA_STATUS_TEST_READY) {
-        Serial.printf("[OTA TEST] FAILED: Bad response: hdr=0x%02X status=0x%02X (expected 0x%02X 0x%02X)\n",
-                      rxBuffer[0], rxBuffer[1], OTA_PACKET_HEADER, OTA_STATUS_TEST_READY);
+        LOG_PRINTF("[OTA TEST] FAILED: Bad response: hdr=0x%02X status=0x%02X (expected 0x%02X 0x%02X)\n",
+                   rxBuffer[0], rxBuffer[1], OTA_PACKET_HEADER, OTA_STATUS_TEST_READY);
         return false;
     }
     
@@ -655,11 +663,11 @@ bool masterOtaRunTest() {
     memcpy(&testSize, &rxBuffer[4], 4);
     uint16_t totalChunks = (testSize + OTA_CHUNK_SIZE - 1) / OTA_CHUNK_SIZE;
     
-    Serial.printf("[OTA TEST] Test mode active: size=%u, chunks=%u\n", testSize, totalChunks);
+    LOG_PRINTF("[OTA TEST] Test mode active: size=%u, chunks=%u\n", testSize, totalChunks);
     
     // Step 2: Download test chunks
     // Note: DMA pipeline is already flushed from TEST_START exchanges
-    Serial.println("[OTA TEST] Step 2: Downloading test chunks...");
+    LOG_PRINTF("[OTA TEST] Step 2: Downloading test chunks...\n");
     
     for (uint16_t chunk = 0; chunk < totalChunks; chunk++) {
         // Prepare GET_CHUNK command
@@ -668,7 +676,7 @@ bool masterOtaRunTest() {
         
         // First exchange - send command
         if (!spiOtaExchangeBulk(txBuffer, rxBuffer, OTA_BULK_PACKET_SIZE)) {
-            Serial.printf("[OTA TEST] FAILED: Chunk %d exchange 1 failed\n", chunk);
+            LOG_PRINTF("[OTA TEST] FAILED: Chunk %d exchange 1 failed\n", chunk);
             goto test_cleanup;
         }
         
@@ -677,20 +685,20 @@ bool masterOtaRunTest() {
         // Second exchange - get response (send same TEST_CHUNK command to keep response valid)
         // Slave will just re-generate the same chunk data
         if (!spiOtaExchangeBulk(txBuffer, rxBuffer, OTA_BULK_PACKET_SIZE)) {
-            Serial.printf("[OTA TEST] FAILED: Chunk %d exchange 2 failed\n", chunk);
+            LOG_PRINTF("[OTA TEST] FAILED: Chunk %d exchange 2 failed\n", chunk);
             goto test_cleanup;
         }
         
         // Validate response
         if (rxBuffer[0] != OTA_PACKET_HEADER || rxBuffer[1] != 0x00) {
-            Serial.printf("[OTA TEST] FAILED: Chunk %d bad response hdr=0x%02X status=0x%02X\n", 
-                          chunk, rxBuffer[0], rxBuffer[1]);
+            LOG_PRINTF("[OTA TEST] FAILED: Chunk %d bad response hdr=0x%02X status=0x%02X\n", 
+                       chunk, rxBuffer[0], rxBuffer[1]);
             goto test_cleanup;
         }
         
         uint16_t chunkLen = rxBuffer[2] | (rxBuffer[3] << 8);
         if (chunkLen == 0 || chunkLen > OTA_CHUNK_SIZE) {
-            Serial.printf("[OTA TEST] FAILED: Chunk %d invalid length %u\n", chunk, chunkLen);
+            LOG_PRINTF("[OTA TEST] FAILED: Chunk %d invalid length %u\n", chunk, chunkLen);
             goto test_cleanup;
         }
         
@@ -702,8 +710,8 @@ bool masterOtaRunTest() {
         if (receivedCrc != calculatedCrc) {
             crcErrors++;
             if (crcErrors <= 3) {
-                Serial.printf("[OTA TEST] CRC error chunk %d: got 0x%08X, calc 0x%08X\n",
-                              chunk, receivedCrc, calculatedCrc);
+                LOG_PRINTF("[OTA TEST] CRC error chunk %d: got 0x%08X, calc 0x%08X\n",
+                           chunk, receivedCrc, calculatedCrc);
             }
         }
         
@@ -713,8 +721,8 @@ bool masterOtaRunTest() {
             if (rxBuffer[4 + i] != expected) {
                 patternErrors++;
                 if (patternErrors <= 3) {
-                    Serial.printf("[OTA TEST] Pattern error chunk %d byte %d: got 0x%02X, exp 0x%02X\n",
-                                  chunk, i, rxBuffer[4 + i], expected);
+                    LOG_PRINTF("[OTA TEST] Pattern error chunk %d byte %d: got 0x%02X, exp 0x%02X\n",
+                               chunk, i, rxBuffer[4 + i], expected);
                 }
                 break;  // Only count one error per chunk
             }
@@ -725,8 +733,8 @@ bool masterOtaRunTest() {
         
         // Progress every 10 chunks
         if (chunk % 10 == 0 || chunk == totalChunks - 1) {
-            Serial.printf("[OTA TEST] Progress: %d/%d chunks (%u bytes)\n", 
-                          chunk + 1, totalChunks, bytesReceived);
+            LOG_PRINTF("[OTA TEST] Progress: %d/%d chunks (%u bytes)\n", 
+                       chunk + 1, totalChunks, bytesReceived);
         }
     }
     
@@ -738,8 +746,8 @@ test_cleanup:
                   (patternErrors == 0);
     
     // Step 3: Send TEST_END command with result (1=passed, 0=failed)
-    Serial.printf("[OTA TEST] Step 3: Sending TEST_END (result=%s)...\n", 
-                  passed ? "PASSED" : "FAILED");
+    LOG_PRINTF("[OTA TEST] Step 3: Sending TEST_END (result=%s)...\n", 
+               passed ? "PASSED" : "FAILED");
     
     memset(txBuffer, 0, OTA_BULK_PACKET_SIZE);
     otaPackCommand(txBuffer, OTA_CMD_TEST_END, passed ? 1 : 0);
@@ -752,23 +760,23 @@ test_cleanup:
     uint32_t elapsed = millis() - startTime;
     uint32_t bytesPerSec = (bytesReceived * 1000) / elapsed;
     
-    Serial.println("[OTA TEST] ========================================");
-    Serial.println("[OTA TEST] Test Results:");
-    Serial.printf("[OTA TEST]   Chunks: %u/%u\n", chunksReceived, totalChunks);
-    Serial.printf("[OTA TEST]   Bytes: %u/%u\n", bytesReceived, testSize);
-    Serial.printf("[OTA TEST]   CRC Errors: %u\n", crcErrors);
-    Serial.printf("[OTA TEST]   Pattern Errors: %u\n", patternErrors);
-    Serial.printf("[OTA TEST]   Time: %u ms\n", elapsed);
-    Serial.printf("[OTA TEST]   Speed: %u bytes/sec\n", bytesPerSec);
+    LOG_PRINTF("[OTA TEST] ========================================\n");
+    LOG_PRINTF("[OTA TEST] Test Results:\n");
+    LOG_PRINTF("[OTA TEST]   Chunks: %u/%u\n", chunksReceived, totalChunks);
+    LOG_PRINTF("[OTA TEST]   Bytes: %u/%u\n", bytesReceived, testSize);
+    LOG_PRINTF("[OTA TEST]   CRC Errors: %u\n", crcErrors);
+    LOG_PRINTF("[OTA TEST]   Pattern Errors: %u\n", patternErrors);
+    LOG_PRINTF("[OTA TEST]   Time: %u ms\n", elapsed);
+    LOG_PRINTF("[OTA TEST]   Speed: %u bytes/sec\n", bytesPerSec);
     
     // passed was already calculated before sending TEST_END
     
     if (passed) {
-        Serial.println("[OTA TEST] PASSED!");
+        LOG_PRINTF("[OTA TEST] PASSED!\n");
     } else {
-        Serial.println("[OTA TEST] FAILED!");
+        LOG_PRINTF("[OTA TEST] FAILED!\n");
     }
-    Serial.println("[OTA TEST] ========================================");
+    LOG_PRINTF("[OTA TEST] ========================================\n");
     
     return passed;
 }
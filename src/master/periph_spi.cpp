@@ -0,0 +1,21 @@
+#include "master/periph_spi.h"
+#include "shared/config.h"
+#include <Arduino.h>
+
+static SPIClass* bus = nullptr;
+
+SPIClass* periphSpi() {
+    if (bus) return bus;
+
+    // Neither device may see the other's traffic as its own, not even the
+    // SD card's power-up clocks
+    pinMode(SD_SPI_CS_PIN, OUTPUT);
+    digitalWrite(SD_SPI_CS_PIN, HIGH);
+    pinMode(MCP2515_CS_PIN, OUTPUT);
+    digitalWrite(MCP2515_CS_PIN, HIGH);
+
+    // Chip selects are driven by the drivers, not by the host
+    bus = new SPIClass(FSPI);
+    bus->begin(SD_SPI_SCK_PIN, SD_SPI_MISO_PIN, SD_SPI_MOSI_PIN, -1);
+    return bus;
+}
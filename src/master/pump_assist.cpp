@@ -0,0 +1,29 @@
+#include "master/pump_assist.h"
+#include "shared/config.h"
+
+// The engine RPM message is set with canSetRpmMessageId()
+const CanSignalDef CAN_DEFAULT_SIGNALS[CAN_SIGNAL_DEFAULT_COUNT] = {
+    // name            ID          ext    start len order                signed factor                offset
+    {"pump_status",   0x1B200002, true,  55,   16, CAN_SIGNAL_MOTOROLA, false, CAN_SIGNAL_FIXED(1.0), 0},
+    {"vehicle_speed", 0x02104136, true,  55,   16, CAN_SIGNAL_MOTOROLA, false, CAN_SIGNAL_FIXED(1.0), 0},
+    {"engine_rpm",    0x000,      false, 0,    16, CAN_SIGNAL_INTEL,    false, CAN_SIGNAL_FIXED(1.0), 0},
+};
+
+bool pumpAssistRpm(const CanSignalValue& value, uint32_t* seenUpdates, uint16_t* rpm) {
+    if (value.updates == *seenUpdates) {
+        return false;
+    }
+    *seenUpdates = value.updates;
+    int32_t whole = canSignalToInt(value.value);
+    *rpm = whole < 0 ? 0 : (whole > 0xFFFF ? 0xFFFF : (uint16_t)whole);
+    return true;
+}
+
+uint8_t pumpDutyForRpm(uint16_t rpm) {
+    if (rpm >= 4000) return 255;
+    return (uint8_t)((rpm * 255UL) / 4000UL);
+}
+
+uint16_t ehpsSpeedForDuty(uint8_t duty) {
+    return (uint16_t)((uint32_t)(255 - duty) * EHPS_SPEED_LEAST_ASSIST / 255);
+}
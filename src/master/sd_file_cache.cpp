@@ -0,0 +1,228 @@
+#include "master/sd_file_cache.h"
+#include <string.h>
+
+// Handle = generation << 8 | slot, kept positive
+#define HANDLE_SLOT(h)          ((uint32_t)(h) & 0xFF)
+#define HANDLE_GENERATION(h)    ((uint16_t)(((uint32_t)(h) >> 8) & 0x7FFF))
+#define MAKE_HANDLE(slot, gen)  ((SdHandle)((((uint32_t)(gen) & 0x7FFF) << 8) | (slot)))
+
+// =============================================================================
+// Construction
+// =============================================================================
+
+SdFileCache::SdFileCache()
+    : _backend(nullptr)
+    , _slotCount(0)
+    , _clock(0)
+    , _nowMs(0) {
+    memset(_slots, 0, sizeof(_slots));
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+void SdFileCache::init(SdFileBackend* backend, uint32_t slots) {
+    closeAll();
+    _backend = backend;
+    _slotCount = slots < 1 ? 1 : (slots > SD_FILE_CACHE_MAX ? SD_FILE_CACHE_MAX : slots);
+}
+
+uint32_t SdFileCache::openFiles() const {
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < _slotCount; i++) {
+        if (_slots[i].file) count++;
+    }
+    return count;
+}
+
+// =============================================================================
+// Slots
+// =============================================================================
+
+SdFileCache::Slot* SdFileCache::lookup(SdHandle handle) {
+    if (handle < 0 || HANDLE_SLOT(handle) >= _slotCount) return nullptr;
+    Slot& slot = _slots[HANDLE_SLOT(handle)];
+    if (!slot.file || slot.generation != HANDLE_GENERATION(handle)) return nullptr;
+    slot.lastUse = ++_clock;
+    return &slot;
+}
+
+int32_t SdFileCache::find(const char* path) const {
+    for (uint32_t i = 0; i < _slotCount; i++) {
+        if (_slots[i].file && !_slots[i].transient && strcmp(_slots[i].path, path) == 0) {
+            return (int32_t)i;
+        }
+    }
+    return -1;
+}
+
+// Free slot, else the least recently used unpinned one (-1 if all pinned)
+int32_t SdFileCache::victim() const {
+    int32_t best = -1;
+    for (uint32_t i = 0; i < _slotCount; i++) {
+        const Slot& slot = _slots[i];
+        if (!slot.file) return (int32_t)i;
+        if (slot.pins == 0 && (best < 0 || slot.lastUse < _slots[best].lastUse)) {
+            best = (int32_t)i;
+        }
+    }
+    return best;
+}
+
+bool SdFileCache::flushSlot(Slot& slot) {
+    if (!slot.dirty) return true;
+    bool ok = _backend->sync(slot.file);
+    slot.dirty = false;
+    _stats.syncs++;
+    return ok;
+}
+
+void SdFileCache::closeSlot(Slot& slot) {
+    if (!slot.file) return;
+    flushSlot(slot);
+    _backend->close(slot.file);
+    slot.file = nullptr;
+    slot.path[0] = '\0';
+    slot.pins = 0;
+    slot.transient = false;
+    slot.generation++;
+}
+
+// =============================================================================
+// Handles
+// =============================================================================
+
+SdHandle SdFileCache::open(const char* path, bool create) {
+    if (!_backend || !path) return SD_HANDLE_INVALID;
+
+    bool transient = strlen(path) >= SD_FILE_PATH_MAX;
+    if (!transient) {
+        int32_t index = find(path);
+        if (index >= 0) {
+            Slot& slot = _slots[index];
+            slot.pins++;
+            slot.lastUse = ++_clock;
+            _stats.hits++;
+            return MAKE_HANDLE(index, slot.generation);
+        }
+    }
+
+    int32_t index = victim();
+    if (index < 0) return SD_HANDLE_INVALID;
+
+    Slot& slot = _slots[index];
+    if (slot.file) {
+        closeSlot(slot);
+        _stats.evictions++;
+    }
+
+    void* file = _backend->open(path, create);
+    if (!file) return SD_HANDLE_INVALID;
+
+    slot.file = file;
+    if (transient) {
+        slot.path[0] = '\0';
+        _stats.bypasses++;
+    } else {
+        strcpy(slot.path, path);
+        _stats.misses++;
+    }
+    slot.transient = transient;
+    slot.pins = 1;
+    slot.dirty = false;
+    slot.lastUse = ++_clock;
+    return MAKE_HANDLE(index, slot.generation);
+}
+
+void SdFileCache::release(SdHandle handle) {
+    Slot* slot = lookup(handle);
+    if (!slot || slot->pins == 0) return;
+    slot->pins--;
+    if (slot->pins == 0 && slot->transient) {
+        closeSlot(*slot);
+    }
+}
+
+int32_t SdFileCache::readAt(SdHandle handle, uint32_t offset, uint8_t* buffer, size_t length) {
+    Slot* slot = lookup(handle);
+    if (!slot) return -1;
+    return _backend->readAt(slot->file, offset, buffer, length);
+}
+
+int32_t SdFileCache::writeAt(SdHandle handle, uint32_t offset, const uint8_t* data, size_t length) {
+    Slot* slot = lookup(handle);
+    if (!slot) return -1;
+    if (!slot->dirty) {
+        slot->dirty = true;
+        slot->dirtySince = _nowMs;
+    }
+    return _backend->writeAt(slot->file, offset, data, length);
+}
+
+int32_t SdFileCache::size(SdHandle handle) {
+    Slot* slot = lookup(handle);
+    if (!slot) return -1;
+    return _backend->size(slot->file);
+}
+
+bool SdFileCache::sync(SdHandle handle) {
+    Slot* slot = lookup(handle);
+    if (!slot) return false;
+    return flushSlot(*slot);
+}
+
+// =============================================================================
+// Path Operations
+// =============================================================================
+
+bool SdFileCache::syncPath(const char* path) {
+    int32_t index = find(path);
+    return index < 0 || flushSlot(_slots[index]);
+}
+
+void SdFileCache::invalidate(const char* path) {
+    int32_t index = find(path);
+    if (index >= 0) {
+        closeSlot(_slots[index]);
+    }
+}
+
+void SdFileCache::invalidateDir(const char* dir) {
+    size_t length = strlen(dir);
+    while (length > 0 && dir[length - 1] == '/') {
+        length--;
+    }
+    for (uint32_t i = 0; i < _slotCount; i++) {
+        Slot& slot = _slots[i];
+        if (slot.file && !slot.transient &&
+            strncmp(slot.path, dir, length) == 0 && slot.path[length] == '/') {
+            closeSlot(slot);
+        }
+    }
+}
+
+bool SdFileCache::syncAll() {
+    bool ok = true;
+    for (uint32_t i = 0; i < _slotCount; i++) {
+        if (_slots[i].file) {
+            ok = flushSlot(_slots[i]) && ok;
+        }
+    }
+    return ok;
+}
+
+bool SdFileCache::syncDue(uint32_t nowMs, uint32_t intervalMs) {
+    _nowMs = nowMs;
+    bool ok = true;
+    for (uint32_t i = 0; i < _slotCount; i++) {
+        Slot& slot = _slots[i];
+        if (slot.file && slot.dirty && nowMs - slot.dirtySince >= intervalMs) {
+            ok = flushSlot(slot) && ok;
+        }
+    }
+    return ok;
+}
+
+void SdFileCache::closeAll() {
+    for (uint32_t i = 0; i < SD_FILE_CACHE_MAX; i++) {
+        closeSlot(_slots[i]);
+    }
+}
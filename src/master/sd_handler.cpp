@@ -1,13 +1,137 @@
 #include "master/sd_handler.h"
+#include "master/periph_spi.h"
 #include "shared/config.h"
 #include <Arduino.h>
 #include <SPI.h>
 #include <SD.h>
 #include <FS.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <ff.h>
 
-// Use FSPI (SPI3) for SD card - separate from HSPI used for slave communication
-static SPIClass* sdSpi = nullptr;
+// The SD card shares FSPI with the MCP2515 (periph_spi.h); HSPI talks to the slave
 static bool sdMounted = false;
+static int fatDrive = -1;   // FatFs volume of the card, found on first use
+
+// =============================================================================
+// Latency Statistics
+// =============================================================================
+
+static SdLatencyStats latency;
+static portMUX_TYPE latencyMux = portMUX_INITIALIZER_UNLOCKED;
+
+static void recordOp(SdOpType op, uint32_t startUs, uint32_t bytes, bool ok, const char* path) {
+    uint32_t us = micros() - startUs;
+    uint32_t nowMs = millis();
+    portENTER_CRITICAL(&latencyMux);
+    sdLatencyRecord(&latency, op, us, bytes, ok, path, nowMs, SD_SLOW_OP_US);
+    portEXIT_CRITICAL(&latencyMux);
+}
+
+void sdGetLatencyStats(SdLatencyStats* stats) {
+    portENTER_CRITICAL(&latencyMux);
+    *stats = latency;
+    portEXIT_CRITICAL(&latencyMux);
+}
+
+void sdResetLatencyStats() {
+    uint32_t nowMs = millis();
+    portENTER_CRITICAL(&latencyMux);
+    sdLatencyReset(&latency, nowMs);
+    portEXIT_CRITICAL(&latencyMux);
+}
+
+void sdPrintLatencyStats() {
+    static SdLatencyStats stats;    // Too large for the caller's stack
+    sdGetLatencyStats(&stats);
+
+    char line[112];
+    Serial.printf("SD latency over %lu s:\n", (millis() - stats.sinceMs) / 1000);
+    for (uint8_t op = 0; op < SD_OP_TYPES; op++) {
+        if (stats.ops[op].operations == 0) continue;
+        sdLatencyFormatLine(&stats.ops[op], op, line, sizeof(line));
+        Serial.printf("  %s\n", line);
+    }
+    if (stats.slowCount == 0) return;
+
+    Serial.printf("  %lu ops over %d ms, latest:\n", stats.slowCount, SD_SLOW_OP_US / 1000);
+    uint32_t shown = stats.slowCount < SD_SLOW_TRACE_SIZE ? stats.slowCount : SD_SLOW_TRACE_SIZE;
+    for (uint32_t i = 1; i <= shown; i++) {
+        sdLatencyFormatSlow(&stats.slow[(stats.slowCount - i) % SD_SLOW_TRACE_SIZE], line, sizeof(line));
+        Serial.printf("    %s\n", line);
+    }
+}
+
+// =============================================================================
+// Open File Cache
+// =============================================================================
+// Cached Files are shared between tasks, so every entry point that touches
+// the cache holds sdMutex (recursive - some entry points call others)
+
+class ArduinoFileBackend : public SdFileBackend {
+public:
+    void* open(const char* path, bool create) override {
+        uint32_t start = micros();
+        const char* mode = "r+";
+        if (!SD.exists(path)) {
+            if (!create) {
+                recordOp(SD_OP_OPEN, start, 0, false, path);
+                return nullptr;
+            }
+            mode = "w+";
+        }
+        File file = SD.open(path, mode);
+        recordOp(SD_OP_OPEN, start, 0, (bool)file, path);
+        if (!file) return nullptr;
+        return new File(file);
+    }
+
+    int32_t readAt(void* file, uint32_t offset, uint8_t* buffer, size_t length) override {
+        uint32_t start = micros();
+        File* f = (File*)file;
+        int32_t result = f->seek(offset) ? (int32_t)f->read(buffer, length) : -1;
+        recordOp(SD_OP_READ, start, result > 0 ? result : 0, result == (int32_t)length, f->path());
+        return result;
+    }
+
+    int32_t writeAt(void* file, uint32_t offset, const uint8_t* data, size_t length) override {
+        uint32_t start = micros();
+        File* f = (File*)file;
+        int32_t result = f->seek(offset) ? (int32_t)f->write(data, length) : -1;
+        recordOp(SD_OP_WRITE, start, result > 0 ? result : 0, result == (int32_t)length, f->path());
+        return result;
+    }
+
+    int32_t size(void* file) override {
+        return (int32_t)((File*)file)->size();
+    }
+
+    bool sync(void* file) override {
+        uint32_t start = micros();
+        File* f = (File*)file;
+        f->flush();
+        recordOp(SD_OP_SYNC, start, 0, true, f->path());
+        return true;
+    }
+
+    void close(void* file) override {
+        uint32_t start = micros();
+        File* f = (File*)file;
+        f->close();
+        recordOp(SD_OP_SYNC, start, 0, true, nullptr);
+        delete f;
+    }
+};
+
+static ArduinoFileBackend fileBackend;
+static SdFileCache fileCache;
+static SemaphoreHandle_t sdMutex = nullptr;
+
+class SdLockGuard {
+public:
+    SdLockGuard() { xSemaphoreTakeRecursive(sdMutex, portMAX_DELAY); }
+    ~SdLockGuard() { xSemaphoreGiveRecursive(sdMutex); }
+};
 
 bool sdInit() {
     // Check card detect pin if configured
@@ -19,18 +143,17 @@ bool sdInit() {
     }
     #endif
 
-    // Initialize FSPI (SPI3) on custom pins for SD card
-    sdSpi = new SPIClass(FSPI);
-    sdSpi->begin(SD_SPI_SCK_PIN, SD_SPI_MISO_PIN, SD_SPI_MOSI_PIN, SD_SPI_CS_PIN);
-
-    // Initialize SD library with custom SPI and CS pin
-    if (!SD.begin(SD_SPI_CS_PIN, *sdSpi, SD_SPI_FREQUENCY)) {
+    // Initialize SD library on the shared peripheral bus with its own CS pin
+    if (!SD.begin(SD_SPI_CS_PIN, *periphSpi(), SD_SPI_FREQUENCY)) {
         Serial.println("SD: Mount failed");
-        delete sdSpi;
-        sdSpi = nullptr;
         return false;
     }
 
+    if (!sdMutex) {
+        sdMutex = xSemaphoreCreateRecursiveMutex();
+    }
+    fileCache.init(&fileBackend, SD_FILE_CACHE_SIZE);
+    sdResetLatencyStats();
     sdMounted = true;
 
     // Print card info
@@ -94,77 +217,112 @@ const char* sdGetCardType() {
 
 bool sdExists(const char* path) {
     if (!sdMounted) return false;
-    return SD.exists(path);
+    SdLockGuard lock;
+    uint32_t start = micros();
+    bool exists = SD.exists(path);
+    recordOp(SD_OP_META, start, 0, true, path);
+    return exists;
 }
 
 bool sdMkdir(const char* path) {
     if (!sdMounted) return false;
-    return SD.mkdir(path);
+    SdLockGuard lock;
+    uint32_t start = micros();
+    bool success = SD.mkdir(path);
+    recordOp(SD_OP_META, start, 0, success, path);
+    return success;
 }
 
 bool sdRemove(const char* path) {
     if (!sdMounted) return false;
-    return SD.remove(path);
+    SdLockGuard lock;
+    fileCache.invalidate(path);
+    uint32_t start = micros();
+    bool success = SD.remove(path);
+    recordOp(SD_OP_META, start, 0, success, path);
+    return success;
 }
 
 bool sdRmdir(const char* path) {
     if (!sdMounted) return false;
-    return SD.rmdir(path);
+    SdLockGuard lock;
+    fileCache.invalidateDir(path);
+    uint32_t start = micros();
+    bool success = SD.rmdir(path);
+    recordOp(SD_OP_META, start, 0, success, path);
+    return success;
 }
 
 bool sdRename(const char* oldPath, const char* newPath) {
     if (!sdMounted) return false;
-    return SD.rename(oldPath, newPath);
+    SdLockGuard lock;
+    fileCache.invalidate(oldPath);
+    fileCache.invalidate(newPath);
+    uint32_t start = micros();
+    bool success = SD.rename(oldPath, newPath);
+    recordOp(SD_OP_META, start, 0, success, newPath);
+    return success;
 }
 
 int32_t sdReadFile(const char* path, uint8_t* buffer, size_t bufferSize) {
     if (!sdMounted) return -1;
+    SdLockGuard lock;
 
-    File file = SD.open(path, FILE_READ);
-    if (!file) {
+    SdHandle handle = fileCache.open(path, false);
+    if (handle < 0) {
         return -1;
     }
 
-    size_t fileSize = file.size();
+    int32_t fileSize = fileCache.size(handle);
 
     // If buffer is null, just return file size
-    if (buffer == nullptr) {
-        file.close();
-        return (int32_t)fileSize;
+    if (buffer == nullptr || fileSize < 0) {
+        fileCache.release(handle);
+        return fileSize;
     }
 
     // Read up to buffer size
-    size_t toRead = (fileSize < bufferSize) ? fileSize : bufferSize;
-    size_t bytesRead = file.read(buffer, toRead);
-    file.close();
+    size_t toRead = ((size_t)fileSize < bufferSize) ? (size_t)fileSize : bufferSize;
+    int32_t bytesRead = fileCache.readAt(handle, 0, buffer, toRead);
+    fileCache.release(handle);
 
-    return (int32_t)bytesRead;
+    return bytesRead;
 }
 
 String sdReadFileString(const char* path) {
     if (!sdMounted) return String();
+    SdLockGuard lock;
+    fileCache.syncPath(path);
 
+    uint32_t start = micros();
     File file = SD.open(path, FILE_READ);
     if (!file) {
+        recordOp(SD_OP_OPEN, start, 0, false, path);
         return String();
     }
 
     String content = file.readString();
     file.close();
+    recordOp(SD_OP_READ, start, content.length(), true, path);
     return content;
 }
 
 bool sdWriteFile(const char* path, const uint8_t* data, size_t length) {
     if (!sdMounted) return false;
+    SdLockGuard lock;
+    fileCache.invalidate(path);  // Truncated below
 
+    uint32_t start = micros();
     File file = SD.open(path, FILE_WRITE);
     if (!file) {
+        recordOp(SD_OP_OPEN, start, 0, false, path);
         Serial.printf("SD: Failed to open %s for writing\n", path);
         return false;
     }
 
     size_t written = file.write(data, length);
     file.close();
+    recordOp(SD_OP_WRITE, start, written, written == length, path);
 
     if (written != length) {
         Serial.printf("SD: Write incomplete %zu/%zu bytes to %s\n", written, length, path);
@@ -180,18 +338,20 @@ bool sdWriteFileString(const char* path, const String& content) {
 
 bool sdAppendFile(const char* path, const uint8_t* data, size_t length) {
     if (!sdMounted) return false;
+    SdLockGuard lock;
 
-    File file = SD.open(path, FILE_APPEND);
-    if (!file) {
+    SdHandle handle = fileCache.open(path, true);
+    if (handle < 0) {
         Serial.printf("SD: Failed to open %s for appending\n", path);
         return false;
     }
 
-    size_t written = file.write(data, length);
-    file.close();
+    int32_t end = fileCache.size(handle);
+    int32_t written = end < 0 ? -1 : fileCache.writeAt(handle, (uint32_t)end, data, length);
+    fileCache.release(handle);
 
-    if (written != length) {
-        Serial.printf("SD: Append incomplete %zu/%zu bytes to %s\n", written, length, path);
+    if (written != (int32_t)length) {
+        Serial.printf("SD: Append incomplete %ld/%zu bytes to %s\n", (long)written, length, path);
         return false;
     }
 
@@ -204,101 +364,259 @@ bool sdAppendFileString(const char* path, const String& content) {
 
 int32_t sdFileSize(const char* path) {
     if (!sdMounted) return -1;
+    SdLockGuard lock;
 
-    File file = SD.open(path, FILE_READ);
-    if (!file) {
+    SdHandle handle = fileCache.open(path, false);
+    if (handle < 0) {
         return -1;
     }
 
-    int32_t size = (int32_t)file.size();
-    file.close();
+    int32_t size = fileCache.size(handle);
+    fileCache.release(handle);
     return size;
 }
 
 int32_t sdReadFileAt(const char* path, uint32_t offset, uint8_t* buffer, size_t length) {
     if (!sdMounted || buffer == nullptr) return -1;
+    SdLockGuard lock;
 
-    File file = SD.open(path, FILE_READ);
-    if (!file) {
+    SdHandle handle = fileCache.open(path, false);
+    if (handle < 0) {
         return -1;
     }
 
-    if (offset > 0 && !file.seek(offset)) {
-        file.close();
+    int32_t bytesRead = fileCache.readAt(handle, offset, buffer, length);
+    fileCache.release(handle);
+    return bytesRead;
+}
+
+int32_t sdWriteFileAt(const char* path, uint32_t offset, const uint8_t* data, size_t length) {
+    if (!sdMounted || data == nullptr) return -1;
+    SdLockGuard lock;
+
+    SdHandle handle = fileCache.open(path, true);
+    if (handle < 0) {
         return -1;
     }
 
-    size_t bytesRead = file.read(buffer, length);
-    file.close();
+    int32_t bytesWritten = fileCache.writeAt(handle, offset, data, length);
+    fileCache.release(handle);
+    return bytesWritten;
+}
 
-    return (int32_t)bytesRead;
+SdHandle sdOpen(const char* path, bool create) {
+    if (!sdMounted) return SD_HANDLE_INVALID;
+    SdLockGuard lock;
+    return fileCache.open(path, create);
 }
 
-int32_t sdWriteFileAt(const char* path, uint32_t offset, const uint8_t* data, size_t length) {
+int32_t sdPread(SdHandle handle, uint32_t offset, uint8_t* buffer, size_t length) {
+    if (!sdMounted || buffer == nullptr) return -1;
+    SdLockGuard lock;
+    return fileCache.readAt(handle, offset, buffer, length);
+}
+
+int32_t sdPwrite(SdHandle handle, uint32_t offset, const uint8_t* data, size_t length) {
     if (!sdMounted || data == nullptr) return -1;
+    SdLockGuard lock;
+    return fileCache.writeAt(handle, offset, data, length);
+}
 
-    // Use FILE_WRITE which opens for read/write, creating if needed
-    // Note: On FAT32, "r+" mode isn't directly supported, so we use a workaround
-    File file = SD.open(path, "r+");
-    if (!file) {
-        // File doesn't exist, create it
-        file = SD.open(path, FILE_WRITE);
-        if (!file) {
-            return -1;
-        }
-    }
+int32_t sdHandleSize(SdHandle handle) {
+    if (!sdMounted) return -1;
+    SdLockGuard lock;
+    return fileCache.size(handle);
+}
 
-    if (offset > 0 && !file.seek(offset)) {
-        file.close();
-        return -1;
-    }
+bool sdSync(SdHandle handle) {
+    if (!sdMounted) return false;
+    SdLockGuard lock;
+    return fileCache.sync(handle);
+}
 
-    size_t bytesWritten = file.write(data, length);
-    file.close();
+void sdClose(SdHandle handle) {
+    if (!sdMounted) return;
+    SdLockGuard lock;
+    fileCache.release(handle);
+}
 
-    return (int32_t)bytesWritten;
+bool sdSyncFile(const char* path) {
+    if (!sdMounted) return false;
+    SdLockGuard lock;
+    return fileCache.syncPath(path);
 }
 
-bool sdCreateSparseFile(const char* path, uint32_t size) {
+bool sdSyncAll() {
     if (!sdMounted) return false;
+    SdLockGuard lock;
+    return fileCache.syncAll();
+}
+
+void sdPeriodicSync() {
+    if (!sdMounted) return;
+    // Skip without waiting if another task is busy on the card
+    if (xSemaphoreTakeRecursive(sdMutex, 0) != pdTRUE) return;
+    fileCache.syncDue(millis(), SD_SYNC_INTERVAL_MS);
+    xSemaphoreGiveRecursive(sdMutex);
+}
+
+void sdGetFileCacheStats(SdFileCacheStats* stats, uint32_t* openFiles) {
+    if (!sdMutex) {
+        memset(stats, 0, sizeof(*stats));
+        *openFiles = 0;
+        return;
+    }
+    SdLockGuard lock;
+    *stats = fileCache.stats();
+    *openFiles = fileCache.openFiles();
+}
 
+// =============================================================================
+// Preallocation
+// =============================================================================
+// The SD library hides which FatFs volume it mounted, so the first call
+// looks for the drive that has the (just created) file
+
+static bool fatPath(const char* path, char* out, size_t size) {
+    if (fatDrive < 0) {
+        for (int drive = 0; drive < FF_VOLUMES && fatDrive < 0; drive++) {
+            FILINFO info;
+            snprintf(out, size, "%d:%s", drive, path);
+            if (f_stat(out, &info) == FR_OK) {
+                fatDrive = drive;
+            }
+        }
+        if (fatDrive < 0) return false;
+    }
+    return snprintf(out, size, "%d:%s", fatDrive, path) < (int)size;
+}
+
+static uint32_t fatSectorSize(FATFS* fs) {
+#if FF_MAX_SS != FF_MIN_SS
+    return fs->ssize;
+#else
+    return FF_MAX_SS;
+#endif
+}
+
+// Describe where an open file lies; walks the cluster chain unless the
+// caller already knows it is contiguous
+static bool fatExtent(FIL* file, bool knownContiguous, SdExtent* extent) {
+    FATFS* fs = file->obj.fs;
+    uint32_t sectorSize = fatSectorSize(fs);
+    uint32_t clusterBytes = fs->csize * sectorSize;
+    uint32_t size = (uint32_t)f_size(file);
+
+    memset(extent, 0, sizeof(SdExtent));
+    extent->drive = fs->pdrv;
+    extent->sectorSize = (uint16_t)sectorSize;
+    extent->sectors = (size + sectorSize - 1) / sectorSize;
+    if (file->obj.sclust < 2) {
+        extent->contiguous = size == 0;
+        return true;
+    }
+    extent->firstSector = (uint32_t)(fs->database + (LBA_t)fs->csize * (file->obj.sclust - 2));
+
+    bool contiguous = true;
+    if (!knownContiguous) {
+        // Seeking one byte into cluster k leaves its number in file->clust;
+        // forward seeks follow the chain from the current cluster
+        for (uint32_t k = 1; (uint64_t)k * clusterBytes < size; k++) {
+            if (f_lseek(file, (FSIZE_t)k * clusterBytes + 1) != FR_OK) return false;
+            if (file->clust != file->obj.sclust + k) {
+                contiguous = false;
+                break;
+            }
+        }
+    }
+    extent->contiguous = contiguous;
+    if (!contiguous) {
+        extent->firstSector = 0;
+    }
+    return true;
+}
+
+static bool createSparseFile(const char* path, uint32_t size, SdExtent* extent) {
     // Remove existing file
     if (SD.exists(path)) {
         SD.remove(path);
     }
 
-    File file = SD.open(path, FILE_WRITE);
-    if (!file) {
+    File created = SD.open(path, FILE_WRITE);
+    if (!created) {
         return false;
     }
+    created.close();
 
-    // Write in chunks to avoid memory issues
-    const size_t chunkSize = 4096;
-    uint8_t* zeros = (uint8_t*)calloc(chunkSize, 1);
-    if (!zeros) {
-        file.close();
+    char fat[SD_FILE_PATH_MAX + 4];
+    FIL file;
+    if (!fatPath(path, fat, sizeof(fat)) ||
+        f_open(&file, fat, FA_CREATE_ALWAYS | FA_WRITE | FA_READ) != FR_OK) {
         return false;
     }
 
-    uint32_t remaining = size;
-    bool success = true;
-
-    while (remaining > 0) {
-        size_t toWrite = (remaining > chunkSize) ? chunkSize : remaining;
-        if (file.write(zeros, toWrite) != toWrite) {
-            success = false;
-            break;
+    // f_expand reserves one run of free clusters and writes only the FAT,
+    // so the file is contiguous and nothing is cleared. Without one long
+    // enough run, seeking past the end allocates cluster by cluster.
+    bool contiguous = false;
+    FRESULT result = FR_OK;
+    if (size > 0) {
+#if FF_USE_EXPAND
+        result = f_expand(&file, size, 1);
+        contiguous = result == FR_OK;
+        if (result == FR_DENIED) {
+            Serial.printf("SD: No contiguous %luKB for %s, allocating in pieces\n",
+                          size / 1024, path);
+        }
+#else
+        result = FR_DENIED;
+#endif
+        if (result == FR_DENIED) {
+            UINT written = 0;
+            const uint8_t zero = 0;
+            result = f_lseek(&file, size - 1);
+            if (result == FR_OK) result = f_write(&file, &zero, 1, &written);
+            if (result == FR_OK && written != 1) result = FR_DISK_ERR;
         }
-        remaining -= toWrite;
     }
 
-    free(zeros);
-    file.close();
+    bool success = result == FR_OK && f_size(&file) == size;
+    if (success && extent) {
+        success = fatExtent(&file, contiguous, extent);
+    }
+    success = f_close(&file) == FR_OK && success;
+    return success;
+}
+
+bool sdCreateSparseFile(const char* path, uint32_t size, SdExtent* extent) {
+    if (!sdMounted) return false;
+    SdLockGuard lock;
+    fileCache.invalidate(path);
+    uint32_t start = micros();
+    bool success = createSparseFile(path, size, extent);
+    recordOp(SD_OP_META, start, 0, success, path);
+    return success;
+}
+
+bool sdGetFileExtent(const char* path, SdExtent* extent) {
+    if (!sdMounted) return false;
+    SdLockGuard lock;
+    fileCache.syncPath(path);       // Buffered writes may still extend the chain
+
+    char fat[SD_FILE_PATH_MAX + 4];
+    FIL file;
+    if (!fatPath(path, fat, sizeof(fat)) || f_open(&file, fat, FA_READ) != FR_OK) {
+        return false;
+    }
+    bool success = fatExtent(&file, false, extent);
+    f_close(&file);
     return success;
 }
 
 bool sdListDir(const char* path, SdListCallback callback, void* userData) {
     if (!sdMounted) return false;
+    SdLockGuard lock;
+    fileCache.syncAll();  // Sizes of open files as written so far
 
     File root = SD.open(path);
     if (!root || !root.isDirectory()) {
@@ -375,21 +693,22 @@ void sdPrintDir(const char* path, uint8_t depth) {
         return;
     }
 
+    SdLockGuard lock;
+    fileCache.syncAll();
     Serial.printf("SD: Contents of %s\n", path);
     printDirRecursive(path, 0, depth);
 }
 
 void sdUnmount() {
     if (sdMounted) {
+        SdLockGuard lock;
+        fileCache.closeAll();
         SD.end();
         sdMounted = false;
+        fatDrive = -1;
         Serial.println("SD: Unmounted");
     }
-    if (sdSpi) {
-        sdSpi->end();
-        delete sdSpi;
-        sdSpi = nullptr;
-    }
+    // The bus stays up: the MCP2515 is on it too
 }
 
 bool sdRemount() {
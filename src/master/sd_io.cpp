@@ -0,0 +1,243 @@
+#include "master/sd_io.h"
+#include "master/sd_handler.h"
+#include "shared/config.h"
+#include <Arduino.h>
+#include <freertos/semphr.h>
+
+static SdIoQueue ioQueue;
+static portMUX_TYPE ioMux = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t ioSignal = nullptr;     // Given on every submit
+static TaskHandle_t ioTask = nullptr;            // Set by the first sdIoProcess()
+
+static const char* const PRIORITY_NAMES[SD_IO_PRIORITIES] = {
+    "safety", "telemetry", "vmem", "bulk"
+};
+
+// =============================================================================
+// Initialization
+// =============================================================================
+
+bool sdIoInit() {
+    if (ioSignal) return true;
+    ioSignal = xSemaphoreCreateBinary();
+    if (!ioSignal) {
+        Serial.println("SD I/O: Failed to create signal");
+        return false;
+    }
+    ioQueue.init(SD_IO_QUEUE_DEPTH, SD_IO_SAFETY_RESERVE, true);
+    return true;
+}
+
+// =============================================================================
+// Worker
+// =============================================================================
+
+static int32_t runJob(const SdIoJob& job) {
+    switch (job.op) {
+        case SD_IO_APPEND:
+            return sdAppendFile(job.path, job.data, job.length) ? (int32_t)job.length : -1;
+        case SD_IO_WRITE_AT:
+            return sdWriteFileAt(job.path, job.offset, job.data, job.length);
+        case SD_IO_READ_AT:
+            return sdReadFileAt(job.path, job.offset, job.buffer, job.length);
+        case SD_IO_SYNC:
+            return (job.allFiles ? sdSyncAll() : sdSyncFile(job.path)) ? 0 : -1;
+    }
+    return -1;
+}
+
+void sdIoProcess(uint32_t waitMs) {
+    if (!ioSignal) {
+        vTaskDelay(pdMS_TO_TICKS(waitMs));
+        return;
+    }
+    ioTask = xTaskGetCurrentTaskHandle();
+    xSemaphoreTake(ioSignal, pdMS_TO_TICKS(waitMs));
+
+    while (true) {
+        portENTER_CRITICAL(&ioMux);
+        SdIoJob* job = ioQueue.take();
+        portEXIT_CRITICAL(&ioMux);
+        if (!job) break;
+
+        // A taken job is out of every list, so submitters never touch it
+        int32_t result = runJob(*job);
+
+        // Safety logs go to the card now, not on the next periodic sync -
+        // the power may be about to drop
+        if (job->priority == SD_IO_SAFETY && result >= 0 &&
+            (job->op == SD_IO_APPEND || job->op == SD_IO_WRITE_AT)) {
+            sdSyncFile(job->path);
+        }
+
+        SdIoCompletion completion;
+        portENTER_CRITICAL(&ioMux);
+        ioQueue.finish(job, result, micros(), &completion);
+        portEXIT_CRITICAL(&ioMux);
+
+        if (completion.callback) {
+            completion.callback(completion.result, completion.context);
+        }
+    }
+}
+
+// =============================================================================
+// Requests
+// =============================================================================
+
+static bool submit(const SdIoRequest& request) {
+    if (!ioSignal) return false;
+    portENTER_CRITICAL(&ioMux);
+    bool queued = ioQueue.submit(request, micros());
+    portEXIT_CRITICAL(&ioMux);
+    if (queued) {
+        xSemaphoreGive(ioSignal);
+    }
+    return queued;
+}
+
+static SdIoRequest makeRequest(SdIoOp op, const char* path, SdIoPriority priority,
+                               SdIoCallback callback, void* context) {
+    SdIoRequest request;
+    memset(&request, 0, sizeof(request));
+    request.op = op;
+    request.path = path;
+    request.priority = priority;
+    request.callback = callback;
+    request.context = context;
+    return request;
+}
+
+bool sdIoAppend(const char* path, const void* data, size_t length, SdIoPriority priority,
+                SdIoCallback callback, void* context) {
+    SdIoRequest request = makeRequest(SD_IO_APPEND, path, priority, callback, context);
+    request.data = (const uint8_t*)data;
+    request.length = length;
+    return submit(request);
+}
+
+bool sdIoAppendString(const char* path, const char* text, SdIoPriority priority) {
+    return sdIoAppend(path, text, strlen(text), priority);
+}
+
+bool sdIoWriteAt(const char* path, uint32_t offset, const void* data, size_t length,
+                 SdIoPriority priority, SdIoCallback callback, void* context) {
+    SdIoRequest request = makeRequest(SD_IO_WRITE_AT, path, priority, callback, context);
+    request.offset = offset;
+    request.data = (const uint8_t*)data;
+    request.length = length;
+    return submit(request);
+}
+
+bool sdIoReadAt(const char* path, uint32_t offset, void* buffer, size_t length,
+                SdIoPriority priority, SdIoCallback callback, void* context) {
+    SdIoRequest request = makeRequest(SD_IO_READ_AT, path, priority, callback, context);
+    request.offset = offset;
+    request.buffer = (uint8_t*)buffer;
+    request.length = length;
+    return submit(request);
+}
+
+bool sdIoSync(const char* path, SdIoPriority priority, SdIoCallback callback, void* context) {
+    return submit(makeRequest(SD_IO_SYNC, path, priority, callback, context));
+}
+
+// =============================================================================
+// Futures
+// =============================================================================
+
+void sdIoFutureInit(SdIoFuture* future) {
+    future->done = false;
+    future->result = -1;
+    future->waiter = xTaskGetCurrentTaskHandle();
+}
+
+void sdIoComplete(int32_t result, void* context) {
+    SdIoFuture* future = (SdIoFuture*)context;
+    // Once done is set the waiter may return and its future go out of
+    // scope, so nothing of it is read after that
+    TaskHandle_t waiter = future->waiter;
+    future->result = result;
+    __atomic_store_n(&future->done, true, __ATOMIC_RELEASE);
+    xTaskNotifyGive(waiter);
+}
+
+int32_t sdIoWait(SdIoFuture* future, uint32_t timeoutMs) {
+    TickType_t start = xTaskGetTickCount();
+    TickType_t timeout = timeoutMs == portMAX_DELAY ? portMAX_DELAY : pdMS_TO_TICKS(timeoutMs);
+    while (!__atomic_load_n(&future->done, __ATOMIC_ACQUIRE)) {
+        TickType_t waited = xTaskGetTickCount() - start;
+        if (timeout != portMAX_DELAY && waited >= timeout) return -1;
+        // Notifications left over from other futures only cause another pass
+        ulTaskNotifyTake(pdTRUE, timeout == portMAX_DELAY ? portMAX_DELAY : timeout - waited);
+    }
+    return future->result;
+}
+
+static bool runsDirectly() {
+    return !ioTask || xTaskGetCurrentTaskHandle() == ioTask;
+}
+
+static int32_t submitAndWait(SdIoRequest& request) {
+    SdIoFuture future;
+    sdIoFutureInit(&future);
+    request.callback = sdIoComplete;
+    request.context = &future;
+    while (!submit(request)) {
+        vTaskDelay(1);
+    }
+    return sdIoWait(&future, portMAX_DELAY);
+}
+
+int32_t sdIoReadAtWait(const char* path, uint32_t offset, void* buffer, size_t length,
+                       SdIoPriority priority) {
+    if (runsDirectly()) {
+        return sdReadFileAt(path, offset, (uint8_t*)buffer, length);
+    }
+    SdIoRequest request = makeRequest(SD_IO_READ_AT, path, priority, nullptr, nullptr);
+    request.offset = offset;
+    request.buffer = (uint8_t*)buffer;
+    request.length = length;
+    return submitAndWait(request);
+}
+
+int32_t sdIoWriteAtWait(const char* path, uint32_t offset, const void* data, size_t length,
+                        SdIoPriority priority) {
+    if (runsDirectly()) {
+        return sdWriteFileAt(path, offset, (const uint8_t*)data, length);
+    }
+    SdIoRequest request = makeRequest(SD_IO_WRITE_AT, path, priority, nullptr, nullptr);
+    request.offset = offset;
+    request.data = (const uint8_t*)data;
+    request.length = length;
+    return submitAndWait(request);
+}
+
+// =============================================================================
+// Statistics
+// =============================================================================
+
+void sdIoGetStats(SdIoStats* stats, uint32_t* pending) {
+    portENTER_CRITICAL(&ioMux);
+    *stats = ioQueue.stats();
+    *pending = ioQueue.pending();
+    portEXIT_CRITICAL(&ioMux);
+}
+
+void sdIoPrintStats() {
+    SdIoStats stats;
+    uint32_t pending;
+    sdIoGetStats(&stats, &pending);
+
+    Serial.printf("SD I/O: %lu pending, %lu/%d slots at most\n",
+                  pending, stats.highWater, SD_IO_QUEUE_DEPTH);
+    for (uint32_t c = 0; c < SD_IO_PRIORITIES; c++) {
+        const SdIoClassStats& cls = stats.classes[c];
+        if (cls.submitted == 0 && cls.rejected == 0) continue;
+        uint32_t avgUs = cls.completed > 0 ? (uint32_t)(cls.totalWaitUs / cls.completed) : 0;
+        Serial.printf("  %-9s %lu req, %lu merged, %lu ops, %lu failed, %lu rejected, "
+                      "wait avg %lu us max %lu us\n",
+                      PRIORITY_NAMES[c], cls.submitted, cls.merged, cls.operations,
+                      cls.failed, cls.rejected, avgUs, cls.maxWaitUs);
+    }
+}
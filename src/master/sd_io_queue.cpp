@@ -0,0 +1,259 @@
+#include "master/sd_io_queue.h"
+#include <string.h>
+
+// =============================================================================
+// Construction
+// =============================================================================
+
+SdIoQueue::SdIoQueue()
+    : _free(-1)
+    , _depth(0)
+    , _reserve(0)
+    , _used(0)
+    , _sequence(0)
+    , _merging(false) {
+    memset(_jobs, 0, sizeof(_jobs));
+    for (uint32_t p = 0; p < SD_IO_PRIORITIES; p++) {
+        _head[p] = -1;
+        _tail[p] = -1;
+    }
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+void SdIoQueue::init(uint32_t depth, uint32_t safetyReserve, bool merging) {
+    _depth = depth < 1 ? 1 : (depth > SD_IO_QUEUE_MAX ? SD_IO_QUEUE_MAX : depth);
+    _reserve = safetyReserve < _depth ? safetyReserve : _depth - 1;
+    _merging = merging;
+    _used = 0;
+    _sequence = 0;
+
+    for (uint32_t p = 0; p < SD_IO_PRIORITIES; p++) {
+        _head[p] = -1;
+        _tail[p] = -1;
+    }
+    _free = -1;
+    for (int32_t i = (int32_t)_depth - 1; i >= 0; i--) {
+        _jobs[i].queued = false;
+        _jobs[i].next = _free;
+        _free = (int16_t)i;
+    }
+    resetStats();
+}
+
+void SdIoQueue::resetStats() {
+    uint32_t used = _used;
+    memset(&_stats, 0, sizeof(_stats));
+    _stats.highWater = used;
+}
+
+// =============================================================================
+// Lists
+// =============================================================================
+
+void SdIoQueue::append(uint8_t priority, int16_t index) {
+    SdIoJob& job = _jobs[index];
+    job.priority = priority;
+    job.queued = true;
+    job.next = -1;
+    if (_tail[priority] >= 0) {
+        _jobs[_tail[priority]].next = index;
+    } else {
+        _head[priority] = index;
+    }
+    _tail[priority] = index;
+}
+
+void SdIoQueue::unlink(uint8_t priority, int16_t index, int16_t previous) {
+    SdIoJob& job = _jobs[index];
+    if (previous >= 0) {
+        _jobs[previous].next = job.next;
+    } else {
+        _head[priority] = job.next;
+    }
+    if (_tail[priority] == index) {
+        _tail[priority] = previous;
+    }
+    job.next = -1;
+    job.queued = false;
+}
+
+// Move queued requests for path from less important classes to the end of
+// priority. Walking the classes most important first keeps their order:
+// earlier requests for a file are never in a less important class than
+// later ones.
+void SdIoQueue::promote(const char* path, uint8_t priority) {
+    for (uint32_t p = priority + 1; p < SD_IO_PRIORITIES; p++) {
+        int16_t previous = -1;
+        int16_t index = _head[p];
+        while (index >= 0) {
+            SdIoJob& job = _jobs[index];
+            int16_t next = job.next;
+            if (!job.allFiles && strcmp(job.path, path) == 0) {
+                unlink((uint8_t)p, index, previous);
+                append(priority, index);
+                _stats.classes[job.origin].promoted++;
+            } else {
+                previous = index;
+            }
+            index = next;
+        }
+    }
+}
+
+// =============================================================================
+// Merging
+// =============================================================================
+
+// Fold request into the last queued request for the same file if it
+// continues it
+bool SdIoQueue::merge(const SdIoRequest& request, uint32_t nowUs) {
+    if (request.callback || (request.op != SD_IO_APPEND && request.op != SD_IO_WRITE_AT)) {
+        return false;
+    }
+
+    SdIoJob* last = nullptr;
+    for (uint32_t p = 0; p < SD_IO_PRIORITIES; p++) {
+        for (int16_t index = _head[p]; index >= 0; index = _jobs[index].next) {
+            SdIoJob& job = _jobs[index];
+            if (!job.allFiles && strcmp(job.path, request.path) == 0 &&
+                (!last || job.sequence > last->sequence)) {
+                last = &job;
+            }
+        }
+    }
+    if (!last || last->op != request.op || last->length + request.length > SD_IO_INLINE_BYTES) {
+        return false;
+    }
+    if (request.op == SD_IO_WRITE_AT && last->offset + last->length != request.offset) {
+        return false;
+    }
+
+    // A small request queued without a copy moves into its inline buffer
+    if (last->data != last->inlineData) {
+        memcpy(last->inlineData, last->data, last->length);
+        last->data = last->inlineData;
+    }
+    memcpy(last->inlineData + last->length, request.data, request.length);
+    last->length += request.length;
+
+    uint8_t cls = (uint8_t)request.priority;
+    if (last->riders[cls] == 0) {
+        last->riderFirstUs[cls] = nowUs;
+    }
+    last->riders[cls]++;
+    last->riderSubmitUs[cls] += nowUs;
+    return true;
+}
+
+// =============================================================================
+// Submit / Take / Finish
+// =============================================================================
+
+bool SdIoQueue::submit(const SdIoRequest& request, uint32_t nowUs) {
+    if ((uint32_t)request.priority >= SD_IO_PRIORITIES) return false;
+    SdIoClassStats& cls = _stats.classes[request.priority];
+
+    bool allFiles = request.op == SD_IO_SYNC && request.path == nullptr;
+    if ((!allFiles && (!request.path || strlen(request.path) >= SD_FILE_PATH_MAX)) ||
+        (request.op == SD_IO_READ_AT && !request.buffer) ||
+        ((request.op == SD_IO_APPEND || request.op == SD_IO_WRITE_AT) && !request.data)) {
+        cls.rejected++;
+        return false;
+    }
+
+    if (!allFiles) {
+        promote(request.path, (uint8_t)request.priority);
+    }
+    if (_merging && merge(request, nowUs)) {
+        cls.submitted++;
+        cls.merged++;
+        return true;
+    }
+
+    uint32_t limit = request.priority == SD_IO_SAFETY ? _depth : _depth - _reserve;
+    if (_used >= limit || _free < 0) {
+        cls.rejected++;
+        return false;
+    }
+
+    int16_t index = _free;
+    SdIoJob& job = _jobs[index];
+    _free = job.next;
+
+    job.op = request.op;
+    job.origin = (uint8_t)request.priority;
+    job.allFiles = allFiles;
+    if (allFiles) {
+        job.path[0] = '\0';
+    } else {
+        strcpy(job.path, request.path);
+    }
+    job.offset = request.offset;
+    job.length = request.length;
+    job.ownLength = request.length;
+    job.buffer = request.buffer;
+    job.callback = request.callback;
+    job.context = request.context;
+    job.sequence = _sequence++;
+    job.submitUs = nowUs;
+    memset(job.riders, 0, sizeof(job.riders));
+    memset(job.riderSubmitUs, 0, sizeof(job.riderSubmitUs));
+
+    if (request.data && request.length <= SD_IO_INLINE_BYTES) {
+        memcpy(job.inlineData, request.data, request.length);
+        job.data = job.inlineData;
+    } else {
+        job.data = request.data;
+    }
+
+    append((uint8_t)request.priority, index);
+    _used++;
+    if (_used > _stats.highWater) _stats.highWater = _used;
+    cls.submitted++;
+    return true;
+}
+
+SdIoJob* SdIoQueue::take() {
+    for (uint32_t p = 0; p < SD_IO_PRIORITIES; p++) {
+        int16_t index = _head[p];
+        if (index >= 0) {
+            unlink((uint8_t)p, index, -1);
+            return &_jobs[index];
+        }
+    }
+    return nullptr;
+}
+
+void SdIoQueue::finish(SdIoJob* job, int32_t result, uint32_t nowUs, SdIoCompletion* completion) {
+    SdIoClassStats& cls = _stats.classes[job->origin];
+    uint32_t wait = nowUs - job->submitUs;
+    cls.operations++;
+    cls.completed++;
+    cls.totalWaitUs += wait;
+    if (wait > cls.maxWaitUs) cls.maxWaitUs = wait;
+    if (result < 0) cls.failed++;
+
+    for (uint32_t c = 0; c < SD_IO_PRIORITIES; c++) {
+        if (job->riders[c] == 0) continue;
+        SdIoClassStats& rider = _stats.classes[c];
+        rider.completed += job->riders[c];
+        rider.totalWaitUs += (uint64_t)job->riders[c] * nowUs - job->riderSubmitUs[c];
+        uint32_t riderWait = nowUs - job->riderFirstUs[c];
+        if (riderWait > rider.maxWaitUs) rider.maxWaitUs = riderWait;
+        if (result < 0) rider.failed += job->riders[c];
+    }
+
+    // Writes report the caller's own bytes, not those merged behind them
+    if (result >= 0 && job->op != SD_IO_READ_AT && job->op != SD_IO_SYNC) {
+        result = (uint32_t)result >= job->length ? (int32_t)job->ownLength :
+                 ((uint32_t)result < job->ownLength ? result : (int32_t)job->ownLength);
+    }
+    completion->callback = job->callback;
+    completion->context = job->context;
+    completion->result = result;
+
+    job->queued = false;
+    job->next = _free;
+    _free = (int16_t)(job - _jobs);
+    _used--;
+}
@@ -4,7 +4,7 @@
 #include <Arduino.h>
 #include <SPI.h>
 
-// Use HSPI (SPI2) for communication - separate from VSPI used by other peripherals
+// Use HSPI (SPI3) for communication - FSPI is the SD card and MCP2515's bus
 static SPIClass* commSpi = nullptr;
 static SPISettings spiSettings(COMM_SPI_FREQUENCY, MSBFIRST, SPI_MODE0);
 
@@ -15,7 +15,7 @@ static uint32_t successCount = 0;
 static uint32_t errorCount = 0;
 
 bool spiMasterInit() {
-    // Initialize HSPI (SPI2) on custom pins
+    // Initialize HSPI (SPI3) on custom pins
     commSpi = new SPIClass(HSPI);
     commSpi->begin(COMM_SPI_SCK_PIN, COMM_SPI_MISO_PIN, COMM_SPI_MOSI_PIN, COMM_SPI_CS_PIN);
     
@@ -30,17 +30,8 @@ bool spiMasterInit() {
     return true;
 }
 
-bool spiExchange(uint16_t rpmToSend, uint8_t modeToSend, 
-                 int16_t waterTempF10, uint8_t waterStatus,
-                 uint8_t* requestedMode, uint16_t* requestedRpm) {
-    if (!commSpi) return false;
-
-    // Prepare master->slave packet (master is authoritative)
-    uint8_t txBuffer[SPI_PACKET_SIZE];
-    uint8_t rxBuffer[SPI_PACKET_SIZE];
-
-    packMasterPacket(txBuffer, rpmToSend, modeToSend, waterTempF10, waterStatus);
-
+// One SPI_PACKET_SIZE transaction
+static void transferPacket(const uint8_t* txBuffer, uint8_t* rxBuffer) {
     // Begin SPI transaction
     commSpi->beginTransaction(spiSettings);
     digitalWrite(COMM_SPI_CS_PIN, LOW);  // Select slave
@@ -59,6 +50,19 @@ bool spiExchange(uint16_t rpmToSend, uint8_t modeToSend,
 
     // Gap between transactions for slave to re-queue
     delayMicroseconds(50);
+}
+
+bool spiExchange(uint16_t rpmToSend, uint8_t modeToSend, 
+                 int16_t waterTempF10, uint8_t waterStatus,
+                 uint8_t* requestedMode, uint16_t* requestedRpm) {
+    if (!commSpi) return false;
+
+    // Prepare master->slave packet (master is authoritative)
+    uint8_t txBuffer[SPI_PACKET_SIZE];
+    uint8_t rxBuffer[SPI_PACKET_SIZE];
+
+    packMasterPacket(txBuffer, rpmToSend, modeToSend, waterTempF10, waterStatus);
+    transferPacket(txBuffer, rxBuffer);
 
     // Validate received packet from slave (contains UI input requests)
     if (validateSpiPacket(rxBuffer)) {
@@ -72,6 +76,24 @@ bool spiExchange(uint16_t rpmToSend, uint8_t modeToSend,
     return false;
 }
 
+bool spiSendCanStats(const uint8_t* packet, uint8_t* requestedMode, uint16_t* requestedRpm) {
+    if (!commSpi) return false;
+
+    uint8_t rxBuffer[SPI_PACKET_SIZE];
+    transferPacket(packet, rxBuffer);
+
+    // The slave answers with its normal packet
+    if (validateSpiPacket(rxBuffer)) {
+        *requestedMode = extractSpiMode(rxBuffer);
+        *requestedRpm = extractSpiRpm(rxBuffer);
+        successCount++;
+        return true;
+    }
+
+    errorCount++;
+    return false;
+}
+
 uint32_t spiGetSuccessCount() {
     return successCount;
 }
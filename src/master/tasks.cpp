@@ -1,8 +1,16 @@
 #include "tasks.h"
 #include "master/spi_master.h"
 #include "master/sd_handler.h"
+#include "master/sd_io.h"
+#include "master/telemetry.h"
+#include "master/can_capture.h"
+#include "master/can_replay.h"
+#include "master/black_box.h"
+#include "master/deferred_log.h"
 #include "master/ota_handler.h"
+#include "master/pump_assist.h"
 #include "can_handler.h"
+#include "ehps_control.h"
 #include "rpm_counter.h"
 #include "water_temp.h"
 #include "encoder_mux.h"
@@ -30,6 +38,8 @@ MasterState masterState = {
     .lastValidSpiTime = 0,
     .spiTimeoutCount = 0,
     .currentPwmDuty = 0,
+    .waterTempF10 = WATER_TEMP_INVALID,
+    .waterStatus = WATER_TEMP_STATUS_DISABLED,
     .simGoingUp = true,
     .lastSimChange = 0
 };
@@ -57,6 +67,10 @@ static TaskHandle_t taskHandlePump = nullptr;
 static TaskHandle_t taskHandleSpiComm = nullptr;
 static TaskHandle_t taskHandleUi = nullptr;
 static TaskHandle_t taskHandleNvs = nullptr;
+static TaskHandle_t taskHandleSdIo = nullptr;
+static TaskHandle_t taskHandleTelemetry = nullptr;
+static TaskHandle_t taskHandleLog = nullptr;
+static TaskHandle_t taskHandleCanRx = nullptr;
 
 // =============================================================================
 // NVS State
@@ -86,12 +100,21 @@ static void taskPump(void* param);
 static void taskSpiComm(void* param);
 static void taskUi(void* param);
 static void taskNvs(void* param);
+static void taskSdIo(void* param);
+static void taskTelemetry(void* param);
+static void taskLog(void* param);
+static void taskCanRx(void* param);
 
 // =============================================================================
 // Initialization
 // =============================================================================
 
 bool tasksInit() {
+    // Real-time tasks log through the ring from their first line
+    if (!deferredLogInit()) {
+        return false;
+    }
+
     // Create state mutex
     stateMutex = xSemaphoreCreateMutex();
     if (stateMutex == nullptr) {
@@ -112,6 +135,22 @@ bool tasksInit() {
         return false;
     }
 
+    // SD requests can be queued before the card is mounted
+    if (!sdIoInit()) {
+        return false;
+    }
+
+    // Without chunk buffers the recorder task just idles
+    if (!telemetryInit()) {
+        Serial.println("WARNING: Telemetry recorder unavailable");
+    }
+    if (!canCaptureInit()) {
+        Serial.println("WARNING: CAN capture unavailable");
+    }
+    if (!canReplayInit()) {
+        Serial.println("WARNING: CAN replay unavailable");
+    }
+
     // Initialize RTC tracking
     if (rtcMagic != RTC_MAGIC_VALUE) {
         rtcMagic = RTC_MAGIC_VALUE;
@@ -149,6 +188,9 @@ bool tasksInit() {
         Serial.printf("Last uptime: %lu ms\n", rtcLastUptimeMs);
     }
 
+    // Keeps the state before an abnormal reset for a dump
+    blackBoxInit();
+
     // Load settings from NVS
     prefs.begin("master", true);
     masterState.displayMode = prefs.getUChar("mode", MODE_AUTO);
@@ -189,6 +231,21 @@ bool tasksStart() {
         return false;
     }
 
+    // Create CAN RX task (empties the MCP2515 on its interrupt)
+    result = xTaskCreatePinnedToCore(
+        taskCanRx,
+        "CAN_RX",
+        TASK_STACK_CAN_RX,
+        nullptr,
+        TASK_PRIORITY_CAN_RX,
+        &taskHandleCanRx,
+        TASK_CORE_CAN_RX
+    );
+    if (result != pdPASS) {
+        Serial.println("Failed to create CAN RX task");
+        return false;
+    }
+
     // Create SPI communication task
     result = xTaskCreatePinnedToCore(
         taskSpiComm,
@@ -234,15 +291,68 @@ bool tasksStart() {
         return false;
     }
 
+    // Create SD I/O task (all card access from real-time tasks goes here)
+    result = xTaskCreatePinnedToCore(
+        taskSdIo,
+        "SD_IO",
+        TASK_STACK_SD_IO,
+        nullptr,
+        TASK_PRIORITY_SD_IO,
+        &taskHandleSdIo,
+        TASK_CORE_SD_IO
+    );
+    if (result != pdPASS) {
+        Serial.println("Failed to create SD I/O task");
+        return false;
+    }
+
+    // Create telemetry recorder task (samples state, never touches the card)
+    result = xTaskCreatePinnedToCore(
+        taskTelemetry,
+        "Telemetry",
+        TASK_STACK_TELEMETRY,
+        nullptr,
+        TASK_PRIORITY_TELEMETRY,
+        &taskHandleTelemetry,
+        TASK_CORE_TELEMETRY
+    );
+    if (result != pdPASS) {
+        Serial.println("Failed to create Telemetry task");
+        return false;
+    }
+
+    // Create log task (prints what the real-time tasks logged)
+    result = xTaskCreatePinnedToCore(
+        taskLog,
+        "Log",
+        TASK_STACK_LOG,
+        nullptr,
+        TASK_PRIORITY_LOG,
+        &taskHandleLog,
+        TASK_CORE_LOG
+    );
+    if (result != pdPASS) {
+        Serial.println("Failed to create Log task");
+        return false;
+    }
+
     Serial.println("\n=== Tasks Started ===");
     Serial.printf("  Pump:     Core %d, Priority %d, %dHz\n",
                   TASK_CORE_PUMP, TASK_PRIORITY_PUMP, 1000/PUMP_TASK_PERIOD_MS);
+    Serial.printf("  CAN_RX:   Core %d, Priority %d, on interrupt\n",
+                  TASK_CORE_CAN_RX, TASK_PRIORITY_CAN_RX);
     Serial.printf("  SPI_Comm: Core %d, Priority %d, %dHz\n",
                   TASK_CORE_SPI_COMM, TASK_PRIORITY_SPI_COMM, 1000/SPI_TASK_PERIOD_MS);
     Serial.printf("  UI:       Core %d, Priority %d, %dHz\n",
                   TASK_CORE_UI, TASK_PRIORITY_UI, 1000/UI_TASK_PERIOD_MS);
     Serial.printf("  NVS:      Core %d, Priority %d, %dHz\n",
                   TASK_CORE_NVS, TASK_PRIORITY_NVS, 1000/NVS_TASK_PERIOD_MS);
+    Serial.printf("  SD_IO:    Core %d, Priority %d, on demand\n",
+                  TASK_CORE_SD_IO, TASK_PRIORITY_SD_IO);
+    Serial.printf("  Telemetry: Core %d, Priority %d, up to %dHz\n",
+                  TASK_CORE_TELEMETRY, TASK_PRIORITY_TELEMETRY, TELEMETRY_MAX_RATE_HZ);
+    Serial.printf("  Log:      Core %d, Priority %d, %dHz\n",
+                  TASK_CORE_LOG, TASK_PRIORITY_LOG, 1000/LOG_TASK_PERIOD_MS);
     Serial.println("======================\n");
 
     return true;
@@ -252,6 +362,10 @@ TaskHandle_t getTaskPump() { return taskHandlePump; }
 TaskHandle_t getTaskSpiComm() { return taskHandleSpiComm; }
 TaskHandle_t getTaskUi() { return taskHandleUi; }
 TaskHandle_t getTaskNvs() { return taskHandleNvs; }
+TaskHandle_t getTaskSdIo() { return taskHandleSdIo; }
+TaskHandle_t getTaskTelemetry() { return taskHandleTelemetry; }
+TaskHandle_t getTaskLog() { return taskHandleLog; }
+TaskHandle_t getTaskCanRx() { return taskHandleCanRx; }
 
 // =============================================================================
 // Thread-Safe State Access
@@ -307,6 +421,7 @@ void tasksSetDisplayMode(uint8_t mode) {
             masterState.displayMode = mode;
             nvsSavePending = true;
             lastInputTime = millis();
+            blackBoxEvent(BLACKBOX_EVENT_DISPLAY_MODE, mode);
         }
         STATE_UNLOCK();
     }
@@ -331,13 +446,16 @@ void tasksRequestNvsSave() {
 void tasksEnterFailsafe(const char* reason) {
     if (masterState.health != HEALTH_FAILSAFE) {
         masterState.health = HEALTH_FAILSAFE;
-        Serial.printf("!!! FAILSAFE: %s !!!\n", reason);
+        LOG_PRINTF("!!! FAILSAFE: %s !!!\n", reason);
 
-        // Log to SD
+        // Keep the seconds leading up to this for the black box dump
+        blackBoxTrigger(BLACKBOX_EVENT_FAILSAFE, (uint16_t)masterState.spiTimeoutCount);
+
+        // Log to SD - queued, this runs on the pump task
         if (sdIsReady()) {
             char entry[128];
             snprintf(entry, sizeof(entry), "%lu,FAILSAFE,%s\n", millis(), reason);
-            sdAppendFileString("/crash_log.csv", entry);
+            sdIoAppendString("/crash_log.csv", entry, SD_IO_SAFETY);
         }
     }
 }
@@ -345,7 +463,8 @@ void tasksEnterFailsafe(const char* reason) {
 void tasksExitFailsafe() {
     if (masterState.health == HEALTH_FAILSAFE) {
         masterState.health = HEALTH_OK;
-        Serial.println("Failsafe cleared");
+        blackBoxEvent(BLACKBOX_EVENT_FAILSAFE_CLEAR, 0);
+        LOG_PRINTF("Failsafe cleared\n");
     }
 }
 
@@ -356,16 +475,11 @@ void tasksExitFailsafe() {
 // Controls PWM output for pump motors
 // Feeds watchdog - if this task hangs, system resets
 
-static uint8_t rpmToPwmDuty(uint16_t rpm) {
-    if (rpm >= 4000) return 255;
-    return (uint8_t)((rpm * 255UL) / 4000UL);
-}
-
 static void taskPump(void* param) {
     TickType_t lastWakeTime = xTaskGetTickCount();
     const TickType_t period = pdMS_TO_TICKS(PUMP_TASK_PERIOD_MS);
 
-    Serial.println("[Pump Task] Started - Safety Critical");
+    LOG_PRINTF("[Pump Task] Started - Safety Critical\n");
 
     while (true) {
         // Feed watchdog from this critical task
@@ -392,12 +506,15 @@ static void taskPump(void* param) {
             duty = FAILSAFE_PWM_DUTY;
         } else {
             uint16_t rpm = tasksGetCurrentRpm();
-            duty = rpmToPwmDuty(rpm);
+            duty = pumpDutyForRpm(rpm);
         }
 
         ledcWrite(PWM_OUTPUT_CHANNEL, duty);
         masterState.currentPwmDuty = duty;
 
+        // Black box sample (RTC memory, no lock)
+        blackBoxSample(now);
+
         vTaskDelayUntil(&lastWakeTime, period);
     }
 }
@@ -411,11 +528,75 @@ static void taskPump(void* param) {
 static uint8_t lastSlaveMode = MODE_AUTO;
 static uint16_t lastSlaveRpm = 3000;
 
+// CAN statistics dump to the slave ('is'): the summary, then an ID and a
+// TIMING packet per table entry, sent in place of every other state packet
+static volatile bool canStatsDumpRequested = false;
+static bool canStatsDumping = false;
+static bool canStatsSentLast = false;
+static uint32_t canStatsSlot = 0;
+static uint8_t canStatsRow = 0;
+static bool canStatsTimingNext = false;
+static CanIdStats canStatsEntry;
+
+static void putLe16(uint8_t* p, uint32_t value) {
+    if (value > 0xFFFF) value = 0xFFFF;
+    p[0] = value & 0xFF;
+    p[1] = (value >> 8) & 0xFF;
+}
+
+static bool nextCanStatsPacket(uint8_t* packet) {
+    uint8_t payload[5];
+
+    if (canStatsDumpRequested) {
+        canStatsDumpRequested = false;
+        CanBusSummary summary;
+        float average;
+        canGetBusSummary(&summary, &average);
+        putLe16(&payload[0], (uint32_t)(summary.load * 1000.0f + 0.5f));
+        payload[2] = summary.ids > 0xFF ? 0xFF : (uint8_t)summary.ids;
+        putLe16(&payload[3], summary.framesPerSec);
+        packCanStatsPacket(packet, CAN_STATS_KIND_SUMMARY, 0, payload);
+        canStatsDumping = true;
+        canStatsSlot = 0;
+        canStatsRow = 0;
+        canStatsTimingNext = false;
+        return true;
+    }
+    if (!canStatsDumping) {
+        return false;
+    }
+
+    if (canStatsTimingNext) {
+        putLe16(&payload[0], canStatsEntry.periodUs / 100);
+        putLe16(&payload[2], canStatsEntry.jitterUs / 10);
+        payload[4] = canStatsEntry.dlc | (canStatsEntry.rtr ? 0x80 : 0);
+        packCanStatsPacket(packet, CAN_STATS_KIND_TIMING, canStatsRow, payload);
+        canStatsTimingNext = false;
+        canStatsRow++;
+        return true;
+    }
+    while (canStatsRow < CAN_STATS_LINK_ROWS && canStatsSlot < CAN_STATS_SLOTS) {
+        if (canGetIdStats(canStatsSlot++, &canStatsEntry)) {
+            uint32_t id = canStatsEntry.id | (canStatsEntry.extended ? CAN_STATS_EXTENDED_BIT : 0);
+            for (int i = 0; i < 4; i++) {
+                payload[i] = (id >> (8 * i)) & 0xFF;
+            }
+            payload[4] = canStatsEntry.changed;
+            packCanStatsPacket(packet, CAN_STATS_KIND_ID, canStatsRow, payload);
+            canStatsTimingNext = true;
+            return true;
+        }
+    }
+    canStatsDumping = false;
+    LOG_PRINTF("CAN stats: %u IDs sent to slave\n", canStatsRow);
+    return false;
+}
+
 static void taskSpiComm(void* param) {
     TickType_t lastWakeTime = xTaskGetTickCount();
     const TickType_t period = pdMS_TO_TICKS(SPI_TASK_PERIOD_MS);
 
-    Serial.println("[SPI Task] Started");
+    LOG_PRINTF("[SPI Task] Started\n");
     
     // Initialize OTA handler
     masterOtaInit();
@@ -429,7 +610,7 @@ static void taskSpiComm(void* param) {
             // Still need to maintain watchdog
             if (masterOtaGetState() == MASTER_OTA_COMPLETE && masterOtaRebootPending()) {
                 // Update complete - reboot
-                Serial.println("[SPI Task] OTA complete, rebooting...");
+                LOG_PRINTF("[SPI Task] OTA complete, rebooting...\n");
                 vTaskDelay(pdMS_TO_TICKS(100));
                 masterOtaReboot();
             }
@@ -437,6 +618,20 @@ static void taskSpiComm(void* param) {
             continue;
         }
 
+        // CAN statistics dump; the slave's requests come again next exchange
+        uint8_t statsPacket[SPI_PACKET_SIZE];
+        if (!canStatsSentLast && nextCanStatsPacket(statsPacket)) {
+            canStatsSentLast = true;
+            uint8_t ignoredMode;
+            uint16_t ignoredRpm;
+            if (spiSendCanStats(statsPacket, &ignoredMode, &ignoredRpm)) {
+                masterState.lastValidSpiTime = now;
+            }
+            vTaskDelayUntil(&lastWakeTime, period);
+            continue;
+        }
+        canStatsSentLast = false;
+
         // Update simulation if in simulate mode
         if (masterState.opMode == OP_MODE_SIMULATE &&
             masterState.displayMode == MODE_AUTO) {
@@ -511,6 +706,11 @@ static void taskSpiComm(void* param) {
                 waterStatus = WATER_TEMP_STATUS_OK;
             }
         }
+        if (waterStatus != masterState.waterStatus) {
+            blackBoxEvent(BLACKBOX_EVENT_WATER_STATUS, waterStatus);
+        }
+        masterState.waterTempF10 = waterTempF10;
+        masterState.waterStatus = waterStatus;
 
         if (spiExchange(rpmToSend, modeToSend, waterTempF10, waterStatus, &reqMode, &reqRpm)) {
             // Valid response
@@ -530,8 +730,8 @@ static void taskSpiComm(void* param) {
                 if (reqMode != masterState.displayMode) {
                     tasksSetDisplayMode(reqMode);
                     changed = true;
-                    Serial.printf("Mode -> %s (slave)\n",
-                                  reqMode == MODE_AUTO ? "AUTO" : "MANUAL");
+                    LOG_PRINTF("Mode -> %s (slave)\n",
+                               reqMode == MODE_AUTO ? "AUTO" : "MANUAL");
                 }
             }
 
@@ -540,13 +740,14 @@ static void taskSpiComm(void* param) {
                 if (reqRpm != masterState.manualRpm) {
                     tasksSetManualRpm(reqRpm);
                     changed = true;
-                    Serial.printf("RPM -> %u (slave)\n", reqRpm);
+                    LOG_PRINTF("RPM -> %u (slave)\n", reqRpm);
                 }
             }
         } else {
             // SPI failed
             if (masterState.health == HEALTH_OK) {
                 masterState.health = HEALTH_SPI_TIMEOUT;
+                blackBoxEvent(BLACKBOX_EVENT_HEALTH, HEALTH_SPI_TIMEOUT);
             }
         }
 
@@ -600,7 +801,16 @@ static void printHelp() {
     Serial.println("SD Card:");
     Serial.println("  d - List root directory");
     Serial.println("  x - SD card info");
+    Serial.println("  l - SD latency (lr - and reset)");
     Serial.println("  L - View crash log");
+    Serial.println("  g - Telemetry recorder (g<hz> start, g0 stop)");
+    Serial.println("  b - Black box status");
+    Serial.println("  B - Dump black box now");
+    Serial.println("  o - Deferred log (o1/o0 copy to SD on/off)");
+    Serial.println("  e - EHPS CAN control (e1/e0 on/off)");
+    Serial.println("  k - CAN capture (ks to SD, ku to USB, k0 stop)");
+    Serial.println("  i - CAN IDs and bus load (ir reset, is send to slave)");
+    Serial.println("  y - CAN replay (y<file>[*<speed>] from /can, *0 max speed, yx stop)");
     Serial.println("  ? - This help");
     Serial.println();
 }
@@ -609,6 +819,8 @@ static void printStats() {
     Serial.println("\n=== Statistics ===");
     Serial.printf("CAN Messages: %lu\n", canGetMessageCount());
     Serial.printf("CAN Errors: %lu\n", canGetErrorCount());
+    canPrintRxStats();
+    canPrintTxStats();
     Serial.printf("SPI Success: %lu\n", spiGetSuccessCount());
     Serial.printf("SPI Errors: %lu\n", spiGetErrorCount());
     Serial.printf("SPI Timeouts: %lu\n", masterState.spiTimeoutCount);
@@ -645,6 +857,9 @@ static void printTaskInfo() {
     Serial.printf("Pump:     stack=%u, state=%d\n",
                   uxTaskGetStackHighWaterMark(taskHandlePump),
                   eTaskGetState(taskHandlePump));
+    Serial.printf("CAN_RX:   stack=%u, state=%d\n",
+                  uxTaskGetStackHighWaterMark(taskHandleCanRx),
+                  eTaskGetState(taskHandleCanRx));
     Serial.printf("SPI_Comm: stack=%u, state=%d\n",
                   uxTaskGetStackHighWaterMark(taskHandleSpiComm),
                   eTaskGetState(taskHandleSpiComm));
@@ -654,6 +869,15 @@ static void printTaskInfo() {
     Serial.printf("NVS:      stack=%u, state=%d\n",
                   uxTaskGetStackHighWaterMark(taskHandleNvs),
                   eTaskGetState(taskHandleNvs));
+    Serial.printf("SD_IO:    stack=%u, state=%d\n",
+                  uxTaskGetStackHighWaterMark(taskHandleSdIo),
+                  eTaskGetState(taskHandleSdIo));
+    Serial.printf("Telemetry: stack=%u, state=%d\n",
+                  uxTaskGetStackHighWaterMark(taskHandleTelemetry),
+                  eTaskGetState(taskHandleTelemetry));
+    Serial.printf("Log:      stack=%u, state=%d\n",
+                  uxTaskGetStackHighWaterMark(taskHandleLog),
+                  eTaskGetState(taskHandleLog));
     Serial.println();
 }
 
@@ -671,13 +895,23 @@ static void processEncoder() {
         uint8_t mode = tasksGetDisplayMode();
         uint8_t newMode = (mode == MODE_AUTO) ? MODE_MANUAL : MODE_AUTO;
         tasksSetDisplayMode(newMode);
-        Serial.printf("Button: %s\n", newMode == MODE_AUTO ? "AUTO" : "MANUAL");
+        LOG_PRINTF("Button: %s\n", newMode == MODE_AUTO ? "AUTO" : "MANUAL");
     }
 
     // Power steering level is handled automatically by encoder_mux
     // Get it when needed via encoderMuxGetPowerSteeringLevel()
 }
 
+static void processCan() {
+    // Drain the frames the CAN RX task queued; in RPM mode they drive the pump
+    uint16_t rpm;
+    if (canProcess(&rpm) &&
+        masterState.opMode == OP_MODE_RPM &&
+        masterState.displayMode == MODE_AUTO) {
+        tasksSetCurrentRpm(rpm);
+    }
+}
+
 static void processSerial() {
     if (!Serial.available()) return;
 
@@ -691,6 +925,7 @@ static void processSerial() {
         case 's':
         case 'S':
             masterState.opMode = OP_MODE_SNIFF;
+            blackBoxEvent(BLACKBOX_EVENT_OP_MODE, OP_MODE_SNIFF);
             canSetMode(CAN_MODE_SNIFF);
             Serial.println("Sniff mode");
             break;
@@ -698,6 +933,7 @@ static void processSerial() {
         case 'r':
         case 'R':
             masterState.opMode = OP_MODE_RPM;
+            blackBoxEvent(BLACKBOX_EVENT_OP_MODE, OP_MODE_RPM);
             canSetMode(CAN_MODE_RPM);
             Serial.println("RPM mode");
             break;
@@ -705,8 +941,10 @@ static void processSerial() {
         case 'm':
         case 'M':
             masterState.opMode = OP_MODE_SIMULATE;
+            blackBoxEvent(BLACKBOX_EVENT_OP_MODE, OP_MODE_SIMULATE);
             masterState.lastSimChange = millis();
             masterState.simGoingUp = true;
+            canSetMode(CAN_MODE_IDLE);
             tasksSetCurrentRpm(SIM_MIN_RPM);
             Serial.println("Simulate mode");
             break;
@@ -754,6 +992,25 @@ static void processSerial() {
                               sdGetCardType(),
                               sdGetTotalBytes() / (1024*1024),
                               sdGetFreeBytes() / (1024*1024));
+                SdFileCacheStats cache;
+                uint32_t openFiles;
+                sdGetFileCacheStats(&cache, &openFiles);
+                Serial.printf("SD: %lu files open, %lu hits, %lu opens, %lu evictions, %lu syncs\n",
+                              openFiles, cache.hits, cache.misses + cache.bypasses,
+                              cache.evictions, cache.syncs);
+                sdIoPrintStats();
+            } else {
+                Serial.println("SD not mounted");
+            }
+            break;
+
+        case 'l':
+            if (sdIsReady()) {
+                sdPrintLatencyStats();
+                if (input.length() > 1 && input[1] == 'r') {
+                    sdResetLatencyStats();
+                    Serial.println("SD latency reset");
+                }
             } else {
                 Serial.println("SD not mounted");
             }
@@ -772,6 +1029,103 @@ static void processSerial() {
             }
             break;
 
+        case 'g':
+            // Telemetry recorder status, or start/stop with a rate
+            if (input.length() > 1) {
+                long rate = input.substring(1).toInt();
+                if (rate < 0 || !telemetrySetRate((uint16_t)rate)) {
+                    Serial.printf("Telemetry rate must be 0..%d Hz\n", TELEMETRY_MAX_RATE_HZ);
+                } else {
+                    Serial.printf("Telemetry -> %ld Hz\n", rate);
+                }
+            } else {
+                telemetryPrintStats();
+            }
+            break;
+
+        case 'b':
+            blackBoxPrintStats();
+            break;
+
+        case 'B':
+            blackBoxTrigger(BLACKBOX_EVENT_MANUAL, 0);
+            Serial.printf("Black box: dump after %d more samples\n", BLACKBOX_POST_SAMPLES);
+            break;
+
+        case 'o':
+            // Deferred log status, or SD copy on/off
+            if (input.length() > 1) {
+                bool enabled = input[1] == '1';
+                deferredLogSetSd(enabled);
+                Serial.printf("Log SD copy -> %s\n", enabled ? "on" : "off");
+            } else {
+                deferredLogPrintStats();
+            }
+            break;
+
+        case 'e':
+            // EHPS CAN control status, or on/off
+            if (input.length() > 1) {
+                bool enabled = input[1] == '1';
+                ehpsEnable(enabled);
+                Serial.printf("EHPS CAN control -> %s\n", enabled ? "on" : "off");
+            } else {
+                canPrintTxStats();
+            }
+            break;
+
+        case 'k':
+            // CAN capture status, or start/stop
+            if (input.length() > 1) {
+                CanCaptureSink sink = input[1] == 's' ? CAN_CAPTURE_SD
+                                    : input[1] == 'u' ? CAN_CAPTURE_USB : CAN_CAPTURE_OFF;
+                if (!canCaptureStart(sink)) {
+                    Serial.println(sink == CAN_CAPTURE_SD ? "CAN capture: SD not ready"
+                                                          : "CAN capture: unavailable");
+                } else {
+                    canRefreshFilters();
+                    Serial.printf("CAN capture -> %s\n", sink == CAN_CAPTURE_SD ? "SD"
+                                  : sink == CAN_CAPTURE_USB ? "USB" : "off");
+                }
+            } else {
+                canCapturePrintStats();
+            }
+            break;
+
+        case 'i':
+            // Per-ID CAN statistics
+            if (input.length() > 1 && input[1] == 'r') {
+                canResetIdStats();
+                Serial.println("CAN ID statistics reset");
+            } else if (input.length() > 1 && input[1] == 's') {
+                canStatsDumpRequested = true;
+                Serial.printf("CAN stats: sending up to %u IDs to slave\n", CAN_STATS_LINK_ROWS);
+            } else {
+                canPrintIdStats();
+            }
+            break;
+
+        case 'y':
+            // CAN replay status, start (file, optional speed) or stop
+            if (input.length() > 1 && input[1] == 'x') {
+                canReplayStop();
+                Serial.println("CAN replay -> off");
+            } else if (input.length() > 1) {
+                int star = input.indexOf('*');
+                long file = input.substring(1, star < 0 ? input.length() : star).toInt();
+                long speed = star < 0 ? 1 : input.substring(star + 1).toInt();
+                if (file < 0 || speed < 0 || !canReplayStart((uint32_t)file, (uint32_t)speed)) {
+                    Serial.printf("CAN replay: no capture %ld on SD\n", file);
+                } else if (speed == CAN_REPLAY_ASAP) {
+                    Serial.printf("CAN replay -> %05ld.cap at max speed\n", file);
+                } else {
+                    Serial.printf("CAN replay -> %05ld.cap at %ldx\n", file, speed);
+                }
+            } else {
+                canReplayPrintStats();
+            }
+            break;
+
         case 'p':
             // Enable RPM pulse counter
             if (!rpmCounterIsEnabled()) {
@@ -856,28 +1210,29 @@ static void taskUi(void* param) {
     // Initialize MCP23017-based encoder multiplexer
     if (encoderMuxInit()) {
         encoderMuxEnable();
-        Serial.println("[UI Task] Encoder MUX initialized");
+        LOG_PRINTF("[UI Task] Encoder MUX initialized\n");
     } else {
-        Serial.println("[UI Task] WARNING: Encoder MUX init failed - MCP23017 not found");
+        LOG_PRINTF("[UI Task] WARNING: Encoder MUX init failed - MCP23017 not found\n");
     }
 
-    Serial.println("[UI Task] Started");
+    LOG_PRINTF("[UI Task] Started\n");
 
     // Heartbeat counter
     uint32_t loopCount = 0;
 
     while (true) {
         processEncoder();
+        processCan();
         processSerial();
 
         // Heartbeat every 5 seconds
         loopCount++;
         if (loopCount >= (5000 / UI_TASK_PERIOD_MS)) {
             loopCount = 0;
-            Serial.printf("Heartbeat: %s, rpm=%u, pwm=%u\n",
-                          getHealthName(masterState.health),
-                          masterState.currentRpm,
-                          masterState.currentPwmDuty);
+            LOG_PRINTF("Heartbeat: %s, rpm=%u, pwm=%u\n",
+                       getHealthName(masterState.health),
+                       masterState.currentRpm,
+                       masterState.currentPwmDuty);
         }
 
         vTaskDelayUntil(&lastWakeTime, period);
@@ -895,6 +1250,9 @@ static void taskNvs(void* param) {
     Serial.println("[NVS Task] Started");
 
     while (true) {
+        // Black box dumps are formatted here, away from the pump task
+        blackBoxProcess();
+
         // Check if save is pending and debounce time has passed
         if (nvsSavePending) {
             uint32_t now = millis();
@@ -927,3 +1285,65 @@ static void taskNvs(void* param) {
         vTaskDelayUntil(&lastWakeTime, period);
     }
 }
+
+// =============================================================================
+// SD I/O Task
+// =============================================================================
+// Runs queued SD requests (sd_io.h) most important first, and flushes files
+// left with buffered writes
+
+static void taskSdIo(void* param) {
+    Serial.println("[SD I/O Task] Started");
+
+    while (true) {
+        sdIoProcess(SD_IO_IDLE_WAIT_MS);
+        sdPeriodicSync();
+    }
+}
+
+// =============================================================================
+// Telemetry Recorder Task
+// =============================================================================
+// Samples the master state into binary log chunks (telemetry.h) and hands
+// them to the SD I/O task
+
+static void taskTelemetry(void* param) {
+    Serial.println("[Telemetry Task] Started");
+
+    while (true) {
+        telemetryProcess();
+    }
+}
+
+// =============================================================================
+// Log Task
+// =============================================================================
+// Formats and prints what the real-time tasks logged (deferred_log.h), and
+// writes CAN capture blocks bound for USB (can_capture.h)
+
+static void taskLog(void* param) {
+    TickType_t lastWakeTime = xTaskGetTickCount();
+    const TickType_t period = pdMS_TO_TICKS(LOG_TASK_PERIOD_MS);
+
+    Serial.println("[Log Task] Started");
+
+    while (true) {
+        deferredLogProcess();
+        canCaptureDrainUsb();
+        vTaskDelayUntil(&lastWakeTime, period);
+    }
+}
+
+// =============================================================================
+// CAN RX Task
+// =============================================================================
+// Woken by the MCP2515 interrupt, moves received frames into the frame ring
+// (can_handler.h) before the controller's two buffers overflow
+
+static void taskCanRx(void* param) {
+    Serial.println("[CAN RX Task] Started");
+
+    while (true) {
+        canRxProcess(CAN_RX_IDLE_WAIT_MS);
+    }
+}
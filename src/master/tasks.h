@@ -14,23 +14,35 @@
 // Task priorities (higher = more important)
 // CRITICAL: Pump control must be highest priority for safety
 #define TASK_PRIORITY_PUMP      10    // Highest - safety critical PWM control
+#define TASK_PRIORITY_CAN_RX    6     // High - MCP2515 holds only two frames
 #define TASK_PRIORITY_SPI_COMM  5     // High - slave communication
+#define TASK_PRIORITY_TELEMETRY 4     // Medium - sampling must not wait behind the card
 #define TASK_PRIORITY_UI        3     // Medium - encoder and serial
+#define TASK_PRIORITY_SD_IO     2     // Low - card latency must not delay the UI
 #define TASK_PRIORITY_NVS       1     // Low - settings persistence
+#define TASK_PRIORITY_LOG       1     // Low - formats the real-time tasks' messages
 
 // Stack sizes (in words, not bytes)
 #define TASK_STACK_PUMP      4096
+#define TASK_STACK_CAN_RX    3072
 #define TASK_STACK_SPI_COMM  4096
 #define TASK_STACK_UI        4096
-#define TASK_STACK_NVS       2048
+#define TASK_STACK_SD_IO     4096  // SD library + completion callbacks
+#define TASK_STACK_TELEMETRY 4096  // Directory scan when recording starts
+#define TASK_STACK_NVS       3072  // Black box dump formatting
+#define TASK_STACK_LOG       3072  // snprintf
 
 // Core assignments (ESP32-S3 has 2 cores)
 // Core 0: WiFi/BT stack, lower priority tasks
 // Core 1: Time-critical tasks
 #define TASK_CORE_PUMP      1     // Pump control on Core 1 for deterministic timing
 #define TASK_CORE_SPI_COMM  0     // SPI on Core 0
+#define TASK_CORE_CAN_RX    0     // CAN RX on Core 0, away from the pump
 #define TASK_CORE_UI        1     // UI on Core 1 (encoder needs fast response)
+#define TASK_CORE_SD_IO     0     // SD I/O on Core 0, away from the pump
+#define TASK_CORE_TELEMETRY 0     // Telemetry on Core 0, away from the pump
 #define TASK_CORE_NVS       0     // NVS on Core 0 (flash operations)
+#define TASK_CORE_LOG       0     // Log on Core 0, Serial output away from the pump
 
 // Queue sizes
 #define QUEUE_SIZE_SLAVE_CMD    4     // Commands from slave UI
@@ -45,6 +57,9 @@
 #define SPI_TASK_PERIOD_MS      100   // 10Hz SPI communication
 #define UI_TASK_PERIOD_MS       20    // 50Hz encoder polling
 #define NVS_TASK_PERIOD_MS      1000  // 1Hz NVS check
+#define LOG_TASK_PERIOD_MS      20    // 50Hz deferred log drain
+#define SD_IO_IDLE_WAIT_MS      100   // SD I/O task wakes at least this often to sync files
+#define CAN_RX_IDLE_WAIT_MS     10    // CAN RX task checks the INT pin this often without an interrupt
 
 // Safety thresholds
 #define SPI_COMM_TIMEOUT_MS     500   // Enter failsafe after this
@@ -112,6 +127,10 @@ typedef struct {
     // PWM state
     uint8_t currentPwmDuty;
 
+    // Water temperature as last sent to the slave (WATER_TEMP_STATUS_*)
+    int16_t waterTempF10;
+    uint8_t waterStatus;
+
     // Simulation state
     bool simGoingUp;
     uint32_t lastSimChange;
@@ -146,6 +165,10 @@ TaskHandle_t getTaskPump();
 TaskHandle_t getTaskSpiComm();
 TaskHandle_t getTaskUi();
 TaskHandle_t getTaskNvs();
+TaskHandle_t getTaskSdIo();
+TaskHandle_t getTaskTelemetry();
+TaskHandle_t getTaskLog();
+TaskHandle_t getTaskCanRx();
 
 // =============================================================================
 // State Access Functions (Thread-Safe)
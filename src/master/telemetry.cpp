@@ -0,0 +1,333 @@
+#include "master/telemetry.h"
+#include "master/sd_handler.h"
+#include "master/sd_io.h"
+#include "tasks.h"
+#include "rpm_counter.h"
+#include "vss_counter.h"
+#include "water_temp.h"
+#include "encoder_mux.h"
+#include "shared/config.h"
+#include "shared/protocol.h"
+#include "shared/version.h"
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <freertos/queue.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TELEMETRY_IDLE_WAIT_MS      100     // Stopped recorder checks for work this often
+#define TELEMETRY_INPUT_PERIOD_MS   100     // Window the pulse inputs are averaged over
+#define TELEMETRY_PATH_MAX          24
+
+// A chunk handed to the SD I/O task, one per buffer
+typedef struct {
+    char path[TELEMETRY_PATH_MAX];
+    uint32_t fileIndex;
+    uint32_t chunkIndex;
+    uint8_t buffer;
+} ChunkWrite;
+
+static TelemetryWriter writer;
+static uint8_t* buffers[TELEMETRY_BUFFERS];
+static uint32_t bufferCount = 0;
+static ChunkWrite writes[TELEMETRY_BUFFERS];
+static QueueHandle_t writtenQueue = nullptr;    // Buffers back from the SD I/O task
+
+// Sealed chunks the SD I/O queue had no room for yet, oldest first
+static TelemetryChunk pending[TELEMETRY_BUFFERS];
+static uint32_t pendingCount = 0;
+
+static volatile uint16_t requestedRate = TELEMETRY_RATE_HZ;
+static uint16_t startedRate = 0;                // Request the recording was started for
+static bool recording = false;
+static bool nextFileKnown = false;
+static uint32_t nextFile = 0;
+
+static TickType_t lastWake;
+static TickType_t period;
+static uint32_t sequence = 0;
+
+// Pulse inputs, refreshed every TELEMETRY_INPUT_PERIOD_MS
+static uint16_t inputRpm = 0;
+static uint16_t speedKph10 = 0;
+static uint32_t lastInputMs = 0;
+
+static TelemetryStats stats;
+static volatile uint32_t writeErrors = 0;       // Counted on the SD I/O task
+
+// =============================================================================
+// Files
+// =============================================================================
+
+static void telemetryPath(uint32_t fileIndex, char* path, size_t size) {
+    snprintf(path, size, TELEMETRY_DIR "/%05lu.bin", (unsigned long)fileIndex);
+}
+
+static bool findLastFile(const char* name, bool isDirectory, size_t size, void* userData) {
+    uint32_t* last = (uint32_t*)userData;
+    char* end;
+    unsigned long index = strtoul(name, &end, 10);
+    if (!isDirectory && end != name && strcmp(end, ".bin") == 0 && index + 1 > *last) {
+        *last = index + 1;
+    }
+    return true;
+}
+
+// Runs on the SD I/O task
+static void onChunkWritten(int32_t result, void* context) {
+    ChunkWrite* write = (ChunkWrite*)context;
+    if (result < 0) {
+        writeErrors++;
+    }
+
+    // First chunk of a new file is on the card: drop the oldest file
+    if (result >= 0 && write->chunkIndex == 0 && write->fileIndex >= TELEMETRY_FILES) {
+        char oldPath[TELEMETRY_PATH_MAX];
+        telemetryPath(write->fileIndex - TELEMETRY_FILES, oldPath, sizeof(oldPath));
+        if (sdExists(oldPath)) {
+            sdRemove(oldPath);
+        }
+    }
+
+    uint8_t buffer = write->buffer;
+    xQueueSend(writtenQueue, &buffer, 0);
+}
+
+// Hand sealed chunks to the SD I/O task in order, keeping the rest for the
+// next sample when its queue is full
+static void submitPending() {
+    uint32_t submitted = 0;
+    while (submitted < pendingCount) {
+        const TelemetryChunk& chunk = pending[submitted];
+        ChunkWrite* write = &writes[chunk.buffer];
+        telemetryPath(chunk.fileIndex, write->path, sizeof(write->path));
+        write->fileIndex = chunk.fileIndex;
+        write->chunkIndex = chunk.chunkIndex;
+        write->buffer = chunk.buffer;
+        uint32_t offset = telemetryChunkOffset(chunk.chunkIndex, writer.chunkBytes());
+        if (!sdIoWriteAt(write->path, offset, chunk.data, chunk.length, SD_IO_TELEMETRY,
+                         onChunkWritten, write)) {
+            break;
+        }
+        submitted++;
+    }
+    if (submitted > 0) {
+        memmove(pending, pending + submitted, (pendingCount - submitted) * sizeof(TelemetryChunk));
+        pendingCount -= submitted;
+    }
+}
+
+static void releaseWritten() {
+    uint8_t buffer;
+    while (xQueueReceive(writtenQueue, &buffer, 0) == pdTRUE) {
+        writer.release(buffer);
+    }
+}
+
+// =============================================================================
+// Recording
+// =============================================================================
+
+// Chunk that fills in about TELEMETRY_CHUNK_MS, whole sectors, at most TELEMETRY_CHUNK_KB
+static uint32_t chunkBytesFor(uint16_t rateHz) {
+    uint32_t bytes = sizeof(TelemetryChunkHeader) +
+                     (uint32_t)rateHz * TELEMETRY_CHUNK_MS / 1000 * sizeof(TelemetryRecord);
+    bytes = (bytes + 511) & ~511UL;
+    return bytes > TELEMETRY_CHUNK_KB * 1024UL ? TELEMETRY_CHUNK_KB * 1024UL : bytes;
+}
+
+// Buffers still out with the SD I/O task delay the start, the writer is
+// reconfigured for the new chunk size
+static bool startRecording(uint16_t rateHz) {
+    if (!sdIsReady() || writer.stats().buffersInUse > 0) {
+        return false;
+    }
+
+    if (!nextFileKnown) {
+        sdMkdir(TELEMETRY_DIR);
+        nextFile = 0;
+        sdListDir(TELEMETRY_DIR, findLastFile, &nextFile);
+        nextFileKnown = true;
+    }
+
+    period = configTICK_RATE_HZ / rateHz > 0 ? configTICK_RATE_HZ / rateHz : 1;
+    uint16_t actualRate = configTICK_RATE_HZ / period;
+    uint32_t chunkBytes = chunkBytesFor(actualRate);
+    uint32_t fileChunks = TELEMETRY_FILE_MB * 1024UL * 1024UL / chunkBytes;
+    if (!writer.init(buffers, bufferCount, chunkBytes, fileChunks, nextFile, actualRate,
+                     FIRMWARE_VERSION)) {
+        Serial.println("Telemetry: Bad configuration");
+        requestedRate = 0;
+        return false;
+    }
+
+    memset(&stats, 0, sizeof(stats));
+    writeErrors = 0;
+    stats.rateHz = actualRate;
+    sequence = 0;
+    lastInputMs = 0;
+    lastWake = xTaskGetTickCount();
+    recording = true;
+
+    char path[TELEMETRY_PATH_MAX];
+    telemetryPath(nextFile, path, sizeof(path));
+    Serial.printf("Telemetry: Recording %u Hz to %s, %lu B chunks\n",
+                  actualRate, path, chunkBytes);
+    return true;
+}
+
+static void stopRecording() {
+    TelemetryChunk chunk;
+    if (writer.flush(&chunk)) {
+        pending[pendingCount++] = chunk;
+    }
+    writer.endFile();
+    submitPending();
+    if (writer.stats().files > 0) {
+        nextFile = writer.currentFile() + 1;
+    }
+    recording = false;
+    stats.rateHz = 0;
+    Serial.printf("Telemetry: Stopped, %lu records\n", writer.stats().records);
+}
+
+static void updateInputs(uint32_t nowMs) {
+    if (lastInputMs != 0 && nowMs - lastInputMs < TELEMETRY_INPUT_PERIOD_MS) return;
+    lastInputMs = nowMs;
+    inputRpm = rpmCounterIsEnabled() ? (uint16_t)rpmCounterGetRPM() : 0;
+    speedKph10 = vssCounterIsEnabled() ? (uint16_t)(vssCounterGetKPH() * 10.0f) : 0;
+}
+
+// Plain reads of masterState: each field is written whole by its owner
+// task, and a sample mixing two updates is harmless in a log
+static void sample(TelemetryRecord* record, uint64_t nowUs) {
+    record->timeUs = (uint32_t)nowUs;
+    record->sequence = sequence++;
+    record->targetRpm = masterState.currentRpm;
+    record->manualRpm = masterState.manualRpm;
+    record->inputRpm = inputRpm;
+    record->speedKph10 = speedKph10;
+    record->waterTempF10 = masterState.waterTempF10;
+    record->waterStatus = masterState.waterStatus;
+    record->pwmDuty = masterState.currentPwmDuty;
+    record->steeringLevel = encoderMuxIsEnabled() ? encoderMuxGetPowerSteeringLevel() : 0;
+    record->health = (uint8_t)masterState.health;
+    record->modes = (masterState.displayMode & TELEMETRY_MODE_DISPLAY_MASK) |
+                    ((uint8_t)masterState.opMode << TELEMETRY_MODE_OP_SHIFT);
+    record->flags = (rpmCounterIsEnabled() ? TELEMETRY_FLAG_RPM_INPUT : 0) |
+                    (vssCounterIsEnabled() ? TELEMETRY_FLAG_VSS_INPUT : 0) |
+                    (waterTempIsEnabled() ? TELEMETRY_FLAG_WATER_INPUT : 0) |
+                    (encoderMuxIsEnabled() ? TELEMETRY_FLAG_ENCODER : 0);
+}
+
+// =============================================================================
+// Public API
+// =============================================================================
+
+bool telemetryInit() {
+    if (writtenQueue) return true;
+    writtenQueue = xQueueCreate(TELEMETRY_BUFFERS, sizeof(uint8_t));
+    if (!writtenQueue) {
+        Serial.println("Telemetry: Failed to create queue");
+        return false;
+    }
+
+    // PSRAM if present; internal RAM is only worth a minimal double buffer
+    size_t size = TELEMETRY_BUFFER_BYTES(TELEMETRY_CHUNK_KB * 1024UL);
+    for (uint32_t i = 0; i < TELEMETRY_BUFFERS; i++) {
+        uint8_t* buffer = (uint8_t*)heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+        if (!buffer && i < 2) {
+            buffer = (uint8_t*)malloc(size);
+        }
+        if (!buffer) break;
+        buffers[bufferCount++] = buffer;
+    }
+    if (bufferCount < 2) {
+        Serial.println("Telemetry: Not enough memory for chunk buffers");
+        return false;
+    }
+    Serial.printf("Telemetry: %lu x %u KB chunk buffers\n", bufferCount, (unsigned)(size / 1024));
+    return true;
+}
+
+void telemetryProcess() {
+    if (bufferCount < 2) {
+        vTaskDelay(pdMS_TO_TICKS(TELEMETRY_IDLE_WAIT_MS));
+        return;
+    }
+
+    releaseWritten();
+    if (pendingCount > 0) {
+        submitPending();
+    }
+
+    if (recording && requestedRate != startedRate) {
+        stopRecording();
+    }
+    if (!recording) {
+        if (requestedRate > 0 && startRecording(requestedRate)) {
+            startedRate = requestedRate;
+        } else {
+            vTaskDelay(pdMS_TO_TICKS(TELEMETRY_IDLE_WAIT_MS));
+        }
+        return;
+    }
+
+    // Late periods are sampled straight away, so the record times show the jitter
+    if (xTaskDelayUntil(&lastWake, period) == pdFALSE) {
+        stats.overruns++;
+    }
+
+    uint64_t nowUs = esp_timer_get_time();
+    updateInputs(millis());
+    TelemetryRecord record;
+    sample(&record, nowUs);
+    stats.samples++;
+
+    TelemetryChunk chunk;
+    if (writer.add(record, nowUs, &chunk)) {
+        pending[pendingCount++] = chunk;
+        submitPending();
+    }
+
+    uint32_t us = (uint32_t)(esp_timer_get_time() - nowUs);
+    if (us > stats.maxSampleUs) {
+        stats.maxSampleUs = us;
+    }
+}
+
+bool telemetrySetRate(uint16_t rateHz) {
+    if (rateHz > TELEMETRY_MAX_RATE_HZ) {
+        return false;
+    }
+    requestedRate = rateHz;
+    return true;
+}
+
+void telemetryGetStats(TelemetryStats* out) {
+    *out = stats;
+    out->writeErrors = writeErrors;
+    out->writer = writer.stats();
+}
+
+void telemetryPrintStats() {
+    TelemetryStats s;
+    telemetryGetStats(&s);
+
+    if (s.rateHz == 0) {
+        Serial.printf("Telemetry: Stopped (%s)\n",
+                      requestedRate > 0 ? "waiting for the SD card" : "off");
+    } else {
+        char path[TELEMETRY_PATH_MAX];
+        telemetryPath(writer.currentFile(), path, sizeof(path));
+        Serial.printf("Telemetry: %u Hz, %s\n", s.rateHz, path);
+    }
+    Serial.printf("  %lu samples, %lu dropped, %lu late, %lu write errors, sample max %lu us\n",
+                  s.samples, s.writer.dropped, s.overruns, s.writeErrors, s.maxSampleUs);
+    Serial.printf("  %lu chunks of %lu B (%lu records), %lu files, %llu KB\n",
+                  s.writer.chunks, writer.chunkBytes(), writer.chunkRecords(), s.writer.files,
+                  s.writer.bytes / 1024);
+    Serial.printf("  %lu/%lu buffers in use, %lu at most, %lu waiting for the queue\n",
+                  s.writer.buffersInUse, bufferCount, s.writer.maxBuffersInUse, pendingCount);
+}
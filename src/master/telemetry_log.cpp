@@ -0,0 +1,197 @@
+#include "master/telemetry_log.h"
+#include "shared/ota_protocol.h"
+#include <string.h>
+
+// =============================================================================
+// Format
+// =============================================================================
+
+uint32_t telemetryHeaderCrc(const void* header, size_t size) {
+    return otaCrc32((const uint8_t*)header, size - sizeof(uint32_t));
+}
+
+bool telemetryFileHeaderValid(const TelemetryFileHeader* header) {
+    return header->magic == TELEMETRY_FILE_MAGIC &&
+           header->version == TELEMETRY_FORMAT_VERSION &&
+           header->recordBytes == sizeof(TelemetryRecord) &&
+           header->headerBytes == TELEMETRY_FILE_HEADER_BYTES &&
+           header->chunkBytes > sizeof(TelemetryChunkHeader) &&
+           header->crc == telemetryHeaderCrc(header, sizeof(TelemetryFileHeader));
+}
+
+bool telemetryChunkValid(const TelemetryChunkHeader* header, const uint8_t* data,
+                         uint32_t chunkRecords) {
+    if (header->magic != TELEMETRY_CHUNK_MAGIC ||
+        header->crc != telemetryHeaderCrc(header, sizeof(TelemetryChunkHeader)) ||
+        header->recordCount == 0 || header->recordCount > chunkRecords) {
+        return false;
+    }
+    return header->dataCrc == otaCrc32(data, header->recordCount * sizeof(TelemetryRecord));
+}
+
+// =============================================================================
+// Writer
+// =============================================================================
+
+TelemetryWriter::TelemetryWriter()
+    : _count(0)
+    , _chunkBytes(0)
+    , _chunkRecords(0)
+    , _fileChunks(0)
+    , _sampleRateHz(0)
+    , _current(-1)
+    , _withHeader(false)
+    , _crc(0)
+    , _fileIndex(0)
+    , _nextChunk(0)
+    , _fileOpen(false) {
+    memset(_buffers, 0, sizeof(_buffers));
+    memset(_busy, 0, sizeof(_busy));
+    memset(_firmware, 0, sizeof(_firmware));
+    memset(&_header, 0, sizeof(_header));
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+bool TelemetryWriter::init(uint8_t* const* buffers, uint32_t count, uint32_t chunkBytes,
+                           uint32_t fileChunks, uint32_t firstFile, uint16_t sampleRateHz,
+                           const char* firmware) {
+    if (count == 0 || count > TELEMETRY_MAX_BUFFERS || fileChunks == 0 ||
+        chunkBytes < sizeof(TelemetryChunkHeader) + sizeof(TelemetryRecord) ||
+        telemetryChunkRecords(chunkBytes) > UINT16_MAX) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if (!buffers[i]) return false;
+        _buffers[i] = buffers[i];
+        _busy[i] = false;
+    }
+    _count = count;
+    _chunkBytes = chunkBytes;
+    _chunkRecords = telemetryChunkRecords(chunkBytes);
+    _fileChunks = fileChunks;
+    _sampleRateHz = sampleRateHz;
+    strncpy(_firmware, firmware ? firmware : "", sizeof(_firmware) - 1);
+    _current = -1;
+    _fileIndex = firstFile;
+    _nextChunk = 0;
+    _fileOpen = false;
+    memset(&_stats, 0, sizeof(_stats));
+    return true;
+}
+
+// Take a free buffer for a chunk starting with record, and start a new
+// file first if the last one is complete
+bool TelemetryWriter::acquire(const TelemetryRecord& record, uint64_t timeUs) {
+    int32_t free = -1;
+    for (uint32_t i = 0; i < _count; i++) {
+        if (!_busy[i]) {
+            free = (int32_t)i;
+            break;
+        }
+    }
+    if (free < 0) return false;
+
+    _busy[free] = true;
+    _current = free;
+    _stats.buffersInUse++;
+    if (_stats.buffersInUse > _stats.maxBuffersInUse) {
+        _stats.maxBuffersInUse = _stats.buffersInUse;
+    }
+
+    _withHeader = !_fileOpen;
+    if (_withHeader) {
+        if (_stats.files > 0) _fileIndex++;
+        _fileOpen = true;
+        _nextChunk = 0;
+        _stats.files++;
+
+        TelemetryFileHeader file;
+        memset(&file, 0, sizeof(file));
+        file.magic = TELEMETRY_FILE_MAGIC;
+        file.version = TELEMETRY_FORMAT_VERSION;
+        file.headerBytes = TELEMETRY_FILE_HEADER_BYTES;
+        file.recordBytes = sizeof(TelemetryRecord);
+        file.sampleRateHz = _sampleRateHz;
+        file.chunkBytes = _chunkBytes;
+        file.chunkRecords = _chunkRecords;
+        file.fileIndex = _fileIndex;
+        file.startTimeUs = timeUs;
+        file.firstSequence = record.sequence;
+        memcpy(file.firmware, _firmware, sizeof(file.firmware));
+        file.crc = telemetryHeaderCrc(&file, sizeof(file));
+
+        memset(_buffers[free], 0, TELEMETRY_FILE_HEADER_BYTES);
+        memcpy(_buffers[free], &file, sizeof(file));
+    }
+
+    memset(&_header, 0, sizeof(_header));
+    _header.magic = TELEMETRY_CHUNK_MAGIC;
+    _header.chunkIndex = _nextChunk++;
+    _header.firstSequence = record.sequence;
+    _header.firstTimeUs = timeUs;
+    _crc = 0xFFFFFFFF;
+    return true;
+}
+
+bool TelemetryWriter::add(const TelemetryRecord& record, uint64_t timeUs, TelemetryChunk* chunk) {
+    if (_count == 0) return false;
+    if (_current < 0 && !acquire(record, timeUs)) {
+        _stats.dropped++;
+        return false;
+    }
+
+    uint8_t* base = _buffers[_current] + (_withHeader ? TELEMETRY_FILE_HEADER_BYTES : 0);
+    memcpy(base + sizeof(TelemetryChunkHeader) + _header.recordCount * sizeof(TelemetryRecord),
+           &record, sizeof(TelemetryRecord));
+    // Checksum as we go, so sealing a chunk costs no more than adding a record
+    _crc = ~otaCrc32((const uint8_t*)&record, sizeof(TelemetryRecord), _crc);
+    _header.recordCount++;
+    _stats.records++;
+
+    if (_header.recordCount < _chunkRecords) return false;
+    seal(chunk);
+    return true;
+}
+
+bool TelemetryWriter::flush(TelemetryChunk* chunk) {
+    if (_current < 0) return false;
+    seal(chunk);
+    return true;
+}
+
+void TelemetryWriter::endFile() {
+    _fileOpen = false;
+}
+
+// Pad, checksum and hand out the current chunk
+void TelemetryWriter::seal(TelemetryChunk* chunk) {
+    uint32_t headerBytes = _withHeader ? TELEMETRY_FILE_HEADER_BYTES : 0;
+    uint8_t* base = _buffers[_current] + headerBytes;
+    uint8_t* records = base + sizeof(TelemetryChunkHeader);
+    uint32_t used = _header.recordCount * sizeof(TelemetryRecord);
+
+    memset(records + used, 0, _chunkBytes - sizeof(TelemetryChunkHeader) - used);
+    _header.dataCrc = ~_crc;
+    _header.crc = telemetryHeaderCrc(&_header, sizeof(_header));
+    memcpy(base, &_header, sizeof(_header));
+
+    chunk->data = _buffers[_current];
+    chunk->length = headerBytes + _chunkBytes;
+    chunk->fileIndex = _fileIndex;
+    chunk->chunkIndex = _header.chunkIndex;
+    chunk->buffer = (uint8_t)_current;
+
+    _stats.chunks++;
+    _stats.bytes += chunk->length;
+    _current = -1;
+    if (_nextChunk >= _fileChunks) {
+        _fileOpen = false;
+    }
+}
+
+void TelemetryWriter::release(uint8_t buffer) {
+    if (buffer < _count && _busy[buffer] && (int32_t)buffer != _current) {
+        _busy[buffer] = false;
+        _stats.buffersInUse--;
+    }
+}
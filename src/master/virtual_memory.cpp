@@ -3,31 +3,68 @@
 #if VIRTUAL_MEMORY
 
 #include "master/virtual_memory.h"
-#include "master/sd_handler.h"
-#include <Arduino.h>
-#include <esp_heap_caps.h>
+#include "master/vmem_backend.h"
+#include <string.h>
+#include <stdlib.h>
 
 // Global instance
 VirtualMemory vmem;
 
+// Context of the claimSlot() eviction filter
+typedef struct {
+    const VMemPage* slots;
+    const int32_t* skipped;
+    uint32_t skipCount;
+} VMemVictimFilter;
+
+// Count an event against the calling task
+#define VMEM_STAT(field, n)     VMEM_ATOMIC_ADD(&taskStats()->field, (uint32_t)(n))
+
+// VMemStats is a block of uint32_t counters
+#define VMEM_STAT_WORDS         (sizeof(VMemStats) / sizeof(uint32_t))
+
 // =============================================================================
 // Constructor / Destructor
 // =============================================================================
 
-VirtualMemory::VirtualMemory()
+template <class Policy>
+VirtualMemoryT<Policy>::VirtualMemoryT()
     : _initialized(false)
     , _totalSize(0)
     , _cacheSize(0)
     , _maxCachePages(0)
     , _totalPages(0)
-    , _pageTable(nullptr)
+    , _pageSize(VMEM_PAGE_SIZE)
+    , _pageShift(0)
+    , _sectorsPerPage(VMEM_SECTORS_PER_PAGE)
+    , _shardSize(0)
+    , _pageDir(nullptr)
+    , _pageDirSize(0)
+    , _pageLeaves(0)
+    , _leafShift(0)
+    , _stripeShift(0)
+    , _pageMap(nullptr)
+    , _pageMapCopy(nullptr)
+    , _pageMapDirty(false)
     , _cacheSlots(nullptr)
     , _cacheBuffer(nullptr)
+#ifdef ARDUINO
+    , _storage(vmemSdStorage())
+    , _allocator(vmemPsramAllocator())
+#else
+    , _storage(nullptr)
+    , _allocator(nullptr)
+#endif
+    , _pagesLoaded(0)
+    , _pinnedPages(0)
+    , _traceHook(nullptr)
+    , _traceUserData(nullptr)
 {
-    memset(&_stats, 0, sizeof(_stats));
+    memset(_taskStats, 0, sizeof(_taskStats));
 }
 
-VirtualMemory::~VirtualMemory() {
+template <class Policy>
+VirtualMemoryT<Policy>::~VirtualMemoryT() {
     shutdown();
 }
 
@@ -35,52 +72,121 @@ VirtualMemory::~VirtualMemory() {
 // Initialization
 // =============================================================================
 
-bool VirtualMemory::init(uint32_t totalSize) {
+template <class Policy>
+void VirtualMemoryT<Policy>::setBackend(VMemStorage* storage, VMemAllocator* allocator) {
+    if (_initialized) {
+        VMEM_LOG("VMEM: Cannot change backend while initialized\n");
+        return;
+    }
+    _storage = storage;
+    _allocator = allocator;
+}
+
+template <class Policy>
+bool VirtualMemoryT<Policy>::init(uint32_t totalSize, uint32_t cacheSize, uint32_t tierSize) {
+    VMemGeometry geometry = vmemDefaultGeometry();
+    geometry.totalSize = totalSize;
+    geometry.cacheSize = cacheSize;
+    geometry.tierSize = tierSize;
+    return init(geometry);
+}
+
+template <class Policy>
+bool VirtualMemoryT<Policy>::init(const VMemGeometry& geometry) {
     if (_initialized) {
-        Serial.println("VMEM: Already initialized");
+        VMEM_LOG("VMEM: Already initialized\n");
         return true;
     }
 
+    if (!_storage || !_allocator) {
+        VMEM_LOG("VMEM: No backend configured\n");
+        return false;
+    }
+
+    uint32_t totalSize = geometry.totalSize;
+    uint32_t pageSize = geometry.pageSize;
+    uint32_t cacheSize = geometry.cacheSize;
+    uint32_t tierSize = geometry.tierSize;
+
+    // Validate geometry: whole pages everywhere, slot numbers fit the table
+    if (pageSize < VMEM_MIN_PAGE_SIZE || pageSize > VMEM_MAX_PAGE_SIZE ||
+        (pageSize & (pageSize - 1)) != 0) {
+        VMEM_LOG("VMEM: Invalid page size %lu\n", pageSize);
+        return false;
+    }
+    if (totalSize < pageSize || totalSize % pageSize != 0 ||
+        cacheSize < pageSize || cacheSize / pageSize >= VMEM_PT_NONE ||
+        geometry.shardSize % pageSize != 0) {
+        VMEM_LOG("VMEM: Invalid geometry (%lu total, %lu cache, %lu shard, %lu page)\n",
+                 totalSize, cacheSize, geometry.shardSize, pageSize);
+        return false;
+    }
+
     // Check SD card is ready
-    if (!sdIsReady()) {
-        Serial.println("VMEM: SD card not ready");
+    if (!_storage->isReady()) {
+        VMEM_LOG("VMEM: SD card not ready\n");
         return false;
     }
 
-    // Check PSRAM is available
-    size_t psramFree = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
-    if (psramFree < VMEM_CACHE_SIZE) {
-        Serial.printf("VMEM: Insufficient PSRAM (need %lu, have %zu)\n",
-                      VMEM_CACHE_SIZE, psramFree);
+    // Check PSRAM is available (durable mode adds its checksum table)
+    uint32_t journalBytes = geometry.journalSize > 0
+        ? (totalSize / pageSize) * sizeof(VMemPageMeta) + VMEM_JOURNAL_BLOCK + pageSize : 0;
+    size_t psramFree = _allocator->freeBytes();
+    if (psramFree < cacheSize + tierSize + journalBytes) {
+        VMEM_LOG("VMEM: Insufficient PSRAM (need %lu, have %zu)\n",
+                 cacheSize + tierSize + journalBytes, psramFree);
         return false;
     }
 
+    _pageSize = pageSize;
+    _pageShift = 0;
+    while ((1UL << _pageShift) < pageSize) {
+        _pageShift++;
+    }
+    _sectorsPerPage = pageSize / VMEM_SECTOR_SIZE;
+    _shardSize = geometry.shardSize;
     _totalSize = totalSize;
-    _totalPages = totalSize / VMEM_PAGE_SIZE;
-    _cacheSize = VMEM_CACHE_SIZE;
-    _maxCachePages = _cacheSize / VMEM_PAGE_SIZE;
-
-    Serial.printf("VMEM: Initializing %lu MB virtual memory\n", totalSize / (1024 * 1024));
-    Serial.printf("VMEM: Page size: %d bytes, Total pages: %lu, Cache pages: %lu\n",
-                  VMEM_PAGE_SIZE, _totalPages, _maxCachePages);
-
-    // Allocate page table (maps virtual page -> cache slot, -1 if not cached)
-    _pageTable = (int32_t*)calloc(_totalPages, sizeof(int32_t));
-    if (!_pageTable) {
-        Serial.println("VMEM: Failed to allocate page table");
+    _totalPages = totalSize >> _pageShift;
+    _cacheSize = cacheSize - cacheSize % pageSize;
+    _maxCachePages = _cacheSize >> _pageShift;
+
+    VMEM_LOG("VMEM: Initializing %lu MB virtual memory\n", totalSize / (1024 * 1024));
+    VMEM_LOG("VMEM: Page size: %lu bytes, Total pages: %lu, Cache pages: %lu\n",
+             _pageSize, _totalPages, _maxCachePages);
+
+    // Split the page table into at most VMEM_LOCK_STRIPES ranges of at
+    // least 8 pages, so page map bytes never span two stripes
+    _stripeShift = 3;
+    while (((_totalPages - 1) >> _stripeShift) >= VMEM_LOCK_STRIPES) {
+        _stripeShift++;
+    }
+
+    // Allocate page table directory; leaves (no larger than a stripe)
+    // come and go with the pages cached in them
+    _leafShift = _stripeShift < VMEM_PT_LEAF_BITS ? _stripeShift : VMEM_PT_LEAF_BITS;
+    _pageDirSize = ((_totalPages - 1) >> _leafShift) + 1;
+    _pageDir = (uint16_t**)calloc(_pageDirSize, sizeof(uint16_t*));
+    _pageLeaves = 0;
+    if (!_pageDir) {
+        VMEM_LOG("VMEM: Failed to allocate page table\n");
         return false;
     }
-    // Initialize all entries to -1 (not cached)
-    for (uint32_t i = 0; i < _totalPages; i++) {
-        _pageTable[i] = -1;
+
+    // Allocate materialised page bitmap
+    size_t mapBytes = (_totalPages + 7) / 8;
+    _pageMap = (uint8_t*)calloc(mapBytes, 1);
+    _pageMapCopy = (uint8_t*)calloc(mapBytes, 1);
+    if (!_pageMap || !_pageMapCopy) {
+        VMEM_LOG("VMEM: Failed to allocate page map\n");
+        releaseBuffers();
+        return false;
     }
 
     // Allocate cache slot descriptors
     _cacheSlots = (VMemPage*)calloc(_maxCachePages, sizeof(VMemPage));
     if (!_cacheSlots) {
-        Serial.println("VMEM: Failed to allocate cache slots");
-        free(_pageTable);
-        _pageTable = nullptr;
+        VMEM_LOG("VMEM: Failed to allocate cache slots\n");
+        releaseBuffers();
         return false;
     }
 
@@ -88,102 +194,152 @@ bool VirtualMemory::init(uint32_t totalSize) {
     for (uint32_t i = 0; i < _maxCachePages; i++) {
         _cacheSlots[i].virtualPage = 0xFFFFFFFF;  // Unused marker
         _cacheSlots[i].cachePtr = nullptr;
-        _cacheSlots[i].lastAccess = 0;
-        _cacheSlots[i].dirty = false;
+        _cacheSlots[i].pinCount = 0;
         _cacheSlots[i].valid = false;
+        _cacheSlots[i].reserved = false;
+        clearDirty(_cacheSlots[i]);
+    }
+
+    // Replacement policy state (one entry per slot, 2Q/ARC ghost map in PSRAM)
+    if (!_policy.init(_allocator, _maxCachePages, _totalPages)) {
+        VMEM_LOG("VMEM: Failed to allocate %s policy state\n", Policy::name());
+        releaseBuffers();
+        return false;
     }
 
     // Allocate PSRAM cache buffer
-    _cacheBuffer = (uint8_t*)heap_caps_malloc(_cacheSize, MALLOC_CAP_SPIRAM);
+    _cacheBuffer = (uint8_t*)_allocator->alloc(_cacheSize);
     if (!_cacheBuffer) {
-        Serial.println("VMEM: Failed to allocate PSRAM cache");
-        free(_cacheSlots);
-        free(_pageTable);
-        _cacheSlots = nullptr;
-        _pageTable = nullptr;
+        VMEM_LOG("VMEM: Failed to allocate PSRAM cache\n");
+        releaseBuffers();
         return false;
     }
 
     // Assign cache pointers to slots
     for (uint32_t i = 0; i < _maxCachePages; i++) {
-        _cacheSlots[i].cachePtr = _cacheBuffer + (i * VMEM_PAGE_SIZE);
+        _cacheSlots[i].cachePtr = _cacheBuffer + (i * _pageSize);
     }
 
     // Create or verify swap file
-    int32_t swapSize = sdFileSize(VMEM_SWAP_FILE);
-    if (swapSize < 0 || (uint32_t)swapSize < totalSize) {
-        Serial.printf("VMEM: Creating swap file (%lu MB)...\n", totalSize / (1024 * 1024));
-        if (!sdCreateSparseFile(VMEM_SWAP_FILE, totalSize)) {
-            Serial.println("VMEM: Failed to create swap file");
-            heap_caps_free(_cacheBuffer);
-            free(_cacheSlots);
-            free(_pageTable);
-            _cacheBuffer = nullptr;
-            _cacheSlots = nullptr;
-            _pageTable = nullptr;
+    _storage->setShardSize(_shardSize);
+    int64_t swapSize = _storage->size();
+    if (swapSize < 0 || (uint64_t)swapSize < totalSize) {
+        // No zero-fill needed - every page starts out unmaterialised
+        VMEM_LOG("VMEM: Creating swap file (%lu MB)...\n", totalSize / (1024 * 1024));
+        if (!_storage->create(totalSize) || !_storage->saveMap(_pageMap, mapBytes)) {
+            VMEM_LOG("VMEM: Failed to create swap file\n");
+            releaseBuffers();
             return false;
         }
-        Serial.println("VMEM: Swap file created");
+        VMEM_LOG("VMEM: Swap file created\n");
+    } else if (_storage->loadMap(_pageMap, mapBytes)) {
+        uint32_t materialised = 0;
+        for (uint32_t i = 0; i < _totalPages; i++) {
+            if (isMaterialised(i)) materialised++;
+        }
+        VMEM_LOG("VMEM: Using existing swap file (%d MB, %lu pages written)\n",
+                 (int)(swapSize / (1024 * 1024)), materialised);
     } else {
-        Serial.printf("VMEM: Using existing swap file (%d MB)\n", swapSize / (1024 * 1024));
+        // Swap files from before the page map were zero-filled at creation,
+        // so every page on the card holds valid data
+        VMEM_LOG("VMEM: Using existing swap file (%d MB, no page map)\n",
+                 (int)(swapSize / (1024 * 1024)));
+        memset(_pageMap, 0xFF, mapBytes);
+        _pageMapDirty = true;
+    }
+
+    if (_shardSize > 0) {
+        VMEM_LOG("VMEM: Swap split into %lu files of %lu MB\n",
+                 (totalSize + _shardSize - 1) / _shardSize, _shardSize / (1024 * 1024));
+    }
+
+    // Durable mode: finish any write-backs cut short by a power loss, then
+    // start a fresh journal epoch
+    if (geometry.journalSize > 0) {
+        if (!_journal.init(_storage, _allocator, _totalPages, _pageSize, geometry.journalSize)) {
+            VMEM_LOG("VMEM: Failed to set up journal (%lu KB)\n", geometry.journalSize / 1024);
+            releaseBuffers();
+            return false;
+        }
+        if (!_journal.recover(journalReplayed, this) || !savePageMap() || !_journal.checkpoint()) {
+            VMEM_LOG("VMEM: Journal recovery failed\n");
+            releaseBuffers();
+            return false;
+        }
+        const VMemRecovery& recovery = _journal.recovery();
+        VMEM_LOG("VMEM: Journal %lu KB - recovered %lu records (%lu pages redone, %lu KB read%s) in %lu us\n",
+                 geometry.journalSize / 1024, recovery.records, recovery.pages,
+                 recovery.bytesRead / 1024, recovery.torn ? ", last record torn" : "",
+                 recovery.timeUs);
+    }
+
+    // Compressed tier is optional - run without it if the pool does not fit
+    if (tierSize > 0) {
+        if (_tier.init(_allocator, tierSize, _totalPages, _pageSize)) {
+            VMEM_LOG("VMEM: Compressed tier %lu KB\n", _tier.capacity() / 1024);
+        } else {
+            VMEM_LOG("VMEM: Failed to allocate compressed tier, continuing without\n");
+        }
     }
 
-    _stats.maxPages = _maxCachePages;
+    // Fresh statistics; the last entry collects tasks beyond the table
+    memset(_taskStats, 0, sizeof(_taskStats));
+    _taskStats[VMEM_MAX_TASK_STATS - 1].taskId = UINTPTR_MAX;
+    strncpy(_taskStats[VMEM_MAX_TASK_STATS - 1].name, "(other)",
+            sizeof(_taskStats[0].name) - 1);
+    _pagesLoaded = 0;
+    _pinnedPages = 0;
+
     _initialized = true;
 
-    Serial.printf("VMEM: Ready - %lu MB virtual, %lu MB cache (%lu pages)\n",
-                  _totalSize / (1024 * 1024),
-                  _cacheSize / (1024 * 1024),
-                  _maxCachePages);
+    VMEM_LOG("VMEM: Ready - %lu MB virtual, %lu MB cache (%lu pages), %lu lock stripes, %s\n",
+             _totalSize / (1024 * 1024),
+             _cacheSize / (1024 * 1024),
+             _maxCachePages,
+             ((_totalPages - 1) >> _stripeShift) + 1,
+             Policy::name());
 
     return true;
 }
 
-void VirtualMemory::shutdown() {
+template <class Policy>
+void VirtualMemoryT<Policy>::shutdown() {
     if (!_initialized) return;
 
-    Serial.println("VMEM: Shutting down...");
+    VMEM_LOG("VMEM: Shutting down...\n");
 
     // Flush all dirty pages
     flush();
 
     // Free resources
-    if (_cacheBuffer) {
-        heap_caps_free(_cacheBuffer);
-        _cacheBuffer = nullptr;
-    }
-    if (_cacheSlots) {
-        free(_cacheSlots);
-        _cacheSlots = nullptr;
-    }
-    if (_pageTable) {
-        free(_pageTable);
-        _pageTable = nullptr;
-    }
+    releaseBuffers();
 
     _initialized = false;
-    Serial.println("VMEM: Shutdown complete");
+    VMEM_LOG("VMEM: Shutdown complete\n");
 }
 
 // =============================================================================
 // Memory Operations
 // =============================================================================
 
-int32_t VirtualMemory::read(uint32_t vaddr, void* buffer, size_t length) {
+template <class Policy>
+int32_t VirtualMemoryT<Policy>::read(uint32_t vaddr, void* buffer, size_t length) {
     if (!_initialized || buffer == nullptr) return -1;
     if (vaddr + length > _totalSize) return -1;
+    if (_traceHook) _traceHook(vaddr, length, false, _traceUserData);
 
     uint8_t* dst = (uint8_t*)buffer;
     size_t remaining = length;
     uint32_t currentAddr = vaddr;
 
     while (remaining > 0) {
-        uint32_t pageNum = currentAddr / VMEM_PAGE_SIZE;
-        uint32_t pageOffset = currentAddr % VMEM_PAGE_SIZE;
-        size_t bytesInPage = VMEM_PAGE_SIZE - pageOffset;
+        uint32_t pageNum = currentAddr >> _pageShift;
+        uint32_t pageOffset = (currentAddr & (_pageSize - 1));
+        size_t bytesInPage = _pageSize - pageOffset;
         if (bytesInPage > remaining) bytesInPage = remaining;
 
         // Get page pointer (loads from SD if needed)
+        VMemLockGuard guard(stripeLock(pageNum));
         uint8_t* pagePtr = getPagePtr(pageNum);
         if (!pagePtr) {
             return -1;  // Page fault failed
@@ -200,33 +356,33 @@ int32_t VirtualMemory::read(uint32_t vaddr, void* buffer, size_t length) {
     return (int32_t)length;
 }
 
-int32_t VirtualMemory::write(uint32_t vaddr, const void* data, size_t length) {
+template <class Policy>
+int32_t VirtualMemoryT<Policy>::write(uint32_t vaddr, const void* data, size_t length) {
     if (!_initialized || data == nullptr) return -1;
     if (vaddr + length > _totalSize) return -1;
+    if (_traceHook) _traceHook(vaddr, length, true, _traceUserData);
 
     const uint8_t* src = (const uint8_t*)data;
     size_t remaining = length;
     uint32_t currentAddr = vaddr;
 
     while (remaining > 0) {
-        uint32_t pageNum = currentAddr / VMEM_PAGE_SIZE;
-        uint32_t pageOffset = currentAddr % VMEM_PAGE_SIZE;
-        size_t bytesInPage = VMEM_PAGE_SIZE - pageOffset;
+        uint32_t pageNum = currentAddr >> _pageShift;
+        uint32_t pageOffset = (currentAddr & (_pageSize - 1));
+        size_t bytesInPage = _pageSize - pageOffset;
         if (bytesInPage > remaining) bytesInPage = remaining;
 
         // Get page pointer (loads from SD if needed)
+        VMemLockGuard guard(stripeLock(pageNum));
         uint8_t* pagePtr = getPagePtr(pageNum);
         if (!pagePtr) {
             return -1;  // Page fault failed
         }
 
-        // Copy data and mark dirty
+        // Copy data and mark the touched sectors dirty
         memcpy(pagePtr + pageOffset, src, bytesInPage);
 
-        int32_t slot = _pageTable[pageNum];
-        if (slot >= 0) {
-            _cacheSlots[slot].dirty = true;
-        }
+        markDirty(slotOf(pageNum), pageOffset, bytesInPage);
 
         src += bytesInPage;
         currentAddr += bytesInPage;
@@ -236,19 +392,41 @@ int32_t VirtualMemory::write(uint32_t vaddr, const void* data, size_t length) {
     return (int32_t)length;
 }
 
-bool VirtualMemory::zero(uint32_t vaddr, size_t length) {
+template <class Policy>
+bool VirtualMemoryT<Policy>::zero(uint32_t vaddr, size_t length) {
     if (!_initialized) return false;
     if (vaddr + length > _totalSize) return false;
+    if (_traceHook) _traceHook(vaddr, length, true, _traceUserData);
 
     size_t remaining = length;
     uint32_t currentAddr = vaddr;
 
     while (remaining > 0) {
-        uint32_t pageNum = currentAddr / VMEM_PAGE_SIZE;
-        uint32_t pageOffset = currentAddr % VMEM_PAGE_SIZE;
-        size_t bytesInPage = VMEM_PAGE_SIZE - pageOffset;
+        uint32_t pageNum = currentAddr >> _pageShift;
+        uint32_t pageOffset = (currentAddr & (_pageSize - 1));
+        size_t bytesInPage = _pageSize - pageOffset;
         if (bytesInPage > remaining) bytesInPage = remaining;
 
+        VMemLockGuard guard(stripeLock(pageNum));
+
+        // Whole page - forget it was ever written, no SD access needed
+        if (bytesInPage == _pageSize) {
+            if (_tier.isEnabled()) {
+                VMemLockGuard tierGuard(_tierLock);
+                _tier.drop(pageNum);
+            }
+            setMaterialised(pageNum, false);
+            int32_t slot = slotOf(pageNum);
+            if (slot >= 0) {
+                memset(_cacheSlots[slot].cachePtr, 0, _pageSize);
+                clearDirty(_cacheSlots[slot]);
+                touchPage(slot);
+            }
+            currentAddr += bytesInPage;
+            remaining -= bytesInPage;
+            continue;
+        }
+
         // Get page pointer
         uint8_t* pagePtr = getPagePtr(pageNum);
         if (!pagePtr) return false;
@@ -256,10 +434,7 @@ bool VirtualMemory::zero(uint32_t vaddr, size_t length) {
         // Zero the region
         memset(pagePtr + pageOffset, 0, bytesInPage);
 
-        int32_t slot = _pageTable[pageNum];
-        if (slot >= 0) {
-            _cacheSlots[slot].dirty = true;
-        }
+        markDirty(slotOf(pageNum), pageOffset, bytesInPage);
 
         currentAddr += bytesInPage;
         remaining -= bytesInPage;
@@ -268,49 +443,181 @@ bool VirtualMemory::zero(uint32_t vaddr, size_t length) {
     return true;
 }
 
+// =============================================================================
+// Zero-Copy Mapping
+// =============================================================================
+
+template <class Policy>
+void* VirtualMemoryT<Policy>::map(uint32_t vaddr, size_t length, VMemMapMode mode) {
+    if (!_initialized || length == 0) return nullptr;
+    if (vaddr + length > _totalSize) return nullptr;
+    if (_traceHook) _traceHook(vaddr, length, mode == VMEM_MAP_WRITE, _traceUserData);
+
+    uint32_t firstPage = vaddr >> _pageShift;
+    uint32_t lastPage = (vaddr + length - 1) >> _pageShift;
+    uint32_t count = lastPage - firstPage + 1;
+
+    int32_t startSlot;
+    if (count == 1) {
+        // Single page - regular page fault path
+        stripeLock(firstPage).lock();
+        startSlot = getPagePtr(firstPage) ? slotOf(firstPage) : -1;
+    } else {
+        // Moving pages between slots touches every stripe
+        lockAll();
+        _replacementLock.lock();
+        startSlot = mapContiguous(firstPage, count);
+        _replacementLock.unlock();
+        if (startSlot < 0) {
+            VMEM_LOG("VMEM: Cannot map %lu contiguous pages at page %lu\n",
+                     count, firstPage);
+        }
+    }
+
+    // Pin every page in the span
+    if (startSlot >= 0) {
+        for (uint32_t i = 0; i < count; i++) {
+            VMemPage& page = _cacheSlots[startSlot + i];
+            if (page.pinCount == 0) {
+                VMEM_ATOMIC_ADD(&_pinnedPages, 1);
+            }
+            VMEM_ATOMIC_STORE(&page.pinCount, (uint16_t)(page.pinCount + 1));
+        }
+    }
+
+    if (count == 1) {
+        stripeLock(firstPage).unlock();
+    } else {
+        unlockAll();
+    }
+
+    // Dirty marking happens on unmap
+    if (startSlot < 0) return nullptr;
+    return _cacheSlots[startSlot].cachePtr + ((vaddr & (_pageSize - 1)));
+}
+
+template <class Policy>
+bool VirtualMemoryT<Policy>::unmap(uint32_t vaddr, size_t length, VMemMapMode mode) {
+    if (!_initialized || length == 0) return false;
+    if (vaddr + length > _totalSize) return false;
+
+    uint32_t firstPage = vaddr >> _pageShift;
+    uint32_t lastPage = (vaddr + length - 1) >> _pageShift;
+    uint32_t endAddr = vaddr + length;
+    bool ok = true;
+
+    for (uint32_t pageNum = firstPage; pageNum <= lastPage; pageNum++) {
+        VMemLockGuard guard(stripeLock(pageNum));
+        int32_t slot = slotOf(pageNum);
+        if (slot < 0 || _cacheSlots[slot].pinCount == 0) {
+            VMEM_LOG("VMEM: unmap of page %lu that is not mapped\n", pageNum);
+            ok = false;
+            continue;
+        }
+
+        VMemPage& page = _cacheSlots[slot];
+        if (mode == VMEM_MAP_WRITE) {
+            // Only the mapped part of the page can have changed
+            uint32_t pageStart = pageNum * _pageSize;
+            uint32_t from = vaddr > pageStart ? vaddr - pageStart : 0;
+            uint32_t to = endAddr < pageStart + _pageSize ? endAddr - pageStart : _pageSize;
+            markDirty(slot, from, to - from);
+        }
+        VMEM_ATOMIC_STORE(&page.pinCount, (uint16_t)(page.pinCount - 1));
+        if (page.pinCount == 0) {
+            VMEM_ATOMIC_SUB(&_pinnedPages, 1);
+        }
+        touchPage(slot);
+    }
+
+    return ok;
+}
+
 // =============================================================================
 // Cache Control
 // =============================================================================
 
-bool VirtualMemory::flush() {
+template <class Policy>
+bool VirtualMemoryT<Policy>::flush() {
     if (!_initialized) return false;
 
     uint32_t flushed = 0;
+    bool ok = true;
     for (uint32_t i = 0; i < _maxCachePages; i++) {
-        if (_cacheSlots[i].valid && _cacheSlots[i].dirty) {
+        // Slot ownership is read under the replacement lock, the page itself
+        // is written back under its stripe lock
+        uint32_t virtualPage = 0;
+        _replacementLock.lock();
+        bool cached = !_cacheSlots[i].reserved && _cacheSlots[i].valid;
+        if (cached) virtualPage = _cacheSlots[i].virtualPage;
+        _replacementLock.unlock();
+        if (!cached) continue;
+
+        VMemLockGuard guard(stripeLock(virtualPage));
+        if (slotOf(virtualPage) == (int32_t)i && _cacheSlots[i].dirty) {
             if (writeBackPage(i)) {
                 flushed++;
+            } else {
+                ok = false;
             }
         }
     }
 
+    // Pages living only in the compressed tier
+    if (_tier.isEnabled()) {
+        VMemLockGuard guard(_tierLock);
+        int32_t written = _tier.flush(0, _totalPages - 1, tierWriteBack, this);
+        if (written < 0) {
+            ok = false;
+        } else {
+            flushed += written;
+        }
+    }
+
     if (flushed > 0) {
-        Serial.printf("VMEM: Flushed %lu dirty pages\n", flushed);
+        VMEM_LOG("VMEM: Flushed %lu dirty pages\n", flushed);
     }
-    return true;
+
+    // Durable mode: the checkpoint saves the page map along with the
+    // checksum table, so recovery after a clean flush reads nothing
+    if (_journal.isEnabled()) {
+        VMemLockGuard guard(_journalLock);
+        return checkpointJournal() && ok;
+    }
+    // Page data first, so the saved map never lists a page still buffered
+    return _storage->sync() && savePageMap() && ok;
 }
 
-bool VirtualMemory::flushRange(uint32_t vaddr, size_t length) {
+template <class Policy>
+bool VirtualMemoryT<Policy>::flushRange(uint32_t vaddr, size_t length) {
     if (!_initialized) return false;
 
-    uint32_t startPage = vaddr / VMEM_PAGE_SIZE;
-    uint32_t endPage = (vaddr + length - 1) / VMEM_PAGE_SIZE;
+    uint32_t startPage = vaddr >> _pageShift;
+    uint32_t endPage = (vaddr + length - 1) >> _pageShift;
 
+    bool ok = true;
     for (uint32_t pageNum = startPage; pageNum <= endPage && pageNum < _totalPages; pageNum++) {
-        int32_t slot = _pageTable[pageNum];
-        if (slot >= 0 && _cacheSlots[slot].dirty) {
-            writeBackPage(slot);
+        VMemLockGuard guard(stripeLock(pageNum));
+        int32_t slot = slotOf(pageNum);
+        if (slot >= 0 && _cacheSlots[slot].dirty && !writeBackPage(slot)) {
+            ok = false;
         }
     }
 
-    return true;
+    if (_tier.isEnabled()) {
+        VMemLockGuard guard(_tierLock);
+        ok = _tier.flush(startPage, endPage, tierWriteBack, this) >= 0 && ok;
+    }
+
+    return _storage->sync() && savePageMap() && ok;
 }
 
-void VirtualMemory::prefetch(uint32_t vaddr, size_t length) {
+template <class Policy>
+void VirtualMemoryT<Policy>::prefetch(uint32_t vaddr, size_t length) {
     if (!_initialized) return;
 
-    uint32_t startPage = vaddr / VMEM_PAGE_SIZE;
-    uint32_t endPage = (vaddr + length - 1) / VMEM_PAGE_SIZE;
+    uint32_t startPage = vaddr >> _pageShift;
+    uint32_t endPage = (vaddr + length - 1) >> _pageShift;
 
     // Prefetch up to a reasonable number of pages
     uint32_t maxPrefetch = 8;
@@ -319,204 +626,920 @@ void VirtualMemory::prefetch(uint32_t vaddr, size_t length) {
     for (uint32_t pageNum = startPage;
          pageNum <= endPage && pageNum < _totalPages && prefetched < maxPrefetch;
          pageNum++) {
-        if (_pageTable[pageNum] < 0) {
+        VMemLockGuard guard(stripeLock(pageNum));
+        if (slotOf(pageNum) < 0) {
             // Page not in cache, load it
-            loadPage(pageNum);
+            getPagePtr(pageNum);
             prefetched++;
         }
     }
 }
 
-void VirtualMemory::invalidate() {
+template <class Policy>
+void VirtualMemoryT<Policy>::invalidate() {
     if (!_initialized) return;
 
+    lockAll();
+    _replacementLock.lock();
+
     // Mark all cache slots as invalid (discards dirty data!)
+    // Pinned pages are kept - a mapping still points at them
     for (uint32_t i = 0; i < _maxCachePages; i++) {
-        if (_cacheSlots[i].valid) {
+        if (_cacheSlots[i].valid && _cacheSlots[i].pinCount == 0) {
             uint32_t vpage = _cacheSlots[i].virtualPage;
             if (vpage < _totalPages) {
-                _pageTable[vpage] = -1;
+                setSlotOf(vpage, -1);
             }
             _cacheSlots[i].valid = false;
-            _cacheSlots[i].dirty = false;
             _cacheSlots[i].virtualPage = 0xFFFFFFFF;
+            clearDirty(_cacheSlots[i]);
+            _policy.remove(i, false);
+            VMEM_ATOMIC_SUB(&_pagesLoaded, 1);
         }
     }
-    _stats.pagesLoaded = 0;
+
+    if (_tier.isEnabled()) {
+        VMemLockGuard guard(_tierLock);
+        _tier.clear();
+    }
+
+    _replacementLock.unlock();
+    unlockAll();
 }
 
 // =============================================================================
 // Statistics
 // =============================================================================
 
-void VirtualMemory::resetStats() {
-    _stats.hits = 0;
-    _stats.misses = 0;
-    _stats.evictions = 0;
-    _stats.writebacks = 0;
-    _stats.bytesRead = 0;
-    _stats.bytesWritten = 0;
-    // Keep pagesLoaded and maxPages
+template <class Policy>
+VMemStats VirtualMemoryT<Policy>::getStats() const {
+    VMemStats total;
+    memset(&total, 0, sizeof(total));
+
+    uint32_t* totalWords = (uint32_t*)&total;
+    for (uint32_t i = 0; i < VMEM_MAX_TASK_STATS; i++) {
+        const uint32_t* words = (const uint32_t*)&_taskStats[i].stats;
+        for (uint32_t w = 0; w < VMEM_STAT_WORDS; w++) {
+            totalWords[w] += VMEM_ATOMIC_LOAD(&words[w]);
+        }
+    }
+
+    total.pagesLoaded = VMEM_ATOMIC_LOAD(&_pagesLoaded);
+    total.maxPages = _maxCachePages;
+    total.pinnedPages = VMEM_ATOMIC_LOAD(&_pinnedPages);
+    if (_tier.isEnabled()) {
+        VMemLockGuard guard(_tierLock);
+        total.tierPages = _tier.pages();
+        total.tierBytes = _tier.bytes();
+    } else {
+        total.tierPages = 0;
+        total.tierBytes = 0;
+    }
+    return total;
 }
 
-float VirtualMemory::hitRate() const {
-    uint32_t total = _stats.hits + _stats.misses;
+template <class Policy>
+uint32_t VirtualMemoryT<Policy>::getTaskStats(VMemTaskStats* out, uint32_t maxEntries) const {
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < VMEM_MAX_TASK_STATS && count < maxEntries; i++) {
+        uintptr_t taskId = __atomic_load_n(&_taskStats[i].taskId, __ATOMIC_ACQUIRE);
+        if (taskId == 0) continue;
+
+        const uint32_t* words = (const uint32_t*)&_taskStats[i].stats;
+        uint32_t* outWords = (uint32_t*)&out[count].stats;
+        for (uint32_t w = 0; w < VMEM_STAT_WORDS; w++) {
+            outWords[w] = VMEM_ATOMIC_LOAD(&words[w]);
+        }
+        if (i == VMEM_MAX_TASK_STATS - 1 && out[count].stats.hits + out[count].stats.misses == 0) {
+            continue;  // Overflow entry never used
+        }
+        out[count].taskId = taskId;
+        memcpy(out[count].name, _taskStats[i].name, sizeof(out[count].name));
+        count++;
+    }
+    return count;
+}
+
+template <class Policy>
+void VirtualMemoryT<Policy>::resetStats() {
+    // Zero every task's counters; gauges (pagesLoaded, maxPages,
+    // pinnedPages, tierPages, tierBytes) are kept outside the per-task blocks
+    for (uint32_t i = 0; i < VMEM_MAX_TASK_STATS; i++) {
+        uint32_t* words = (uint32_t*)&_taskStats[i].stats;
+        for (uint32_t w = 0; w < VMEM_STAT_WORDS; w++) {
+            VMEM_ATOMIC_STORE(&words[w], 0);
+        }
+    }
+}
+
+template <class Policy>
+float VirtualMemoryT<Policy>::hitRate() const {
+    VMemStats stats = getStats();
+    uint32_t total = stats.hits + stats.misses;
     if (total == 0) return 1.0f;
-    return (float)_stats.hits / (float)total;
+    return (float)stats.hits / (float)total;
+}
+
+template <class Policy>
+void VirtualMemoryT<Policy>::printStats() {
+    VMemStats stats = getStats();
+    VMEM_LOG("=== Virtual Memory Statistics ===\n");
+    VMEM_LOG("Cache hits:      %lu\n", stats.hits);
+    VMEM_LOG("Cache misses:    %lu\n", stats.misses);
+    VMEM_LOG("Hit rate:        %.1f%%\n", hitRate() * 100.0f);
+    VMEM_LOG("Policy:          %s (%lu ghost hits)\n", Policy::name(), stats.ghostHits);
+    VMEM_LOG("Zero-fill faults:%lu\n", stats.zeroFills);
+    VMEM_LOG("Pages loaded:    %lu / %lu (%lu B pages)\n", stats.pagesLoaded, stats.maxPages,
+             _pageSize);
+    VMEM_LOG("Page table:      %lu bytes\n", getPageTableBytes());
+    VMEM_LOG("Pages pinned:    %lu\n", stats.pinnedPages);
+    VMEM_LOG("Evictions:       %lu\n", stats.evictions);
+    VMEM_LOG("Write-backs:     %lu\n", stats.writebacks);
+    VMEM_LOG("Relocations:     %lu\n", stats.relocations);
+    VMEM_LOG("SD bytes read:   %lu KB\n", stats.bytesRead / 1024);
+    VMEM_LOG("SD bytes written:%lu KB\n", stats.bytesWritten / 1024);
+    VMEM_LOG("Write-back runs: %lu (%lu KB clean sectors skipped)\n",
+             stats.writeRuns, stats.bytesSaved / 1024);
+    if (_tier.isEnabled()) {
+        VMEM_LOG("Tier:            %lu pages in %lu / %lu KB\n",
+                 stats.tierPages, stats.tierBytes / 1024, _tier.capacity() / 1024);
+        VMEM_LOG("Tier hits:       %lu / %lu (%lu stored, %lu rejected, %lu evicted)\n",
+                 stats.tierHits, stats.tierHits + stats.tierMisses,
+                 stats.tierStores, stats.tierRejects, stats.tierEvictions);
+    }
+    if (_journal.isEnabled()) {
+        VMEM_LOG("Journal:         %lu records, %lu KB (%lu / %lu KB in use)\n",
+                 stats.journalRecords, stats.journalBytes / 1024,
+                 _journal.used() / 1024, _journal.capacity() / 1024);
+        VMEM_LOG("Checkpoints:     %lu (%lu checksum errors)\n",
+                 stats.checkpoints, stats.checksumErrors);
+    }
+
+    VMemTaskStats tasks[VMEM_MAX_TASK_STATS];
+    uint32_t taskCount = getTaskStats(tasks, VMEM_MAX_TASK_STATS);
+    for (uint32_t i = 0; i < taskCount; i++) {
+        const VMemStats& t = tasks[i].stats;
+        uint32_t lookups = t.hits + t.misses;
+        VMEM_LOG("  %-15s %lu hits, %lu misses (%.1f%%)\n",
+                 tasks[i].name, t.hits, t.misses,
+                 lookups ? 100.0f * t.hits / lookups : 100.0f);
+    }
+    VMEM_LOG("=================================\n");
 }
 
-void VirtualMemory::printStats() {
-    Serial.println("=== Virtual Memory Statistics ===");
-    Serial.printf("Cache hits:      %lu\n", _stats.hits);
-    Serial.printf("Cache misses:    %lu\n", _stats.misses);
-    Serial.printf("Hit rate:        %.1f%%\n", hitRate() * 100.0f);
-    Serial.printf("Pages loaded:    %lu / %lu\n", _stats.pagesLoaded, _stats.maxPages);
-    Serial.printf("Evictions:       %lu\n", _stats.evictions);
-    Serial.printf("Write-backs:     %lu\n", _stats.writebacks);
-    Serial.printf("SD bytes read:   %lu KB\n", _stats.bytesRead / 1024);
-    Serial.printf("SD bytes written:%lu KB\n", _stats.bytesWritten / 1024);
-    Serial.println("=================================");
+template <class Policy>
+void VirtualMemoryT<Policy>::setTraceHook(VMemTraceHook hook, void* userData) {
+    _traceHook = hook;
+    _traceUserData = userData;
 }
 
 // =============================================================================
 // Internal Helpers
 // =============================================================================
 
-int32_t VirtualMemory::findCacheSlot(uint32_t virtualPage) {
-    return _pageTable[virtualPage];
+template <class Policy>
+int32_t VirtualMemoryT<Policy>::findCacheSlot(uint32_t virtualPage) {
+    return slotOf(virtualPage);
+}
+
+// Make sure virtualPage has a page table leaf (all VMEM_PT_NONE when new).
+// A leaf never spans two stripes, so its directory entry and use count
+// are guarded by the same stripe lock as its pages.
+template <class Policy>
+bool VirtualMemoryT<Policy>::allocLeaf(uint32_t virtualPage) {
+    uint16_t*& leaf = _pageDir[virtualPage >> _leafShift];
+    if (leaf) return true;
+
+    uint32_t leafPages = 1UL << _leafShift;
+    leaf = (uint16_t*)malloc((leafPages + 1) * sizeof(uint16_t));
+    if (!leaf) return false;
+    memset(leaf, 0xFF, leafPages * sizeof(uint16_t));
+    leaf[leafPages] = 0;  // Cached pages in this leaf
+    VMEM_ATOMIC_ADD(&_pageLeaves, 1);
+    return true;
 }
 
-int32_t VirtualMemory::loadPage(uint32_t virtualPage) {
-    if (virtualPage >= _totalPages) return -1;
+// Free the leaf of virtualPage once none of its pages is cached
+template <class Policy>
+void VirtualMemoryT<Policy>::releaseLeaf(uint32_t virtualPage) {
+    uint16_t*& leaf = _pageDir[virtualPage >> _leafShift];
+    if (leaf && leaf[1UL << _leafShift] == 0) {
+        free(leaf);
+        leaf = nullptr;
+        VMEM_ATOMIC_SUB(&_pageLeaves, 1);
+    }
+}
 
-    // Find a free cache slot
-    int32_t slot = -1;
-    for (uint32_t i = 0; i < _maxCachePages; i++) {
-        if (!_cacheSlots[i].valid) {
-            slot = i;
-            break;
+template <class Policy>
+int32_t VirtualMemoryT<Policy>::slotOf(uint32_t virtualPage) {
+    // Caller holds the stripe lock of virtualPage
+    uint16_t* leaf = _pageDir[virtualPage >> _leafShift];
+    if (!leaf) return -1;
+    uint16_t slot = leaf[virtualPage & ((1UL << _leafShift) - 1)];
+    return slot == VMEM_PT_NONE ? -1 : (int32_t)slot;
+}
+
+template <class Policy>
+void VirtualMemoryT<Policy>::setSlotOf(uint32_t virtualPage, int32_t slot) {
+    // Caller holds the stripe lock of virtualPage; loadPageIntoSlot()
+    // allocates the leaf before a page is first cached
+    uint16_t* leaf = _pageDir[virtualPage >> _leafShift];
+    if (!leaf) return;
+    uint16_t& entry = leaf[virtualPage & ((1UL << _leafShift) - 1)];
+    uint16_t& used = leaf[1UL << _leafShift];
+    if (slot >= 0) {
+        if (entry == VMEM_PT_NONE) used++;
+        entry = (uint16_t)slot;
+    } else if (entry != VMEM_PT_NONE) {
+        entry = VMEM_PT_NONE;
+        used--;
+        releaseLeaf(virtualPage);
+    }
+}
+
+template <class Policy>
+uint32_t VirtualMemoryT<Policy>::getPageTableBytes() const {
+    return _pageDirSize * sizeof(uint16_t*) +
+           VMEM_ATOMIC_LOAD(&_pageLeaves) * ((1UL << _leafShift) + 1) * sizeof(uint16_t) +
+           _policy.mapBytes();
+}
+
+template <class Policy>
+VMemLock& VirtualMemoryT<Policy>::stripeLock(uint32_t virtualPage) {
+    return _stripeLocks[virtualPage >> _stripeShift];
+}
+
+template <class Policy>
+void VirtualMemoryT<Policy>::lockAll() {
+    // Never wait while holding some stripes: a page fault holding the
+    // missing stripe may need to evict a page from one we already hold
+    for (;;) {
+        uint32_t held = 0;
+        while (held < VMEM_LOCK_STRIPES && _stripeLocks[held].tryLock()) {
+            held++;
         }
+        if (held == VMEM_LOCK_STRIPES) return;
+
+        while (held > 0) {
+            _stripeLocks[--held].unlock();
+        }
+        vmemYield();
     }
+}
 
-    // No free slot, need to evict
-    if (slot < 0) {
-        slot = evictPage();
-        if (slot < 0) {
-            Serial.println("VMEM: Failed to evict page");
-            return -1;
+template <class Policy>
+void VirtualMemoryT<Policy>::unlockAll() {
+    for (uint32_t i = VMEM_LOCK_STRIPES; i > 0; i--) {
+        _stripeLocks[i - 1].unlock();
+    }
+}
+
+template <class Policy>
+VMemStats* VirtualMemoryT<Policy>::taskStats() {
+    uintptr_t taskId = vmemTaskId();
+    const uint32_t entries = VMEM_MAX_TASK_STATS - 1;
+
+    for (uint32_t i = 0; i < entries; i++) {
+        uintptr_t owner = __atomic_load_n(&_taskStats[i].taskId, __ATOMIC_ACQUIRE);
+        if (owner == taskId) return &_taskStats[i].stats;
+        if (owner == 0) break;
+    }
+
+    // First event from this task - claim an entry
+    VMemLockGuard guard(_statsLock);
+    for (uint32_t i = 0; i < entries; i++) {
+        VMemTaskStats& entry = _taskStats[i];
+        if (entry.taskId == taskId) return &entry.stats;
+        if (entry.taskId == 0) {
+            strncpy(entry.name, vmemTaskName(), sizeof(entry.name) - 1);
+            __atomic_store_n(&entry.taskId, taskId, __ATOMIC_RELEASE);
+            return &entry.stats;
+        }
+    }
+    return &_taskStats[entries].stats;
+}
+
+template <class Policy>
+int32_t VirtualMemoryT<Policy>::claimSlot(uint32_t virtualPage) {
+    // Caller holds the stripe lock of virtualPage. Returns a reserved slot
+    // that no longer holds a page, or -1 if every page is pinned.
+    const uint32_t heldStripe = virtualPage >> _stripeShift;
+    int32_t skipped[4];
+    uint32_t skipCount = 0;
+
+    for (;;) {
+        _replacementLock.lock();
+
+        // Prefer a free slot
+        for (uint32_t i = 0; i < _maxCachePages; i++) {
+            // Fields of a reserved slot belong to the task that claimed it
+            if (!_cacheSlots[i].reserved && !_cacheSlots[i].valid) {
+                _cacheSlots[i].reserved = true;
+                _replacementLock.unlock();
+                return i;
+            }
+        }
+
+        // Otherwise the policy's choice among pages that are not pinned,
+        // being loaded or recently found locked by another task
+        VMemVictimFilter filter = { _cacheSlots, skipped, skipCount };
+        int32_t victim = _policy.victim(virtualPage, slotEvictable, &filter);
+
+        if (victim < 0) {
+            bool busy = skipCount > 0;
+            for (uint32_t i = 0; i < _maxCachePages && !busy; i++) {
+                busy = _cacheSlots[i].reserved;
+            }
+            _replacementLock.unlock();
+            if (!busy) return -1;  // Every page is pinned
+
+            // Remaining candidates are in use by other tasks - retry
+            skipCount = 0;
+            vmemYield();
+            continue;
+        }
+
+        // The victim's page table entry belongs to its stripe. Blocking on
+        // it here could deadlock, so another task's stripe is only tried.
+        VMemPage& page = _cacheSlots[victim];
+        uint32_t victimStripe = page.virtualPage >> _stripeShift;
+        bool otherStripe = victimStripe != heldStripe;
+        if (otherStripe && !_stripeLocks[victimStripe].tryLock()) {
+            _replacementLock.unlock();
+            if (skipCount < 4) {
+                skipped[skipCount++] = victim;
+            } else {
+                skipCount = 0;
+                vmemYield();
+            }
+            continue;
         }
+
+        // Pinned between the scan and taking the lock
+        if (page.pinCount > 0) {
+            if (otherStripe) _stripeLocks[victimStripe].unlock();
+            _replacementLock.unlock();
+            continue;
+        }
+
+        page.reserved = true;
+        _replacementLock.unlock();
+
+        // Demote to the compressed tier, or write back if dirty (victim
+        // stripe stays locked, so nobody can fault the page back in before
+        // the new data is in the tier or on the card)
+        if (!demotePage(victim) && page.dirty) {
+            if (!writeBackPage(victim)) {
+                VMEM_LOG("VMEM: Write-back failed during eviction\n");
+                // Continue anyway - data loss, but don't deadlock
+            }
+        }
+
+        setSlotOf(page.virtualPage, -1);
+        _policy.remove(victim, true);
+        page.valid = false;
+        page.virtualPage = 0xFFFFFFFF;
+        clearDirty(page);
+        VMEM_ATOMIC_SUB(&_pagesLoaded, 1);
+        VMEM_STAT(evictions, 1);
+
+        if (otherStripe) _stripeLocks[victimStripe].unlock();
+        return victim;
+    }
+}
+
+template <class Policy>
+bool VirtualMemoryT<Policy>::slotEvictable(uint32_t slot, void* context) {
+    // Called by the policy with the replacement lock held
+    const VMemVictimFilter* filter = (const VMemVictimFilter*)context;
+    const VMemPage& page = filter->slots[slot];
+    if (page.reserved || !page.valid || VMEM_ATOMIC_LOAD(&page.pinCount) > 0) return false;
+    for (uint32_t k = 0; k < filter->skipCount; k++) {
+        if (filter->skipped[k] == (int32_t)slot) return false;
+    }
+    return true;
+}
+
+template <class Policy>
+bool VirtualMemoryT<Policy>::loadPageIntoSlot(uint32_t virtualPage, int32_t slot) {
+    VMemPage& page = _cacheSlots[slot];
+    bool fromTier = false;
+    bool tierDirty = false;
+    uint32_t tierSectors[VMEM_DIRTY_WORDS];
+
+    // Page table leaf before any data moves, so running out of memory
+    // here leaves the page where it was
+    if (!allocLeaf(virtualPage)) {
+        VMEM_LOG("VMEM: Failed to allocate page table leaf\n");
+        return false;
     }
 
-    // Read page from SD card
-    uint32_t fileOffset = virtualPage * VMEM_PAGE_SIZE;
-    int32_t bytesRead = sdReadFileAt(VMEM_SWAP_FILE, fileOffset,
-                                      _cacheSlots[slot].cachePtr, VMEM_PAGE_SIZE);
-    if (bytesRead < 0) {
-        Serial.printf("VMEM: Failed to read page %lu from SD\n", virtualPage);
-        return -1;
+    // Compressed tier first - it may hold data newer than the card
+    if (_tier.isEnabled()) {
+        VMemLockGuard guard(_tierLock);
+        fromTier = _tier.fetch(virtualPage, page.cachePtr, &tierDirty, tierSectors);
+        if (!fromTier) VMEM_STAT(tierMisses, 1);
+    }
+
+    if (fromTier) {
+        VMEM_STAT(tierHits, 1);
+    } else if (isMaterialised(virtualPage)) {
+        // Read page from SD card
+        uint32_t fileOffset = virtualPage * _pageSize;
+        int32_t bytesRead = _storage->readAt(fileOffset, _cacheSlots[slot].cachePtr, _pageSize);
+        if (bytesRead < 0) {
+            VMEM_LOG("VMEM: Failed to read page %lu from SD\n", virtualPage);
+            releaseLeaf(virtualPage);
+            return false;
+        }
+        VMEM_STAT(bytesRead, _pageSize);
+
+        // Durable mode: refuse a page that is not what was last written
+        if (_journal.isEnabled() && !_journal.verify(virtualPage, page.cachePtr)) {
+            VMEM_LOG("VMEM: Checksum mismatch on page %lu\n", virtualPage);
+            VMEM_STAT(checksumErrors, 1);
+            releaseLeaf(virtualPage);
+            return false;
+        }
+    } else {
+        // Never written - the swap holds no data for it yet
+        memset(_cacheSlots[slot].cachePtr, 0, _pageSize);
+        VMEM_STAT(zeroFills, 1);
     }
 
     // Update slot
-    _cacheSlots[slot].virtualPage = virtualPage;
-    _cacheSlots[slot].valid = true;
-    _cacheSlots[slot].dirty = false;
-    _cacheSlots[slot].lastAccess = millis();
+    page.virtualPage = virtualPage;
+    page.valid = true;
+    page.pinCount = 0;
+    clearDirty(page);
+    if (tierDirty) {
+        page.dirty = true;
+        memcpy(page.dirtySectors, tierSectors, sizeof(page.dirtySectors));
+    }
+    if (_policy.insert(slot, virtualPage)) {
+        VMEM_STAT(ghostHits, 1);
+    }
 
     // Update page table
-    _pageTable[virtualPage] = slot;
+    setSlotOf(virtualPage, slot);
 
     // Update stats
-    _stats.misses++;
-    _stats.pagesLoaded++;
-    _stats.bytesRead += VMEM_PAGE_SIZE;
+    VMEM_STAT(misses, 1);
+    VMEM_ATOMIC_ADD(&_pagesLoaded, 1);
 
-    return slot;
+    return true;
 }
 
-int32_t VirtualMemory::evictPage() {
-    // Find LRU (least recently used) page
-    int32_t lruSlot = -1;
-    uint32_t oldestTime = 0xFFFFFFFF;
+template <class Policy>
+bool VirtualMemoryT<Policy>::freeSlot(int32_t slot) {
+    VMemPage& page = _cacheSlots[slot];
+    if (!page.valid) return true;
+    if (page.pinCount > 0) return false;
 
-    for (uint32_t i = 0; i < _maxCachePages; i++) {
-        if (_cacheSlots[i].valid && _cacheSlots[i].lastAccess < oldestTime) {
-            oldestTime = _cacheSlots[i].lastAccess;
-            lruSlot = i;
+    // Demote to the compressed tier, or write back if dirty
+    if (!demotePage(slot) && page.dirty) {
+        if (!writeBackPage(slot)) {
+            VMEM_LOG("VMEM: Write-back failed during eviction\n");
+            // Continue anyway - data loss, but don't deadlock
         }
     }
 
-    if (lruSlot < 0) {
-        return -1;  // No valid pages to evict (shouldn't happen)
+    // Update page table to mark page as not cached
+    if (page.virtualPage < _totalPages) {
+        setSlotOf(page.virtualPage, -1);
     }
+    _policy.remove(slot, true);
 
-    // Write back if dirty
-    if (_cacheSlots[lruSlot].dirty) {
-        if (!writeBackPage(lruSlot)) {
-            Serial.println("VMEM: Write-back failed during eviction");
-            // Continue anyway - data loss, but don't deadlock
+    // Mark slot as free
+    page.valid = false;
+    page.virtualPage = 0xFFFFFFFF;
+    clearDirty(page);
+
+    VMEM_STAT(evictions, 1);
+    VMEM_ATOMIC_SUB(&_pagesLoaded, 1);
+
+    return true;
+}
+
+template <class Policy>
+void VirtualMemoryT<Policy>::moveSlot(int32_t from, int32_t to) {
+    // Move a cached page (data + state) into a free slot
+    VMemPage& src = _cacheSlots[from];
+    VMemPage& dst = _cacheSlots[to];
+
+    memcpy(dst.cachePtr, src.cachePtr, _pageSize);
+    dst.virtualPage = src.virtualPage;
+    dst.pinCount = 0;
+    dst.reserved = false;
+    dst.dirty = src.dirty;
+    memcpy(dst.dirtySectors, src.dirtySectors, sizeof(dst.dirtySectors));
+    dst.valid = true;
+    setSlotOf(dst.virtualPage, to);
+    _policy.move(from, to);
+
+    src.valid = false;
+    src.virtualPage = 0xFFFFFFFF;
+    clearDirty(src);
+
+    VMEM_STAT(relocations, 1);
+}
+
+template <class Policy>
+int32_t VirtualMemoryT<Policy>::findFreeSlotOutside(int32_t start, uint32_t count) {
+    for (uint32_t i = 0; i < _maxCachePages; i++) {
+        if ((int32_t)i >= start && (int32_t)i < start + (int32_t)count) continue;
+        if (!_cacheSlots[i].valid) return i;
+    }
+    return -1;
+}
+
+template <class Policy>
+int32_t VirtualMemoryT<Policy>::findContiguousRun(uint32_t firstPage, uint32_t count) {
+    if (count > _maxCachePages) return -1;
+
+    // A page of the span that is already pinned cannot move, so it fixes
+    // where the run has to start
+    for (uint32_t i = 0; i < count; i++) {
+        int32_t slot = slotOf(firstPage + i);
+        if (slot >= 0 && _cacheSlots[slot].pinCount > 0) {
+            int32_t start = slot - (int32_t)i;
+            if (start < 0 || (uint32_t)start + count > _maxCachePages) return -1;
+            for (uint32_t j = 0; j < count; j++) {
+                const VMemPage& page = _cacheSlots[start + j];
+                if (page.pinCount > 0 && page.virtualPage != firstPage + j) return -1;
+
+                // Other pinned pages of the span must already be in place too
+                int32_t other = slotOf(firstPage + j);
+                if (other >= 0 && _cacheSlots[other].pinCount > 0 &&
+                    other != start + (int32_t)j) return -1;
+            }
+            return start;
         }
     }
 
-    // Update page table to mark page as not cached
-    uint32_t evictedPage = _cacheSlots[lruSlot].virtualPage;
-    if (evictedPage < _totalPages) {
-        _pageTable[evictedPage] = -1;
+    // Otherwise pick the unpinned window that needs the fewest page moves
+    int32_t bestStart = -1;
+    uint32_t bestCost = 0xFFFFFFFF;
+
+    for (uint32_t start = 0; start + count <= _maxCachePages; start++) {
+        uint32_t cost = 0;
+        bool usable = true;
+        for (uint32_t j = 0; j < count; j++) {
+            const VMemPage& page = _cacheSlots[start + j];
+            if (page.pinCount > 0) {
+                usable = false;
+                start += j;  // Skip past the pinned slot
+                break;
+            }
+            if (page.valid && page.virtualPage != firstPage + j) {
+                cost += page.dirty ? 2 : 1;
+            }
+        }
+        if (usable && cost < bestCost) {
+            bestCost = cost;
+            bestStart = start;
+            if (cost == 0) break;
+        }
     }
 
-    // Mark slot as free
-    _cacheSlots[lruSlot].valid = false;
-    _cacheSlots[lruSlot].virtualPage = 0xFFFFFFFF;
+    return bestStart;
+}
+
+template <class Policy>
+int32_t VirtualMemoryT<Policy>::mapContiguous(uint32_t firstPage, uint32_t count) {
+    int32_t start = findContiguousRun(firstPage, count);
+    if (start < 0) return -1;
 
-    _stats.evictions++;
-    _stats.pagesLoaded--;
+    for (uint32_t i = 0; i < count; i++) {
+        int32_t target = start + i;
+        uint32_t pageNum = firstPage + i;
+        int32_t current = slotOf(pageNum);
 
-    return lruSlot;
+        if (current == target) {
+            VMEM_STAT(hits, 1);
+            touchPage(target);
+            continue;
+        }
+
+        // Vacate the target slot - keep its page cached elsewhere if possible
+        if (_cacheSlots[target].valid) {
+            int32_t spare = findFreeSlotOutside(start, count);
+            if (spare >= 0) {
+                moveSlot(target, spare);
+            } else if (!freeSlot(target)) {
+                return -1;
+            }
+        }
+
+        if (current >= 0) {
+            // Already cached in the wrong slot - move it into place
+            moveSlot(current, target);
+            VMEM_STAT(hits, 1);
+            touchPage(target);
+        } else if (!loadPageIntoSlot(pageNum, target)) {
+            return -1;
+        }
+    }
+
+    return start;
 }
 
-bool VirtualMemory::writeBackPage(int32_t slot) {
+template <class Policy>
+bool VirtualMemoryT<Policy>::writeBackPage(int32_t slot) {
     if (slot < 0 || (uint32_t)slot >= _maxCachePages) return false;
     if (!_cacheSlots[slot].valid || !_cacheSlots[slot].dirty) return true;  // Nothing to do
 
-    uint32_t virtualPage = _cacheSlots[slot].virtualPage;
-    uint32_t fileOffset = virtualPage * VMEM_PAGE_SIZE;
+    VMemPage& page = _cacheSlots[slot];
+    if (!writeSectors(page.virtualPage, page.cachePtr, page.dirtySectors)) {
+        return false;
+    }
+
+    clearDirty(page);
+    return true;
+}
+
+template <class Policy>
+bool VirtualMemoryT<Policy>::writeSectors(uint32_t virtualPage, const uint8_t* data,
+                                 const uint32_t* dirtySectors) {
+    // First write of a page - the clean sectors on the card are not zeroed
+    uint32_t allSectors[VMEM_DIRTY_WORDS];
+    if (!isMaterialised(virtualPage)) {
+        memset(allSectors, 0, sizeof(allSectors));
+        for (uint32_t sector = 0; sector < _sectorsPerPage; sector++) {
+            allSectors[sector / 32] |= 1UL << (sector % 32);
+        }
+        dirtySectors = allSectors;
+    }
+
+    if (!_journal.isEnabled()) {
+        return writeRuns(virtualPage, data, dirtySectors);
+    }
+
+    // Durable mode: journal, write, commit - one write-back at a time, so a
+    // checkpoint never empties the journal under a write still in flight
+    VMemLockGuard guard(_journalLock);
+    if (!journalWriteBack(virtualPage, data, dirtySectors)) {
+        return false;
+    }
+    bool ok = writeRuns(virtualPage, data, dirtySectors);
+    // Committed even if the write failed: the checksum then reports the
+    // page as damaged instead of trusting whatever reached the card
+    _journal.commit();
+    return ok;
+}
+
+template <class Policy>
+bool VirtualMemoryT<Policy>::writeRuns(uint32_t virtualPage, const uint8_t* data,
+                                       const uint32_t* dirtySectors) {
+    uint32_t fileOffset = virtualPage * _pageSize;
+    uint32_t written = 0;
+
+    // Write each run of consecutive dirty sectors with a single request
+    uint32_t sector = 0;
+    while (sector < _sectorsPerPage) {
+        if (!(dirtySectors[sector / 32] & (1UL << (sector % 32)))) {
+            sector++;
+            continue;
+        }
+
+        uint32_t runStart = sector;
+        while (sector < _sectorsPerPage &&
+               (dirtySectors[sector / 32] & (1UL << (sector % 32)))) {
+            sector++;
+        }
+
+        uint32_t offset = runStart * VMEM_SECTOR_SIZE;
+        uint32_t length = (sector - runStart) * VMEM_SECTOR_SIZE;
+        int32_t bytesWritten = _storage->writeAt(fileOffset + offset, data + offset, length);
+        if (bytesWritten != (int32_t)length) {
+            VMEM_LOG("VMEM: Write-back failed for page %lu\n", virtualPage);
+            VMEM_STAT(bytesWritten, written);
+            return false;
+        }
+
+        written += length;
+        VMEM_STAT(writeRuns, 1);
+    }
+
+    setMaterialised(virtualPage, true);
+    VMEM_STAT(writebacks, 1);
+    VMEM_STAT(bytesWritten, written);
+    VMEM_STAT(bytesSaved, _pageSize - written);
+
+    return true;
+}
+
+template <class Policy>
+bool VirtualMemoryT<Policy>::journalWriteBack(uint32_t virtualPage, const uint8_t* data,
+                                              const uint32_t* sectors) {
+    // Caller holds the journal lock
+    int32_t length = _journal.append(virtualPage, data, sectors);
+    if (length == 0) {
+        // Journal full - make room and retry once (a record always fits an
+        // empty journal)
+        if (!checkpointJournal()) {
+            return false;
+        }
+        length = _journal.append(virtualPage, data, sectors);
+    }
+    if (length <= 0) {
+        VMEM_LOG("VMEM: Journal append failed for page %lu\n", virtualPage);
+        return false;
+    }
+
+    VMEM_STAT(journalRecords, 1);
+    VMEM_STAT(journalBytes, length);
+    return true;
+}
 
-    int32_t bytesWritten = sdWriteFileAt(VMEM_SWAP_FILE, fileOffset,
-                                          _cacheSlots[slot].cachePtr, VMEM_PAGE_SIZE);
-    if (bytesWritten != VMEM_PAGE_SIZE) {
-        Serial.printf("VMEM: Write-back failed for page %lu\n", virtualPage);
+template <class Policy>
+bool VirtualMemoryT<Policy>::checkpointJournal() {
+    // Caller holds the journal lock. The page map goes first: once the
+    // journal is emptied, replay can no longer mark its pages materialised.
+    if (!savePageMap() || !_journal.checkpoint()) {
+        VMEM_LOG("VMEM: Journal checkpoint failed\n");
         return false;
     }
+    VMEM_STAT(checkpoints, 1);
+    return true;
+}
+
+template <class Policy>
+void VirtualMemoryT<Policy>::journalReplayed(uint32_t virtualPage, void* context) {
+    static_cast<VirtualMemoryT<Policy>*>(context)->setMaterialised(virtualPage, true);
+}
+
+template <class Policy>
+bool VirtualMemoryT<Policy>::demotePage(int32_t slot) {
+    // Caller holds the page's stripe and has reserved or owns the slot.
+    // Returns true if the tier now holds the page (dirty data included).
+    if (!_tier.isEnabled()) return false;
+
+    VMemPage& page = _cacheSlots[slot];
+
+    // Clean never-written pages come back as zero fills for free
+    if (!page.dirty && !isMaterialised(page.virtualPage)) return false;
+
+    VMemLockGuard guard(_tierLock);
+    uint32_t length = _tier.compress(page.cachePtr);
+    if (length == 0) {
+        VMEM_STAT(tierRejects, 1);
+        return false;
+    }
+
+    uint32_t evicted = _tier.evictions();
+    bool stored = _tier.store(page.virtualPage, length, page.dirty, page.dirtySectors,
+                              tierWriteBack, this);
+    VMEM_STAT(tierEvictions, _tier.evictions() - evicted);
+    if (stored) {
+        VMEM_STAT(tierStores, 1);
+    } else {
+        VMEM_STAT(tierRejects, 1);
+    }
+    return stored;
+}
+
+template <class Policy>
+bool VirtualMemoryT<Policy>::tierWriteBack(uint32_t virtualPage, const uint8_t* page,
+                                  const uint32_t* dirtySectors, void* context) {
+    // Runs under the tier lock without the page's stripe: the page is not
+    // cached, and faulting it in has to take the tier lock first
+    return ((VirtualMemoryT<Policy>*)context)->writeSectors(virtualPage, page, dirtySectors);
+}
+
+template <class Policy>
+void VirtualMemoryT<Policy>::markDirty(int32_t slot, uint32_t offset, size_t length) {
+    if (slot < 0 || length == 0) return;
+
+    VMemPage& page = _cacheSlots[slot];
+    uint32_t first = offset / VMEM_SECTOR_SIZE;
+    uint32_t last = (offset + length - 1) / VMEM_SECTOR_SIZE;
+    for (uint32_t sector = first; sector <= last; sector++) {
+        page.dirtySectors[sector / 32] |= 1UL << (sector % 32);
+    }
+    page.dirty = true;
+}
 
-    _cacheSlots[slot].dirty = false;
-    _stats.writebacks++;
-    _stats.bytesWritten += VMEM_PAGE_SIZE;
+template <class Policy>
+void VirtualMemoryT<Policy>::clearDirty(VMemPage& page) {
+    page.dirty = false;
+    memset(page.dirtySectors, 0, sizeof(page.dirtySectors));
+}
 
+template <class Policy>
+bool VirtualMemoryT<Policy>::isMaterialised(uint32_t virtualPage) const {
+    return (VMEM_ATOMIC_LOAD(&_pageMap[virtualPage / 8]) >> (virtualPage % 8)) & 1;
+}
+
+template <class Policy>
+void VirtualMemoryT<Policy>::setMaterialised(uint32_t virtualPage, bool materialised) {
+    if (isMaterialised(virtualPage) == materialised) return;
+
+    // Atomic - tier write-back sets bits of pages in stripes it does not hold
+    uint8_t bit = (uint8_t)(1 << (virtualPage % 8));
+    if (materialised) {
+        __atomic_fetch_or(&_pageMap[virtualPage / 8], bit, __ATOMIC_RELAXED);
+    } else {
+        __atomic_fetch_and(&_pageMap[virtualPage / 8], (uint8_t)~bit, __ATOMIC_RELAXED);
+    }
+    VMEM_ATOMIC_STORE(&_pageMapDirty, true);
+}
+
+template <class Policy>
+bool VirtualMemoryT<Policy>::savePageMap() {
+    if (!VMEM_ATOMIC_LOAD(&_pageMapDirty)) return true;
+
+    // Clear the flag before taking the snapshot, so a bit changed while
+    // copying marks the map dirty again for the next save
+    VMemLockGuard guard(_pageMapLock);
+    size_t mapBytes = (_totalPages + 7) / 8;
+    if (!__atomic_exchange_n(&_pageMapDirty, false, __ATOMIC_ACQ_REL)) return true;
+    for (size_t i = 0; i < mapBytes; i++) {
+        _pageMapCopy[i] = VMEM_ATOMIC_LOAD(&_pageMap[i]);
+    }
+
+    if (!_storage->saveMap(_pageMapCopy, mapBytes)) {
+        VMEM_LOG("VMEM: Failed to save page map\n");
+        VMEM_ATOMIC_STORE(&_pageMapDirty, true);
+        return false;
+    }
     return true;
 }
 
-uint8_t* VirtualMemory::getPagePtr(uint32_t virtualPage) {
+template <class Policy>
+void VirtualMemoryT<Policy>::releaseBuffers() {
+    _journal.release();
+    _tier.release();
+    _policy.release();
+    if (_cacheBuffer) {
+        _allocator->release(_cacheBuffer);
+        _cacheBuffer = nullptr;
+    }
+    if (_cacheSlots) {
+        free(_cacheSlots);
+        _cacheSlots = nullptr;
+    }
+    if (_pageMap) {
+        free(_pageMap);
+        _pageMap = nullptr;
+    }
+    if (_pageMapCopy) {
+        free(_pageMapCopy);
+        _pageMapCopy = nullptr;
+    }
+    if (_pageDir) {
+        for (uint32_t i = 0; i < _pageDirSize; i++) {
+            free(_pageDir[i]);
+        }
+        free(_pageDir);
+        _pageDir = nullptr;
+    }
+    _pageLeaves = 0;
+}
+
+template <class Policy>
+uint8_t* VirtualMemoryT<Policy>::getPagePtr(uint32_t virtualPage) {
+    // Caller holds the stripe lock of virtualPage
     if (virtualPage >= _totalPages) return nullptr;
 
-    int32_t slot = _pageTable[virtualPage];
+    int32_t slot = slotOf(virtualPage);
 
     if (slot >= 0) {
         // Cache hit
-        _stats.hits++;
+        VMEM_STAT(hits, 1);
         touchPage(slot);
         return _cacheSlots[slot].cachePtr;
     }
 
-    // Cache miss - load page
-    slot = loadPage(virtualPage);
-    if (slot < 0) return nullptr;
+    // Cache miss - claim a slot and load the page without holding the
+    // replacement lock, so faults in other stripes proceed in parallel
+    slot = claimSlot(virtualPage);
+    if (slot < 0) {
+        VMEM_LOG("VMEM: Failed to evict page\n");
+        return nullptr;
+    }
+
+    bool loaded = loadPageIntoSlot(virtualPage, slot);
 
-    return _cacheSlots[slot].cachePtr;
+    _replacementLock.lock();
+    _cacheSlots[slot].reserved = false;
+    _replacementLock.unlock();
+
+    return loaded ? _cacheSlots[slot].cachePtr : nullptr;
 }
 
-void VirtualMemory::touchPage(int32_t slot) {
+template <class Policy>
+void VirtualMemoryT<Policy>::touchPage(int32_t slot) {
     if (slot >= 0 && (uint32_t)slot < _maxCachePages) {
-        _cacheSlots[slot].lastAccess = millis();
+        _policy.touch(slot);
     }
 }
 
+// Every policy is compiled so tools can compare them; unused ones are
+// dropped by the linker
+template class VirtualMemoryT<VMemLruPolicy>;
+template class VirtualMemoryT<VMemClockPolicy>;
+template class VirtualMemoryT<VMem2QPolicy>;
+template class VirtualMemoryT<VMemArcPolicy>;
+
 #endif // VIRTUAL_MEMORY
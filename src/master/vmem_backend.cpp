@@ -0,0 +1,179 @@
+#include "shared/config.h"
+
+#if VIRTUAL_MEMORY
+
+#include "master/vmem_backend.h"
+#include "master/virtual_memory.h"
+#include "master/sd_handler.h"
+#include "master/sd_io.h"
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+
+// =============================================================================
+// SD Card Swap File
+// =============================================================================
+
+class SdSwapStorage : public VMemStorage {
+public:
+    SdSwapStorage() : _shardSize(0) {}
+
+    bool isReady() override {
+        return sdIsReady();
+    }
+
+    void setShardSize(uint32_t shardSize) override {
+        _shardSize = shardSize;
+    }
+
+    int64_t size() override {
+        if (_shardSize == 0) {
+            return sdFileSize(VMEM_SWAP_FILE);
+        }
+
+        // Sum of consecutive full shards
+        char path[32];
+        int64_t total = -1;
+        for (uint32_t shard = 0;; shard++) {
+            shardPath(shard, path, sizeof(path));
+            if (sdFileSize(path) != (int32_t)_shardSize) break;
+            total = (int64_t)(shard + 1) * _shardSize;
+        }
+        return total;
+    }
+
+    bool create(uint32_t size) override {
+        const char* stale[] = {VMEM_SWAP_MAP_FILE, VMEM_SWAP_META_FILE, VMEM_SWAP_JOURNAL_FILE};
+        for (const char* path : stale) {
+            if (sdExists(path)) {
+                sdRemove(path);
+            }
+        }
+        removeShards();
+
+        uint32_t start = millis();
+        SdExtent extent;
+        uint32_t files = 1;
+        uint32_t contiguous = 0;
+        if (_shardSize == 0) {
+            if (!sdCreateSparseFile(VMEM_SWAP_FILE, size, &extent)) {
+                return false;
+            }
+            contiguous += extent.contiguous;
+        } else {
+            // Separate files keep each FAT cluster chain short and every file
+            // below the FAT32 4 GB limit
+            if (sdExists(VMEM_SWAP_FILE)) {
+                sdRemove(VMEM_SWAP_FILE);
+            }
+            char path[32];
+            files = (size + _shardSize - 1) / _shardSize;
+            for (uint32_t shard = 0; shard < files; shard++) {
+                shardPath(shard, path, sizeof(path));
+                if (!sdCreateSparseFile(path, _shardSize, &extent)) {
+                    return false;
+                }
+                contiguous += extent.contiguous;
+            }
+        }
+        Serial.printf("VMEM: Swap allocated in %lu ms, %lu of %lu file(s) contiguous\n",
+                      millis() - start, contiguous, files);
+        return true;
+    }
+
+    // Page traffic goes through the SD I/O queue, behind safety and
+    // telemetry logs
+    int32_t readAt(uint32_t offset, uint8_t* buffer, size_t length) override {
+        if (_shardSize == 0) {
+            return sdIoReadAtWait(VMEM_SWAP_FILE, offset, buffer, length, SD_IO_VMEM);
+        }
+        char path[32];
+        shardPath(offset / _shardSize, path, sizeof(path));
+        return sdIoReadAtWait(path, offset % _shardSize, buffer, length, SD_IO_VMEM);
+    }
+
+    int32_t writeAt(uint32_t offset, const uint8_t* data, size_t length) override {
+        if (_shardSize == 0) {
+            return sdIoWriteAtWait(VMEM_SWAP_FILE, offset, data, length, SD_IO_VMEM);
+        }
+        char path[32];
+        shardPath(offset / _shardSize, path, sizeof(path));
+        return sdIoWriteAtWait(path, offset % _shardSize, data, length, SD_IO_VMEM);
+    }
+
+    bool loadMap(uint8_t* bits, size_t length) override {
+        if (sdFileSize(VMEM_SWAP_MAP_FILE) != (int32_t)length) return false;
+        return sdReadFileAt(VMEM_SWAP_MAP_FILE, 0, bits, length) == (int32_t)length;
+    }
+
+    bool sync() override {
+        return sdSyncAll();
+    }
+
+    bool saveMap(const uint8_t* bits, size_t length) override {
+        return sdWriteFileAt(VMEM_SWAP_MAP_FILE, 0, bits, length) == (int32_t)length &&
+               sdSyncFile(VMEM_SWAP_MAP_FILE);
+    }
+
+    int32_t sideReadAt(VMemSideFile file, uint32_t offset, uint8_t* buffer, size_t length) override {
+        return sdReadFileAt(sidePath(file), offset, buffer, length);
+    }
+
+    int32_t sideWriteAt(VMemSideFile file, uint32_t offset, const uint8_t* data, size_t length) override {
+        int32_t written = sdWriteFileAt(sidePath(file), offset, data, length);
+        if (written < 0 || !sdSyncFile(sidePath(file))) return -1;
+        return written;
+    }
+
+private:
+    uint32_t _shardSize;
+
+    static const char* sidePath(VMemSideFile file) {
+        return file == VMEM_SIDE_META ? VMEM_SWAP_META_FILE : VMEM_SWAP_JOURNAL_FILE;
+    }
+
+    static void shardPath(uint32_t shard, char* path, size_t size) {
+        snprintf(path, size, VMEM_SWAP_SHARD_FORMAT, (unsigned long)shard);
+    }
+
+    // Remove shards left by any previous layout
+    void removeShards() {
+        char path[32];
+        for (uint32_t shard = 0;; shard++) {
+            shardPath(shard, path, sizeof(path));
+            if (!sdExists(path)) break;
+            sdRemove(path);
+        }
+    }
+};
+
+// =============================================================================
+// PSRAM Cache Allocator
+// =============================================================================
+
+class PsramAllocator : public VMemAllocator {
+public:
+    size_t freeBytes() override {
+        return heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    }
+
+    void* alloc(size_t size) override {
+        return heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+    }
+
+    void release(void* ptr) override {
+        heap_caps_free(ptr);
+    }
+};
+
+static SdSwapStorage sdStorage;
+static PsramAllocator psramAllocator;
+
+VMemStorage* vmemSdStorage() {
+    return &sdStorage;
+}
+
+VMemAllocator* vmemPsramAllocator() {
+    return &psramAllocator;
+}
+
+#endif // VIRTUAL_MEMORY
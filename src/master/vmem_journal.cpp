@@ -0,0 +1,413 @@
+#include "shared/config.h"
+
+#if VIRTUAL_MEMORY
+
+#include "master/vmem_journal.h"
+#include <stdlib.h>
+#include <string.h>
+
+// =============================================================================
+// CRC-32
+// =============================================================================
+
+static const uint32_t crcTable[256] = {
+    0x00000000, 0x77073096, 0xEE0E612C, 0x990951BA, 0x076DC419, 0x706AF48F,
+    0xE963A535, 0x9E6495A3, 0x0EDB8832, 0x79DCB8A4, 0xE0D5E91E, 0x97D2D988,
+    0x09B64C2B, 0x7EB17CBD, 0xE7B82D07, 0x90BF1D91, 0x1DB71064, 0x6AB020F2,
+    0xF3B97148, 0x84BE41DE, 0x1ADAD47D, 0x6DDDE4EB, 0xF4D4B551, 0x83D385C7,
+    0x136C9856, 0x646BA8C0, 0xFD62F97A, 0x8A65C9EC, 0x14015C4F, 0x63066CD9,
+    0xFA0F3D63, 0x8D080DF5, 0x3B6E20C8, 0x4C69105E, 0xD56041E4, 0xA2677172,
+    0x3C03E4D1, 0x4B04D447, 0xD20D85FD, 0xA50AB56B, 0x35B5A8FA, 0x42B2986C,
+    0xDBBBC9D6, 0xACBCF940, 0x32D86CE3, 0x45DF5C75, 0xDCD60DCF, 0xABD13D59,
+    0x26D930AC, 0x51DE003A, 0xC8D75180, 0xBFD06116, 0x21B4F4B5, 0x56B3C423,
+    0xCFBA9599, 0xB8BDA50F, 0x2802B89E, 0x5F058808, 0xC60CD9B2, 0xB10BE924,
+    0x2F6F7C87, 0x58684C11, 0xC1611DAB, 0xB6662D3D, 0x76DC4190, 0x01DB7106,
+    0x98D220BC, 0xEFD5102A, 0x71B18589, 0x06B6B51F, 0x9FBFE4A5, 0xE8B8D433,
+    0x7807C9A2, 0x0F00F934, 0x9609A88E, 0xE10E9818, 0x7F6A0DBB, 0x086D3D2D,
+    0x91646C97, 0xE6635C01, 0x6B6B51F4, 0x1C6C6162, 0x856530D8, 0xF262004E,
+    0x6C0695ED, 0x1B01A57B, 0x8208F4C1, 0xF50FC457, 0x65B0D9C6, 0x12B7E950,
+    0x8BBEB8EA, 0xFCB9887C, 0x62DD1DDF, 0x15DA2D49, 0x8CD37CF3, 0xFBD44C65,
+    0x4DB26158, 0x3AB551CE, 0xA3BC0074, 0xD4BB30E2, 0x4ADFA541, 0x3DD895D7,
+    0xA4D1C46D, 0xD3D6F4FB, 0x4369E96A, 0x346ED9FC, 0xAD678846, 0xDA60B8D0,
+    0x44042D73, 0x33031DE5, 0xAA0A4C5F, 0xDD0D7CC9, 0x5005713C, 0x270241AA,
+    0xBE0B1010, 0xC90C2086, 0x5768B525, 0x206F85B3, 0xB966D409, 0xCE61E49F,
+    0x5EDEF90E, 0x29D9C998, 0xB0D09822, 0xC7D7A8B4, 0x59B33D17, 0x2EB40D81,
+    0xB7BD5C3B, 0xC0BA6CAD, 0xEDB88320, 0x9ABFB3B6, 0x03B6E20C, 0x74B1D29A,
+    0xEAD54739, 0x9DD277AF, 0x04DB2615, 0x73DC1683, 0xE3630B12, 0x94643B84,
+    0x0D6D6A3E, 0x7A6A5AA8, 0xE40ECF0B, 0x9309FF9D, 0x0A00AE27, 0x7D079EB1,
+    0xF00F9344, 0x8708A3D2, 0x1E01F268, 0x6906C2FE, 0xF762575D, 0x806567CB,
+    0x196C3671, 0x6E6B06E7, 0xFED41B76, 0x89D32BE0, 0x10DA7A5A, 0x67DD4ACC,
+    0xF9B9DF6F, 0x8EBEEFF9, 0x17B7BE43, 0x60B08ED5, 0xD6D6A3E8, 0xA1D1937E,
+    0x38D8C2C4, 0x4FDFF252, 0xD1BB67F1, 0xA6BC5767, 0x3FB506DD, 0x48B2364B,
+    0xD80D2BDA, 0xAF0A1B4C, 0x36034AF6, 0x41047A60, 0xDF60EFC3, 0xA867DF55,
+    0x316E8EEF, 0x4669BE79, 0xCB61B38C, 0xBC66831A, 0x256FD2A0, 0x5268E236,
+    0xCC0C7795, 0xBB0B4703, 0x220216B9, 0x5505262F, 0xC5BA3BBE, 0xB2BD0B28,
+    0x2BB45A92, 0x5CB36A04, 0xC2D7FFA7, 0xB5D0CF31, 0x2CD99E8B, 0x5BDEAE1D,
+    0x9B64C2B0, 0xEC63F226, 0x756AA39C, 0x026D930A, 0x9C0906A9, 0xEB0E363F,
+    0x72076785, 0x05005713, 0x95BF4A82, 0xE2B87A14, 0x7BB12BAE, 0x0CB61B38,
+    0x92D28E9B, 0xE5D5BE0D, 0x7CDCEFB7, 0x0BDBDF21, 0x86D3D2D4, 0xF1D4E242,
+    0x68DDB3F8, 0x1FDA836E, 0x81BE16CD, 0xF6B9265B, 0x6FB077E1, 0x18B74777,
+    0x88085AE6, 0xFF0F6A70, 0x66063BCA, 0x11010B5C, 0x8F659EFF, 0xF862AE69,
+    0x616BFFD3, 0x166CCF45, 0xA00AE278, 0xD70DD2EE, 0x4E048354, 0x3903B3C2,
+    0xA7672661, 0xD06016F7, 0x4969474D, 0x3E6E77DB, 0xAED16A4A, 0xD9D65ADC,
+    0x40DF0B66, 0x37D83BF0, 0xA9BCAE53, 0xDEBB9EC5, 0x47B2CF7F, 0x30B5FFE9,
+    0xBDBDF21C, 0xCABAC28A, 0x53B39330, 0x24B4A3A6, 0xBAD03605, 0xCDD70693,
+    0x54DE5729, 0x23D967BF, 0xB3667A2E, 0xC4614AB8, 0x5D681B02, 0x2A6F2B94,
+    0xB40BBE37, 0xC30C8EA1, 0x5A05DF1B, 0x2D02EF8D
+};
+
+uint32_t vmemCrc32(const uint8_t* data, size_t length, uint32_t crc) {
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc = crcTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// Checksum of a header or record block, excluding its trailing crc field
+template <class T>
+static uint32_t blockCrc(const T& block) {
+    return vmemCrc32((const uint8_t*)&block, offsetof(T, crc));
+}
+
+static uint32_t sectorCount(const uint32_t* sectors, uint32_t sectorsPerPage) {
+    uint32_t count = 0;
+    for (uint32_t sector = 0; sector < sectorsPerPage; sector++) {
+        if (sectors[sector / 32] & (1UL << (sector % 32))) count++;
+    }
+    return count;
+}
+
+// =============================================================================
+// Setup
+// =============================================================================
+
+VMemJournal::VMemJournal()
+    : _storage(nullptr)
+    , _allocator(nullptr)
+    , _totalPages(0)
+    , _pageSize(0)
+    , _journalSize(0)
+    , _meta(nullptr)
+    , _metaDirty(nullptr)
+    , _metaBlocks(0)
+    , _metaDirtyCount(0)
+    , _metaHeaderWritten(false)
+    , _staging(nullptr)
+    , _epoch(0)
+    , _sequence(0)
+    , _offset(VMEM_JOURNAL_BLOCK)
+    , _pendingPage(0)
+{
+    memset(&_pending, 0, sizeof(_pending));
+    memset(&_recovery, 0, sizeof(_recovery));
+}
+
+bool VMemJournal::init(VMemStorage* storage, VMemAllocator* allocator, uint32_t totalPages,
+                       uint32_t pageSize, uint32_t journalSize) {
+    release();
+    if (journalSize < 2 * VMEM_JOURNAL_BLOCK + pageSize) return false;
+
+    _storage = storage;
+    _allocator = allocator;
+    _totalPages = totalPages;
+    _pageSize = pageSize;
+    _journalSize = journalSize;
+    _metaBlocks = (totalPages + VMEM_META_PER_BLOCK - 1) / VMEM_META_PER_BLOCK;
+
+    _meta = (VMemPageMeta*)allocator->alloc(totalPages * sizeof(VMemPageMeta));
+    _metaDirty = (uint8_t*)calloc((_metaBlocks + 7) / 8, 1);
+    _staging = (uint8_t*)allocator->alloc(VMEM_JOURNAL_BLOCK + pageSize);
+    if (!_meta || !_metaDirty || !_staging) {
+        release();
+        return false;
+    }
+
+    // Table from the last checkpoint; without one no page has a checksum
+    // yet and the whole table is written by the first checkpoint
+    VMemJournalHeader header;
+    size_t tableBytes = totalPages * sizeof(VMemPageMeta);
+    _metaHeaderWritten = readHeader(VMEM_SIDE_META, header) &&
+                         header.pageSize == pageSize && header.totalPages == totalPages &&
+                         storage->sideReadAt(VMEM_SIDE_META, VMEM_JOURNAL_BLOCK,
+                                             (uint8_t*)_meta, tableBytes) == (int32_t)tableBytes;
+    if (!_metaHeaderWritten) {
+        memset(_meta, 0, tableBytes);
+        memset(_metaDirty, 0xFF, (_metaBlocks + 7) / 8);
+        _metaDirtyCount = _metaBlocks;
+    }
+
+    _epoch = 0;
+    _sequence = 0;
+    _offset = VMEM_JOURNAL_BLOCK;
+    memset(&_recovery, 0, sizeof(_recovery));
+    return true;
+}
+
+void VMemJournal::release() {
+    if (_allocator) {
+        if (_meta) _allocator->release(_meta);
+        if (_staging) _allocator->release(_staging);
+    }
+    free(_metaDirty);
+    _meta = nullptr;
+    _staging = nullptr;
+    _metaDirty = nullptr;
+    _metaBlocks = 0;
+    _metaDirtyCount = 0;
+}
+
+// =============================================================================
+// Headers
+// =============================================================================
+
+bool VMemJournal::writeHeader(VMemSideFile file, uint32_t epoch) {
+    memset(_staging, 0, VMEM_JOURNAL_BLOCK);
+    VMemJournalHeader* header = (VMemJournalHeader*)_staging;
+    header->magic = file == VMEM_SIDE_META ? VMEM_META_MAGIC : VMEM_JOURNAL_MAGIC;
+    header->epoch = epoch;
+    header->pageSize = _pageSize;
+    header->totalPages = _totalPages;
+    header->crc = blockCrc(*header);
+    return _storage->sideWriteAt(file, 0, _staging, VMEM_JOURNAL_BLOCK) == VMEM_JOURNAL_BLOCK;
+}
+
+bool VMemJournal::readHeader(VMemSideFile file, VMemJournalHeader& header) {
+    if (_storage->sideReadAt(file, 0, (uint8_t*)&header, sizeof(header)) != (int32_t)sizeof(header)) {
+        return false;
+    }
+    uint32_t magic = file == VMEM_SIDE_META ? VMEM_META_MAGIC : VMEM_JOURNAL_MAGIC;
+    return header.magic == magic && header.crc == blockCrc(header);
+}
+
+// =============================================================================
+// Recovery
+// =============================================================================
+
+// Read and check the record at offset into the staging buffer
+// Sets *length to the record size, or 0 if the journal ends here
+bool VMemJournal::readRecord(uint32_t offset, const VMemJournalHeader& header, uint32_t* length) {
+    *length = 0;
+    if (offset + VMEM_JOURNAL_BLOCK > _journalSize ||
+        _storage->sideReadAt(VMEM_SIDE_JOURNAL, offset, _staging, VMEM_JOURNAL_BLOCK) != VMEM_JOURNAL_BLOCK) {
+        return true;
+    }
+    _recovery.bytesRead += VMEM_JOURNAL_BLOCK;
+
+    VMemJournalRecord record;
+    memcpy(&record, _staging, sizeof(record));
+    if (record.magic != VMEM_JOURNAL_RECORD_MAGIC || record.epoch != header.epoch ||
+        record.sequence != _sequence) {
+        return true;  // End of this epoch's records
+    }
+
+    // From here on a mismatch means the append was cut short
+    uint32_t dataBytes = record.sectors * VMEM_SECTOR_BYTES;
+    if (record.crc != blockCrc(record) || record.virtualPage >= header.totalPages ||
+        dataBytes > _pageSize ||
+        record.sectors != sectorCount(record.dirtySectors, header.pageSize / VMEM_SECTOR_BYTES) ||
+        offset + VMEM_JOURNAL_BLOCK + dataBytes > _journalSize) {
+        return false;
+    }
+    uint8_t* data = _staging + VMEM_JOURNAL_BLOCK;
+    int32_t n = _storage->sideReadAt(VMEM_SIDE_JOURNAL, offset + VMEM_JOURNAL_BLOCK, data, dataBytes);
+    if (n != (int32_t)dataBytes || vmemCrc32(data, dataBytes) != record.dataCrc) {
+        return false;
+    }
+    _recovery.bytesRead += dataBytes;
+
+    *length = VMEM_JOURNAL_BLOCK + dataBytes;
+    return true;
+}
+
+// Write the sector data in the staging buffer back to the swap, one
+// request per run of consecutive sectors
+bool VMemJournal::redo(const VMemJournalRecord& record, uint32_t pageSize) {
+    uint32_t fileOffset = record.virtualPage * pageSize;
+    uint32_t sectorsPerPage = pageSize / VMEM_SECTOR_BYTES;
+    const uint8_t* data = _staging + VMEM_JOURNAL_BLOCK;
+
+    uint32_t sector = 0;
+    while (sector < sectorsPerPage) {
+        if (!(record.dirtySectors[sector / 32] & (1UL << (sector % 32)))) {
+            sector++;
+            continue;
+        }
+        uint32_t runStart = sector;
+        while (sector < sectorsPerPage && (record.dirtySectors[sector / 32] & (1UL << (sector % 32)))) {
+            sector++;
+        }
+        uint32_t length = (sector - runStart) * VMEM_SECTOR_BYTES;
+        if (_storage->writeAt(fileOffset + runStart * VMEM_SECTOR_BYTES, data, length) != (int32_t)length) {
+            return false;
+        }
+        data += length;
+    }
+    return true;
+}
+
+bool VMemJournal::recover(VMemJournalReplayFn replayed, void* context) {
+    uint32_t start = vmemMicros();
+    memset(&_recovery, 0, sizeof(_recovery));
+    _sequence = 0;
+    _offset = VMEM_JOURNAL_BLOCK;
+
+    VMemJournalHeader header;
+    if (!readHeader(VMEM_SIDE_JOURNAL, header)) {
+        _epoch = 0;
+        _recovery.timeUs = vmemMicros() - start;
+        return true;  // No journal yet
+    }
+    _epoch = header.epoch;
+
+    // Records written under another geometry still redo their bytes, but
+    // the checksum table they refer to is gone
+    bool sameGeometry = header.pageSize == _pageSize && header.totalPages == _totalPages;
+
+    while (true) {
+        uint32_t length;
+        if (!readRecord(_offset, header, &length)) {
+            _recovery.torn = true;
+            break;
+        }
+        if (length == 0) break;
+
+        VMemJournalRecord record;
+        memcpy(&record, _staging, sizeof(record));
+        _recovery.records++;
+
+        // Older generations are already in the checkpointed table
+        if (!sameGeometry || record.generation > _meta[record.virtualPage].generation) {
+            if (!redo(record, header.pageSize)) {
+                return false;
+            }
+            if (sameGeometry) {
+                VMemPageMeta meta = {record.generation, record.pageCrc};
+                setMeta(record.virtualPage, meta);
+            }
+            _recovery.pages++;
+        }
+        if (sameGeometry) {
+            replayed(record.virtualPage, context);
+        }
+
+        _offset += length;
+        _sequence++;
+    }
+
+    _recovery.timeUs = vmemMicros() - start;
+    return true;
+}
+
+// =============================================================================
+// Logging
+// =============================================================================
+
+int32_t VMemJournal::append(uint32_t virtualPage, const uint8_t* page, const uint32_t* sectors) {
+    uint32_t sectorsPerPage = _pageSize / VMEM_SECTOR_BYTES;
+    uint32_t count = sectorCount(sectors, sectorsPerPage);
+    uint32_t length = VMEM_JOURNAL_BLOCK + count * VMEM_SECTOR_BYTES;
+    if (_offset + length > _journalSize) return 0;
+
+    // Sector data in ascending order after the record block
+    uint8_t* data = _staging + VMEM_JOURNAL_BLOCK;
+    for (uint32_t sector = 0; sector < sectorsPerPage; sector++) {
+        if (sectors[sector / 32] & (1UL << (sector % 32))) {
+            memcpy(data, page + sector * VMEM_SECTOR_BYTES, VMEM_SECTOR_BYTES);
+            data += VMEM_SECTOR_BYTES;
+        }
+    }
+
+    _pendingPage = virtualPage;
+    _pending.generation = _meta[virtualPage].generation + 1;
+    if (_pending.generation == 0) _pending.generation = 1;
+    _pending.crc = vmemCrc32(page, _pageSize);
+
+    memset(_staging, 0, VMEM_JOURNAL_BLOCK);
+    VMemJournalRecord* record = (VMemJournalRecord*)_staging;
+    record->magic = VMEM_JOURNAL_RECORD_MAGIC;
+    record->epoch = _epoch;
+    record->sequence = _sequence;
+    record->virtualPage = virtualPage;
+    record->generation = _pending.generation;
+    record->pageCrc = _pending.crc;
+    record->dataCrc = vmemCrc32(_staging + VMEM_JOURNAL_BLOCK, length - VMEM_JOURNAL_BLOCK);
+    record->sectors = count;
+    memcpy(record->dirtySectors, sectors, sizeof(record->dirtySectors));
+    record->crc = blockCrc(*record);
+
+    if (_storage->sideWriteAt(VMEM_SIDE_JOURNAL, _offset, _staging, length) != (int32_t)length) {
+        return -1;
+    }
+    _offset += length;
+    _sequence++;
+    return (int32_t)length;
+}
+
+void VMemJournal::commit() {
+    setMeta(_pendingPage, _pending);
+}
+
+void VMemJournal::setMeta(uint32_t virtualPage, const VMemPageMeta& meta) {
+    _meta[virtualPage] = meta;
+    uint32_t block = virtualPage / VMEM_META_PER_BLOCK;
+    if (!(_metaDirty[block / 8] & (1 << (block % 8)))) {
+        _metaDirty[block / 8] |= 1 << (block % 8);
+        _metaDirtyCount++;
+    }
+}
+
+bool VMemJournal::checkpoint() {
+    // Nothing logged since the last checkpoint
+    if (_epoch != 0 && _offset == VMEM_JOURNAL_BLOCK && _metaDirtyCount == 0) return true;
+
+    // The swap writes and page map the records cover must reach the card
+    // before the records are dropped
+    if (!_storage->sync()) return false;
+
+    if (!_metaHeaderWritten) {
+        if (!writeHeader(VMEM_SIDE_META, 0)) return false;
+        _metaHeaderWritten = true;
+    }
+
+    // Changed table blocks, one write per run
+    uint32_t tableBytes = _totalPages * sizeof(VMemPageMeta);
+    uint32_t block = 0;
+    while (block < _metaBlocks) {
+        if (!(_metaDirty[block / 8] & (1 << (block % 8)))) {
+            block++;
+            continue;
+        }
+        uint32_t runStart = block;
+        while (block < _metaBlocks && (_metaDirty[block / 8] & (1 << (block % 8)))) {
+            _metaDirty[block / 8] &= ~(1 << (block % 8));
+            block++;
+        }
+        uint32_t offset = runStart * VMEM_JOURNAL_BLOCK;
+        uint32_t end = block * VMEM_JOURNAL_BLOCK;
+        if (end > tableBytes) end = tableBytes;
+        if (_storage->sideWriteAt(VMEM_SIDE_META, VMEM_JOURNAL_BLOCK + offset,
+                                  (const uint8_t*)_meta + offset, end - offset) != (int32_t)(end - offset)) {
+            // Keep the rest marked; the journal still covers these pages
+            for (uint32_t b = runStart; b < block; b++) {
+                _metaDirty[b / 8] |= 1 << (b % 8);
+            }
+            return false;
+        }
+        _metaDirtyCount -= block - runStart;
+    }
+
+    // New epoch: every existing record becomes stale
+    if (!writeHeader(VMEM_SIDE_JOURNAL, _epoch + 1)) return false;
+    _epoch++;
+    _sequence = 0;
+    _offset = VMEM_JOURNAL_BLOCK;
+    return true;
+}
+
+bool VMemJournal::verify(uint32_t virtualPage, const uint8_t* page) const {
+    const VMemPageMeta& meta = _meta[virtualPage];
+    return meta.generation == 0 || vmemCrc32(page, _pageSize) == meta.crc;
+}
+
+#endif // VIRTUAL_MEMORY
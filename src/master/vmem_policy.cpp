@@ -0,0 +1,449 @@
+#include "shared/config.h"
+
+#if VIRTUAL_MEMORY
+
+#include "master/vmem_policy.h"
+#include <stdlib.h>
+#include <string.h>
+
+// =============================================================================
+// LRU
+// =============================================================================
+
+VMemLruPolicy::VMemLruPolicy()
+    : _stamps(nullptr)
+    , _slots(0)
+    , _clock(0)
+{
+}
+
+bool VMemLruPolicy::init(VMemAllocator* allocator, uint32_t slots, uint32_t totalPages) {
+    (void)allocator;
+    (void)totalPages;
+    release();
+    _stamps = (uint32_t*)calloc(slots, sizeof(uint32_t));
+    _slots = slots;
+    _clock = 0;
+    return _stamps != nullptr;
+}
+
+void VMemLruPolicy::release() {
+    free(_stamps);
+    _stamps = nullptr;
+    _slots = 0;
+}
+
+int32_t VMemLruPolicy::victim(uint32_t incoming, VMemEvictableFn evictable, void* context) {
+    (void)incoming;
+
+    // Oldest stamp by age, so the 32-bit counter may wrap
+    uint32_t now = VMEM_ATOMIC_LOAD(&_clock);
+    int32_t best = -1;
+    uint32_t bestAge = 0;
+
+    for (uint32_t i = 0; i < _slots; i++) {
+        uint32_t age = now - VMEM_ATOMIC_LOAD(&_stamps[i]);
+        if ((best < 0 || age > bestAge) && evictable(i, context)) {
+            best = i;
+            bestAge = age;
+        }
+    }
+    return best;
+}
+
+// =============================================================================
+// CLOCK
+// =============================================================================
+
+VMemClockPolicy::VMemClockPolicy()
+    : _referenced(nullptr)
+    , _slots(0)
+    , _hand(0)
+{
+}
+
+bool VMemClockPolicy::init(VMemAllocator* allocator, uint32_t slots, uint32_t totalPages) {
+    (void)allocator;
+    (void)totalPages;
+    release();
+    _referenced = (uint8_t*)calloc(slots, 1);
+    _slots = slots;
+    _hand = 0;
+    return _referenced != nullptr;
+}
+
+void VMemClockPolicy::release() {
+    free(_referenced);
+    _referenced = nullptr;
+    _slots = 0;
+}
+
+int32_t VMemClockPolicy::victim(uint32_t incoming, VMemEvictableFn evictable, void* context) {
+    (void)incoming;
+
+    // Two full turns clear every reference bit, so a third finds nothing new
+    for (uint32_t n = 0; n < 2 * _slots + 1; n++) {
+        uint32_t slot = _hand;
+        _hand = (_hand + 1 < _slots) ? _hand + 1 : 0;
+
+        if (!evictable(slot, context)) continue;
+        if (VMEM_ATOMIC_LOAD(&_referenced[slot])) {
+            VMEM_ATOMIC_STORE(&_referenced[slot], (uint8_t)0);  // Second chance
+            continue;
+        }
+        return slot;
+    }
+    return -1;
+}
+
+// =============================================================================
+// List-Based Policies
+// =============================================================================
+
+// Spread consecutive pages over the map
+static inline uint32_t ghostHash(uint32_t virtualPage) {
+    uint32_t h = virtualPage * 2654435761UL;
+    return h ^ (h >> 16);
+}
+
+VMemListPolicy::VMemListPolicy()
+    : _nodes(nullptr)
+    , _pageOf(nullptr)
+    , _ghostMap(nullptr)
+    , _ghostMapMask(0)
+    , _allocator(nullptr)
+    , _slots(0)
+    , _totalPages(0)
+    , _freeGhost(VMEM_POLICY_NONE)
+{
+    memset(_lists, 0, sizeof(_lists));
+}
+
+bool VMemListPolicy::init(VMemAllocator* allocator, uint32_t slots, uint32_t totalPages,
+                          uint32_t ghosts) {
+    release();
+    if (!allocator) return false;
+    if (ghosts == 0) ghosts = 1;
+    uint32_t nodes = slots + ghosts;
+    if (nodes >= VMEM_POLICY_NONE) return false;
+
+    // At most half full keeps the probe runs short
+    uint32_t mapSize = 2;
+    while (mapSize < 2 * ghosts) {
+        mapSize <<= 1;
+    }
+
+    _allocator = allocator;
+    _nodes = (VMemPolicyNode*)calloc(nodes, sizeof(VMemPolicyNode));
+    _pageOf = (uint32_t*)calloc(nodes, sizeof(uint32_t));
+    _ghostMap = (uint16_t*)allocator->alloc(mapSize * sizeof(uint16_t));
+    if (!_nodes || !_pageOf || !_ghostMap) {
+        release();
+        return false;
+    }
+
+    _slots = slots;
+    _totalPages = totalPages;
+    _ghostMapMask = mapSize - 1;
+    for (uint32_t i = 0; i < mapSize; i++) {
+        _ghostMap[i] = VMEM_POLICY_NONE;
+    }
+    for (uint32_t i = 0; i < 4; i++) {
+        _lists[i].head = VMEM_POLICY_NONE;
+        _lists[i].tail = VMEM_POLICY_NONE;
+        _lists[i].size = 0;
+    }
+    for (uint32_t i = 0; i < nodes; i++) {
+        _nodes[i].list = NO_LIST;
+        _nodes[i].prev = VMEM_POLICY_NONE;
+        _nodes[i].next = VMEM_POLICY_NONE;
+    }
+
+    // Ghost nodes start on the free list
+    _freeGhost = VMEM_POLICY_NONE;
+    for (uint32_t i = nodes; i > slots; i--) {
+        _nodes[i - 1].next = _freeGhost;
+        _freeGhost = (uint16_t)(i - 1);
+    }
+    return true;
+}
+
+void VMemListPolicy::release() {
+    free(_nodes);
+    free(_pageOf);
+    if (_ghostMap) {
+        _allocator->release(_ghostMap);
+    }
+    _nodes = nullptr;
+    _pageOf = nullptr;
+    _ghostMap = nullptr;
+    _ghostMapMask = 0;
+    _slots = 0;
+}
+
+void VMemListPolicy::pushHead(uint8_t list, uint16_t node) {
+    VMemPolicyList& l = _lists[list];
+    VMemPolicyNode& n = _nodes[node];
+    n.list = list;
+    n.prev = VMEM_POLICY_NONE;
+    n.next = l.head;
+    if (l.head != VMEM_POLICY_NONE) {
+        _nodes[l.head].prev = node;
+    } else {
+        l.tail = node;
+    }
+    l.head = node;
+    l.size++;
+}
+
+void VMemListPolicy::unlink(uint16_t node) {
+    VMemPolicyNode& n = _nodes[node];
+    if (n.list == NO_LIST) return;
+
+    VMemPolicyList& l = _lists[n.list];
+    if (n.prev != VMEM_POLICY_NONE) {
+        _nodes[n.prev].next = n.next;
+    } else {
+        l.head = n.next;
+    }
+    if (n.next != VMEM_POLICY_NONE) {
+        _nodes[n.next].prev = n.prev;
+    } else {
+        l.tail = n.prev;
+    }
+    l.size--;
+    n.list = NO_LIST;
+    n.prev = VMEM_POLICY_NONE;
+    n.next = VMEM_POLICY_NONE;
+}
+
+void VMemListPolicy::replaceNode(uint16_t from, uint16_t to) {
+    // Put node 'to' where 'from' is, keeping the list position
+    VMemPolicyNode& src = _nodes[from];
+    _pageOf[to] = _pageOf[from];
+    if (src.list == NO_LIST) {
+        _nodes[to].list = NO_LIST;
+        return;
+    }
+
+    VMemPolicyList& l = _lists[src.list];
+    _nodes[to] = src;
+    if (src.prev != VMEM_POLICY_NONE) {
+        _nodes[src.prev].next = to;
+    } else {
+        l.head = to;
+    }
+    if (src.next != VMEM_POLICY_NONE) {
+        _nodes[src.next].prev = to;
+    } else {
+        l.tail = to;
+    }
+    src.list = NO_LIST;
+    src.prev = VMEM_POLICY_NONE;
+    src.next = VMEM_POLICY_NONE;
+}
+
+uint16_t VMemListPolicy::findGhost(uint32_t virtualPage) const {
+    if (!_ghostMap) return VMEM_POLICY_NONE;
+
+    // The map is never full, so every probe run ends at an empty entry
+    for (uint32_t i = ghostHash(virtualPage) & _ghostMapMask;; i = (i + 1) & _ghostMapMask) {
+        uint16_t node = _ghostMap[i];
+        if (node == VMEM_POLICY_NONE || _pageOf[node] == virtualPage) return node;
+    }
+}
+
+bool VMemListPolicy::addGhost(uint8_t list, uint32_t virtualPage) {
+    if (virtualPage >= _totalPages || _freeGhost == VMEM_POLICY_NONE) return false;
+
+    uint16_t node = _freeGhost;
+    _freeGhost = _nodes[node].next;
+    _pageOf[node] = virtualPage;
+
+    // Cached pages have no ghost, so the page is not in the map yet
+    uint32_t i = ghostHash(virtualPage) & _ghostMapMask;
+    while (_ghostMap[i] != VMEM_POLICY_NONE) {
+        i = (i + 1) & _ghostMapMask;
+    }
+    _ghostMap[i] = node;
+    pushHead(list, node);
+    return true;
+}
+
+void VMemListPolicy::dropGhost(uint16_t node) {
+    unlink(node);
+
+    uint32_t hole = ghostHash(_pageOf[node]) & _ghostMapMask;
+    while (_ghostMap[hole] != node) {
+        hole = (hole + 1) & _ghostMapMask;
+    }
+
+    // Shift later entries of the probe run back into the hole unless that
+    // would move them in front of their home entry
+    for (uint32_t i = (hole + 1) & _ghostMapMask; _ghostMap[i] != VMEM_POLICY_NONE;
+         i = (i + 1) & _ghostMapMask) {
+        uint32_t home = ghostHash(_pageOf[_ghostMap[i]]) & _ghostMapMask;
+        if (((i - home) & _ghostMapMask) >= ((i - hole) & _ghostMapMask)) {
+            _ghostMap[hole] = _ghostMap[i];
+            hole = i;
+        }
+    }
+    _ghostMap[hole] = VMEM_POLICY_NONE;
+
+    _nodes[node].next = _freeGhost;
+    _freeGhost = node;
+}
+
+int32_t VMemListPolicy::lastEvictable(uint8_t list, VMemEvictableFn evictable, void* context) {
+    for (uint16_t node = _lists[list].tail; node != VMEM_POLICY_NONE; node = _nodes[node].prev) {
+        if (evictable(node, context)) return node;
+    }
+    return -1;
+}
+
+// =============================================================================
+// 2Q
+// =============================================================================
+
+bool VMem2QPolicy::init(VMemAllocator* allocator, uint32_t slots, uint32_t totalPages) {
+    // Sizes recommended by the 2Q paper: A1in 25%, A1out 50% of the cache
+    _inTarget = slots / 4 ? slots / 4 : 1;
+    _outTarget = slots / 2 ? slots / 2 : 1;
+    return VMemListPolicy::init(allocator, slots, totalPages, _outTarget);
+}
+
+void VMem2QPolicy::touch(uint32_t slot) {
+    VMemLockGuard guard(_lock);
+    // Pages in A1in stay put - a burst of hits right after loading is
+    // not evidence of long-term reuse
+    if (_nodes[slot].list == AM) {
+        unlink(slot);
+        pushHead(AM, slot);
+    }
+}
+
+bool VMem2QPolicy::insert(uint32_t slot, uint32_t virtualPage) {
+    VMemLockGuard guard(_lock);
+    _pageOf[slot] = virtualPage;
+
+    uint16_t ghost = findGhost(virtualPage);
+    if (ghost != VMEM_POLICY_NONE) {
+        dropGhost(ghost);
+        pushHead(AM, slot);
+        return true;
+    }
+    pushHead(A1IN, slot);
+    return false;
+}
+
+void VMem2QPolicy::remove(uint32_t slot, bool evicted) {
+    VMemLockGuard guard(_lock);
+    bool probation = _nodes[slot].list == A1IN;
+    unlink(slot);
+
+    if (evicted && probation) {
+        if (_lists[A1OUT].size >= _outTarget) {
+            dropGhost(_lists[A1OUT].tail);
+        }
+        addGhost(A1OUT, _pageOf[slot]);
+    }
+}
+
+void VMem2QPolicy::move(uint32_t from, uint32_t to) {
+    VMemLockGuard guard(_lock);
+    replaceNode(from, to);
+}
+
+int32_t VMem2QPolicy::victim(uint32_t incoming, VMemEvictableFn evictable, void* context) {
+    (void)incoming;
+    VMemLockGuard guard(_lock);
+
+    uint8_t first = _lists[A1IN].size > _inTarget ? A1IN : AM;
+    int32_t slot = lastEvictable(first, evictable, context);
+    if (slot < 0) {
+        slot = lastEvictable(first == A1IN ? AM : A1IN, evictable, context);
+    }
+    return slot;
+}
+
+// =============================================================================
+// ARC
+// =============================================================================
+
+bool VMemArcPolicy::init(VMemAllocator* allocator, uint32_t slots, uint32_t totalPages) {
+    _target = 0;
+    return VMemListPolicy::init(allocator, slots, totalPages, slots);
+}
+
+void VMemArcPolicy::touch(uint32_t slot) {
+    VMemLockGuard guard(_lock);
+    if (_nodes[slot].list == T1 || _nodes[slot].list == T2) {
+        unlink(slot);
+        pushHead(T2, slot);
+    }
+}
+
+bool VMemArcPolicy::insert(uint32_t slot, uint32_t virtualPage) {
+    VMemLockGuard guard(_lock);
+    _pageOf[slot] = virtualPage;
+
+    uint16_t ghost = findGhost(virtualPage);
+    if (ghost != VMEM_POLICY_NONE) {
+        // Adapt the T1 target towards the list that would have kept the page
+        uint32_t b1 = _lists[B1].size;
+        uint32_t b2 = _lists[B2].size;
+        if (_nodes[ghost].list == B1) {
+            uint32_t delta = b1 && b2 / b1 > 1 ? b2 / b1 : 1;
+            _target = _target + delta < _slots ? _target + delta : _slots;
+        } else {
+            uint32_t delta = b2 && b1 / b2 > 1 ? b1 / b2 : 1;
+            _target = _target > delta ? _target - delta : 0;
+        }
+        dropGhost(ghost);
+        pushHead(T2, slot);
+        return true;
+    }
+
+    pushHead(T1, slot);
+    return false;
+}
+
+void VMemArcPolicy::remove(uint32_t slot, bool evicted) {
+    VMemLockGuard guard(_lock);
+    uint8_t list = _nodes[slot].list;
+    unlink(slot);
+    if (!evicted || (list != T1 && list != T2)) return;
+
+    // Keep the directory at most one cache worth of ghosts, trimming the
+    // recency side first once T1 + B1 reaches the cache size
+    if (_freeGhost == VMEM_POLICY_NONE) {
+        bool trimB1 = _lists[B1].size > 0 &&
+                      (_lists[T1].size + _lists[B1].size >= _slots || _lists[B2].size == 0);
+        dropGhost(_lists[trimB1 ? B1 : B2].tail);
+    }
+    addGhost(list == T1 ? B1 : B2, _pageOf[slot]);
+}
+
+void VMemArcPolicy::move(uint32_t from, uint32_t to) {
+    VMemLockGuard guard(_lock);
+    replaceNode(from, to);
+}
+
+int32_t VMemArcPolicy::victim(uint32_t incoming, VMemEvictableFn evictable, void* context) {
+    VMemLockGuard guard(_lock);
+
+    // REPLACE from the ARC paper: evict from T1 while it is above target
+    // (or at target when the incoming page is a B2 ghost), else from T2
+    uint32_t t1 = _lists[T1].size;
+    uint16_t ghost = findGhost(incoming);
+    bool inB2 = ghost != VMEM_POLICY_NONE && _nodes[ghost].list == B2;
+    uint8_t first = (t1 > 0 && (t1 > _target || (inB2 && t1 == _target))) ? T1 : T2;
+
+    int32_t slot = lastEvictable(first, evictable, context);
+    if (slot < 0) {
+        slot = lastEvictable(first == T1 ? T2 : T1, evictable, context);
+    }
+    return slot;
+}
+
+#endif // VIRTUAL_MEMORY
@@ -0,0 +1,433 @@
+#include "shared/config.h"
+
+#if VIRTUAL_MEMORY
+
+#include "master/vmem_tier.h"
+#include <string.h>
+
+// =============================================================================
+// LZ Codec
+// =============================================================================
+
+#define LZ_MAX_LITERALS     32
+#define LZ_MAX_DISTANCE     8192
+#define LZ_MIN_MATCH        3
+#define LZ_MAX_MATCH        (LZ_MIN_MATCH - 1 + 7 + 255)
+
+static inline uint32_t lzHash(const uint8_t* p) {
+    uint32_t v = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+    return (v * 2654435761u) >> (32 - VMEM_LZ_HASH_BITS);
+}
+
+size_t vmemLzCompress(const uint8_t* in, size_t inLength, uint8_t* out, size_t outCapacity,
+                      uint16_t* hashTable) {
+    if (inLength == 0 || inLength >= 0xFFFF || outCapacity < 2) return 0;
+
+    memset(hashTable, 0xFF, VMEM_LZ_HASH_SIZE * sizeof(uint16_t));
+
+    size_t ip = 0;
+    size_t op = 1;              // out[0] is the first literal control byte
+    size_t literalCtrl = 0;
+    uint32_t literals = 0;
+
+    while (ip < inLength) {
+        uint32_t ref = 0xFFFF;
+        if (ip + LZ_MIN_MATCH <= inLength) {
+            uint32_t h = lzHash(in + ip);
+            ref = hashTable[h];
+            hashTable[h] = (uint16_t)ip;
+        }
+
+        if (ref != 0xFFFF && ip - ref <= LZ_MAX_DISTANCE &&
+            in[ref] == in[ip] && in[ref + 1] == in[ip + 1] && in[ref + 2] == in[ip + 2]) {
+            // Extend the match
+            size_t maxLength = inLength - ip;
+            if (maxLength > LZ_MAX_MATCH) maxLength = LZ_MAX_MATCH;
+            size_t length = LZ_MIN_MATCH;
+            while (length < maxLength && in[ref + length] == in[ip + length]) {
+                length++;
+            }
+
+            // Close the pending literal run (or drop its unused control byte)
+            if (literals > 0) {
+                out[literalCtrl] = (uint8_t)(literals - 1);
+            } else {
+                op--;
+            }
+
+            if (op + 4 > outCapacity) return 0;
+
+            uint32_t distance = (uint32_t)(ip - ref - 1);
+            uint32_t code = (uint32_t)(length - 2);
+            if (code < 7) {
+                out[op++] = (uint8_t)((code << 5) | (distance >> 8));
+            } else {
+                out[op++] = (uint8_t)((7 << 5) | (distance >> 8));
+                out[op++] = (uint8_t)(code - 7);
+            }
+            out[op++] = (uint8_t)(distance & 0xFF);
+
+            ip += length;
+
+            // Open the next literal run
+            literalCtrl = op++;
+            literals = 0;
+            continue;
+        }
+
+        if (op >= outCapacity) return 0;
+        out[op++] = in[ip++];
+        literals++;
+
+        if (literals == LZ_MAX_LITERALS) {
+            out[literalCtrl] = LZ_MAX_LITERALS - 1;
+            if (op >= outCapacity) return 0;
+            literalCtrl = op++;
+            literals = 0;
+        }
+    }
+
+    if (literals > 0) {
+        out[literalCtrl] = (uint8_t)(literals - 1);
+    } else {
+        op--;
+    }
+
+    return op;
+}
+
+bool vmemLzDecompress(const uint8_t* in, size_t inLength, uint8_t* out, size_t outLength) {
+    size_t ip = 0;
+    size_t op = 0;
+
+    while (ip < inLength) {
+        uint32_t ctrl = in[ip++];
+
+        if (ctrl < LZ_MAX_LITERALS) {
+            size_t count = ctrl + 1;
+            if (ip + count > inLength || op + count > outLength) return false;
+            memcpy(out + op, in + ip, count);
+            ip += count;
+            op += count;
+            continue;
+        }
+
+        uint32_t code = ctrl >> 5;
+        if (code == 7) {
+            if (ip >= inLength) return false;
+            code += in[ip++];
+        }
+        if (ip >= inLength) return false;
+
+        size_t distance = (((ctrl & 0x1F) << 8) | in[ip++]) + 1;
+        size_t length = code + 2;
+        if (distance > op || op + length > outLength) return false;
+
+        // Byte copy - source and destination may overlap (runs)
+        const uint8_t* src = out + op - distance;
+        for (size_t i = 0; i < length; i++) {
+            out[op + i] = src[i];
+        }
+        op += length;
+    }
+
+    return op == outLength;
+}
+
+// =============================================================================
+// Setup
+// =============================================================================
+
+VMemTier::VMemTier()
+    : _allocator(nullptr)
+    , _pool(nullptr)
+    , _chunkNext(nullptr)
+    , _chunkCount(0)
+    , _freeChunk(VMEM_TIER_NONE)
+    , _freeChunks(0)
+    , _entries(nullptr)
+    , _freeEntry(VMEM_TIER_NONE)
+    , _oldest(VMEM_TIER_NONE)
+    , _newest(VMEM_TIER_NONE)
+    , _index(nullptr)
+    , _totalPages(0)
+    , _pageSize(0)
+    , _maxCompressed(0)
+    , _hashTable(nullptr)
+    , _staging(nullptr)
+    , _gather(nullptr)
+    , _pageBuffer(nullptr)
+    , _pages(0)
+    , _bytes(0)
+    , _evictions(0)
+{
+}
+
+bool VMemTier::init(VMemAllocator* allocator, uint32_t poolSize, uint32_t totalPages,
+                    uint32_t pageSize) {
+    release();
+
+    _allocator = allocator;
+    _chunkCount = poolSize / VMEM_TIER_CHUNK_SIZE;
+    if (_chunkCount >= VMEM_TIER_NONE) _chunkCount = VMEM_TIER_NONE - 1;
+    if (_chunkCount == 0) return false;
+    _totalPages = totalPages;
+    _pageSize = pageSize;
+    // Pages that do not shrink below this are cheaper to keep on SD
+    _maxCompressed = pageSize * 3 / 4;
+
+    // Every entry holds at least one chunk, so chunkCount entries suffice
+    _pool = (uint8_t*)allocator->alloc(_chunkCount * VMEM_TIER_CHUNK_SIZE);
+    _chunkNext = (uint16_t*)allocator->alloc(_chunkCount * sizeof(uint16_t));
+    _entries = (VMemTierEntry*)allocator->alloc(_chunkCount * sizeof(VMemTierEntry));
+    _index = (uint16_t*)allocator->alloc(totalPages * sizeof(uint16_t));
+    _hashTable = (uint16_t*)allocator->alloc(VMEM_LZ_HASH_SIZE * sizeof(uint16_t));
+    _staging = (uint8_t*)allocator->alloc(_maxCompressed);
+    _gather = (uint8_t*)allocator->alloc(_maxCompressed);
+    _pageBuffer = (uint8_t*)allocator->alloc(pageSize);
+
+    if (!_pool || !_chunkNext || !_entries || !_index || !_hashTable || !_staging || !_gather || !_pageBuffer) {
+        release();
+        return false;
+    }
+
+    for (uint32_t i = 0; i < totalPages; i++) {
+        _index[i] = VMEM_TIER_NONE;
+    }
+    _oldest = VMEM_TIER_NONE;
+    _newest = VMEM_TIER_NONE;
+    _pages = 0;
+    _bytes = 0;
+    _evictions = 0;
+
+    // Thread every chunk and entry onto its free list
+    for (uint32_t i = 0; i < _chunkCount; i++) {
+        _chunkNext[i] = (i + 1 < _chunkCount) ? (uint16_t)(i + 1) : VMEM_TIER_NONE;
+        _entries[i].newer = (i + 1 < _chunkCount) ? (uint16_t)(i + 1) : VMEM_TIER_NONE;
+    }
+    _freeChunk = 0;
+    _freeChunks = _chunkCount;
+    _freeEntry = 0;
+
+    return true;
+}
+
+void VMemTier::release() {
+    if (_allocator) {
+        if (_pool) _allocator->release(_pool);
+        if (_chunkNext) _allocator->release(_chunkNext);
+        if (_entries) _allocator->release(_entries);
+        if (_index) _allocator->release(_index);
+        if (_hashTable) _allocator->release(_hashTable);
+        if (_staging) _allocator->release(_staging);
+        if (_gather) _allocator->release(_gather);
+        if (_pageBuffer) _allocator->release(_pageBuffer);
+    }
+    _pool = nullptr;
+    _chunkNext = nullptr;
+    _entries = nullptr;
+    _index = nullptr;
+    _hashTable = nullptr;
+    _staging = nullptr;
+    _gather = nullptr;
+    _pageBuffer = nullptr;
+    _chunkCount = 0;
+    _freeChunks = 0;
+    _pages = 0;
+    _bytes = 0;
+}
+
+// =============================================================================
+// Store / Fetch
+// =============================================================================
+
+uint32_t VMemTier::compress(const uint8_t* page) {
+    if (!_pool) return 0;
+    return (uint32_t)vmemLzCompress(page, _pageSize, _staging, _maxCompressed, _hashTable);
+}
+
+bool VMemTier::store(uint32_t virtualPage, uint32_t length, bool dirty,
+                     const uint32_t* dirtySectors, VMemTierWriteFn writeBack, void* context) {
+    if (!_pool || length == 0 || virtualPage >= _totalPages) return false;
+
+    // Replace any older copy
+    drop(virtualPage);
+
+    uint32_t chunksNeeded = (length + VMEM_TIER_CHUNK_SIZE - 1) / VMEM_TIER_CHUNK_SIZE;
+    if (chunksNeeded > _chunkCount) return false;
+    while (_freeChunks < chunksNeeded) {
+        if (!evictOldest(writeBack, context)) return false;
+    }
+
+    // Entry slots never run out before chunks do
+    uint16_t entry = _freeEntry;
+    VMemTierEntry& e = _entries[entry];
+    _freeEntry = e.newer;
+
+    // Scatter the staged data into a chunk chain
+    uint16_t first = _freeChunk;
+    uint16_t chunk = first;
+    for (uint32_t offset = 0; offset < length; offset += VMEM_TIER_CHUNK_SIZE) {
+        uint32_t n = length - offset;
+        if (n > VMEM_TIER_CHUNK_SIZE) n = VMEM_TIER_CHUNK_SIZE;
+        memcpy(_pool + (uint32_t)chunk * VMEM_TIER_CHUNK_SIZE, _staging + offset, n);
+        if (offset + VMEM_TIER_CHUNK_SIZE < length) {
+            chunk = _chunkNext[chunk];
+        }
+    }
+    _freeChunk = _chunkNext[chunk];
+    _chunkNext[chunk] = VMEM_TIER_NONE;
+    _freeChunks -= chunksNeeded;
+
+    e.virtualPage = virtualPage;
+    e.length = (uint16_t)length;
+    e.firstChunk = first;
+    e.dirty = dirty;
+    memcpy(e.dirtySectors, dirtySectors, sizeof(e.dirtySectors));
+
+    // Append as newest
+    e.older = _newest;
+    e.newer = VMEM_TIER_NONE;
+    if (_newest != VMEM_TIER_NONE) {
+        _entries[_newest].newer = entry;
+    } else {
+        _oldest = entry;
+    }
+    _newest = entry;
+
+    _index[virtualPage] = entry;
+    _pages++;
+    _bytes += length;
+    return true;
+}
+
+bool VMemTier::fetch(uint32_t virtualPage, uint8_t* page, bool* dirty, uint32_t* dirtySectors) {
+    if (!_pool || virtualPage >= _totalPages) return false;
+
+    uint16_t entry = _index[virtualPage];
+    if (entry == VMEM_TIER_NONE) return false;
+
+    if (!readEntry(entry, page)) {
+        // Corrupt pool data - drop it and fall back to storage
+        freeEntry(entry);
+        return false;
+    }
+
+    *dirty = _entries[entry].dirty;
+    memcpy(dirtySectors, _entries[entry].dirtySectors, sizeof(_entries[entry].dirtySectors));
+    freeEntry(entry);
+    return true;
+}
+
+void VMemTier::drop(uint32_t virtualPage) {
+    if (!_pool || virtualPage >= _totalPages) return;
+
+    uint16_t entry = _index[virtualPage];
+    if (entry != VMEM_TIER_NONE) {
+        freeEntry(entry);
+    }
+}
+
+void VMemTier::clear() {
+    while (_oldest != VMEM_TIER_NONE) {
+        freeEntry(_oldest);
+    }
+}
+
+int32_t VMemTier::flush(uint32_t firstPage, uint32_t lastPage,
+                        VMemTierWriteFn writeBack, void* context) {
+    if (!_pool) return 0;
+
+    int32_t written = 0;
+    bool ok = true;
+    for (uint16_t entry = _oldest; entry != VMEM_TIER_NONE; entry = _entries[entry].newer) {
+        VMemTierEntry& e = _entries[entry];
+        if (!e.dirty || e.virtualPage < firstPage || e.virtualPage > lastPage) continue;
+
+        if (!readEntry(entry, _pageBuffer) ||
+            !writeBack(e.virtualPage, _pageBuffer, e.dirtySectors, context)) {
+            ok = false;
+            continue;
+        }
+        e.dirty = false;
+        memset(e.dirtySectors, 0, sizeof(e.dirtySectors));
+        written++;
+    }
+    return ok ? written : -1;
+}
+
+// =============================================================================
+// Internal Helpers
+// =============================================================================
+
+bool VMemTier::readEntry(uint16_t entry, uint8_t* page) {
+    // Gather the chunk chain, then decompress (staging may hold a page
+    // waiting to be stored)
+    const VMemTierEntry& e = _entries[entry];
+    uint16_t chunk = e.firstChunk;
+    for (uint32_t offset = 0; offset < e.length; offset += VMEM_TIER_CHUNK_SIZE) {
+        if (chunk == VMEM_TIER_NONE) return false;
+        uint32_t n = e.length - offset;
+        if (n > VMEM_TIER_CHUNK_SIZE) n = VMEM_TIER_CHUNK_SIZE;
+        memcpy(_gather + offset, _pool + (uint32_t)chunk * VMEM_TIER_CHUNK_SIZE, n);
+        chunk = _chunkNext[chunk];
+    }
+    return vmemLzDecompress(_gather, e.length, page, _pageSize);
+}
+
+bool VMemTier::evictOldest(VMemTierWriteFn writeBack, void* context) {
+    uint16_t entry = _oldest;
+    if (entry == VMEM_TIER_NONE) return false;
+
+    VMemTierEntry& e = _entries[entry];
+    if (e.dirty) {
+        // Last copy of this data - it has to reach storage first
+        if (!readEntry(entry, _pageBuffer) ||
+            !writeBack(e.virtualPage, _pageBuffer, e.dirtySectors, context)) {
+            return false;
+        }
+    }
+
+    freeEntry(entry);
+    _evictions++;
+    return true;
+}
+
+void VMemTier::unlink(uint16_t entry) {
+    VMemTierEntry& e = _entries[entry];
+    if (e.older != VMEM_TIER_NONE) {
+        _entries[e.older].newer = e.newer;
+    } else {
+        _oldest = e.newer;
+    }
+    if (e.newer != VMEM_TIER_NONE) {
+        _entries[e.newer].older = e.older;
+    } else {
+        _newest = e.older;
+    }
+}
+
+void VMemTier::freeEntry(uint16_t entry) {
+    VMemTierEntry& e = _entries[entry];
+    unlink(entry);
+
+    // Return the chunk chain to the free list
+    uint16_t chunk = e.firstChunk;
+    uint32_t chunks = 1;
+    while (_chunkNext[chunk] != VMEM_TIER_NONE) {
+        chunk = _chunkNext[chunk];
+        chunks++;
+    }
+    _chunkNext[chunk] = _freeChunk;
+    _freeChunk = e.firstChunk;
+    _freeChunks += chunks;
+
+    _index[e.virtualPage] = VMEM_TIER_NONE;
+    _pages--;
+    _bytes -= e.length;
+
+    e.newer = _freeEntry;
+    _freeEntry = entry;
+}
+
+#endif // VIRTUAL_MEMORY
@@ -142,6 +142,24 @@ static void drawDiagnosticsContent() {
 
         snprintf(buf, sizeof(buf), "%llu MB", sdCardUsedBytes() / (1024 * 1024));
         DRAW_LINE("Used:", buf, COLOR_RPM_TEXT);
+
+        // Latency p50/p99 and card throughput since boot
+        static SdLatencyStats latency;
+        sdCardGetLatencyStats(&latency);
+        sdLatencyFormatShort(&latency.ops[SD_OP_READ], buf, sizeof(buf));
+        DRAW_LINE("Read:", buf, COLOR_RPM_TEXT);
+        sdLatencyFormatShort(&latency.ops[SD_OP_WRITE], buf, sizeof(buf));
+        DRAW_LINE("Write:", buf, COLOR_RPM_TEXT);
+
+        if (latency.slowCount > 0) {
+            const SdSlowOp& last = latency.slow[(latency.slowCount - 1) % SD_SLOW_TRACE_SIZE];
+            char time[12];
+            sdLatencyFormatTime(last.us, time, sizeof(time));
+            snprintf(buf, sizeof(buf), "%lu (last %s %s)", latency.slowCount, sdOpName(last.op), time);
+            DRAW_LINE("Slow ops:", buf, COLOR_WARNING);
+        } else {
+            DRAW_LINE("Slow ops:", "None", COLOR_RPM_TEXT);
+        }
     } else {
         DRAW_LINE("SD Card:", "Not Present", COLOR_DISCONNECTED);
     }
@@ -276,7 +294,7 @@ void screenSettingsHandleTouch(int16_t x, int16_t y, bool pressed) {
             } else if (touchState.lastTouchY >= 0) {
                 int16_t delta = touchState.lastTouchY - y;
                 if (abs(delta) > 3) {
-                    int maxScroll = 80;
+                    int maxScroll = 140;
                     diagScrollOffset += delta;
                     if (diagScrollOffset < 0) diagScrollOffset = 0;
                     if (diagScrollOffset > maxScroll) diagScrollOffset = maxScroll;
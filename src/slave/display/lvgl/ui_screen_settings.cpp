@@ -33,6 +33,9 @@ static lv_obj_t* lbl_fw_built = nullptr;
 static lv_obj_t* lbl_sd_status = nullptr;
 static lv_obj_t* lbl_sd_total = nullptr;
 static lv_obj_t* lbl_sd_used = nullptr;
+static lv_obj_t* lbl_sd_read = nullptr;
+static lv_obj_t* lbl_sd_write = nullptr;
+static lv_obj_t* lbl_sd_slow = nullptr;
 static lv_obj_t* lbl_wifi_mode = nullptr;
 static lv_obj_t* lbl_wifi_status = nullptr;
 static lv_obj_t* lbl_wifi_ssid = nullptr;
@@ -178,6 +181,9 @@ void ui_screen_settings_create() {
     lbl_sd_status = create_info_row(cont_diag, "SD Card:");
     lbl_sd_total = create_info_row(cont_diag, "Total:");
     lbl_sd_used = create_info_row(cont_diag, "Used:");
+    lbl_sd_read = create_info_row(cont_diag, "Read:");
+    lbl_sd_write = create_info_row(cont_diag, "Write:");
+    lbl_sd_slow = create_info_row(cont_diag, "Slow ops:");
     
     create_separator(cont_diag);
     
@@ -282,11 +288,34 @@ void ui_screen_settings_update() {
         
         snprintf(buf, sizeof(buf), "%llu MB", sdCardUsedBytes() / (1024 * 1024));
         lv_label_set_text(lbl_sd_used, buf);
+
+        // Latency p50/p99 and card throughput since boot
+        static SdLatencyStats latency;
+        sdCardGetLatencyStats(&latency);
+        sdLatencyFormatShort(&latency.ops[SD_OP_READ], buf, sizeof(buf));
+        lv_label_set_text(lbl_sd_read, buf);
+        sdLatencyFormatShort(&latency.ops[SD_OP_WRITE], buf, sizeof(buf));
+        lv_label_set_text(lbl_sd_write, buf);
+
+        if (latency.slowCount > 0) {
+            const SdSlowOp& last = latency.slow[(latency.slowCount - 1) % SD_SLOW_TRACE_SIZE];
+            char time[12];
+            sdLatencyFormatTime(last.us, time, sizeof(time));
+            snprintf(buf, sizeof(buf), "%lu (last %s %s)", latency.slowCount, sdOpName(last.op), time);
+            lv_label_set_text(lbl_sd_slow, buf);
+            lv_obj_set_style_text_color(lbl_sd_slow, UI_COLOR_WARNING, 0);
+        } else {
+            lv_label_set_text(lbl_sd_slow, "None");
+            lv_obj_set_style_text_color(lbl_sd_slow, UI_COLOR_ON_SURFACE, 0);
+        }
     } else {
         lv_label_set_text(lbl_sd_status, "Not Present");
         lv_obj_set_style_text_color(lbl_sd_status, UI_COLOR_ERROR, 0);
         lv_label_set_text(lbl_sd_total, "-");
         lv_label_set_text(lbl_sd_used, "-");
+        lv_label_set_text(lbl_sd_read, "-");
+        lv_label_set_text(lbl_sd_write, "-");
+        lv_label_set_text(lbl_sd_slow, "-");
     }
     
     // WiFi info
@@ -276,7 +276,9 @@ static void handlePackageServer() {
             uint8_t buffer[1024];
             size_t len = packageClient.read(buffer, sizeof(buffer));
             if (len > 0) {
-                packageFile.write(buffer, len);
+                uint32_t start = micros();
+                size_t written = packageFile.write(buffer, len);
+                sdCardRecordOp(SD_OP_WRITE, start, written, written == len, OTA_PACKAGE_PATH);
                 bytesReceived += len;
                 currentProgress = (bytesReceived * 100) / expectedBytes;
                 
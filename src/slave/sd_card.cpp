@@ -6,6 +6,59 @@
 static bool sdInitialized = false;
 static uint8_t cardType = CARD_NONE;
 
+// =============================================================================
+// Latency Statistics
+// =============================================================================
+
+static SdLatencyStats latency;
+static portMUX_TYPE latencyMux = portMUX_INITIALIZER_UNLOCKED;
+
+void sdCardRecordOp(SdOpType op, uint32_t startUs, uint32_t bytes, bool ok, const char* path) {
+    uint32_t us = micros() - startUs;
+    uint32_t nowMs = millis();
+    portENTER_CRITICAL(&latencyMux);
+    sdLatencyRecord(&latency, op, us, bytes, ok, path, nowMs, SD_SLOW_OP_US);
+    portEXIT_CRITICAL(&latencyMux);
+}
+
+void sdCardGetLatencyStats(SdLatencyStats* stats) {
+    portENTER_CRITICAL(&latencyMux);
+    *stats = latency;
+    portEXIT_CRITICAL(&latencyMux);
+}
+
+void sdCardResetLatencyStats() {
+    uint32_t nowMs = millis();
+    portENTER_CRITICAL(&latencyMux);
+    sdLatencyReset(&latency, nowMs);
+    portEXIT_CRITICAL(&latencyMux);
+}
+
+void sdCardPrintLatencyStats() {
+    static SdLatencyStats stats;    // Too large for the caller's stack
+    sdCardGetLatencyStats(&stats);
+
+    char line[112];
+    Serial.printf("SD latency over %lu s:\n", (millis() - stats.sinceMs) / 1000);
+    for (uint8_t op = 0; op < SD_OP_TYPES; op++) {
+        if (stats.ops[op].operations == 0) continue;
+        sdLatencyFormatLine(&stats.ops[op], op, line, sizeof(line));
+        Serial.printf("  %s\n", line);
+    }
+    if (stats.slowCount == 0) return;
+
+    Serial.printf("  %lu ops over %d ms, latest:\n", stats.slowCount, SD_SLOW_OP_US / 1000);
+    uint32_t shown = stats.slowCount < SD_SLOW_TRACE_SIZE ? stats.slowCount : SD_SLOW_TRACE_SIZE;
+    for (uint32_t i = 1; i <= shown; i++) {
+        sdLatencyFormatSlow(&stats.slow[(stats.slowCount - i) % SD_SLOW_TRACE_SIZE], line, sizeof(line));
+        Serial.printf("    %s\n", line);
+    }
+}
+
+// =============================================================================
+// Card
+// =============================================================================
+
 bool sdCardInit() {
     Serial.println("Initializing SD card (SDMMC)...");
     Serial.printf("  CLK: GPIO %d\n", SD_MMC_CLK);
@@ -31,6 +84,7 @@ bool sdCardInit() {
     }
 
     sdInitialized = true;
+    sdCardResetLatencyStats();
     Serial.printf("SD card initialized (SDMMC): %s\n", sdCardType());
     Serial.printf("SD card size: %llu MB\n", SD_MMC.cardSize() / (1024 * 1024));
 
@@ -66,8 +120,10 @@ char* sdCardReadFile(const char* path, size_t* length) {
         return nullptr;
     }
 
+    uint32_t start = micros();
     File file = SD_MMC.open(path, FILE_READ);
     if (!file) {
+        sdCardRecordOp(SD_OP_OPEN, start, 0, false, path);
         Serial.printf("Failed to open file: %s\n", path);
         *length = 0;
         return nullptr;
@@ -85,6 +141,7 @@ char* sdCardReadFile(const char* path, size_t* length) {
     size_t bytesRead = file.readBytes(buffer, fileSize);
     buffer[bytesRead] = '\0';
     file.close();
+    sdCardRecordOp(SD_OP_READ, start, bytesRead, bytesRead == fileSize, path);
 
     *length = bytesRead;
     return buffer;
@@ -93,14 +150,17 @@ char* sdCardReadFile(const char* path, size_t* length) {
 bool sdCardWriteFile(const char* path, const uint8_t* data, size_t length) {
     if (!sdInitialized) return false;
 
+    uint32_t start = micros();
     File file = SD_MMC.open(path, FILE_WRITE);
     if (!file) {
+        sdCardRecordOp(SD_OP_OPEN, start, 0, false, path);
         Serial.printf("Failed to open file for writing: %s\n", path);
         return false;
     }
 
     size_t written = file.write(data, length);
     file.close();
+    sdCardRecordOp(SD_OP_WRITE, start, written, written == length, path);
 
     if (written != length) {
         Serial.printf("Write incomplete: %zu of %zu bytes\n", written, length);
@@ -113,26 +173,35 @@ bool sdCardWriteFile(const char* path, const uint8_t* data, size_t length) {
 bool sdCardAppendFile(const char* path, const uint8_t* data, size_t length) {
     if (!sdInitialized) return false;
 
+    uint32_t start = micros();
     File file = SD_MMC.open(path, FILE_APPEND);
     if (!file) {
+        sdCardRecordOp(SD_OP_OPEN, start, 0, false, path);
         Serial.printf("Failed to open file for appending: %s\n", path);
         return false;
     }
 
     size_t written = file.write(data, length);
     file.close();
+    sdCardRecordOp(SD_OP_WRITE, start, written, written == length, path);
 
     return (written == length);
 }
 
 bool sdCardFileExists(const char* path) {
     if (!sdInitialized) return false;
-    return SD_MMC.exists(path);
+    uint32_t start = micros();
+    bool exists = SD_MMC.exists(path);
+    sdCardRecordOp(SD_OP_META, start, 0, true, path);
+    return exists;
 }
 
 bool sdCardDeleteFile(const char* path) {
     if (!sdInitialized) return false;
-    return SD_MMC.remove(path);
+    uint32_t start = micros();
+    bool success = SD_MMC.remove(path);
+    sdCardRecordOp(SD_OP_META, start, 0, success, path);
+    return success;
 }
 
 void sdCardListDir(const char* dirname, uint8_t levels) {
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include "shared/sd_latency.h"
 
 // Initialize SD card
 bool sdCardInit();
@@ -33,4 +34,14 @@ bool sdCardDeleteFile(const char* path);
 // List files in directory (for diagnostics)
 void sdCardListDir(const char* dirname, uint8_t levels);
 
+// Latency histograms per operation type, throughput and the slow-op trace
+// (operations of at least SD_SLOW_OP_US). Counted since init or reset.
+void sdCardGetLatencyStats(SdLatencyStats* stats);
+void sdCardResetLatencyStats();
+void sdCardPrintLatencyStats();
+
+// Record an operation timed by code that uses SD_MMC directly
+// (startUs from micros() before the operation)
+void sdCardRecordOp(SdOpType op, uint32_t startUs, uint32_t bytes, bool ok, const char* path);
+
 #endif // SD_CARD_H
@@ -152,8 +152,10 @@ size_t spiOtaReadChunk(uint16_t chunkIndex, uint8_t* buffer, size_t maxLen) {
         return 0;
     }
     
+    uint32_t start = micros();
     fs::File f = SD_MMC.open(OTA_CONTROLLER_FW_PATH, FILE_READ);
     if (!f) {
+        sdCardRecordOp(SD_OP_OPEN, start, 0, false, OTA_CONTROLLER_FW_PATH);
         return 0;
     }
     
@@ -173,6 +175,7 @@ size_t spiOtaReadChunk(uint16_t chunkIndex, uint8_t* buffer, size_t maxLen) {
     
     size_t read = f.read(buffer, toRead);
     f.close();
+    sdCardRecordOp(SD_OP_READ, start, read, read == toRead, OTA_CONTROLLER_FW_PATH);
     
     return read;
 }
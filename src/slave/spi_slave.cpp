@@ -20,6 +20,11 @@ static volatile uint32_t invalidPacketCount = 0;
 static volatile uint8_t requestedMode = MODE_AUTO;
 static volatile uint16_t requestedRpm = 3000;
 
+// CAN statistics from the master's last dump
+static SpiCanStats canStats;
+static SpiCanStatsRow canStatsRows[CAN_STATS_LINK_ROWS];
+static bool canStatsReceived = false;
+
 // Track previous connection state for reconnection sync
 static volatile bool wasConnected = false;
 static volatile bool justReconnected = false;
@@ -103,6 +108,35 @@ void spiSlaveSetRequest(uint8_t mode, uint16_t rpm) {
     packSlavePacket(txBuffer, requestedMode, requestedRpm);
 }
 
+// One packet of a CAN statistics dump; a summary starts a new dump
+static void storeCanStats(const uint8_t* packet) {
+    uint8_t kind = packet[1] >> 6;
+    uint8_t row = packet[1] & 0x3F;
+    const uint8_t* p = packet + 2;
+
+    if (kind == CAN_STATS_KIND_SUMMARY) {
+        canStats.load = (p[0] | (p[1] << 8)) / 1000.0f;
+        canStats.ids = p[2];
+        canStats.framesPerSec = p[3] | (p[4] << 8);
+        canStats.rows = 0;
+        canStats.receivedMs = millis();
+        canStatsReceived = true;
+    } else if (kind == CAN_STATS_KIND_ID) {
+        uint32_t id = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+        canStatsRows[row].id = id & ~CAN_STATS_EXTENDED_BIT;
+        canStatsRows[row].extended = (id & CAN_STATS_EXTENDED_BIT) != 0;
+        canStatsRows[row].changed = p[4];
+    } else if (kind == CAN_STATS_KIND_TIMING) {
+        canStatsRows[row].periodUs = (p[0] | (p[1] << 8)) * 100UL;
+        canStatsRows[row].jitterUs = (p[2] | (p[3] << 8)) * 10UL;
+        canStatsRows[row].dlc = p[4] & 0x0F;
+        canStatsRows[row].rtr = (p[4] & 0x80) != 0;
+        if (row + 1u > canStats.rows) {
+            canStats.rows = row + 1;
+        }
+    }
+}
+
 void spiSlaveProcess() {
     // Check if user has initiated controller OTA update
     // Only enter OTA mode when user explicitly pressed Update button
@@ -155,6 +189,12 @@ void spiSlaveProcess() {
                     validPacketCount++;
                 }
             } 
+            // CAN statistics dump (header 0xCC)
+            else if (!otaBulkMode && validateCanStatsPacket(currentRxBuffer)) {
+                storeCanStats(currentRxBuffer);
+                lastPacketTime = millis();
+                validPacketCount++;
+            }
             // Normal SPI packet (header 0xAA)
             else if (validateSpiPacket(currentRxBuffer)) {
                 // If we were in OTA bulk mode but received normal packet,
@@ -307,6 +347,19 @@ uint16_t spiSlaveGetRequestedRpm() {
     return requestedRpm;
 }
 
+bool spiSlaveGetCanStats(SpiCanStats* stats) {
+    *stats = canStats;
+    return canStatsReceived;
+}
+
+bool spiSlaveGetCanStatsRow(uint32_t row, SpiCanStatsRow* out) {
+    if (!canStatsReceived || row >= canStats.rows) {
+        return false;
+    }
+    *out = canStatsRows[row];
+    return true;
+}
+
 bool spiSlaveCheckReconnected() {
     if (justReconnected) {
         justReconnected = false;
@@ -3,6 +3,7 @@
 #include "slave/ota_handler.h"
 #include "display/display.h"
 #include "display/lvgl/ui_screen_main.h"
+#include "sd_card.h"
 #include "usb_msc.h"
 #include "shared/config.h"
 #include "shared/protocol.h"
@@ -305,6 +306,34 @@ static void taskSerial(void* parameter) {
                     Serial.println();
                     break;
 
+                case 'n':
+                case 'N': {
+                    SpiCanStats stats;
+                    Serial.println("\n=== CAN Bus (from master) ===");
+                    if (!spiSlaveGetCanStats(&stats)) {
+                        Serial.println("No dump received (master: is)");
+                        Serial.println();
+                        break;
+                    }
+                    Serial.printf("Received %lu s ago: load %.1f%%, %lu frames/s, %lu IDs\n",
+                                  (millis() - stats.receivedMs) / 1000, stats.load * 100.0f,
+                                  stats.framesPerSec, stats.ids);
+                    SpiCanStatsRow row;
+                    for (uint32_t i = 0; spiSlaveGetCanStatsRow(i, &row); i++) {
+                        char changed[9];
+                        for (uint32_t b = 0; b < 8; b++) {
+                            changed[b] = (row.changed & (1u << b)) ? (char)('0' + b) : '.';
+                        }
+                        changed[8] = '\0';
+                        Serial.printf(row.extended ? "  0x%08lX" : "  0x%03lX     ", row.id);
+                        Serial.printf("  period %7.1f ms  jitter %6.2f ms  %sDLC %u  changed %s\n",
+                                      row.periodUs / 1000.0f, row.jitterUs / 1000.0f,
+                                      row.rtr ? "RTR " : "", row.dlc, changed);
+                    }
+                    Serial.println();
+                    break;
+                }
+
                 case 'o':
                 case 'O':
                     Serial.println("\n=== OTA Status ===");
@@ -324,6 +353,21 @@ static void taskSerial(void* parameter) {
                     Serial.println();
                     break;
 
+                case 's':
+                case 'S':
+                    Serial.println();
+                    if (sdCardPresent()) {
+                        sdCardPrintLatencyStats();
+                        if (cmd == 'S') {
+                            sdCardResetLatencyStats();
+                            Serial.println("SD latency reset");
+                        }
+                    } else {
+                        Serial.println("SD card not present");
+                    }
+                    Serial.println();
+                    break;
+
                 case '?':
                 case 'h':
                 case 'H':
@@ -334,6 +378,8 @@ static void taskSerial(void* parameter) {
                     Serial.println("  w - Show WiFi status");
                     Serial.println("  o - Show OTA status");
                     Serial.println("  r - Reset OTA state");
+                    Serial.println("  s - SD latency (S - and reset)");
+                    Serial.println("  n - CAN bus statistics from master");
 #if PRODUCTION_BUILD
                     Serial.println("  e - Eject USB mass storage");
 #endif
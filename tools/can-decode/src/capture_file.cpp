@@ -0,0 +1,89 @@
+#include "capture_file.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// =============================================================================
+// Mapping
+// =============================================================================
+
+CaptureFile::~CaptureFile() {
+    if (_data) {
+        munmap(const_cast<uint8_t*>(_data), _size);
+    }
+}
+
+bool CaptureFile::open(const std::string& path, std::string* error) {
+    _path = path;
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        *error = std::strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        *error = std::strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    if (st.st_size == 0) {
+        ::close(fd);
+        return true;
+    }
+
+    void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        *error = std::strerror(errno);
+        return false;
+    }
+    _data = static_cast<const uint8_t*>(map);
+    _size = static_cast<uint64_t>(st.st_size);
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    // Index the blocks in file order
+    uint8_t magic[4];
+    const uint32_t magicValue = CAN_CAPTURE_MAGIC;
+    std::memcpy(magic, &magicValue, sizeof(magic));
+
+    uint64_t pos = 0;
+    bool skipping = false;
+    while (pos < _size) {
+        uint32_t length = 0;
+        if (_data[pos] == magic[0] && _size - pos >= sizeof(magic) &&
+            std::memcmp(_data + pos, magic, sizeof(magic)) == 0) {
+            length = canCaptureBlockLength(_data + pos, _size - pos);
+        }
+        if (length > 0) {
+            Block block;
+            std::memcpy(&block.header, _data + pos, sizeof(block.header));
+            block.records = _data + pos + sizeof(CanCaptureBlockHeader);
+            _blocks.push_back(block);
+            pos += length;
+            skipping = false;
+            continue;
+        }
+
+        // Not a block: jump to the next possible magic
+        if (!skipping) {
+            _skippedRegions++;
+            skipping = true;
+        }
+        const void* next = std::memchr(_data + pos + 1, magic[0], _size - pos - 1);
+        uint64_t to = next ? static_cast<uint64_t>(static_cast<const uint8_t*>(next) - _data) : _size;
+        _skippedBytes += to - pos;
+        pos = to;
+    }
+    return true;
+}
+
+void CaptureFile::frame(size_t block, uint32_t record, CanFrame* frame) const {
+    CanCaptureRecord r;
+    std::memcpy(&r, _blocks[block].records + record * sizeof(CanCaptureRecord), sizeof(r));
+    canCaptureDecode(&_blocks[block].header, &r, frame);
+}
@@ -0,0 +1,55 @@
+#ifndef CAPTURE_FILE_H
+#define CAPTURE_FILE_H
+
+#include "master/can_capture_log.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// =============================================================================
+// Memory-Mapped CAN Capture
+// =============================================================================
+// One capture from the master - a /can/NNNNN.cap file, or a USB stream
+// saved to disk - mapped read-only. Blocks have no fixed stride, so open()
+// walks the file once: a block is wherever the block magic starts a block
+// whose CRC checks out. Anything else (log text between blocks in a USB
+// stream, a block torn by a power loss) is skipped and counted.
+
+class CaptureFile {
+public:
+    CaptureFile() = default;
+    ~CaptureFile();
+    CaptureFile(const CaptureFile&) = delete;
+    CaptureFile& operator=(const CaptureFile&) = delete;
+
+    // Map and index the blocks; error says why it failed
+    bool open(const std::string& path, std::string* error);
+
+    const std::string& path() const { return _path; }
+    uint64_t size() const { return _size; }
+
+    size_t blockCount() const { return _blocks.size(); }
+    const CanCaptureBlockHeader& header(size_t block) const { return _blocks[block].header; }
+
+    // Record of a block back to a frame
+    void frame(size_t block, uint32_t record, CanFrame* frame) const;
+
+    uint64_t skippedBytes() const { return _skippedBytes; }
+    uint32_t skippedRegions() const { return _skippedRegions; }
+
+private:
+    struct Block {
+        CanCaptureBlockHeader header;
+        const uint8_t* records;
+    };
+
+    std::string _path;
+    const uint8_t* _data = nullptr;
+    uint64_t _size = 0;
+    std::vector<Block> _blocks;
+    uint64_t _skippedBytes = 0;
+    uint32_t _skippedRegions = 0;
+};
+
+#endif // CAPTURE_FILE_H
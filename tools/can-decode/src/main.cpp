@@ -0,0 +1,422 @@
+#include "capture_file.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// =============================================================================
+// Constants
+// =============================================================================
+
+constexpr uint32_t DEFAULT_BITRATE = 500000;
+
+// Frame length on the wire without stuff bits, interframe space included
+constexpr uint32_t STANDARD_FRAME_BITS = 47;
+constexpr uint32_t EXTENDED_FRAME_BITS = 67;
+
+// =============================================================================
+// Options
+// =============================================================================
+
+struct DecodeOptions {
+    std::string output;             // Log destination, stdout if empty
+    std::string interface = "can0"; // candump interface name
+    uint32_t channel = 1;           // ASC channel
+    uint32_t bitrate = DEFAULT_BITRATE;
+};
+
+// =============================================================================
+// Usage
+// =============================================================================
+
+static void printUsage(const char* progName) {
+    std::cout << "can-decode - Reader for master CAN captures (/can/NNNNN.cap or a USB stream)\n\n";
+    std::cout << "Usage:\n";
+    std::cout << "  " << progName << " info <files...> [--bitrate <n>]\n";
+    std::cout << "      Blocks, frames, bus load, and whether any frame was lost\n\n";
+    std::cout << "  " << progName << " candump <files...> [options]\n";
+    std::cout << "      Export as a candump -L log (canplayer, python-can, SavvyCAN)\n\n";
+    std::cout << "  " << progName << " asc <files...> [options]\n";
+    std::cout << "      Export as a Vector ASC log\n\n";
+    std::cout << "Files are read in the order given; a capture split over several files\n";
+    std::cout << "continues from one to the next.\n\n";
+    std::cout << "Options:\n";
+    std::cout << "  -o, --output <file>    Log output (default: stdout)\n";
+    std::cout << "  --interface <name>     candump interface (default: can0)\n";
+    std::cout << "  --channel <n>          ASC channel (default: 1)\n";
+    std::cout << "  --bitrate <n>          Bus bit rate for the load figures (default: "
+              << DEFAULT_BITRATE << ")\n";
+    std::cout << "  --help                 Show this help\n";
+}
+
+// =============================================================================
+// Captures
+// =============================================================================
+// Block sequence numbers restart at 0 with each capture, so one USB stream
+// or one run of files can hold several.
+
+struct CaptureSummary {
+    uint32_t firstSequence = 0;
+    uint32_t blocks = 0;
+    uint32_t missingBlocks = 0;     // Sequence gaps: blocks lost on the way
+    uint64_t frames = 0;
+    uint32_t dropped = 0;           // No free buffer on the master
+    uint32_t overruns = 0;          // Controller overruns
+    uint64_t firstUs = 0;
+    uint64_t lastUs = 0;
+    uint64_t busiestFrames = 0;     // In one whole second
+    uint64_t busiestBits = 0;
+
+    bool complete() const { return missingBlocks == 0 && dropped == 0 && overruns == 0; }
+};
+
+static uint32_t frameBits(const CanFrame& frame) {
+    uint32_t bits = (frame.flags & CAN_FRAME_EXTENDED) ? EXTENDED_FRAME_BITS : STANDARD_FRAME_BITS;
+    return (frame.flags & CAN_FRAME_RTR) ? bits : bits + 8 * frame.dlc;
+}
+
+// Every frame in file and block order, summarized per capture
+static std::vector<CaptureSummary> walk(const std::vector<std::unique_ptr<CaptureFile>>& files,
+                                        const std::function<void(const CanFrame&)>& onFrame) {
+    std::vector<CaptureSummary> captures;
+    uint32_t nextSequence = 0;
+    uint64_t second = UINT64_MAX;
+    uint64_t secondFrames = 0;
+    uint64_t secondBits = 0;
+
+    auto endSecond = [&]() {
+        if (captures.empty()) return;
+        CaptureSummary& c = captures.back();
+        if (secondBits > c.busiestBits) {
+            c.busiestBits = secondBits;
+            c.busiestFrames = secondFrames;
+        }
+        secondFrames = 0;
+        secondBits = 0;
+    };
+
+    for (const auto& file : files) {
+        for (size_t b = 0; b < file->blockCount(); b++) {
+            const CanCaptureBlockHeader& h = file->header(b);
+            if (captures.empty() || h.sequence < nextSequence) {
+                endSecond();
+                second = UINT64_MAX;
+                captures.emplace_back();
+                captures.back().firstSequence = h.sequence;
+                captures.back().missingBlocks = h.sequence;
+                captures.back().firstUs = h.firstTimeUs;
+            } else {
+                captures.back().missingBlocks += h.sequence - nextSequence;
+            }
+            nextSequence = h.sequence + 1;
+
+            CaptureSummary& c = captures.back();
+            c.blocks++;
+            c.frames += h.recordCount;
+            c.dropped = std::max(c.dropped, h.dropped);
+            c.overruns = std::max(c.overruns, h.overruns);
+
+            for (uint32_t r = 0; r < h.recordCount; r++) {
+                CanFrame frame;
+                file->frame(b, r, &frame);
+                c.lastUs = std::max(c.lastUs, frame.timeUs);
+
+                // Load per whole second of the esp_timer clock
+                if (frame.timeUs / 1000000 != second) {
+                    endSecond();
+                    second = frame.timeUs / 1000000;
+                }
+                secondFrames++;
+                secondBits += frameBits(frame);
+
+                if (onFrame) onFrame(frame);
+            }
+        }
+    }
+    endSecond();
+    return captures;
+}
+
+// =============================================================================
+// Helpers
+// =============================================================================
+
+static bool openFiles(const std::vector<std::string>& paths,
+                      std::vector<std::unique_ptr<CaptureFile>>& files) {
+    for (const std::string& path : paths) {
+        auto file = std::make_unique<CaptureFile>();
+        std::string error;
+        if (!file->open(path, &error)) {
+            std::cerr << "Error: " << path << ": " << error << "\n";
+            return false;
+        }
+        files.push_back(std::move(file));
+    }
+    return true;
+}
+
+static FILE* openOutput(const DecodeOptions& opts) {
+    if (opts.output.empty()) {
+        return stdout;
+    }
+    FILE* out = fopen(opts.output.c_str(), "wb");
+    if (!out) {
+        std::cerr << "Error: cannot create " << opts.output << ": " << std::strerror(errno) << "\n";
+    }
+    return out;
+}
+
+// Keep stdout clean for the log itself
+static int finishOutput(FILE* out, const std::vector<CaptureSummary>& captures) {
+    bool ok = !ferror(out);
+    if (out != stdout && fclose(out) != 0) {
+        ok = false;
+    }
+    if (!ok) {
+        std::cerr << "Error: write failed: " << std::strerror(errno) << "\n";
+        return 1;
+    }
+
+    uint64_t frames = 0;
+    bool complete = true;
+    for (const CaptureSummary& c : captures) {
+        frames += c.frames;
+        complete = complete && c.complete();
+    }
+    std::cerr << frames << " frames from " << captures.size() << " capture"
+              << (captures.size() == 1 ? "" : "s");
+    if (!complete) {
+        std::cerr << ", INCOMPLETE (see info)";
+    }
+    std::cerr << "\n";
+    return 0;
+}
+
+static void formatData(const CanFrame& frame, char* text, bool spaced) {
+    static const char HEX[] = "0123456789ABCDEF";
+    char* p = text;
+    uint8_t length = frame.dlc < 8 ? frame.dlc : 8;
+    for (uint8_t i = 0; i < length; i++) {
+        if (spaced) *p++ = ' ';
+        *p++ = HEX[frame.data[i] >> 4];
+        *p++ = HEX[frame.data[i] & 0x0F];
+    }
+    *p = '\0';
+}
+
+// =============================================================================
+// Commands
+// =============================================================================
+
+static int cmdInfo(const std::vector<std::unique_ptr<CaptureFile>>& files, const DecodeOptions& opts) {
+    for (const auto& file : files) {
+        std::cout << file->path() << ": " << file->size() << " B, " << file->blockCount()
+                  << " blocks";
+        if (file->skippedBytes() > 0) {
+            std::cout << ", " << file->skippedBytes() << " B outside blocks in "
+                      << file->skippedRegions() << " places";
+        }
+        std::cout << "\n";
+    }
+    std::cout << "\n";
+
+    std::vector<CaptureSummary> captures = walk(files, nullptr);
+    bool complete = true;
+    for (size_t i = 0; i < captures.size(); i++) {
+        const CaptureSummary& c = captures[i];
+        double seconds = (c.lastUs - c.firstUs) / 1e6;
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << "Capture " << i + 1 << ":\n";
+        std::cout << "  Time:      " << c.firstUs / 1e6 << " s to " << c.lastUs / 1e6
+                  << " s since boot (" << seconds << " s)\n";
+        std::cout << "  Frames:    " << c.frames << " in " << c.blocks << " blocks";
+        if (seconds > 0) {
+            std::cout << std::setprecision(0) << ", " << c.frames / seconds << " frames/s";
+        }
+        std::cout << "\n";
+        std::cout << std::setprecision(1);
+        std::cout << "  Busiest:   " << c.busiestFrames << " frames in one second, "
+                  << 100.0 * c.busiestBits / opts.bitrate << "% bus load at "
+                  << opts.bitrate / 1000 << " kbit/s (before stuff bits)\n";
+        std::cout << "  Lost:      " << c.missingBlocks << " blocks missing"
+                  << (c.firstSequence > 0 ? " (capture start not included)" : "") << ", "
+                  << c.dropped << " frames dropped on the master, " << c.overruns
+                  << " controller overruns\n";
+        std::cout << "  Verdict:   " << (c.complete() ? "complete, no frame lost" : "INCOMPLETE")
+                  << "\n";
+        complete = complete && c.complete();
+    }
+    if (captures.empty()) {
+        std::cout << "No capture blocks found\n";
+        return 1;
+    }
+    return complete ? 0 : 2;
+}
+
+// (seconds.microseconds) interface ID#DATA, as written by candump -L
+static int cmdCandump(const std::vector<std::unique_ptr<CaptureFile>>& files, const DecodeOptions& opts) {
+    FILE* out = openOutput(opts);
+    if (!out) return 1;
+
+    const char* interface = opts.interface.c_str();
+    std::vector<CaptureSummary> captures = walk(files, [&](const CanFrame& frame) {
+        char data[17];
+        char id[12];
+        if (frame.flags & CAN_FRAME_EXTENDED) {
+            snprintf(id, sizeof(id), "%08" PRIX32, frame.id);
+        } else {
+            snprintf(id, sizeof(id), "%03" PRIX32, frame.id);
+        }
+        if (frame.flags & CAN_FRAME_RTR) {
+            // canutils writes the requested length after R when there is one
+            if (frame.dlc > 0) {
+                snprintf(data, sizeof(data), "R%u", frame.dlc);
+            } else {
+                snprintf(data, sizeof(data), "R");
+            }
+        } else {
+            formatData(frame, data, false);
+        }
+        fprintf(out, "(%" PRIu64 ".%06" PRIu64 ") %s %s#%s\n", frame.timeUs / 1000000,
+                frame.timeUs % 1000000, interface, id, data);
+    });
+    return finishOutput(out, captures);
+}
+
+// Vector ASC, times relative to the first frame
+static int cmdAsc(const std::vector<std::unique_ptr<CaptureFile>>& files, const DecodeOptions& opts) {
+    FILE* out = openOutput(opts);
+    if (!out) return 1;
+
+    char date[64];
+    time_t now = time(nullptr);
+    strftime(date, sizeof(date), "%a %b %d %H:%M:%S.000 %Y", localtime(&now));
+    fprintf(out, "date %s\n", date);
+    fprintf(out, "base hex  timestamps absolute\n");
+    fprintf(out, "internal events logged\n");
+    fprintf(out, "Begin Triggerblock %s\n", date);
+    fprintf(out, "   0.000000 Start of measurement\n");
+
+    bool first = true;
+    uint64_t startUs = 0;
+    std::vector<CaptureSummary> captures = walk(files, [&](const CanFrame& frame) {
+        if (first) {
+            startUs = frame.timeUs;
+            first = false;
+        }
+        double seconds = frame.timeUs >= startUs ? (frame.timeUs - startUs) / 1e6 : 0.0;
+        char id[16];
+        if (frame.flags & CAN_FRAME_EXTENDED) {
+            snprintf(id, sizeof(id), "%" PRIX32 "x", frame.id);
+        } else {
+            snprintf(id, sizeof(id), "%" PRIX32, frame.id);
+        }
+        if (frame.flags & CAN_FRAME_RTR) {
+            fprintf(out, "%11.6f %u  %-15s Rx   r\n", seconds, opts.channel, id);
+        } else {
+            char data[25];
+            formatData(frame, data, true);
+            fprintf(out, "%11.6f %u  %-15s Rx   d %u%s\n", seconds, opts.channel, id, frame.dlc, data);
+        }
+    });
+    fprintf(out, "End TriggerBlock\n");
+    return finishOutput(out, captures);
+}
+
+// =============================================================================
+// Main
+// =============================================================================
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::string command = argv[1];
+
+    if (command == "--help" || command == "-h") {
+        printUsage(argv[0]);
+        return 0;
+    }
+
+    DecodeOptions opts;
+
+    enum { OPT_INTERFACE = 1000, OPT_CHANNEL, OPT_BITRATE };
+
+    static struct option longOptions[] = {
+        {"output", required_argument, nullptr, 'o'},
+        {"interface", required_argument, nullptr, OPT_INTERFACE},
+        {"channel", required_argument, nullptr, OPT_CHANNEL},
+        {"bitrate", required_argument, nullptr, OPT_BITRATE},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}
+    };
+
+    // Skip command name for getopt
+    optind = 2;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "o:h", longOptions, nullptr)) != -1) {
+        switch (opt) {
+            case 'o':             opts.output = optarg; break;
+            case OPT_INTERFACE:   opts.interface = optarg; break;
+            case OPT_CHANNEL:     opts.channel = static_cast<uint32_t>(std::strtoul(optarg, nullptr, 0)); break;
+            case OPT_BITRATE:     opts.bitrate = static_cast<uint32_t>(std::strtoul(optarg, nullptr, 0)); break;
+            case 'h':
+                printUsage(argv[0]);
+                return 0;
+            default:
+                return 1;
+        }
+    }
+
+    std::vector<std::string> paths;
+    for (int i = optind; i < argc; i++) {
+        paths.push_back(argv[i]);
+    }
+
+    if (command != "info" && command != "candump" && command != "asc") {
+        std::cerr << "Unknown command: " << command << "\n\n";
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (paths.empty()) {
+        std::cerr << "Error: " << command << " command requires <files...>\n";
+        return 1;
+    }
+    if (opts.bitrate == 0) {
+        std::cerr << "Error: --bitrate must be above 0\n";
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<CaptureFile>> files;
+    if (!openFiles(paths, files)) {
+        return 1;
+    }
+
+    int result = 0;
+
+    if (command == "info") {
+        result = cmdInfo(files, opts);
+    }
+    else if (command == "candump") {
+        result = cmdCandump(files, opts);
+    }
+    else {
+        result = cmdAsc(files, opts);
+    }
+
+    return result;
+}
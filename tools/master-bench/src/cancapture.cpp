@@ -0,0 +1,353 @@
+#include "cancapture.h"
+#include "master/can_capture_log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// =============================================================================
+// Bus
+// =============================================================================
+
+static const uint64_t BIT_US = 2;                       // 500 kbit/s
+static const uint64_t PHASE_US = 3000000;               // Traffic pattern lasts this long
+static const uint64_t LOG_PERIOD_US = 20000;            // LOG_TASK_PERIOD_MS
+static const uint64_t FLUSH_US = CAN_CAPTURE_FLUSH_MS * 1000ULL;
+
+// Frame bits without stuffing (interframe space included), and the most
+// stuff bits the stuffed part can take
+static uint32_t frameBits(bool extended, uint8_t dataBytes) {
+    return (extended ? 67 : 47) + 8 * dataBytes;
+}
+static uint32_t worstStuffBits(bool extended, uint8_t dataBytes) {
+    return ((extended ? 54 : 34) + 8 * dataBytes - 1) / 4;
+}
+
+// Back-to-back frames for the whole run, cycling through three patterns:
+// shortest standard frames, worst-stuffed 8-byte extended frames, and a
+// random mix with random stuffing
+static std::vector<CanFrame> makeBus(uint32_t seconds, uint32_t seed, uint64_t* bitsOut) {
+    std::mt19937 rng(seed);
+    std::vector<CanFrame> frames;
+    const uint64_t startUs = 1000000;
+    const uint64_t endUs = startUs + static_cast<uint64_t>(seconds) * 1000000ULL;
+    uint64_t t = startUs;
+    uint64_t bits = 0;
+
+    while (t < endUs) {
+        CanFrame f;
+        std::memset(&f, 0, sizeof(f));
+        uint32_t frameLength;
+        switch (((t - startUs) / PHASE_US) % 3) {
+            case 0:
+                f.id = rng() & 0x7FF;
+                frameLength = frameBits(false, 0);
+                break;
+            case 1:
+                f.id = rng() & 0x1FFFFFFF;
+                f.flags = CAN_FRAME_EXTENDED;
+                f.dlc = 8;
+                for (int i = 0; i < 8; i++) f.data[i] = static_cast<uint8_t>(rng());
+                frameLength = frameBits(true, 8) + worstStuffBits(true, 8);
+                break;
+            default: {
+                bool extended = rng() & 1;
+                f.flags = extended ? CAN_FRAME_EXTENDED : 0;
+                f.id = rng() & (extended ? 0x1FFFFFFF : 0x7FF);
+                f.dlc = static_cast<uint8_t>(rng() % 9);
+                uint8_t dataBytes = f.dlc;
+                if (rng() % 50 == 0) {
+                    f.flags |= CAN_FRAME_RTR;
+                    dataBytes = 0;
+                } else {
+                    for (uint8_t i = 0; i < f.dlc; i++) f.data[i] = static_cast<uint8_t>(rng());
+                }
+                frameLength = frameBits(extended, dataBytes) +
+                              rng() % (worstStuffBits(extended, dataBytes) + 1);
+                break;
+            }
+        }
+        t += frameLength * BIT_US;
+        bits += frameLength;
+        f.timeUs = t;                   // Stamped when the last bit is in
+        frames.push_back(f);
+    }
+    *bitsOut = bits;
+    return frames;
+}
+
+struct Buffers {
+    std::vector<std::vector<uint8_t>> storage;
+    std::vector<uint8_t*> pointers;
+
+    Buffers(uint32_t count, uint32_t blockBytes) : storage(count), pointers(count) {
+        for (uint32_t i = 0; i < count; i++) {
+            storage[i].resize(blockBytes);
+            pointers[i] = storage[i].data();
+        }
+    }
+};
+
+// =============================================================================
+// Reader Checks
+// =============================================================================
+
+struct Check {
+    uint32_t blocks = 0;
+    uint64_t frames = 0;
+    uint32_t missingBlocks = 0;
+    uint32_t errors = 0;            // Frames that differ or are missing
+    uint64_t skippedBytes = 0;
+    uint32_t dropped = 0;           // From the last header
+    uint32_t overruns = 0;
+};
+
+static bool sameFrame(const CanFrame& a, const CanFrame& b) {
+    return a.timeUs == b.timeUs && a.id == b.id && a.dlc == b.dlc && a.flags == b.flags &&
+           std::memcmp(a.data, b.data, sizeof(a.data)) == 0;
+}
+
+// Scan the way can-decode does: a block wherever the magic starts one
+// with a good CRC, anything else skipped
+static Check readBack(const std::vector<uint8_t>& stream, const std::vector<CanFrame>& stored) {
+    Check check;
+    uint32_t nextSequence = 0;
+    uint64_t pos = 0;
+    while (pos < stream.size()) {
+        uint32_t length = canCaptureBlockLength(stream.data() + pos, stream.size() - pos);
+        if (length == 0) {
+            pos++;
+            check.skippedBytes++;
+            continue;
+        }
+
+        CanCaptureBlockHeader header;
+        std::memcpy(&header, stream.data() + pos, sizeof(header));
+        check.missingBlocks += header.sequence - nextSequence;
+        nextSequence = header.sequence + 1;
+        check.dropped = header.dropped;
+        check.overruns = header.overruns;
+
+        for (uint32_t r = 0; r < header.recordCount; r++) {
+            CanCaptureRecord record;
+            std::memcpy(&record, stream.data() + pos + sizeof(header) + r * sizeof(record),
+                        sizeof(record));
+            CanFrame frame;
+            canCaptureDecode(&header, &record, &frame);
+            if (check.frames >= stored.size() || !sameFrame(frame, stored[check.frames])) {
+                check.errors++;
+            }
+            check.frames++;
+        }
+        check.blocks++;
+        pos += length;
+    }
+    if (check.frames < stored.size()) {
+        check.errors += static_cast<uint32_t>(stored.size() - check.frames);
+    }
+    return check;
+}
+
+// =============================================================================
+// Paced Runs
+// =============================================================================
+
+enum class Sink { Sd, Usb };
+
+// One capture of the whole bus into a sink. SD: each sealed block is
+// written in order by a card that stalls now and then. USB: the Log task
+// wakes every LOG_PERIOD_US and writes the waiting blocks at the USB rate,
+// after a line of log text now and then.
+static bool runSink(const char* name, Sink sink, uint32_t bufferCount,
+                    const CanCaptureParams& params, const std::vector<CanFrame>& bus) {
+    const uint32_t blockBytes = params.blockKb * 1024;
+    Buffers buffers(bufferCount, blockBytes);
+    CanCaptureWriter writer;
+    writer.init(buffers.pointers.data(), bufferCount, blockBytes);
+
+    std::mt19937 rng(params.seed);
+    std::vector<uint8_t> stream;
+    std::vector<CanFrame> stored;
+    stored.reserve(bus.size());
+    std::deque<std::pair<uint64_t, uint8_t>> writing;      // Finish time, buffer
+    std::deque<CanCaptureBlock> usbQueue;
+    uint64_t sinkFree = 0;
+    uint64_t nextStallUs = static_cast<uint64_t>(params.stallEverySec) * 1000000ULL;
+    uint64_t nextLogUs = LOG_PERIOD_US;
+    uint32_t stalls = 0;
+    uint32_t textLines = 0;
+    uint64_t maxBehindUs = 0;
+
+    auto emit = [&](const CanCaptureBlock& block, uint64_t startUs, uint64_t us) {
+        stream.insert(stream.end(), block.data, block.data + block.length);
+        sinkFree = startUs + us;
+        writing.emplace_back(sinkFree, block.buffer);
+    };
+
+    auto submit = [&](const CanCaptureBlock& block, uint64_t nowUs) {
+        if (sink == Sink::Usb) {
+            usbQueue.push_back(block);
+            return;
+        }
+        uint64_t start = std::max(nowUs, sinkFree);
+        uint64_t us = params.opLatencyUs +
+            static_cast<uint64_t>(block.length) * 1000000ULL / (params.throughputKBps * 1024ULL);
+        if (params.stallEverySec > 0 && start >= nextStallUs) {
+            us += params.stallMs * 1000ULL;
+            nextStallUs += static_cast<uint64_t>(params.stallEverySec) * 1000000ULL;
+            stalls++;
+        }
+        emit(block, start, us);
+        maxBehindUs = std::max(maxBehindUs, sinkFree - nowUs);
+    };
+
+    // The Log task writes blocks one after the other; a long drain delays its next wake
+    auto drainUsb = [&](uint64_t nowUs) {
+        if (rng() % 8 == 0) {
+            std::string line = "[CAN RX] heartbeat " + std::to_string(nowUs) + "\n";
+            stream.insert(stream.end(), line.begin(), line.end());
+            textLines++;
+        }
+        uint64_t t = nowUs;
+        while (!usbQueue.empty()) {
+            const CanCaptureBlock& block = usbQueue.front();
+            uint64_t us = static_cast<uint64_t>(block.length) * 1000000ULL / (params.usbKBps * 1024ULL);
+            emit(block, t, us);
+            t += us;
+            usbQueue.pop_front();
+        }
+        maxBehindUs = std::max(maxBehindUs, t - nowUs);
+        nextLogUs = std::max(nextLogUs + LOG_PERIOD_US, t);
+    };
+
+    auto releaseUntil = [&](uint64_t nowUs) {
+        while (!writing.empty() && writing.front().first <= nowUs) {
+            writer.release(writing.front().second);
+            writing.pop_front();
+        }
+    };
+
+    CanCaptureBlock block;
+    for (const CanFrame& frame : bus) {
+        while (sink == Sink::Usb && nextLogUs <= frame.timeUs) {
+            releaseUntil(nextLogUs);
+            drainUsb(nextLogUs);
+        }
+        releaseUntil(frame.timeUs);
+        if (writer.flush(frame.timeUs, FLUSH_US, &block)) {
+            submit(block, frame.timeUs);
+        }
+
+        uint32_t dropped = writer.stats().dropped;
+        if (writer.add(frame, &block)) {
+            submit(block, frame.timeUs);
+        }
+        if (writer.stats().dropped == dropped) {
+            stored.push_back(frame);
+        }
+    }
+
+    // Stop: the last block (or the final counters) once everything is written
+    uint64_t endUs = bus.back().timeUs;
+    if (sink == Sink::Usb) {
+        drainUsb(std::max(endUs, nextLogUs));
+    }
+    releaseUntil(UINT64_MAX);
+    if (writer.flush(std::max(endUs, sinkFree), 0, &block)) {
+        submit(block, std::max(endUs, sinkFree));
+    }
+    if (sink == Sink::Usb) {
+        drainUsb(std::max(endUs, nextLogUs));
+    }
+
+    const CanCaptureStats& s = writer.stats();
+    Check check = readBack(stream, stored);
+    bool ok = check.errors == 0 && check.missingBlocks == 0 && check.frames == s.frames &&
+              check.blocks == s.blocks && check.dropped == s.dropped && check.overruns == 0 &&
+              s.frames + s.dropped == bus.size();
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << name << ": " << bufferCount << " x " << params.blockKb << " KB buffers, ";
+    if (sink == Sink::Sd) {
+        std::cout << "card " << params.opLatencyUs << " us/write + " << params.throughputKBps
+                  << " KB/s, " << params.stallMs << " ms stall every " << params.stallEverySec
+                  << " s (" << stalls << " stalls)\n";
+    } else {
+        std::cout << "USB " << params.usbKBps << " KB/s every " << LOG_PERIOD_US / 1000
+                  << " ms, " << textLines << " log lines between blocks\n";
+    }
+    std::cout << "         " << s.frames << " stored, " << s.dropped << " dropped ("
+              << std::setprecision(3) << 100.0 * s.dropped / bus.size() << "%), buffers "
+              << s.maxBuffersInUse << "/" << bufferCount << " at most, sink behind by "
+              << std::setprecision(1) << maxBehindUs / 1000.0 << " ms at most\n";
+    std::cout << "         read back " << check.blocks << " blocks, " << check.frames << " frames, "
+              << check.skippedBytes << " B skipped, " << check.missingBlocks
+              << " missing blocks, header counts " << check.dropped << " dropped / "
+              << check.overruns << " overruns, " << check.errors << " errors: "
+              << (ok ? "OK" : "MISMATCH") << "\n";
+    return ok;
+}
+
+// =============================================================================
+// Run
+// =============================================================================
+
+int canCaptureRun(const CanCaptureParams& params) {
+    const uint32_t blockBytes = params.blockKb * 1024;
+    uint64_t busBits = 0;
+    std::vector<CanFrame> bus = makeBus(params.seconds, params.seed, &busBits);
+    uint64_t busUs = bus.back().timeUs - 1000000;
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "CAN capture: " << bus.size() << " frames in " << params.seconds
+              << " s at 100% of 500 kbit/s (" << bus.size() / (busUs / 1e6) << " frames/s, "
+              << "shortest frames " << 1e6 / (frameBits(false, 0) * BIT_US)
+              << "/s), " << blockBytes << " B blocks of "
+              << (blockBytes - sizeof(CanCaptureBlockHeader)) / sizeof(CanCaptureRecord)
+              << " frames\n\n";
+
+    // Encode rate, buffers back as soon as a block is sealed
+    {
+        Buffers buffers(params.buffers, blockBytes);
+        CanCaptureWriter writer;
+        writer.init(buffers.pointers.data(), params.buffers, blockBytes);
+        CanCaptureBlock block;
+        const uint32_t passes = 10;
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t p = 0; p < passes; p++) {
+            for (const CanFrame& frame : bus) {
+                CanFrame f = frame;
+                f.timeUs += static_cast<uint64_t>(p) * (busUs + 1000000);
+                if (writer.add(f, &block)) {
+                    writer.release(block.buffer);
+                }
+            }
+        }
+        if (writer.flush(0, 0, &block)) {
+            writer.release(block.buffer);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const CanCaptureStats& s = writer.stats();
+        double busSeconds = busUs / 1e6 * passes;
+
+        std::cout << "Encode:  " << s.frames << " frames in " << seconds * 1000.0 << " ms, "
+                  << s.frames / seconds / 1e6 << " M frames/s, " << std::setprecision(0)
+                  << seconds * 1e9 / s.frames << " ns/frame\n";
+        std::cout << std::setprecision(1);
+        std::cout << "Output:  " << s.blocks << " blocks, " << s.bytes / busSeconds / 1024.0
+                  << " KB/s for the sink at full load\n\n";
+    }
+
+    bool ok = true;
+    ok = runSink("SD", Sink::Sd, params.buffers, params, bus) && ok;
+    ok = runSink("USB", Sink::Usb, params.buffers, params, bus) && ok;
+    // Too few buffers for the stalls: drops, each one counted
+    ok = runSink("SD/2", Sink::Sd, 2, params, bus) && ok;
+    return ok ? 0 : 1;
+}
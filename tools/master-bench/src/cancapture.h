@@ -0,0 +1,38 @@
+#ifndef CANCAPTURE_BENCH_H
+#define CANCAPTURE_BENCH_H
+
+#include "master/can_capture_log.h"
+#include "shared/config.h"
+
+#include <cstdint>
+
+// =============================================================================
+// CAN Capture Benchmark
+// =============================================================================
+// Feeds the master's CanCaptureWriter a 500 kbit/s bus at 100% load in
+// simulated time - back-to-back frames cycling between the shortest
+// standard frames (the highest frame rate), stuffed 8-byte extended frames
+// (the highest byte rate) and a random mix. First measures the encode
+// rate, then paces the frames against each sink: the SD card with the
+// telemetry bench's stalls, and the USB stream drained by the Log task
+// with log text between the blocks, plus a run short of buffers. Every
+// byte written is read back as a converter would - resyncing on the block
+// magic - and each run passes only if every stored frame comes back
+// exactly and the drop counters in the headers account for the rest.
+
+struct CanCaptureParams {
+    uint32_t seconds = 60;              // Simulated bus time
+    uint32_t blockKb = CAN_CAPTURE_BLOCK_KB;
+    uint32_t buffers = CAN_CAPTURE_BUFFERS;
+    uint32_t opLatencyUs = 1000;        // Card cost per write
+    uint32_t throughputKBps = 2000;     // Card transfer rate
+    uint32_t stallMs = 250;             // Card stall (erase, wear levelling) ...
+    uint32_t stallEverySec = 10;        // ... once this often
+    uint32_t usbKBps = 1000;            // USB CDC rate the host keeps up with
+    uint32_t seed = 1;
+};
+
+// Returns 0 when every run read back exactly what it stored and counted
+int canCaptureRun(const CanCaptureParams& params);
+
+#endif // CANCAPTURE_BENCH_H
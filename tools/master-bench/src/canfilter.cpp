@@ -0,0 +1,173 @@
+#include "canfilter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// =============================================================================
+// Synthetic Bus
+// =============================================================================
+
+struct BusId {
+    CanId id;
+    uint32_t rateHz;
+};
+
+// IDs from the Volvo EHPS notes, then random traffic in the same ranges
+static std::vector<BusId> makeBus(std::mt19937& rng) {
+    std::vector<BusId> bus = {
+        {{0x1B200002, true}, 20},       // Pump alive
+        {{0x02104136, true}, 71},       // Vehicle speed
+        {{0x1AE0092C, true}, 2},
+        {{0x01E0162A, true}, 50},
+        {{0x00800401, true}, 100},
+    };
+    std::uniform_int_distribution<uint32_t> rate(1, 100);
+    std::uniform_int_distribution<uint32_t> std11(0x000, 0x7FF);
+    std::uniform_int_distribution<uint32_t> low16(0x0000, 0xFFFF);
+    static const uint32_t extPrefixes[] = {0x00800000, 0x01E00000, 0x02100000, 0x1AE00000,
+                                           0x1B200000};
+    std::uniform_int_distribution<uint32_t> prefix(0, 4);
+
+    while (bus.size() < 60) {
+        BusId entry;
+        if (bus.size() % 3 == 0) {
+            entry.id = {std11(rng), false};
+        } else {
+            entry.id = {extPrefixes[prefix(rng)] | low16(rng), true};
+        }
+        entry.rateHz = rate(rng);
+        bool duplicate = false;
+        for (const BusId& other : bus) {
+            duplicate |= other.id.id == entry.id.id && other.id.extended == entry.id.extended;
+        }
+        if (!duplicate) {
+            bus.push_back(entry);
+        }
+    }
+    return bus;
+}
+
+// =============================================================================
+// Checks
+// =============================================================================
+
+// Wanted IDs all pass, standard filters never compare data bytes, and an
+// exact plan passes nothing else on the bus
+static bool planValid(const CanFilterPlan& plan, const std::vector<BusId>& bus) {
+    for (uint32_t i = 0; i < plan.wantedCount; i++) {
+        if (!canFilterAccepts(&plan, plan.wanted[i].id, plan.wanted[i].extended)) {
+            std::cout << "  wanted ID 0x" << std::hex << plan.wanted[i].id << std::dec
+                      << " rejected\n";
+            return false;
+        }
+    }
+    for (uint32_t f = 0; f < CAN_FILTER_COUNT; f++) {
+        uint32_t mask = plan.mask[f < CAN_FILTER_RXB0_FILTERS ? 0 : 1];
+        if (!plan.filterExtended[f] && (mask & 0xFFFF) != 0) {
+            std::cout << "  standard filter RXF" << f << " under a mask with data bits\n";
+            return false;
+        }
+    }
+    if (plan.exact) {
+        for (const BusId& b : bus) {
+            if (canFilterAccepts(&plan, b.id.id, b.id.extended) &&
+                !canFilterWanted(&plan, b.id.id, b.id.extended)) {
+                std::cout << "  exact plan passes 0x" << std::hex << b.id.id << std::dec << "\n";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Share of the bus traffic the plan rejects, whatever it was planned on
+static double rejection(const CanFilterPlan& plan, const std::vector<BusId>& bus) {
+    uint64_t total = 0;
+    uint64_t accepted = 0;
+    for (const BusId& b : bus) {
+        total += b.rateHz;
+        if (canFilterAccepts(&plan, b.id.id, b.id.extended)) {
+            accepted += b.rateHz;
+        }
+    }
+    return total == 0 ? 0.0 : 1.0 - static_cast<double>(accepted) / total;
+}
+
+// =============================================================================
+// Run
+// =============================================================================
+
+int canFilterRun(const CanFilterParams& params) {
+    std::mt19937 rng(params.seed);
+    std::vector<BusId> bus = makeBus(rng);
+
+    CanTrafficSurvey survey;
+    uint64_t busFrames = 0;
+    for (uint32_t s = 0; s < params.seconds; s++) {
+        for (const BusId& b : bus) {
+            for (uint32_t n = 0; n < b.rateHz; n++) {
+                survey.add(b.id.id, b.id.extended);
+            }
+            busFrames += b.rateHz;
+        }
+    }
+
+    // The pump's own ID first, then the rest of the bus in random order
+    std::vector<CanId> order;
+    for (const BusId& b : bus) {
+        order.push_back(b.id);
+    }
+    std::shuffle(order.begin() + 1, order.end(), rng);
+
+    std::cout << "CAN filter: " << bus.size() << " IDs on the bus, " << busFrames
+              << " frames surveyed over " << params.seconds << " s\n\n";
+    std::cout << "  IDs  exact  extra IDs   rejected  (no survey)   wanted   plan us\n";
+
+    uint32_t failures = 0;
+    for (uint32_t k = 1; k <= params.ids; k++) {
+        CanFilterPlan plan;
+        CanFilterPlan blind;
+
+        auto start = std::chrono::steady_clock::now();
+        canFilterPlan(order.data(), k, &survey, &plan);
+        double planUs = std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - start).count();
+        canFilterPlan(order.data(), k, nullptr, &blind);
+
+        failures += !planValid(plan, bus);
+        failures += !planValid(blind, bus);
+
+        // Traffic of the wanted IDs: the most the filters could reject
+        uint64_t total = 0;
+        uint64_t wanted = 0;
+        for (const BusId& b : bus) {
+            total += b.rateHz;
+            if (canFilterWanted(&plan, b.id.id, b.id.extended)) {
+                wanted += b.rateHz;
+            }
+        }
+
+        std::cout << std::fixed << std::setprecision(1);
+        std::cout << "  " << std::setw(3) << k << "  " << std::setw(5)
+                  << (plan.exact ? "yes" : "no") << "  " << std::setw(9) << plan.extraIds
+                  << "  " << std::setw(8) << 100.0 * rejection(plan, bus) << "%  "
+                  << std::setw(10) << 100.0 * rejection(blind, bus) << "%  " << std::setw(6)
+                  << 100.0 * wanted / total << "%  " << std::setw(8) << std::setprecision(0)
+                  << planUs << "\n";
+
+        double predicted = canFilterPredictedRejection(&plan);
+        if (std::abs(predicted - rejection(plan, bus)) > 0.001) {
+            std::cout << "  predicted rejection " << predicted << " does not match the bus\n";
+            failures++;
+        }
+    }
+
+    std::cout << "\nCheck:   " << failures << " invalid plans: " << (failures == 0 ? "OK" : "FAILED")
+              << "\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,324 @@
+#include "canstats.h"
+#include "master/can_bus_stats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+
+static const uint32_t BITRATE = 500000;
+static const uint64_t SECOND_US = 1000000;
+
+// =============================================================================
+// Reference Frame Length
+// =============================================================================
+
+static void appendBits(std::vector<uint8_t>& bits, uint32_t value, int count) {
+    for (int i = count - 1; i >= 0; i--) {
+        bits.push_back((value >> i) & 1);
+    }
+}
+
+// Build the frame bit by bit, divide for the CRC, then insert stuff bits
+static uint32_t referenceBits(const CanFrame& f) {
+    bool rtr = f.flags & CAN_FRAME_RTR;
+    std::vector<uint8_t> bits;
+    bits.push_back(0);
+    if (f.flags & CAN_FRAME_EXTENDED) {
+        appendBits(bits, f.id >> 18, 11);
+        bits.push_back(1);
+        bits.push_back(1);
+        appendBits(bits, f.id & 0x3FFFF, 18);
+        bits.push_back(rtr);
+        appendBits(bits, 0, 2);
+    } else {
+        appendBits(bits, f.id, 11);
+        bits.push_back(rtr);
+        appendBits(bits, 0, 2);
+    }
+    appendBits(bits, f.dlc, 4);
+    if (!rtr) {
+        for (uint8_t i = 0; i < f.dlc; i++) appendBits(bits, f.data[i], 8);
+    }
+
+    // Long division by x^15 + x^14 + x^10 + x^8 + x^7 + x^4 + x^3 + 1
+    std::vector<uint8_t> rem(bits);
+    rem.insert(rem.end(), 15, 0);
+    static const uint8_t poly[16] = {1, 1, 0, 0, 0, 1, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1};
+    for (size_t i = 0; i < bits.size(); i++) {
+        if (rem[i]) {
+            for (int j = 0; j < 16; j++) rem[i + j] ^= poly[j];
+        }
+    }
+    bits.insert(bits.end(), rem.end() - 15, rem.end());
+
+    std::vector<uint8_t> wire;
+    int run = 0;
+    for (uint8_t b : bits) {
+        if (!wire.empty() && wire.back() == b) {
+            run++;
+        } else {
+            run = 1;
+        }
+        wire.push_back(b);
+        if (run == 5) {
+            wire.push_back(!b);
+            run = 1;
+        }
+    }
+    return static_cast<uint32_t>(wire.size()) + 13;
+}
+
+// =============================================================================
+// Bus
+// =============================================================================
+
+struct Truth {
+    uint32_t frames = 0;
+    uint64_t firstUs = 0;
+    uint64_t lastUs = 0;
+    uint32_t minIntervalUs = UINT32_MAX;
+    uint32_t maxIntervalUs = 0;
+    std::vector<uint32_t> intervals;
+    uint8_t data[8] = {0};
+    uint8_t changed = 0;
+};
+
+static uint32_t keyOf(const CanFrame& f) {
+    return f.id | ((f.flags & CAN_FRAME_EXTENDED) ? 0x80000000u : 0);
+}
+
+// Periodic IDs with jitter, merged in time order
+static std::vector<CanFrame> makeBus(const CanStatsParams& p, uint32_t ids, std::mt19937& rng) {
+    static const uint32_t PERIODS_MS[] = {10, 20, 25, 50, 100, 200, 500, 1000};
+    std::vector<CanFrame> frames;
+    const uint64_t startUs = SECOND_US;
+    const uint64_t endUs = startUs + p.seconds * SECOND_US;
+
+    for (uint32_t n = 0; n < ids; n++) {
+        CanFrame f;
+        std::memset(&f, 0, sizeof(f));
+        bool extended = rng() % 3 == 0;
+        f.flags = extended ? CAN_FRAME_EXTENDED : 0;
+        f.id = extended ? (0x18000000 | (rng() & 0xFFFFFF)) : (0x100 + n * 7) & 0x7FF;
+        f.dlc = static_cast<uint8_t>(1 + rng() % 8);
+        for (int i = 0; i < 8; i++) f.data[i] = i < f.dlc ? static_cast<uint8_t>(rng()) : 0;
+        bool dlcSwitches = n % 20 == 7;
+
+        uint64_t periodUs = PERIODS_MS[rng() % 8] * 1000ULL;
+        int64_t jitter = static_cast<int64_t>(periodUs * p.jitterPct / 100);
+        std::uniform_int_distribution<int64_t> offset(-jitter, jitter);
+        uint64_t phase = rng() % periodUs;
+        for (uint64_t k = 0;; k++) {
+            uint64_t t = startUs + phase + k * periodUs + jitter + offset(rng);
+            if (t >= endUs) break;
+            f.timeUs = t;
+            f.data[0] = static_cast<uint8_t>(k);                // Rolling counter
+            if (f.dlc > 2 && k % 50 == 49) f.data[2]++;         // Slow signal
+            if (dlcSwitches) f.dlc = k % 2 ? 8 : 4;
+            frames.push_back(f);
+        }
+    }
+    std::stable_sort(frames.begin(), frames.end(),
+                     [](const CanFrame& a, const CanFrame& b) { return a.timeUs < b.timeUs; });
+    return frames;
+}
+
+static std::map<uint32_t, Truth> makeTruth(const std::vector<CanFrame>& frames) {
+    std::map<uint32_t, Truth> truth;
+    for (const CanFrame& f : frames) {
+        Truth& t = truth[keyOf(f)];
+        uint8_t data[8] = {0};
+        std::memcpy(data, f.data, f.dlc);
+        if (t.frames == 0) {
+            t.firstUs = f.timeUs;
+        } else {
+            uint32_t interval = static_cast<uint32_t>(f.timeUs - t.lastUs);
+            t.intervals.push_back(interval);
+            t.minIntervalUs = std::min(t.minIntervalUs, interval);
+            t.maxIntervalUs = std::max(t.maxIntervalUs, interval);
+            for (int b = 0; b < 8; b++) {
+                if (data[b] != t.data[b]) t.changed |= 1 << b;
+            }
+        }
+        std::memcpy(t.data, data, 8);
+        t.lastUs = f.timeUs;
+        t.frames++;
+    }
+    return truth;
+}
+
+// =============================================================================
+// Run
+// =============================================================================
+
+int canStatsRun(const CanStatsParams& params) {
+    std::mt19937 rng(params.seed);
+    int failures = 0;
+
+    // Frame length against the reference, random frames of every shape
+    uint32_t lengthErrors = 0;
+    const uint32_t lengthFrames = 200000;
+    for (uint32_t i = 0; i < lengthFrames; i++) {
+        CanFrame f;
+        std::memset(&f, 0, sizeof(f));
+        bool extended = rng() & 1;
+        f.flags = (extended ? CAN_FRAME_EXTENDED : 0) | (rng() % 16 == 0 ? CAN_FRAME_RTR : 0);
+        // Runs of equal bits make the stuffing interesting
+        uint32_t pattern = rng() % 3;
+        f.id = (pattern == 0 ? 0 : pattern == 1 ? 0xFFFFFFFF : rng()) & (extended ? 0x1FFFFFFF : 0x7FF);
+        f.dlc = static_cast<uint8_t>(rng() % 9);
+        for (uint8_t b = 0; b < 8; b++) {
+            f.data[b] = pattern == 2 ? static_cast<uint8_t>(rng()) : (rng() % 4 ? 0 : 0xFF);
+        }
+        if (canFrameBits(f) != referenceBits(f)) lengthErrors++;
+    }
+    std::cout << "Length:  " << lengthFrames << " frames against the bit-by-bit reference, "
+              << lengthErrors << " differ\n";
+    failures += lengthErrors > 0;
+
+    std::vector<CanFrame> frames = makeBus(params, params.ids, rng);
+    std::map<uint32_t, Truth> truth = makeTruth(frames);
+    std::vector<uint32_t> bits(frames.size());
+    uint64_t totalBits = 0;
+    for (size_t i = 0; i < frames.size(); i++) {
+        bits[i] = canFrameBits(frames[i]);
+        totalBits += bits[i];
+    }
+
+    // Update cost, with the frame length computed here or passed in
+    static CanBusStats stats;
+    stats.setBitrate(BITRATE);
+    const int passes = 20;
+    auto start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < passes; pass++) {
+        stats.reset();
+        for (const CanFrame& f : frames) stats.add(f);
+    }
+    double fullNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start)
+                        .count() / passes / frames.size();
+    start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < passes; pass++) {
+        stats.reset();
+        for (size_t i = 0; i < frames.size(); i++) stats.add(frames[i], bits[i]);
+    }
+    double tableNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start)
+                         .count() / passes / frames.size();
+
+    const CanBusSummary& s = stats.summary();
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Bus:     " << truth.size() << " IDs, " << frames.size() << " frames in "
+              << params.seconds << " s, jitter +/-" << params.jitterPct << "% of the period\n";
+    std::cout << "Update:  " << fullNs << " ns/frame (" << tableNs << " ns in the table, "
+              << fullNs - tableNs << " ns for the length), "
+              << std::setprecision(3) << static_cast<double>(stats.probes()) / frames.size()
+              << " probes/frame\n";
+
+    // Every entry against the truth
+    uint32_t exactErrors = 0;
+    uint32_t periodErrors = 0;
+    uint32_t jitterErrors = 0;
+    double worstPeriod = 0;
+    double worstJitter = 0;
+    double worstMean = 0;
+    double jitterRatio = 0;
+    uint32_t jitterIds = 0;
+    for (const auto& kv : truth) {
+        const Truth& t = kv.second;
+        CanIdStats e;
+        bool extended = kv.first & 0x80000000u;
+        if (!stats.find(kv.first & 0x1FFFFFFF, extended, &e)) {
+            exactErrors++;
+            continue;
+        }
+        if (e.frames != t.frames || e.minIntervalUs != t.minIntervalUs ||
+            e.maxIntervalUs != t.maxIntervalUs || e.changed != t.changed ||
+            std::memcmp(e.data, t.data, 8) != 0 || e.firstUs != t.firstUs || e.lastUs != t.lastUs) {
+            exactErrors++;
+        }
+        if (t.intervals.size() < 2) continue;
+
+        // The same averages in floating point: the integer ones may only
+        // drift by their rounding, half a microsecond a step
+        double period = t.intervals[0];
+        double jitter = 0;
+        for (size_t i = 1; i < t.intervals.size(); i++) {
+            double deviation = t.intervals[i] - period;
+            jitter += (std::fabs(deviation) - jitter) / (1 << CAN_STATS_JITTER_SHIFT);
+            period += deviation / (1 << CAN_STATS_EWMA_SHIFT);
+        }
+        double periodError = std::fabs(e.periodUs - period);
+        double jitterError = std::fabs(e.jitterUs - jitter);
+        worstPeriod = std::max(worstPeriod, periodError);
+        worstJitter = std::max(worstJitter, jitterError);
+        if (periodError > (1 << CAN_STATS_EWMA_SHIFT) / 2.0 + 1) periodErrors++;
+        if (jitterError > (1 << CAN_STATS_JITTER_SHIFT) / 2.0 + 1) jitterErrors++;
+
+        // How well they describe the bus
+        double mean = static_cast<double>(t.lastUs - t.firstUs) / t.intervals.size();
+        double spread = 0;
+        for (uint32_t interval : t.intervals) spread += std::fabs(interval - mean);
+        spread /= t.intervals.size();
+        worstMean = std::max(worstMean, std::fabs(e.periodUs - mean) / mean);
+        jitterRatio += e.jitterUs / spread;
+        jitterIds++;
+    }
+    std::cout << "Entries: " << truth.size() - exactErrors << "/" << truth.size()
+              << " exact (frames, intervals, changed bytes, payload), EWMAs within "
+              << std::setprecision(1) << worstPeriod << " / " << worstJitter
+              << " us of floating point\n";
+    std::cout << "Fit:     period within " << std::setprecision(2) << worstMean * 100
+              << "% of each ID's mean interval, jitter " << jitterRatio / jitterIds
+              << "x the mean deviation on average\n";
+    failures += exactErrors > 0 || periodErrors > 0 || jitterErrors > 0;
+
+    // Bus load per whole second from the first frame, as the table counts it
+    std::vector<uint64_t> secondBits(params.seconds + 2, 0);
+    uint64_t firstUs = frames.front().timeUs;
+    for (size_t i = 0; i < frames.size(); i++) {
+        secondBits[(frames[i].timeUs - firstUs) / SECOND_US] += bits[i];
+    }
+    uint64_t lastSecond = (frames.back().timeUs - firstUs) / SECOND_US;
+    uint64_t peakBits = *std::max_element(secondBits.begin(), secondBits.begin() + lastSecond);
+    double truthAverage = static_cast<double>(totalBits) * SECOND_US /
+                          (frames.back().timeUs - firstUs) / BITRATE;
+    bool loadOk = s.bits == totalBits &&
+                  std::fabs(s.peakLoad - static_cast<double>(peakBits) / BITRATE) < 1e-6 &&
+                  std::fabs(s.load - static_cast<double>(secondBits[lastSecond - 1]) / BITRATE) < 1e-6 &&
+                  std::fabs(stats.averageLoad() - truthAverage) < 1e-4;
+    stats.tick(frames.back().timeUs + 3 * SECOND_US);
+    loadOk = loadOk && s.load == 0 && s.framesPerSec == 0;
+    std::cout << std::setprecision(1) << "Load:    " << truthAverage * 100 << "% average, "
+              << s.peakLoad * 100 << "% busiest second at " << BITRATE / 1000 << " kbit/s, "
+              << "0% once quiet: " << (loadOk ? "OK" : "MISMATCH") << "\n";
+    failures += !loadOk;
+
+    // More IDs than the table holds: the first half-table's worth are kept
+    std::vector<CanFrame> crowded = makeBus(params, CAN_STATS_SLOTS, rng);
+    std::map<uint32_t, Truth> crowdedTruth = makeTruth(crowded);
+    stats.reset();
+    for (const CanFrame& f : crowded) stats.add(f);
+    uint32_t kept = 0;
+    uint64_t keptFrames = 0;
+    for (const auto& kv : crowdedTruth) {
+        CanIdStats e;
+        if (stats.find(kv.first & 0x1FFFFFFF, kv.first & 0x80000000u, &e)) {
+            kept++;
+            keptFrames += e.frames;
+        }
+    }
+    bool crowdedOk = s.ids == CAN_STATS_SLOTS / 2 && kept == s.ids &&
+                     keptFrames + s.untracked == crowded.size() && s.frames == crowded.size();
+    std::cout << "Full:    " << crowdedTruth.size() << " IDs, " << s.ids << " kept, " << s.untracked
+              << " frames untracked, " << std::setprecision(3)
+              << static_cast<double>(stats.probes()) / crowded.size()
+              << " probes/frame: " << (crowdedOk ? "OK" : "MISMATCH") << "\n";
+    failures += !crowdedOk;
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,185 @@
+#include "cantx.h"
+#include "master/can_tx_schedule.h"
+#include "master/pump_assist.h"
+#include "shared/config.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// =============================================================================
+// Model
+// =============================================================================
+
+static const uint64_t ALIVE_PERIOD_US = 84459;      // 0x1B200002 at ~11.84 Hz
+static const uint64_t IDLE_WAKE_US = 10000;         // CAN_RX_IDLE_WAIT_MS
+static const uint64_t FRAME_US = 270;               // 8-byte extended frame at 500 kbit/s, stuffed
+
+// Wake-up latency of the sending task: mostly tens of microseconds, one
+// wake in a hundred stalled by a few milliseconds
+struct Latency {
+    std::mt19937 rng;
+    explicit Latency(uint32_t seed) : rng(seed) {}
+    uint64_t next() {
+        if (rng() % 100 == 0) {
+            return 1000 + rng() % 4000;
+        }
+        return 20 + rng() % 180;
+    }
+};
+
+// Pump silent for 2 s in the middle of the run
+struct Pump {
+    uint64_t silentFrom;
+    uint64_t silentTo;
+    // Last alive frame at or before t, 0 = none
+    uint64_t lastAlive(uint64_t t) const {
+        uint64_t last = (t / ALIVE_PERIOD_US) * ALIVE_PERIOD_US;
+        if (last >= silentFrom && last < silentTo) {
+            last = silentFrom > 0 ? ((silentFrom - 1) / ALIVE_PERIOD_US) * ALIVE_PERIOD_US : 0;
+        }
+        return last;
+    }
+    uint64_t nextAlive(uint64_t t) const {
+        uint64_t next = (t / ALIVE_PERIOD_US + 1) * ALIVE_PERIOD_US;
+        return next >= silentFrom && next < silentTo
+                   ? ((silentTo + ALIVE_PERIOD_US - 1) / ALIVE_PERIOD_US) * ALIVE_PERIOD_US
+                   : next;
+    }
+    bool alive(uint64_t t) const {
+        uint64_t last = lastAlive(t);
+        return last != 0 && t - last < EHPS_ALIVE_TIMEOUT_MS * 1000ULL;
+    }
+};
+
+static uint8_t duty = 0;
+
+static bool buildSpeed(uint8_t* data, void*) {
+    uint16_t speed = ehpsSpeedForDuty(duty);
+    data[6] = static_cast<uint8_t>(speed >> 8);
+    data[7] = static_cast<uint8_t>(speed);
+    return true;
+}
+
+static bool buildKeepAlive(uint8_t*, void*) {
+    return true;
+}
+
+// =============================================================================
+// Run
+// =============================================================================
+
+int canTxRun(const CanTxParams& params) {
+    const uint64_t endUs = static_cast<uint64_t>(params.seconds) * 1000000;
+    Pump pump = {endUs / 2, endUs / 2 + 2000000};
+    Latency latency(params.seed);
+
+    CanTxScheduler scheduler;
+    CanTxMessage speed = {"speed", 0x02104136, true, 8, EHPS_SPEED_PERIOD_US, 0, 2,
+                          buildSpeed, nullptr};
+    CanTxMessage keepAlive = {"keepalive", 0x1AE0092C, true, 8, EHPS_KEEPALIVE_PERIOD_US,
+                              EHPS_SPEED_PERIOD_US / 2, 1, buildKeepAlive, nullptr};
+    scheduler.add(speed);
+    scheduler.add(keepAlive);
+
+    uint64_t bufferDoneUs[CAN_TX_BUFFERS] = {0, 0, 0};
+    uint64_t busFreeUs = 0;
+    uint32_t gateViolations = 0;
+    uint32_t payloadErrors = 0;
+    std::vector<std::pair<uint64_t, uint64_t>> openIntervals;
+
+    uint64_t now = 1;
+    while (now < endUs) {
+        // Wake: gate, then everything due
+        bool open = pump.alive(now);
+        if (open != scheduler.gateOpen()) {
+            scheduler.setGate(open, now);
+            if (open) {
+                openIntervals.push_back({now, endUs});
+            } else {
+                openIntervals.back().second = now;
+            }
+        }
+        duty = static_cast<uint8_t>(now / 100000);
+
+        uint32_t index;
+        CanFrame frame;
+        while (scheduler.next(now, &index, &frame)) {
+            uint8_t buffer = scheduler.message(index).buffer;
+            if (bufferDoneUs[buffer] > now) {
+                scheduler.busy(index);
+                continue;
+            }
+            if (!pump.alive(now)) {
+                gateViolations++;
+            }
+            if (frame.id == speed.id) {
+                uint16_t value = static_cast<uint16_t>((frame.data[6] << 8) | frame.data[7]);
+                uint16_t expected = static_cast<uint16_t>((255u - duty) * EHPS_SPEED_LEAST_ASSIST / 255u);
+                payloadErrors += value != expected;
+            }
+            // The bus carries one frame at a time
+            uint64_t start = std::max(now, busFreeUs);
+            busFreeUs = start + FRAME_US;
+            bufferDoneUs[buffer] = busFreeUs;
+            scheduler.sent(index, now);
+        }
+
+        // Sleep to the next deadline, alive frame or idle wake, then wake late
+        uint64_t wake = std::min({scheduler.nextDeadline(), pump.nextAlive(now), now + IDLE_WAKE_US});
+        now = std::max(wake, now + 1) + latency.next();
+    }
+
+    // Naive loop with the same latency: sleep one period after each send
+    Latency naiveLatency(params.seed);
+    uint64_t naiveSent = 0;
+    for (uint64_t t = 1; t < endUs; t += EHPS_SPEED_PERIOD_US + naiveLatency.next()) {
+        naiveSent++;
+    }
+
+    // Deadlines each message had while the gate was open
+    std::cout << "CAN TX: " << params.seconds << " s simulated, pump silent "
+              << pump.silentFrom / 1000000.0 << "-" << pump.silentTo / 1000000.0 << " s, "
+              << openIntervals.size() << " gate openings\n\n";
+    std::cout << "  Message     period us  deadlines      sent  busy  missed  rate Hz  late max  jitter max\n";
+
+    uint32_t unaccounted = 0;
+    double openSeconds = 0;
+    for (const auto& interval : openIntervals) {
+        openSeconds += (interval.second - interval.first) / 1e6;
+    }
+    std::cout << std::fixed;
+    for (uint32_t i = 0; i < scheduler.count(); i++) {
+        const CanTxMessage& m = scheduler.message(i);
+        const CanTxStats& s = scheduler.stats(i);
+        uint64_t deadlines = 0;
+        for (const auto& interval : openIntervals) {
+            uint64_t first = interval.first + m.phaseUs;
+            if (interval.second > first) {
+                deadlines += (interval.second - first - 1) / m.periodUs + 1;
+            }
+        }
+        uint64_t handled = static_cast<uint64_t>(s.sent) + s.busy + s.missed + s.declined;
+        // A deadline just before the gate closes may be dropped with it
+        uint64_t slack = openIntervals.size();
+        if (handled > deadlines || deadlines - handled > slack) {
+            unaccounted++;
+        }
+        std::cout << "  " << std::left << std::setw(10) << m.name << std::right << std::setw(11)
+                  << m.periodUs << std::setw(11) << deadlines << std::setw(10) << s.sent
+                  << std::setw(6) << s.busy << std::setw(8) << s.missed << std::setw(9)
+                  << std::setprecision(2) << s.sent / openSeconds << std::setw(10)
+                  << s.maxLateUs << std::setw(12) << s.maxJitterUs << "\n";
+    }
+    std::cout << "  naive speed loop: " << std::setprecision(2) << naiveSent / (endUs / 1e6)
+              << " Hz (target " << 1e6 / EHPS_SPEED_PERIOD_US << ")\n\n";
+
+    bool ok = gateViolations == 0 && payloadErrors == 0 && unaccounted == 0;
+    std::cout << "Check:   " << gateViolations << " frames without the alive frame, "
+              << payloadErrors << " wrong speed payloads, " << unaccounted
+              << " messages with deadlines unaccounted: " << (ok ? "OK" : "FAILED") << "\n";
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,283 @@
+#include "files.h"
+#include "master/sd_file_cache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// =============================================================================
+// stdio Backend
+// =============================================================================
+// Same buffered FILE* layer the ESP-IDF VFS puts under Arduino's File
+
+class StdioFileBackend : public SdFileBackend {
+public:
+    uint64_t opens = 0;
+    uint64_t syncs = 0;
+
+    void* open(const char* path, bool create) override {
+        FILE* f = std::fopen(path, "r+b");
+        if (!f && create) {
+            f = std::fopen(path, "w+b");
+        }
+        if (f) opens++;
+        return f;
+    }
+
+    int32_t readAt(void* file, uint32_t offset, uint8_t* buffer, size_t length) override {
+        FILE* f = static_cast<FILE*>(file);
+        if (std::fseek(f, static_cast<long>(offset), SEEK_SET) != 0) return -1;
+        return static_cast<int32_t>(std::fread(buffer, 1, length, f));
+    }
+
+    int32_t writeAt(void* file, uint32_t offset, const uint8_t* data, size_t length) override {
+        FILE* f = static_cast<FILE*>(file);
+        if (std::fseek(f, static_cast<long>(offset), SEEK_SET) != 0) return -1;
+        return static_cast<int32_t>(std::fwrite(data, 1, length, f));
+    }
+
+    int32_t size(void* file) override {
+        FILE* f = static_cast<FILE*>(file);
+        if (std::fseek(f, 0, SEEK_END) != 0) return -1;
+        return static_cast<int32_t>(std::ftell(f));
+    }
+
+    bool sync(void* file) override {
+        syncs++;
+        return std::fflush(static_cast<FILE*>(file)) == 0;
+    }
+
+    void close(void* file) override {
+        std::fclose(static_cast<FILE*>(file));
+    }
+};
+
+// =============================================================================
+// Workload
+// =============================================================================
+
+enum class FileOpKind { Read, Write, Append, Size };
+
+struct FileOp {
+    FileOpKind kind;
+    uint32_t file;                  // files = the append log
+    uint32_t offset;
+    uint32_t seed;                  // Written data
+};
+
+// Most traffic goes to the first file (the swap), the rest is spread out
+static std::vector<FileOp> makeWorkload(const FilesParams& params) {
+    std::mt19937 rng(params.seed);
+    std::vector<FileOp> ops(params.ops);
+    uint32_t blocks = params.fileKb * 1024 / params.length;
+    for (FileOp& op : ops) {
+        uint32_t roll = rng() % 100;
+        if (roll < 5) {
+            op.kind = FileOpKind::Append;
+            op.file = params.files;
+        } else if (roll < 8) {
+            op.kind = FileOpKind::Size;
+            op.file = rng() % params.files;
+        } else {
+            op.kind = rng() % 100 < params.writePercent ? FileOpKind::Write : FileOpKind::Read;
+            op.file = rng() % 100 < 60 ? 0 : rng() % params.files;
+        }
+        op.offset = (rng() % blocks) * params.length;
+        op.seed = rng();
+    }
+    return ops;
+}
+
+static std::string filePath(const FilesParams& params, const char* run, uint32_t file) {
+    return params.pathPrefix + "." + run + "." + std::to_string(file);
+}
+
+static void fillData(std::vector<uint8_t>& data, uint32_t seed) {
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = static_cast<uint8_t>((seed >> (8 * (i % 4))) + i);
+    }
+}
+
+struct FilesResult {
+    double wallMs = 0;
+    uint64_t opens = 0;
+    uint64_t syncs = 0;
+    SdFileCacheStats cache = {};
+};
+
+// Both runs start from files of the same size
+static bool prepareFiles(const FilesParams& params, const char* run) {
+    std::vector<uint8_t> zero(params.fileKb * 1024, 0);
+    for (uint32_t file = 0; file <= params.files; file++) {
+        FILE* f = std::fopen(filePath(params, run, file).c_str(), "wb");
+        if (!f) return false;
+        bool ok = file == params.files || std::fwrite(zero.data(), 1, zero.size(), f) == zero.size();
+        std::fclose(f);
+        if (!ok) return false;
+    }
+    return true;
+}
+
+static double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+// Old sd_handler: open -> operation -> close for every call
+static bool runUncached(const FilesParams& params, const std::vector<FileOp>& ops, FilesResult& result) {
+    StdioFileBackend backend;
+    std::vector<std::string> paths;
+    for (uint32_t file = 0; file <= params.files; file++) {
+        paths.push_back(filePath(params, "open", file));
+    }
+    std::vector<uint8_t> buffer(params.length);
+
+    auto start = std::chrono::steady_clock::now();
+    for (const FileOp& op : ops) {
+        void* f = backend.open(paths[op.file].c_str(), op.kind == FileOpKind::Append);
+        if (!f) return false;
+        int32_t n = 0;
+        switch (op.kind) {
+            case FileOpKind::Read:
+                n = backend.readAt(f, op.offset, buffer.data(), params.length);
+                break;
+            case FileOpKind::Write:
+                fillData(buffer, op.seed);
+                n = backend.writeAt(f, op.offset, buffer.data(), params.length);
+                break;
+            case FileOpKind::Append:
+                fillData(buffer, op.seed);
+                n = backend.size(f);
+                if (n >= 0) n = backend.writeAt(f, static_cast<uint32_t>(n), buffer.data(), params.length);
+                break;
+            case FileOpKind::Size:
+                n = backend.size(f);
+                break;
+        }
+        backend.close(f);
+        if (n < 0) return false;
+    }
+    result.wallMs = elapsedMs(start);
+    result.opens = backend.opens;
+    result.syncs = backend.syncs;
+    return true;
+}
+
+// sd_handler with the handle cache, periodic sync included
+static bool runCached(const FilesParams& params, const std::vector<FileOp>& ops, FilesResult& result) {
+    StdioFileBackend backend;
+    SdFileCache cache;
+    cache.init(&backend, params.slots);
+    std::vector<std::string> paths;
+    for (uint32_t file = 0; file <= params.files; file++) {
+        paths.push_back(filePath(params, "cached", file));
+    }
+    std::vector<uint8_t> buffer(params.length);
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < ops.size(); i++) {
+        const FileOp& op = ops[i];
+        SdHandle h = cache.open(paths[op.file].c_str(), op.kind == FileOpKind::Append);
+        if (h < 0) return false;
+        int32_t n = 0;
+        switch (op.kind) {
+            case FileOpKind::Read:
+                n = cache.readAt(h, op.offset, buffer.data(), params.length);
+                break;
+            case FileOpKind::Write:
+                fillData(buffer, op.seed);
+                n = cache.writeAt(h, op.offset, buffer.data(), params.length);
+                break;
+            case FileOpKind::Append:
+                fillData(buffer, op.seed);
+                n = cache.size(h);
+                if (n >= 0) n = cache.writeAt(h, static_cast<uint32_t>(n), buffer.data(), params.length);
+                break;
+            case FileOpKind::Size:
+                n = cache.size(h);
+                break;
+        }
+        cache.release(h);
+        if (n < 0) return false;
+
+        // The device syncs from a 1 Hz task; here every 1000 ops stand in for a second
+        if (i % 1000 == 999) {
+            cache.syncDue(static_cast<uint32_t>(i), 1000);
+        }
+    }
+    cache.closeAll();
+    result.wallMs = elapsedMs(start);
+    result.opens = backend.opens;
+    result.syncs = backend.syncs;
+    result.cache = cache.stats();
+    return true;
+}
+
+static bool sameContents(const std::string& a, const std::string& b) {
+    FILE* fa = std::fopen(a.c_str(), "rb");
+    FILE* fb = std::fopen(b.c_str(), "rb");
+    bool same = fa && fb;
+    std::vector<uint8_t> ba(65536), bb(65536);
+    while (same) {
+        size_t na = std::fread(ba.data(), 1, ba.size(), fa);
+        size_t nb = std::fread(bb.data(), 1, bb.size(), fb);
+        same = na == nb && std::equal(ba.begin(), ba.begin() + na, bb.begin());
+        if (na == 0) break;
+    }
+    if (fa) std::fclose(fa);
+    if (fb) std::fclose(fb);
+    return same;
+}
+
+// =============================================================================
+// Report
+// =============================================================================
+
+int filesRun(const FilesParams& params) {
+    std::vector<FileOp> ops = makeWorkload(params);
+
+    std::cout << "File handles: " << params.ops << " ops over " << params.files << " files of "
+              << params.fileKb << " KB + 1 append log, " << params.length << " B transfers, "
+              << params.slots << " cache slots\n\n";
+
+    FilesResult uncached;
+    FilesResult cached;
+    if (!prepareFiles(params, "open") || !prepareFiles(params, "cached") ||
+        !runUncached(params, ops, uncached) || !runCached(params, ops, cached)) {
+        std::cerr << "files: I/O failed\n";
+        return 1;
+    }
+
+    bool same = true;
+    for (uint32_t file = 0; file <= params.files; file++) {
+        same = same && sameContents(filePath(params, "open", file), filePath(params, "cached", file));
+        unlink(filePath(params, "open", file).c_str());
+        unlink(filePath(params, "cached", file).c_str());
+    }
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << std::setw(16) << "mode" << std::setw(12) << "wall ms" << std::setw(14) << "ops/s"
+              << std::setw(10) << "opens" << std::setw(10) << "syncs" << std::setw(14) << "open cost ms" << "\n";
+    const FilesResult* results[] = {&uncached, &cached};
+    const char* names[] = {"open per op", "handle cache"};
+    for (int i = 0; i < 2; i++) {
+        const FilesResult& r = *results[i];
+        std::cout << std::setw(16) << names[i] << std::setw(12) << r.wallMs
+                  << std::setw(14) << (r.wallMs > 0 ? params.ops / (r.wallMs / 1000.0) : 0.0)
+                  << std::setw(10) << r.opens << std::setw(10) << r.syncs
+                  << std::setw(14) << r.opens * static_cast<double>(params.openLatencyUs) / 1000.0 << "\n";
+    }
+    std::cout << "\nCache: " << cached.cache.hits << " hits, " << cached.cache.misses << " misses, "
+              << cached.cache.evictions << " evictions, " << cached.cache.syncs << " syncs\n";
+    if (cached.wallMs > 0) {
+        std::cout << "Speedup: " << std::setprecision(2) << uncached.wallMs / cached.wallMs << "x\n";
+    }
+    std::cout << "Contents: " << (same ? "identical" : "DIFFERENT") << "\n";
+    return same ? 0 : 1;
+}
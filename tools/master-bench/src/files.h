@@ -0,0 +1,31 @@
+#ifndef FILES_H
+#define FILES_H
+
+#include <cstdint>
+#include <string>
+
+// =============================================================================
+// SD File Handle Cache Benchmark
+// =============================================================================
+// Replays one random workload against a few files twice: opening and
+// closing the file around every operation, as sd_handler did before its
+// handle cache, and through SdFileCache. Operations mirror what the master
+// does on the card - positioned page reads and writes on the swap files,
+// appends to a log, size queries. Both runs must leave identical files.
+
+struct FilesParams {
+    uint32_t files = 4;             // Files the workload spreads over
+    uint32_t fileKb = 1024;         // Size of each positioned-I/O file
+    uint32_t slots = 6;             // Cache slots (SD_FILE_CACHE_SIZE on the device)
+    uint32_t ops = 100000;
+    uint32_t length = 512;          // Bytes per read/write
+    uint32_t writePercent = 30;
+    uint32_t openLatencyUs = 0;     // Modeled cost of one open (path lookup + chain walk)
+    uint32_t seed = 1;
+    std::string pathPrefix;
+};
+
+// Returns 0 when both runs produced identical files
+int filesRun(const FilesParams& params);
+
+#endif // FILES_H
@@ -0,0 +1,204 @@
+#include "logring.h"
+#include "master/log_ring.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// =============================================================================
+// Formatting
+// =============================================================================
+
+static const char* const HEARTBEAT = "Heartbeat: %s, rpm=%u, pwm=%u\n";
+
+// The same message through the ring and through snprintf, into a buffer of size
+template <typename... Args>
+static bool formatMatches(LogRing& ring, size_t size, const char* format, Args... args) {
+    char expected[256];
+    char actual[256];
+    snprintf(expected, size, format, args...);
+
+    LogRecord record;
+    if (!ring.push(0, format, args...) || !ring.pop(&record)) {
+        std::cout << "  ring refused: " << format;
+        return false;
+    }
+    size_t length = logFormat(&record, actual, size);
+    if (std::strcmp(expected, actual) != 0 || length != std::strlen(expected)) {
+        std::cout << "  mismatch for \"" << format << "\":\n    snprintf:  " << expected
+                  << "\n    logFormat: " << actual << "\n";
+        return false;
+    }
+    return true;
+}
+
+static uint32_t checkFormats(LogRing& ring) {
+    uint32_t failures = 0;
+    int local = 0;
+    failures += !formatMatches(ring, 256, HEARTBEAT, "OK", 3500u, 200u);
+    failures += !formatMatches(ring, 256, "%d %i %5d %-5d| %05d %+d\n", -42, 7, 123, 45, 9, 3);
+    failures += !formatMatches(ring, 256, "%ld %lu %lld %llu\n", -123456789L, 4000000000UL,
+                               -1234567890123LL, 18000000000000000000ULL);
+    failures += !formatMatches(ring, 256, "%zu %hu %hhu %c%c\n", static_cast<size_t>(123456),
+                               static_cast<unsigned short>(65535),
+                               static_cast<unsigned char>(200), 'o', 'k');
+    failures += !formatMatches(ring, 256, "%x %X %08X 0x%02X %#o\n", 0xbeefu, 0xCAFEu, 0x1234u,
+                               0x5u, 8u);
+    failures += !formatMatches(ring, 256, "%.1f F %.3fV %e %g\n", 212.45, 3.3f, 0.000123, 1e10);
+    failures += !formatMatches(ring, 256, "%s|%10s|%-6s|%.3s\n", "a", "right", "left", "truncate");
+    failures += !formatMatches(ring, 256, "100%% %s %p\n", "done", static_cast<void*>(&local));
+    failures += !formatMatches(ring, 12, HEARTBEAT, "SPI_TIMEOUT", 4000u, 255u);
+    return failures;
+}
+
+// =============================================================================
+// Cost per message
+// =============================================================================
+
+static void measureCost(LogRing& ring, uint32_t messages) {
+    const uint32_t batch = ring.capacity();
+    const uint32_t batches = (messages + batch - 1) / batch;
+    char line[160];
+    volatile size_t sink = 0;
+    double pushNs = 0;
+    double drainNs = 0;
+    double inPlaceNs = 0;
+
+    for (uint32_t b = 0; b < batches; b++) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < batch; i++) {
+            uint32_t n = b * batch + i;
+            ring.push(n, HEARTBEAT, "OK", 3500u + (n & 511), 200u + (n & 31));
+        }
+        auto pushed = std::chrono::steady_clock::now();
+        LogRecord record;
+        while (ring.pop(&record)) {
+            sink = sink + logFormat(&record, line, sizeof(line));
+        }
+        auto drained = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < batch; i++) {
+            uint32_t n = b * batch + i;
+            sink = sink + snprintf(line, sizeof(line), HEARTBEAT, "OK", 3500u + (n & 511),
+                                   200u + (n & 31));
+        }
+        auto formatted = std::chrono::steady_clock::now();
+
+        pushNs += std::chrono::duration<double, std::nano>(pushed - start).count();
+        drainNs += std::chrono::duration<double, std::nano>(drained - pushed).count();
+        inPlaceNs += std::chrono::duration<double, std::nano>(formatted - drained).count();
+    }
+
+    double total = static_cast<double>(batches) * batch;
+    std::cout << std::fixed << std::setprecision(0);
+    std::cout << "Cost:    heartbeat message, " << static_cast<uint64_t>(total) << " times\n";
+    std::cout << "         push " << pushNs / total << " ns (real-time task), pop + format "
+              << drainNs / total << " ns (Log task), snprintf in place "
+              << inPlaceNs / total << " ns\n";
+    std::cout << "         record " << sizeof(LogSlot) << " B, ring " << ring.capacity()
+              << " slots = " << ring.capacity() * sizeof(LogSlot) << " B\n\n";
+}
+
+// =============================================================================
+// Producers and consumer
+// =============================================================================
+
+static const char* const NUMBERED = "%u %u\n";
+
+int logRingRun(const LogRingParams& params) {
+    std::vector<LogSlot> slots(params.slots);
+    LogRing ring;
+    if (!ring.init(slots.data(), params.slots)) {
+        std::cerr << "Error: --slots must be a power of two\n";
+        return 1;
+    }
+
+    std::cout << "Log ring: " << params.slots << " slots, " << params.threads
+              << " producers x " << params.ops << " records\n\n";
+
+    uint32_t formatFailures = checkFormats(ring);
+    std::cout << "Format:  " << (formatFailures == 0 ? "matches snprintf" : "MISMATCH") << "\n\n";
+
+    measureCost(ring, params.ops * params.threads);
+
+    ring.init(slots.data(), params.slots);
+    std::vector<uint32_t> refused(params.threads, 0);
+    std::atomic<uint32_t> running(params.threads);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> producers;
+    for (uint32_t t = 0; t < params.threads; t++) {
+        producers.emplace_back([&, t]() {
+            for (uint32_t seq = 0; seq < params.ops; seq++) {
+                if (!ring.push(seq, NUMBERED, t, seq)) {
+                    // Dropped like on the device; let the consumer catch up
+                    refused[t]++;
+                    std::this_thread::yield();
+                }
+            }
+            running--;
+        });
+    }
+
+    // Consumer: every record once, in order per producer
+    std::vector<uint32_t> received(params.threads, 0);
+    std::vector<int64_t> last(params.threads, -1);
+    uint32_t errors = 0;
+    LogRecord record;
+    while (true) {
+        bool done = running.load() == 0;
+        bool any = false;
+        while (ring.pop(&record)) {
+            any = true;
+            uint32_t values[2];
+            if (record.format != NUMBERED || record.argBytes != sizeof(values)) {
+                errors++;
+                continue;
+            }
+            std::memcpy(values, record.args, sizeof(values));
+            uint32_t t = values[0];
+            if (t >= params.threads || values[1] != record.timeUs ||
+                static_cast<int64_t>(values[1]) <= last[t]) {
+                errors++;
+                continue;
+            }
+            last[t] = values[1];
+            received[t]++;
+        }
+        if (done && !any) {
+            break;
+        }
+        if (!any) {
+            std::this_thread::yield();
+        }
+    }
+    for (std::thread& p : producers) {
+        p.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t total = static_cast<uint64_t>(params.threads) * params.ops;
+    uint64_t got = 0;
+    uint64_t lost = 0;
+    for (uint32_t t = 0; t < params.threads; t++) {
+        got += received[t];
+        // Each producer knows what it could not push; nothing else may be missing
+        int64_t missing = static_cast<int64_t>(params.ops) - received[t] - refused[t];
+        lost += static_cast<uint64_t>(missing < 0 ? -missing : missing);
+    }
+
+    std::cout << std::setprecision(1);
+    std::cout << "Threads: " << got << " received, " << ring.dropped() << " dropped ("
+              << std::setprecision(2) << 100.0 * ring.dropped() / total << "%), "
+              << ring.maxDepth() << "/" << ring.capacity() << " waiting at most, "
+              << std::setprecision(1) << total / seconds / 1e6 << " M records/s\n";
+
+    bool ok = formatFailures == 0 && errors == 0 && lost == 0 && got + ring.dropped() == total;
+    std::cout << "Check:   " << errors << " out of order or corrupt, " << lost << " lost: "
+              << (ok ? "OK" : "MISMATCH") << "\n";
+    return ok ? 0 : 1;
+}
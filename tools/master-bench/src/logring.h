@@ -0,0 +1,28 @@
+#ifndef LOGRING_BENCH_H
+#define LOGRING_BENCH_H
+
+#include "shared/config.h"
+
+#include <cstdint>
+
+// =============================================================================
+// Deferred Log Ring Benchmark
+// =============================================================================
+// Checks logFormat() against snprintf over the conversions the firmware
+// uses, then measures what a real-time task pays per message - a push into
+// the master's LogRing - against formatting it in place, and what the Log
+// task pays to pop and format it later. Finally several producer threads
+// push numbered records into one ring while a consumer drains it; every
+// record must come out once, in order per producer, or be counted as
+// dropped.
+
+struct LogRingParams {
+    uint32_t slots = LOG_RING_SLOTS;    // Ring size, power of two
+    uint32_t threads = 4;               // Producers
+    uint32_t ops = 100000;              // Records per producer
+};
+
+// Returns 0 when formatting matched and no record was lost or reordered
+int logRingRun(const LogRingParams& params);
+
+#endif // LOGRING_BENCH_H
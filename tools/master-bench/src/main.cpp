@@ -0,0 +1,415 @@
+#include "cancapture.h"
+#include "canfilter.h"
+#include "canstats.h"
+#include "cantx.h"
+#include "files.h"
+#include "logring.h"
+#include "replay.h"
+#include "sdio.h"
+#include "signals.h"
+#include "telemetry.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// =============================================================================
+// Options
+// =============================================================================
+
+struct BenchOptions {
+    // Shared by several benchmarks
+    uint32_t ops = 100000;
+    uint32_t length = 64;
+    uint32_t writePercent = 30;
+    uint32_t threads = 4;
+    uint32_t seed = 1;
+    uint32_t writeLatencyUs = 0;        // Card model, 0 = benchmark default
+    uint32_t throughputKBps = 0;
+    std::string prefix;
+
+    FilesParams files;
+    SdioParams sdio;
+    TelemetryParams telemetry;
+    LogRingParams logring;
+    CanFilterParams canfilter;
+    SignalsParams signals;
+    CanTxParams cantx;
+    CanCaptureParams cancapture;
+    CanStatsParams canstats;
+    ReplayParams replay;
+};
+
+// Card model shared by the SD benchmarks
+template <typename Params>
+static void applyCard(const BenchOptions& opts, Params& params) {
+    if (opts.writeLatencyUs > 0) params.opLatencyUs = opts.writeLatencyUs;
+    if (opts.throughputKBps > 0) params.throughputKBps = opts.throughputKBps;
+}
+
+// =============================================================================
+// Commands
+// =============================================================================
+// Each checks its options, prints why they are out of range and returns 1,
+// or runs its benchmark and returns that result
+
+static int cmdFiles(const std::vector<std::string>&, const BenchOptions& opts) {
+    FilesParams params = opts.files;
+    if (params.files == 0 || opts.length == 0 || params.fileKb * 1024 < opts.length) {
+        std::cerr << "Error: --files, --length and --file-kb must allow at least one transfer\n";
+        return 1;
+    }
+    params.ops = opts.ops;
+    params.length = opts.length;
+    params.writePercent = opts.writePercent;
+    params.seed = opts.seed;
+    params.pathPrefix = opts.prefix;
+    return filesRun(params);
+}
+
+static int cmdSdio(const std::vector<std::string>&, const BenchOptions& opts) {
+    SdioParams params = opts.sdio;
+    if (params.seconds == 0 || params.seconds > 3600 || params.depth < 2 ||
+        params.depth > SD_IO_QUEUE_MAX || params.reserve >= params.depth) {
+        std::cerr << "Error: --seconds must be 1..3600, --depth 2.." << SD_IO_QUEUE_MAX
+                  << " and --reserve below --depth\n";
+        return 1;
+    }
+    applyCard(opts, params);
+    params.seed = opts.seed;
+    return sdioRun(params);
+}
+
+static int cmdTelemetry(const std::vector<std::string>&, const BenchOptions& opts) {
+    TelemetryParams params = opts.telemetry;
+    if (params.seconds == 0 || params.seconds > 86400 || params.rateHz == 0 ||
+        params.rateHz > 100000 || params.chunkKb == 0 || params.chunkKb > 1024 ||
+        params.chunkKb > params.fileMb * 1024 || params.buffers == 0 ||
+        params.buffers > TELEMETRY_MAX_BUFFERS) {
+        std::cerr << "Error: --seconds must be 1..86400, --rate-hz 1..100000, --chunk-kb 1..1024"
+                  << " and --buffers 1.." << TELEMETRY_MAX_BUFFERS << "\n";
+        return 1;
+    }
+    applyCard(opts, params);
+    params.seed = opts.seed;
+    return telemetryRun(params);
+}
+
+static int cmdLogRing(const std::vector<std::string>&, const BenchOptions& opts) {
+    LogRingParams params = opts.logring;
+    if (params.slots < 2 || (params.slots & (params.slots - 1)) != 0 || opts.threads == 0 ||
+        opts.threads > 64 || opts.ops == 0) {
+        std::cerr << "Error: --slots must be a power of two, --threads 1..64 and --ops at least 1\n";
+        return 1;
+    }
+    params.threads = opts.threads;
+    params.ops = opts.ops;
+    return logRingRun(params);
+}
+
+static int cmdCanFilter(const std::vector<std::string>&, const BenchOptions& opts) {
+    CanFilterParams params = opts.canfilter;
+    if (params.ids == 0 || params.ids > CAN_FILTER_MAX_IDS || params.seconds == 0 ||
+        params.seconds > 3600) {
+        std::cerr << "Error: --ids must be 1.." << CAN_FILTER_MAX_IDS << " and --seconds 1..3600\n";
+        return 1;
+    }
+    params.seed = opts.seed;
+    return canFilterRun(params);
+}
+
+static int cmdSignals(const std::vector<std::string>&, const BenchOptions& opts) {
+    if (opts.ops == 0) {
+        std::cerr << "Error: --ops must be at least 1\n";
+        return 1;
+    }
+    SignalsParams params = opts.signals;
+    params.frames = opts.ops;
+    params.seed = opts.seed;
+    return signalsRun(params);
+}
+
+static int cmdCanTx(const std::vector<std::string>&, const BenchOptions& opts) {
+    CanTxParams params = opts.cantx;
+    if (params.seconds < 10 || params.seconds > 86400) {
+        std::cerr << "Error: --seconds must be 10..86400\n";
+        return 1;
+    }
+    params.seed = opts.seed;
+    return canTxRun(params);
+}
+
+static int cmdCanCapture(const std::vector<std::string>&, const BenchOptions& opts) {
+    CanCaptureParams params = opts.cancapture;
+    if (params.seconds == 0 || params.seconds > 3600 || params.blockKb == 0 ||
+        params.blockKb > 1024 || params.buffers < 2 || params.buffers > CAN_CAPTURE_MAX_BUFFERS ||
+        params.usbKBps == 0) {
+        std::cerr << "Error: --seconds must be 1..3600, --block-kb 1..1024, --buffers 2.."
+                  << CAN_CAPTURE_MAX_BUFFERS << " and --usb-kbps at least 1\n";
+        return 1;
+    }
+    applyCard(opts, params);
+    params.seed = opts.seed;
+    return canCaptureRun(params);
+}
+
+static int cmdCanStats(const std::vector<std::string>&, const BenchOptions& opts) {
+    CanStatsParams params = opts.canstats;
+    if (params.seconds < 3 || params.seconds > 3600 || params.ids == 0 ||
+        params.ids > CAN_STATS_SLOTS / 2) {
+        std::cerr << "Error: --seconds must be 3..3600 and --ids 1.." << CAN_STATS_SLOTS / 2 << "\n";
+        return 1;
+    }
+    params.seed = opts.seed;
+    return canStatsRun(params);
+}
+
+static int cmdReplay(const std::vector<std::string>& args, const BenchOptions& opts) {
+    ReplayParams params = opts.replay;
+    if (args.empty() && (params.seconds < 10 || params.seconds > 3600)) {
+        std::cerr << "Error: --seconds must be 10..3600\n";
+        return 1;
+    }
+    params.files = args;
+    params.seed = opts.seed;
+    return replayRun(params);
+}
+
+struct Command {
+    const char* name;
+    const char* args;
+    const char* summary;
+    int (*run)(const std::vector<std::string>& args, const BenchOptions& opts);
+};
+
+static const Command COMMANDS[] = {
+    {"files", "", "sd_handler file access with and without the open file cache", cmdFiles},
+    {"sdio", "", "Master SD traffic mix in arrival order vs the SD I/O priority queue", cmdSdio},
+    {"telemetry", "", "Telemetry recorder encode rate, then drops against a stalling card",
+     cmdTelemetry},
+    {"logring", "", "Deferred log ring: push vs format cost, then concurrent producers",
+     cmdLogRing},
+    {"canfilter", "", "MCP2515 mask/filter plans for growing sets of wanted CAN IDs",
+     cmdCanFilter},
+    {"signals", "", "CAN signal table decoding rate, checked against a bit-by-bit reference",
+     cmdSignals},
+    {"cantx", "", "Volvo EHPS transmit schedule in simulated time: rate, jitter, alive gate",
+     cmdCanTx},
+    {"cancapture", "", "CAN capture at 100% bus load to SD and USB, every frame read back",
+     cmdCanCapture},
+    {"canstats", "", "Per-ID CAN statistics and bus load on a simulated bus, checked exactly",
+     cmdCanStats},
+    {"replay", " [capture.cap ...]", "CAN capture through decoding and pump assist in simulated time",
+     cmdReplay},
+};
+
+// =============================================================================
+// Usage
+// =============================================================================
+
+static void printUsage(const char* progName) {
+    std::cout << "master-bench - Host benchmarks for the master's SD, logging and CAN modules\n\n";
+    std::cout << "Each benchmark runs the firmware's own code on simulated input and checks\n";
+    std::cout << "the result against a reference; the exit status is 0 only if it matched.\n\n";
+    std::cout << "Usage:\n";
+    for (const Command& command : COMMANDS) {
+        std::cout << "  " << progName << " " << command.name << command.args << " [options]\n";
+        std::cout << "      " << command.summary << "\n\n";
+    }
+    std::cout << "Common options:\n";
+    std::cout << "  --seed <n>             Random seed (default: 1)\n";
+    std::cout << "  --write-latency-us <n> Card cost per write for sdio, telemetry and cancapture\n";
+    std::cout << "  --throughput-kbps <n>  Card transfer rate in KB/s for the same\n\n";
+    std::cout << "Files options:\n";
+    std::cout << "  --files <n>            Random-access files (default: 4)\n";
+    std::cout << "  --file-kb <n>          Size of each file (default: 1024)\n";
+    std::cout << "  --slots <n>            Open file cache slots (default: " << SD_FILE_CACHE_SIZE << ")\n";
+    std::cout << "  --ops <n>              Operations (default: 100000)\n";
+    std::cout << "  --length <n>           Bytes per read/write (default: 64)\n";
+    std::cout << "  --write-pct <n>        Percentage of writes (default: 30)\n";
+    std::cout << "  --open-latency-us <n>  Modeled cost of one open on the card (default: 0)\n";
+    std::cout << "  --prefix <path>        Bench files (default: /tmp/master-bench-<pid>)\n\n";
+    std::cout << "SD I/O options:\n";
+    std::cout << "  --seconds <n>          Simulated time (default: 10)\n";
+    std::cout << "  --depth <n>            Queue slots, at most " << SD_IO_QUEUE_MAX
+              << " (default: 16)\n";
+    std::cout << "  --reserve <n>          Slots kept for safety logs (default: 2)\n\n";
+    std::cout << "Telemetry options:\n";
+    std::cout << "  --seconds <n>          Recording time (default: 600)\n";
+    std::cout << "  --rate-hz <n>          Samples per second (default: 1000)\n";
+    std::cout << "  --chunk-kb <n>         Chunk size (default: " << TELEMETRY_CHUNK_KB << ")\n";
+    std::cout << "  --buffers <n>          Chunk buffers, at most " << TELEMETRY_MAX_BUFFERS
+              << " (default: " << TELEMETRY_BUFFERS << ")\n";
+    std::cout << "  --stall-ms <n>         Card stall every 10 s (default: 250)\n\n";
+    std::cout << "Log ring options:\n";
+    std::cout << "  --slots <n>            Ring slots, power of two (default: " << LOG_RING_SLOTS << ")\n";
+    std::cout << "  --threads <n>          Producer threads (default: 4)\n";
+    std::cout << "  --ops <n>              Records per producer (default: 100000)\n\n";
+    std::cout << "CAN filter options:\n";
+    std::cout << "  --ids <n>              Largest wanted ID set, at most " << CAN_FILTER_MAX_IDS
+              << " (default: 12)\n";
+    std::cout << "  --seconds <n>          Surveyed bus time (default: 10)\n\n";
+    std::cout << "Signals options:\n";
+    std::cout << "  --ops <n>              Frames to decode (default: 100000)\n\n";
+    std::cout << "CAN TX options:\n";
+    std::cout << "  --seconds <n>          Simulated time (default: 60)\n\n";
+    std::cout << "CAN capture options:\n";
+    std::cout << "  --seconds <n>          Bus time (default: 60)\n";
+    std::cout << "  --block-kb <n>         Block size (default: " << CAN_CAPTURE_BLOCK_KB << ")\n";
+    std::cout << "  --buffers <n>          Block buffers, at most " << CAN_CAPTURE_MAX_BUFFERS
+              << " (default: " << CAN_CAPTURE_BUFFERS << ")\n";
+    std::cout << "  --stall-ms <n>         Card stall every 10 s (default: 250)\n";
+    std::cout << "  --usb-kbps <n>         USB stream rate (default: 1000)\n\n";
+    std::cout << "CAN stats options:\n";
+    std::cout << "  --seconds <n>          Bus time (default: 60)\n";
+    std::cout << "  --ids <n>              Periodic IDs on the bus, at most " << CAN_STATS_SLOTS / 2
+              << " (default: 80)\n\n";
+    std::cout << "CAN replay options (no capture file = synthetic drive):\n";
+    std::cout << "  --seconds <n>          Synthetic drive (default: 120)\n";
+    std::cout << "  --speed <n>            Pace against the wall clock at n x real time (default: 0 = max)\n";
+    std::cout << "  --csv <path>           Write every change of RPM, duty and EHPS speed\n\n";
+    std::cout << "Other:\n";
+    std::cout << "  --help                 Show this help\n";
+}
+
+// =============================================================================
+// Main
+// =============================================================================
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::string name = argv[1];
+
+    if (name == "--help" || name == "-h") {
+        printUsage(argv[0]);
+        return 0;
+    }
+
+    const Command* command = nullptr;
+    for (const Command& candidate : COMMANDS) {
+        if (name == candidate.name) {
+            command = &candidate;
+        }
+    }
+    if (!command) {
+        std::cerr << "Unknown command: " << name << "\n\n";
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    BenchOptions opts;
+
+    enum {
+        OPT_OPS = 1000, OPT_LENGTH, OPT_WRITE_PCT, OPT_SEED, OPT_WRITE_LAT, OPT_THROUGHPUT,
+        OPT_THREADS, OPT_FILES, OPT_FILE_KB, OPT_SLOTS, OPT_OPEN_LAT, OPT_PREFIX,
+        OPT_SECONDS, OPT_DEPTH, OPT_RESERVE, OPT_RATE_HZ, OPT_CHUNK_KB, OPT_BUFFERS,
+        OPT_STALL_MS, OPT_IDS, OPT_BLOCK_KB, OPT_USB_KBPS, OPT_SPEED, OPT_CSV
+    };
+
+    static struct option longOptions[] = {
+        {"ops", required_argument, nullptr, OPT_OPS},
+        {"length", required_argument, nullptr, OPT_LENGTH},
+        {"write-pct", required_argument, nullptr, OPT_WRITE_PCT},
+        {"seed", required_argument, nullptr, OPT_SEED},
+        {"write-latency-us", required_argument, nullptr, OPT_WRITE_LAT},
+        {"throughput-kbps", required_argument, nullptr, OPT_THROUGHPUT},
+        {"threads", required_argument, nullptr, OPT_THREADS},
+        {"files", required_argument, nullptr, OPT_FILES},
+        {"file-kb", required_argument, nullptr, OPT_FILE_KB},
+        {"slots", required_argument, nullptr, OPT_SLOTS},
+        {"open-latency-us", required_argument, nullptr, OPT_OPEN_LAT},
+        {"prefix", required_argument, nullptr, OPT_PREFIX},
+        {"seconds", required_argument, nullptr, OPT_SECONDS},
+        {"depth", required_argument, nullptr, OPT_DEPTH},
+        {"reserve", required_argument, nullptr, OPT_RESERVE},
+        {"rate-hz", required_argument, nullptr, OPT_RATE_HZ},
+        {"chunk-kb", required_argument, nullptr, OPT_CHUNK_KB},
+        {"buffers", required_argument, nullptr, OPT_BUFFERS},
+        {"stall-ms", required_argument, nullptr, OPT_STALL_MS},
+        {"ids", required_argument, nullptr, OPT_IDS},
+        {"block-kb", required_argument, nullptr, OPT_BLOCK_KB},
+        {"usb-kbps", required_argument, nullptr, OPT_USB_KBPS},
+        {"speed", required_argument, nullptr, OPT_SPEED},
+        {"csv", required_argument, nullptr, OPT_CSV},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}
+    };
+
+    // Skip command name for getopt
+    optind = 2;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "h", longOptions, nullptr)) != -1) {
+        uint32_t value = optarg ? static_cast<uint32_t>(std::strtoul(optarg, nullptr, 0)) : 0;
+        switch (opt) {
+            case OPT_OPS:         opts.ops = value; break;
+            case OPT_LENGTH:      opts.length = value; break;
+            case OPT_WRITE_PCT:   opts.writePercent = value; break;
+            case OPT_SEED:        opts.seed = value; break;
+            case OPT_WRITE_LAT:   opts.writeLatencyUs = value; break;
+            case OPT_THROUGHPUT:  opts.throughputKBps = value; break;
+            case OPT_THREADS:     opts.threads = value; break;
+            case OPT_FILES:       opts.files.files = value; break;
+            case OPT_FILE_KB:     opts.files.fileKb = value; break;
+            case OPT_SLOTS:
+                opts.files.slots = value;
+                opts.logring.slots = value;
+                break;
+            case OPT_OPEN_LAT:    opts.files.openLatencyUs = value; break;
+            case OPT_PREFIX:      opts.prefix = optarg; break;
+            case OPT_SECONDS:
+                opts.sdio.seconds = value;
+                opts.telemetry.seconds = value;
+                opts.canfilter.seconds = value;
+                opts.cantx.seconds = value;
+                opts.cancapture.seconds = value;
+                opts.canstats.seconds = value;
+                opts.replay.seconds = value;
+                break;
+            case OPT_DEPTH:       opts.sdio.depth = value; break;
+            case OPT_RESERVE:     opts.sdio.reserve = value; break;
+            case OPT_RATE_HZ:     opts.telemetry.rateHz = value; break;
+            case OPT_CHUNK_KB:    opts.telemetry.chunkKb = value; break;
+            case OPT_BUFFERS:
+                opts.telemetry.buffers = value;
+                opts.cancapture.buffers = value;
+                break;
+            case OPT_STALL_MS:
+                opts.telemetry.stallMs = value;
+                opts.cancapture.stallMs = value;
+                break;
+            case OPT_IDS:
+                opts.canfilter.ids = value;
+                opts.canstats.ids = value;
+                break;
+            case OPT_BLOCK_KB:    opts.cancapture.blockKb = value; break;
+            case OPT_USB_KBPS:    opts.cancapture.usbKBps = value; break;
+            case OPT_SPEED:       opts.replay.speed = value; break;
+            case OPT_CSV:         opts.replay.csvPath = optarg; break;
+            case 'h':
+                printUsage(argv[0]);
+                return 0;
+            default:
+                return 1;
+        }
+    }
+
+    std::vector<std::string> args;
+    for (int i = optind; i < argc; i++) {
+        args.push_back(argv[i]);
+    }
+
+    if (opts.prefix.empty()) {
+        opts.prefix = "/tmp/master-bench-" + std::to_string(getpid());
+    }
+
+    return command->run(args, opts);
+}
@@ -0,0 +1,490 @@
+#include "replay.h"
+#include "master/can_capture_log.h"
+#include "master/can_frame_ring.h"
+#include "master/can_replay_log.h"
+#include "master/can_signal.h"
+#include "master/pump_assist.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+static const uint64_t UI_PERIOD_US = 20000;             // UI_TASK_PERIOD_MS
+static const uint64_t PUMP_PERIOD_US = 10000;           // PUMP_TASK_PERIOD_MS
+static const uint64_t FLUSH_US = CAN_CAPTURE_FLUSH_MS * 1000ULL;
+static const uint64_t DRIVE_START_US = 1000000;
+static const uint32_t DROPPED_BLOCK = 5;                // Synthetic capture: lost on the way
+static const uint32_t CORRUPTED_BLOCK = 11;             // Synthetic capture: a flipped bit
+
+// =============================================================================
+// Synthetic Drive
+// =============================================================================
+
+// Engine RPM over a 40 s cycle: idle, pull away, a rev past full assist,
+// cruise with some ripple, slow down, idle
+static uint16_t engineRpm(uint64_t t) {
+    double s = std::fmod((t - DRIVE_START_US) / 1e6, 40.0);
+    double rpm;
+    if (s < 5) rpm = 800;
+    else if (s < 15) rpm = 800 + (s - 5) * 220;
+    else if (s < 20) rpm = 3000 + std::sin((s - 15) * M_PI / 5) * 1600;
+    else if (s < 30) rpm = 2200 + std::sin(s * 3) * 100;
+    else if (s < 35) rpm = 2200 - (s - 30) * 280;
+    else rpm = 800;
+    return static_cast<uint16_t>(rpm);
+}
+
+struct Source {
+    uint32_t id;
+    bool extended;
+    uint64_t periodUs;
+};
+
+static std::vector<CanFrame> makeDrive(uint32_t seconds, uint32_t seed) {
+    static const uint64_t PERIODS_MS[] = {10, 20, 50, 100, 200, 500, 1000};
+    std::mt19937 rng(seed);
+
+    std::vector<Source> sources;
+    sources.push_back({CAN_DEFAULT_SIGNALS[CAN_SIGNAL_ENGINE_RPM].id, false, 10000});
+    sources.push_back({CAN_DEFAULT_SIGNALS[CAN_SIGNAL_PUMP_STATUS].id, true, 20000});
+    sources.push_back({CAN_DEFAULT_SIGNALS[CAN_SIGNAL_VEHICLE_SPEED].id, true, EHPS_SPEED_PERIOD_US});
+    while (sources.size() < 43) {
+        uint32_t id = 0x100 + rng() % 0x600;
+        sources.push_back({id, false, PERIODS_MS[rng() % 7] * 1000});
+    }
+
+    const uint64_t endUs = DRIVE_START_US + static_cast<uint64_t>(seconds) * 1000000ULL;
+    std::vector<CanFrame> frames;
+    for (size_t i = 0; i < sources.size(); i++) {
+        const Source& src = sources[i];
+        uint64_t phase = rng() % src.periodUs;
+        for (uint32_t k = 0;; k++) {
+            uint64_t t = DRIVE_START_US + phase + k * src.periodUs + rng() % 400;
+            if (t >= endUs) break;
+            CanFrame f;
+            std::memset(&f, 0, sizeof(f));
+            f.timeUs = t;
+            f.id = src.id;
+            f.flags = src.extended ? CAN_FRAME_EXTENDED : 0;
+            f.dlc = 8;
+            if (i == 0) {
+                uint16_t rpm = engineRpm(t);
+                f.data[0] = static_cast<uint8_t>(rpm);
+                f.data[1] = static_cast<uint8_t>(rpm >> 8);
+                f.data[2] = static_cast<uint8_t>(k);
+            } else if (i <= 2) {
+                uint16_t value = static_cast<uint16_t>(i == 1 ? 0x0100 + k % 16 : 0x2000 - engineRpm(t));
+                f.data[6] = static_cast<uint8_t>(value >> 8);
+                f.data[7] = static_cast<uint8_t>(value);
+            } else {
+                f.data[0] = static_cast<uint8_t>(k);
+                for (int b = 1; b < 8; b++) f.data[b] = static_cast<uint8_t>(rng());
+            }
+            frames.push_back(f);
+        }
+    }
+    std::stable_sort(frames.begin(), frames.end(),
+                     [](const CanFrame& a, const CanFrame& b) { return a.timeUs < b.timeUs; });
+    return frames;
+}
+
+// Capture the drive the way the RX task does, buffers back at once; log
+// text now and then between blocks, one block lost and one corrupted.
+// expected gets the frames a reader should find.
+static std::vector<uint8_t> captureDrive(const std::vector<CanFrame>& frames,
+                                         std::vector<CanFrame>* expected) {
+    const uint32_t blockBytes = CAN_CAPTURE_BLOCK_KB * 1024;
+    std::vector<std::vector<uint8_t>> storage(2, std::vector<uint8_t>(blockBytes));
+    uint8_t* buffers[2] = {storage[0].data(), storage[1].data()};
+    CanCaptureWriter writer;
+    writer.init(buffers, 2, blockBytes);
+
+    std::vector<uint8_t> stream;
+    size_t stored = 0;
+    auto emit = [&](const CanCaptureBlock& block) {
+        uint32_t records = (block.length - sizeof(CanCaptureBlockHeader)) / sizeof(CanCaptureRecord);
+        if (block.sequence % 7 == 3) {
+            std::ostringstream text;
+            text << "[" << block.sequence * 137 << "] CAN TX: sending\n";
+            std::string line = text.str();
+            stream.insert(stream.end(), line.begin(), line.end());
+        }
+        if (block.sequence != DROPPED_BLOCK) {
+            size_t at = stream.size();
+            stream.insert(stream.end(), block.data, block.data + block.length);
+            if (block.sequence == CORRUPTED_BLOCK) {
+                stream[at + block.length / 2] ^= 0x10;
+            } else {
+                expected->insert(expected->end(), frames.begin() + stored,
+                                 frames.begin() + stored + records);
+            }
+        }
+        stored += records;
+        writer.release(block.buffer);
+    };
+
+    CanCaptureBlock block;
+    for (const CanFrame& f : frames) {
+        if (writer.flush(f.timeUs, FLUSH_US, &block)) emit(block);
+        if (writer.add(f, &block)) emit(block);
+    }
+    if (writer.flush(frames.back().timeUs, 0, &block)) emit(block);
+    return stream;
+}
+
+// =============================================================================
+// Reading
+// =============================================================================
+
+// Hands the stream to the reader in chunks of up to maxChunk bytes (0 =
+// whatever fits, as the device reads), returns false at the end
+struct Feeder {
+    const std::vector<uint8_t>& stream;
+    CanReplayReader reader;
+    std::vector<uint8_t> buffer;
+    size_t pos = 0;
+    uint32_t maxChunk;
+    std::mt19937 rng;
+
+    Feeder(const std::vector<uint8_t>& s, uint32_t bufferBytes, uint32_t chunk, uint32_t seed)
+        : stream(s), buffer(bufferBytes), maxChunk(chunk), rng(seed) {
+        reader.init(buffer.data(), bufferBytes);
+    }
+
+    bool next(CanFrame* frame) {
+        while (!reader.next(frame)) {
+            if (reader.done()) return false;
+            uint32_t room;
+            uint8_t* at = reader.space(&room);
+            size_t n = std::min<size_t>(room, stream.size() - pos);
+            if (maxChunk > 0) n = std::min<size_t>(n, 1 + rng() % maxChunk);
+            if (at != nullptr && n > 0) {
+                std::memcpy(at, stream.data() + pos, n);
+                reader.filled(static_cast<uint32_t>(n));
+                pos += n;
+            }
+            if (pos == stream.size()) reader.finish();
+        }
+        return true;
+    }
+};
+
+static bool sameFrame(const CanFrame& a, const CanFrame& b) {
+    return a.timeUs == b.timeUs && a.id == b.id && a.dlc == b.dlc && a.flags == b.flags &&
+           std::memcmp(a.data, b.data, sizeof(a.data)) == 0;
+}
+
+// Largest valid block, for the smallest buffer that reads the whole capture
+static uint32_t largestBlock(const std::vector<uint8_t>& stream) {
+    uint32_t largest = 0;
+    for (size_t pos = 0; pos < stream.size();) {
+        uint32_t length = canCaptureBlockLength(stream.data() + pos, stream.size() - pos);
+        largest = std::max(largest, length);
+        pos += length > 0 ? length : 1;
+    }
+    return largest;
+}
+
+// =============================================================================
+// Pipeline
+// =============================================================================
+
+struct Outputs {
+    uint64_t digest = 14695981039346656037ULL;  // FNV-1a over every pump tick
+    uint64_t frames = 0;
+    uint64_t pumpTicks = 0;
+    uint64_t changes = 0;
+    uint32_t ringOverruns = 0;
+    uint32_t restarts = 0;                      // Recorded clock went backwards
+    uint64_t durationUs = 0;                    // Replayed time
+    uint16_t minRpm = UINT16_MAX;
+    uint16_t maxRpm = 0;
+    uint8_t minDuty = 255;
+    uint8_t maxDuty = 0;
+    double wallMs = 0;
+    uint64_t maxLateUs = 0;                     // Paced: frame pushed after it was due
+    CanReplayStats reader;
+};
+
+static void digestBytes(uint64_t* digest, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        *digest = (*digest ^ ((value >> (8 * i)) & 0xFF)) * 1099511628211ULL;
+    }
+}
+
+// Frames into the ring at their recorded time (on one timeline, kept
+// moving forward across clock restarts); the UI task drains and decodes
+// it, the pump task turns the newest RPM into duty and EHPS speed. Ticks
+// due before a frame run before it is pushed. speed paces the pushes
+// against the wall clock without changing any output.
+static Outputs runPipeline(const std::vector<uint8_t>& stream, uint32_t bufferBytes,
+                           uint32_t maxChunk, uint32_t seed, uint32_t speed, std::ostream* csv) {
+    Outputs out;
+    Feeder feeder(stream, bufferBytes, maxChunk, seed);
+    CanReplayPacer timeline;
+    CanReplayPacer wall;
+    timeline.start(1, 0);
+    wall.start(speed, 0);
+
+    std::vector<CanFrame> ringFrames(CAN_RX_RING_FRAMES);
+    CanFrameRing ring;
+    ring.init(ringFrames.data(), CAN_RX_RING_FRAMES);
+    CanSignalDecoder decoder;
+    decoder.compile(CAN_DEFAULT_SIGNALS, CAN_SIGNAL_DEFAULT_COUNT);
+
+    uint32_t seenUpdates = 0;
+    uint16_t rpm = 0;
+    uint16_t lastRpm = 0;
+    uint8_t lastDuty = 0;
+    uint16_t lastSpeed = 0;
+    bool started = false;
+    uint64_t firstUs = 0;
+    uint64_t nextUi = 0;
+    uint64_t nextPump = 0;
+
+    auto ui = [&]() {
+        CanFrame f;
+        while (ring.pop(&f)) {
+            decoder.decode(f);
+        }
+        uint16_t value;
+        if (pumpAssistRpm(decoder.value(CAN_SIGNAL_ENGINE_RPM), &seenUpdates, &value)) {
+            rpm = value;
+        }
+    };
+    auto pump = [&](uint64_t now) {
+        uint8_t duty = pumpDutyForRpm(rpm);
+        uint16_t ehps = ehpsSpeedForDuty(duty);
+        uint64_t tick = (now - firstUs) / PUMP_PERIOD_US;
+        digestBytes(&out.digest, tick, 8);
+        digestBytes(&out.digest, rpm, 2);
+        digestBytes(&out.digest, duty, 1);
+        digestBytes(&out.digest, ehps, 2);
+        out.pumpTicks++;
+        out.minRpm = std::min(out.minRpm, rpm);
+        out.maxRpm = std::max(out.maxRpm, rpm);
+        out.minDuty = std::min(out.minDuty, duty);
+        out.maxDuty = std::max(out.maxDuty, duty);
+        if (out.pumpTicks == 1 || rpm != lastRpm || duty != lastDuty || ehps != lastSpeed) {
+            out.changes++;
+            if (csv) {
+                *csv << (now - firstUs) / 1000 << "," << rpm << "," << static_cast<int>(duty)
+                     << "," << ehps << "\n";
+            }
+        }
+        lastRpm = rpm;
+        lastDuty = duty;
+        lastSpeed = ehps;
+    };
+    auto runTicks = [&](uint64_t before) {
+        while (nextUi < before || nextPump < before) {
+            if (nextUi <= nextPump) {
+                ui();
+                nextUi += UI_PERIOD_US;
+            } else {
+                pump(nextPump);
+                nextPump += PUMP_PERIOD_US;
+            }
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    CanFrame frame;
+    uint64_t t = 0;
+    while (feeder.next(&frame)) {
+        t = timeline.due(frame.timeUs);
+        if (!started) {
+            started = true;
+            firstUs = t;
+            nextUi = t + UI_PERIOD_US;
+            nextPump = t + PUMP_PERIOD_US;
+        }
+        runTicks(t);
+
+        if (speed != CAN_REPLAY_ASAP) {
+            auto due = start + std::chrono::microseconds(wall.due(frame.timeUs));
+            std::this_thread::sleep_until(due);
+            uint64_t late = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - due).count());
+            out.maxLateUs = std::max(out.maxLateUs, late);
+        }
+        frame.timeUs = t;
+        ring.push(frame);
+        out.frames++;
+    }
+    if (started) {
+        runTicks(t + UI_PERIOD_US + 1);
+        out.durationUs = t - firstUs;
+    }
+    out.wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    out.ringOverruns = ring.overruns();
+    out.restarts = timeline.restarts();
+    out.reader = feeder.reader.stats();
+    return out;
+}
+
+// =============================================================================
+// Throughput
+// =============================================================================
+
+// Reader alone, then the decoder alone on the frames it returns, each
+// repeated to about two million frames
+static void measure(const std::vector<uint8_t>& stream, uint64_t frames, double* readNs,
+                    double* decodeNs) {
+    uint32_t passes = static_cast<uint32_t>(std::max<uint64_t>(1, 2000000 / std::max<uint64_t>(frames, 1)));
+    std::vector<CanFrame> decoded;
+    decoded.reserve(frames);
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t count = 0;
+    for (uint32_t p = 0; p < passes; p++) {
+        Feeder feeder(stream, CAN_REPLAY_BUFFER_KB * 1024, 0, 0);
+        CanFrame f;
+        while (feeder.next(&f)) {
+            if (p == 0) decoded.push_back(f);
+            count++;
+        }
+    }
+    *readNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+              std::max<uint64_t>(count, 1);
+
+    CanSignalDecoder decoder;
+    decoder.compile(CAN_DEFAULT_SIGNALS, CAN_SIGNAL_DEFAULT_COUNT);
+    static volatile uint64_t updates = 0;     // Keeps the loop
+    start = std::chrono::steady_clock::now();
+    for (uint32_t p = 0; p < passes; p++) {
+        for (const CanFrame& f : decoded) {
+            updates += decoder.decode(f);
+        }
+    }
+    *decodeNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+                std::max<uint64_t>(decoded.size() * passes, 1);
+}
+
+// =============================================================================
+// Run
+// =============================================================================
+
+static bool loadFiles(const std::vector<std::string>& files, std::vector<uint8_t>* stream) {
+    for (const std::string& path : files) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            std::cerr << "Cannot read " << path << "\n";
+            return false;
+        }
+        stream->insert(stream->end(), std::istreambuf_iterator<char>(in),
+                       std::istreambuf_iterator<char>());
+    }
+    return true;
+}
+
+int replayRun(const ReplayParams& params) {
+    std::vector<uint8_t> stream;
+    std::vector<CanFrame> expected;
+    bool synthetic = params.files.empty();
+    if (synthetic) {
+        std::vector<CanFrame> drive = makeDrive(params.seconds, params.seed);
+        stream = captureDrive(drive, &expected);
+    } else if (!loadFiles(params.files, &stream)) {
+        return 1;
+    }
+
+    std::ofstream csvFile;
+    if (!params.csvPath.empty()) {
+        csvFile.open(params.csvPath);
+        if (!csvFile) {
+            std::cerr << "Cannot write " << params.csvPath << "\n";
+            return 1;
+        }
+        csvFile << "time_ms,rpm,duty,ehps_speed\n";
+    }
+
+    bool ok = true;
+    Outputs ref = runPipeline(stream, CAN_REPLAY_BUFFER_KB * 1024, 0, 0, params.speed,
+                              csvFile.is_open() ? &csvFile : nullptr);
+    const CanReplayStats& r = ref.reader;
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "CAN replay: ";
+    if (synthetic) {
+        std::cout << "synthetic drive, " << params.seconds << " s";
+    } else {
+        std::cout << params.files.size() << " file" << (params.files.size() == 1 ? "" : "s");
+    }
+    std::cout << ", " << stream.size() / 1024 << " KB\n\n";
+    std::cout << "Capture: " << r.frames << " frames in " << r.blocks << " blocks over "
+              << ref.durationUs / 1e6 << " s, " << r.missingBlocks << " blocks missing, "
+              << r.skippedBytes << " bytes skipped";
+    if (ref.restarts > 0) {
+        std::cout << ", clock restarted " << ref.restarts << (ref.restarts == 1 ? " time" : " times");
+    }
+    std::cout << "\n         capture lost " << r.dropped << " frames (no buffer) and "
+              << r.overruns << " to controller overruns\n";
+    if (ref.frames == 0) {
+        std::cerr << "No capture blocks found\n";
+        return 1;
+    }
+
+    if (synthetic) {
+        // Every frame of the blocks kept comes back, in order
+        Feeder feeder(stream, CAN_REPLAY_BUFFER_KB * 1024, 1500, params.seed);
+        CanFrame f;
+        uint64_t count = 0;
+        uint64_t errors = 0;
+        while (feeder.next(&f)) {
+            errors += count >= expected.size() || !sameFrame(f, expected[count]);
+            count++;
+        }
+        errors += count < expected.size() ? expected.size() - count : 0;
+        bool readOk = errors == 0 && r.missingBlocks == 2;
+        std::cout << "Read:    " << count << " of " << expected.size() << " stored frames, "
+                  << errors << " differ, block " << DROPPED_BLOCK << " lost and block "
+                  << CORRUPTED_BLOCK << " corrupted " << (readOk ? "[OK]" : "[FAILED]") << "\n";
+        ok = readOk && ok;
+    }
+
+    std::cout << "Outputs: " << ref.pumpTicks << " pump ticks, " << ref.changes << " changes, RPM "
+              << ref.minRpm << ".." << ref.maxRpm << ", duty " << static_cast<int>(ref.minDuty)
+              << ".." << static_cast<int>(ref.maxDuty) << ", ring overruns " << ref.ringOverruns
+              << "\n         digest " << std::hex << std::setw(16) << std::setfill('0') << ref.digest
+              << std::dec << std::setfill(' ');
+    if (csvFile.is_open()) {
+        std::cout << ", changes in " << params.csvPath;
+    }
+    std::cout << "\n";
+
+    // The same outputs whatever the reads look like
+    uint32_t block = std::max<uint32_t>(largestBlock(stream), CAN_CAPTURE_BLOCK_KB * 1024);
+    Outputs chunked = runPipeline(stream, CAN_REPLAY_BUFFER_KB * 1024, 4096, params.seed,
+                                  CAN_REPLAY_ASAP, nullptr);
+    Outputs small = runPipeline(stream, block, 512, params.seed + 1, CAN_REPLAY_ASAP, nullptr);
+    bool same = chunked.digest == ref.digest && small.digest == ref.digest &&
+                chunked.frames == ref.frames && small.frames == ref.frames;
+    std::cout << "Repeat:  same digest with reads of 1-4096 B and a " << block / 1024
+              << " KB buffer read 1-512 B at a time " << (same ? "[OK]" : "[FAILED]") << "\n";
+    ok = same && ok;
+
+    double readNs;
+    double decodeNs;
+    measure(stream, ref.frames, &readNs, &decodeNs);
+    double pipelineNs = chunked.wallMs * 1e6 / std::max<uint64_t>(chunked.frames, 1);
+    std::cout << std::setprecision(0) << "Speed:   reader " << readNs << " ns/frame, decoder "
+              << decodeNs << " ns/frame, pipeline " << pipelineNs << " ns/frame ("
+              << std::setprecision(1) << 1e9 / pipelineNs / 1e6 << " M frames/s, "
+              << std::setprecision(0) << ref.durationUs / 1000.0 / std::max(chunked.wallMs, 1e-3)
+              << "x real time)\n";
+
+    if (params.speed != CAN_REPLAY_ASAP) {
+        std::cout << std::setprecision(1) << "Paced:   " << params.speed << "x, "
+                  << ref.wallMs / 1000.0 << " s for " << ref.durationUs / 1e6
+                  << " s of capture, late max " << ref.maxLateUs << " us\n";
+    }
+    return ok ? 0 : 1;
+}
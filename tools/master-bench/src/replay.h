@@ -0,0 +1,44 @@
+#ifndef REPLAY_BENCH_H
+#define REPLAY_BENCH_H
+
+#include "master/can_replay_log.h"
+#include "shared/config.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// =============================================================================
+// CAN Replay Benchmark
+// =============================================================================
+// Replays a CAN capture through the master's pipeline on the host: the
+// CanReplayReader the device reads SD captures with, the frame ring,
+// CanSignalDecoder with the default signal table, and the assist mapping
+// of master/pump_assist.h - newest engine RPM, pump PWM duty, EHPS speed
+// value. The UI task (every UI_TASK_PERIOD_MS) and the pump task (every
+// PUMP_TASK_PERIOD_MS) run in simulated time on the recorded clock, so a
+// capture always gives the same control outputs: their digest, or the CSV
+// of every change, compares firmware versions. The run is checked by
+// replaying again with the file read in different chunk sizes and a
+// buffer of one block, which must give the same digest.
+//
+// Without a file, a synthetic drive is captured first - engine RPM from
+// idle to past full assist, the pump's alive message, vehicle speed and
+// background traffic - with log text between blocks, a block lost and one
+// corrupted, and every frame read back is checked against what was stored.
+// Then reports reader, decoder and pipeline throughput. --speed paces the
+// pipeline run against the wall clock, like the device does.
+
+struct ReplayParams {
+    std::vector<std::string> files;     // Capture files, replayed in order; none = synthetic
+    uint32_t seconds = 120;             // Synthetic drive
+    uint32_t speed = CAN_REPLAY_ASAP;   // Pipeline run: N x real time, or as fast as possible
+    std::string csvPath;                // Control output changes
+    uint32_t seed = 1;
+};
+
+// Returns 0 when every replay gives the same outputs (and, synthetic, every
+// stored frame comes back)
+int replayRun(const ReplayParams& params);
+
+#endif // REPLAY_BENCH_H
@@ -0,0 +1,298 @@
+#include "sdio.h"
+#include "master/sd_io_queue.h"
+
+#include <algorithm>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+// =============================================================================
+// Workload
+// =============================================================================
+
+static const char* const CLASS_NAMES[SD_IO_PRIORITIES] = {"safety", "telemetry", "vmem", "bulk"};
+
+struct Arrival {
+    uint32_t timeUs;
+    SdIoOp op;
+    SdIoPriority priority;
+    const char* path;
+    uint32_t offset;
+    std::vector<uint8_t> data;      // Written bytes, or the read buffer
+};
+
+static const uint32_t VMEM_PAGE = 8192;
+static const uint32_t VMEM_PAGES = 256;
+static const uint32_t BULK_CHUNK = 32768;
+
+static void addArrival(std::vector<Arrival>& arrivals, std::mt19937& rng, uint32_t timeUs,
+                       SdIoOp op, SdIoPriority priority, const char* path, uint32_t offset,
+                       uint32_t length) {
+    Arrival a;
+    a.timeUs = timeUs;
+    a.op = op;
+    a.priority = priority;
+    a.path = path;
+    a.offset = offset;
+    a.data.resize(length);
+    if (op != SD_IO_READ_AT) {
+        for (uint8_t& b : a.data) b = static_cast<uint8_t>(rng());
+    }
+    arrivals.push_back(std::move(a));
+}
+
+static std::vector<Arrival> makeArrivals(const SdioParams& params) {
+    std::mt19937 rng(params.seed);
+    std::vector<Arrival> arrivals;
+    const uint32_t endUs = params.seconds * 1000000;
+
+    // Telemetry at 100 Hz, every tenth record also an event line
+    for (uint32_t t = 0, n = 0; t < endUs; t += 10000, n++) {
+        addArrival(arrivals, rng, t + rng() % 500, SD_IO_APPEND, SD_IO_TELEMETRY,
+                   "/telemetry.log", 0, 48);
+        if (n % 10 == 9) {
+            addArrival(arrivals, rng, t + 600, SD_IO_APPEND, SD_IO_TELEMETRY,
+                       "/crash_log.csv", 0, 24);
+        }
+    }
+
+    // Safety lines now and then, into the same crash log
+    for (uint32_t t = 350000; t < endUs; t += 300000 + rng() % 800000) {
+        addArrival(arrivals, rng, t, SD_IO_APPEND, SD_IO_SAFETY, "/crash_log.csv", 0, 40);
+    }
+
+    // Swap traffic: every 200 ms a burst of write-backs and page-ins
+    for (uint32_t t = 5000; t < endUs; t += 200000) {
+        for (uint32_t i = 0; i < 12; i++) {
+            bool write = i % 3 != 2;
+            addArrival(arrivals, rng, t + i * 500, write ? SD_IO_WRITE_AT : SD_IO_READ_AT,
+                       SD_IO_VMEM, "/vmem_swap.bin", (rng() % VMEM_PAGES) * VMEM_PAGE, VMEM_PAGE);
+        }
+    }
+
+    // Bulk export, one chunk every 100 ms
+    for (uint32_t t = 20000, offset = 0; t < endUs; t += 100000, offset += BULK_CHUNK) {
+        addArrival(arrivals, rng, t, SD_IO_WRITE_AT, SD_IO_BULK, "/bulk.bin", offset, BULK_CHUNK);
+    }
+
+    std::stable_sort(arrivals.begin(), arrivals.end(),
+                     [](const Arrival& a, const Arrival& b) { return a.timeUs < b.timeUs; });
+    return arrivals;
+}
+
+// Blocking callers (swap, bulk) retry a full queue; log callers drop
+static bool retries(SdIoPriority priority) {
+    return priority == SD_IO_VMEM || priority == SD_IO_BULK;
+}
+
+// =============================================================================
+// Simulated Card
+// =============================================================================
+
+class SimCard {
+public:
+    explicit SimCard(const SdioParams& params) : _params(params) {}
+
+    uint64_t busyUs = 0;
+    uint32_t operations = 0;
+    std::map<std::string, std::vector<uint8_t>> files;
+
+    // Apply the operation and return its duration
+    uint32_t run(SdIoOp op, const std::string& path, uint32_t offset,
+                 const uint8_t* data, uint8_t* buffer, uint32_t length) {
+        std::vector<uint8_t>& file = files[path];
+        switch (op) {
+            case SD_IO_APPEND:
+                file.insert(file.end(), data, data + length);
+                break;
+            case SD_IO_WRITE_AT:
+                if (file.size() < offset + length) file.resize(offset + length);
+                std::copy(data, data + length, file.begin() + offset);
+                break;
+            case SD_IO_READ_AT:
+                for (uint32_t i = 0; i < length; i++) {
+                    buffer[i] = offset + i < file.size() ? file[offset + i] : 0;
+                }
+                break;
+            case SD_IO_SYNC:
+                break;
+        }
+        uint32_t us = _params.opLatencyUs +
+            static_cast<uint32_t>(static_cast<uint64_t>(length) * 1000000ULL /
+                                  (_params.throughputKBps * 1024ULL));
+        busyUs += us;
+        operations++;
+        return us;
+    }
+
+private:
+    const SdioParams& _params;
+};
+
+struct ModeResult {
+    SdIoStats stats = {};
+    uint32_t operations = 0;
+    uint64_t busyUs = 0;
+    uint32_t dropped = 0;
+    std::map<std::string, std::vector<uint8_t>> files;
+};
+
+// =============================================================================
+// Modes
+// =============================================================================
+
+// Synchronous calls in arrival order, as before the SD I/O task
+static ModeResult runInOrder(const SdioParams& params, std::vector<Arrival>& arrivals) {
+    SimCard card(params);
+    ModeResult result;
+    uint64_t cardFree = 0;
+    for (Arrival& a : arrivals) {
+        uint64_t start = std::max<uint64_t>(a.timeUs, cardFree);
+        cardFree = start + card.run(a.op, a.path, a.offset, a.data.data(), a.data.data(),
+                                    static_cast<uint32_t>(a.data.size()));
+        SdIoClassStats& cls = result.stats.classes[a.priority];
+        uint32_t wait = static_cast<uint32_t>(cardFree - a.timeUs);
+        cls.submitted++;
+        cls.completed++;
+        cls.operations++;
+        cls.totalWaitUs += wait;
+        cls.maxWaitUs = std::max(cls.maxWaitUs, wait);
+    }
+    result.operations = card.operations;
+    result.busyUs = card.busyUs;
+    result.files = std::move(card.files);
+    return result;
+}
+
+static SdIoRequest toRequest(Arrival& a) {
+    SdIoRequest request = {};
+    request.op = a.op;
+    request.priority = a.priority;
+    request.path = a.path;
+    request.offset = a.offset;
+    request.length = static_cast<uint32_t>(a.data.size());
+    if (a.op == SD_IO_READ_AT) {
+        request.buffer = a.data.data();
+    } else {
+        request.data = a.data.data();
+    }
+    return request;
+}
+
+static ModeResult runQueued(const SdioParams& params, std::vector<Arrival>& arrivals, bool merging) {
+    SimCard card(params);
+    SdIoQueue queue;
+    queue.init(params.depth, params.reserve, merging);
+    ModeResult result;
+
+    std::deque<size_t> backlog;     // Rejected blocking requests, in order
+    size_t next = 0;
+    bool busy = false;
+    uint64_t finishAt = 0;
+    SdIoJob* running = nullptr;
+
+    // Requests are submitted with their arrival time, so a retried one is
+    // charged for the time its caller spent waiting for a slot
+    auto submitBacklog = [&]() {
+        while (!backlog.empty() && queue.submit(toRequest(arrivals[backlog.front()]),
+                                                arrivals[backlog.front()].timeUs)) {
+            backlog.pop_front();
+        }
+    };
+
+    while (next < arrivals.size() || busy || queue.pending() > 0 || !backlog.empty()) {
+        bool arrival = next < arrivals.size() && (!busy || arrivals[next].timeUs < finishAt);
+        if (arrival) {
+            Arrival& a = arrivals[next];
+            // A blocked caller submits nothing else until its request is in
+            bool blocked = std::any_of(backlog.begin(), backlog.end(),
+                                       [&](size_t i) { return arrivals[i].priority == a.priority; });
+            if (blocked) {
+                backlog.push_back(next);
+            } else if (!queue.submit(toRequest(a), a.timeUs)) {
+                if (retries(a.priority)) {
+                    backlog.push_back(next);
+                } else {
+                    result.dropped++;
+                }
+            }
+            if (!busy) finishAt = a.timeUs;
+            next++;
+        } else if (busy) {
+            SdIoCompletion completion;
+            queue.finish(running, 0, static_cast<uint32_t>(finishAt), &completion);
+            busy = false;
+            submitBacklog();
+        } else {
+            submitBacklog();
+        }
+
+        if (!busy) {
+            running = queue.take();
+            if (running) {
+                busy = true;
+                finishAt += card.run(running->op, running->path, running->offset, running->data,
+                                     running->buffer, running->length);
+            }
+        }
+    }
+
+    result.stats = queue.stats();
+    result.operations = card.operations;
+    result.busyUs = card.busyUs;
+    result.files = std::move(card.files);
+    return result;
+}
+
+// =============================================================================
+// Report
+// =============================================================================
+
+int sdioRun(const SdioParams& params) {
+    std::vector<Arrival> arrivals = makeArrivals(params);
+
+    std::cout << "SD I/O: " << arrivals.size() << " requests over " << params.seconds
+              << " s, card " << params.opLatencyUs << " us/op + " << params.throughputKBps
+              << " KB/s, queue " << params.depth << " slots (" << params.reserve << " safety)\n\n";
+
+    const char* names[] = {"arrival order", "priority", "priority+merge"};
+    ModeResult results[3];
+    results[0] = runInOrder(params, arrivals);
+    results[1] = runQueued(params, arrivals, false);
+    results[2] = runQueued(params, arrivals, true);
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << std::setw(16) << "mode" << std::setw(11) << "class" << std::setw(9) << "reqs"
+              << std::setw(9) << "merged" << std::setw(9) << "ops" << std::setw(12) << "wait avg ms"
+              << std::setw(12) << "wait max ms" << "\n";
+    for (int m = 0; m < 3; m++) {
+        for (uint32_t c = 0; c < SD_IO_PRIORITIES; c++) {
+            const SdIoClassStats& cls = results[m].stats.classes[c];
+            double avg = cls.completed > 0 ? cls.totalWaitUs / 1000.0 / cls.completed : 0.0;
+            std::cout << std::setw(16) << (c == 0 ? names[m] : "") << std::setw(11) << CLASS_NAMES[c]
+                      << std::setw(9) << cls.submitted << std::setw(9) << cls.merged
+                      << std::setw(9) << cls.operations << std::setw(12) << avg
+                      << std::setw(12) << cls.maxWaitUs / 1000.0 << "\n";
+        }
+        std::cout << std::setw(16) << "" << std::setw(11) << "card" << std::setw(9) << ""
+                  << std::setw(9) << "" << std::setw(9) << results[m].operations
+                  << std::setw(11) << 100.0 * results[m].busyUs / (params.seconds * 1e6) << "% busy";
+        if (results[m].dropped > 0) {
+            std::cout << ", " << results[m].dropped << " log requests dropped (queue full)";
+        }
+        std::cout << "\n";
+    }
+
+    bool dropped = results[1].dropped > 0 || results[2].dropped > 0;
+    bool same = results[1].files == results[0].files && results[2].files == results[0].files;
+    if (dropped) {
+        std::cout << "\nContents: not compared, requests were dropped\n";
+        return 0;
+    }
+    std::cout << "\nContents: " << (same ? "identical" : "DIFFERENT") << "\n";
+    return same ? 0 : 1;
+}
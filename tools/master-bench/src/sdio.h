@@ -0,0 +1,31 @@
+#ifndef SDIO_H
+#define SDIO_H
+
+#include "master/sd_io_queue.h"
+
+#include <cstdint>
+
+// =============================================================================
+// SD I/O Scheduler Simulation
+// =============================================================================
+// Replays the master's mix of SD traffic against a simulated card, in
+// simulated time: safety log lines, 100 Hz telemetry appends (every tenth
+// also an event line in the crash log), bursts of virtual memory page
+// write-backs and page-ins, and large bulk writes. The same arrivals run
+// three ways: in arrival order (the synchronous calls sd_handler saw
+// before the SD I/O task), through SdIoQueue by priority, and by priority
+// with merging. Files must end up identical in every mode.
+
+struct SdioParams {
+    uint32_t seconds = 10;          // Simulated time
+    uint32_t depth = 16;            // Queue slots
+    uint32_t reserve = 2;           // Of those, for safety logs
+    uint32_t opLatencyUs = 1000;    // Card cost per operation
+    uint32_t throughputKBps = 2000; // Card transfer rate
+    uint32_t seed = 1;
+};
+
+// Returns 0 when every mode produced the same files
+int sdioRun(const SdioParams& params);
+
+#endif // SDIO_H
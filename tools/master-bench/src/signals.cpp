@@ -0,0 +1,192 @@
+#include "signals.h"
+#include "master/can_signal.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// =============================================================================
+// Table
+// =============================================================================
+
+static const uint32_t TABLE_IDS = 8;
+
+// The Volvo signals, then random ones over TABLE_IDS - 2 more IDs
+static std::vector<CanSignalDef> makeTable(std::mt19937& rng, std::vector<std::string>& names) {
+    std::vector<CanSignalDef> table = {
+        {"pump_status", 0x1B200002, true, 55, 16, CAN_SIGNAL_MOTOROLA, false,
+         CAN_SIGNAL_FIXED(1.0), 0},
+        {"vehicle_speed", 0x02104136, true, 55, 16, CAN_SIGNAL_MOTOROLA, false,
+         CAN_SIGNAL_FIXED(1.0), 0},
+    };
+    std::uniform_int_distribution<uint32_t> length(1, 32);
+    std::uniform_int_distribution<uint32_t> bit(0, 63);
+    std::uniform_int_distribution<int32_t> factor(1, 8 << CAN_SIGNAL_FRACTION_BITS);
+    std::uniform_int_distribution<int32_t> offset(-(1000 << CAN_SIGNAL_FRACTION_BITS),
+                                                  1000 << CAN_SIGNAL_FRACTION_BITS);
+
+    names.reserve(CAN_SIGNAL_MAX);
+    for (uint32_t i = 2; table.size() < CAN_SIGNAL_MAX - 2; i++) {
+        CanSignalDef def;
+        uint32_t slot = 2 + i % (TABLE_IDS - 2);
+        def.extended = slot % 2 == 0;
+        def.id = def.extended ? 0x18F00000 + slot : 0x100 + slot;
+        def.length = static_cast<uint8_t>(length(rng));
+        def.order = rng() % 2 ? CAN_SIGNAL_MOTOROLA : CAN_SIGNAL_INTEL;
+        def.isSigned = rng() % 2;
+        def.factor = factor(rng);
+        def.offset = offset(rng);
+        // A start bit that keeps the signal inside 8 bytes
+        do {
+            def.startBit = static_cast<uint8_t>(bit(rng));
+        } while (def.order == CAN_SIGNAL_INTEL
+                     ? def.startBit + def.length > 64
+                     : (7 - def.startBit / 8) * 8 + def.startBit % 8 < def.length - 1);
+        names.push_back("sig" + std::to_string(table.size()));
+        def.name = names.back().c_str();
+        table.push_back(def);
+    }
+    return table;
+}
+
+// =============================================================================
+// Reference
+// =============================================================================
+
+// Walk the DBC bit numbering one bit at a time
+static bool referenceDecode(const CanSignalDef& def, const CanFrame& frame, int64_t* value) {
+    uint64_t raw = 0;
+    int pos = def.startBit;
+    for (int i = 0; i < def.length; i++) {
+        int bitIndex = def.order == CAN_SIGNAL_INTEL ? i : def.length - 1 - i;
+        if (pos / 8 >= frame.dlc) {
+            return false;
+        }
+        raw |= static_cast<uint64_t>((frame.data[pos / 8] >> (pos % 8)) & 1) << bitIndex;
+        if (def.order == CAN_SIGNAL_INTEL) {
+            pos++;
+        } else {
+            // Motorola runs down a byte, then on to bit 7 of the next one
+            pos = pos % 8 == 0 ? pos + 15 : pos - 1;
+        }
+    }
+    int64_t signedRaw = static_cast<int64_t>(raw);
+    if (def.isSigned && (raw >> (def.length - 1)) & 1) {
+        signedRaw -= static_cast<int64_t>(1) << def.length;
+    }
+    *value = signedRaw * def.factor + def.offset;
+    return true;
+}
+
+// =============================================================================
+// Run
+// =============================================================================
+
+int signalsRun(const SignalsParams& params) {
+    std::mt19937 rng(params.seed);
+    std::vector<std::string> names;
+    std::vector<CanSignalDef> table = makeTable(rng, names);
+
+    CanSignalDecoder decoder;
+    if (!decoder.compile(table.data(), static_cast<uint32_t>(table.size()))) {
+        std::cout << "Table did not compile\n";
+        return 1;
+    }
+
+    uint32_t failures = 0;
+
+    // The pump status frame from the Volvo notes: bytes 6-7 = 0x0F71
+    CanFrame pump = {0, 0x1B200002, 8, CAN_FRAME_EXTENDED, {0, 0, 0, 0, 0, 0, 0x0F, 0x71}};
+    decoder.decode(pump);
+    int32_t status = canSignalToInt(decoder.value(0).value);
+    std::cout << "Volvo:   pump status 0F 71 decodes to " << status << " ("
+              << (status == 0x0F71 ? "OK" : "WRONG") << ")\n";
+    failures += status != 0x0F71;
+
+    // Frames: nine in ten from table IDs, random DLC
+    std::vector<CanFrame> frames(params.frames);
+    std::uniform_int_distribution<uint32_t> pick(0, decoder.idCount() + decoder.idCount() / 8);
+    for (uint32_t i = 0; i < params.frames; i++) {
+        CanFrame& f = frames[i];
+        uint32_t index = pick(rng);
+        if (index < decoder.idCount()) {
+            CanId id = decoder.id(index);
+            f.id = id.id;
+            f.flags = id.extended ? CAN_FRAME_EXTENDED : 0;
+        } else {
+            f.id = 0x400 + (rng() & 0xFF);
+            f.flags = 0;
+        }
+        f.dlc = rng() % 4 == 0 ? static_cast<uint8_t>(rng() % 9) : 8;
+        f.timeUs = i;
+        for (uint8_t& b : f.data) {
+            b = static_cast<uint8_t>(rng());
+        }
+    }
+
+    // Check every value against the reference
+    uint64_t checked = 0;
+    for (const CanFrame& f : frames) {
+        std::vector<uint32_t> before(table.size());
+        for (uint32_t s = 0; s < table.size(); s++) {
+            before[s] = decoder.value(s).updates;
+        }
+        decoder.decode(f);
+        for (uint32_t s = 0; s < table.size(); s++) {
+            const CanSignalDef& def = table[s];
+            bool matches = f.id == def.id && ((f.flags & CAN_FRAME_EXTENDED) != 0) == def.extended;
+            int64_t expected = 0;
+            bool decoded = matches && referenceDecode(def, f, &expected);
+            bool updated = decoder.value(s).updates != before[s];
+            if (decoded != updated || (decoded && decoder.value(s).value != expected)) {
+                if (failures < 5) {
+                    std::cout << "  " << def.name << " on 0x" << std::hex << f.id << std::dec
+                              << ": got " << decoder.value(s).value << ", expected " << expected
+                              << (decoded ? "" : " (no update)") << "\n";
+                }
+                failures++;
+            }
+            checked += decoded;
+        }
+    }
+
+    // Decoder rate
+    decoder.compile(table.data(), static_cast<uint32_t>(table.size()));
+    uint64_t decoded = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const CanFrame& f : frames) {
+        decoded += decoder.decode(f);
+    }
+    double decoderSeconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    // Reference rate: scan the table, walk the bits
+    volatile int64_t sink = 0;
+    start = std::chrono::steady_clock::now();
+    for (const CanFrame& f : frames) {
+        for (const CanSignalDef& def : table) {
+            int64_t value;
+            if (f.id == def.id && ((f.flags & CAN_FRAME_EXTENDED) != 0) == def.extended &&
+                referenceDecode(def, f, &value)) {
+                sink = sink + value;
+            }
+        }
+    }
+    double referenceSeconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "Table:   " << table.size() << " signals over " << decoder.idCount()
+              << " IDs, " << sizeof(CanSignalDecoder) << " B compiled\n";
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Decoder: " << decoded / decoderSeconds / 1e6 << " M signals/s, "
+              << params.frames / decoderSeconds / 1e6 << " M frames/s ("
+              << decoderSeconds * 1e9 / params.frames << " ns per frame)\n";
+    std::cout << "Scan:    " << decoded / referenceSeconds / 1e6 << " M signals/s, "
+              << params.frames / referenceSeconds / 1e6 << " M frames/s (bit walk over the table)\n";
+    std::cout << "Check:   " << checked << " values against the reference, " << failures
+              << " wrong: " << (failures == 0 ? "OK" : "MISMATCH") << "\n";
+    return failures == 0 ? 0 : 1;
+}
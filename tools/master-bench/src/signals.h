@@ -0,0 +1,24 @@
+#ifndef SIGNALS_BENCH_H
+#define SIGNALS_BENCH_H
+
+#include <cstdint>
+
+// =============================================================================
+// CAN Signal Decoding Benchmark
+// =============================================================================
+// Compiles the master's Volvo signal table plus random Intel and Motorola
+// signals (signed, scaled, offset) into a CanSignalDecoder and feeds it
+// random frames, a tenth of them from IDs outside the table. Every decoded
+// value is checked against a bit-by-bit reference that walks the DBC bit
+// numbering and scans the whole table per frame; both are timed, and the
+// decoder's rate is reported in signals and frames per second.
+
+struct SignalsParams {
+    uint32_t frames = 100000;
+    uint32_t seed = 1;
+};
+
+// Returns 0 when every value matched the reference
+int signalsRun(const SignalsParams& params);
+
+#endif // SIGNALS_BENCH_H
@@ -0,0 +1,235 @@
+#include "telemetry.h"
+#include "master/telemetry_log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// =============================================================================
+// Samples
+// =============================================================================
+
+static const uint32_t SAMPLE_TABLE = 4096;
+
+// Slowly varying state with a little sensor noise, like a drive
+static std::vector<TelemetryRecord> makeSamples(uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<TelemetryRecord> samples(SAMPLE_TABLE);
+    for (uint32_t i = 0; i < SAMPLE_TABLE; i++) {
+        TelemetryRecord& r = samples[i];
+        std::memset(&r, 0, sizeof(r));
+        uint32_t phase = i % 1024;
+        r.targetRpm = static_cast<uint16_t>(3500 + (phase < 512 ? phase : 1023 - phase) * 2);
+        r.manualRpm = 3000;
+        r.inputRpm = static_cast<uint16_t>(r.targetRpm + rng() % 40);
+        r.speedKph10 = static_cast<uint16_t>(i / 8 + rng() % 5);
+        r.waterTempF10 = static_cast<int16_t>(1800 + i / 64);
+        r.pwmDuty = static_cast<uint8_t>(r.targetRpm >= 4000 ? 255 : r.targetRpm * 255 / 4000);
+        r.steeringLevel = 50;
+        r.modes = 1 << TELEMETRY_MODE_OP_SHIFT;
+        r.flags = TELEMETRY_FLAG_RPM_INPUT | TELEMETRY_FLAG_WATER_INPUT;
+    }
+    return samples;
+}
+
+static uint64_t sampleTimeUs(uint64_t index, uint32_t rateHz) {
+    return 1000000ULL + index * 1000000ULL / rateHz;
+}
+
+struct Buffers {
+    std::vector<std::vector<uint8_t>> storage;
+    std::vector<uint8_t*> pointers;
+
+    Buffers(uint32_t count, uint32_t chunkBytes) : storage(count), pointers(count) {
+        for (uint32_t i = 0; i < count; i++) {
+            storage[i].resize(TELEMETRY_BUFFER_BYTES(chunkBytes));
+            pointers[i] = storage[i].data();
+        }
+    }
+};
+
+// =============================================================================
+// Reader Checks
+// =============================================================================
+
+struct Check {
+    uint32_t chunks = 0;
+    uint32_t files = 0;
+    uint32_t records = 0;
+    uint32_t gaps = 0;              // Samples missing between records
+    uint32_t errors = 0;
+    uint32_t expectFile = 0;
+    uint32_t expectChunk = 0;
+    uint32_t nextSequence = 0;
+    uint64_t fileBytes = 0;         // End of the furthest chunk, summed over files
+    uint64_t lastEnd = 0;
+};
+
+static void checkChunk(const TelemetryChunk& chunk, uint32_t chunkBytes, uint32_t rateHz,
+                       Check& check) {
+    const uint8_t* data = chunk.data;
+    if (chunk.chunkIndex == 0) {
+        TelemetryFileHeader file;
+        std::memcpy(&file, data, sizeof(file));
+        if (!telemetryFileHeaderValid(&file) || file.fileIndex != check.expectFile ||
+            file.chunkBytes != chunkBytes) {
+            check.errors++;
+        }
+        check.fileBytes += check.lastEnd;
+        check.files++;
+        check.expectFile = chunk.fileIndex + 1;
+        check.expectChunk = 0;
+        data += TELEMETRY_FILE_HEADER_BYTES;
+    }
+    if (chunk.chunkIndex != check.expectChunk) {
+        check.errors++;
+    }
+    check.expectChunk = chunk.chunkIndex + 1;
+    check.lastEnd = telemetryChunkOffset(chunk.chunkIndex, chunkBytes) + chunk.length;
+
+    TelemetryChunkHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    const uint8_t* records = data + sizeof(TelemetryChunkHeader);
+    if (!telemetryChunkValid(&header, records, telemetryChunkRecords(chunkBytes)) ||
+        header.firstTimeUs != sampleTimeUs(header.firstSequence, rateHz)) {
+        check.errors++;
+        return;
+    }
+    for (uint32_t i = 0; i < header.recordCount; i++) {
+        TelemetryRecord record;
+        std::memcpy(&record, records + i * sizeof(TelemetryRecord), sizeof(record));
+        if (record.sequence < check.nextSequence ||
+            record.timeUs != static_cast<uint32_t>(sampleTimeUs(record.sequence, rateHz))) {
+            check.errors++;
+        }
+        check.gaps += record.sequence - check.nextSequence;
+        check.nextSequence = record.sequence + 1;
+    }
+    check.records += header.recordCount;
+    check.chunks++;
+}
+
+// =============================================================================
+// Runs
+// =============================================================================
+
+int telemetryRun(const TelemetryParams& params) {
+    const uint32_t chunkBytes = params.chunkKb * 1024;
+    const uint32_t fileChunks = params.fileMb * 1024 * 1024 / chunkBytes;
+    const uint64_t total = static_cast<uint64_t>(params.seconds) * params.rateHz;
+    std::vector<TelemetryRecord> samples = makeSamples(params.seed);
+
+    std::cout << "Telemetry: " << total << " samples (" << params.rateHz << " Hz for "
+              << params.seconds << " s), " << chunkBytes << " B chunks of "
+              << telemetryChunkRecords(chunkBytes) << " records, " << params.buffers
+              << " buffers, " << params.fileMb << " MB files\n\n";
+
+    // Encode rate, buffers back as soon as a chunk is sealed
+    {
+        Buffers buffers(params.buffers, chunkBytes);
+        TelemetryWriter writer;
+        writer.init(buffers.pointers.data(), params.buffers, chunkBytes, fileChunks, 0,
+                    static_cast<uint16_t>(params.rateHz), "bench");
+        TelemetryChunk chunk;
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < total; i++) {
+            TelemetryRecord record = samples[i % SAMPLE_TABLE];
+            uint64_t timeUs = sampleTimeUs(i, params.rateHz);
+            record.timeUs = static_cast<uint32_t>(timeUs);
+            record.sequence = static_cast<uint32_t>(i);
+            if (writer.add(record, timeUs, &chunk)) {
+                writer.release(chunk.buffer);
+            }
+        }
+        if (writer.flush(&chunk)) {
+            writer.release(chunk.buffer);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const TelemetryWriterStats& s = writer.stats();
+        double recordBytes = static_cast<double>(s.records) * sizeof(TelemetryRecord);
+
+        std::cout << std::fixed << std::setprecision(1);
+        std::cout << "Encode:  " << s.records << " records in " << seconds * 1000.0 << " ms, "
+                  << s.records / seconds / 1e6 << " M records/s, "
+                  << recordBytes / seconds / (1024.0 * 1024.0) << " MB/s, "
+                  << std::setprecision(0) << seconds * 1e9 / s.records << " ns/record\n";
+        std::cout << std::setprecision(1);
+        std::cout << "Output:  " << s.chunks << " chunks, " << s.files << " files, "
+                  << s.bytes / (1024.0 * 1024.0) << " MB ("
+                  << 100.0 * (s.bytes - recordBytes) / s.bytes << "% headers and padding)\n";
+        std::cout << "Card:    " << std::setprecision(0)
+                  << static_cast<double>(s.bytes) / params.seconds / 1024.0
+                  << " KB/s needed at " << params.rateHz << " Hz\n\n";
+    }
+
+    // Paced against a simulated card; buffers come back when it has written them
+    Buffers buffers(params.buffers, chunkBytes);
+    TelemetryWriter writer;
+    writer.init(buffers.pointers.data(), params.buffers, chunkBytes, fileChunks, 0,
+                static_cast<uint16_t>(params.rateHz), "bench");
+    std::deque<std::pair<uint64_t, uint8_t>> writing;      // Finish time, buffer
+    uint64_t cardFree = 0;
+    uint64_t nextStallUs = static_cast<uint64_t>(params.stallEverySec) * 1000000ULL;
+    uint32_t stalls = 0;
+    uint64_t maxQueueUs = 0;
+    Check check;
+
+    auto submit = [&](const TelemetryChunk& chunk, uint64_t nowUs) {
+        checkChunk(chunk, chunkBytes, params.rateHz, check);
+        uint64_t start = std::max(nowUs, cardFree);
+        uint64_t us = params.opLatencyUs +
+            static_cast<uint64_t>(chunk.length) * 1000000ULL / (params.throughputKBps * 1024ULL);
+        if (params.stallEverySec > 0 && start >= nextStallUs) {
+            us += params.stallMs * 1000ULL;
+            nextStallUs += static_cast<uint64_t>(params.stallEverySec) * 1000000ULL;
+            stalls++;
+        }
+        cardFree = start + us;
+        maxQueueUs = std::max(maxQueueUs, cardFree - nowUs);
+        writing.emplace_back(cardFree, chunk.buffer);
+    };
+
+    TelemetryChunk chunk;
+    uint64_t lastUs = 0;
+    for (uint64_t i = 0; i < total; i++) {
+        uint64_t timeUs = sampleTimeUs(i, params.rateHz);
+        while (!writing.empty() && writing.front().first <= timeUs) {
+            writer.release(writing.front().second);
+            writing.pop_front();
+        }
+        TelemetryRecord record = samples[i % SAMPLE_TABLE];
+        record.timeUs = static_cast<uint32_t>(timeUs);
+        record.sequence = static_cast<uint32_t>(i);
+        if (writer.add(record, timeUs, &chunk)) {
+            submit(chunk, timeUs);
+        }
+        lastUs = timeUs;
+    }
+    if (writer.flush(&chunk)) {
+        submit(chunk, lastUs);
+    }
+    check.fileBytes += check.lastEnd;
+    // Samples dropped after the last stored record are gaps too
+    check.gaps += static_cast<uint32_t>(total - check.nextSequence);
+
+    const TelemetryWriterStats& s = writer.stats();
+    std::cout << "Paced:   card " << params.opLatencyUs << " us/write + " << params.throughputKBps
+              << " KB/s, " << params.stallMs << " ms stall every " << params.stallEverySec
+              << " s (" << stalls << " stalls)\n";
+    std::cout << "         " << s.records << " stored, " << s.dropped << " dropped ("
+              << std::setprecision(3) << 100.0 * s.dropped / total << "%), buffers "
+              << s.maxBuffersInUse << "/" << params.buffers << " at most, card behind by "
+              << std::setprecision(1) << maxQueueUs / 1000.0 << " ms at most\n";
+
+    bool ok = check.errors == 0 && check.records == s.records && check.gaps == s.dropped &&
+              check.chunks == s.chunks && check.files == s.files && check.fileBytes == s.bytes;
+    std::cout << "Read back: " << check.chunks << " chunks in " << check.files << " files, "
+              << check.records << " records, " << check.gaps << " missing samples, "
+              << check.errors << " errors: " << (ok ? "OK" : "MISMATCH") << "\n";
+    return ok ? 0 : 1;
+}
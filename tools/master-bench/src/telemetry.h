@@ -0,0 +1,36 @@
+#ifndef TELEMETRY_BENCH_H
+#define TELEMETRY_BENCH_H
+
+#include "master/telemetry_log.h"
+#include "shared/config.h"
+
+#include <cstdint>
+
+// =============================================================================
+// Telemetry Recorder Benchmark
+// =============================================================================
+// Runs the master's TelemetryWriter twice over the same synthetic samples.
+// The first run measures encode rate (record copy, running CRC, chunk
+// sealing) with buffers released at once. The second paces samples at the
+// recording rate against a simulated card that now and then stalls, and
+// reports how many samples the chunk buffers could not absorb. Every chunk
+// of the second run is checked the way a reader would: headers, CRCs and
+// sequence numbers, with any gap matching a counted drop.
+
+struct TelemetryParams {
+    uint32_t seconds = 600;         // Recording time
+    uint32_t rateHz = 1000;         // Samples per second
+    uint32_t chunkKb = TELEMETRY_CHUNK_KB;
+    uint32_t buffers = TELEMETRY_BUFFERS;
+    uint32_t fileMb = TELEMETRY_FILE_MB;
+    uint32_t opLatencyUs = 1000;    // Card cost per write
+    uint32_t throughputKBps = 2000; // Card transfer rate
+    uint32_t stallMs = 250;         // Card stall (erase, wear levelling) ...
+    uint32_t stallEverySec = 10;    // ... once this often
+    uint32_t seed = 1;
+};
+
+// Returns 0 when every chunk read back as written
+int telemetryRun(const TelemetryParams& params);
+
+#endif // TELEMETRY_BENCH_H
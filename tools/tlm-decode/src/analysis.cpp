@@ -0,0 +1,424 @@
+#include "analysis.h"
+#include "shared/protocol.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <thread>
+
+// =============================================================================
+// Threads
+// =============================================================================
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Split [0, count) into one contiguous run per thread; fn(thread, begin, end)
+template <class Fn>
+static void parallelRuns(size_t count, unsigned threads, Fn fn) {
+    threads = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threads, count)));
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back(fn, t, count * t / threads, count * (t + 1) / threads);
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+// Ask for a thread's chunks before it walks them, one call per file
+static void prefetchRun(const std::vector<ChunkRef>& chunks, size_t begin, size_t end) {
+    while (begin < end) {
+        size_t last = begin;
+        while (last + 1 < end && chunks[last + 1].file == chunks[begin].file) last++;
+        chunks[begin].file->prefetch(chunks[begin].chunk, chunks[last].chunk + 1);
+        begin = last + 1;
+    }
+}
+
+// =============================================================================
+// Chunk Selection
+// =============================================================================
+
+std::vector<ChunkRef> selectChunks(const std::vector<std::unique_ptr<LogFile>>& files,
+                                   const Window& window) {
+    std::vector<ChunkRef> chunks;
+    for (const auto& file : files) {
+        uint32_t first = window.fromUs > 0 ? file->seek(window.fromUs) : 0;
+        uint32_t last = window.toUs < UINT64_MAX ? file->seekStart(window.toUs) : file->chunkCount();
+        for (uint32_t k = first; k < last; k++) {
+            chunks.push_back({file.get(), k});
+        }
+    }
+    return chunks;
+}
+
+// =============================================================================
+// Verify
+// =============================================================================
+
+VerifyResult verifyChunks(const std::vector<ChunkRef>& chunks, unsigned threads) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<VerifyResult> partial(std::max(1u, threads));
+
+    parallelRuns(chunks.size(), threads, [&](unsigned t, size_t begin, size_t end) {
+        VerifyResult& r = partial[t];
+        prefetchRun(chunks, begin, end);
+        for (size_t i = begin; i < end; i++) {
+            const ChunkRef& ref = chunks[i];
+            r.bytes += ref.file->header().chunkBytes;
+            switch (ref.file->check(ref.chunk)) {
+                case ChunkState::Ok:
+                    r.ok++;
+                    r.records += ref.file->chunkHeader(ref.chunk)->recordCount;
+                    break;
+                case ChunkState::Missing:
+                    r.missing++;
+                    break;
+                case ChunkState::Corrupt:
+                    r.corrupt++;
+                    r.bad.push_back(ref);
+                    break;
+            }
+        }
+    });
+
+    VerifyResult result;
+    for (const VerifyResult& r : partial) {
+        result.ok += r.ok;
+        result.missing += r.missing;
+        result.corrupt += r.corrupt;
+        result.records += r.records;
+        result.bytes += r.bytes;
+        result.bad.insert(result.bad.end(), r.bad.begin(), r.bad.end());
+    }
+    result.seconds = secondsSince(start);
+    return result;
+}
+
+// =============================================================================
+// Summary
+// =============================================================================
+
+static const uint32_t HISTOGRAM_BINS = 65536;
+
+// Histogram bin of each signal, or -1 when the sample has no valid value
+static void signalBins(const TelemetryRecord& r, int32_t bins[SIGNAL_COUNT]) {
+    bins[SIGNAL_TARGET_RPM] = r.targetRpm;
+    bins[SIGNAL_MANUAL_RPM] = r.manualRpm;
+    bins[SIGNAL_INPUT_RPM] = (r.flags & TELEMETRY_FLAG_RPM_INPUT) ? r.inputRpm : -1;
+    bins[SIGNAL_SPEED] = (r.flags & TELEMETRY_FLAG_VSS_INPUT) ? r.speedKph10 : -1;
+    bins[SIGNAL_WATER_TEMP] = (r.waterStatus == WATER_TEMP_STATUS_OK &&
+                               r.waterTempF10 != WATER_TEMP_INVALID) ? r.waterTempF10 + 32768 : -1;
+    bins[SIGNAL_PWM_DUTY] = r.pwmDuty;
+    bins[SIGNAL_STEERING] = (r.flags & TELEMETRY_FLAG_ENCODER) ? r.steeringLevel : -1;
+}
+
+static const struct {
+    const char* name;
+    const char* unit;
+    double scale;
+    int32_t offset;
+} SIGNALS[SIGNAL_COUNT] = {
+    {"target_rpm",   "rpm", 1.0,  0},
+    {"manual_rpm",   "rpm", 1.0,  0},
+    {"input_rpm",    "rpm", 1.0,  0},
+    {"speed",        "kph", 0.1,  0},
+    {"water_temp",   "F",   0.1,  32768},
+    {"pwm_duty",     "",    1.0,  0},
+    {"steering",     "",    1.0,  0},
+};
+
+// One thread's share: histograms instead of sorted samples, so the merge
+// is a sum and percentiles come from one pass over the bins
+struct SummaryPartial {
+    std::vector<uint32_t> histogram[SIGNAL_COUNT];
+    double sum[SIGNAL_COUNT] = {};
+    uint64_t records = 0;
+    uint64_t skipped = 0;
+    uint64_t bytes = 0;
+    uint64_t dropped = 0;
+    uint32_t restarts = 0;
+    bool any = false;
+    uint32_t firstSequence = 0;
+    uint32_t lastSequence = 0;
+    uint64_t firstUs = 0;
+    uint64_t lastUs = 0;
+    uint64_t overheat = 0;
+    double overheatSeconds = 0;
+    uint64_t health[HEALTH_STATES + 1] = {};
+};
+
+static void summarizeRun(const std::vector<ChunkRef>& chunks, size_t begin, size_t end,
+                         const Window& window, int32_t overheatF10, SummaryPartial& p) {
+    for (auto& histogram : p.histogram) {
+        histogram.assign(HISTOGRAM_BINS, 0);
+    }
+    prefetchRun(chunks, begin, end);
+
+    for (size_t i = begin; i < end; i++) {
+        const ChunkRef& ref = chunks[i];
+        p.bytes += ref.file->header().chunkBytes;
+        if (ref.file->check(ref.chunk) != ChunkState::Ok) {
+            p.skipped++;
+            continue;
+        }
+        const TelemetryChunkHeader& header = *ref.file->chunkHeader(ref.chunk);
+        const TelemetryRecord* records = ref.file->chunkRecords(ref.chunk);
+        const uint16_t rateHz = ref.file->header().sampleRateHz;
+        const double samplePeriod = rateHz ? 1.0 / rateHz : 0.0;
+
+        for (uint32_t n = 0; n < header.recordCount; n++) {
+            const TelemetryRecord& r = records[n];
+            uint64_t timeUs = recordTimeUs(header, r);
+            if (timeUs < window.fromUs || timeUs >= window.toUs) continue;
+
+            if (!p.any) {
+                p.any = true;
+                p.firstSequence = r.sequence;
+                p.firstUs = timeUs;
+            } else if (r.sequence > p.lastSequence) {
+                p.dropped += r.sequence - p.lastSequence - 1;
+            } else {
+                p.restarts++;
+            }
+            p.lastSequence = r.sequence;
+            p.lastUs = timeUs;
+            p.records++;
+
+            int32_t bins[SIGNAL_COUNT];
+            signalBins(r, bins);
+            for (int s = 0; s < SIGNAL_COUNT; s++) {
+                if (bins[s] < 0) continue;
+                p.histogram[s][bins[s]]++;
+                p.sum[s] += bins[s] - SIGNALS[s].offset;
+            }
+            if (bins[SIGNAL_WATER_TEMP] >= 0 && r.waterTempF10 >= overheatF10) {
+                p.overheat++;
+                p.overheatSeconds += samplePeriod;
+            }
+            p.health[std::min<uint8_t>(r.health, HEALTH_STATES)]++;
+        }
+    }
+}
+
+// Value at fraction q of the samples, from the merged histogram
+static double percentile(const std::vector<uint64_t>& histogram, uint64_t count, double q) {
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * count)));
+    uint64_t seen = 0;
+    for (uint32_t bin = 0; bin < HISTOGRAM_BINS; bin++) {
+        seen += histogram[bin];
+        if (seen >= rank) return bin;
+    }
+    return HISTOGRAM_BINS - 1;
+}
+
+Summary summarize(const std::vector<ChunkRef>& chunks, const Window& window,
+                  float overheatF, unsigned threads) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<SummaryPartial> partial(std::max(1u, threads));
+    const int32_t overheatF10 = static_cast<int32_t>(std::lround(overheatF * 10.0f));
+
+    parallelRuns(chunks.size(), threads, [&](unsigned t, size_t begin, size_t end) {
+        summarizeRun(chunks, begin, end, window, overheatF10, partial[t]);
+    });
+
+    Summary summary;
+    if (!chunks.empty()) {
+        summary.sampleRateHz = chunks.front().file->header().sampleRateHz;
+    }
+    std::vector<uint64_t> histogram[SIGNAL_COUNT];
+    double sum[SIGNAL_COUNT] = {};
+    for (auto& h : histogram) {
+        h.assign(HISTOGRAM_BINS, 0);
+    }
+
+    // Merge in chunk order so sequence gaps between runs are counted once
+    const SummaryPartial* previous = nullptr;
+    for (const SummaryPartial& p : partial) {
+        summary.skipped += p.skipped;
+        summary.bytes += p.bytes;
+        if (!p.any) continue;
+        if (previous) {
+            if (p.firstSequence > previous->lastSequence) {
+                summary.dropped += p.firstSequence - previous->lastSequence - 1;
+            } else {
+                summary.restarts++;
+            }
+        } else {
+            summary.firstUs = p.firstUs;
+        }
+        summary.lastUs = p.lastUs;
+        summary.records += p.records;
+        summary.dropped += p.dropped;
+        summary.restarts += p.restarts;
+        summary.overheatSamples += p.overheat;
+        summary.overheatSeconds += p.overheatSeconds;
+        for (int h = 0; h <= HEALTH_STATES; h++) {
+            summary.health[h] += p.health[h];
+        }
+        for (int s = 0; s < SIGNAL_COUNT; s++) {
+            sum[s] += p.sum[s];
+            for (uint32_t bin = 0; bin < HISTOGRAM_BINS; bin++) {
+                histogram[s][bin] += p.histogram[s][bin];
+            }
+        }
+        previous = &p;
+    }
+
+    for (int s = 0; s < SIGNAL_COUNT; s++) {
+        SignalSummary& out = summary.signals[s];
+        out.name = SIGNALS[s].name;
+        out.unit = SIGNALS[s].unit;
+        for (uint32_t bin = 0; bin < HISTOGRAM_BINS; bin++) {
+            out.count += histogram[s][bin];
+        }
+        if (out.count == 0) continue;
+
+        uint32_t lo = 0;
+        while (histogram[s][lo] == 0) lo++;
+        uint32_t hi = HISTOGRAM_BINS - 1;
+        while (histogram[s][hi] == 0) hi--;
+        auto value = [&](double bin) { return (bin - SIGNALS[s].offset) * SIGNALS[s].scale; };
+        out.min = value(lo);
+        out.max = value(hi);
+        out.mean = sum[s] / out.count * SIGNALS[s].scale;
+        out.p50 = value(percentile(histogram[s], out.count, 0.50));
+        out.p95 = value(percentile(histogram[s], out.count, 0.95));
+        out.p99 = value(percentile(histogram[s], out.count, 0.99));
+    }
+    summary.seconds = secondsSince(start);
+    return summary;
+}
+
+// =============================================================================
+// CSV Export
+// =============================================================================
+
+// Chunks each thread formats per batch; bounds memory to a few MB per thread
+static const size_t CSV_BATCH_CHUNKS = 64;
+
+static const char CSV_HEADER[] =
+    "time_s,sequence,target_rpm,manual_rpm,input_rpm,speed_kph,water_temp_f,water_status,"
+    "pwm_duty,steering,health,display_mode,op_mode,flags\n";
+
+// snprintf costs more than everything else in a row put together
+static char* putUint(char* p, uint64_t v) {
+    char digits[20];
+    int n = 0;
+    do {
+        digits[n++] = static_cast<char>('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n > 0) *p++ = digits[--n];
+    return p;
+}
+
+// Fixed point with one decimal: 1234 -> "123.4"
+static char* putTenths(char* p, int32_t v) {
+    if (v < 0) {
+        *p++ = '-';
+        v = -v;
+    }
+    p = putUint(p, static_cast<uint32_t>(v) / 10);
+    *p++ = '.';
+    *p++ = static_cast<char>('0' + v % 10);
+    return p;
+}
+
+static void formatRun(const std::vector<ChunkRef>& chunks, size_t begin, size_t end,
+                      const Window& window, std::string& out, ExportResult& result) {
+    out.clear();
+    prefetchRun(chunks, begin, end);
+    char row[192];
+
+    for (size_t i = begin; i < end; i++) {
+        const ChunkRef& ref = chunks[i];
+        if (ref.file->check(ref.chunk) != ChunkState::Ok) {
+            result.skipped++;
+            continue;
+        }
+        const TelemetryChunkHeader& header = *ref.file->chunkHeader(ref.chunk);
+        const TelemetryRecord* records = ref.file->chunkRecords(ref.chunk);
+
+        for (uint32_t n = 0; n < header.recordCount; n++) {
+            const TelemetryRecord& r = records[n];
+            uint64_t timeUs = recordTimeUs(header, r);
+            if (timeUs < window.fromUs || timeUs >= window.toUs) continue;
+
+            char* p = row;
+            p = putUint(p, timeUs / 1000000);
+            *p++ = '.';
+            uint32_t fraction = static_cast<uint32_t>(timeUs % 1000000);
+            for (uint32_t div = 100000; div > 0; div /= 10) {
+                *p++ = static_cast<char>('0' + fraction / div % 10);
+            }
+            *p++ = ',';
+            p = putUint(p, r.sequence);
+            *p++ = ',';
+            p = putUint(p, r.targetRpm);
+            *p++ = ',';
+            p = putUint(p, r.manualRpm);
+            *p++ = ',';
+            p = putUint(p, r.inputRpm);
+            *p++ = ',';
+            p = putTenths(p, r.speedKph10);
+            *p++ = ',';
+            if (r.waterStatus == WATER_TEMP_STATUS_OK && r.waterTempF10 != WATER_TEMP_INVALID) {
+                p = putTenths(p, r.waterTempF10);
+            }
+            *p++ = ',';
+            p = putUint(p, r.waterStatus);
+            *p++ = ',';
+            p = putUint(p, r.pwmDuty);
+            *p++ = ',';
+            p = putUint(p, r.steeringLevel);
+            *p++ = ',';
+            p = putUint(p, r.health);
+            *p++ = ',';
+            p = putUint(p, r.modes & TELEMETRY_MODE_DISPLAY_MASK);
+            *p++ = ',';
+            p = putUint(p, r.modes >> TELEMETRY_MODE_OP_SHIFT);
+            *p++ = ',';
+            p = putUint(p, r.flags);
+            *p++ = '\n';
+            out.append(row, p - row);
+            result.records++;
+        }
+    }
+}
+
+bool exportCsv(const std::vector<ChunkRef>& chunks, const Window& window, FILE* out,
+               unsigned threads, ExportResult* result) {
+    auto start = std::chrono::steady_clock::now();
+    threads = std::max(1u, threads);
+    std::vector<std::string> text(threads);
+    std::vector<ExportResult> partial(threads);
+    *result = ExportResult();
+
+    if (fputs(CSV_HEADER, out) < 0) return false;
+    result->bytes += sizeof(CSV_HEADER) - 1;
+
+    // Format a batch in parallel, then write it in order
+    const size_t batch = CSV_BATCH_CHUNKS * threads;
+    for (size_t first = 0; first < chunks.size(); first += batch) {
+        size_t count = std::min(batch, chunks.size() - first);
+        parallelRuns(count, threads, [&](unsigned t, size_t begin, size_t end) {
+            formatRun(chunks, first + begin, first + end, window, text[t], partial[t]);
+        });
+        for (unsigned t = 0; t < threads && t < count; t++) {
+            if (fwrite(text[t].data(), 1, text[t].size(), out) != text[t].size()) return false;
+            result->bytes += text[t].size();
+        }
+    }
+
+    for (const ExportResult& p : partial) {
+        result->records += p.records;
+        result->skipped += p.skipped;
+    }
+    result->seconds = secondsSince(start);
+    return fflush(out) == 0;
+}
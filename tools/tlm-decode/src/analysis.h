@@ -0,0 +1,113 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include "log_file.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+// =============================================================================
+// Log Analysis
+// =============================================================================
+// Work over a set of log files is split into runs of chunks, one per
+// thread. Chunks are independent (own header, own CRC, own start time),
+// so threads never share state until their results are merged in file
+// order at the end.
+
+// Device time window, in microseconds since boot
+struct Window {
+    uint64_t fromUs = 0;
+    uint64_t toUs = UINT64_MAX;     // Exclusive
+};
+
+struct ChunkRef {
+    const LogFile* file;
+    uint32_t chunk;
+};
+
+// Chunks of files (sorted by file index) that may hold records in window
+std::vector<ChunkRef> selectChunks(const std::vector<std::unique_ptr<LogFile>>& files,
+                                   const Window& window);
+
+// =============================================================================
+// Verify
+// =============================================================================
+
+struct VerifyResult {
+    uint64_t ok = 0;
+    uint64_t missing = 0;
+    uint64_t corrupt = 0;
+    uint64_t records = 0;
+    uint64_t bytes = 0;             // Chunk bytes read
+    double seconds = 0;
+    std::vector<ChunkRef> bad;      // Corrupt chunks, in order
+};
+
+VerifyResult verifyChunks(const std::vector<ChunkRef>& chunks, unsigned threads);
+
+// =============================================================================
+// Summary
+// =============================================================================
+
+struct SignalSummary {
+    const char* name;
+    const char* unit;
+    uint64_t count = 0;             // Samples with a valid value
+    double min = 0;
+    double max = 0;
+    double mean = 0;
+    double p50 = 0;
+    double p95 = 0;
+    double p99 = 0;
+};
+
+enum {
+    SIGNAL_TARGET_RPM,
+    SIGNAL_MANUAL_RPM,
+    SIGNAL_INPUT_RPM,
+    SIGNAL_SPEED,
+    SIGNAL_WATER_TEMP,
+    SIGNAL_PWM_DUTY,
+    SIGNAL_STEERING,
+    SIGNAL_COUNT
+};
+
+#define HEALTH_STATES 4             // SystemHealth values on the master
+
+struct Summary {
+    uint64_t records = 0;
+    uint64_t skipped = 0;           // Chunks with a bad header or CRC
+    uint64_t dropped = 0;           // Sequence numbers never stored
+    uint32_t restarts = 0;          // Sequence went backwards (reboot)
+    uint64_t firstUs = 0;
+    uint64_t lastUs = 0;
+    uint32_t sampleRateHz = 0;
+    SignalSummary signals[SIGNAL_COUNT];
+    uint64_t overheatSamples = 0;
+    double overheatSeconds = 0;
+    uint64_t health[HEALTH_STATES + 1] = {};   // Last slot: out of range
+    uint64_t bytes = 0;
+    double seconds = 0;
+};
+
+Summary summarize(const std::vector<ChunkRef>& chunks, const Window& window,
+                  float overheatF, unsigned threads);
+
+// =============================================================================
+// CSV Export
+// =============================================================================
+
+struct ExportResult {
+    uint64_t records = 0;
+    uint64_t skipped = 0;
+    uint64_t bytes = 0;             // CSV bytes written
+    double seconds = 0;
+};
+
+// Returns false if writing to out failed
+bool exportCsv(const std::vector<ChunkRef>& chunks, const Window& window, FILE* out,
+               unsigned threads, ExportResult* result);
+
+#endif // ANALYSIS_H
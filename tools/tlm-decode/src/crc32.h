@@ -0,0 +1,15 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <cstddef>
+#include <cstdint>
+
+// =============================================================================
+// CRC-32
+// =============================================================================
+// IEEE CRC-32, the same checksum otaCrc32() computes on the device, eight
+// bytes per step (slicing-by-8) so checking chunks keeps up with the disk.
+
+uint32_t crc32Fast(const uint8_t* data, size_t length);
+
+#endif // CRC32_H
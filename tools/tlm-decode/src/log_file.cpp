@@ -0,0 +1,145 @@
+#include "log_file.h"
+#include "crc32.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// =============================================================================
+// Mapping
+// =============================================================================
+
+LogFile::~LogFile() {
+    if (_data) {
+        munmap(const_cast<uint8_t*>(_data), _size);
+    }
+}
+
+bool LogFile::open(const std::string& path, std::string* error) {
+    _path = path;
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        *error = std::strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        *error = std::strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    if (st.st_size < TELEMETRY_FILE_HEADER_BYTES) {
+        *error = "too short for a file header";
+        ::close(fd);
+        return false;
+    }
+
+    void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        *error = std::strerror(errno);
+        return false;
+    }
+    _data = static_cast<const uint8_t*>(map);
+    _size = static_cast<uint64_t>(st.st_size);
+
+    std::memcpy(&_header, _data, sizeof(_header));
+    if (!telemetryFileHeaderValid(&_header)) {
+        *error = "not a telemetry log (bad file header)";
+        return false;
+    }
+    _chunks = static_cast<uint32_t>((_size - TELEMETRY_FILE_HEADER_BYTES) / _header.chunkBytes);
+    return true;
+}
+
+void LogFile::prefetch(uint32_t first, uint32_t last) const {
+    if (first >= last || first >= _chunks) return;
+    if (last > _chunks) last = _chunks;
+    // madvise wants a page-aligned start
+    uint64_t start = TELEMETRY_FILE_HEADER_BYTES + static_cast<uint64_t>(first) * _header.chunkBytes;
+    uint64_t end = TELEMETRY_FILE_HEADER_BYTES + static_cast<uint64_t>(last) * _header.chunkBytes;
+    uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    start &= ~(page - 1);
+    madvise(const_cast<uint8_t*>(_data) + start, end - start, MADV_WILLNEED);
+}
+
+// =============================================================================
+// Chunks
+// =============================================================================
+
+const uint8_t* LogFile::chunkData(uint32_t k) const {
+    return _data + TELEMETRY_FILE_HEADER_BYTES + static_cast<uint64_t>(k) * _header.chunkBytes;
+}
+
+const TelemetryChunkHeader* LogFile::chunkHeader(uint32_t k) const {
+    // Chunk offsets are multiples of 512, so the header is aligned in the map
+    auto header = reinterpret_cast<const TelemetryChunkHeader*>(chunkData(k));
+    if (header->magic != TELEMETRY_CHUNK_MAGIC ||
+        header->crc != crc32Fast(reinterpret_cast<const uint8_t*>(header),
+                                 sizeof(TelemetryChunkHeader) - sizeof(uint32_t)) ||
+        header->recordCount == 0 || header->recordCount > telemetryChunkRecords(_header.chunkBytes)) {
+        return nullptr;
+    }
+    return header;
+}
+
+ChunkState LogFile::check(uint32_t k) const {
+    auto raw = reinterpret_cast<const TelemetryChunkHeader*>(chunkData(k));
+    if (raw->magic == 0) {
+        return ChunkState::Missing;
+    }
+    const TelemetryChunkHeader* header = chunkHeader(k);
+    if (!header) {
+        return ChunkState::Corrupt;
+    }
+    const uint8_t* records = chunkData(k) + sizeof(TelemetryChunkHeader);
+    if (crc32Fast(records, header->recordCount * sizeof(TelemetryRecord)) != header->dataCrc) {
+        return ChunkState::Corrupt;
+    }
+    return ChunkState::Ok;
+}
+
+// =============================================================================
+// Seeking
+// =============================================================================
+
+uint64_t LogFile::startAtOrAfter(uint32_t k) const {
+    for (; k < _chunks; k++) {
+        const TelemetryChunkHeader* header = chunkHeader(k);
+        if (header) return header->firstTimeUs;
+    }
+    return UINT64_MAX;
+}
+
+uint32_t LogFile::lowerBound(uint64_t timeUs, bool inclusive) const {
+    uint32_t lo = 0;
+    uint32_t hi = _chunks;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        uint64_t start = startAtOrAfter(mid);
+        if (inclusive ? start >= timeUs : start > timeUs) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return lo;
+}
+
+uint32_t LogFile::seek(uint64_t timeUs) const {
+    // Step back from the first chunk starting after timeUs to a valid one
+    uint32_t k = lowerBound(timeUs, false);
+    while (k > 0) {
+        k--;
+        if (chunkHeader(k)) return k;
+    }
+    return 0;
+}
+
+uint32_t LogFile::seekStart(uint64_t timeUs) const {
+    return lowerBound(timeUs, true);
+}
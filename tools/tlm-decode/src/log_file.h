@@ -0,0 +1,80 @@
+#ifndef LOG_FILE_H
+#define LOG_FILE_H
+
+#include "master/telemetry_log.h"
+
+#include <cstdint>
+#include <string>
+
+// =============================================================================
+// Memory-Mapped Telemetry Log
+// =============================================================================
+// One /tlm/NNNNN.bin file from the master, mapped read-only. Chunks are at
+// a fixed stride after the file header, so chunk k is found by arithmetic
+// and a time is found by binary search over the chunk headers - nothing
+// is read that the caller does not ask for. A trailing partial chunk (the
+// card was pulled mid-write) is ignored.
+
+enum class ChunkState {
+    Ok,
+    Missing,        // Never written (zeros or a chunk the card lost)
+    Corrupt         // Bad header or record CRC
+};
+
+class LogFile {
+public:
+    LogFile() = default;
+    ~LogFile();
+    LogFile(const LogFile&) = delete;
+    LogFile& operator=(const LogFile&) = delete;
+
+    // Map and check the file header; error says why it failed
+    bool open(const std::string& path, std::string* error);
+
+    const std::string& path() const { return _path; }
+    const TelemetryFileHeader& header() const { return _header; }
+    uint64_t size() const { return _size; }
+    uint32_t chunkCount() const { return _chunks; }
+
+    // Chunk k's header if its magic and header CRC check out, else nullptr
+    const TelemetryChunkHeader* chunkHeader(uint32_t k) const;
+
+    const uint8_t* chunkData(uint32_t k) const;
+    const TelemetryRecord* chunkRecords(uint32_t k) const {
+        return reinterpret_cast<const TelemetryRecord*>(chunkData(k) + sizeof(TelemetryChunkHeader));
+    }
+
+    // Header and record CRCs
+    ChunkState check(uint32_t k) const;
+
+    // Chunks with valid headers have rising start times, so both of these
+    // are binary searches.
+    // Chunk holding the record at timeUs: the last one starting at or
+    // before it (0 if none does)
+    uint32_t seek(uint64_t timeUs) const;
+    // First chunk starting at or after timeUs (chunkCount() if none)
+    uint32_t seekStart(uint64_t timeUs) const;
+
+    // Ask the kernel to read chunks [first, last) ahead
+    void prefetch(uint32_t first, uint32_t last) const;
+
+private:
+    // Start time of the first valid chunk at or after k (UINT64_MAX if none)
+    uint64_t startAtOrAfter(uint32_t k) const;
+
+    // First k whose startAtOrAfter() is above timeUs (or at least, if inclusive)
+    uint32_t lowerBound(uint64_t timeUs, bool inclusive) const;
+
+    std::string _path;
+    TelemetryFileHeader _header = {};
+    const uint8_t* _data = nullptr;
+    uint64_t _size = 0;
+    uint32_t _chunks = 0;
+};
+
+// Full time of a record, from the 32-bit time it carries and its chunk's start
+inline uint64_t recordTimeUs(const TelemetryChunkHeader& chunk, const TelemetryRecord& record) {
+    return chunk.firstTimeUs + static_cast<uint32_t>(record.timeUs - static_cast<uint32_t>(chunk.firstTimeUs));
+}
+
+#endif // LOG_FILE_H
@@ -0,0 +1,339 @@
+#include "analysis.h"
+#include "log_file.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// =============================================================================
+// Constants
+// =============================================================================
+
+constexpr float DEFAULT_OVERHEAT_F = 230.0f;
+
+static const char* const HEALTH_NAMES[HEALTH_STATES + 1] = {
+    "ok", "spi_timeout", "can_error", "failsafe", "unknown"
+};
+
+// =============================================================================
+// Options
+// =============================================================================
+
+struct DecodeOptions {
+    Window window;
+    std::string output;             // CSV destination, stdout if empty
+    unsigned threads = 0;           // 0 = one per core
+    float overheatF = DEFAULT_OVERHEAT_F;
+};
+
+// =============================================================================
+// Usage
+// =============================================================================
+
+static void printUsage(const char* progName) {
+    std::cout << "tlm-decode - Reader for master telemetry logs (/tlm/NNNNN.bin)\n\n";
+    std::cout << "Usage:\n";
+    std::cout << "  " << progName << " info <files...>\n";
+    std::cout << "      File headers and chunk time ranges\n\n";
+    std::cout << "  " << progName << " verify <files...> [--threads <n>]\n";
+    std::cout << "      Check every chunk CRC in parallel\n\n";
+    std::cout << "  " << progName << " stats <files...> [options]\n";
+    std::cout << "      Min/max/percentiles per signal, time above overheat, health states\n\n";
+    std::cout << "  " << progName << " csv <files...> [options]\n";
+    std::cout << "      Export records as CSV\n\n";
+    std::cout << "Files are read in file index order whatever order they are given in.\n\n";
+    std::cout << "Options:\n";
+    std::cout << "  --from <s>             Start of window, seconds since boot (default: start)\n";
+    std::cout << "  --to <s>               End of window, seconds since boot (default: end)\n";
+    std::cout << "  -o, --output <file>    CSV output (default: stdout)\n";
+    std::cout << "  --threads <n>          Worker threads (default: one per core)\n";
+    std::cout << "  --overheat-f <deg>     Overheat threshold (default: " << DEFAULT_OVERHEAT_F << ")\n";
+    std::cout << "  --help                 Show this help\n";
+}
+
+// =============================================================================
+// Helpers
+// =============================================================================
+
+static bool openFiles(const std::vector<std::string>& paths,
+                      std::vector<std::unique_ptr<LogFile>>& files) {
+    for (const std::string& path : paths) {
+        auto file = std::make_unique<LogFile>();
+        std::string error;
+        if (!file->open(path, &error)) {
+            std::cerr << "Error: " << path << ": " << error << "\n";
+            return false;
+        }
+        files.push_back(std::move(file));
+    }
+    std::stable_sort(files.begin(), files.end(), [](const auto& a, const auto& b) {
+        return a->header().fileIndex < b->header().fileIndex;
+    });
+    return true;
+}
+
+static double mbPerSecond(uint64_t bytes, double seconds) {
+    return seconds > 0 ? bytes / seconds / (1024.0 * 1024.0) : 0.0;
+}
+
+static std::string formatTime(uint64_t timeUs) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.3f s", timeUs / 1e6);
+    return text;
+}
+
+// =============================================================================
+// Commands
+// =============================================================================
+
+static int cmdInfo(const std::vector<std::unique_ptr<LogFile>>& files) {
+    for (const auto& file : files) {
+        const TelemetryFileHeader& h = file->header();
+        char firmware[TELEMETRY_FIRMWARE_MAX + 1] = {};
+        std::memcpy(firmware, h.firmware, TELEMETRY_FIRMWARE_MAX);
+
+        uint32_t valid = 0;
+        uint64_t records = 0;
+        uint64_t firstUs = UINT64_MAX;
+        uint64_t lastUs = 0;
+        for (uint32_t k = 0; k < file->chunkCount(); k++) {
+            const TelemetryChunkHeader* chunk = file->chunkHeader(k);
+            if (!chunk) continue;
+            valid++;
+            records += chunk->recordCount;
+            firstUs = std::min(firstUs, chunk->firstTimeUs);
+            lastUs = std::max(lastUs, recordTimeUs(*chunk, file->chunkRecords(k)[chunk->recordCount - 1]));
+        }
+
+        std::cout << file->path() << ":\n";
+        std::cout << "  File index:   " << h.fileIndex << " (firmware " << firmware << ")\n";
+        std::cout << "  Sample rate:  " << h.sampleRateHz << " Hz, " << h.recordBytes << " B records\n";
+        std::cout << "  Chunks:       " << valid << "/" << file->chunkCount() << " with headers, "
+                  << h.chunkBytes << " B (" << h.chunkRecords << " records each)\n";
+        std::cout << "  Records:      " << records << " from sequence " << h.firstSequence << "\n";
+        if (valid > 0) {
+            std::cout << "  Time:         " << formatTime(firstUs) << " to " << formatTime(lastUs) << "\n";
+        }
+    }
+    return 0;
+}
+
+static int cmdVerify(const std::vector<std::unique_ptr<LogFile>>& files, const DecodeOptions& opts) {
+    std::vector<ChunkRef> chunks = selectChunks(files, Window());
+    VerifyResult r = verifyChunks(chunks, opts.threads);
+
+    for (const ChunkRef& bad : r.bad) {
+        std::cout << "  corrupt: " << bad.file->path() << " chunk " << bad.chunk << "\n";
+    }
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Chunks:     " << chunks.size() << " (" << r.ok << " ok, " << r.missing
+              << " missing, " << r.corrupt << " corrupt)\n";
+    std::cout << "Records:    " << r.records << "\n";
+    std::cout << "Throughput: " << r.bytes / (1024.0 * 1024.0) << " MB in " << r.seconds * 1000.0
+              << " ms, " << mbPerSecond(r.bytes, r.seconds) / 1024.0 << " GB/s on "
+              << opts.threads << " threads\n";
+    return r.corrupt == 0 ? 0 : 2;
+}
+
+static int cmdStats(const std::vector<std::unique_ptr<LogFile>>& files, const DecodeOptions& opts) {
+    std::vector<ChunkRef> chunks = selectChunks(files, opts.window);
+    Summary s = summarize(chunks, opts.window, opts.overheatF, opts.threads);
+    if (s.records == 0) {
+        std::cerr << "No records in the selected window\n";
+        return 1;
+    }
+
+    double spanSeconds = (s.lastUs - s.firstUs) / 1e6;
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Window:    " << formatTime(s.firstUs) << " to " << formatTime(s.lastUs)
+              << " (" << spanSeconds << " s)\n";
+    std::cout << "Records:   " << s.records << " at " << s.sampleRateHz << " Hz, " << s.dropped
+              << " dropped, " << s.restarts << " restarts, " << s.skipped << " bad chunks skipped\n\n";
+
+    std::cout << "  " << std::left << std::setw(15) << "signal" << std::right
+              << std::setw(10) << "samples" << std::setw(9) << "min" << std::setw(9) << "p50"
+              << std::setw(9) << "p95" << std::setw(9) << "p99" << std::setw(9) << "max"
+              << std::setw(9) << "mean" << "\n";
+    for (const SignalSummary& sig : s.signals) {
+        std::string name = sig.name;
+        if (sig.unit[0]) name += std::string(" ") + sig.unit;
+        std::cout << "  " << std::left << std::setw(15) << name << std::right
+                  << std::setw(10) << sig.count;
+        if (sig.count == 0) {
+            std::cout << "  (no valid samples)\n";
+            continue;
+        }
+        std::cout << std::setw(9) << sig.min << std::setw(9) << sig.p50 << std::setw(9) << sig.p95
+                  << std::setw(9) << sig.p99 << std::setw(9) << sig.max << std::setw(9) << sig.mean
+                  << "\n";
+    }
+
+    const SignalSummary& water = s.signals[SIGNAL_WATER_TEMP];
+    std::cout << "\nOverheat:  " << s.overheatSeconds << " s at or above " << opts.overheatF << " F ("
+              << std::setprecision(2) << (water.count ? 100.0 * s.overheatSamples / water.count : 0.0)
+              << "% of valid water temp samples)\n";
+    std::cout << "Health:   ";
+    for (int h = 0; h <= HEALTH_STATES; h++) {
+        if (s.health[h] == 0) continue;
+        std::cout << " " << HEALTH_NAMES[h] << " " << 100.0 * s.health[h] / s.records << "%";
+    }
+    std::cout << "\nParsed:    " << s.bytes / (1024.0 * 1024.0) << " MB in " << s.seconds * 1000.0
+              << " ms, " << mbPerSecond(s.bytes, s.seconds) / 1024.0 << " GB/s\n";
+    return 0;
+}
+
+static int cmdCsv(const std::vector<std::unique_ptr<LogFile>>& files, const DecodeOptions& opts) {
+    FILE* out = stdout;
+    if (!opts.output.empty()) {
+        out = fopen(opts.output.c_str(), "wb");
+        if (!out) {
+            std::cerr << "Error: cannot create " << opts.output << ": " << std::strerror(errno) << "\n";
+            return 1;
+        }
+    }
+
+    std::vector<ChunkRef> chunks = selectChunks(files, opts.window);
+    ExportResult r;
+    bool ok = exportCsv(chunks, opts.window, out, opts.threads, &r);
+    if (out != stdout && fclose(out) != 0) {
+        ok = false;
+    }
+    if (!ok) {
+        std::cerr << "Error: write failed: " << std::strerror(errno) << "\n";
+        return 1;
+    }
+
+    // Keep stdout clean for the CSV itself
+    std::cerr << std::fixed << std::setprecision(1);
+    std::cerr << r.records << " records (" << r.bytes / (1024.0 * 1024.0) << " MB CSV) in "
+              << r.seconds * 1000.0 << " ms";
+    if (r.skipped > 0) {
+        std::cerr << ", " << r.skipped << " bad chunks skipped";
+    }
+    std::cerr << "\n";
+    return 0;
+}
+
+// =============================================================================
+// Main
+// =============================================================================
+
+static bool parseSeconds(const char* text, uint64_t* timeUs) {
+    char* end = nullptr;
+    double seconds = std::strtod(text, &end);
+    if (end == text || *end != '\0' || !(seconds >= 0)) return false;
+    *timeUs = static_cast<uint64_t>(std::llround(seconds * 1e6));
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::string command = argv[1];
+
+    if (command == "--help" || command == "-h") {
+        printUsage(argv[0]);
+        return 0;
+    }
+
+    DecodeOptions opts;
+
+    enum { OPT_FROM = 1000, OPT_TO, OPT_THREADS, OPT_OVERHEAT_F };
+
+    static struct option longOptions[] = {
+        {"from", required_argument, nullptr, OPT_FROM},
+        {"to", required_argument, nullptr, OPT_TO},
+        {"output", required_argument, nullptr, 'o'},
+        {"threads", required_argument, nullptr, OPT_THREADS},
+        {"overheat-f", required_argument, nullptr, OPT_OVERHEAT_F},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}
+    };
+
+    // Skip command name for getopt
+    optind = 2;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "o:h", longOptions, nullptr)) != -1) {
+        switch (opt) {
+            case OPT_FROM:
+                if (!parseSeconds(optarg, &opts.window.fromUs)) {
+                    std::cerr << "Error: --from wants seconds\n";
+                    return 1;
+                }
+                break;
+            case OPT_TO:
+                if (!parseSeconds(optarg, &opts.window.toUs)) {
+                    std::cerr << "Error: --to wants seconds\n";
+                    return 1;
+                }
+                break;
+            case 'o':             opts.output = optarg; break;
+            case OPT_THREADS:     opts.threads = static_cast<unsigned>(std::strtoul(optarg, nullptr, 0)); break;
+            case OPT_OVERHEAT_F:  opts.overheatF = std::strtof(optarg, nullptr); break;
+            case 'h':
+                printUsage(argv[0]);
+                return 0;
+            default:
+                return 1;
+        }
+    }
+
+    std::vector<std::string> paths;
+    for (int i = optind; i < argc; i++) {
+        paths.push_back(argv[i]);
+    }
+
+    if (opts.threads == 0) {
+        opts.threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (opts.window.fromUs >= opts.window.toUs) {
+        std::cerr << "Error: --from must be before --to\n";
+        return 1;
+    }
+
+    if (command != "info" && command != "verify" && command != "stats" && command != "csv") {
+        std::cerr << "Unknown command: " << command << "\n\n";
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (paths.empty()) {
+        std::cerr << "Error: " << command << " command requires <files...>\n";
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<LogFile>> files;
+    if (!openFiles(paths, files)) {
+        return 1;
+    }
+
+    int result = 0;
+
+    if (command == "info") {
+        result = cmdInfo(files);
+    }
+    else if (command == "verify") {
+        result = cmdVerify(files, opts);
+    }
+    else if (command == "stats") {
+        result = cmdStats(files, opts);
+    }
+    else {
+        result = cmdCsv(files, opts);
+    }
+
+    return result;
+}
@@ -0,0 +1,265 @@
+#include "durable.h"
+#include "policy_dispatch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+// =============================================================================
+// Page Versions
+// =============================================================================
+// Every write op appends the CRC of each page it touched; version 0 is the
+// zero page a never-written page reads as.
+
+struct PageHistory {
+    std::vector<uint32_t> crcs;     // Version k is crcs[k - 1]
+    uint32_t flushed = 0;           // Version the last successful flush() made durable
+};
+
+enum PageVerdict { PAGE_INTACT, PAGE_DETECTED, PAGE_LOST, PAGE_CORRUPT, PAGE_VERDICTS };
+
+static const char* const VERDICT_NAMES[PAGE_VERDICTS] = {"intact", "detected", "lost", "corrupt"};
+
+// Trace data: incompressible and different for every write, so a torn
+// write-back never matches a version by accident
+static uint8_t durableByte(uint32_t addr, uint32_t generation, uint32_t seed) {
+    uint32_t h = (addr ^ seed) * 2654435761u + generation * 40503u;
+    return static_cast<uint8_t>(h >> 24);
+}
+
+static PageVerdict classify(const PageHistory& history, uint32_t crc, uint32_t zeroCrc) {
+    // Newest matching version
+    for (size_t k = history.crcs.size(); k > 0; k--) {
+        if (history.crcs[k - 1] == crc) {
+            return k >= history.flushed ? PAGE_INTACT : PAGE_LOST;
+        }
+    }
+    if (crc == zeroCrc) {
+        return history.flushed == 0 ? PAGE_INTACT : PAGE_LOST;
+    }
+    return PAGE_CORRUPT;
+}
+
+// =============================================================================
+// Passes
+// =============================================================================
+
+struct PassResult {
+    double wallMs = 0;
+    StorageCounters io;
+    VMemStats stats = {};
+    uint32_t verdicts[PAGE_VERDICTS] = {};
+    VMemRecovery recovery = {};
+};
+
+static double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+template <class Policy>
+static bool openVm(VirtualMemoryT<Policy>& vm, PosixStorage& storage, HeapAllocator& allocator,
+                   const DurableParams& params, uint32_t journalKb) {
+    VMemGeometry geometry;
+    geometry.totalSize = params.sizeMb * 1024 * 1024;
+    geometry.pageSize = params.pageSize;
+    geometry.cacheSize = params.cacheKb * 1024;
+    geometry.tierSize = params.tierKb * 1024;
+    geometry.shardSize = params.shardMb * 1024 * 1024;
+    geometry.journalSize = journalKb * 1024;
+    vm.setBackend(&storage, &allocator);
+    return vm.init(geometry);
+}
+
+// Replay the trace, losing power at storage write cutAt (0 = never), then
+// reopen the swap and classify every page
+template <class Policy>
+static bool runPass(const std::vector<TraceOp>& ops, const DurableParams& params,
+                    uint32_t journalKb, uint64_t cutAt, PassResult& result) {
+    const uint32_t spaceSize = params.sizeMb * 1024 * 1024;
+    const uint32_t pages = spaceSize / params.pageSize;
+
+    HeapAllocator allocator;
+    std::vector<PageHistory> history(pages);
+    std::vector<uint8_t> shadow(spaceSize, 0);
+    std::vector<uint8_t> buffer;
+    result = PassResult();
+
+    {
+        PosixStorage storage(params.swapPath, params.latency);
+        storage.remove();
+        VirtualMemoryT<Policy> vm;
+        if (!openVm(vm, storage, allocator, params, journalKb)) {
+            std::cerr << "VirtualMemory init failed\n";
+            return false;
+        }
+        storage.resetCounters();
+        storage.cutPowerAfter(cutAt);
+
+        auto start = std::chrono::steady_clock::now();
+        uint32_t generation = 0;
+        bool alive = true;
+
+        for (size_t i = 0; i < ops.size() && alive; i++) {
+            const TraceOp& op = ops[i];
+            if (op.length == 0 || static_cast<uint64_t>(op.addr) + op.length > spaceSize) {
+                continue;
+            }
+            buffer.resize(op.length);
+
+            if (op.write) {
+                generation++;
+                for (uint32_t j = 0; j < op.length; j++) {
+                    buffer[j] = durableByte(op.addr + j, generation, params.seed);
+                }
+                // The shadow moves first: a write that fails part-way may
+                // still have reached the cache
+                std::copy(buffer.begin(), buffer.end(), shadow.begin() + op.addr);
+                uint32_t first = op.addr / params.pageSize;
+                uint32_t last = (op.addr + op.length - 1) / params.pageSize;
+                for (uint32_t page = first; page <= last; page++) {
+                    history[page].crcs.push_back(
+                        vmemCrc32(&shadow[static_cast<size_t>(page) * params.pageSize], params.pageSize));
+                }
+                alive = vm.write(op.addr, buffer.data(), op.length) >= 0;
+            } else {
+                alive = vm.read(op.addr, buffer.data(), op.length) >= 0;
+            }
+
+            if (alive && params.flushEvery > 0 && (i + 1) % params.flushEvery == 0) {
+                alive = vm.flush();
+                if (alive) {
+                    for (PageHistory& h : history) h.flushed = static_cast<uint32_t>(h.crcs.size());
+                }
+            }
+            alive = alive && !storage.powerLost();
+        }
+
+        if (alive && vm.flush() && !storage.powerLost()) {
+            for (PageHistory& h : history) h.flushed = static_cast<uint32_t>(h.crcs.size());
+        }
+        result.wallMs = elapsedMs(start);
+        result.io = storage.counters();
+        result.stats = vm.getStats();
+        // Shutdown after a cut only fails its writes; nothing more reaches the files
+    }
+    if (cutAt == 0) {
+        PosixStorage(params.swapPath, params.latency).remove();
+        return true;
+    }
+
+    // Power back: a new instance recovers the swap
+    PosixStorage storage(params.swapPath, params.latency);
+    VirtualMemoryT<Policy> vm;
+    if (!openVm(vm, storage, allocator, params, journalKb)) {
+        std::cerr << "VirtualMemory init failed after the power cut\n";
+        return false;
+    }
+    result.recovery = vm.getRecovery();
+
+    std::vector<uint8_t> zero(params.pageSize, 0);
+    uint32_t zeroCrc = vmemCrc32(zero.data(), params.pageSize);
+    buffer.resize(params.pageSize);
+    for (uint32_t page = 0; page < pages; page++) {
+        if (vm.read(page * params.pageSize, buffer.data(), params.pageSize) < 0) {
+            result.verdicts[PAGE_DETECTED]++;
+            continue;
+        }
+        result.verdicts[classify(history[page], vmemCrc32(buffer.data(), params.pageSize), zeroCrc)]++;
+    }
+
+    vm.shutdown();
+    storage.remove();
+    return true;
+}
+
+// =============================================================================
+// Report
+// =============================================================================
+
+template <class Policy>
+static int durableRunWith(const std::vector<TraceOp>& ops, const DurableParams& params) {
+    std::cout << "Durable mode: " << ops.size() << " ops, " << params.sizeMb << " MB virtual, "
+              << params.cacheKb << " KB cache, " << params.pageSize << " B pages, "
+              << params.journalKb << " KB journal, " << Policy::name() << "\n\n";
+
+    // Overhead without power cuts
+    PassResult plain;
+    PassResult durable;
+    if (!runPass<Policy>(ops, params, 0, 0, plain) ||
+        !runPass<Policy>(ops, params, params.journalKb, 0, durable)) {
+        return 1;
+    }
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << std::setw(10) << "mode" << std::setw(10) << "wall ms" << std::setw(10) << "writes"
+              << std::setw(12) << "written KB" << std::setw(12) << "stall ms"
+              << std::setw(10) << "records" << std::setw(13) << "checkpoints" << "\n";
+    const PassResult* passes[] = {&plain, &durable};
+    const char* names[] = {"plain", "durable"};
+    for (int i = 0; i < 2; i++) {
+        const PassResult& r = *passes[i];
+        std::cout << std::setw(10) << names[i] << std::setw(10) << r.wallMs
+                  << std::setw(10) << r.io.writes << std::setw(12) << r.io.bytesWritten / 1024
+                  << std::setw(12) << r.io.modeledUs / 1000.0
+                  << std::setw(10) << r.stats.journalRecords << std::setw(13) << r.stats.checkpoints << "\n";
+    }
+    if (plain.io.bytesWritten > 0 && plain.io.modeledUs > 0) {
+        std::cout << "Overhead: " << std::setprecision(2)
+                  << static_cast<double>(durable.io.bytesWritten) / plain.io.bytesWritten << "x bytes written, "
+                  << static_cast<double>(durable.io.modeledUs) / plain.io.modeledUs << "x modeled stall\n";
+    }
+
+    // Power cuts, evenly spaced over each mode's own write count
+    std::cout << "\nPower cuts (" << params.cuts << " per mode, flush every " << params.flushEvery
+              << " ops):\n";
+    std::cout << std::setw(10) << "mode" << std::setw(10) << "intact" << std::setw(10) << "detected"
+              << std::setw(10) << "lost" << std::setw(10) << "corrupt"
+              << std::setw(10) << "records" << std::setw(8) << "torn"
+              << std::setw(14) << "max rec us" << "\n";
+
+    bool ok = true;
+    for (int i = 0; i < 2; i++) {
+        uint32_t journalKb = i == 0 ? 0 : params.journalKb;
+        uint64_t writes = passes[i]->io.writes;
+        uint64_t totals[PAGE_VERDICTS] = {};
+        uint64_t records = 0;
+        uint32_t torn = 0;
+        uint32_t maxRecoveryUs = 0;
+
+        for (uint32_t cut = 1; cut <= params.cuts && writes > 0; cut++) {
+            uint64_t cutAt = 1 + (writes - 1) * cut / (params.cuts + 1);
+            PassResult r;
+            if (!runPass<Policy>(ops, params, journalKb, cutAt, r)) {
+                return 1;
+            }
+            for (int v = 0; v < PAGE_VERDICTS; v++) totals[v] += r.verdicts[v];
+            records += r.recovery.records;
+            torn += r.recovery.torn ? 1 : 0;
+            maxRecoveryUs = std::max(maxRecoveryUs, r.recovery.timeUs);
+
+            if (journalKb > 0 && (r.verdicts[PAGE_LOST] > 0 || r.verdicts[PAGE_CORRUPT] > 0)) {
+                std::cerr << "durable: cut at write " << cutAt << " left " << r.verdicts[PAGE_LOST]
+                          << " lost and " << r.verdicts[PAGE_CORRUPT] << " corrupt pages\n";
+                ok = false;
+            }
+        }
+
+        std::cout << std::setw(10) << names[i];
+        for (int v = 0; v < PAGE_VERDICTS; v++) std::cout << std::setw(10) << totals[v];
+        std::cout << std::setw(10) << records << std::setw(8) << torn
+                  << std::setw(14) << maxRecoveryUs << "\n";
+    }
+
+    std::cout << "\nResult: " << (ok ? "OK" : "FAILED") << " (durable mode "
+              << (ok ? "kept every page intact or detected" : "lost data") << ", "
+              << VERDICT_NAMES[PAGE_CORRUPT] << " counts for plain mode are torn write-backs)\n";
+    return ok ? 0 : 1;
+}
+
+int durableRun(const std::vector<TraceOp>& ops, const DurableParams& params) {
+    return policyDispatch(params.policy, [&](auto tag) {
+        return durableRunWith<typename decltype(tag)::type>(ops, params);
+    });
+}
@@ -0,0 +1,44 @@
+#ifndef DURABLE_H
+#define DURABLE_H
+
+#include "posix_storage.h"
+#include "trace.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// =============================================================================
+// Durable Mode Overhead and Power-Cut Test
+// =============================================================================
+// Replays a trace with and without the write-ahead journal and compares the
+// storage traffic, then cuts power at evenly spaced storage writes. After
+// each cut the swap is reopened by a fresh instance and every page is
+// classified against the versions the trace wrote to it:
+//
+//   intact    a version at least as new as the last successful flush()
+//   detected  load refused with a checksum error (durable mode only)
+//   lost      an older version than the last flush() promised
+//   corrupt   matches no version at all (torn write-back)
+//
+// Durable mode must never produce lost or corrupt pages.
+
+struct DurableParams {
+    uint32_t sizeMb = 4;
+    uint32_t cacheKb = 256;
+    uint32_t tierKb = 0;
+    uint32_t pageSize = 8192;
+    uint32_t shardMb = 0;
+    uint32_t journalKb = 256;       // Journal for the durable runs
+    uint32_t policy = 0;            // VMEM_POLICY_* replacement policy
+    uint32_t cuts = 20;             // Power-cut points per mode
+    uint32_t flushEvery = 1000;     // Ops between flush() calls (0 = only at the end)
+    uint32_t seed = 1;
+    LatencyModel latency;
+    std::string swapPath;
+};
+
+// Returns 0 when durable mode kept every page intact or detected
+int durableRun(const std::vector<TraceOp>& ops, const DurableParams& params);
+
+#endif // DURABLE_H
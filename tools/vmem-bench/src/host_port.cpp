@@ -0,0 +1,59 @@
+#include "master/vmem_backend.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <thread>
+
+// =============================================================================
+// Host implementations of the VirtualMemory platform hooks
+// =============================================================================
+
+static std::atomic<bool> hostLogging(false);
+static std::atomic<uintptr_t> nextThreadId(1);
+
+void vmemSetHostLogging(bool enabled) {
+    hostLogging = enabled;
+}
+
+void vmemHostLog(const char* fmt, ...) {
+    if (!hostLogging) return;
+
+    va_list args;
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+}
+
+uint32_t vmemMillis() {
+    static const auto start = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count());
+}
+
+uint32_t vmemMicros() {
+    static const auto start = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+}
+
+// Small sequential ids read better in per-task statistics than pthread ids
+uintptr_t vmemTaskId() {
+    thread_local uintptr_t id = nextThreadId++;
+    return id;
+}
+
+const char* vmemTaskName() {
+    thread_local char name[16] = {0};
+    if (name[0] == '\0') {
+        snprintf(name, sizeof(name), "thread-%lu", static_cast<unsigned long>(vmemTaskId()));
+    }
+    return name;
+}
+
+void vmemYield() {
+    std::this_thread::yield();
+}
@@ -0,0 +1,649 @@
+#include "durable.h"
+#include "policy_dispatch.h"
+#include "posix_storage.h"
+#include "stress.h"
+#include "trace.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// =============================================================================
+// Constants
+// =============================================================================
+
+constexpr uint32_t DEFAULT_SIZE_MB = VIRTUAL_MEMORY_SIZE_MB;
+constexpr uint32_t DEFAULT_CACHE_KB = VIRTUAL_MEMORY_CACHE_MB * 1024;
+constexpr uint32_t DEFAULT_TIER_KB = VIRTUAL_MEMORY_TIER_KB;
+constexpr uint32_t DEFAULT_PAGE_SIZE = VIRTUAL_MEMORY_PAGE_SIZE;
+constexpr uint32_t DEFAULT_SHARD_MB = VIRTUAL_MEMORY_SHARD_MB;
+constexpr uint32_t DEFAULT_JOURNAL_KB = VIRTUAL_MEMORY_JOURNAL_KB;
+
+// =============================================================================
+// Options
+// =============================================================================
+
+// Contents written by trace ops (decides how well pages compress)
+enum class DataMode {
+    Random,         // Incompressible
+    Telemetry,      // Sparse slow-changing sample records
+    Zeros
+};
+
+struct BenchOptions {
+    uint32_t sizeMb = DEFAULT_SIZE_MB;
+    uint32_t cacheKb = DEFAULT_CACHE_KB;
+    uint32_t tierKb = DEFAULT_TIER_KB;
+    uint32_t pageSize = DEFAULT_PAGE_SIZE;
+    uint32_t shardMb = DEFAULT_SHARD_MB;
+    uint32_t journalKb = DEFAULT_JOURNAL_KB;
+    DataMode data = DataMode::Random;
+    uint32_t policy = VIRTUAL_MEMORY_POLICY;
+    TraceParams trace;
+    LatencyModel latency;
+    std::string swapPath;
+    uint32_t threads = 4;
+    uint32_t cuts = 20;
+    uint32_t flushEvery = 1000;
+    bool verify = false;
+    bool verbose = false;
+};
+
+struct BenchResult {
+    const char* policy;
+    uint32_t cacheKb;
+    uint32_t tierKb;
+    uint32_t journalKb;
+    uint32_t pageSize;
+    uint32_t pageTableBytes;        // Page table RAM at the end of the run
+    uint64_t ops;
+    uint64_t bytesRequested;
+    double wallMs;
+    VMemStats stats;
+    StorageCounters io;
+    bool verified;
+};
+
+// =============================================================================
+// Usage
+// =============================================================================
+
+static void printUsage(const char* progName) {
+    std::cout << "vmem-bench - Host benchmark for the master VirtualMemory system\n\n";
+    std::cout << "Usage:\n";
+    std::cout << "  " << progName << " run <trace> [options]\n";
+    std::cout << "      Replay a trace and report hit rate, stall time and bytes moved\n\n";
+    std::cout << "  " << progName << " sweep <trace> [options]\n";
+    std::cout << "      Replay a trace against cache sizes from 64KB up to --cache-kb\n\n";
+    std::cout << "  " << progName << " compare <trace> [options]\n";
+    std::cout << "      Replay a trace once per replacement policy (LRU, CLOCK, 2Q, ARC)\n\n";
+    std::cout << "  " << progName << " stress [options]\n";
+    std::cout << "      Concurrent readers/writers on one instance, checks data consistency\n\n";
+    std::cout << "  " << progName << " durable <trace> [options]\n";
+    std::cout << "      Journal overhead, then power cuts checked for lost or torn pages\n\n";
+    std::cout << "  " << progName << " gen <trace> <output> [options]\n";
+    std::cout << "      Write a synthetic trace to a file\n\n";
+    std::cout << "Traces:\n";
+    std::cout << "  seq | random | strided | hotset   Synthetic patterns\n";
+    std::cout << "  scan                              Hot set interrupted by full sweeps\n";
+    std::cout << "  <file>                            Recorded trace (R/W <addr> <len> per line)\n\n";
+    std::cout << "Geometry:\n";
+    std::cout << "  --size-mb <n>          Virtual space (default: " << DEFAULT_SIZE_MB << ")\n";
+    std::cout << "  --cache-kb <n>         Page cache (default: " << DEFAULT_CACHE_KB << ")\n";
+    std::cout << "  --tier-kb <n>          Compressed tier behind the cache (default: "
+              << DEFAULT_TIER_KB << ")\n";
+    std::cout << "  --policy <name>        Replacement policy: lru | clock | 2q | arc (default: "
+              << policyName(VIRTUAL_MEMORY_POLICY) << ")\n";
+    std::cout << "  --page-size <n>        Page size, power of two 512.." << VMEM_MAX_PAGE_SIZE
+              << " (default: " << DEFAULT_PAGE_SIZE << ")\n";
+    std::cout << "  --shard-mb <n>         Split the swap into files of this size (default: "
+              << DEFAULT_SHARD_MB << " = one file)\n";
+    std::cout << "  --journal-kb <n>       Durable mode write-ahead journal (default: "
+              << DEFAULT_JOURNAL_KB << " = off)\n\n";
+    std::cout << "Synthetic trace options:\n";
+    std::cout << "  --ops <n>              Number of accesses (default: 100000)\n";
+    std::cout << "  --length <n>           Bytes per access (default: 64)\n";
+    std::cout << "  --write-pct <n>        Percentage of writes (default: 30)\n";
+    std::cout << "  --stride <n>           Stride in bytes for strided (default: 24640)\n";
+    std::cout << "  --hot-kb <n>           Hot region for hotset (default: 1024)\n";
+    std::cout << "  --hot-pct <n>          Accesses hitting the hot region (default: 90)\n";
+    std::cout << "  --seed <n>             Random seed (default: 1)\n";
+    std::cout << "  --data <mode>          Written data: random | telemetry | zeros (default: random)\n\n";
+    std::cout << "Storage model:\n";
+    std::cout << "  --read-latency-us <n>  Fixed cost per read (default: 0)\n";
+    std::cout << "  --write-latency-us <n> Fixed cost per write (default: 0)\n";
+    std::cout << "  --throughput-kbps <n>  Transfer rate in KB/s (default: unlimited)\n";
+    std::cout << "  --sleep                Really sleep for the modeled latency\n";
+    std::cout << "  --swap <path>          Swap file, removed after each run (default: /tmp)\n\n";
+    std::cout << "Stress options:\n";
+    std::cout << "  --threads <n>          Writer threads (default: 4)\n";
+    std::cout << "  --ops <n>              Operations per writer (default: 100000)\n\n";
+    std::cout << "Durable options (journal from --journal-kb, 256 if unset):\n";
+    std::cout << "  --cuts <n>             Power-cut points per mode (default: 20)\n";
+    std::cout << "  --flush-every <n>      Trace ops between flushes (default: 1000)\n\n";
+    std::cout << "Other:\n";
+    std::cout << "  --verify               Check every read against a shadow copy\n";
+    std::cout << "  --verbose              Show VirtualMemory log output\n";
+    std::cout << "  --help                 Show this help\n";
+}
+
+// =============================================================================
+// Benchmark
+// =============================================================================
+
+static double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+static uint8_t patternByte(DataMode mode, uint32_t addr, uint32_t generation) {
+    switch (mode) {
+        case DataMode::Telemetry:
+            // 16-byte records: a sequence number and one slowly moving value
+            if (addr % 16 == 0) return static_cast<uint8_t>(generation);
+            if (addr % 16 == 4) return static_cast<uint8_t>(addr >> 12);
+            return 0;
+        case DataMode::Zeros:
+            return 0;
+        default:
+            return static_cast<uint8_t>((addr * 2654435761u) >> 24) ^ static_cast<uint8_t>(generation);
+    }
+}
+
+template <class Policy>
+static bool runTraceWith(const std::vector<TraceOp>& ops, const BenchOptions& opts,
+                         uint32_t cacheKb, BenchResult& result) {
+    const uint32_t spaceSize = opts.sizeMb * 1024 * 1024;
+
+    PosixStorage storage(opts.swapPath, opts.latency);
+    HeapAllocator allocator;
+
+    // Start every run from a fresh swap so results are comparable
+    storage.remove();
+
+    VMemGeometry geometry;
+    geometry.totalSize = spaceSize;
+    geometry.pageSize = opts.pageSize;
+    geometry.cacheSize = cacheKb * 1024;
+    geometry.tierSize = opts.tierKb * 1024;
+    geometry.shardSize = opts.shardMb * 1024 * 1024;
+    geometry.journalSize = opts.journalKb * 1024;
+
+    VirtualMemoryT<Policy> vm;
+    vm.setBackend(&storage, &allocator);
+    if (!vm.init(geometry)) {
+        std::cerr << "VirtualMemory init failed\n";
+        return false;
+    }
+
+    std::vector<uint8_t> shadow;
+    if (opts.verify) {
+        shadow.assign(spaceSize, 0);
+    }
+
+    std::vector<uint8_t> buffer;
+    result = BenchResult();
+    result.policy = Policy::name();
+    result.cacheKb = cacheKb;
+    result.tierKb = vm.getTierSize() / 1024;
+    result.journalKb = opts.journalKb;
+    result.pageSize = vm.getPageSize();
+    result.verified = true;
+
+    auto start = std::chrono::steady_clock::now();
+    uint32_t generation = 0;
+
+    for (const TraceOp& op : ops) {
+        if (op.length == 0 || static_cast<uint64_t>(op.addr) + op.length > spaceSize) {
+            continue;  // Recorded traces may come from a larger space
+        }
+        buffer.resize(op.length);
+
+        if (op.write) {
+            generation++;
+            for (uint32_t i = 0; i < op.length; i++) {
+                buffer[i] = patternByte(opts.data, op.addr + i, generation);
+            }
+            if (vm.write(op.addr, buffer.data(), op.length) < 0) {
+                std::cerr << "write failed at 0x" << std::hex << op.addr << std::dec << "\n";
+                return false;
+            }
+            if (opts.verify) {
+                std::memcpy(&shadow[op.addr], buffer.data(), op.length);
+            }
+        } else {
+            if (vm.read(op.addr, buffer.data(), op.length) < 0) {
+                std::cerr << "read failed at 0x" << std::hex << op.addr << std::dec << "\n";
+                return false;
+            }
+            if (opts.verify && std::memcmp(&shadow[op.addr], buffer.data(), op.length) != 0) {
+                std::cerr << "verify mismatch at 0x" << std::hex << op.addr << std::dec << "\n";
+                result.verified = false;
+            }
+        }
+
+        result.ops++;
+        result.bytesRequested += op.length;
+    }
+
+    vm.flush();
+    result.wallMs = elapsedMs(start);
+    result.stats = vm.getStats();
+    result.io = storage.counters();
+    result.pageTableBytes = vm.getPageTableBytes();
+
+    // Final pass: the swap plus cache must match everything written
+    if (opts.verify) {
+        std::vector<uint8_t> all(spaceSize);
+        if (vm.read(0, all.data(), spaceSize) < 0 || all != shadow) {
+            std::cerr << "verify: final contents differ from shadow copy\n";
+            result.verified = false;
+        }
+    }
+
+    vm.shutdown();
+    storage.remove();
+    return true;
+}
+
+static bool runTrace(const std::vector<TraceOp>& ops, const BenchOptions& opts,
+                     uint32_t cacheKb, BenchResult& result) {
+    return policyDispatch(opts.policy, [&](auto tag) {
+        return runTraceWith<typename decltype(tag)::type>(ops, opts, cacheKb, result);
+    });
+}
+
+static void printResult(const BenchResult& r, bool verify) {
+    uint64_t faults = static_cast<uint64_t>(r.stats.hits) + r.stats.misses;
+    double hitRate = faults ? 100.0 * r.stats.hits / faults : 100.0;
+    uint64_t moved = r.io.bytesRead + r.io.bytesWritten;
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "  Cache:            " << r.cacheKb << " KB ("
+              << r.stats.maxPages << " pages of " << r.pageSize << " B), "
+              << r.policy << " replacement\n";
+    std::cout << "  Page table:       " << r.pageTableBytes << " B\n";
+    std::cout << "  Ops:              " << r.ops << " in " << r.wallMs << " ms ("
+              << (r.wallMs > 0 ? r.ops / (r.wallMs / 1000.0) : 0.0) << " ops/s)\n";
+    std::cout << "  Page lookups:     " << faults << " (" << r.stats.hits << " hits, "
+              << r.stats.misses << " misses)\n";
+    std::cout << "  Hit rate:         " << std::setprecision(2) << hitRate << "%\n";
+    std::cout << std::setprecision(1);
+    std::cout << "  Evictions:        " << r.stats.evictions << " ("
+              << r.stats.ghostHits << " ghost hits)\n";
+    std::cout << "  Write-backs:      " << r.stats.writebacks << " pages in "
+              << r.stats.writeRuns << " sector runs ("
+              << r.stats.bytesSaved / 1024 << " KB clean sectors skipped)\n";
+    std::cout << "  Zero-fill faults: " << r.stats.zeroFills << " (no storage read)\n";
+    if (r.tierKb > 0) {
+        std::cout << "  Tier:             " << r.tierKb << " KB, " << r.stats.tierHits << " hits, "
+                  << r.stats.tierMisses << " misses, " << r.stats.tierStores << " stored, " << r.stats.tierRejects << " rejected, "
+                  << r.stats.tierEvictions << " evicted\n";
+        std::cout << "  Tier contents:    " << r.stats.tierPages << " pages in "
+                  << r.stats.tierBytes / 1024 << " KB ("
+                  << (r.stats.tierBytes ? static_cast<double>(r.stats.tierPages) * r.pageSize
+                                          / r.stats.tierBytes : 0.0) << "x)\n";
+    }
+    if (r.journalKb > 0) {
+        std::cout << "  Journal:          " << r.journalKb << " KB, " << r.stats.journalRecords
+                  << " records (" << r.stats.journalBytes / 1024 << " KB), "
+                  << r.stats.checkpoints << " checkpoints, "
+                  << r.stats.checksumErrors << " checksum errors\n";
+    }
+    std::cout << "  Storage reads:    " << r.io.reads << " (" << r.io.bytesRead / 1024 << " KB)\n";
+    std::cout << "  Storage writes:   " << r.io.writes << " (" << r.io.bytesWritten / 1024 << " KB)\n";
+    std::cout << "  Bytes moved:      " << moved / 1024 << " KB ("
+              << (r.bytesRequested ? static_cast<double>(moved) / r.bytesRequested : 0.0)
+              << "x requested)\n";
+    std::cout << "  Stall (measured): " << r.io.measuredUs / 1000.0 << " ms\n";
+    std::cout << "  Stall (modeled):  " << r.io.modeledUs / 1000.0 << " ms\n";
+    if (verify) {
+        std::cout << "  Verify:           " << (r.verified ? "OK" : "FAILED") << "\n";
+    }
+}
+
+static bool loadOps(const std::string& traceName, const BenchOptions& opts,
+                    std::vector<TraceOp>& ops) {
+    if (traceIsSynthetic(traceName)) {
+        TraceParams params = opts.trace;
+        params.spaceSize = opts.sizeMb * 1024 * 1024;
+        params.pageSize = opts.pageSize;
+        ops = traceGenerate(traceName, params);
+        return !ops.empty();
+    }
+    return traceLoad(traceName, ops);
+}
+
+// =============================================================================
+// Commands
+// =============================================================================
+
+static int cmdRun(const std::string& traceName, const BenchOptions& opts) {
+    std::vector<TraceOp> ops;
+    if (!loadOps(traceName, opts, ops)) {
+        std::cerr << "No trace ops for '" << traceName << "'\n";
+        return 1;
+    }
+
+    std::cout << "Trace: " << traceName << " (" << ops.size() << " ops), "
+              << opts.sizeMb << " MB virtual\n";
+
+    BenchResult result;
+    if (!runTrace(ops, opts, opts.cacheKb, result)) {
+        return 1;
+    }
+    printResult(result, opts.verify);
+    return (opts.verify && !result.verified) ? 1 : 0;
+}
+
+static int cmdSweep(const std::string& traceName, const BenchOptions& opts) {
+    std::vector<TraceOp> ops;
+    if (!loadOps(traceName, opts, ops)) {
+        std::cerr << "No trace ops for '" << traceName << "'\n";
+        return 1;
+    }
+
+    std::cout << "Trace: " << traceName << " (" << ops.size() << " ops), "
+              << opts.sizeMb << " MB virtual\n\n";
+    std::cout << std::setw(10) << "cache KB" << std::setw(10) << "hit %"
+              << std::setw(12) << "misses" << std::setw(12) << "writebacks"
+              << std::setw(14) << "moved KB" << std::setw(14) << "stall ms" << "\n";
+
+    uint32_t minKb = opts.pageSize / 1024 > 64 ? opts.pageSize / 1024 : 64;
+    for (uint32_t kb = minKb; kb <= opts.cacheKb; kb *= 2) {
+        BenchResult r;
+        if (!runTrace(ops, opts, kb, r)) {
+            return 1;
+        }
+        uint64_t faults = static_cast<uint64_t>(r.stats.hits) + r.stats.misses;
+        double stallMs = (opts.latency.sleep ? r.io.measuredUs : r.io.modeledUs) / 1000.0;
+        std::cout << std::fixed << std::setprecision(2)
+                  << std::setw(10) << kb
+                  << std::setw(10) << (faults ? 100.0 * r.stats.hits / faults : 100.0)
+                  << std::setw(12) << r.stats.misses
+                  << std::setw(12) << r.stats.writebacks
+                  << std::setw(14) << (r.io.bytesRead + r.io.bytesWritten) / 1024
+                  << std::setw(14) << stallMs << "\n";
+    }
+    return 0;
+}
+
+static int cmdCompare(const std::string& traceName, const BenchOptions& opts) {
+    std::vector<TraceOp> ops;
+    if (!loadOps(traceName, opts, ops)) {
+        std::cerr << "No trace ops for '" << traceName << "'\n";
+        return 1;
+    }
+
+    std::cout << "Trace: " << traceName << " (" << ops.size() << " ops), "
+              << opts.sizeMb << " MB virtual, " << opts.cacheKb << " KB cache\n\n";
+    std::cout << std::setw(8) << "policy" << std::setw(10) << "hit %"
+              << std::setw(12) << "misses" << std::setw(12) << "ghost hits"
+              << std::setw(12) << "writebacks" << std::setw(14) << "moved KB"
+              << std::setw(14) << "stall ms" << std::setw(10) << "wall ms" << "\n";
+
+    bool verified = true;
+    for (uint32_t policy = 0; policy < POLICY_COUNT; policy++) {
+        BenchOptions run = opts;
+        run.policy = policy;
+        BenchResult r;
+        if (!runTrace(ops, run, opts.cacheKb, r)) {
+            return 1;
+        }
+        verified = verified && r.verified;
+        uint64_t faults = static_cast<uint64_t>(r.stats.hits) + r.stats.misses;
+        double stallMs = (opts.latency.sleep ? r.io.measuredUs : r.io.modeledUs) / 1000.0;
+        std::cout << std::fixed << std::setprecision(2)
+                  << std::setw(8) << r.policy
+                  << std::setw(10) << (faults ? 100.0 * r.stats.hits / faults : 100.0)
+                  << std::setw(12) << r.stats.misses
+                  << std::setw(12) << r.stats.ghostHits
+                  << std::setw(12) << r.stats.writebacks
+                  << std::setw(14) << (r.io.bytesRead + r.io.bytesWritten) / 1024
+                  << std::setw(14) << stallMs
+                  << std::setw(10) << std::setprecision(1) << r.wallMs << "\n";
+    }
+
+    if (opts.verify) {
+        std::cout << "\nVerify: " << (verified ? "OK" : "FAILED") << "\n";
+    }
+    return (opts.verify && !verified) ? 1 : 0;
+}
+
+static int cmdStress(const BenchOptions& opts) {
+    StressParams params;
+    params.sizeMb = opts.sizeMb;
+    params.cacheKb = opts.cacheKb;
+    params.tierKb = opts.tierKb;
+    params.pageSize = opts.pageSize;
+    params.shardMb = opts.shardMb;
+    params.journalKb = opts.journalKb;
+    params.policy = opts.policy;
+    params.threads = opts.threads;
+    params.opsPerThread = opts.trace.ops;
+    params.seed = opts.trace.seed;
+    params.latency = opts.latency;
+    params.swapPath = opts.swapPath;
+    return stressRun(params);
+}
+
+static int cmdDurable(const std::string& traceName, const BenchOptions& opts) {
+    std::vector<TraceOp> ops;
+    if (!loadOps(traceName, opts, ops)) {
+        std::cerr << "No trace ops for '" << traceName << "'\n";
+        return 1;
+    }
+
+    DurableParams params;
+    params.sizeMb = opts.sizeMb;
+    params.cacheKb = opts.cacheKb;
+    params.tierKb = opts.tierKb;
+    params.pageSize = opts.pageSize;
+    params.shardMb = opts.shardMb;
+    params.journalKb = opts.journalKb > 0 ? opts.journalKb : 256;
+    params.policy = opts.policy;
+    params.cuts = opts.cuts;
+    params.flushEvery = opts.flushEvery;
+    params.seed = opts.trace.seed;
+    params.latency = opts.latency;
+    params.swapPath = opts.swapPath;
+    return durableRun(ops, params);
+}
+
+static int cmdGen(const std::string& traceName, const std::string& output,
+                  const BenchOptions& opts) {
+    if (!traceIsSynthetic(traceName)) {
+        std::cerr << "Unknown synthetic trace: " << traceName << "\n";
+        return 1;
+    }
+
+    std::vector<TraceOp> ops;
+    loadOps(traceName, opts, ops);
+    if (!traceSave(output, ops)) {
+        return 1;
+    }
+    std::cout << "Wrote " << ops.size() << " ops to " << output << "\n";
+    return 0;
+}
+
+// =============================================================================
+// Main
+// =============================================================================
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::string command = argv[1];
+
+    if (command == "--help" || command == "-h") {
+        printUsage(argv[0]);
+        return 0;
+    }
+
+    BenchOptions opts;
+
+    enum {
+        OPT_SIZE_MB = 1000, OPT_CACHE_KB, OPT_OPS, OPT_LENGTH, OPT_WRITE_PCT,
+        OPT_STRIDE, OPT_HOT_KB, OPT_HOT_PCT, OPT_SEED, OPT_READ_LAT, OPT_WRITE_LAT,
+        OPT_THROUGHPUT, OPT_SLEEP, OPT_SWAP, OPT_THREADS, OPT_VERIFY, OPT_VERBOSE,
+        OPT_TIER_KB, OPT_DATA, OPT_POLICY, OPT_PAGE_SIZE, OPT_SHARD_MB,
+        OPT_JOURNAL_KB, OPT_CUTS, OPT_FLUSH_EVERY
+    };
+
+    static struct option longOptions[] = {
+        {"size-mb", required_argument, nullptr, OPT_SIZE_MB},
+        {"cache-kb", required_argument, nullptr, OPT_CACHE_KB},
+        {"tier-kb", required_argument, nullptr, OPT_TIER_KB},
+        {"page-size", required_argument, nullptr, OPT_PAGE_SIZE},
+        {"shard-mb", required_argument, nullptr, OPT_SHARD_MB},
+        {"journal-kb", required_argument, nullptr, OPT_JOURNAL_KB},
+        {"data", required_argument, nullptr, OPT_DATA},
+        {"policy", required_argument, nullptr, OPT_POLICY},
+        {"ops", required_argument, nullptr, OPT_OPS},
+        {"length", required_argument, nullptr, OPT_LENGTH},
+        {"write-pct", required_argument, nullptr, OPT_WRITE_PCT},
+        {"stride", required_argument, nullptr, OPT_STRIDE},
+        {"hot-kb", required_argument, nullptr, OPT_HOT_KB},
+        {"hot-pct", required_argument, nullptr, OPT_HOT_PCT},
+        {"seed", required_argument, nullptr, OPT_SEED},
+        {"read-latency-us", required_argument, nullptr, OPT_READ_LAT},
+        {"write-latency-us", required_argument, nullptr, OPT_WRITE_LAT},
+        {"throughput-kbps", required_argument, nullptr, OPT_THROUGHPUT},
+        {"sleep", no_argument, nullptr, OPT_SLEEP},
+        {"swap", required_argument, nullptr, OPT_SWAP},
+        {"threads", required_argument, nullptr, OPT_THREADS},
+        {"cuts", required_argument, nullptr, OPT_CUTS},
+        {"flush-every", required_argument, nullptr, OPT_FLUSH_EVERY},
+        {"verify", no_argument, nullptr, OPT_VERIFY},
+        {"verbose", no_argument, nullptr, OPT_VERBOSE},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}
+    };
+
+    // Skip command name for getopt
+    optind = 2;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "h", longOptions, nullptr)) != -1) {
+        uint32_t value = optarg ? static_cast<uint32_t>(std::strtoul(optarg, nullptr, 0)) : 0;
+        switch (opt) {
+            case OPT_SIZE_MB:     opts.sizeMb = value; break;
+            case OPT_CACHE_KB:    opts.cacheKb = value; break;
+            case OPT_TIER_KB:     opts.tierKb = value; break;
+            case OPT_PAGE_SIZE:   opts.pageSize = value; break;
+            case OPT_SHARD_MB:    opts.shardMb = value; break;
+            case OPT_JOURNAL_KB:  opts.journalKb = value; break;
+            case OPT_POLICY:
+                if (!policyParse(optarg, opts.policy)) {
+                    std::cerr << "Unknown policy: " << optarg << "\n";
+                    return 1;
+                }
+                break;
+            case OPT_DATA:
+                if (std::strcmp(optarg, "random") == 0) {
+                    opts.data = DataMode::Random;
+                } else if (std::strcmp(optarg, "telemetry") == 0) {
+                    opts.data = DataMode::Telemetry;
+                } else if (std::strcmp(optarg, "zeros") == 0) {
+                    opts.data = DataMode::Zeros;
+                } else {
+                    std::cerr << "Unknown data mode: " << optarg << "\n";
+                    return 1;
+                }
+                break;
+            case OPT_OPS:         opts.trace.ops = value; break;
+            case OPT_LENGTH:      opts.trace.length = value; break;
+            case OPT_WRITE_PCT:   opts.trace.writePercent = value; break;
+            case OPT_STRIDE:      opts.trace.stride = value; break;
+            case OPT_HOT_KB:      opts.trace.hotSize = value * 1024; break;
+            case OPT_HOT_PCT:     opts.trace.hotPercent = value; break;
+            case OPT_SEED:        opts.trace.seed = value; break;
+            case OPT_READ_LAT:    opts.latency.readLatencyUs = value; break;
+            case OPT_WRITE_LAT:   opts.latency.writeLatencyUs = value; break;
+            case OPT_THROUGHPUT:  opts.latency.throughputKBps = value; break;
+            case OPT_SLEEP:       opts.latency.sleep = true; break;
+            case OPT_SWAP:        opts.swapPath = optarg; break;
+            case OPT_THREADS:     opts.threads = value; break;
+            case OPT_CUTS:        opts.cuts = value; break;
+            case OPT_FLUSH_EVERY: opts.flushEvery = value; break;
+            case OPT_VERIFY:      opts.verify = true; break;
+            case OPT_VERBOSE:     opts.verbose = true; break;
+            case 'h':
+                printUsage(argv[0]);
+                return 0;
+            default:
+                return 1;
+        }
+    }
+
+    std::vector<std::string> args;
+    for (int i = optind; i < argc; i++) {
+        args.push_back(argv[i]);
+    }
+
+    if (opts.pageSize < VMEM_MIN_PAGE_SIZE || opts.pageSize > VMEM_MAX_PAGE_SIZE ||
+        (opts.pageSize & (opts.pageSize - 1)) != 0) {
+        std::cerr << "Error: --page-size must be a power of two from " << VMEM_MIN_PAGE_SIZE
+                  << " to " << VMEM_MAX_PAGE_SIZE << "\n";
+        return 1;
+    }
+    if (opts.sizeMb == 0 || opts.cacheKb * 1024 < opts.pageSize) {
+        std::cerr << "Error: virtual size and cache must each hold at least one page\n";
+        return 1;
+    }
+
+    vmemSetHostLogging(opts.verbose);
+
+    if (opts.swapPath.empty()) {
+        opts.swapPath = "/tmp/vmem-bench-" + std::to_string(getpid()) + ".swap";
+    }
+
+    int result = 0;
+
+    if (command == "run" || command == "sweep" || command == "compare" || command == "durable") {
+        if (args.empty()) {
+            std::cerr << "Error: " << command << " command requires <trace>\n";
+            result = 1;
+        } else if (command == "run") {
+            result = cmdRun(args[0], opts);
+        } else if (command == "durable") {
+            result = cmdDurable(args[0], opts);
+        } else if (command == "compare") {
+            result = cmdCompare(args[0], opts);
+        } else {
+            result = cmdSweep(args[0], opts);
+        }
+    }
+    else if (command == "stress") {
+        if (opts.threads == 0) {
+            std::cerr << "Error: --threads must be at least 1\n";
+            result = 1;
+        } else {
+            result = cmdStress(opts);
+        }
+    }
+    else if (command == "gen") {
+        if (args.size() < 2) {
+            std::cerr << "Error: gen command requires <trace> <output>\n";
+            result = 1;
+        } else {
+            result = cmdGen(args[0], args[1], opts);
+        }
+    }
+    else {
+        std::cerr << "Unknown command: " << command << "\n\n";
+        printUsage(argv[0]);
+        result = 1;
+    }
+
+    return result;
+}
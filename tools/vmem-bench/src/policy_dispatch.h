@@ -0,0 +1,59 @@
+#ifndef POLICY_DISPATCH_H
+#define POLICY_DISPATCH_H
+
+#include "master/virtual_memory.h"
+
+#include <cstdint>
+#include <cstring>
+#include <strings.h>
+
+// =============================================================================
+// Replacement Policy Selection
+// =============================================================================
+// VirtualMemoryT takes its policy as a template parameter; the bench picks
+// one at run time (VMEM_POLICY_* from vmem_policy.h) and calls a generic
+// lambda with a tag carrying the policy type:
+//
+//   policyDispatch(policy, [&](auto tag) {
+//       VirtualMemoryT<typename decltype(tag)::type> vm;
+//       ...
+//   });
+
+template <class P>
+struct PolicyTag {
+    typedef P type;
+};
+
+constexpr uint32_t POLICY_COUNT = 4;
+
+inline const char* policyName(uint32_t policy) {
+    switch (policy) {
+        case VMEM_POLICY_CLOCK: return VMemClockPolicy::name();
+        case VMEM_POLICY_2Q:    return VMem2QPolicy::name();
+        case VMEM_POLICY_ARC:   return VMemArcPolicy::name();
+        default:                return VMemLruPolicy::name();
+    }
+}
+
+// Accepts lru, clock, 2q, arc (any case)
+inline bool policyParse(const char* name, uint32_t& policy) {
+    for (uint32_t p = 0; p < POLICY_COUNT; p++) {
+        if (strcasecmp(name, policyName(p)) == 0) {
+            policy = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+template <class Fn>
+auto policyDispatch(uint32_t policy, Fn fn) {
+    switch (policy) {
+        case VMEM_POLICY_CLOCK: return fn(PolicyTag<VMemClockPolicy>());
+        case VMEM_POLICY_2Q:    return fn(PolicyTag<VMem2QPolicy>());
+        case VMEM_POLICY_ARC:   return fn(PolicyTag<VMemArcPolicy>());
+        default:                return fn(PolicyTag<VMemLruPolicy>());
+    }
+}
+
+#endif // POLICY_DISPATCH_H
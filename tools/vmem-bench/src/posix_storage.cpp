@@ -0,0 +1,310 @@
+#include "posix_storage.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using Clock = std::chrono::steady_clock;
+
+static uint64_t elapsedUs(Clock::time_point start) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        Clock::now() - start).count());
+}
+
+// =============================================================================
+// PosixStorage
+// =============================================================================
+
+PosixStorage::PosixStorage(const std::string& path, const LatencyModel& model)
+    : _path(path), _mapPath(path + ".map"), _model(model), _shardSize(0),
+      _writesToCut(0), _powerLost(false) {
+}
+
+PosixStorage::~PosixStorage() {
+    closeFiles();
+}
+
+std::string PosixStorage::filePath(uint32_t file) const {
+    return _shardSize == 0 ? _path : _path + "." + std::to_string(file);
+}
+
+int PosixStorage::openFile(uint32_t file) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (file >= _fds.size()) {
+        _fds.resize(file + 1, -1);
+    }
+    if (_fds[file] < 0) {
+        _fds[file] = open(filePath(file).c_str(), O_RDWR);
+    }
+    return _fds[file];
+}
+
+void PosixStorage::closeFiles() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (int fd : _fds) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    _fds.clear();
+}
+
+std::string PosixStorage::sidePath(VMemSideFile file) const {
+    return _path + (file == VMEM_SIDE_META ? ".meta" : ".jnl");
+}
+
+// Unlink the single-file swap and every shard (either layout), the page map
+// and the side files
+void PosixStorage::removeFiles() {
+    unlink(_path.c_str());
+    unlink(_mapPath.c_str());
+    unlink(sidePath(VMEM_SIDE_META).c_str());
+    unlink(sidePath(VMEM_SIDE_JOURNAL).c_str());
+    for (uint32_t shard = 0;; shard++) {
+        std::string path = _path + "." + std::to_string(shard);
+        if (unlink(path.c_str()) != 0) break;
+    }
+}
+
+// Swap offset -> file number, offset made relative to that file
+uint32_t PosixStorage::locate(uint32_t& offset) const {
+    if (_shardSize == 0) return 0;
+    uint32_t file = offset / _shardSize;
+    offset %= _shardSize;
+    return file;
+}
+
+void PosixStorage::account(bool write, ssize_t bytes, uint64_t measuredUs, uint64_t modeledUs) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _counters.measuredUs += measuredUs;
+    _counters.modeledUs += modeledUs;
+    if (bytes < 0) return;
+    if (write) {
+        _counters.writes++;
+        _counters.bytesWritten += static_cast<uint64_t>(bytes);
+    } else {
+        _counters.reads++;
+        _counters.bytesRead += static_cast<uint64_t>(bytes);
+    }
+}
+
+StorageCounters PosixStorage::counters() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _counters;
+}
+
+void PosixStorage::resetCounters() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _counters = StorageCounters();
+}
+
+// =============================================================================
+// Power Cut Simulation
+// =============================================================================
+
+void PosixStorage::cutPowerAfter(uint64_t writes) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _writesToCut = writes;
+    _powerLost = false;
+}
+
+bool PosixStorage::powerLost() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _powerLost;
+}
+
+bool PosixStorage::readAllowed() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return !_powerLost;
+}
+
+// False once power is lost. The write that loses it is torn: length is cut
+// to its first half, rounded down to whole blocks, and torn is set.
+bool PosixStorage::writeAllowed(size_t& length, bool& torn) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    torn = false;
+    if (_powerLost) return false;
+    if (_writesToCut > 0 && --_writesToCut == 0) {
+        _powerLost = true;
+        torn = true;
+        length = (length / 2) & ~static_cast<size_t>(511);
+    }
+    return true;
+}
+
+bool PosixStorage::isReady() {
+    return true;
+}
+
+void PosixStorage::setShardSize(uint32_t shardSize) {
+    closeFiles();
+    _shardSize = shardSize;
+}
+
+int64_t PosixStorage::size() {
+    struct stat st;
+    if (_shardSize == 0) {
+        if (stat(_path.c_str(), &st) != 0) {
+            return -1;
+        }
+        return static_cast<int64_t>(st.st_size);
+    }
+
+    // Sum of consecutive full shards
+    int64_t total = -1;
+    for (uint32_t shard = 0;; shard++) {
+        if (stat(filePath(shard).c_str(), &st) != 0 ||
+            static_cast<uint64_t>(st.st_size) != _shardSize) {
+            break;
+        }
+        total = static_cast<int64_t>(shard + 1) * _shardSize;
+    }
+    return total;
+}
+
+bool PosixStorage::create(uint32_t size) {
+    closeFiles();
+    removeFiles();
+
+    uint32_t files = _shardSize == 0 ? 1 : (size + _shardSize - 1) / _shardSize;
+    uint32_t fileSize = _shardSize == 0 ? size : _shardSize;
+    for (uint32_t file = 0; file < files; file++) {
+        int fd = open(filePath(file).c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        // Sparse on the host; VirtualMemory never reads pages it has not written
+        bool ok = ftruncate(fd, static_cast<off_t>(fileSize)) == 0;
+        close(fd);
+        if (!ok) return false;
+    }
+    return true;
+}
+
+uint64_t PosixStorage::applyLatency(uint32_t fixedUs, size_t length) {
+    uint64_t us = fixedUs;
+    if (_model.throughputKBps > 0) {
+        us += (static_cast<uint64_t>(length) * 1000000ULL) / (_model.throughputKBps * 1024ULL);
+    }
+    if (_model.sleep && us > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(us));
+    }
+    return us;
+}
+
+int32_t PosixStorage::readAt(uint32_t offset, uint8_t* buffer, size_t length) {
+    if (!readAllowed()) return -1;
+    int fd = openFile(locate(offset));
+    if (fd < 0) return -1;
+
+    auto start = Clock::now();
+    ssize_t n = pread(fd, buffer, length, static_cast<off_t>(offset));
+    uint64_t modeledUs = applyLatency(_model.readLatencyUs, length);
+    account(false, n, elapsedUs(start), modeledUs);
+
+    return n < 0 ? -1 : static_cast<int32_t>(n);
+}
+
+int32_t PosixStorage::writeAt(uint32_t offset, const uint8_t* data, size_t length) {
+    bool torn;
+    if (!writeAllowed(length, torn)) return -1;
+    int fd = openFile(locate(offset));
+    if (fd < 0) return -1;
+
+    auto start = Clock::now();
+    ssize_t n = pwrite(fd, data, length, static_cast<off_t>(offset));
+    uint64_t modeledUs = applyLatency(_model.writeLatencyUs, length);
+    account(true, n, elapsedUs(start), modeledUs);
+
+    return n < 0 || torn ? -1 : static_cast<int32_t>(n);
+}
+
+// pwrite() hands every write to the OS, which is where the power cut
+// simulation draws the line
+bool PosixStorage::sync() {
+    return readAllowed();
+}
+
+bool PosixStorage::loadMap(uint8_t* bits, size_t length) {
+    if (!readAllowed()) return false;
+    int fd = open(_mapPath.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    auto start = Clock::now();
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) == length &&
+              pread(fd, bits, length, 0) == static_cast<ssize_t>(length);
+    close(fd);
+    uint64_t modeledUs = applyLatency(_model.readLatencyUs, length);
+    account(false, ok ? static_cast<ssize_t>(length) : -1, elapsedUs(start), modeledUs);
+
+    return ok;
+}
+
+bool PosixStorage::saveMap(const uint8_t* bits, size_t length) {
+    bool torn;
+    if (!writeAllowed(length, torn)) return false;
+    int fd = open(_mapPath.c_str(), O_WRONLY | O_CREAT, 0644);
+    if (fd < 0) return false;
+
+    auto start = Clock::now();
+    bool ok = pwrite(fd, bits, length, 0) == static_cast<ssize_t>(length);
+    close(fd);
+    uint64_t modeledUs = applyLatency(_model.writeLatencyUs, length);
+    account(true, ok ? static_cast<ssize_t>(length) : -1, elapsedUs(start), modeledUs);
+
+    return ok && !torn;
+}
+
+int32_t PosixStorage::sideReadAt(VMemSideFile file, uint32_t offset, uint8_t* buffer, size_t length) {
+    if (!readAllowed()) return -1;
+    int fd = open(sidePath(file).c_str(), O_RDONLY);
+    if (fd < 0) return -1;
+
+    auto start = Clock::now();
+    ssize_t n = pread(fd, buffer, length, static_cast<off_t>(offset));
+    close(fd);
+    uint64_t modeledUs = applyLatency(_model.readLatencyUs, length);
+    account(false, n, elapsedUs(start), modeledUs);
+
+    return n < 0 ? -1 : static_cast<int32_t>(n);
+}
+
+int32_t PosixStorage::sideWriteAt(VMemSideFile file, uint32_t offset, const uint8_t* data, size_t length) {
+    bool torn;
+    if (!writeAllowed(length, torn)) return -1;
+    int fd = open(sidePath(file).c_str(), O_WRONLY | O_CREAT, 0644);
+    if (fd < 0) return -1;
+
+    auto start = Clock::now();
+    ssize_t n = pwrite(fd, data, length, static_cast<off_t>(offset));
+    close(fd);
+    uint64_t modeledUs = applyLatency(_model.writeLatencyUs, length);
+    account(true, n, elapsedUs(start), modeledUs);
+
+    return n < 0 || torn ? -1 : static_cast<int32_t>(n);
+}
+
+void PosixStorage::remove() {
+    closeFiles();
+    removeFiles();
+}
+
+// =============================================================================
+// HeapAllocator
+// =============================================================================
+
+size_t HeapAllocator::freeBytes() {
+    return SIZE_MAX;
+}
+
+void* HeapAllocator::alloc(size_t size) {
+    return std::malloc(size);
+}
+
+void HeapAllocator::release(void* ptr) {
+    std::free(ptr);
+}
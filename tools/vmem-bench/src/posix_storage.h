@@ -0,0 +1,111 @@
+#ifndef POSIX_STORAGE_H
+#define POSIX_STORAGE_H
+
+#include "master/vmem_backend.h"
+
+#include <cstdint>
+#include <sys/types.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// =============================================================================
+// Injected Latency Model
+// =============================================================================
+// Approximates an SD card behind the firmware's SPI bus. Each operation
+// costs a fixed setup latency plus transfer time at the given throughput.
+
+struct LatencyModel {
+    uint32_t readLatencyUs = 0;     // Fixed cost per read
+    uint32_t writeLatencyUs = 0;    // Fixed cost per write
+    uint32_t throughputKBps = 0;    // Transfer rate (0 = infinite)
+    bool sleep = false;             // Actually sleep instead of only accounting
+};
+
+// =============================================================================
+// I/O Counters
+// =============================================================================
+
+struct StorageCounters {
+    uint64_t reads = 0;
+    uint64_t writes = 0;
+    uint64_t bytesRead = 0;
+    uint64_t bytesWritten = 0;
+    uint64_t measuredUs = 0;        // Wall time spent inside storage calls
+    uint64_t modeledUs = 0;         // Latency model total
+};
+
+// =============================================================================
+// POSIX File Backing Store
+// =============================================================================
+// pread/pwrite on one descriptor per file, safe to call from several
+// threads. With a shard size the swap is split into <path>.0, <path>.1, ...
+// Side files (durable mode) are <path>.meta and <path>.jnl.
+//
+// cutPowerAfter() simulates a power loss: the chosen write only lands its
+// first half (in whole 512-byte blocks) and fails, and every later read or
+// write fails, as if the card had gone away.
+
+class PosixStorage : public VMemStorage {
+public:
+    PosixStorage(const std::string& path, const LatencyModel& model);
+    ~PosixStorage() override;
+
+    bool isReady() override;
+    void setShardSize(uint32_t shardSize) override;
+    int64_t size() override;
+    bool create(uint32_t size) override;
+    int32_t readAt(uint32_t offset, uint8_t* buffer, size_t length) override;
+    int32_t writeAt(uint32_t offset, const uint8_t* data, size_t length) override;
+    bool sync() override;
+    bool loadMap(uint8_t* bits, size_t length) override;
+    bool saveMap(const uint8_t* bits, size_t length) override;
+    int32_t sideReadAt(VMemSideFile file, uint32_t offset, uint8_t* buffer, size_t length) override;
+    int32_t sideWriteAt(VMemSideFile file, uint32_t offset, const uint8_t* data, size_t length) override;
+
+    // Delete swap (all shards), page map and side files so the next init()
+    // starts from scratch
+    void remove();
+
+    // Lose power during the given write (1 = next), 0 to disarm
+    void cutPowerAfter(uint64_t writes);
+    bool powerLost();
+
+    StorageCounters counters();
+    void resetCounters();
+
+private:
+    std::string _path;
+    std::string _mapPath;
+    LatencyModel _model;
+    uint32_t _shardSize;
+    std::vector<int> _fds;          // Per file (one unless sharded), -1 until opened
+    StorageCounters _counters;
+    uint64_t _writesToCut;          // Writes left until the power cut, 0 = disarmed
+    bool _powerLost;
+    std::mutex _mutex;              // Guards _fds, _counters and the power cut (I/O itself runs unlocked)
+
+    std::string filePath(uint32_t file) const;
+    int openFile(uint32_t file);
+    void closeFiles();
+    void removeFiles();
+    std::string sidePath(VMemSideFile file) const;
+    bool readAllowed();
+    bool writeAllowed(size_t& length, bool& torn);
+    uint32_t locate(uint32_t& offset) const;
+    uint64_t applyLatency(uint32_t fixedUs, size_t length);
+    void account(bool write, ssize_t bytes, uint64_t measuredUs, uint64_t modeledUs);
+};
+
+// =============================================================================
+// Heap Cache Allocator (stands in for PSRAM)
+// =============================================================================
+
+class HeapAllocator : public VMemAllocator {
+public:
+    size_t freeBytes() override;
+    void* alloc(size_t size) override;
+    void release(void* ptr) override;
+};
+
+#endif // POSIX_STORAGE_H
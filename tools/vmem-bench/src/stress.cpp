@@ -0,0 +1,290 @@
+#include "stress.h"
+#include "policy_dispatch.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+// =============================================================================
+// Records
+// =============================================================================
+
+constexpr uint32_t RECORD_SIZE = 64;
+constexpr uint32_t PAYLOAD_WORDS = 12;
+
+struct Record {
+    uint32_t addr;                  // Own virtual address (catches misplaced pages)
+    uint32_t owner;                 // Writer thread + 1 (0 = never written)
+    uint32_t version;               // Increments on every write by the owner
+    uint32_t payload[PAYLOAD_WORDS];
+    uint32_t check;                 // Checksum over everything above
+};
+
+static_assert(sizeof(Record) == RECORD_SIZE, "Record must be 64 bytes");
+static_assert(VMEM_MIN_PAGE_SIZE % RECORD_SIZE == 0, "Records must not straddle pages");
+
+static uint32_t recordChecksum(const Record& r) {
+    const uint32_t* words = reinterpret_cast<const uint32_t*>(&r);
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < sizeof(Record) / 4 - 1; i++) {
+        h = (h ^ words[i]) * 16777619u;
+    }
+    return h;
+}
+
+static Record makeRecord(uint32_t addr, uint32_t owner, uint32_t version) {
+    Record r;
+    r.addr = addr;
+    r.owner = owner;
+    r.version = version;
+    for (uint32_t i = 0; i < PAYLOAD_WORDS; i++) {
+        r.payload[i] = (addr * 31u + version * 7u + i) ^ (owner << 24);
+    }
+    r.check = recordChecksum(r);
+    return r;
+}
+
+static bool recordIs(const Record& r, uint32_t addr, uint32_t owner, uint32_t version) {
+    Record expected = makeRecord(addr, owner, version);
+    return std::memcmp(&r, &expected, sizeof(Record)) == 0;
+}
+
+// A record read by someone other than its owner must be either untouched
+// (all zeros) or a complete version written by the owner
+static bool recordConsistent(const Record& r, uint32_t addr) {
+    static const Record zero = {};
+    if (std::memcmp(&r, &zero, sizeof(Record)) == 0) return true;
+    return r.addr == addr && r.check == recordChecksum(r) &&
+           recordIs(r, addr, r.owner, r.version);
+}
+
+// =============================================================================
+// Worker Threads
+// =============================================================================
+
+template <class VM>
+struct StressShared {
+    VM* vm;
+    uint32_t records;
+    uint32_t writers;
+    uint32_t ops;
+    uint32_t seed;
+    std::atomic<uint64_t> errors{0};
+    std::atomic<uint64_t> opsDone{0};
+    std::atomic<bool> writersDone{false};
+};
+
+template <class VM>
+static void reportError(StressShared<VM>& shared, const char* what, uint32_t addr) {
+    if (shared.errors++ < 10) {
+        std::cerr << "stress: " << what << " at 0x" << std::hex << addr << std::dec << "\n";
+    }
+}
+
+template <class VM>
+static void writerThread(StressShared<VM>& shared, uint32_t index, std::vector<uint32_t>& versions) {
+    std::mt19937 rng(shared.seed * 1000 + index);
+    const uint32_t owner = index + 1;
+    const uint32_t owned = (shared.records - index + shared.writers - 1) / shared.writers;
+    VM& vm = *shared.vm;
+
+    for (uint32_t op = 0; op < shared.ops; op++) {
+        uint32_t choice = rng() % 100;
+        uint32_t mine = (rng() % owned) * shared.writers + index;
+        uint32_t addr = mine * RECORD_SIZE;
+        Record r;
+
+        if (choice < 35) {
+            // Write a new version of an owned record
+            uint32_t version = ++versions[mine / shared.writers];
+            r = makeRecord(addr, owner, version);
+            if (vm.write(addr, &r, sizeof(r)) < 0) reportError(shared, "write failed", addr);
+        } else if (choice < 45) {
+            // Same through a single-page write mapping
+            uint32_t version = ++versions[mine / shared.writers];
+            Record* mapped = static_cast<Record*>(vm.map(addr, sizeof(Record), VMEM_MAP_WRITE));
+            if (!mapped) {
+                reportError(shared, "map failed", addr);
+                continue;
+            }
+            *mapped = makeRecord(addr, owner, version);
+            vm.unmap(addr, sizeof(Record), VMEM_MAP_WRITE);
+        } else if (choice < 70) {
+            // Owned record must hold exactly the last version written
+            uint32_t version = versions[mine / shared.writers];
+            if (vm.read(addr, &r, sizeof(r)) < 0) {
+                reportError(shared, "read failed", addr);
+            } else if (version == 0 ? !recordConsistent(r, addr) || r.owner != 0
+                                    : !recordIs(r, addr, owner, version)) {
+                reportError(shared, "lost update", addr);
+            }
+        } else if (choice < 98) {
+            // Any record must never be torn
+            uint32_t any = rng() % shared.records;
+            uint32_t anyAddr = any * RECORD_SIZE;
+            if (vm.read(anyAddr, &r, sizeof(r)) < 0) {
+                reportError(shared, "read failed", anyAddr);
+            } else if (!recordConsistent(r, anyAddr)) {
+                reportError(shared, "torn record", anyAddr);
+            }
+        } else if (index == 0 && choice == 98) {
+            // Multi-page read mapping (takes every stripe)
+            uint32_t pageSize = vm.getPageSize();
+            uint32_t span = 2 * pageSize;
+            uint32_t start = (rng() % (shared.records * RECORD_SIZE / pageSize - 2)) * pageSize;
+            const Record* mapped = static_cast<const Record*>(vm.map(start, span, VMEM_MAP_READ));
+            if (mapped) {
+                for (uint32_t i = 0; i < span / RECORD_SIZE; i++) {
+                    if (!recordConsistent(mapped[i], start + i * RECORD_SIZE)) {
+                        reportError(shared, "torn record in mapping", start + i * RECORD_SIZE);
+                    }
+                }
+                vm.unmap(start, span, VMEM_MAP_READ);
+            }
+        } else if (index == 0) {
+            vm.flush();
+        }
+        shared.opsDone++;
+    }
+}
+
+template <class VM>
+static void hotReaderThread(StressShared<VM>& shared) {
+    // First 16 KB is read constantly, so it should stay cached
+    const uint32_t hotRecords = 16384 / RECORD_SIZE;
+    std::mt19937 rng(shared.seed);
+    Record r;
+
+    while (!shared.writersDone) {
+        uint32_t addr = (rng() % hotRecords) * RECORD_SIZE;
+        if (shared.vm->read(addr, &r, sizeof(r)) < 0 || !recordConsistent(r, addr)) {
+            reportError(shared, "hot read", addr);
+        }
+        shared.opsDone++;
+    }
+}
+
+// =============================================================================
+// Entry Point
+// =============================================================================
+
+template <class Policy>
+static int stressRunWith(const StressParams& params) {
+    const uint32_t spaceSize = params.sizeMb * 1024 * 1024;
+
+    PosixStorage storage(params.swapPath, params.latency);
+    HeapAllocator allocator;
+    storage.remove();
+
+    VirtualMemoryT<Policy> vm;
+    vm.setBackend(&storage, &allocator);
+    VMemGeometry geometry;
+    geometry.totalSize = spaceSize;
+    geometry.pageSize = params.pageSize;
+    geometry.cacheSize = params.cacheKb * 1024;
+    geometry.tierSize = params.tierKb * 1024;
+    geometry.shardSize = params.shardMb * 1024 * 1024;
+    geometry.journalSize = params.journalKb * 1024;
+    if (!vm.init(geometry)) {
+        std::cerr << "VirtualMemory init failed\n";
+        return 1;
+    }
+
+    StressShared<VirtualMemoryT<Policy>> shared;
+    shared.vm = &vm;
+    shared.records = spaceSize / RECORD_SIZE;
+    shared.writers = params.threads;
+    shared.ops = params.opsPerThread;
+    shared.seed = params.seed;
+
+    std::cout << "Stress: " << params.threads << " writers + 1 hot reader, "
+              << params.opsPerThread << " ops each, " << params.sizeMb << " MB virtual, "
+              << params.cacheKb << " KB cache, " << params.tierKb << " KB tier, "
+              << params.pageSize << " B pages, " << Policy::name() << "\n";
+
+    // versions[t][k] is the last version thread t wrote to its k-th record
+    std::vector<std::vector<uint32_t>> versions(params.threads);
+    for (uint32_t t = 0; t < params.threads; t++) {
+        versions[t].assign(shared.records / params.threads + 1, 0);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::thread hot(hotReaderThread<VirtualMemoryT<Policy>>, std::ref(shared));
+    std::vector<std::thread> writers;
+    for (uint32_t t = 0; t < params.threads; t++) {
+        writers.emplace_back(writerThread<VirtualMemoryT<Policy>>, std::ref(shared), t,
+                             std::ref(versions[t]));
+    }
+    for (std::thread& w : writers) {
+        w.join();
+    }
+    shared.writersDone = true;
+    hot.join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Final state must match every writer's shadow
+    vm.flush();
+    for (uint32_t rec = 0; rec < shared.records; rec++) {
+        uint32_t t = rec % params.threads;
+        uint32_t version = versions[t][rec / params.threads];
+        uint32_t addr = rec * RECORD_SIZE;
+        Record r;
+        vm.read(addr, &r, sizeof(r));
+        bool ok = version == 0 ? recordConsistent(r, addr) && r.owner == 0
+                               : recordIs(r, addr, t + 1, version);
+        if (!ok) {
+            reportError(shared, "final contents differ", addr);
+        }
+    }
+
+    VMemStats stats = vm.getStats();
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "  Ops:              " << shared.opsDone << " in " << seconds * 1000.0 << " ms ("
+              << shared.opsDone / seconds << " ops/s)\n";
+    std::cout << "  Hit rate:         " << std::setprecision(2) << vm.hitRate() * 100.0f << "%\n";
+    std::cout << std::setprecision(1);
+    std::cout << "  Misses:           " << stats.misses << " (" << stats.zeroFills << " zero-fill)\n";
+    std::cout << "  Evictions:        " << stats.evictions << "\n";
+    std::cout << "  Relocations:      " << stats.relocations << "\n";
+    std::cout << "  Ghost hits:       " << stats.ghostHits << "\n";
+    if (params.tierKb > 0) {
+        std::cout << "  Tier:             " << stats.tierHits << " hits, " << stats.tierMisses
+                  << " misses, " << stats.tierStores
+                  << " stored, " << stats.tierRejects << " rejected, " << stats.tierEvictions
+                  << " evicted\n";
+    }
+    if (params.journalKb > 0) {
+        std::cout << "  Journal:          " << stats.journalRecords << " records, "
+                  << stats.checkpoints << " checkpoints, " << stats.checksumErrors
+                  << " checksum errors\n";
+    }
+
+    VMemTaskStats tasks[VMEM_MAX_TASK_STATS];
+    uint32_t taskCount = vm.getTaskStats(tasks, VMEM_MAX_TASK_STATS);
+    for (uint32_t i = 0; i < taskCount; i++) {
+        const VMemStats& t = tasks[i].stats;
+        std::cout << "    " << std::left << std::setw(12) << tasks[i].name << std::right
+                  << std::setw(10) << t.hits << " hits" << std::setw(10) << t.misses << " misses\n";
+    }
+
+    std::cout << "  Errors:           " << shared.errors << "\n";
+    std::cout << "  Result:           " << (shared.errors == 0 && stats.pinnedPages == 0 ? "OK" : "FAILED") << "\n";
+
+    bool pinnedLeak = stats.pinnedPages != 0;
+    vm.shutdown();
+    storage.remove();
+    return (shared.errors == 0 && !pinnedLeak) ? 0 : 1;
+}
+
+int stressRun(const StressParams& params) {
+    return policyDispatch(params.policy, [&](auto tag) {
+        return stressRunWith<typename decltype(tag)::type>(params);
+    });
+}
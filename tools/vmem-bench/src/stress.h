@@ -0,0 +1,38 @@
+#ifndef STRESS_H
+#define STRESS_H
+
+#include "posix_storage.h"
+
+#include <cstdint>
+#include <string>
+
+// =============================================================================
+// Concurrency Stress Test
+// =============================================================================
+// Several threads hammer one VirtualMemory instance at once. The space is
+// divided into 64-byte self-checking records; each writer thread owns every
+// Nth record and always knows its latest contents, while all threads also
+// read records owned by others and check they are never torn. A hot-set
+// reader keeps hitting cached pages during the page faults, and one thread
+// periodically maps multi-page spans and flushes. Everything is compared
+// against the writers' shadow state at the end.
+
+struct StressParams {
+    uint32_t sizeMb = 8;
+    uint32_t cacheKb = 512;
+    uint32_t tierKb = 0;            // Compressed tier (0 = off)
+    uint32_t pageSize = 8192;
+    uint32_t shardMb = 0;           // Swap shard size (0 = one file)
+    uint32_t journalKb = 0;         // Durable mode journal (0 = off)
+    uint32_t policy = 0;            // VMEM_POLICY_* replacement policy
+    uint32_t threads = 4;           // Writer threads (plus one hot-set reader)
+    uint32_t opsPerThread = 100000;
+    uint32_t seed = 1;
+    LatencyModel latency;
+    std::string swapPath;
+};
+
+// Returns 0 when every check passed
+int stressRun(const StressParams& params);
+
+#endif // STRESS_H
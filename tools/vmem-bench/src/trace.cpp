@@ -0,0 +1,120 @@
+#include "trace.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+bool traceIsSynthetic(const std::string& name) {
+    return name == "seq" || name == "random" || name == "strided" || name == "hotset" ||
+           name == "scan";
+}
+
+// =============================================================================
+// Synthetic Traces
+// =============================================================================
+
+std::vector<TraceOp> traceGenerate(const std::string& name, const TraceParams& params) {
+    std::vector<TraceOp> ops;
+    if (params.spaceSize < params.length || params.length == 0) {
+        return ops;
+    }
+
+    std::mt19937 rng(params.seed);
+    const uint32_t slots = params.spaceSize / params.length;   // Aligned access positions
+    std::uniform_int_distribution<uint32_t> anySlot(0, slots - 1);
+    std::uniform_int_distribution<uint32_t> percent(0, 99);
+
+    uint32_t hotSlots = params.hotSize / params.length;
+    if (hotSlots == 0 || hotSlots > slots) hotSlots = slots;
+    std::uniform_int_distribution<uint32_t> hotSlot(0, hotSlots - 1);
+
+    // scan: every cycle is four hot-set phases and one read sweep touching
+    // each page of the space once, which flushes a plain LRU cache
+    const uint32_t sweepOps = params.spaceSize / params.pageSize ? params.spaceSize / params.pageSize : 1;
+
+    ops.reserve(params.ops);
+    uint64_t pos = 0;
+
+    for (uint32_t i = 0; i < params.ops; i++) {
+        uint32_t slot;
+        bool sweep = false;
+        if (name == "seq") {
+            slot = i % slots;
+        } else if (name == "random") {
+            slot = anySlot(rng);
+        } else if (name == "strided") {
+            slot = static_cast<uint32_t>((pos / params.length) % slots);
+            pos += params.stride;
+        } else if (name == "scan" && i % (5 * sweepOps) >= 4 * sweepOps) {
+            uint32_t step = i % (5 * sweepOps) - 4 * sweepOps;
+            slot = static_cast<uint32_t>((static_cast<uint64_t>(step) * params.pageSize / params.length) % slots);
+            sweep = true;
+        } else {
+            // hotset: most accesses land in a small region at the start
+            slot = percent(rng) < params.hotPercent ? hotSlot(rng) : anySlot(rng);
+        }
+
+        TraceOp op;
+        op.addr = slot * params.length;
+        op.length = params.length;
+        op.write = !sweep && percent(rng) < params.writePercent;
+        ops.push_back(op);
+    }
+
+    return ops;
+}
+
+// =============================================================================
+// Trace Files
+// =============================================================================
+
+bool traceLoad(const std::string& path, std::vector<TraceOp>& outOps) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open trace: " << path << std::endl;
+        return false;
+    }
+
+    outOps.clear();
+    std::string line;
+    size_t lineNo = 0;
+
+    while (std::getline(file, line)) {
+        lineNo++;
+        if (line.empty() || line[0] == '#') continue;
+
+        std::istringstream iss(line);
+        std::string kind, addr, length;
+        if (!(iss >> kind >> addr >> length) || (kind != "R" && kind != "W")) {
+            std::cerr << path << ":" << lineNo << ": malformed trace line" << std::endl;
+            return false;
+        }
+
+        TraceOp op;
+        op.write = (kind == "W");
+        op.addr = static_cast<uint32_t>(std::strtoul(addr.c_str(), nullptr, 0));
+        op.length = static_cast<uint32_t>(std::strtoul(length.c_str(), nullptr, 0));
+        outOps.push_back(op);
+    }
+
+    return true;
+}
+
+bool traceSave(const std::string& path, const std::vector<TraceOp>& ops) {
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (!file) {
+        std::cerr << "Failed to create trace: " << path << std::endl;
+        return false;
+    }
+
+    std::fprintf(file, "# vmem-bench trace, %zu ops\n", ops.size());
+    for (const TraceOp& op : ops) {
+        std::fprintf(file, "%c 0x%08x %u\n", op.write ? 'W' : 'R', op.addr, op.length);
+    }
+
+    std::fclose(file);
+    return true;
+}
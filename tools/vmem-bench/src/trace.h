@@ -0,0 +1,47 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// =============================================================================
+// Access Trace
+// =============================================================================
+// Text format, one access per line (blank lines and '#' comments ignored):
+//   R <addr> <length>
+//   W <addr> <length>
+// Addresses and lengths accept decimal or 0x-prefixed hex. Traces recorded
+// on the device with VirtualMemory::setTraceHook() use the same format.
+
+struct TraceOp {
+    uint32_t addr;
+    uint32_t length;
+    bool write;
+};
+
+// Parameters for synthetic traces
+struct TraceParams {
+    uint32_t spaceSize = 0;         // Virtual address space to cover
+    uint32_t pageSize = 8192;       // Page size (scan sweeps touch each page once)
+    uint32_t ops = 100000;          // Number of accesses
+    uint32_t length = 64;           // Bytes per access
+    uint32_t writePercent = 30;     // Share of writes
+    uint32_t stride = 3 * 8192 + 64;// Byte stride for "strided"
+    uint32_t hotSize = 1 << 20;     // Hot region size for "hotset"
+    uint32_t hotPercent = 90;       // Share of accesses hitting the hot region
+    uint32_t seed = 1;
+};
+
+// Synthetic trace names accepted by traceGenerate()
+bool traceIsSynthetic(const std::string& name);
+
+// Generate sequential, random, strided, hotset or scan (hotset with periodic
+// full sequential sweeps) traces
+std::vector<TraceOp> traceGenerate(const std::string& name, const TraceParams& params);
+
+// Load / save trace files
+bool traceLoad(const std::string& path, std::vector<TraceOp>& outOps);
+bool traceSave(const std::string& path, const std::vector<TraceOp>& ops);
+
+#endif // TRACE_H